@@ -143,6 +143,65 @@ ide_buffer_change_monitor_set_property (GObject      *object,
     }
 }
 
+typedef struct
+{
+  IdeBufferChangeMonitorForeachRunFunc callback;
+  gpointer                             user_data;
+  guint                                range_begin;
+  guint                                range_end;
+  guint                                line_begin;
+  guint                                line_end;
+  IdeBufferLineChange                  change;
+} ForeachRun;
+
+static void
+foreach_run_flush (ForeachRun *state)
+{
+  guint line_begin = MAX (state->line_begin, state->range_begin);
+  guint line_end = MIN (state->line_end, state->range_end);
+
+  if (state->change != IDE_BUFFER_LINE_CHANGE_NONE && line_end > line_begin)
+    state->callback (line_begin, line_end, state->change, state->user_data);
+
+  state->change = IDE_BUFFER_LINE_CHANGE_NONE;
+}
+
+static void
+foreach_run_cb (guint               line,
+                IdeBufferLineChange change,
+                gpointer            user_data)
+{
+  ForeachRun *state = user_data;
+
+  if (change == state->change && line == state->line_end)
+    {
+      state->line_end++;
+      return;
+    }
+
+  foreach_run_flush (state);
+
+  state->line_begin = line;
+  state->line_end = line + 1;
+  state->change = change;
+}
+
+static void
+ide_buffer_change_monitor_real_foreach_run (IdeBufferChangeMonitor               *self,
+                                            guint                                 line_begin,
+                                            guint                                 line_end,
+                                            IdeBufferChangeMonitorForeachRunFunc  callback,
+                                            gpointer                              user_data)
+{
+  ForeachRun state = { callback, user_data, line_begin, line_end, 0, 0, IDE_BUFFER_LINE_CHANGE_NONE };
+
+  /* Monitors only report changed lines from foreach_change() so
+   * coalescing them costs O(changes) rather than O(lines).
+   */
+  ide_buffer_change_monitor_foreach_change (self, line_begin, line_end, foreach_run_cb, &state);
+  foreach_run_flush (&state);
+}
+
 static void
 ide_buffer_change_monitor_class_init (IdeBufferChangeMonitorClass *klass)
 {
@@ -154,6 +213,8 @@ ide_buffer_change_monitor_class_init (IdeBufferChangeMonitorClass *klass)
 
   i_object_class->destroy = ide_buffer_change_monitor_destroy;
 
+  klass->foreach_run = ide_buffer_change_monitor_real_foreach_run;
+
   properties [PROP_BUFFER] =
     g_param_spec_object ("buffer",
                          "Buffer",
@@ -217,6 +278,37 @@ ide_buffer_change_monitor_foreach_change (IdeBufferChangeMonitor            *sel
     IDE_BUFFER_CHANGE_MONITOR_GET_CLASS (self)->foreach_change (self, line_begin, line_end, callback, user_data);
 }
 
+/**
+ * ide_buffer_change_monitor_foreach_run:
+ * @self: a #IdeBufferChangeMonitor
+ * @line_begin: the starting line
+ * @line_end: the end line
+ * @callback: (scope call): a callback
+ * @user_data: user data for @callback
+ *
+ * Calls @callback for every run of consecutive lines between @line_begin
+ * and @line_end which share the same addition, deletion, or change.
+ *
+ * This is cheaper than ide_buffer_change_monitor_foreach_change() when
+ * summarizing a whole file, such as for an overview map.
+ *
+ * Since: 50
+ */
+void
+ide_buffer_change_monitor_foreach_run (IdeBufferChangeMonitor               *self,
+                                       guint                                 line_begin,
+                                       guint                                 line_end,
+                                       IdeBufferChangeMonitorForeachRunFunc  callback,
+                                       gpointer                              user_data)
+{
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+  g_return_if_fail (IDE_IS_BUFFER_CHANGE_MONITOR (self));
+  g_return_if_fail (callback != NULL);
+
+  if (line_begin < line_end)
+    IDE_BUFFER_CHANGE_MONITOR_GET_CLASS (self)->foreach_run (self, line_begin, line_end, callback, user_data);
+}
+
 /**
  * ide_buffer_change_monitor_get_buffer:
  * @self: a #IdeBufferChangeMonitor
@@ -49,6 +49,22 @@ typedef void (*IdeBufferChangeMonitorForeachFunc) (guint               line,
                                                    IdeBufferLineChange change,
                                                    gpointer            user_data);
 
+/**
+ * IdeBufferChangeMonitorForeachRunFunc:
+ * @line_begin: the first line of the run, starting from 0
+ * @line_end: the line after the last line of the run
+ * @change: the change shared by every line in the run
+ * @user_data: user data provided with callback
+ *
+ * Called for every run of consecutive lines which have the same change.
+ *
+ * Since: 50
+ */
+typedef void (*IdeBufferChangeMonitorForeachRunFunc) (guint               line_begin,
+                                                      guint               line_end,
+                                                      IdeBufferLineChange change,
+                                                      gpointer            user_data);
+
 struct _IdeBufferChangeMonitorClass
 {
   IdeObjectClass parent_class;
@@ -63,9 +79,14 @@ struct _IdeBufferChangeMonitorClass
                                          guint                              line_end,
                                          IdeBufferChangeMonitorForeachFunc  callback,
                                          gpointer                           user_data);
+  void                (*foreach_run)    (IdeBufferChangeMonitor               *self,
+                                         guint                                 line_begin,
+                                         guint                                 line_end,
+                                         IdeBufferChangeMonitorForeachRunFunc  callback,
+                                         gpointer                              user_data);
 
   /*< private >*/
-  gpointer _reserved[8];
+  gpointer _reserved[7];
 };
 
 IDE_AVAILABLE_IN_ALL
@@ -78,6 +99,12 @@ void                 ide_buffer_change_monitor_foreach_change (IdeBufferChangeMo
                                                                guint                              line_end,
                                                                IdeBufferChangeMonitorForeachFunc  callback,
                                                                gpointer                           user_data);
+IDE_AVAILABLE_IN_50
+void                 ide_buffer_change_monitor_foreach_run    (IdeBufferChangeMonitor               *self,
+                                                               guint                                 line_begin,
+                                                               guint                                 line_end,
+                                                               IdeBufferChangeMonitorForeachRunFunc  callback,
+                                                               gpointer                              user_data);
 IDE_AVAILABLE_IN_ALL
 IdeBufferLineChange  ide_buffer_change_monitor_get_change     (IdeBufferChangeMonitor            *self,
                                                                guint                              line);
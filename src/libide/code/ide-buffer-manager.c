@@ -32,6 +32,7 @@
 #include "ide-buffer-private.h"
 #include "ide-buffer-manager.h"
 #include "ide-doc-seq-private.h"
+#include "ide-file-edits-private.h"
 #include "ide-text-edit.h"
 #include "ide-text-edit-private.h"
 #include "ide-location.h"
@@ -41,6 +42,7 @@ struct _IdeBufferManager
 {
   IdeObject   parent_instance;
   GHashTable *loading_tasks;
+  GPtrArray  *journal;
   gssize      max_file_size;
 };
 
@@ -51,15 +53,52 @@ typedef struct
   guint      had_failure : 1;
 } SaveAll;
 
+/* The number of files which are edited concurrently without loading
+ * them into an IdeBuffer.
+ */
+#define N_EDIT_WORKERS 4
+
+typedef struct
+{
+  GFile  *file;
+  GArray *edits;
+  GFile  *backup;
+  char   *digest;
+  guint   needs_buffer : 1;
+  guint   written : 1;
+} FileEdits;
+
+typedef struct
+{
+  GFile    *file;
+  GFile    *backup;
+  char     *digest;
+  GWeakRef  buffer;
+  guint     change_count;
+} JournalEntry;
+
 typedef struct
 {
   GPtrArray  *edits;
   GHashTable *buffers;
   GHashTable *to_close;
+  GPtrArray  *streamed;
+  GQueue      pending;
+  GPtrArray  *journal;
+  GFile      *journal_dir;
+  GError     *error;
+  gint64      serial;
   guint       n_active;
+  guint       n_workers;
   guint       failed : 1;
 } EditState;
 
+typedef struct
+{
+  GPtrArray *journal;
+  guint      n_conflicts;
+} RevertState;
+
 typedef struct
 {
   GFile *file;
@@ -79,6 +118,7 @@ G_DEFINE_FINAL_TYPE_WITH_CODE (IdeBufferManager, ide_buffer_manager, IDE_TYPE_OB
 
 enum {
   PROP_0,
+  PROP_CAN_REVERT_EDITS,
   PROP_MAX_FILE_SIZE,
   N_PROPS
 };
@@ -94,6 +134,26 @@ enum {
 static GParamSpec *properties [N_PROPS];
 static guint signals [N_SIGNALS];
 
+static void
+file_edits_free (FileEdits *fe)
+{
+  g_clear_object (&fe->file);
+  g_clear_object (&fe->backup);
+  g_clear_pointer (&fe->edits, g_array_unref);
+  g_clear_pointer (&fe->digest, g_free);
+  g_slice_free (FileEdits, fe);
+}
+
+static void
+journal_entry_free (JournalEntry *entry)
+{
+  g_clear_object (&entry->file);
+  g_clear_object (&entry->backup);
+  g_clear_pointer (&entry->digest, g_free);
+  g_weak_ref_clear (&entry->buffer);
+  g_slice_free (JournalEntry, entry);
+}
+
 static void
 edit_state_free (EditState *state)
 {
@@ -101,13 +161,87 @@ edit_state_free (EditState *state)
 
   if (state != NULL)
     {
+      g_assert (state->n_workers == 0);
+
+      g_queue_clear (&state->pending);
       g_clear_pointer (&state->edits, g_ptr_array_unref);
       g_clear_pointer (&state->buffers, g_hash_table_unref);
       g_clear_pointer (&state->to_close, g_hash_table_unref);
+      g_clear_pointer (&state->streamed, g_ptr_array_unref);
+      g_clear_pointer (&state->journal, g_ptr_array_unref);
+      g_clear_object (&state->journal_dir);
+      g_clear_error (&state->error);
       g_slice_free (EditState, state);
     }
 }
 
+static void
+revert_state_free (RevertState *state)
+{
+  g_clear_pointer (&state->journal, g_ptr_array_unref);
+  g_slice_free (RevertState, state);
+}
+
+static void
+ide_buffer_manager_discard_journal_worker (IdeTask      *task,
+                                           gpointer      source_object,
+                                           gpointer      task_data,
+                                           GCancellable *cancellable)
+{
+  GPtrArray *journal = task_data;
+
+  g_assert (IDE_IS_TASK (task));
+  g_assert (journal != NULL);
+
+  for (guint i = 0; i < journal->len; i++)
+    {
+      const JournalEntry *entry = g_ptr_array_index (journal, i);
+
+      if (entry->backup != NULL)
+        g_file_delete (entry->backup, NULL, NULL);
+    }
+
+  ide_task_return_boolean (task, TRUE);
+}
+
+static void
+ide_buffer_manager_discard_journal (IdeBufferManager *self)
+{
+  g_autoptr(GPtrArray) journal = NULL;
+  g_autoptr(IdeTask) task = NULL;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+
+  if (!(journal = g_steal_pointer (&self->journal)))
+    return;
+
+  task = ide_task_new (self, NULL, NULL, NULL);
+  ide_task_set_source_tag (task, ide_buffer_manager_discard_journal);
+  ide_task_set_kind (task, IDE_TASK_KIND_IO);
+  ide_task_set_task_data (task, g_steal_pointer (&journal), g_ptr_array_unref);
+  ide_task_run_in_thread (task, ide_buffer_manager_discard_journal_worker);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_CAN_REVERT_EDITS]);
+}
+
+static void
+ide_buffer_manager_set_journal (IdeBufferManager *self,
+                                GPtrArray        *journal)
+{
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+  g_assert (journal != NULL);
+
+  ide_buffer_manager_discard_journal (self);
+
+  if (journal->len == 0)
+    return;
+
+  self->journal = g_ptr_array_ref (journal);
+  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_CAN_REVERT_EDITS]);
+}
+
 static void
 save_all_free (SaveAll *state)
 {
@@ -198,6 +332,8 @@ ide_buffer_manager_destroy (IdeObject *object)
 
   g_clear_pointer (&self->loading_tasks, g_hash_table_unref);
 
+  ide_buffer_manager_discard_journal (self);
+
   IDE_OBJECT_CLASS (ide_buffer_manager_parent_class)->destroy (object);
 
   IDE_EXIT;
@@ -213,6 +349,10 @@ ide_buffer_manager_get_property (GObject    *object,
 
   switch (prop_id)
     {
+    case PROP_CAN_REVERT_EDITS:
+      g_value_set_boolean (value, ide_buffer_manager_can_revert_edits (self));
+      break;
+
     case PROP_MAX_FILE_SIZE:
       g_value_set_int64 (value, ide_buffer_manager_get_max_file_size (self));
       break;
@@ -254,6 +394,20 @@ ide_buffer_manager_class_init (IdeBufferManagerClass *klass)
   i_object_class->remove = ide_buffer_manager_remove;
   i_object_class->destroy = ide_buffer_manager_destroy;
 
+  /**
+   * IdeBufferManager:can-revert-edits:
+   *
+   * The "can-revert-edits" property is %TRUE when the last call to
+   * ide_buffer_manager_apply_edits_async() may be reverted using
+   * ide_buffer_manager_revert_edits_async().
+   *
+   * Since: 50
+   */
+  properties [PROP_CAN_REVERT_EDITS] =
+    g_param_spec_boolean ("can-revert-edits", NULL, NULL,
+                          FALSE,
+                          (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   /**
    * IdeBufferManager:max-file-size:
    *
@@ -871,6 +1025,85 @@ ide_buffer_manager_save_all_finish (IdeBufferManager  *self,
   IDE_RETURN (ret);
 }
 
+static void
+file_edits_add (FileEdits   *fe,
+                IdeTextEdit *edit)
+{
+  IdeRange *range = ide_text_edit_get_range (edit);
+  IdeLocation *begin = ide_range_get_begin (range);
+  IdeLocation *end = ide_range_get_end (range);
+  IdeFileEdit file_edit;
+
+  file_edit.begin_line = ide_location_get_line (begin);
+  file_edit.begin_line_offset = ide_location_get_line_offset (begin);
+  file_edit.end_line = ide_location_get_line (end);
+  file_edit.end_line_offset = ide_location_get_line_offset (end);
+  file_edit.text = g_strdup (ide_text_edit_get_text (edit));
+
+  g_array_append_val (fe->edits, file_edit);
+}
+
+static void
+ide_buffer_manager_seal_journal_worker (IdeTask      *task,
+                                        gpointer      source_object,
+                                        gpointer      task_data,
+                                        GCancellable *cancellable)
+{
+  GPtrArray *journal = task_data;
+
+  g_assert (IDE_IS_TASK (task));
+  g_assert (journal != NULL);
+
+  /* Files which had to be edited with an IdeBuffer only have their
+   * final contents once the buffer has been saved.
+   */
+  for (guint i = journal->len; i > 0; i--)
+    {
+      JournalEntry *entry = g_ptr_array_index (journal, i - 1);
+      g_autoptr(GBytes) bytes = NULL;
+
+      if (entry->backup == NULL || entry->digest != NULL)
+        continue;
+
+      if ((bytes = g_file_load_bytes (entry->file, cancellable, NULL, NULL)))
+        {
+          entry->digest = _ide_file_compute_digest (bytes);
+        }
+      else
+        {
+          g_file_delete (entry->backup, NULL, NULL);
+          g_ptr_array_remove_index (journal, i - 1);
+        }
+    }
+
+  ide_task_return_boolean (task, TRUE);
+}
+
+static void
+ide_buffer_manager_seal_journal_cb (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  IdeBufferManager *self = (IdeBufferManager *)object;
+  g_autoptr(IdeTask) task = user_data;
+  EditState *state;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+  g_assert (IDE_IS_TASK (result));
+  g_assert (IDE_IS_TASK (task));
+
+  state = ide_task_get_task_data (task);
+
+  ide_task_propagate_boolean (IDE_TASK (result), NULL);
+  ide_buffer_manager_set_journal (self, state->journal);
+  ide_task_return_boolean (task, TRUE);
+
+  IDE_EXIT;
+}
+
 static void
 ide_buffer_manager_apply_edits_save_cb (GObject      *object,
                                         GAsyncResult *result,
@@ -878,7 +1111,9 @@ ide_buffer_manager_apply_edits_save_cb (GObject      *object,
 {
   IdeBufferManager *self = (IdeBufferManager *)object;
   g_autoptr(IdeTask) task = user_data;
+  g_autoptr(IdeTask) seal = NULL;
   g_autoptr(GError) error = NULL;
+  EditState *state;
 
   IDE_ENTRY;
 
@@ -887,10 +1122,23 @@ ide_buffer_manager_apply_edits_save_cb (GObject      *object,
   g_assert (G_IS_ASYNC_RESULT (result));
   g_assert (IDE_IS_TASK (task));
 
+  state = ide_task_get_task_data (task);
+
   if (!ide_buffer_manager_save_all_finish (self, result, &error))
-    ide_task_return_error (task, g_steal_pointer (&error));
-  else
-    ide_task_return_boolean (task, TRUE);
+    {
+      ide_buffer_manager_set_journal (self, state->journal);
+      ide_task_return_error (task, g_steal_pointer (&error));
+      IDE_EXIT;
+    }
+
+  seal = ide_task_new (self,
+                       ide_task_get_cancellable (task),
+                       ide_buffer_manager_seal_journal_cb,
+                       g_object_ref (task));
+  ide_task_set_source_tag (seal, ide_buffer_manager_apply_edits_save_cb);
+  ide_task_set_kind (seal, IDE_TASK_KIND_IO);
+  ide_task_set_task_data (seal, g_ptr_array_ref (state->journal), g_ptr_array_unref);
+  ide_task_run_in_thread (seal, ide_buffer_manager_seal_journal_worker);
 
   IDE_EXIT;
 }
@@ -977,6 +1225,88 @@ ide_buffer_manager_do_apply_edits (IdeBufferManager *self,
   IDE_EXIT;
 }
 
+static void
+ide_buffer_manager_apply_edits_in_place (IdeBufferManager *self,
+                                         IdeTask          *task)
+{
+  g_autoptr(GPtrArray) in_place = NULL;
+  g_autoptr(GPtrArray) entries = NULL;
+  GHashTableIter iter;
+  EditState *state;
+  IdeBuffer *buffer;
+  GFile *file;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+  g_assert (IDE_IS_TASK (task));
+
+  state = ide_task_get_task_data (task);
+
+  in_place = g_ptr_array_new ();
+  entries = g_ptr_array_new ();
+
+  for (guint i = 0; i < state->edits->len; i++)
+    {
+      IdeTextEdit *edit = g_ptr_array_index (state->edits, i);
+      IdeLocation *location;
+      IdeRange *range;
+
+      if (NULL == (range = ide_text_edit_get_range (edit)) ||
+          NULL == (location = ide_range_get_begin (range)) ||
+          NULL == (file = ide_location_get_file (location)))
+        continue;
+
+      if (g_hash_table_lookup (state->buffers, file) != NULL)
+        g_ptr_array_add (in_place, edit);
+    }
+
+  /* Buffers which were already open are reverted using their undo stack,
+   * so track the change count to know if anything happened since.
+   */
+  g_hash_table_iter_init (&iter, state->buffers);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&file, (gpointer *)&buffer))
+    {
+      JournalEntry *entry;
+
+      if (buffer == NULL || g_hash_table_contains (state->to_close, file))
+        continue;
+
+      entry = g_slice_new0 (JournalEntry);
+      entry->file = g_object_ref (file);
+      entry->change_count = ide_buffer_get_change_count (buffer);
+      g_weak_ref_init (&entry->buffer, buffer);
+
+      g_ptr_array_add (entries, entry);
+    }
+
+  ide_buffer_manager_do_apply_edits (self, state->buffers, in_place);
+
+  for (guint i = 0; i < entries->len; i++)
+    {
+      JournalEntry *entry = g_ptr_array_index (entries, i);
+      g_autoptr(IdeBuffer) edited = g_weak_ref_get (&entry->buffer);
+      guint change_count = ide_buffer_get_change_count (edited);
+
+      if (change_count == entry->change_count)
+        {
+          journal_entry_free (entry);
+          continue;
+        }
+
+      entry->change_count = change_count;
+      g_ptr_array_add (state->journal, entry);
+    }
+
+  ide_buffer_manager_save_all_async (self,
+                                     ide_task_get_cancellable (task),
+                                     ide_buffer_manager_apply_edits_save_cb,
+                                     g_object_ref (task));
+
+  IDE_EXIT;
+}
+
 static void
 ide_buffer_manager_apply_edits_buffer_loaded_cb (GObject      *object,
                                                  GAsyncResult *result,
@@ -1011,6 +1341,7 @@ ide_buffer_manager_apply_edits_buffer_loaded_cb (GObject      *object,
       if (state->failed == FALSE)
         {
           state->failed = TRUE;
+          ide_buffer_manager_set_journal (self, state->journal);
           ide_task_return_error (task, g_steal_pointer (&error));
         }
     }
@@ -1026,19 +1357,243 @@ ide_buffer_manager_apply_edits_buffer_loaded_cb (GObject      *object,
 
   /* If this is the last buffer to load, then we can go apply the edits. */
   if (state->n_active == 0)
+    ide_buffer_manager_apply_edits_in_place (self, task);
+
+  IDE_EXIT;
+}
+
+static void
+ide_buffer_manager_apply_edits_streamed (IdeBufferManager *self,
+                                         IdeTask          *task)
+{
+  GCancellable *cancellable;
+  EditState *state;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+  g_assert (IDE_IS_TASK (task));
+
+  cancellable = ide_task_get_cancellable (task);
+  state = ide_task_get_task_data (task);
+
+  g_assert (state->n_workers == 0);
+
+  for (guint i = 0; i < state->streamed->len; i++)
+    {
+      FileEdits *fe = g_ptr_array_index (state->streamed, i);
+      JournalEntry *entry;
+
+      if (fe->backup == NULL ||
+          !(fe->written || (fe->needs_buffer && state->error == NULL)))
+        continue;
+
+      entry = g_slice_new0 (JournalEntry);
+      entry->file = g_object_ref (fe->file);
+      entry->backup = g_steal_pointer (&fe->backup);
+      entry->digest = g_steal_pointer (&fe->digest);
+      g_weak_ref_init (&entry->buffer, NULL);
+
+      g_ptr_array_add (state->journal, entry);
+    }
+
+  /* Keep what we wrote revertible even if some files failed */
+  if (state->error != NULL)
     {
-      ide_buffer_manager_do_apply_edits (self,
-                                         state->buffers,
-                                         state->edits);
-      ide_buffer_manager_save_all_async (self,
-                                         cancellable,
-                                         ide_buffer_manager_apply_edits_save_cb,
-                                         g_steal_pointer (&task));
+      state->failed = TRUE;
+      ide_buffer_manager_set_journal (self, state->journal);
+      ide_task_return_error (task, g_steal_pointer (&state->error));
+      IDE_EXIT;
+    }
+
+  /* Files we could not edit directly (such as those which need a charset
+   * conversion) are loaded into a buffer like any other edit.
+   */
+  for (guint i = 0; i < state->streamed->len; i++)
+    {
+      FileEdits *fe = g_ptr_array_index (state->streamed, i);
+
+      if (!fe->needs_buffer)
+        continue;
+
+      g_hash_table_insert (state->buffers, g_object_ref (fe->file), NULL);
+
+      state->n_active++;
+
+      ide_buffer_manager_load_file_async (self,
+                                          fe->file,
+                                          IDE_BUFFER_OPEN_FLAGS_DISABLE_ADDINS,
+                                          NULL,
+                                          cancellable,
+                                          ide_buffer_manager_apply_edits_buffer_loaded_cb,
+                                          g_object_ref (task));
     }
 
+  IDE_TRACE_MSG ("Waiting for %d buffers to load", state->n_active);
+
+  if (state->n_active == 0)
+    ide_buffer_manager_apply_edits_in_place (self, task);
+
   IDE_EXIT;
 }
 
+static void
+ide_buffer_manager_apply_file_edits_worker (IdeTask      *task,
+                                            gpointer      source_object,
+                                            gpointer      task_data,
+                                            GCancellable *cancellable)
+{
+  FileEdits *fe = task_data;
+  g_autoptr(GBytes) contents = NULL;
+  g_autoptr(GBytes) replaced = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_TASK (task));
+  g_assert (fe != NULL);
+  g_assert (G_IS_FILE (fe->file));
+
+  if (!(contents = g_file_load_bytes (fe->file, cancellable, NULL, &error)))
+    {
+      ide_task_return_error (task, g_steal_pointer (&error));
+      return;
+    }
+
+  if (!(replaced = _ide_file_edits_apply (contents, fe->edits, &error)))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA))
+        {
+          ide_task_return_error (task, g_steal_pointer (&error));
+          return;
+        }
+
+      fe->needs_buffer = TRUE;
+    }
+  else if (g_bytes_equal (contents, replaced))
+    {
+      ide_task_return_boolean (task, TRUE);
+      return;
+    }
+
+  if (fe->backup != NULL)
+    {
+      g_autoptr(GFile) journal_dir = g_file_get_parent (fe->backup);
+      gconstpointer data;
+      gsize len;
+
+      if (!g_file_make_directory_with_parents (journal_dir, cancellable, &error))
+        {
+          if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+            {
+              ide_task_return_error (task, g_steal_pointer (&error));
+              return;
+            }
+
+          g_clear_error (&error);
+        }
+
+      data = g_bytes_get_data (contents, &len);
+
+      if (!g_file_replace_contents (fe->backup, data, len, NULL, FALSE,
+                                    G_FILE_CREATE_PRIVATE, NULL,
+                                    cancellable, &error))
+        {
+          ide_task_return_error (task, g_steal_pointer (&error));
+          return;
+        }
+    }
+
+  if (fe->needs_buffer)
+    {
+      ide_task_return_boolean (task, TRUE);
+      return;
+    }
+
+  if (!_ide_file_replace_bytes (fe->file, replaced, cancellable, &error))
+    {
+      if (fe->backup != NULL)
+        g_file_delete (fe->backup, NULL, NULL);
+      ide_task_return_error (task, g_steal_pointer (&error));
+      return;
+    }
+
+  fe->digest = _ide_file_compute_digest (replaced);
+  fe->written = TRUE;
+
+  ide_task_return_boolean (task, TRUE);
+}
+
+static void ide_buffer_manager_apply_edits_pump (IdeBufferManager *self,
+                                                 IdeTask          *task);
+
+static void
+ide_buffer_manager_apply_file_edits_cb (GObject      *object,
+                                        GAsyncResult *result,
+                                        gpointer      user_data)
+{
+  IdeBufferManager *self = (IdeBufferManager *)object;
+  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(GError) error = NULL;
+  EditState *state;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+  g_assert (IDE_IS_TASK (result));
+  g_assert (IDE_IS_TASK (task));
+
+  state = ide_task_get_task_data (task);
+  state->n_workers--;
+
+  if (!ide_task_propagate_boolean (IDE_TASK (result), &error) && state->error == NULL)
+    state->error = g_steal_pointer (&error);
+
+  ide_buffer_manager_apply_edits_pump (self, task);
+
+  IDE_EXIT;
+}
+
+static void
+ide_buffer_manager_apply_edits_pump (IdeBufferManager *self,
+                                     IdeTask          *task)
+{
+  GCancellable *cancellable;
+  EditState *state;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+  g_assert (IDE_IS_TASK (task));
+
+  cancellable = ide_task_get_cancellable (task);
+  state = ide_task_get_task_data (task);
+
+  /* Stop handing out files once something failed, but wait for the
+   * files in flight so that they may be reverted.
+   */
+  while (state->error == NULL &&
+         state->n_workers < N_EDIT_WORKERS &&
+         state->pending.length > 0)
+    {
+      FileEdits *fe = g_queue_pop_head (&state->pending);
+      g_autoptr(IdeTask) worker = NULL;
+
+      worker = ide_task_new (self,
+                             cancellable,
+                             ide_buffer_manager_apply_file_edits_cb,
+                             g_object_ref (task));
+      ide_task_set_source_tag (worker, ide_buffer_manager_apply_edits_pump);
+      ide_task_set_kind (worker, IDE_TASK_KIND_IO);
+      ide_task_set_task_data (worker, fe, NULL);
+      ide_task_run_in_thread (worker, ide_buffer_manager_apply_file_edits_worker);
+
+      state->n_workers++;
+    }
+
+  if (state->n_workers == 0)
+    ide_buffer_manager_apply_edits_streamed (self, task);
+}
+
 static void
 ide_buffer_manager_apply_edits_completed_cb (IdeBufferManager *self,
                                              GParamSpec       *pspec,
@@ -1108,8 +1663,14 @@ compare_edits (gconstpointer a,
  * @user_data: user data for @callback
  *
  * Asynchronously requests that all of @edits are applied to the buffers
- * in the project. If the buffer has not been loaded for a particular edit,
- * it will be loaded.
+ * in the project.
+ *
+ * Edits to files which are already open are applied to their buffer.
+ * Other files are edited on disk by a few worker threads without loading
+ * them into a buffer, and are replaced atomically.
+ *
+ * The edits may be reverted as a whole afterwards using
+ * ide_buffer_manager_revert_edits_async().
  *
  * @callback should call ide_buffer_manager_apply_edits_finish() to get the
  * result of this operation.
@@ -1122,6 +1683,8 @@ ide_buffer_manager_apply_edits_async (IdeBufferManager    *self,
                                       gpointer             user_data)
 {
   g_autoptr(IdeTask) task = NULL;
+  g_autoptr(IdeContext) context = NULL;
+  g_autoptr(GHashTable) streaming = NULL;
   EditState *state;
 
   IDE_ENTRY;
@@ -1138,6 +1701,9 @@ ide_buffer_manager_apply_edits_async (IdeBufferManager    *self,
   task = ide_task_new (self, cancellable, callback, user_data);
   ide_task_set_source_tag (task, ide_buffer_manager_apply_edits_async);
 
+  /* The previous edits can no longer be reverted reliably */
+  ide_buffer_manager_discard_journal (self);
+
   state = g_slice_new0 (EditState);
   state->buffers = g_hash_table_new_full (g_file_hash,
                                           (GEqualFunc)g_file_equal,
@@ -1147,21 +1713,30 @@ ide_buffer_manager_apply_edits_async (IdeBufferManager    *self,
                                            (GEqualFunc)g_file_equal,
                                            g_object_unref,
                                            _g_object_unref0);
+  state->streamed = g_ptr_array_new_with_free_func ((GDestroyNotify)file_edits_free);
+  state->journal = g_ptr_array_new_with_free_func ((GDestroyNotify)journal_entry_free);
+  state->serial = g_get_real_time ();
   state->edits = g_steal_pointer (&edits);
   ide_task_set_task_data (task, state, edit_state_free);
 
+  if ((context = ide_object_ref_context (IDE_OBJECT (self))))
+    state->journal_dir = ide_context_cache_file (context, "edit-journal", NULL);
+
   g_signal_connect_object (task,
                            "notify::completed",
                            G_CALLBACK (ide_buffer_manager_apply_edits_completed_cb),
                            self,
                            G_CONNECT_SWAPPED);
 
+  streaming = g_hash_table_new (g_file_hash, (GEqualFunc)g_file_equal);
+
   for (guint i = 0; i < state->edits->len; i++)
     {
       IdeTextEdit *edit = g_ptr_array_index (state->edits, i);
       IdeLocation *location;
       IdeBuffer *buffer;
       IdeRange *range;
+      FileEdits *fe;
       GFile *file;
 
       if (NULL == (range = ide_text_edit_get_range (edit)) ||
@@ -1172,38 +1747,44 @@ ide_buffer_manager_apply_edits_async (IdeBufferManager    *self,
       if (g_hash_table_contains (state->buffers, file))
         continue;
 
+      if ((fe = g_hash_table_lookup (streaming, file)))
+        {
+          file_edits_add (fe, edit);
+          continue;
+        }
+
       if ((buffer = ide_buffer_manager_find_buffer (self, file)))
         {
           g_hash_table_insert (state->buffers, g_object_ref (file), g_object_ref (buffer));
           continue;
         }
 
-      g_hash_table_insert (state->buffers, g_object_ref (file), NULL);
+      /* Don't load buffers for files which are not open since there may
+       * be thousands of them. Workers will edit them on disk instead.
+       */
+      fe = g_slice_new0 (FileEdits);
+      fe->file = g_object_ref (file);
+      fe->edits = g_array_new (FALSE, FALSE, sizeof (IdeFileEdit));
+      g_array_set_clear_func (fe->edits, (GDestroyNotify)_ide_file_edit_clear);
 
-      state->n_active++;
+      if (state->journal_dir != NULL)
+        {
+          g_autofree char *name = g_strdup_printf ("%"G_GINT64_FORMAT"-%u",
+                                                   state->serial,
+                                                   state->streamed->len);
+          fe->backup = g_file_get_child (state->journal_dir, name);
+        }
 
-      /* Load buffers, but don't create views for them since we don't want to
-       * create lots of views if there are lots of files to edit.
-       */
-      ide_buffer_manager_load_file_async (self,
-                                          file,
-                                          IDE_BUFFER_OPEN_FLAGS_DISABLE_ADDINS,
-                                          NULL,
-                                          cancellable,
-                                          ide_buffer_manager_apply_edits_buffer_loaded_cb,
-                                          g_object_ref (task));
+      file_edits_add (fe, edit);
+
+      g_ptr_array_add (state->streamed, fe);
+      g_queue_push_tail (&state->pending, fe);
+      g_hash_table_insert (streaming, file, fe);
     }
 
-  IDE_TRACE_MSG ("Waiting for %d buffers to load", state->n_active);
+  IDE_TRACE_MSG ("Streaming edits to %u files", state->streamed->len);
 
-  if (state->n_active == 0)
-    {
-      ide_buffer_manager_do_apply_edits (self, state->buffers, state->edits);
-      ide_buffer_manager_save_all_async (self,
-                                         cancellable,
-                                         ide_buffer_manager_apply_edits_save_cb,
-                                         g_steal_pointer (&task));
-    }
+  ide_buffer_manager_apply_edits_pump (self, task);
 
   IDE_EXIT;
 }
@@ -1226,6 +1807,245 @@ ide_buffer_manager_apply_edits_finish (IdeBufferManager  *self,
   IDE_RETURN (ret);
 }
 
+/**
+ * ide_buffer_manager_can_revert_edits:
+ * @self: an #IdeBufferManager
+ *
+ * Checks if the edits from the last call to
+ * ide_buffer_manager_apply_edits_async() may be reverted.
+ *
+ * Returns: %TRUE if ide_buffer_manager_revert_edits_async() may be used
+ *
+ * Since: 50
+ */
+gboolean
+ide_buffer_manager_can_revert_edits (IdeBufferManager *self)
+{
+  g_return_val_if_fail (IDE_IS_BUFFER_MANAGER (self), FALSE);
+
+  return self->journal != NULL;
+}
+
+static void
+ide_buffer_manager_revert_edits_worker (IdeTask      *task,
+                                        gpointer      source_object,
+                                        gpointer      task_data,
+                                        GCancellable *cancellable)
+{
+  RevertState *state = task_data;
+
+  g_assert (IDE_IS_TASK (task));
+  g_assert (state != NULL);
+  g_assert (state->journal != NULL);
+
+  for (guint i = 0; i < state->journal->len; i++)
+    {
+      const JournalEntry *entry = g_ptr_array_index (state->journal, i);
+      g_autoptr(GBytes) current = NULL;
+      g_autoptr(GBytes) original = NULL;
+      g_autoptr(GError) error = NULL;
+      g_autofree char *digest = NULL;
+
+      if (entry->backup == NULL)
+        continue;
+
+      /* A missing digest means the file was never written */
+      if (entry->digest != NULL)
+        {
+          /* Leave the file alone if it was changed after we wrote it */
+          if (!(current = g_file_load_bytes (entry->file, cancellable, NULL, NULL)) ||
+              !(digest = _ide_file_compute_digest (current)) ||
+              !g_str_equal (digest, entry->digest))
+            {
+              state->n_conflicts++;
+            }
+          else if (!(original = g_file_load_bytes (entry->backup, cancellable, NULL, &error)) ||
+                   !_ide_file_replace_bytes (entry->file, original, cancellable, &error))
+            {
+              g_warning ("Failed to revert “%s”: %s",
+                         g_file_peek_path (entry->file), error->message);
+              state->n_conflicts++;
+            }
+        }
+
+      g_file_delete (entry->backup, NULL, NULL);
+    }
+
+  ide_task_return_boolean (task, TRUE);
+}
+
+static void
+ide_buffer_manager_revert_edits_save_cb (GObject      *object,
+                                         GAsyncResult *result,
+                                         gpointer      user_data)
+{
+  IdeBufferManager *self = (IdeBufferManager *)object;
+  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(GError) error = NULL;
+  RevertState *state;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_TASK (task));
+
+  state = ide_task_get_task_data (task);
+
+  if (!ide_buffer_manager_save_all_finish (self, result, &error))
+    ide_task_return_error (task, g_steal_pointer (&error));
+  else if (state->n_conflicts > 0)
+    ide_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_FAILED,
+                               ngettext ("%u file was changed since the edits were applied and was not reverted",
+                                         "%u files were changed since the edits were applied and were not reverted",
+                                         state->n_conflicts),
+                               state->n_conflicts);
+  else
+    ide_task_return_boolean (task, TRUE);
+
+  IDE_EXIT;
+}
+
+static void
+ide_buffer_manager_revert_edits_cb (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  IdeBufferManager *self = (IdeBufferManager *)object;
+  g_autoptr(IdeTask) task = user_data;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+  g_assert (IDE_IS_TASK (result));
+  g_assert (IDE_IS_TASK (task));
+
+  ide_task_propagate_boolean (IDE_TASK (result), NULL);
+
+  /* Save buffers which were reverted using their undo stack */
+  ide_buffer_manager_save_all_async (self,
+                                     ide_task_get_cancellable (task),
+                                     ide_buffer_manager_revert_edits_save_cb,
+                                     g_steal_pointer (&task));
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_buffer_manager_revert_edits_async:
+ * @self: an #IdeBufferManager
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @callback: a #GAsyncReadyCallback to execute upon completion
+ * @user_data: closure data for @callback
+ *
+ * Reverts the edits from the last call to
+ * ide_buffer_manager_apply_edits_async() as a single operation.
+ *
+ * Files and buffers which were changed after the edits were applied are
+ * left untouched and the operation completes with an error.
+ *
+ * Since: 50
+ */
+void
+ide_buffer_manager_revert_edits_async (IdeBufferManager    *self,
+                                       GCancellable        *cancellable,
+                                       GAsyncReadyCallback  callback,
+                                       gpointer             user_data)
+{
+  g_autoptr(IdeTask) task = NULL;
+  g_autoptr(IdeTask) worker = NULL;
+  RevertState *state;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+  g_return_if_fail (IDE_IS_BUFFER_MANAGER (self));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = ide_task_new (self, cancellable, callback, user_data);
+  ide_task_set_source_tag (task, ide_buffer_manager_revert_edits_async);
+
+  if (self->journal == NULL)
+    {
+      ide_task_return_new_error (task,
+                                 G_IO_ERROR,
+                                 G_IO_ERROR_NOT_FOUND,
+                                 "There are no edits to revert");
+      IDE_EXIT;
+    }
+
+  state = g_slice_new0 (RevertState);
+  state->journal = g_steal_pointer (&self->journal);
+  ide_task_set_task_data (task, state, revert_state_free);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_CAN_REVERT_EDITS]);
+
+  /* Buffers can only be reverted if nothing changed them since */
+  for (guint i = 0; i < state->journal->len; i++)
+    {
+      const JournalEntry *entry = g_ptr_array_index (state->journal, i);
+      g_autoptr(IdeBuffer) buffer = NULL;
+
+      if (entry->backup != NULL)
+        continue;
+
+      buffer = g_weak_ref_get ((GWeakRef *)&entry->buffer);
+
+      if (buffer != NULL &&
+          ide_buffer_get_change_count (buffer) == entry->change_count &&
+          gtk_text_buffer_get_can_undo (GTK_TEXT_BUFFER (buffer)))
+        gtk_text_buffer_undo (GTK_TEXT_BUFFER (buffer));
+      else
+        state->n_conflicts++;
+    }
+
+  worker = ide_task_new (self,
+                         cancellable,
+                         ide_buffer_manager_revert_edits_cb,
+                         g_object_ref (task));
+  ide_task_set_source_tag (worker, ide_buffer_manager_revert_edits_worker);
+  ide_task_set_kind (worker, IDE_TASK_KIND_IO);
+  ide_task_set_task_data (worker, state, NULL);
+  ide_task_run_in_thread (worker, ide_buffer_manager_revert_edits_worker);
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_buffer_manager_revert_edits_finish:
+ * @self: an #IdeBufferManager
+ * @result: a #GAsyncResult provided to callback
+ * @error: a location for a #GError, or %NULL
+ *
+ * Completes a request to ide_buffer_manager_revert_edits_async().
+ *
+ * Returns: %TRUE if all of the edits were reverted; otherwise %FALSE
+ *   and @error is set
+ *
+ * Since: 50
+ */
+gboolean
+ide_buffer_manager_revert_edits_finish (IdeBufferManager  *self,
+                                        GAsyncResult      *result,
+                                        GError           **error)
+{
+  gboolean ret;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_MAIN_THREAD (), FALSE);
+  g_return_val_if_fail (IDE_IS_BUFFER_MANAGER (self), FALSE);
+  g_return_val_if_fail (IDE_IS_TASK (result), FALSE);
+
+  ret = ide_task_propagate_boolean (IDE_TASK (result), error);
+
+  IDE_RETURN (ret);
+}
+
 void
 _ide_buffer_manager_buffer_loaded (IdeBufferManager *self,
                                    IdeBuffer        *buffer)
@@ -120,5 +120,16 @@ IDE_AVAILABLE_IN_ALL
 gboolean          ide_buffer_manager_apply_edits_finish (IdeBufferManager      *self,
                                                          GAsyncResult          *result,
                                                          GError               **error);
+IDE_AVAILABLE_IN_50
+gboolean          ide_buffer_manager_can_revert_edits    (IdeBufferManager      *self);
+IDE_AVAILABLE_IN_50
+void              ide_buffer_manager_revert_edits_async  (IdeBufferManager      *self,
+                                                          GCancellable          *cancellable,
+                                                          GAsyncReadyCallback    callback,
+                                                          gpointer               user_data);
+IDE_AVAILABLE_IN_50
+gboolean          ide_buffer_manager_revert_edits_finish (IdeBufferManager      *self,
+                                                          GAsyncResult          *result,
+                                                          GError               **error);
 
 G_END_DECLS
@@ -41,6 +41,10 @@
 #define DIAG_GROUP_MAGIC       0xF1282727
 #define IS_DIAGNOSTICS_GROUP(g) ((g) && (g)->magic == DIAG_GROUP_MAGIC)
 
+IDE_DEFINE_COUNTER (diagnose_requests, "Diagnostics", "Requests", "Number of diagnose requests sent to providers");
+IDE_DEFINE_COUNTER (diagnose_received, "Diagnostics", "Received", "Number of diagnostics received from providers");
+IDE_DEFINE_COUNTER (diagnose_dispatch_usec, "Diagnostics", "Dispatch (usec)", "Time spent dispatching diagnostics");
+
 typedef struct
 {
   /*
@@ -302,6 +306,7 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
   g_autoptr(GError) error = NULL;
   IdeDiagnosticsGroup *group;
   gboolean changed;
+  gint64 begin;
 
   IDE_ENTRY;
 
@@ -310,6 +315,8 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
   g_assert (G_IS_ASYNC_RESULT (result));
   g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
 
+  begin = ide_profiler_now ();
+
   diagnostics = ide_diagnostic_provider_diagnose_finish (provider, result, &error);
 
   IDE_TRACE_MSG ("%s diagnosis completed (%s)",
@@ -355,6 +362,8 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
     {
       guint length = diagnostics_get_size (diagnostics);
 
+      ide_counter_add (&diagnose_received, length);
+
       for (guint i = 0; i < length; i++)
         {
           g_autoptr(IdeDiagnostic) diagnostic = g_list_model_get_item (G_LIST_MODEL (diagnostics), i);
@@ -391,6 +400,9 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
   if (changed)
     g_signal_emit (self, signals [CHANGED], 0);
 
+  ide_counter_add (&diagnose_dispatch_usec, (ide_profiler_now () - begin) / 1000);
+  IDE_PROFILER_SPAN_END (begin, "Diagnostics", "Dispatch", "%s", G_OBJECT_TYPE_NAME (provider));
+
   /*
    * If there are no more diagnostics providers active and the group needs
    * another diagnosis, then we can start the next one now.
@@ -438,6 +450,8 @@ ide_diagnostics_group_diagnose_foreach (IdeExtensionSetAdapter *adapter,
 
   group->in_diagnose++;
 
+  ide_counter_inc (&diagnose_requests);
+
 #ifdef IDE_ENABLE_TRACE
   {
     g_autofree gchar *uri = g_file_get_uri (group->file);
@@ -439,6 +439,99 @@ ide_diagnostics_foreach_line_in_range (IdeDiagnostics             *self,
     }
 }
 
+/**
+ * ide_diagnostics_foreach_run:
+ * @self: an #IdeDiagnostics
+ * @file: a #GFile
+ * @begin_line: the starting line
+ * @end_line: the line after the last line to include
+ * @callback: (scope call): a callback to execute for each run
+ * @user_data: user data for @callback
+ *
+ * Like ide_diagnostics_foreach_line_in_range() but calls @callback once
+ * for each run of consecutive lines sharing the same most severe
+ * #IdeDiagnosticSeverity. The cost depends on the number of diagnostics
+ * within the range rather than the number of diagnostics in @file, which
+ * makes it suitable for summarizing a whole file.
+ *
+ * Since: 50
+ */
+void
+ide_diagnostics_foreach_run (IdeDiagnostics            *self,
+                             GFile                     *file,
+                             guint                      begin_line,
+                             guint                      end_line,
+                             IdeDiagnosticsRunCallback  callback,
+                             gpointer                   user_data)
+{
+  IdeDiagnosticsPrivate *priv = ide_diagnostics_get_instance_private (self);
+  const IdeDiagnosticsCache *cache;
+  IdeDiagnosticSeverity run_severity = IDE_DIAGNOSTIC_IGNORED;
+  guint run_begin = 0;
+  guint run_end = 0;
+  guint lo;
+  guint hi;
+
+  g_return_if_fail (IDE_IS_DIAGNOSTICS (self));
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (callback != NULL);
+
+  if (priv->items->len == 0 || begin_line >= end_line)
+    return;
+
+  if (priv->caches == NULL)
+    ide_diagnostics_build_caches (self);
+
+  if (!(cache = g_hash_table_lookup (priv->caches, file)))
+    return;
+
+  /* Lines are sorted, find the first line within range */
+  lo = 0;
+  hi = cache->lines->len;
+  while (lo < hi)
+    {
+      guint mid = (lo + hi) / 2;
+
+      if ((guint)g_array_index (cache->lines, IdeDiagnosticsCacheLine, mid).line < begin_line)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  for (guint i = lo; i < cache->lines->len; i++)
+    {
+      const IdeDiagnosticsCacheLine *line = &g_array_index (cache->lines, IdeDiagnosticsCacheLine, i);
+      IdeDiagnosticSeverity severity = line->severity;
+
+      if ((guint)line->line >= end_line)
+        break;
+
+      /* Multiple diagnostics on a line collapse to the most severe */
+      while (i + 1 < cache->lines->len &&
+             g_array_index (cache->lines, IdeDiagnosticsCacheLine, i + 1).line == line->line)
+        {
+          i++;
+          severity = MAX (severity, g_array_index (cache->lines, IdeDiagnosticsCacheLine, i).severity);
+        }
+
+      if (run_end > run_begin && run_end == (guint)line->line && run_severity == severity)
+        {
+          run_end++;
+          continue;
+        }
+
+      if (run_end > run_begin)
+        callback (run_begin, run_end, run_severity, user_data);
+
+      run_begin = line->line;
+      run_end = run_begin + 1;
+      run_severity = severity;
+    }
+
+  if (run_end > run_begin)
+    callback (run_begin, run_end, run_severity, user_data);
+}
+
 /**
  * ide_diagnostics_get_diagnostic_at_line:
  * @self: a #IdeDiagnostics
@@ -49,6 +49,23 @@ typedef void (*IdeDiagnosticsLineCallback) (guint                 line,
                                             IdeDiagnosticSeverity severity,
                                             gpointer              user_data);
 
+/**
+ * IdeDiagnosticsRunCallback:
+ * @begin_line: the first line of the run, starting from 0
+ * @end_line: the line after the last line of the run
+ * @severity: the most severe #IdeDiagnosticSeverity of each line
+ * @user_data: user data provided with callback
+ *
+ * This function prototype is used to notify a caller of every run of
+ * consecutive lines which have diagnostics of the same severity.
+ *
+ * Since: 50
+ */
+typedef void (*IdeDiagnosticsRunCallback) (guint                 begin_line,
+                                           guint                 end_line,
+                                           IdeDiagnosticSeverity severity,
+                                           gpointer              user_data);
+
 struct _IdeDiagnosticsClass
 {
   IdeObjectClass parent_class;
@@ -85,6 +102,13 @@ void            ide_diagnostics_foreach_line_in_range   (IdeDiagnostics
                                                          guint                       end_line,
                                                          IdeDiagnosticsLineCallback  callback,
                                                          gpointer                    user_data);
+IDE_AVAILABLE_IN_50
+void            ide_diagnostics_foreach_run             (IdeDiagnostics             *self,
+                                                         GFile                      *file,
+                                                         guint                       begin_line,
+                                                         guint                       end_line,
+                                                         IdeDiagnosticsRunCallback   callback,
+                                                         gpointer                    user_data);
 IDE_AVAILABLE_IN_ALL
 IdeDiagnostic  *ide_diagnostics_get_diagnostic_at_line  (IdeDiagnostics             *self,
                                                          GFile                      *file,
@@ -0,0 +1,50 @@
+/* ide-file-edits-private.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* A plain copy of an IdeTextEdit that may be used from a thread. Lines
+ * and offsets follow IdeLocation, so a negative line_offset means the
+ * first non-space character of the line.
+ */
+typedef struct
+{
+  int   begin_line;
+  int   begin_line_offset;
+  int   end_line;
+  int   end_line_offset;
+  char *text;
+} IdeFileEdit;
+
+void     _ide_file_edit_clear      (IdeFileEdit   *edit);
+GBytes  *_ide_file_edits_apply     (GBytes        *contents,
+                                    const GArray  *edits,
+                                    GError       **error);
+gboolean _ide_file_replace_bytes   (GFile         *file,
+                                    GBytes        *contents,
+                                    GCancellable  *cancellable,
+                                    GError       **error);
+char    *_ide_file_compute_digest  (GBytes        *contents);
+
+G_END_DECLS
@@ -0,0 +1,380 @@
+/* ide-file-edits.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "ide-file-edits"
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include "ide-file-edits-private.h"
+
+/* These helpers apply edits to files which are not open in an IdeBuffer
+ * without creating one. They are safe to use from a thread so that the
+ * buffer manager can stream many files through a few workers.
+ */
+
+void
+_ide_file_edit_clear (IdeFileEdit *edit)
+{
+  g_clear_pointer (&edit->text, g_free);
+}
+
+typedef struct
+{
+  const char *data;
+  gsize       len;
+  /* Byte offset of the start of each line */
+  GArray     *lines;
+} LineIndex;
+
+static void
+line_index_init (LineIndex  *index,
+                 const char *data,
+                 gsize       len)
+{
+  const char *iter = data;
+  const char *end = data + len;
+  gsize zero = 0;
+
+  index->data = data;
+  index->len = len;
+  index->lines = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+  g_array_append_val (index->lines, zero);
+
+  while (iter < end)
+    {
+      const char *nl = memchr (iter, '\n', end - iter);
+      gsize offset;
+
+      if (nl == NULL)
+        break;
+
+      offset = nl - data + 1;
+      g_array_append_val (index->lines, offset);
+      iter = nl + 1;
+    }
+}
+
+static void
+line_index_clear (LineIndex *index)
+{
+  g_clear_pointer (&index->lines, g_array_unref);
+}
+
+/* Resolves a position the same way ide_buffer_get_iter_at_location()
+ * does, clamping to the end of the line or the end of the contents.
+ */
+static gsize
+line_index_get_offset (const LineIndex *index,
+                       int              line,
+                       int              line_offset)
+{
+  const char *iter;
+  const char *line_end;
+  gsize begin;
+  gsize end;
+
+  line = MAX (0, line);
+
+  if ((guint)line >= index->lines->len)
+    return index->len;
+
+  begin = g_array_index (index->lines, gsize, line);
+
+  if ((guint)line + 1 < index->lines->len)
+    end = g_array_index (index->lines, gsize, line + 1) - 1;
+  else
+    end = index->len;
+
+  /* The newline is not part of the line, nor is \r of \r\n */
+  if (end > begin && index->data[end - 1] == '\r')
+    end--;
+
+  iter = index->data + begin;
+  line_end = index->data + end;
+
+  if (line_offset < 0)
+    {
+      while (iter < line_end && g_unichar_isspace (g_utf8_get_char (iter)))
+        iter = g_utf8_next_char (iter);
+    }
+  else
+    {
+      for (int i = 0; i < line_offset && iter < line_end; i++)
+        iter = g_utf8_next_char (iter);
+    }
+
+  return MIN (iter, line_end) - index->data;
+}
+
+/**
+ * _ide_file_edits_apply:
+ * @contents: the contents of the file
+ * @edits: (element-type IdeFileEdit): the edits sorted in reverse order
+ *   as ide_buffer_manager_apply_edits_async() does
+ * @error: a location for a #GError
+ *
+ * Applies @edits to @contents. Positions outside of the file are clamped
+ * like they would be in an #IdeBuffer. Overlapping edits are trimmed so
+ * that no text is replaced twice.
+ *
+ * Contents which are not UTF-8 result in %G_IO_ERROR_INVALID_DATA as
+ * the character offsets could not be resolved without converting the
+ * file like #IdeBuffer does when loading it.
+ *
+ * Returns: (transfer full): the new contents, or %NULL and @error is set
+ */
+GBytes *
+_ide_file_edits_apply (GBytes        *contents,
+                       const GArray  *edits,
+                       GError       **error)
+{
+  LineIndex index;
+  GString *str;
+  const char *data;
+  gsize cursor = 0;
+  gsize len;
+
+  g_return_val_if_fail (contents != NULL, NULL);
+  g_return_val_if_fail (edits != NULL, NULL);
+
+  data = g_bytes_get_data (contents, &len);
+
+  if (!g_utf8_validate_len (data, len, NULL))
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_INVALID_DATA,
+                           "File is not valid UTF-8");
+      return NULL;
+    }
+
+  line_index_init (&index, data, len);
+
+  str = g_string_sized_new (len);
+
+  /* Walk the edits from the start of the file */
+  for (guint i = edits->len; i > 0; i--)
+    {
+      const IdeFileEdit *edit = &g_array_index (edits, IdeFileEdit, i - 1);
+      gsize begin = line_index_get_offset (&index, edit->begin_line, edit->begin_line_offset);
+      gsize end = line_index_get_offset (&index, edit->end_line, edit->end_line_offset);
+
+      begin = MAX (begin, cursor);
+      end = MAX (end, begin);
+
+      g_string_append_len (str, data + cursor, begin - cursor);
+
+      if (edit->text != NULL)
+        g_string_append (str, edit->text);
+
+      cursor = end;
+    }
+
+  g_string_append_len (str, data + cursor, len - cursor);
+
+  line_index_clear (&index);
+
+  return g_string_free_to_bytes (str);
+}
+
+static gboolean
+write_all (int            fd,
+           const guint8  *data,
+           gsize          len,
+           GError       **error)
+{
+  while (len > 0)
+    {
+      gssize n_written = write (fd, data, len);
+
+      if (n_written < 0)
+        {
+          int errsv = errno;
+
+          if (errsv == EINTR)
+            continue;
+
+          g_set_error_literal (error,
+                               G_IO_ERROR,
+                               g_io_error_from_errno (errsv),
+                               g_strerror (errsv));
+          return FALSE;
+        }
+
+      data += n_written;
+      len -= n_written;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+sync_fd (int      fd,
+         GError **error)
+{
+  if (fsync (fd) != 0)
+    {
+      int errsv = errno;
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           g_io_error_from_errno (errsv),
+                           g_strerror (errsv));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * _ide_file_replace_bytes:
+ * @file: the file to replace
+ * @contents: the new contents
+ * @cancellable: (nullable): a #GCancellable
+ * @error: a location for a #GError
+ *
+ * Atomically replaces the contents of @file by writing a temporary file
+ * next to it and renaming it over @file.
+ *
+ * Unlike g_file_replace_contents(), the mode, owner and extended
+ * attributes of @file are copied to the new file before it is renamed
+ * into place, and symbolic links are followed rather than replaced.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set
+ */
+gboolean
+_ide_file_replace_bytes (GFile         *file,
+                         GBytes        *contents,
+                         GCancellable  *cancellable,
+                         GError       **error)
+{
+  g_autoptr(GFileInfo) xattrs = NULL;
+  g_autoptr(GFile) real_file = NULL;
+  g_autoptr(GFile) tmp_file = NULL;
+  g_autofree char *real_path = NULL;
+  g_autofree char *dirname = NULL;
+  g_autofree char *basename = NULL;
+  g_autofree char *tmpl = NULL;
+  const guint8 *data;
+  struct stat st;
+  gsize len;
+  int fd;
+
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (contents != NULL, FALSE);
+
+  data = g_bytes_get_data (contents, &len);
+
+  if (!g_file_is_native (file))
+    return g_file_replace_contents (file, (const char *)data, len, NULL, FALSE,
+                                    G_FILE_CREATE_NONE, NULL, cancellable, error);
+
+  if (!(real_path = realpath (g_file_peek_path (file), NULL)))
+    real_path = g_file_get_path (file);
+
+  if (g_stat (real_path, &st) != 0)
+    {
+      int errsv = errno;
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errsv),
+                   "Failed to stat %s: %s",
+                   real_path, g_strerror (errsv));
+      return FALSE;
+    }
+
+  real_file = g_file_new_for_path (real_path);
+  xattrs = g_file_query_info (real_file,
+                              "xattr::*,xattr-sys::*",
+                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                              cancellable,
+                              NULL);
+
+  dirname = g_path_get_dirname (real_path);
+  basename = g_path_get_basename (real_path);
+  tmpl = g_strdup_printf ("%s/.%s.XXXXXX", dirname, basename);
+
+  if (-1 == (fd = g_mkstemp_full (tmpl, O_RDWR | O_CLOEXEC, st.st_mode & 0777)))
+    {
+      int errsv = errno;
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errsv),
+                   "Failed to create temporary file: %s",
+                   g_strerror (errsv));
+      return FALSE;
+    }
+
+  /* Ownership may only be kept when we are allowed to, which is fine */
+  if (fchmod (fd, st.st_mode & 07777) != 0 ||
+      (fchown (fd, st.st_uid, st.st_gid) != 0 && errno != EPERM))
+    g_debug ("Failed to copy permissions to %s: %s", tmpl, g_strerror (errno));
+
+  if (!write_all (fd, data, len, error) ||
+      g_cancellable_set_error_if_cancelled (cancellable, error) ||
+      !sync_fd (fd, error))
+    {
+      close (fd);
+      g_unlink (tmpl);
+      return FALSE;
+    }
+
+  close (fd);
+
+  tmp_file = g_file_new_for_path (tmpl);
+
+  if (xattrs != NULL)
+    g_file_set_attributes_from_info (tmp_file,
+                                     xattrs,
+                                     G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                     cancellable,
+                                     NULL);
+
+  if (g_rename (tmpl, real_path) != 0)
+    {
+      int errsv = errno;
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errsv),
+                   "Failed to replace %s: %s",
+                   real_path, g_strerror (errsv));
+      g_unlink (tmpl);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+char *
+_ide_file_compute_digest (GBytes *contents)
+{
+  g_return_val_if_fail (contents != NULL, NULL);
+
+  return g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, contents);
+}
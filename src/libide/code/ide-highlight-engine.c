@@ -42,6 +42,9 @@
 #define RUN_UNCHECKED GSIZE_TO_POINTER(0)
 #define RUN_CHECKED   GSIZE_TO_POINTER(1)
 
+IDE_DEFINE_COUNTER (highlight_quanta, "Highlighting", "Quanta", "Number of highlighting quanta run");
+IDE_DEFINE_COUNTER (highlight_usec, "Highlighting", "Time (usec)", "Time spent highlighting");
+
 struct _IdeHighlightEngine
 {
   IdeObject            parent_instance;
@@ -394,7 +397,15 @@ ide_highlight_engine_worker (gint64   deadline,
 
   if (self->enabled)
     {
-      if (ide_highlight_engine_tick (self, deadline))
+      gint64 begin = ide_profiler_now ();
+      gboolean ret = ide_highlight_engine_tick (self, deadline);
+      gint64 end = ide_profiler_now ();
+
+      ide_counter_inc (&highlight_quanta);
+      ide_counter_add (&highlight_usec, (end - begin) / 1000);
+      IDE_PROFILER_SPAN_END (begin, "Highlighting", "Quanta", "%s", G_OBJECT_TYPE_NAME (self->highlighter));
+
+      if (ret)
         return G_SOURCE_CONTINUE;
     }
 
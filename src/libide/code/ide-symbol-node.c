@@ -326,3 +326,43 @@ ide_symbol_node_get_location_finish (IdeSymbolNode  *self,
 
   return IDE_SYMBOL_NODE_GET_CLASS (self)->get_location_finish (self, result, error);
 }
+
+/**
+ * ide_symbol_node_get_range:
+ * @self: a #IdeSymbolNode
+ * @begin_line: (out) (optional): location for the first line
+ * @begin_line_offset: (out) (optional): location for the offset in @begin_line
+ * @end_line: (out) (optional): location for the last line
+ * @end_line_offset: (out) (optional): location for the offset in @end_line
+ *
+ * Gets the range of the symbol within the file without a round-trip to
+ * the symbol resolver. Not all symbol nodes know their range, in which
+ * case use ide_symbol_node_get_location_async().
+ *
+ * Returns: %TRUE if the range was retrieved
+ *
+ * Since: 50
+ */
+gboolean
+ide_symbol_node_get_range (IdeSymbolNode *self,
+                           guint         *begin_line,
+                           guint         *begin_line_offset,
+                           guint         *end_line,
+                           guint         *end_line_offset)
+{
+  guint dummy_begin_line;
+  guint dummy_begin_line_offset;
+  guint dummy_end_line;
+  guint dummy_end_line_offset;
+
+  g_return_val_if_fail (IDE_IS_SYMBOL_NODE (self), FALSE);
+
+  if (IDE_SYMBOL_NODE_GET_CLASS (self)->get_range == NULL)
+    return FALSE;
+
+  return IDE_SYMBOL_NODE_GET_CLASS (self)->get_range (self,
+                                                      begin_line ? begin_line : &dummy_begin_line,
+                                                      begin_line_offset ? begin_line_offset : &dummy_begin_line_offset,
+                                                      end_line ? end_line : &dummy_end_line,
+                                                      end_line_offset ? end_line_offset : &dummy_end_line_offset);
+}
@@ -47,9 +47,14 @@ struct _IdeSymbolNodeClass
   IdeLocation *(*get_location_finish) (IdeSymbolNode        *self,
                                        GAsyncResult         *result,
                                        GError             **error);
+  gboolean     (*get_range)           (IdeSymbolNode        *self,
+                                       guint                *begin_line,
+                                       guint                *begin_line_offset,
+                                       guint                *end_line,
+                                       guint                *end_line_offset);
 
   /*< private >*/
-  gpointer _reserved[8];
+  gpointer _reserved[7];
 };
 
 IDE_AVAILABLE_IN_ALL
@@ -73,5 +78,11 @@ IDE_AVAILABLE_IN_ALL
 IdeLocation    *ide_symbol_node_get_location_finish (IdeSymbolNode        *self,
                                                      GAsyncResult         *result,
                                                      GError              **error);
+IDE_AVAILABLE_IN_50
+gboolean        ide_symbol_node_get_range           (IdeSymbolNode        *self,
+                                                     guint                *begin_line,
+                                                     guint                *begin_line_offset,
+                                                     guint                *end_line,
+                                                     guint                *end_line_offset);
 
 G_END_DECLS
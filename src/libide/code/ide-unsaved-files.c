@@ -45,6 +45,9 @@ typedef struct
   IdeUnsavedFiles *backptr;
 } UnsavedFile;
 
+IDE_DEFINE_COUNTER (unsaved_file_syncs, "Unsaved Files", "Syncs", "Number of buffer contents synced to unsaved files");
+IDE_DEFINE_COUNTER (unsaved_file_bytes, "Unsaved Files", "Bytes", "Number of bytes synced to unsaved files");
+
 struct _IdeUnsavedFiles
 {
   IdeObject  parent_instance;
@@ -672,12 +675,20 @@ ide_unsaved_files_update (IdeUnsavedFiles *self,
                           GFile           *file,
                           GBytes          *content)
 {
+  gint64 begin = IDE_PROFILER_SPAN_BEGIN ();
+
   g_assert (IDE_IS_UNSAVED_FILES (self));
   g_assert (G_IS_FILE (file));
 
   g_mutex_lock (&self->mutex);
   ide_unsaved_files_update_locked (self, file, content);
   g_mutex_unlock (&self->mutex);
+
+  ide_counter_inc (&unsaved_file_syncs);
+  ide_counter_add (&unsaved_file_bytes, content ? g_bytes_get_size (content) : 0);
+  IDE_PROFILER_SPAN_END (begin, "Unsaved Files", "Sync",
+                         "%"G_GSIZE_FORMAT" bytes",
+                         content ? g_bytes_get_size (content) : 0);
 }
 
 /**
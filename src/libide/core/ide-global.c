@@ -287,6 +287,12 @@ _ide_trace_init (IdeTraceVTable *vtable)
     trace_vtable.load ();
 }
 
+const IdeTraceVTable *
+_ide_trace_get_vtable (void)
+{
+  return &trace_vtable;
+}
+
 void
 _ide_trace_shutdown (void)
 {
@@ -34,13 +34,33 @@ typedef struct
   void (*log)      (GLogLevelFlags  log_level,
                     const gchar    *domain,
                     const gchar    *message);
+
+  /* Used by IdeProfiler to export counters and marks. All of these may
+   * be called from any thread and must be safe for that.
+   */
+  gboolean (*begin_capture)  (const char    *filename,
+                              GError       **error);
+  void     (*end_capture)    (void);
+  void     (*mark)           (gint64         begin_time_nsec,
+                              gint64         duration_nsec,
+                              const char    *group,
+                              const char    *name,
+                              const char    *message);
+  void     (*define_counter) (guint          id,
+                              const char    *category,
+                              const char    *name,
+                              const char    *description);
+  void     (*set_counters)   (const guint   *ids,
+                              const gint64  *values,
+                              guint          n_values);
 } IdeTraceVTable;
 
-void                 _ide_trace_init     (IdeTraceVTable *vtable);
-void                 _ide_trace_log      (GLogLevelFlags  log_level,
-                                          const gchar    *domain,
-                                          const gchar    *message);
-void                 _ide_trace_shutdown (void);
-const gchar * const *_ide_host_environ   (void);
+void                  _ide_trace_init       (IdeTraceVTable *vtable);
+const IdeTraceVTable *_ide_trace_get_vtable (void);
+void                  _ide_trace_log        (GLogLevelFlags  log_level,
+                                             const gchar    *domain,
+                                             const gchar    *message);
+void                  _ide_trace_shutdown   (void);
+const gchar * const  *_ide_host_environ     (void);
 
 G_END_DECLS
@@ -0,0 +1,512 @@
+/* ide-profiler.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "ide-profiler"
+
+#include "config.h"
+
+#include <string.h>
+#include <time.h>
+
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+
+#include "ide-global.h"
+#include "ide-macros.h"
+#include "ide-private.h"
+#include "ide-profiler.h"
+
+/* Each thread that touches a counter gets its own block of slots so that
+ * ide_counter_add() never takes a lock or bounces a cache line between
+ * threads. The sampler thread sums the blocks periodically and hands the
+ * totals to the trace vtable, which writes them to the capture.
+ */
+
+#define MAX_COUNTERS         256
+#define SAMPLE_INTERVAL_USEC (G_USEC_PER_SEC / 20)
+#define SLOW_DISPATCH_NSEC   (G_GINT64_CONSTANT (2) * 1000 * 1000)
+
+typedef struct _CounterSlots
+{
+  GList  link;
+  gint64 values[MAX_COUNTERS];
+} CounterSlots;
+
+static void counter_slots_retire (gpointer data);
+
+static GMutex      registry_mutex;
+static IdeCounter *registry[MAX_COUNTERS];
+static guint       n_registered;
+static GQueue      all_slots;
+static gint64      retired[MAX_COUNTERS];
+static GPrivate    slots_key = G_PRIVATE_INIT (counter_slots_retire);
+
+static int         active;
+static GThread    *sampler;
+static GCond       sampler_cond;
+static gboolean    sampler_exit;
+static guint       n_defined;
+static gint64      exported[MAX_COUNTERS];
+
+static GPollFunc   saved_poll_func;
+static gint64      last_poll_return;
+
+IDE_DEFINE_COUNTER (main_loop_iterations, "Main Loop", "Iterations", "Number of main loop iterations");
+IDE_DEFINE_COUNTER (main_loop_busy, "Main Loop", "Busy (usec)", "Time spent dispatching sources");
+
+static inline gint64
+slot_load (const gint64 *slot)
+{
+  return __atomic_load_n (slot, __ATOMIC_RELAXED);
+}
+
+static inline void
+slot_store (gint64 *slot,
+            gint64  value)
+{
+  __atomic_store_n (slot, value, __ATOMIC_RELAXED);
+}
+
+static CounterSlots *
+counter_slots_new (void)
+{
+  CounterSlots *slots = g_new0 (CounterSlots, 1);
+
+  slots->link.data = slots;
+
+  g_mutex_lock (&registry_mutex);
+  g_queue_push_tail_link (&all_slots, &slots->link);
+  g_mutex_unlock (&registry_mutex);
+
+  g_private_set (&slots_key, slots);
+
+  return slots;
+}
+
+static void
+counter_slots_retire (gpointer data)
+{
+  CounterSlots *slots = data;
+
+  /* Fold the totals of the exiting thread into the retired values
+   * so that counters never go backwards in the capture.
+   */
+  g_mutex_lock (&registry_mutex);
+  for (guint i = 0; i < MAX_COUNTERS; i++)
+    retired[i] += slots->values[i];
+  g_queue_unlink (&all_slots, &slots->link);
+  g_mutex_unlock (&registry_mutex);
+
+  g_free (slots);
+}
+
+static guint
+ide_counter_register (IdeCounter *counter)
+{
+  guint id;
+
+  g_mutex_lock (&registry_mutex);
+
+  if (!(id = counter->id))
+    {
+      if (n_registered < MAX_COUNTERS)
+        {
+          registry[n_registered++] = counter;
+          id = n_registered;
+        }
+      else
+        {
+          g_warning_once ("Too many counters registered, ignoring %s/%s",
+                          counter->category, counter->name);
+          id = G_MAXUINT;
+        }
+
+      g_atomic_int_set (&counter->id, id);
+    }
+
+  g_mutex_unlock (&registry_mutex);
+
+  return id;
+}
+
+/**
+ * ide_counter_add:
+ * @counter: an #IdeCounter
+ * @amount: the amount to add
+ *
+ * Adds @amount to @counter for the current thread.
+ *
+ * This does not take any locks after the first use of @counter on a
+ * given thread and is safe to call from hot paths, even when the
+ * profiler is not recording.
+ *
+ * Since: 50
+ */
+void
+ide_counter_add (IdeCounter *counter,
+                 gint64      amount)
+{
+  CounterSlots *slots;
+  guint id;
+
+  g_return_if_fail (counter != NULL);
+
+  if G_UNLIKELY (!(id = g_atomic_int_get (&counter->id)))
+    id = ide_counter_register (counter);
+
+  if G_UNLIKELY (id > MAX_COUNTERS)
+    return;
+
+  if G_UNLIKELY (!(slots = g_private_get (&slots_key)))
+    slots = counter_slots_new ();
+
+  /* Only this thread writes to the slot, the sampler only reads it */
+  slot_store (&slots->values[id - 1], slots->values[id - 1] + amount);
+}
+
+static gint64
+sum_locked (guint id)
+{
+  gint64 total = retired[id - 1];
+
+  for (const GList *iter = all_slots.head; iter; iter = iter->next)
+    {
+      const CounterSlots *slots = iter->data;
+      total += slot_load (&slots->values[id - 1]);
+    }
+
+  return total;
+}
+
+/**
+ * ide_counter_get:
+ * @counter: an #IdeCounter
+ *
+ * Gets the value of @counter summed across all threads.
+ *
+ * Returns: the current value of @counter
+ *
+ * Since: 50
+ */
+gint64
+ide_counter_get (IdeCounter *counter)
+{
+  gint64 ret = 0;
+  guint id;
+
+  g_return_val_if_fail (counter != NULL, 0);
+
+  id = g_atomic_int_get (&counter->id);
+
+  if (id > 0 && id <= MAX_COUNTERS)
+    {
+      g_mutex_lock (&registry_mutex);
+      ret = sum_locked (id);
+      g_mutex_unlock (&registry_mutex);
+    }
+
+  return ret;
+}
+
+/**
+ * ide_profiler_now:
+ *
+ * Gets the current time in nanoseconds using the same clock that
+ * Sysprof uses for captures.
+ *
+ * Returns: the monotonic time in nanoseconds
+ *
+ * Since: 50
+ */
+gint64
+ide_profiler_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (gint64)ts.tv_sec * G_GINT64_CONSTANT (1000000000) + ts.tv_nsec;
+}
+
+/**
+ * ide_profiler_is_active:
+ *
+ * Checks if a capture is currently being recorded.
+ *
+ * Returns: %TRUE if marks and counters are being recorded
+ *
+ * Since: 50
+ */
+gboolean
+ide_profiler_is_active (void)
+{
+  return g_atomic_int_get (&active);
+}
+
+/**
+ * ide_profiler_mark:
+ * @begin_time_nsec: the start of the span from ide_profiler_now()
+ * @group: the group for the mark
+ * @name: the name of the mark
+ * @message_format: a printf-style format for the message
+ *
+ * Records a mark from @begin_time_nsec until now. Prefer using
+ * IDE_PROFILER_SPAN_END() which avoids formatting the message when
+ * the profiler is not active.
+ *
+ * Since: 50
+ */
+void
+ide_profiler_mark (gint64      begin_time_nsec,
+                   const char *group,
+                   const char *name,
+                   const char *message_format,
+                   ...)
+{
+  const IdeTraceVTable *vtable;
+  g_autofree char *message = NULL;
+  va_list args;
+  gint64 now;
+
+  g_return_if_fail (group != NULL);
+  g_return_if_fail (name != NULL);
+
+  if (!ide_profiler_is_active ())
+    return;
+
+  vtable = _ide_trace_get_vtable ();
+  if (vtable->mark == NULL)
+    return;
+
+  now = ide_profiler_now ();
+
+  va_start (args, message_format);
+  message = g_strdup_vprintf (message_format, args);
+  va_end (args);
+
+  vtable->mark (begin_time_nsec, MAX (0, now - begin_time_nsec), group, name, message);
+}
+
+static void
+ide_profiler_export (const IdeTraceVTable *vtable)
+{
+  guint ids[MAX_COUNTERS];
+  gint64 values[MAX_COUNTERS];
+  IdeCounter *to_define[MAX_COUNTERS];
+  guint first_undefined;
+  guint n_changed = 0;
+  guint n;
+
+  g_mutex_lock (&registry_mutex);
+
+  n = n_registered;
+  first_undefined = n_defined;
+
+  for (guint i = first_undefined; i < n; i++)
+    to_define[i] = registry[i];
+
+  for (guint id = 1; id <= n; id++)
+    {
+      gint64 value = sum_locked (id);
+
+      /* Always send the first value so the counter shows up */
+      if (id > first_undefined || value != exported[id - 1])
+        {
+          ids[n_changed] = id;
+          values[n_changed] = value;
+          exported[id - 1] = value;
+          n_changed++;
+        }
+    }
+
+  g_mutex_unlock (&registry_mutex);
+
+  if (vtable->define_counter != NULL)
+    {
+      for (guint i = first_undefined; i < n; i++)
+        vtable->define_counter (i + 1,
+                                to_define[i]->category,
+                                to_define[i]->name,
+                                to_define[i]->description);
+    }
+
+  n_defined = n;
+
+  if (n_changed > 0 && vtable->set_counters != NULL)
+    vtable->set_counters (ids, values, n_changed);
+}
+
+static gpointer
+ide_profiler_sampler_thread (gpointer data)
+{
+  const IdeTraceVTable *vtable = data;
+
+  g_mutex_lock (&registry_mutex);
+
+  while (!sampler_exit)
+    {
+      gint64 deadline = g_get_monotonic_time () + SAMPLE_INTERVAL_USEC;
+
+      g_cond_wait_until (&sampler_cond, &registry_mutex, deadline);
+
+      g_mutex_unlock (&registry_mutex);
+      ide_profiler_export (vtable);
+      g_mutex_lock (&registry_mutex);
+    }
+
+  g_mutex_unlock (&registry_mutex);
+
+  return NULL;
+}
+
+static int
+ide_profiler_poll (GPollFD *fds,
+                   guint    n_fds,
+                   int      timeout)
+{
+  gint64 enter = ide_profiler_now ();
+  int ret;
+
+  /* Everything between returning from poll() and entering it again is
+   * time spent checking and dispatching sources on the main thread.
+   */
+  if (last_poll_return != 0)
+    {
+      gint64 busy = enter - last_poll_return;
+
+      ide_counter_inc (&main_loop_iterations);
+      ide_counter_add (&main_loop_busy, busy / 1000);
+
+      if (busy >= SLOW_DISPATCH_NSEC)
+        {
+          const IdeTraceVTable *vtable = _ide_trace_get_vtable ();
+
+          if (vtable->mark != NULL)
+            vtable->mark (last_poll_return, busy, "Main Loop", "Dispatch", "");
+        }
+    }
+
+  ret = saved_poll_func (fds, n_fds, timeout);
+
+  last_poll_return = ide_profiler_now ();
+
+  return ret;
+}
+
+/**
+ * ide_profiler_start:
+ * @filename: (nullable): a file to write the capture to, or %NULL
+ *
+ * Starts recording counters and marks.
+ *
+ * If @filename is %NULL, data is sent to the Sysprof instance that
+ * spawned Builder. Otherwise a new capture is written to @filename
+ * which can be opened with Sysprof later.
+ *
+ * This must be called from the main thread.
+ *
+ * Returns: %TRUE if recording started; otherwise %FALSE and @error is set
+ *
+ * Since: 50
+ */
+gboolean
+ide_profiler_start (const char  *filename,
+                    GError     **error)
+{
+  const IdeTraceVTable *vtable;
+
+  g_return_val_if_fail (IDE_IS_MAIN_THREAD (), FALSE);
+
+  if (ide_profiler_is_active ())
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_BUSY,
+                           _("The profiler is already recording"));
+      return FALSE;
+    }
+
+  vtable = _ide_trace_get_vtable ();
+
+  if (vtable->begin_capture == NULL)
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_NOT_SUPPORTED,
+                           _("Builder was compiled without support for Sysprof captures"));
+      return FALSE;
+    }
+
+  if (!vtable->begin_capture (filename, error))
+    return FALSE;
+
+  g_debug ("Recording profiler capture to %s", filename ? filename : "Sysprof");
+
+  n_defined = 0;
+  memset (exported, 0, sizeof exported);
+  sampler_exit = FALSE;
+  sampler = g_thread_new ("[ide-profiler]", ide_profiler_sampler_thread, (gpointer)vtable);
+
+  last_poll_return = 0;
+  saved_poll_func = g_main_context_get_poll_func (NULL);
+  g_main_context_set_poll_func (NULL, ide_profiler_poll);
+
+  g_atomic_int_set (&active, TRUE);
+
+  return TRUE;
+}
+
+/**
+ * ide_profiler_stop:
+ *
+ * Stops a recording started with ide_profiler_start() and flushes
+ * any remaining counter values to the capture.
+ *
+ * Since: 50
+ */
+void
+ide_profiler_stop (void)
+{
+  const IdeTraceVTable *vtable;
+
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+
+  if (!ide_profiler_is_active ())
+    return;
+
+  g_atomic_int_set (&active, FALSE);
+
+  g_main_context_set_poll_func (NULL, saved_poll_func);
+  saved_poll_func = NULL;
+
+  g_mutex_lock (&registry_mutex);
+  sampler_exit = TRUE;
+  g_cond_signal (&sampler_cond);
+  g_mutex_unlock (&registry_mutex);
+
+  g_clear_pointer (&sampler, g_thread_join);
+
+  vtable = _ide_trace_get_vtable ();
+
+  ide_profiler_export (vtable);
+
+  if (vtable->end_capture != NULL)
+    vtable->end_capture ();
+}
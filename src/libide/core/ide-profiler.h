@@ -0,0 +1,113 @@
+/* ide-profiler.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#if !defined (IDE_CORE_INSIDE) && !defined (IDE_CORE_COMPILATION)
+# error "Only <libide-core.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+#include "ide-version-macros.h"
+
+G_BEGIN_DECLS
+
+/**
+ * IdeCounter:
+ * @category: the category shown in the profiler, such as "Completion"
+ * @name: the name of the counter within @category
+ * @description: a short description of what is counted
+ *
+ * A monotonically increasing 64-bit counter which is exported to
+ * Sysprof while the profiler is active.
+ *
+ * Counters must have static storage. Use IDE_DEFINE_COUNTER() to
+ * declare one and ide_counter_add() to increment it from any thread.
+ *
+ * Since: 50
+ */
+typedef struct _IdeCounter
+{
+  const char *category;
+  const char *name;
+  const char *description;
+
+  /*< private >*/
+  guint id;
+} IdeCounter;
+
+#define IDE_DEFINE_COUNTER(Identifier, Category, Name, Description) \
+  static IdeCounter Identifier = { Category, Name, Description, 0 }
+
+IDE_AVAILABLE_IN_50
+void     ide_counter_add        (IdeCounter  *counter,
+                                 gint64       amount);
+IDE_AVAILABLE_IN_50
+gint64   ide_counter_get        (IdeCounter  *counter);
+IDE_AVAILABLE_IN_50
+gboolean ide_profiler_start     (const char  *filename,
+                                 GError     **error);
+IDE_AVAILABLE_IN_50
+void     ide_profiler_stop      (void);
+IDE_AVAILABLE_IN_50
+gboolean ide_profiler_is_active (void);
+IDE_AVAILABLE_IN_50
+gint64   ide_profiler_now       (void);
+IDE_AVAILABLE_IN_50
+void     ide_profiler_mark      (gint64       begin_time_nsec,
+                                 const char  *group,
+                                 const char  *name,
+                                 const char  *message_format,
+                                 ...) G_GNUC_PRINTF (4, 5);
+
+#define ide_counter_inc(c) ide_counter_add(c, 1)
+
+/**
+ * IDE_PROFILER_SPAN_BEGIN:
+ *
+ * Captures the current time for use with IDE_PROFILER_SPAN_END().
+ * This is cheap enough to leave in hot paths; nothing is recorded
+ * unless the profiler is active when the span ends.
+ *
+ * Since: 50
+ */
+#define IDE_PROFILER_SPAN_BEGIN() \
+  (ide_profiler_is_active () ? ide_profiler_now () : 0)
+
+/**
+ * IDE_PROFILER_SPAN_END:
+ * @begin: the value from IDE_PROFILER_SPAN_BEGIN()
+ * @group: the group of the mark, such as "Diagnostics"
+ * @name: the name of the mark
+ * @...: a printf-style message
+ *
+ * Records a mark spanning from @begin until now if the profiler was
+ * active for the entire span.
+ *
+ * Since: 50
+ */
+#define IDE_PROFILER_SPAN_END(begin, group, name, ...)          \
+  G_STMT_START {                                                 \
+    if ((begin) != 0 && ide_profiler_is_active ())               \
+      ide_profiler_mark ((begin), (group), (name), __VA_ARGS__); \
+  } G_STMT_END
+
+G_END_DECLS
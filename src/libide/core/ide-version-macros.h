@@ -47,6 +47,7 @@
 #define IDE_VERSION_47 (G_ENCODE_VERSION (47, 0))
 #define IDE_VERSION_48 (G_ENCODE_VERSION (48, 0))
 #define IDE_VERSION_49 (G_ENCODE_VERSION (49, 0))
+#define IDE_VERSION_50 (G_ENCODE_VERSION (50, 0))
 
 #if IDE_MAJOR_VERSION == IDE_VERSION_43
 # define IDE_VERSION_PREV_STABLE (IDE_VERSION_43)
@@ -188,3 +189,16 @@
 #else
 # define IDE_AVAILABLE_IN_49 _IDE_EXTERN
 #endif
+
+#if IDE_VERSION_MIN_REQUIRED >= IDE_VERSION_50
+# define IDE_DEPRECATED_IN_50 IDE_DEPRECATED
+# define IDE_DEPRECATED_IN_50_FOR(f) IDE_DEPRECATED_FOR(f)
+#else
+# define IDE_DEPRECATED_IN_50 _IDE_EXTERN
+# define IDE_DEPRECATED_IN_50_FOR(f) _IDE_EXTERN
+#endif
+#if IDE_VERSION_MAX_ALLOWED < IDE_VERSION_50
+# define IDE_AVAILABLE_IN_50 IDE_UNAVAILABLE(50, 0)
+#else
+# define IDE_AVAILABLE_IN_50 _IDE_EXTERN
+#endif
@@ -38,6 +38,7 @@
 #include "ide-notifications.h"
 #include "ide-object.h"
 #include "ide-object-box.h"
+#include "ide-profiler.h"
 #include "ide-property-action-group.h"
 #include "ide-settings.h"
 #include "ide-settings-flag-action.h"
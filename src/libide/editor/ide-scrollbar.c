@@ -36,14 +36,18 @@
 #define FALLBACK_WARNING    "#ffaa00"
 #define FALLBACK_DEPRECATED "#8888ff"
 
+/* Ordered by priority, the highest value wins when several runs land
+ * on the same pixel row. Zero means nothing is drawn.
+ */
 typedef enum {
-  LINE_CHANGED,
+  LINE_NONE,
   LINE_ADDED,
+  LINE_CHANGED,
   LINE_DELETED,
+  LINE_DEPRECATED,
+  LINE_WARNING,
   LINE_ERROR,
   LINE_FATAL,
-  LINE_WARNING,
-  LINE_DEPRECATED
 } ChunkType;
 
 typedef struct {
@@ -52,12 +56,28 @@ typedef struct {
   ChunkType line_type;
 } LinesChunk;
 
+/* The overview is kept as a run-length list of lines per source (the
+ * change monitor and diagnostics) which is then binned into one summary
+ * per pixel row. When either source changes, only the rows covering the
+ * lines whose runs differ are recomputed so the cost is proportional to
+ * the number of runs and rows rather than the number of lines.
+ */
+typedef struct {
+  GArray *runs;
+  GArray *rows;
+  guint   dirty_begin;
+  guint   dirty_end;
+} Overview;
+
 struct _IdeScrollbar {
   GtkWidget          parent_instance;
 
   GtkScrollbar      *scrollbar;
 
-  GArray            *chunks;
+  Overview           changes;
+  Overview           diagnostics;
+  guint              n_rows;
+  guint              n_lines;
 
   IdeSourceView     *view;
   IdeBuffer         *buffer;
@@ -87,6 +107,177 @@ enum {
 
 static GParamSpec *properties [N_PROPS];
 
+static void ide_scrollbar_update_changes     (IdeScrollbar *self);
+static void ide_scrollbar_update_diagnostics (IdeScrollbar *self);
+
+static void
+overview_init (Overview *overview)
+{
+  overview->runs = g_array_new (FALSE, FALSE, sizeof (LinesChunk));
+  overview->rows = g_array_new (FALSE, TRUE, sizeof (guint8));
+  overview->dirty_begin = 0;
+  overview->dirty_end = G_MAXUINT;
+}
+
+static void
+overview_clear (Overview *overview)
+{
+  g_clear_pointer (&overview->runs, g_array_unref);
+  g_clear_pointer (&overview->rows, g_array_unref);
+}
+
+static void
+overview_invalidate (Overview *overview,
+                     guint     begin_line,
+                     guint     end_line)
+{
+  if (overview->dirty_begin >= overview->dirty_end)
+    {
+      overview->dirty_begin = begin_line;
+      overview->dirty_end = end_line;
+    }
+  else
+    {
+      overview->dirty_begin = MIN (overview->dirty_begin, begin_line);
+      overview->dirty_end = MAX (overview->dirty_end, end_line);
+    }
+}
+
+static gboolean
+chunk_equal (const LinesChunk *a,
+             const LinesChunk *b)
+{
+  return a->start_line == b->start_line &&
+         a->end_line == b->end_line &&
+         a->line_type == b->line_type;
+}
+
+/* Replaces the runs of @overview, invalidating only the span of lines
+ * between the first and last runs which differ.
+ */
+static void
+overview_take_runs (Overview *overview,
+                    GArray   *runs)
+{
+  GArray *old = overview->runs;
+  guint prefix = 0;
+  guint suffix = 0;
+  guint begin_line = G_MAXUINT;
+  guint end_line = 0;
+
+  while (prefix < old->len &&
+         prefix < runs->len &&
+         chunk_equal (&g_array_index (old, LinesChunk, prefix),
+                      &g_array_index (runs, LinesChunk, prefix)))
+    prefix++;
+
+  while (suffix < old->len - prefix &&
+         suffix < runs->len - prefix &&
+         chunk_equal (&g_array_index (old, LinesChunk, old->len - suffix - 1),
+                      &g_array_index (runs, LinesChunk, runs->len - suffix - 1)))
+    suffix++;
+
+  if (prefix < old->len - suffix)
+    {
+      begin_line = MIN (begin_line, g_array_index (old, LinesChunk, prefix).start_line);
+      end_line = MAX (end_line, g_array_index (old, LinesChunk, old->len - suffix - 1).end_line);
+    }
+
+  if (prefix < runs->len - suffix)
+    {
+      begin_line = MIN (begin_line, g_array_index (runs, LinesChunk, prefix).start_line);
+      end_line = MAX (end_line, g_array_index (runs, LinesChunk, runs->len - suffix - 1).end_line);
+    }
+
+  if (begin_line < end_line)
+    overview_invalidate (overview, begin_line, end_line);
+
+  overview->runs = runs;
+  g_array_unref (old);
+}
+
+static inline guint
+line_to_row (guint  line,
+             guint  n_lines,
+             guint  n_rows)
+{
+  return MIN ((guint64)line * n_rows / MAX (1, n_lines), n_rows);
+}
+
+static inline guint
+line_to_row_end (guint  line,
+                 guint  n_lines,
+                 guint  n_rows)
+{
+  return MIN (((guint64)line * n_rows + MAX (1, n_lines) - 1) / MAX (1, n_lines), n_rows);
+}
+
+static void
+overview_update_rows (Overview *overview,
+                      guint     n_lines,
+                      guint     n_rows)
+{
+  guint8 *rows;
+  guint begin_row;
+  guint end_row;
+  guint lo;
+  guint hi;
+
+  if (overview->rows->len != n_rows)
+    {
+      g_array_set_size (overview->rows, n_rows);
+      overview->dirty_begin = 0;
+      overview->dirty_end = G_MAXUINT;
+    }
+
+  if (overview->dirty_begin >= overview->dirty_end || n_rows == 0)
+    return;
+
+  /* Extend to whole rows since a row may summarize many lines */
+  begin_row = line_to_row (overview->dirty_begin, n_lines, n_rows);
+  end_row = line_to_row_end (MIN (overview->dirty_end, n_lines), n_lines, n_rows);
+  rows = (guint8 *)(gpointer)overview->rows->data;
+
+  memset (&rows[begin_row], 0, end_row - begin_row);
+
+  /* Runs are sorted, so skip straight to the first affecting @begin_row */
+  lo = 0;
+  hi = overview->runs->len;
+  while (lo < hi)
+    {
+      guint mid = (lo + hi) / 2;
+      const LinesChunk *chunk = &g_array_index (overview->runs, LinesChunk, mid);
+
+      if (line_to_row_end (chunk->end_line, n_lines, n_rows) <= begin_row)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  for (guint i = lo; i < overview->runs->len; i++)
+    {
+      const LinesChunk *chunk = &g_array_index (overview->runs, LinesChunk, i);
+      guint first = line_to_row (chunk->start_line, n_lines, n_rows);
+      guint last = line_to_row_end (chunk->end_line, n_lines, n_rows);
+
+      if (first >= end_row)
+        break;
+
+      /* Every run is visible, even if it is less than a row tall */
+      if (last <= first)
+        last = first + 1;
+
+      first = MAX (first, begin_row);
+      last = MIN (last, end_row);
+
+      for (guint row = first; row < last; row++)
+        rows[row] = MAX (rows[row], chunk->line_type);
+    }
+
+  overview->dirty_begin = 0;
+  overview->dirty_end = 0;
+}
+
 static gboolean
 get_style_rgba (GtkSourceStyleScheme *scheme,
                 const gchar          *style_name,
@@ -176,6 +367,9 @@ notify_buffer_cb (GtkTextView *text_view,
                           G_BINDING_SYNC_CREATE);
 
   connect_style_scheme (self);
+
+  ide_scrollbar_update_changes (self);
+  ide_scrollbar_update_diagnostics (self);
 }
 
 static void
@@ -188,7 +382,8 @@ ide_scrollbar_dispose (GObject *object)
   g_clear_object (&self->monitor_signals);
   g_clear_object (&self->buffer_signals);
   g_clear_object (&self->view_signals);
-  g_clear_pointer (&self->chunks, g_array_unref);
+  overview_clear (&self->changes);
+  overview_clear (&self->diagnostics);
 
   g_clear_pointer ((GtkWidget **)&self->scrollbar, gtk_widget_unparent);
 
@@ -258,136 +453,157 @@ snapshot_chunk (IdeScrollbar *self,
 }
 
 static void
-diagnostic_line_cb (guint                 line,
-                    IdeDiagnosticSeverity severity,
-                    gpointer              user_data)
+append_run (GArray    *runs,
+            guint      start_line,
+            guint      end_line,
+            ChunkType  line_type)
 {
-  IdeScrollbar *self = user_data;
-  LinesChunk chunk = {0};
+  LinesChunk chunk = { start_line, end_line, line_type };
+
+  if (runs->len > 0)
+    {
+      LinesChunk *last = &g_array_index (runs, LinesChunk, runs->len - 1);
+
+      if (last->end_line == start_line && last->line_type == line_type)
+        {
+          last->end_line = end_line;
+          return;
+        }
+    }
 
-  chunk.start_line = line;
-  chunk.end_line = line + 1;
+  g_array_append_val (runs, chunk);
+}
+
+static void
+change_run_cb (guint               line_begin,
+               guint               line_end,
+               IdeBufferLineChange change,
+               gpointer            user_data)
+{
+  GArray *runs = user_data;
+
+  if (change & IDE_BUFFER_LINE_CHANGE_DELETED)
+    append_run (runs, line_begin, line_end, LINE_DELETED);
+  else if (change & IDE_BUFFER_LINE_CHANGE_CHANGED)
+    append_run (runs, line_begin, line_end, LINE_CHANGED);
+  else if (change & IDE_BUFFER_LINE_CHANGE_ADDED)
+    append_run (runs, line_begin, line_end, LINE_ADDED);
+}
+
+static void
+diagnostic_run_cb (guint                 begin_line,
+                   guint                 end_line,
+                   IdeDiagnosticSeverity severity,
+                   gpointer              user_data)
+{
+  GArray *runs = user_data;
 
   switch (severity)
     {
     case IDE_DIAGNOSTIC_WARNING:
-      chunk.line_type = LINE_WARNING;
+      append_run (runs, begin_line, end_line, LINE_WARNING);
       break;
 
     case IDE_DIAGNOSTIC_ERROR:
-      chunk.line_type = LINE_ERROR;
+      append_run (runs, begin_line, end_line, LINE_ERROR);
       break;
 
     case IDE_DIAGNOSTIC_FATAL:
-      chunk.line_type = LINE_FATAL;
+      append_run (runs, begin_line, end_line, LINE_FATAL);
       break;
 
     case IDE_DIAGNOSTIC_DEPRECATED:
-      chunk.line_type = LINE_DEPRECATED;
+      append_run (runs, begin_line, end_line, LINE_DEPRECATED);
       break;
 
     case IDE_DIAGNOSTIC_IGNORED:
     case IDE_DIAGNOSTIC_NOTE:
     case IDE_DIAGNOSTIC_UNUSED:
     default:
-      return;
+      break;
     }
-
-  g_array_append_val (self->chunks, chunk);
 }
 
 static void
-ide_scrollbar_update_chunks (IdeScrollbar *self)
+ide_scrollbar_update_changes (IdeScrollbar *self)
 {
+  g_autoptr(GArray) runs = NULL;
   IdeBufferChangeMonitor *monitor;
-  IdeDiagnostics *diagnostics;
-  int total_lines;
+  guint total_lines;
 
-  g_assert (GTK_IS_TEXT_BUFFER (self->buffer));
-  g_assert (self->chunks != NULL);
+  g_assert (IDE_IS_SCROLLBAR (self));
 
-  /* Truncate without freeing allocation */
-  self->chunks->len = 0;
+  if (self->buffer == NULL)
+    return;
 
+  runs = g_array_new (FALSE, FALSE, sizeof (LinesChunk));
   total_lines = gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (self->buffer));
 
-  /* Update lines changes */
   if ((monitor = ide_buffer_get_change_monitor (self->buffer)))
-    {
-      IdeBufferLineChange last_change;
-      int chunk_start_line;
-      gboolean first_line = TRUE;
-      guint line;
+    ide_buffer_change_monitor_foreach_run (monitor, 0, total_lines, change_run_cb, runs);
 
-      for (line = 0; line <= total_lines; line++)
-        {
-          IdeBufferLineChange change;
-
-          if (line == total_lines)
-            change = IDE_BUFFER_LINE_CHANGE_NONE;
-          else
-            change = ide_buffer_change_monitor_get_change (monitor, line);
-
-          if (first_line)
-            {
-              last_change = change;
-              chunk_start_line = line;
-              first_line = FALSE;
-            }
-          else if (change != last_change)
-            {
-              LinesChunk chunk = {0};
-              chunk.start_line = chunk_start_line;
-              chunk.end_line = line + 1;
-
-              switch (last_change)
-                {
-                case IDE_BUFFER_LINE_CHANGE_ADDED:
-                  chunk.line_type = LINE_ADDED;
-                  break;
-
-                case IDE_BUFFER_LINE_CHANGE_CHANGED:
-                  chunk.line_type = LINE_CHANGED;
-                  break;
-
-                case IDE_BUFFER_LINE_CHANGE_DELETED:
-                  chunk.line_type = LINE_DELETED;
-                  break;
-
-                case IDE_BUFFER_LINE_CHANGE_NONE:
-                case IDE_BUFFER_LINE_CHANGE_PREVIOUS_DELETED:
-                default:
-                  last_change = change;
-                  chunk_start_line = line + 1;
-                  continue;
-                }
-
-              g_array_append_val (self->chunks, chunk);
-
-              last_change = change;
-              chunk_start_line = line + 1;
-            }
-        }
-    }
+  overview_take_runs (&self->changes, g_steal_pointer (&runs));
 
-  /* Update diagnostics */
-  if ((diagnostics = ide_buffer_get_diagnostics (IDE_BUFFER (self->buffer))))
-    {
-      GFile *file;
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+static void
+ide_scrollbar_update_diagnostics (IdeScrollbar *self)
+{
+  g_autoptr(GArray) runs = NULL;
+  IdeDiagnostics *diagnostics;
+  GFile *file;
+  guint total_lines;
 
-      file = ide_buffer_get_file (IDE_BUFFER (self->buffer));
+  g_assert (IDE_IS_SCROLLBAR (self));
 
-      ide_diagnostics_foreach_line_in_range (diagnostics,
-                                             file,
-                                             0,
-                                             total_lines,
-                                             diagnostic_line_cb,
-                                             self);
-    }
+  if (self->buffer == NULL)
+    return;
+
+  runs = g_array_new (FALSE, FALSE, sizeof (LinesChunk));
+  total_lines = gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (self->buffer));
+  file = ide_buffer_get_file (self->buffer);
+
+  if ((diagnostics = ide_buffer_get_diagnostics (self->buffer)))
+    ide_diagnostics_foreach_run (diagnostics, file, 0, total_lines, diagnostic_run_cb, runs);
+
+  overview_take_runs (&self->diagnostics, g_steal_pointer (&runs));
 
   gtk_widget_queue_draw (GTK_WIDGET (self));
 }
 
+static void
+snapshot_overview (IdeScrollbar   *self,
+                   const Overview *overview,
+                   double          top_margin,
+                   double          row_height,
+                   double          width,
+                   GtkSnapshot    *snapshot)
+{
+  const guint8 *rows = (const guint8 *)(gconstpointer)overview->rows->data;
+  guint n_rows = overview->rows->len;
+  guint row = 0;
+
+  /* Consecutive rows of the same kind become a single rectangle */
+  while (row < n_rows)
+    {
+      guint end = row + 1;
+
+      while (end < n_rows && rows[end] == rows[row])
+        end++;
+
+      if (rows[row] != LINE_NONE)
+        snapshot_chunk (self,
+                        rows[row],
+                        top_margin + row * row_height,
+                        top_margin + end * row_height,
+                        width,
+                        snapshot);
+
+      row = end;
+    }
+}
+
 static void
 ide_scrollbar_snapshot (GtkWidget  *widget,
                         GtkSnapshot *snapshot)
@@ -405,6 +621,7 @@ ide_scrollbar_snapshot (GtkWidget  *widget,
   int cursor_position;
   int total_lines;
   int cursor_line;
+  guint n_rows;
 
   g_assert (IDE_IS_SCROLLBAR (self));
   g_assert (GTK_IS_SNAPSHOT (snapshot));
@@ -441,20 +658,26 @@ ide_scrollbar_snapshot (GtkWidget  *widget,
                                                       MAX ((int)line_height, 2)));
     }
 
-  /* Draw changes and diagnostics */
-  for (guint i = 0; i < self->chunks->len; i++)
+  /* Draw changes and diagnostics, one summary per pixel row */
+  n_rows = MAX (0, ceil (height - top_margin - bottom_margin));
+
+  if (n_rows != self->n_rows || (guint)total_lines != self->n_lines)
+    {
+      overview_invalidate (&self->changes, 0, G_MAXUINT);
+      overview_invalidate (&self->diagnostics, 0, G_MAXUINT);
+      self->n_rows = n_rows;
+      self->n_lines = total_lines;
+    }
+
+  if (n_rows > 0)
     {
-      const LinesChunk *chunk = &g_array_index (self->chunks, LinesChunk, i);
+      double row_height = (height - top_margin - bottom_margin) / n_rows;
 
-      int chunk_start_y = top_margin + chunk->start_line * line_height;
-      int chunk_end_y   = top_margin + chunk->end_line * line_height;
+      overview_update_rows (&self->changes, total_lines, n_rows);
+      overview_update_rows (&self->diagnostics, total_lines, n_rows);
 
-      snapshot_chunk (self,
-                      chunk->line_type,
-                      chunk_start_y,
-                      chunk_end_y,
-                      width,
-                      snapshot);
+      snapshot_overview (self, &self->changes, top_margin, row_height, width, snapshot);
+      snapshot_overview (self, &self->diagnostics, top_margin, row_height, width, snapshot);
     }
 
   gtk_widget_snapshot_child (GTK_WIDGET (self), GTK_WIDGET (self->scrollbar), snapshot);
@@ -570,13 +793,14 @@ ide_scrollbar_init (IdeScrollbar *self)
 {
   gtk_widget_init_template (GTK_WIDGET (self));
 
-  self->chunks = g_array_new (FALSE, FALSE, sizeof (LinesChunk));
+  overview_init (&self->changes);
+  overview_init (&self->diagnostics);
 
   self->monitor_signals = g_signal_group_new (IDE_TYPE_BUFFER_CHANGE_MONITOR);
 
   g_signal_group_connect_object (self->monitor_signals,
                                  "changed",
-                                 G_CALLBACK (ide_scrollbar_update_chunks),
+                                 G_CALLBACK (ide_scrollbar_update_changes),
                                  self,
                                  G_CONNECT_SWAPPED);
 
@@ -590,7 +814,7 @@ ide_scrollbar_init (IdeScrollbar *self)
 
   g_signal_group_connect_object (self->buffer_signals,
                                  "notify::has-diagnostics",
-                                 G_CALLBACK (ide_scrollbar_update_chunks),
+                                 G_CALLBACK (ide_scrollbar_update_diagnostics),
                                  self,
                                  G_CONNECT_SWAPPED);
 
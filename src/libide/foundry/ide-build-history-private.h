@@ -0,0 +1,56 @@
+/* ide-build-history-private.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "ide-pipeline-phase.h"
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_BUILD_HISTORY (ide_build_history_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeBuildHistory, ide_build_history, IDE, BUILD_HISTORY, GObject)
+
+IdeBuildHistory *ide_build_history_new          (GFile                *file);
+GFile           *ide_build_history_get_file     (IdeBuildHistory      *self);
+void             ide_build_history_load_async   (IdeBuildHistory      *self,
+                                                 GCancellable         *cancellable,
+                                                 GAsyncReadyCallback   callback,
+                                                 gpointer              user_data);
+gboolean         ide_build_history_load_finish  (IdeBuildHistory      *self,
+                                                 GAsyncResult         *result,
+                                                 GError              **error);
+void             ide_build_history_begin        (IdeBuildHistory      *self);
+void             ide_build_history_add_stage    (IdeBuildHistory      *self,
+                                                 const char           *name,
+                                                 IdePipelinePhase      phase,
+                                                 GTimeSpan             duration);
+void             ide_build_history_end          (IdeBuildHistory      *self,
+                                                 gboolean              failed);
+guint            ide_build_history_get_n_builds (IdeBuildHistory      *self);
+GVariant        *ide_build_history_dup_build    (IdeBuildHistory      *self,
+                                                 guint                 position);
+GTimeSpan        ide_build_history_get_baseline (IdeBuildHistory      *self,
+                                                 const char           *stage_name,
+                                                 guint                 n_builds);
+
+G_END_DECLS
@@ -0,0 +1,464 @@
+/* ide-build-history.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "ide-build-history"
+
+#include "config.h"
+
+#include <libide-threading.h>
+
+#include "ide-build-history-private.h"
+
+/* Each build is stored as (begin, duration, failed, stages) where begin
+ * is the wall-clock time in microseconds and stages is an array of
+ * (name, phase, duration) for every stage that was executed.
+ */
+#define BUILD_FORMAT   "(xxba(sut))"
+#define HISTORY_FORMAT "a" BUILD_FORMAT
+#define MAX_BUILDS     50
+
+struct _IdeBuildHistory
+{
+  GObject          parent_instance;
+
+  GFile           *file;
+
+  /* GVariant of BUILD_FORMAT, oldest first */
+  GPtrArray       *builds;
+
+  /* The build currently being recorded */
+  GVariantBuilder *stages;
+  gint64           begin_real_time;
+  gint64           begin_monotonic;
+};
+
+enum {
+  CHANGED,
+  N_SIGNALS
+};
+
+G_DEFINE_FINAL_TYPE (IdeBuildHistory, ide_build_history, G_TYPE_OBJECT)
+
+static guint signals [N_SIGNALS];
+
+static void
+ide_build_history_finalize (GObject *object)
+{
+  IdeBuildHistory *self = (IdeBuildHistory *)object;
+
+  g_clear_pointer (&self->stages, g_variant_builder_unref);
+  g_clear_pointer (&self->builds, g_ptr_array_unref);
+  g_clear_object (&self->file);
+
+  G_OBJECT_CLASS (ide_build_history_parent_class)->finalize (object);
+}
+
+static void
+ide_build_history_class_init (IdeBuildHistoryClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_build_history_finalize;
+
+  /**
+   * IdeBuildHistory::changed:
+   *
+   * The "changed" signal is emitted when the history has been loaded
+   * or a build has been recorded.
+   */
+  signals [CHANGED] =
+    g_signal_new ("changed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE, 0);
+}
+
+static void
+ide_build_history_init (IdeBuildHistory *self)
+{
+  self->builds = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+}
+
+/**
+ * ide_build_history_new:
+ * @file: the file to persist the history to
+ *
+ * Creates a new #IdeBuildHistory which records the duration of every
+ * build and its stages for a single configuration.
+ *
+ * Returns: (transfer full): a new #IdeBuildHistory
+ */
+IdeBuildHistory *
+ide_build_history_new (GFile *file)
+{
+  IdeBuildHistory *self;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  self = g_object_new (IDE_TYPE_BUILD_HISTORY, NULL);
+  self->file = g_object_ref (file);
+
+  return self;
+}
+
+GFile *
+ide_build_history_get_file (IdeBuildHistory *self)
+{
+  g_return_val_if_fail (IDE_IS_BUILD_HISTORY (self), NULL);
+
+  return self->file;
+}
+
+static void
+ide_build_history_load_cb (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  GFile *file = (GFile *)object;
+  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GPtrArray) builds = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GError) error = NULL;
+  IdeBuildHistory *self;
+  GVariantIter iter;
+  GVariant *build;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_FILE (file));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_TASK (task));
+
+  self = ide_task_get_source_object (task);
+
+  if (!(bytes = g_file_load_bytes_finish (file, result, NULL, &error)))
+    {
+      /* No history yet is not an error */
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        ide_task_return_boolean (task, TRUE);
+      else
+        ide_task_return_error (task, g_steal_pointer (&error));
+      IDE_EXIT;
+    }
+
+  variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (HISTORY_FORMAT), bytes, FALSE));
+
+  if (!g_variant_is_normal_form (variant))
+    {
+      ide_task_return_new_error (task,
+                                 G_IO_ERROR,
+                                 G_IO_ERROR_INVALID_DATA,
+                                 "Build history is corrupted");
+      IDE_EXIT;
+    }
+
+  builds = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+
+  g_variant_iter_init (&iter, variant);
+  while ((build = g_variant_iter_next_value (&iter)))
+    g_ptr_array_add (builds, build);
+
+  /* Keep anything recorded while we were loading */
+  g_ptr_array_extend_and_steal (builds, g_steal_pointer (&self->builds));
+  self->builds = g_steal_pointer (&builds);
+
+  if (self->builds->len > MAX_BUILDS)
+    g_ptr_array_remove_range (self->builds, 0, self->builds->len - MAX_BUILDS);
+
+  g_signal_emit (self, signals [CHANGED], 0);
+
+  ide_task_return_boolean (task, TRUE);
+
+  IDE_EXIT;
+}
+
+void
+ide_build_history_load_async (IdeBuildHistory     *self,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+  g_autoptr(IdeTask) task = NULL;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_BUILD_HISTORY (self));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = ide_task_new (self, cancellable, callback, user_data);
+  ide_task_set_source_tag (task, ide_build_history_load_async);
+
+  g_file_load_bytes_async (self->file,
+                           cancellable,
+                           ide_build_history_load_cb,
+                           g_steal_pointer (&task));
+
+  IDE_EXIT;
+}
+
+gboolean
+ide_build_history_load_finish (IdeBuildHistory  *self,
+                               GAsyncResult     *result,
+                               GError          **error)
+{
+  g_return_val_if_fail (IDE_IS_BUILD_HISTORY (self), FALSE);
+  g_return_val_if_fail (IDE_IS_TASK (result), FALSE);
+
+  return ide_task_propagate_boolean (IDE_TASK (result), error);
+}
+
+static void
+ide_build_history_save_worker (IdeTask      *task,
+                               gpointer      source_object,
+                               gpointer      task_data,
+                               GCancellable *cancellable)
+{
+  IdeBuildHistory *self = source_object;
+  GBytes *bytes = task_data;
+  g_autoptr(GFile) parent = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_TASK (task));
+  g_assert (IDE_IS_BUILD_HISTORY (self));
+  g_assert (bytes != NULL);
+
+  parent = g_file_get_parent (self->file);
+
+  if (!g_file_make_directory_with_parents (parent, cancellable, &error) &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+    {
+      ide_task_return_error (task, g_steal_pointer (&error));
+      return;
+    }
+
+  g_clear_error (&error);
+
+  if (!g_file_replace_contents (self->file,
+                                g_bytes_get_data (bytes, NULL),
+                                g_bytes_get_size (bytes),
+                                NULL, FALSE,
+                                G_FILE_CREATE_REPLACE_DESTINATION,
+                                NULL, cancellable, &error))
+    ide_task_return_error (task, g_steal_pointer (&error));
+  else
+    ide_task_return_boolean (task, TRUE);
+}
+
+static void
+ide_build_history_save (IdeBuildHistory *self)
+{
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(IdeTask) task = NULL;
+
+  g_assert (IDE_IS_BUILD_HISTORY (self));
+
+  variant = g_variant_ref_sink (g_variant_new_array (G_VARIANT_TYPE (BUILD_FORMAT),
+                                                     (GVariant **)self->builds->pdata,
+                                                     self->builds->len));
+
+  task = ide_task_new (self, NULL, NULL, NULL);
+  ide_task_set_source_tag (task, ide_build_history_save);
+  ide_task_set_kind (task, IDE_TASK_KIND_IO);
+  ide_task_set_task_data (task, g_variant_get_data_as_bytes (variant), g_bytes_unref);
+  ide_task_run_in_thread (task, ide_build_history_save_worker);
+}
+
+/**
+ * ide_build_history_begin:
+ * @self: a #IdeBuildHistory
+ *
+ * Starts recording a new build. Any build which was not ended is
+ * discarded.
+ */
+void
+ide_build_history_begin (IdeBuildHistory *self)
+{
+  g_return_if_fail (IDE_IS_BUILD_HISTORY (self));
+
+  g_clear_pointer (&self->stages, g_variant_builder_unref);
+
+  self->stages = g_variant_builder_new (G_VARIANT_TYPE ("a(sut)"));
+  self->begin_real_time = g_get_real_time ();
+  self->begin_monotonic = g_get_monotonic_time ();
+}
+
+void
+ide_build_history_add_stage (IdeBuildHistory  *self,
+                             const char       *name,
+                             IdePipelinePhase  phase,
+                             GTimeSpan         duration)
+{
+  g_return_if_fail (IDE_IS_BUILD_HISTORY (self));
+  g_return_if_fail (name != NULL);
+
+  if (self->stages == NULL)
+    return;
+
+  g_variant_builder_add (self->stages, "(sut)", name, phase, (guint64)MAX (0, duration));
+}
+
+/**
+ * ide_build_history_end:
+ * @self: a #IdeBuildHistory
+ * @failed: if the build failed
+ *
+ * Completes the build started with ide_build_history_begin() and saves
+ * the history to disk. Builds which did not execute any stages are not
+ * recorded as they say nothing about how long a build takes.
+ */
+void
+ide_build_history_end (IdeBuildHistory *self,
+                       gboolean         failed)
+{
+  g_autoptr(GVariantBuilder) stages = NULL;
+  g_autoptr(GVariant) stages_variant = NULL;
+  GVariant *build;
+
+  g_return_if_fail (IDE_IS_BUILD_HISTORY (self));
+
+  if (!(stages = g_steal_pointer (&self->stages)))
+    return;
+
+  stages_variant = g_variant_ref_sink (g_variant_builder_end (stages));
+
+  if (g_variant_n_children (stages_variant) == 0)
+    return;
+
+  build = g_variant_new ("(xxb@a(sut))",
+                         self->begin_real_time,
+                         g_get_monotonic_time () - self->begin_monotonic,
+                         !!failed,
+                         stages_variant);
+
+  g_ptr_array_add (self->builds, g_variant_ref_sink (build));
+
+  if (self->builds->len > MAX_BUILDS)
+    g_ptr_array_remove_range (self->builds, 0, self->builds->len - MAX_BUILDS);
+
+  ide_build_history_save (self);
+
+  g_signal_emit (self, signals [CHANGED], 0);
+}
+
+guint
+ide_build_history_get_n_builds (IdeBuildHistory *self)
+{
+  g_return_val_if_fail (IDE_IS_BUILD_HISTORY (self), 0);
+
+  return self->builds->len;
+}
+
+/**
+ * ide_build_history_dup_build:
+ * @self: a #IdeBuildHistory
+ * @position: the number of builds to go back, 0 being the most recent
+ *
+ * Gets a recorded build in the form of `(xxba(sut))` containing the
+ * wall-clock time the build started at, the duration of the build in
+ * microseconds, if the build failed, and the name, phase, and duration
+ * of each executed stage.
+ *
+ * Returns: (transfer full) (nullable): a #GVariant or %NULL
+ */
+GVariant *
+ide_build_history_dup_build (IdeBuildHistory *self,
+                             guint            position)
+{
+  g_return_val_if_fail (IDE_IS_BUILD_HISTORY (self), NULL);
+
+  if (position >= self->builds->len)
+    return NULL;
+
+  return g_variant_ref (g_ptr_array_index (self->builds, self->builds->len - 1 - position));
+}
+
+/**
+ * ide_build_history_get_baseline:
+ * @self: a #IdeBuildHistory
+ * @stage_name: (nullable): the name of a stage or %NULL for the whole build
+ * @n_builds: the number of builds to consider
+ *
+ * Gets the average duration of @stage_name over the @n_builds successful
+ * builds preceding the most recent build. That makes it suitable for
+ * checking whether the most recent build regressed.
+ *
+ * Returns: the average duration in microseconds, or -1 if no previous
+ *   build executed @stage_name
+ */
+GTimeSpan
+ide_build_history_get_baseline (IdeBuildHistory *self,
+                                const char      *stage_name,
+                                guint            n_builds)
+{
+  GTimeSpan total = 0;
+  guint count = 0;
+  guint seen = 0;
+
+  g_return_val_if_fail (IDE_IS_BUILD_HISTORY (self), -1);
+
+  for (guint i = self->builds->len; i > 1 && seen < n_builds; i--)
+    {
+      GVariant *build = g_ptr_array_index (self->builds, i - 2);
+      g_autoptr(GVariantIter) iter = NULL;
+      gint64 begin;
+      gint64 duration;
+      gboolean failed;
+
+      g_variant_get (build, "(xxba(sut))", &begin, &duration, &failed, &iter);
+
+      /* Failed builds stop early and would skew the average */
+      if (failed)
+        continue;
+
+      seen++;
+
+      if (stage_name == NULL)
+        {
+          total += duration;
+          count++;
+          continue;
+        }
+
+      {
+        const char *name;
+        guint phase;
+        guint64 stage_duration;
+
+        while (g_variant_iter_next (iter, "(&sut)", &name, &phase, &stage_duration))
+          {
+            if (g_str_equal (name, stage_name))
+              {
+                total += stage_duration;
+                count++;
+                break;
+              }
+          }
+      }
+    }
+
+  if (count == 0)
+    return -1;
+
+  return total / count;
+}
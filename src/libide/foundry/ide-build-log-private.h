@@ -41,6 +41,12 @@ guint        ide_build_log_add_observer     (IdeBuildLog         *self,
                                              GDestroyNotify       observer_data_destroy);
 gboolean     ide_build_log_remove_observer  (IdeBuildLog         *self,
                                              guint                observer_id);
+void         ide_build_log_set_limits       (IdeBuildLog         *self,
+                                             gsize                max_pending,
+                                             gsize                max_history);
+char       **ide_build_log_search           (IdeBuildLog         *self,
+                                             const char          *needle,
+                                             guint                max_matches);
 
 
 G_END_DECLS
@@ -22,25 +22,59 @@
 
 #include "config.h"
 
+#include <glib/gi18n.h>
 #include <libide-core.h>
 #include <string.h>
 
 #include "ide-build-log.h"
 #include "ide-build-log-private.h"
 
-#define POINTER_MARK(p)   GSIZE_TO_POINTER(GPOINTER_TO_SIZE(p)|1)
-#define POINTER_UNMARK(p) GSIZE_TO_POINTER(GPOINTER_TO_SIZE(p)&~(gsize)1)
-#define POINTER_MARKED(p) (GPOINTER_TO_SIZE(p)&1)
-#define DISPATCH_MAX      20
+/* Output from worker threads is appended to a queue of fixed-size chunks
+ * which the main thread detaches in batches. The pending queue is capped
+ * in bytes: when it is full, writers wait briefly for the main thread to
+ * catch up and then drop the oldest chunks, which are reported to
+ * observers as a single "N lines elided" message.
+ *
+ * Once dispatched, chunks are moved (not copied) into a bounded history
+ * so that the most recent output can be searched later without keeping
+ * the entire log in memory.
+ */
+
+#define CHUNK_SIZE            (64 * 1024)
+#define DEFAULT_MAX_PENDING   (8 * 1024 * 1024)
+#define DEFAULT_MAX_HISTORY   (4 * 1024 * 1024)
+#define DISPATCH_MAX_BYTES    (256 * 1024)
+#define BACKPRESSURE_USEC     (G_USEC_PER_SEC / 200)
+#define RECORD_STDERR         (1U << 31)
+
+typedef struct
+{
+  gsize  capacity;
+  gsize  len;
+  guint  n_lines;
+  guint8 data[];
+} LogChunk;
 
 struct _IdeBuildLog
 {
   GObject      parent_instance;
 
   GArray      *observers;
-  GAsyncQueue *log_queue;
   GSource     *log_source;
 
+  /* Protected by mutex */
+  GMutex       mutex;
+  GCond        cond;
+  GQueue       pending;
+  gsize        pending_bytes;
+  gsize        max_pending;
+  guint        elided;
+
+  /* Main thread only */
+  GQueue       history;
+  gsize        history_bytes;
+  gsize        max_history;
+
   guint        sequence;
 };
 
@@ -54,54 +88,218 @@ typedef struct
 
 G_DEFINE_FINAL_TYPE (IdeBuildLog, ide_build_log, G_TYPE_OBJECT)
 
+static LogChunk *
+log_chunk_new (gsize min_size)
+{
+  gsize capacity = MAX (CHUNK_SIZE, min_size);
+  LogChunk *chunk = g_malloc (sizeof *chunk + capacity);
+
+  chunk->capacity = capacity;
+  chunk->len = 0;
+  chunk->n_lines = 0;
+
+  return chunk;
+}
+
+static inline gsize
+log_record_size (gsize message_len)
+{
+  /* header + message + trailing \0 */
+  return sizeof (guint32) + message_len + 1;
+}
+
+static guint
+count_lines (const gchar *message,
+             gsize        message_len)
+{
+  const gchar *end = message + message_len;
+  guint n_lines = 1;
+
+  /* A trailing newline does not start another line */
+  if (message_len > 0 && end[-1] == '\n')
+    end--;
+
+  while ((message = memchr (message, '\n', end - message)))
+    {
+      n_lines++;
+      message++;
+    }
+
+  return n_lines;
+}
+
+static void
+log_chunk_append (LogChunk          *chunk,
+                  IdeBuildLogStream  stream,
+                  const gchar       *message,
+                  gsize              message_len)
+{
+  guint32 header = MIN (message_len, ~RECORD_STDERR);
+
+  g_assert (chunk->capacity - chunk->len >= log_record_size (message_len));
+
+  if (stream == IDE_BUILD_LOG_STDERR)
+    header |= RECORD_STDERR;
+
+  memcpy (&chunk->data[chunk->len], &header, sizeof header);
+  memcpy (&chunk->data[chunk->len + sizeof header], message, message_len);
+  chunk->data[chunk->len + sizeof header + message_len] = 0;
+  chunk->len += log_record_size (message_len);
+  chunk->n_lines += count_lines (message, message_len);
+}
+
+typedef struct
+{
+  const LogChunk *chunk;
+  gsize           pos;
+} LogChunkIter;
+
+static inline void
+log_chunk_iter_init (LogChunkIter   *iter,
+                     const LogChunk *chunk)
+{
+  iter->chunk = chunk;
+  iter->pos = 0;
+}
+
+static gboolean
+log_chunk_iter_next (LogChunkIter       *iter,
+                     IdeBuildLogStream  *stream,
+                     const gchar       **message,
+                     gsize              *message_len)
+{
+  guint32 header;
+
+  if (iter->pos >= iter->chunk->len)
+    return FALSE;
+
+  memcpy (&header, &iter->chunk->data[iter->pos], sizeof header);
+
+  *stream = (header & RECORD_STDERR) ? IDE_BUILD_LOG_STDERR : IDE_BUILD_LOG_STDOUT;
+  *message_len = header & ~RECORD_STDERR;
+  *message = (const gchar *)&iter->chunk->data[iter->pos + sizeof header];
+
+  iter->pos += log_record_size (*message_len);
+
+  return TRUE;
+}
+
+static void
+ide_build_log_notify_observers (IdeBuildLog       *self,
+                                IdeBuildLogStream  stream,
+                                const gchar       *message,
+                                gsize              message_len)
+{
+  for (guint i = 0; i < self->observers->len; i++)
+    {
+      const Observer *observer = &g_array_index (self->observers, Observer, i);
+
+      observer->callback (stream, message, message_len, observer->data);
+    }
+}
+
+static void
+ide_build_log_trim_history (IdeBuildLog *self)
+{
+  g_assert (IDE_IS_MAIN_THREAD ());
+
+  while (self->history_bytes > self->max_history && self->history.length > 1)
+    {
+      LogChunk *chunk = g_queue_pop_head (&self->history);
+
+      self->history_bytes -= chunk->capacity;
+      g_free (chunk);
+    }
+}
+
+static void
+ide_build_log_push_history (IdeBuildLog *self,
+                            LogChunk    *chunk)
+{
+  g_assert (IDE_IS_MAIN_THREAD ());
+
+  g_queue_push_tail (&self->history, chunk);
+  self->history_bytes += chunk->capacity;
+
+  ide_build_log_trim_history (self);
+}
+
+static void
+ide_build_log_append_history (IdeBuildLog       *self,
+                              IdeBuildLogStream  stream,
+                              const gchar       *message,
+                              gsize              message_len)
+{
+  LogChunk *tail = g_queue_peek_tail (&self->history);
+  gsize needed = log_record_size (message_len);
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+
+  if (tail == NULL || tail->capacity - tail->len < needed)
+    {
+      tail = log_chunk_new (needed);
+      ide_build_log_push_history (self, tail);
+    }
+
+  log_chunk_append (tail, stream, message, message_len);
+}
+
 static gboolean
 emit_log_from_main (gpointer user_data)
 {
   IdeBuildLog *self = user_data;
-  g_autoptr(GPtrArray) ar = g_ptr_array_new ();
-  gpointer item;
+  GQueue batch = G_QUEUE_INIT;
+  gsize batch_bytes = 0;
+  LogChunk *chunk;
+  guint elided;
 
   g_assert (IDE_IS_BUILD_LOG (self));
 
   /*
-   * Pull up to DISPATCH_MAX items from the log queue. We have an upper
-   * bound here so that we don't stall the main loop. Additionally, we
-   * update the ready-time when we run out of items while holding the
-   * async queue lock to synchronize with the caller for further wakeups.
+   * Detach up to DISPATCH_MAX_BYTES worth of chunks from the pending
+   * queue. We have an upper bound here so that we don't stall the main
+   * loop. Additionally, we update the ready-time when we run out of
+   * chunks while holding the lock to synchronize with writers for
+   * further wakeups.
    */
-  g_async_queue_lock (self->log_queue);
-  for (guint i = 0; i < DISPATCH_MAX; i++)
+  g_mutex_lock (&self->mutex);
+  while (batch_bytes < DISPATCH_MAX_BYTES &&
+         (chunk = g_queue_pop_head (&self->pending)))
     {
-      if (NULL == (item = g_async_queue_try_pop_unlocked (self->log_queue)))
-        {
-          g_source_set_ready_time (self->log_source, -1);
-          break;
-        }
-      g_ptr_array_add (ar, item);
+      batch_bytes += chunk->len;
+      g_queue_push_tail (&batch, chunk);
     }
-  g_async_queue_unlock (self->log_queue);
-
-  for (guint i = 0; i < ar->len; i++)
+  self->pending_bytes -= batch_bytes;
+  elided = self->elided;
+  self->elided = 0;
+  if (self->pending.length == 0)
+    g_source_set_ready_time (self->log_source, -1);
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->mutex);
+
+  if (elided > 0)
     {
-      IdeBuildLogStream stream = IDE_BUILD_LOG_STDOUT;
-      gchar *message;
-      gsize message_len;
+      g_autofree gchar *message = NULL;
 
-      item = g_ptr_array_index (ar, i);
-      message = POINTER_UNMARK (item);
-      message_len = strlen (message);
+      message = g_strdup_printf (ngettext ("%u line elided", "%u lines elided", elided), elided);
+      ide_build_log_notify_observers (self, IDE_BUILD_LOG_STDERR, message, strlen (message));
+      ide_build_log_append_history (self, IDE_BUILD_LOG_STDERR, message, strlen (message));
+    }
 
-      if (POINTER_MARKED (item))
-        stream = IDE_BUILD_LOG_STDERR;
+  while ((chunk = g_queue_pop_head (&batch)))
+    {
+      LogChunkIter iter;
+      IdeBuildLogStream stream;
+      const gchar *message;
+      gsize message_len;
 
-      for (guint j = 0; j < self->observers->len; j++)
-        {
-          const Observer *observer = &g_array_index (self->observers, Observer, j);
+      log_chunk_iter_init (&iter, chunk);
 
-          observer->callback (stream, message, message_len, observer->data);
-        }
+      while (log_chunk_iter_next (&iter, &stream, &message, &message_len))
+        ide_build_log_notify_observers (self, stream, message, message_len);
 
-      g_free (message);
+      /* Chunks are immutable once detached, so just move it to history */
+      ide_build_log_push_history (self, chunk);
     }
 
   return G_SOURCE_CONTINUE;
@@ -112,10 +310,15 @@ ide_build_log_finalize (GObject *object)
 {
   IdeBuildLog *self = (IdeBuildLog *)object;
 
-  g_clear_pointer (&self->log_queue, g_async_queue_unref);
   g_clear_pointer (&self->log_source, g_source_destroy);
   g_clear_pointer (&self->observers, g_array_unref);
 
+  g_queue_clear_full (&self->pending, g_free);
+  g_queue_clear_full (&self->history, g_free);
+
+  g_mutex_clear (&self->mutex);
+  g_cond_clear (&self->cond);
+
   G_OBJECT_CLASS (ide_build_log_parent_class)->finalize (object);
 }
 
@@ -132,7 +335,11 @@ ide_build_log_init (IdeBuildLog *self)
 {
   self->observers = g_array_new (FALSE, FALSE, sizeof (Observer));
 
-  self->log_queue = g_async_queue_new ();
+  g_mutex_init (&self->mutex);
+  g_cond_init (&self->cond);
+
+  self->max_pending = DEFAULT_MAX_PENDING;
+  self->max_history = DEFAULT_MAX_HISTORY;
 
   self->log_source = g_timeout_source_new (G_MAXINT);
   g_source_set_priority (self->log_source, G_PRIORITY_LOW);
@@ -148,24 +355,54 @@ ide_build_log_via_main (IdeBuildLog       *self,
                         const gchar       *message,
                         gsize              message_len)
 {
-  gchar *copied = g_strndup (message, message_len);
+  gsize needed = log_record_size (message_len);
+  LogChunk *tail;
 
-  if G_UNLIKELY (stream == IDE_BUILD_LOG_STDERR)
-    copied = POINTER_MARK (copied);
+  g_mutex_lock (&self->mutex);
+
+  if (self->pending_bytes + needed > self->max_pending)
+    {
+      gint64 deadline = g_get_monotonic_time () + BACKPRESSURE_USEC;
+
+      /* Give the main thread a brief chance to drain before we start
+       * throwing away output. This slows down a runaway producer rather
+       * than letting it grow our memory usage without bound.
+       */
+      while (self->pending_bytes + needed > self->max_pending)
+        {
+          if (!g_cond_wait_until (&self->cond, &self->mutex, deadline))
+            break;
+        }
+
+      while (self->pending_bytes + needed > self->max_pending &&
+             (tail = g_queue_pop_head (&self->pending)))
+        {
+          self->pending_bytes -= tail->len;
+          self->elided += tail->n_lines;
+          g_free (tail);
+        }
+    }
+
+  tail = g_queue_peek_tail (&self->pending);
+
+  if (tail == NULL || tail->capacity - tail->len < needed)
+    {
+      tail = log_chunk_new (needed);
+      g_queue_push_tail (&self->pending, tail);
+    }
+
+  log_chunk_append (tail, stream, message, message_len);
+  self->pending_bytes += needed;
 
   /*
-   * Add the log entry to our queue to be dispatched in the main thread.
-   * However, we hold the async queue lock while updating the source ready
-   * time so we are synchronized with the main thread for setting the
-   * ready time. This is needed because the main thread may not dispatch
-   * all available items in a single dispatch (to avoid stalling the
-   * main loop).
+   * We hold the lock while updating the source ready time so we are
+   * synchronized with the main thread for setting the ready time. This
+   * is needed because the main thread may not dispatch all available
+   * chunks in a single dispatch (to avoid stalling the main loop).
    */
-
-  g_async_queue_lock (self->log_queue);
-  g_async_queue_push_unlocked (self->log_queue, copied);
   g_source_set_ready_time (self->log_source, 0);
-  g_async_queue_unlock (self->log_queue);
+
+  g_mutex_unlock (&self->mutex);
 }
 
 void
@@ -185,12 +422,8 @@ ide_build_log_observer (IdeBuildLogStream  stream,
 
   if G_LIKELY (IDE_IS_MAIN_THREAD ())
     {
-      for (guint i = 0; i < self->observers->len; i++)
-        {
-          const Observer *observer = &g_array_index (self->observers, Observer, i);
-
-          observer->callback (stream, message, message_len, observer->data);
-        }
+      ide_build_log_notify_observers (self, stream, message, message_len);
+      ide_build_log_append_history (self, stream, message, message_len);
     }
   else
     {
@@ -245,3 +478,98 @@ ide_build_log_new (void)
 {
   return g_object_new (IDE_TYPE_BUILD_LOG, NULL);
 }
+
+/**
+ * ide_build_log_set_limits:
+ * @self: a #IdeBuildLog
+ * @max_pending: the max number of bytes queued for the main thread
+ * @max_history: the max number of bytes retained for searching
+ *
+ * Sets the memory limits for the build log. Zero for either value
+ * keeps the current setting.
+ */
+void
+ide_build_log_set_limits (IdeBuildLog *self,
+                          gsize        max_pending,
+                          gsize        max_history)
+{
+  g_return_if_fail (IDE_IS_BUILD_LOG (self));
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+
+  if (max_pending > 0)
+    {
+      g_mutex_lock (&self->mutex);
+      self->max_pending = MAX (max_pending, CHUNK_SIZE);
+      g_mutex_unlock (&self->mutex);
+    }
+
+  if (max_history > 0)
+    {
+      self->max_history = MAX (max_history, CHUNK_SIZE);
+      ide_build_log_trim_history (self);
+    }
+}
+
+/**
+ * ide_build_log_search:
+ * @self: a #IdeBuildLog
+ * @needle: the text to search for
+ * @max_matches: the max number of lines to return, or 0 for unlimited
+ *
+ * Searches the retained history for lines containing @needle. Only the
+ * matching lines are copied, newest last.
+ *
+ * Returns: (transfer full): a %NULL-terminated array of lines
+ */
+char **
+ide_build_log_search (IdeBuildLog *self,
+                      const char  *needle,
+                      guint        max_matches)
+{
+  g_autoptr(GStrvBuilder) builder = NULL;
+  g_autoptr(GQueue) matches = NULL;
+  gsize needle_len;
+
+  g_return_val_if_fail (IDE_IS_BUILD_LOG (self), NULL);
+  g_return_val_if_fail (IDE_IS_MAIN_THREAD (), NULL);
+  g_return_val_if_fail (needle != NULL, NULL);
+
+  builder = g_strv_builder_new ();
+  matches = g_queue_new ();
+  needle_len = strlen (needle);
+
+  /* Walk newest to oldest so we can stop early with @max_matches */
+  for (const GList *link = self->history.tail; link; link = link->prev)
+    {
+      const LogChunk *chunk = link->data;
+      g_autoptr(GPtrArray) chunk_matches = g_ptr_array_new ();
+      LogChunkIter iter;
+      IdeBuildLogStream stream;
+      const gchar *message;
+      gsize message_len;
+
+      log_chunk_iter_init (&iter, chunk);
+
+      while (log_chunk_iter_next (&iter, &stream, &message, &message_len))
+        {
+          if (message_len >= needle_len && strstr (message, needle) != NULL)
+            g_ptr_array_add (chunk_matches, (gpointer)message);
+        }
+
+      for (guint i = chunk_matches->len; i > 0; i--)
+        {
+          if (max_matches > 0 && matches->length >= max_matches)
+            break;
+
+          g_queue_push_head (matches, g_ptr_array_index (chunk_matches, i - 1));
+        }
+
+      if (max_matches > 0 && matches->length >= max_matches)
+        break;
+    }
+
+  for (const GList *link = matches->head; link; link = link->next)
+    g_strv_builder_add (builder, link->data);
+
+  return g_strv_builder_end (builder);
+}
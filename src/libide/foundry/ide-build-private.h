@@ -22,6 +22,7 @@
 
 #include <vte/vte.h>
 
+#include "ide-build-history-private.h"
 #include "ide-foundry-types.h"
 
 G_BEGIN_DECLS
@@ -43,5 +44,6 @@ void    _ide_pipeline_check_toolchain       (IdePipeline     *self,
 void    _ide_pipeline_set_pty_size          (IdePipeline     *self,
                                              guint            rows,
                                              guint            columns);
+IdeBuildHistory *_ide_pipeline_get_history (IdePipeline *self);
 
 G_END_DECLS
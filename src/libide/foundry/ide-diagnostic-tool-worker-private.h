@@ -0,0 +1,46 @@
+/* ide-diagnostic-tool-worker-private.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <libide-threading.h>
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_DIAGNOSTIC_TOOL_WORKER (ide_diagnostic_tool_worker_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeDiagnosticToolWorker, ide_diagnostic_tool_worker, IDE, DIAGNOSTIC_TOOL_WORKER, GObject)
+
+IdeDiagnosticToolWorker *ide_diagnostic_tool_worker_new            (IdeSubprocess            *subprocess);
+gboolean                 ide_diagnostic_tool_worker_is_alive       (IdeDiagnosticToolWorker  *self);
+gboolean                 ide_diagnostic_tool_worker_is_busy        (IdeDiagnosticToolWorker  *self);
+void                     ide_diagnostic_tool_worker_stop           (IdeDiagnosticToolWorker  *self);
+void                     ide_diagnostic_tool_worker_request_async  (IdeDiagnosticToolWorker  *self,
+                                                                    const char               *path,
+                                                                    const char               *language_id,
+                                                                    GBytes                   *body,
+                                                                    GCancellable             *cancellable,
+                                                                    GAsyncReadyCallback       callback,
+                                                                    gpointer                  user_data);
+char                    *ide_diagnostic_tool_worker_request_finish (IdeDiagnosticToolWorker  *self,
+                                                                    GAsyncResult             *result,
+                                                                    GError                  **error);
+
+G_END_DECLS
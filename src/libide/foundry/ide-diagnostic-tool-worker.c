@@ -0,0 +1,482 @@
+/* ide-diagnostic-tool-worker.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "ide-diagnostic-tool-worker"
+
+#include "config.h"
+
+#include "ide-diagnostic-tool-worker-private.h"
+
+/* A worker is a long-running diagnostic tool process which is sent one
+ * request at a time over stdin and replies on stdout. Both directions
+ * use "Content-Length" framing similar to the Language Server Protocol.
+ *
+ *   Content-Length: 1234\r\n
+ *   X-Path: /path/to/file.js\r\n
+ *   X-Language: js\r\n
+ *   \r\n
+ *   <contents of the file>
+ *
+ * The reply body is handed to populate_diagnostics() as if it were the
+ * standard output of a one-shot process. Tools which provide a server
+ * mode with a different protocol can be adapted with a small wrapper.
+ */
+
+#define MAX_REPLY_SIZE (64 * 1024 * 1024)
+
+struct _IdeDiagnosticToolWorker
+{
+  GObject           parent_instance;
+
+  IdeSubprocess    *subprocess;
+  GOutputStream    *stdin_stream;
+  GDataInputStream *stdout_stream;
+
+  /* Requests waiting for the worker, IdeTask */
+  GQueue            pending;
+
+  /* The request currently written to the worker */
+  IdeTask          *active;
+  gsize             reply_length;
+  char             *reply;
+
+  guint             has_reply_length : 1;
+  guint             dead : 1;
+};
+
+G_DEFINE_FINAL_TYPE (IdeDiagnosticToolWorker, ide_diagnostic_tool_worker, G_TYPE_OBJECT)
+
+static void ide_diagnostic_tool_worker_pump (IdeDiagnosticToolWorker *self);
+
+static void
+ide_diagnostic_tool_worker_fail (IdeDiagnosticToolWorker *self,
+                                 const GError            *error)
+{
+  IdeTask *task;
+
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL_WORKER (self));
+  g_assert (error != NULL);
+
+  if (!self->dead)
+    {
+      g_debug ("Diagnostic worker %s failed: %s",
+               ide_subprocess_get_identifier (self->subprocess),
+               error->message);
+
+      self->dead = TRUE;
+      ide_subprocess_force_exit (self->subprocess);
+    }
+
+  if (self->active != NULL)
+    {
+      task = g_steal_pointer (&self->active);
+      ide_task_return_error (task, g_error_copy (error));
+      g_object_unref (task);
+    }
+
+  while ((task = g_queue_pop_head (&self->pending)))
+    {
+      ide_task_return_error (task, g_error_copy (error));
+      g_object_unref (task);
+    }
+}
+
+static void
+ide_diagnostic_tool_worker_wait_cb (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  IdeSubprocess *subprocess = (IdeSubprocess *)object;
+  g_autoptr(IdeDiagnosticToolWorker) self = user_data;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_SUBPROCESS (subprocess));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL_WORKER (self));
+
+  if (!ide_subprocess_wait_finish (subprocess, result, &error))
+    g_clear_error (&error);
+
+  g_set_error_literal (&error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_BROKEN_PIPE,
+                       "Diagnostic worker exited");
+  ide_diagnostic_tool_worker_fail (self, error);
+}
+
+static void
+ide_diagnostic_tool_worker_read_body_cb (GObject      *object,
+                                         GAsyncResult *result,
+                                         gpointer      user_data)
+{
+  GInputStream *stream = (GInputStream *)object;
+  g_autoptr(IdeDiagnosticToolWorker) self = user_data;
+  g_autoptr(IdeTask) task = NULL;
+  g_autoptr(GError) error = NULL;
+  gsize n_read = 0;
+
+  g_assert (G_IS_INPUT_STREAM (stream));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL_WORKER (self));
+
+  if (!g_input_stream_read_all_finish (stream, result, &n_read, &error))
+    {
+      g_clear_pointer (&self->reply, g_free);
+      ide_diagnostic_tool_worker_fail (self, error);
+      return;
+    }
+
+  if (self->dead)
+    {
+      g_clear_pointer (&self->reply, g_free);
+      return;
+    }
+
+  if (n_read != self->reply_length)
+    {
+      g_clear_pointer (&self->reply, g_free);
+      g_set_error_literal (&error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_PARTIAL_INPUT,
+                           "Short reply from diagnostic worker");
+      ide_diagnostic_tool_worker_fail (self, error);
+      return;
+    }
+
+  self->reply[n_read] = 0;
+  self->has_reply_length = FALSE;
+
+  task = g_steal_pointer (&self->active);
+  ide_task_return_pointer (task, g_steal_pointer (&self->reply), g_free);
+
+  ide_diagnostic_tool_worker_pump (self);
+}
+
+static void
+ide_diagnostic_tool_worker_read_line_cb (GObject      *object,
+                                         GAsyncResult *result,
+                                         gpointer      user_data)
+{
+  GDataInputStream *stream = (GDataInputStream *)object;
+  g_autoptr(IdeDiagnosticToolWorker) self = user_data;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *line = NULL;
+  gsize len = 0;
+
+  g_assert (G_IS_DATA_INPUT_STREAM (stream));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL_WORKER (self));
+
+  if (!(line = g_data_input_stream_read_line_finish_utf8 (stream, result, &len, &error)))
+    {
+      if (error == NULL)
+        g_set_error_literal (&error,
+                             G_IO_ERROR,
+                             G_IO_ERROR_CLOSED,
+                             "Diagnostic worker closed stdout");
+      ide_diagnostic_tool_worker_fail (self, error);
+      return;
+    }
+
+  if (self->dead)
+    return;
+
+  if (len > 0 && line[len-1] == '\r')
+    line[--len] = 0;
+
+  if (len == 0)
+    {
+      if (!self->has_reply_length)
+        {
+          g_set_error_literal (&error,
+                               G_IO_ERROR,
+                               G_IO_ERROR_INVALID_DATA,
+                               "Diagnostic worker reply is missing Content-Length");
+          ide_diagnostic_tool_worker_fail (self, error);
+          return;
+        }
+
+      self->reply = g_malloc (self->reply_length + 1);
+      g_input_stream_read_all_async (G_INPUT_STREAM (stream),
+                                     self->reply,
+                                     self->reply_length,
+                                     G_PRIORITY_DEFAULT,
+                                     NULL,
+                                     ide_diagnostic_tool_worker_read_body_cb,
+                                     g_object_ref (self));
+      return;
+    }
+
+  if (g_ascii_strncasecmp (line, "Content-Length:", 15) == 0)
+    {
+      guint64 length = g_ascii_strtoull (line + 15, NULL, 10);
+
+      if (length > MAX_REPLY_SIZE)
+        {
+          g_set_error_literal (&error,
+                               G_IO_ERROR,
+                               G_IO_ERROR_MESSAGE_TOO_LARGE,
+                               "Diagnostic worker reply is too large");
+          ide_diagnostic_tool_worker_fail (self, error);
+          return;
+        }
+
+      self->reply_length = length;
+      self->has_reply_length = TRUE;
+    }
+
+  g_data_input_stream_read_line_async (stream,
+                                       G_PRIORITY_DEFAULT,
+                                       NULL,
+                                       ide_diagnostic_tool_worker_read_line_cb,
+                                       g_object_ref (self));
+}
+
+static void
+ide_diagnostic_tool_worker_write_cb (GObject      *object,
+                                     GAsyncResult *result,
+                                     gpointer      user_data)
+{
+  GOutputStream *stream = (GOutputStream *)object;
+  g_autoptr(IdeDiagnosticToolWorker) self = user_data;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (G_IS_OUTPUT_STREAM (stream));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL_WORKER (self));
+
+  if (!g_output_stream_write_all_finish (stream, result, NULL, &error))
+    {
+      ide_diagnostic_tool_worker_fail (self, error);
+      return;
+    }
+
+  if (self->dead)
+    return;
+
+  g_data_input_stream_read_line_async (self->stdout_stream,
+                                       G_PRIORITY_DEFAULT,
+                                       NULL,
+                                       ide_diagnostic_tool_worker_read_line_cb,
+                                       g_object_ref (self));
+}
+
+static void
+ide_diagnostic_tool_worker_pump (IdeDiagnosticToolWorker *self)
+{
+  GBytes *frame;
+
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL_WORKER (self));
+
+  if (self->dead || self->active != NULL)
+    return;
+
+  /* Skip requests cancelled while waiting, they already returned */
+  while (self->pending.length > 0)
+    {
+      IdeTask *task = g_queue_peek_head (&self->pending);
+      GCancellable *cancellable = ide_task_get_cancellable (task);
+
+      if (!g_cancellable_is_cancelled (cancellable))
+        break;
+
+      g_object_unref (g_queue_pop_head (&self->pending));
+    }
+
+  if (self->pending.length == 0)
+    return;
+
+  self->active = g_queue_pop_head (&self->pending);
+  frame = ide_task_get_task_data (self->active);
+
+  /* Requests are not cancelled once written; the reply must still be
+   * read to keep the stream in sync. The task itself already returned
+   * to the caller if it was cancelled.
+   */
+  g_output_stream_write_all_async (self->stdin_stream,
+                                   g_bytes_get_data (frame, NULL),
+                                   g_bytes_get_size (frame),
+                                   G_PRIORITY_DEFAULT,
+                                   NULL,
+                                   ide_diagnostic_tool_worker_write_cb,
+                                   g_object_ref (self));
+}
+
+static void
+ide_diagnostic_tool_worker_dispose (GObject *object)
+{
+  IdeDiagnosticToolWorker *self = (IdeDiagnosticToolWorker *)object;
+
+  if (!self->dead)
+    ide_diagnostic_tool_worker_stop (self);
+
+  G_OBJECT_CLASS (ide_diagnostic_tool_worker_parent_class)->dispose (object);
+}
+
+static void
+ide_diagnostic_tool_worker_finalize (GObject *object)
+{
+  IdeDiagnosticToolWorker *self = (IdeDiagnosticToolWorker *)object;
+
+  g_assert (self->active == NULL);
+  g_assert (self->pending.length == 0);
+
+  g_clear_object (&self->subprocess);
+  g_clear_object (&self->stdin_stream);
+  g_clear_object (&self->stdout_stream);
+  g_clear_pointer (&self->reply, g_free);
+
+  G_OBJECT_CLASS (ide_diagnostic_tool_worker_parent_class)->finalize (object);
+}
+
+static void
+ide_diagnostic_tool_worker_class_init (IdeDiagnosticToolWorkerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = ide_diagnostic_tool_worker_dispose;
+  object_class->finalize = ide_diagnostic_tool_worker_finalize;
+}
+
+static void
+ide_diagnostic_tool_worker_init (IdeDiagnosticToolWorker *self)
+{
+}
+
+/**
+ * ide_diagnostic_tool_worker_new:
+ * @subprocess: an #IdeSubprocess with stdin and stdout pipes
+ *
+ * Creates a new worker speaking to @subprocess.
+ *
+ * Returns: (transfer full): an #IdeDiagnosticToolWorker
+ */
+IdeDiagnosticToolWorker *
+ide_diagnostic_tool_worker_new (IdeSubprocess *subprocess)
+{
+  IdeDiagnosticToolWorker *self;
+
+  g_return_val_if_fail (IDE_IS_SUBPROCESS (subprocess), NULL);
+  g_return_val_if_fail (ide_subprocess_get_stdin_pipe (subprocess) != NULL, NULL);
+  g_return_val_if_fail (ide_subprocess_get_stdout_pipe (subprocess) != NULL, NULL);
+
+  self = g_object_new (IDE_TYPE_DIAGNOSTIC_TOOL_WORKER, NULL);
+  self->subprocess = g_object_ref (subprocess);
+  self->stdin_stream = g_object_ref (ide_subprocess_get_stdin_pipe (subprocess));
+  self->stdout_stream = g_data_input_stream_new (ide_subprocess_get_stdout_pipe (subprocess));
+  g_data_input_stream_set_newline_type (self->stdout_stream, G_DATA_STREAM_NEWLINE_TYPE_LF);
+
+  ide_subprocess_wait_async (subprocess,
+                             NULL,
+                             ide_diagnostic_tool_worker_wait_cb,
+                             g_object_ref (self));
+
+  return self;
+}
+
+gboolean
+ide_diagnostic_tool_worker_is_alive (IdeDiagnosticToolWorker *self)
+{
+  g_return_val_if_fail (IDE_IS_DIAGNOSTIC_TOOL_WORKER (self), FALSE);
+
+  return !self->dead;
+}
+
+gboolean
+ide_diagnostic_tool_worker_is_busy (IdeDiagnosticToolWorker *self)
+{
+  g_return_val_if_fail (IDE_IS_DIAGNOSTIC_TOOL_WORKER (self), FALSE);
+
+  return self->active != NULL || self->pending.length > 0;
+}
+
+void
+ide_diagnostic_tool_worker_stop (IdeDiagnosticToolWorker *self)
+{
+  g_autoptr(GError) error = NULL;
+
+  g_return_if_fail (IDE_IS_DIAGNOSTIC_TOOL_WORKER (self));
+
+  g_set_error_literal (&error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_CANCELLED,
+                       "Diagnostic worker stopped");
+  ide_diagnostic_tool_worker_fail (self, error);
+}
+
+void
+ide_diagnostic_tool_worker_request_async (IdeDiagnosticToolWorker *self,
+                                          const char              *path,
+                                          const char              *language_id,
+                                          GBytes                  *body,
+                                          GCancellable            *cancellable,
+                                          GAsyncReadyCallback      callback,
+                                          gpointer                 user_data)
+{
+  g_autoptr(IdeTask) task = NULL;
+  GString *frame;
+  gsize body_len;
+
+  g_return_if_fail (IDE_IS_DIAGNOSTIC_TOOL_WORKER (self));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = ide_task_new (self, cancellable, callback, user_data);
+  ide_task_set_source_tag (task, ide_diagnostic_tool_worker_request_async);
+  ide_task_set_return_on_cancel (task, TRUE);
+
+  if (self->dead)
+    {
+      ide_task_return_new_error (task,
+                                 G_IO_ERROR,
+                                 G_IO_ERROR_BROKEN_PIPE,
+                                 "Diagnostic worker is not running");
+      return;
+    }
+
+  body_len = body ? g_bytes_get_size (body) : 0;
+
+  frame = g_string_sized_new (body_len + 128);
+  g_string_append_printf (frame, "Content-Length: %"G_GSIZE_FORMAT"\r\n", body_len);
+  if (path != NULL)
+    g_string_append_printf (frame, "X-Path: %s\r\n", path);
+  if (language_id != NULL)
+    g_string_append_printf (frame, "X-Language: %s\r\n", language_id);
+  g_string_append (frame, "\r\n");
+  if (body_len > 0)
+    g_string_append_len (frame, g_bytes_get_data (body, NULL), body_len);
+
+  ide_task_set_task_data (task,
+                          g_string_free_to_bytes (frame),
+                          g_bytes_unref);
+
+  g_queue_push_tail (&self->pending, g_steal_pointer (&task));
+  ide_diagnostic_tool_worker_pump (self);
+}
+
+char *
+ide_diagnostic_tool_worker_request_finish (IdeDiagnosticToolWorker  *self,
+                                           GAsyncResult             *result,
+                                           GError                  **error)
+{
+  g_return_val_if_fail (IDE_IS_DIAGNOSTIC_TOOL_WORKER (self), NULL);
+  g_return_val_if_fail (IDE_IS_TASK (result), NULL);
+
+  return ide_task_propagate_pointer (IDE_TASK (result), error);
+}
@@ -22,16 +22,33 @@
 
 #include "config.h"
 
+#include <string.h>
+
+#include <glib/gstdio.h>
+
 #include <libide-threading.h>
 
 #include "ide-build-manager.h"
 #include "ide-diagnostic-tool.h"
+#include "ide-diagnostic-tool-worker-private.h"
 #include "ide-pipeline.h"
 #include "ide-run-context.h"
 #include "ide-runtime.h"
 #include "ide-runtime-manager.h"
 
 #define DEFAULT_FLAGS (G_SUBPROCESS_FLAGS_STDIN_PIPE|G_SUBPROCESS_FLAGS_STDOUT_PIPE|G_SUBPROCESS_FLAGS_STDERR_PIPE)
+#define WORKER_FLAGS  (G_SUBPROCESS_FLAGS_STDIN_PIPE|G_SUBPROCESS_FLAGS_STDOUT_PIPE|G_SUBPROCESS_FLAGS_STDERR_SILENCE)
+
+/* Results are cached by a hash of the command line, the contents sent
+ * to the tool and the modification time of the configuration files the
+ * tools we know about read, so that reopening or reverting a file, or the
+ * same contents in another buffer, do not need to run the tool again.
+ * Entries stored on disk expire after a day in case a tool reads some
+ * other configuration.
+ */
+#define RESULT_CACHE_MAX_SIZE    (8 * 1024 * 1024)
+#define RESULT_CACHE_MAX_AGE_SEC (60 * 60 * 24)
+#define WORKER_IDLE_TIMEOUT_SEC  (60 * 5)
 
 typedef struct
 {
@@ -43,10 +60,50 @@ typedef struct
 
 typedef struct
 {
-  GBytes *stdin_bytes;
-  GFile  *file;
+  GBytes                *stdin_bytes;
+  GFile                 *file;
+  char                  *language_id;
+  char                  *cache_key;
+  GFile                 *cache_file;
+  IdeSubprocessLauncher *launcher;
+  gint64                 begin_time;
 } DiagnoseState;
 
+/* Shared by every instance of a tool type since instances are created
+ * per-buffer by the diagnostics manager.
+ */
+typedef struct
+{
+  GHashTable *workers;
+  GQueue      waiting;
+  guint       running;
+  guint       max_waiting;
+  guint       idle_source;
+  guint64     spawns;
+  guint64     worker_spawns;
+  guint64     worker_requests;
+  guint64     cache_hits;
+  guint64     cache_misses;
+  guint64     completed;
+  guint64     total_latency_usec;
+  guint64     max_latency_usec;
+} ToolState;
+
+typedef struct
+{
+  IdeDiagnosticToolWorker *worker;
+  gint64                   last_used;
+} WorkerEntry;
+
+typedef struct
+{
+  GList  link;
+  char  *key;
+  char  *stdout_buf;
+  char  *stderr_buf;
+  gsize  size;
+} CacheEntry;
+
 static void diagnostic_provider_iface_init (IdeDiagnosticProviderInterface *iface);
 
 G_DEFINE_ABSTRACT_TYPE_WITH_CODE (IdeDiagnosticTool, ide_diagnostic_tool, IDE_TYPE_OBJECT,
@@ -64,6 +121,16 @@ enum {
 };
 
 static GParamSpec *properties [N_PROPS];
+static GHashTable *tool_states;
+static GHashTable *result_cache;
+static GQueue      result_cache_lru;
+static gsize       result_cache_size;
+
+IDE_DEFINE_COUNTER (tool_spawns, "Diagnostics", "Tool Spawns", "Number of diagnostic tool processes spawned");
+IDE_DEFINE_COUNTER (tool_cache_hits, "Diagnostics", "Tool Cache Hits", "Diagnostic tool runs avoided by the result cache");
+IDE_DEFINE_COUNTER (tool_worker_requests, "Diagnostics", "Tool Worker Requests", "Requests sent to persistent diagnostic tool workers");
+
+static gboolean ide_diagnostic_tool_spawn (IdeTask *task);
 
 static void
 diagnose_state_free (DiagnoseState *state)
@@ -73,12 +140,450 @@ diagnose_state_free (DiagnoseState *state)
   g_assert (state != NULL);
 
   g_clear_pointer (&state->stdin_bytes, g_bytes_unref);
+  g_clear_pointer (&state->language_id, g_free);
+  g_clear_pointer (&state->cache_key, g_free);
+  g_clear_object (&state->cache_file);
+  g_clear_object (&state->launcher);
   g_clear_object (&state->file);
   g_slice_free (DiagnoseState, state);
 
   IDE_EXIT;
 }
 
+static void
+worker_entry_free (gpointer data)
+{
+  WorkerEntry *entry = data;
+
+  ide_diagnostic_tool_worker_stop (entry->worker);
+  g_clear_object (&entry->worker);
+  g_free (entry);
+}
+
+static ToolState *
+tool_state_get (GType type)
+{
+  ToolState *state;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+
+  if (tool_states == NULL)
+    tool_states = g_hash_table_new (NULL, NULL);
+
+  if (!(state = g_hash_table_lookup (tool_states, GSIZE_TO_POINTER (type))))
+    {
+      state = g_new0 (ToolState, 1);
+      state->workers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, worker_entry_free);
+      g_hash_table_insert (tool_states, GSIZE_TO_POINTER (type), state);
+    }
+
+  return state;
+}
+
+static guint
+tool_state_max_running (void)
+{
+  static guint max_running;
+
+  if (max_running == 0)
+    max_running = CLAMP (g_get_num_processors () / 2, 1, 4);
+
+  return max_running;
+}
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+  g_clear_pointer (&entry->key, g_free);
+  g_clear_pointer (&entry->stdout_buf, g_free);
+  g_clear_pointer (&entry->stderr_buf, g_free);
+  g_free (entry);
+}
+
+static const CacheEntry *
+result_cache_lookup (const char *key)
+{
+  CacheEntry *entry;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+
+  if (result_cache == NULL ||
+      !(entry = g_hash_table_lookup (result_cache, key)))
+    return NULL;
+
+  g_queue_unlink (&result_cache_lru, &entry->link);
+  g_queue_push_head_link (&result_cache_lru, &entry->link);
+
+  return entry;
+}
+
+static void
+result_cache_insert (const char *key,
+                     const char *stdout_buf,
+                     const char *stderr_buf)
+{
+  CacheEntry *entry;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (key != NULL);
+
+  if (result_cache == NULL)
+    result_cache = g_hash_table_new (g_str_hash, g_str_equal);
+
+  if (g_hash_table_contains (result_cache, key))
+    return;
+
+  entry = g_new0 (CacheEntry, 1);
+  entry->link.data = entry;
+  entry->key = g_strdup (key);
+  entry->stdout_buf = g_strdup (stdout_buf);
+  entry->stderr_buf = g_strdup (stderr_buf);
+  entry->size = strlen (key)
+              + (stdout_buf ? strlen (stdout_buf) : 0)
+              + (stderr_buf ? strlen (stderr_buf) : 0)
+              + sizeof *entry;
+
+  g_hash_table_insert (result_cache, entry->key, entry);
+  g_queue_push_head_link (&result_cache_lru, &entry->link);
+  result_cache_size += entry->size;
+
+  while (result_cache_size > RESULT_CACHE_MAX_SIZE && result_cache_lru.length > 1)
+    {
+      GList *link = g_queue_pop_tail_link (&result_cache_lru);
+      CacheEntry *old = link->data;
+
+      result_cache_size -= old->size;
+      g_hash_table_remove (result_cache, old->key);
+      cache_entry_free (old);
+    }
+}
+
+/* Configuration files read by the tools we have plugins for */
+static const char * const config_file_names[] = {
+  ".codespellrc",
+  ".eslintrc",
+  ".eslintrc.cjs",
+  ".eslintrc.js",
+  ".eslintrc.json",
+  ".eslintrc.yaml",
+  ".eslintrc.yml",
+  ".flake8",
+  ".hadolint.yaml",
+  ".hadolint.yml",
+  ".rstcheck.cfg",
+  ".rubocop.yml",
+  ".ruff.toml",
+  ".shellcheckrc",
+  ".stylelintrc",
+  ".stylelintrc.js",
+  ".stylelintrc.json",
+  ".stylelintrc.yaml",
+  ".stylelintrc.yml",
+  ".swiftlint.yml",
+  "eslint.config.cjs",
+  "eslint.config.js",
+  "eslint.config.mjs",
+  "package.json",
+  "pyproject.toml",
+  "ruff.toml",
+  "setup.cfg",
+  "stylelint.config.js",
+  "tox.ini",
+};
+
+static void
+add_config_mtimes (GChecksum  *checksum,
+                   GFile      *file,
+                   const char *cwd)
+{
+  g_autoptr(GFile) top = NULL;
+  GFile *dir;
+
+  g_assert (checksum != NULL);
+  g_assert (!file || G_IS_FILE (file));
+
+  if (file == NULL || !g_file_is_native (file))
+    return;
+
+  top = cwd ? g_file_new_for_path (cwd) : NULL;
+  dir = g_file_get_parent (file);
+
+  /* Tools look for their configuration from the directory of the file
+   * up to the root of the project.
+   */
+  while (dir != NULL)
+    {
+      const char *path = g_file_peek_path (dir);
+      GFile *parent;
+
+      for (guint i = 0; i < G_N_ELEMENTS (config_file_names); i++)
+        {
+          g_autofree char *filename = g_build_filename (path, config_file_names[i], NULL);
+          GStatBuf st;
+
+          if (g_stat (filename, &st) == 0)
+            {
+              gint64 mtime = st.st_mtime;
+              gint64 size = st.st_size;
+
+              g_checksum_update (checksum, (const guchar *)filename, strlen (filename) + 1);
+              g_checksum_update (checksum, (const guchar *)&mtime, sizeof mtime);
+              g_checksum_update (checksum, (const guchar *)&size, sizeof size);
+            }
+        }
+
+      if (top == NULL || g_file_equal (dir, top) || !g_file_has_prefix (dir, top))
+        break;
+
+      parent = g_file_get_parent (dir);
+      g_object_unref (dir);
+      dir = parent;
+    }
+
+  g_clear_object (&dir);
+}
+
+typedef struct
+{
+  GChecksum *checksum;
+  GFile     *file;
+  char      *cwd;
+  GBytes    *stdin_bytes;
+} CacheKey;
+
+static void
+cache_key_free (CacheKey *key)
+{
+  g_clear_pointer (&key->checksum, g_checksum_free);
+  g_clear_object (&key->file);
+  g_clear_pointer (&key->cwd, g_free);
+  g_clear_pointer (&key->stdin_bytes, g_bytes_unref);
+  g_free (key);
+}
+
+static void
+ide_diagnostic_tool_cache_key_worker (IdeTask      *task,
+                                      gpointer      source_object,
+                                      gpointer      task_data,
+                                      GCancellable *cancellable)
+{
+  CacheKey *key = task_data;
+
+  g_assert (IDE_IS_TASK (task));
+  g_assert (key != NULL);
+
+  /* Looking for configuration files needs a lot of stat() calls, and
+   * the contents may be large, so do not block the main thread.
+   */
+  add_config_mtimes (key->checksum, key->file, key->cwd);
+
+  g_checksum_update (key->checksum,
+                     g_bytes_get_data (key->stdin_bytes, NULL),
+                     g_bytes_get_size (key->stdin_bytes));
+
+  ide_task_return_pointer (task,
+                           g_strdup (g_checksum_get_string (key->checksum)),
+                           g_free);
+}
+
+static void
+ide_diagnostic_tool_compute_cache_key_async (IdeDiagnosticTool     *self,
+                                             IdeSubprocessLauncher *launcher,
+                                             GFile                 *file,
+                                             const char            *language_id,
+                                             GBytes                *stdin_bytes,
+                                             GCancellable          *cancellable,
+                                             GAsyncReadyCallback    callback,
+                                             gpointer               user_data)
+{
+  g_autoptr(IdeTask) task = NULL;
+  g_autoptr(GChecksum) checksum = NULL;
+  const char * const *argv;
+  const char *cwd;
+  CacheKey *key;
+
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL (self));
+  g_assert (IDE_IS_SUBPROCESS_LAUNCHER (launcher));
+  g_assert (stdin_bytes != NULL);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+#define ADD_STRING(s) \
+  g_checksum_update (checksum, (const guchar *)((s) ? (s) : ""), strlen ((s) ? (s) : "") + 1)
+
+  ADD_STRING (G_OBJECT_TYPE_NAME (self));
+  ADD_STRING (language_id);
+  ADD_STRING (file ? g_file_peek_path (file) : NULL);
+
+  if ((cwd = ide_subprocess_launcher_get_cwd (launcher)))
+    ADD_STRING (cwd);
+
+  if ((argv = ide_subprocess_launcher_get_argv (launcher)))
+    {
+      for (guint i = 0; argv[i]; i++)
+        ADD_STRING (argv[i]);
+    }
+
+#undef ADD_STRING
+
+  key = g_new0 (CacheKey, 1);
+  key->checksum = g_steal_pointer (&checksum);
+  key->file = file ? g_object_ref (file) : NULL;
+  key->cwd = g_strdup (cwd);
+  key->stdin_bytes = g_bytes_ref (stdin_bytes);
+
+  task = ide_task_new (self, cancellable, callback, user_data);
+  ide_task_set_source_tag (task, ide_diagnostic_tool_compute_cache_key_async);
+  ide_task_set_kind (task, IDE_TASK_KIND_IO);
+  ide_task_set_task_data (task, key, cache_key_free);
+  ide_task_run_in_thread (task, ide_diagnostic_tool_cache_key_worker);
+}
+
+static char *
+ide_diagnostic_tool_compute_cache_key_finish (IdeDiagnosticTool  *self,
+                                              GAsyncResult       *result,
+                                              GError            **error)
+{
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL (self));
+  g_assert (IDE_IS_TASK (result));
+
+  return ide_task_propagate_pointer (IDE_TASK (result), error);
+}
+
+typedef struct
+{
+  GFile  *root;
+  GFile  *file;
+  GBytes *bytes;
+} StoreResult;
+
+static void
+store_result_free (StoreResult *store)
+{
+  g_clear_object (&store->root);
+  g_clear_object (&store->file);
+  g_clear_pointer (&store->bytes, g_bytes_unref);
+  g_free (store);
+}
+
+static void
+ide_diagnostic_tool_expire_results (GFile *directory,
+                                    gint64 expire_before)
+{
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  gpointer infoptr;
+
+  g_assert (G_IS_FILE (directory));
+
+  if (!(enumerator = g_file_enumerate_children (directory,
+                                                G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                                G_FILE_ATTRIBUTE_STANDARD_TYPE","
+                                                G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                NULL, NULL)))
+    return;
+
+  while ((infoptr = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+    {
+      g_autoptr(GFileInfo) info = infoptr;
+      g_autoptr(GFile) child = g_file_enumerator_get_child (enumerator, info);
+
+      if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        ide_diagnostic_tool_expire_results (child, expire_before);
+      else if (g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) < expire_before)
+        g_file_delete (child, NULL, NULL);
+    }
+}
+
+static void
+ide_diagnostic_tool_store_worker (IdeTask      *task,
+                                  gpointer      source_object,
+                                  gpointer      task_data,
+                                  GCancellable *cancellable)
+{
+  static gsize expired;
+  StoreResult *store = task_data;
+  g_autoptr(GFile) parent = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_TASK (task));
+  g_assert (store != NULL);
+  g_assert (G_IS_FILE (store->file));
+
+  /* Drop stale results once per session so the directory stays bounded */
+  if (g_once_init_enter (&expired))
+    {
+      gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+
+      ide_diagnostic_tool_expire_results (store->root, now - RESULT_CACHE_MAX_AGE_SEC);
+      g_once_init_leave (&expired, TRUE);
+    }
+
+  parent = g_file_get_parent (store->file);
+
+  if (!g_file_make_directory_with_parents (parent, NULL, &error) &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+    {
+      g_debug ("Failed to create %s: %s", g_file_peek_path (parent), error->message);
+      ide_task_return_boolean (task, FALSE);
+      return;
+    }
+
+  g_clear_error (&error);
+
+  if (!g_file_replace_contents (store->file,
+                                g_bytes_get_data (store->bytes, NULL),
+                                g_bytes_get_size (store->bytes),
+                                NULL, FALSE,
+                                G_FILE_CREATE_REPLACE_DESTINATION,
+                                NULL, NULL, &error))
+    g_debug ("Failed to store diagnostic result: %s", error->message);
+
+  ide_task_return_boolean (task, TRUE);
+}
+
+static void
+ide_diagnostic_tool_store_result (IdeDiagnosticTool *self,
+                                  DiagnoseState     *state,
+                                  const char        *stdout_buf,
+                                  const char        *stderr_buf)
+{
+  g_autoptr(IdeContext) context = NULL;
+  g_autoptr(IdeTask) task = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  g_autofree char *root = NULL;
+  StoreResult *store;
+
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL (self));
+  g_assert (state != NULL);
+
+  if (state->cache_key == NULL)
+    return;
+
+  result_cache_insert (state->cache_key, stdout_buf, stderr_buf);
+
+  if (state->cache_file == NULL ||
+      !(context = ide_object_ref_context (IDE_OBJECT (self))))
+    return;
+
+  variant = g_variant_ref_sink (g_variant_new ("(xss)",
+                                               g_get_real_time () / G_USEC_PER_SEC,
+                                               stdout_buf ? stdout_buf : "",
+                                               stderr_buf ? stderr_buf : ""));
+  root = ide_context_cache_filename (context, "diagnostics", NULL);
+
+  store = g_new0 (StoreResult, 1);
+  store->root = g_file_new_for_path (root);
+  store->file = g_object_ref (state->cache_file);
+  store->bytes = g_variant_get_data_as_bytes (variant);
+
+  task = ide_task_new (self, NULL, NULL, NULL);
+  ide_task_set_source_tag (task, ide_diagnostic_tool_store_result);
+  ide_task_set_kind (task, IDE_TASK_KIND_IO);
+  ide_task_set_task_data (task, store, store_result_free);
+  ide_task_run_in_thread (task, ide_diagnostic_tool_store_worker);
+}
+
 static GBytes *
 ide_diagnostic_tool_real_get_stdin_bytes (IdeDiagnosticTool *self,
                                           GFile             *file,
@@ -385,13 +890,77 @@ ide_diagnostic_tool_init (IdeDiagnosticTool *self)
   priv->flags = DEFAULT_FLAGS;
 }
 
+static void
+ide_diagnostic_tool_complete (IdeTask    *task,
+                              const char *stdout_buf,
+                              const char *stderr_buf,
+                              gboolean    from_cache)
+{
+  g_autoptr(IdeDiagnostics) diagnostics = NULL;
+  IdeDiagnosticTool *self;
+  DiagnoseState *state;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_TASK (task));
+
+  self = ide_task_get_source_object (task);
+  state = ide_task_get_task_data (task);
+
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL (self));
+  g_assert (state != NULL);
+
+  if (!from_cache)
+    {
+      ToolState *tool_state = tool_state_get (G_OBJECT_TYPE (self));
+      guint64 latency = g_get_monotonic_time () - state->begin_time;
+
+      tool_state->completed++;
+      tool_state->total_latency_usec += latency;
+      tool_state->max_latency_usec = MAX (tool_state->max_latency_usec, latency);
+
+      ide_diagnostic_tool_store_result (self, state, stdout_buf, stderr_buf);
+    }
+
+  diagnostics = ide_diagnostics_new ();
+
+  if (IDE_DIAGNOSTIC_TOOL_GET_CLASS (self)->populate_diagnostics)
+    IDE_DIAGNOSTIC_TOOL_GET_CLASS (self)->populate_diagnostics (self, diagnostics, state->file, stdout_buf, stderr_buf);
+
+  ide_task_return_object (task, g_steal_pointer (&diagnostics));
+
+  IDE_EXIT;
+}
+
+static void
+ide_diagnostic_tool_release (GType type)
+{
+  ToolState *tool_state = tool_state_get (type);
+  IdeTask *task;
+
+  g_assert (tool_state->running > 0);
+
+  tool_state->running--;
+
+  /* Keep going until a process was started, otherwise a failure to
+   * spawn would leave the remaining requests waiting forever.
+   */
+  while ((task = g_queue_pop_head (&tool_state->waiting)))
+    {
+      g_autoptr(IdeTask) owned = task;
+
+      if (!ide_task_return_error_if_cancelled (task) &&
+          ide_diagnostic_tool_spawn (task))
+        break;
+    }
+}
+
 static void
 ide_diagnostic_tool_communicate_cb (GObject      *object,
                                     GAsyncResult *result,
                                     gpointer      user_data)
 {
   IdeSubprocess *subprocess = (IdeSubprocess *)object;
-  g_autoptr(IdeDiagnostics) diagnostics = NULL;
   g_autoptr(IdeTask) task = user_data;
   g_autoptr(GError) error = NULL;
   g_autofree char *stdout_buf = NULL;
@@ -416,6 +985,8 @@ ide_diagnostic_tool_communicate_cb (GObject      *object,
   IDE_TRACE_MSG ("Completing diagnose of %s",
                  G_OBJECT_TYPE_NAME (self));
 
+  ide_diagnostic_tool_release (G_OBJECT_TYPE (self));
+
   if (!ide_subprocess_communicate_utf8_finish (subprocess, result, &stdout_buf, &stderr_buf, &error))
     {
       g_assert (error != NULL);
@@ -423,12 +994,360 @@ ide_diagnostic_tool_communicate_cb (GObject      *object,
       IDE_EXIT;
     }
 
-  diagnostics = ide_diagnostics_new ();
+  ide_diagnostic_tool_complete (task, stdout_buf, stderr_buf, FALSE);
 
-  if (IDE_DIAGNOSTIC_TOOL_GET_CLASS (self)->populate_diagnostics)
-    IDE_DIAGNOSTIC_TOOL_GET_CLASS (self)->populate_diagnostics (self, diagnostics, state->file, stdout_buf, stderr_buf);
+  IDE_EXIT;
+}
 
-  ide_task_return_object (task, g_steal_pointer (&diagnostics));
+/* Returns %TRUE if a process was started or the request was queued */
+static gboolean
+ide_diagnostic_tool_spawn (IdeTask *task)
+{
+  g_autoptr(IdeSubprocess) subprocess = NULL;
+  g_autoptr(GError) error = NULL;
+  IdeDiagnosticTool *self;
+  DiagnoseState *state;
+  ToolState *tool_state;
+  const char *stdin_data;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_TASK (task));
+
+  self = ide_task_get_source_object (task);
+  state = ide_task_get_task_data (task);
+  tool_state = tool_state_get (G_OBJECT_TYPE (self));
+
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL (self));
+  g_assert (state != NULL);
+  g_assert (IDE_IS_SUBPROCESS_LAUNCHER (state->launcher));
+
+  /* Saving many files at once (or a project wide search and replace)
+   * must not fork a process per buffer all at the same time.
+   */
+  if (tool_state->running >= tool_state_max_running ())
+    {
+      /* Return to the caller as soon as it cancels rather than when the
+       * request would have been dequeued.
+       */
+      ide_task_set_return_on_cancel (task, TRUE);
+      g_queue_push_tail (&tool_state->waiting, g_object_ref (task));
+      tool_state->max_waiting = MAX (tool_state->max_waiting, tool_state->waiting.length);
+      IDE_RETURN (TRUE);
+    }
+
+  if (!(subprocess = ide_subprocess_launcher_spawn (state->launcher, ide_task_get_cancellable (task), &error)))
+    {
+      g_assert (error != NULL);
+
+      ide_task_return_error (task, g_steal_pointer (&error));
+      IDE_RETURN (FALSE);
+    }
+
+  tool_state->running++;
+  tool_state->spawns++;
+  ide_counter_inc (&tool_spawns);
+
+  if (state->stdin_bytes != NULL)
+    stdin_data = (char *)g_bytes_get_data (state->stdin_bytes, NULL);
+  else
+    stdin_data = NULL;
+
+  ide_subprocess_communicate_utf8_async (subprocess,
+                                         stdin_data,
+                                         ide_task_get_cancellable (task),
+                                         ide_diagnostic_tool_communicate_cb,
+                                         g_object_ref (task));
+
+  IDE_RETURN (TRUE);
+}
+
+
+static gboolean
+ide_diagnostic_tool_reap_workers (gpointer data)
+{
+  ToolState *tool_state = data;
+  GHashTableIter iter;
+  WorkerEntry *entry;
+  gint64 now = g_get_monotonic_time ();
+
+  g_assert (tool_state != NULL);
+
+  g_hash_table_iter_init (&iter, tool_state->workers);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry))
+    {
+      if (!ide_diagnostic_tool_worker_is_alive (entry->worker) ||
+          (!ide_diagnostic_tool_worker_is_busy (entry->worker) &&
+           now - entry->last_used > WORKER_IDLE_TIMEOUT_SEC * G_USEC_PER_SEC))
+        g_hash_table_iter_remove (&iter);
+    }
+
+  if (g_hash_table_size (tool_state->workers) == 0)
+    {
+      tool_state->idle_source = 0;
+      return G_SOURCE_REMOVE;
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Subclasses opt into a persistent worker by implementing
+ * prepare_worker_run_context() to add the arguments which start the tool
+ * in worker mode. See ide-diagnostic-tool-worker.c for the protocol.
+ */
+static IdeDiagnosticToolWorker *
+ide_diagnostic_tool_ensure_worker (IdeDiagnosticTool  *self,
+                                   GError            **error)
+{
+  g_autoptr(IdeSubprocessLauncher) launcher = NULL;
+  g_autoptr(IdeRunContext) run_context = NULL;
+  g_autoptr(IdeSubprocess) subprocess = NULL;
+  const char * const *argv;
+  ToolState *tool_state;
+  WorkerEntry *entry;
+  GString *key;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL (self));
+  g_assert (IDE_DIAGNOSTIC_TOOL_GET_CLASS (self)->prepare_worker_run_context != NULL);
+
+  run_context = ide_run_context_new ();
+
+  if (!ide_diagnostic_tool_real_prepare_run_context (self, run_context, NULL, NULL, NULL, error) ||
+      !IDE_DIAGNOSTIC_TOOL_GET_CLASS (self)->prepare_worker_run_context (self, run_context, error) ||
+      !(launcher = ide_run_context_end (run_context, error)))
+    IDE_RETURN (NULL);
+
+  /* Workers are shared by every buffer using the same command line */
+  key = g_string_new (ide_subprocess_launcher_get_cwd (launcher));
+  if ((argv = ide_subprocess_launcher_get_argv (launcher)))
+    {
+      for (guint i = 0; argv[i]; i++)
+        {
+          g_string_append_c (key, '\x1f');
+          g_string_append (key, argv[i]);
+        }
+    }
+
+  tool_state = tool_state_get (G_OBJECT_TYPE (self));
+
+  if ((entry = g_hash_table_lookup (tool_state->workers, key->str)) &&
+      ide_diagnostic_tool_worker_is_alive (entry->worker))
+    {
+      g_string_free (key, TRUE);
+      entry->last_used = g_get_monotonic_time ();
+      IDE_RETURN (entry->worker);
+    }
+
+  ide_subprocess_launcher_set_flags (launcher, WORKER_FLAGS);
+
+  if (!(subprocess = ide_subprocess_launcher_spawn (launcher, NULL, error)))
+    {
+      g_string_free (key, TRUE);
+      IDE_RETURN (NULL);
+    }
+
+  tool_state->worker_spawns++;
+  ide_counter_inc (&tool_spawns);
+
+  entry = g_new0 (WorkerEntry, 1);
+  entry->worker = ide_diagnostic_tool_worker_new (subprocess);
+  entry->last_used = g_get_monotonic_time ();
+  g_hash_table_replace (tool_state->workers, g_string_free (key, FALSE), entry);
+
+  if (tool_state->idle_source == 0)
+    tool_state->idle_source = g_timeout_add_seconds (60, ide_diagnostic_tool_reap_workers, tool_state);
+
+  IDE_RETURN (entry->worker);
+}
+
+static void
+ide_diagnostic_tool_worker_request_cb (GObject      *object,
+                                       GAsyncResult *result,
+                                       gpointer      user_data)
+{
+  IdeDiagnosticToolWorker *worker = (IdeDiagnosticToolWorker *)object;
+  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *reply = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL_WORKER (worker));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_TASK (task));
+
+  if (!(reply = ide_diagnostic_tool_worker_request_finish (worker, result, &error)))
+    {
+      if (ide_task_return_error_if_cancelled (task))
+        IDE_EXIT;
+
+      /* Fallback to running the tool once, the worker will be
+       * replaced the next time it is needed.
+       */
+      g_debug ("Diagnostic worker failed, spawning instead: %s", error->message);
+      ide_diagnostic_tool_spawn (task);
+      IDE_EXIT;
+    }
+
+  ide_diagnostic_tool_complete (task, reply, NULL, FALSE);
+
+  IDE_EXIT;
+}
+
+static void
+ide_diagnostic_tool_run (IdeTask *task)
+{
+  IdeDiagnosticToolWorker *worker;
+  g_autoptr(GError) error = NULL;
+  IdeDiagnosticTool *self;
+  DiagnoseState *state;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_TASK (task));
+
+  self = ide_task_get_source_object (task);
+  state = ide_task_get_task_data (task);
+
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL (self));
+  g_assert (state != NULL);
+
+  /* Workers are only sent the contents of the buffer */
+  if (IDE_DIAGNOSTIC_TOOL_GET_CLASS (self)->prepare_worker_run_context == NULL ||
+      state->stdin_bytes == NULL)
+    {
+      ide_diagnostic_tool_spawn (task);
+      IDE_EXIT;
+    }
+
+  if (!(worker = ide_diagnostic_tool_ensure_worker (self, &error)))
+    {
+      g_debug ("Failed to start diagnostic worker for %s: %s",
+               G_OBJECT_TYPE_NAME (self), error->message);
+      ide_diagnostic_tool_spawn (task);
+      IDE_EXIT;
+    }
+
+  tool_state_get (G_OBJECT_TYPE (self))->worker_requests++;
+  ide_counter_inc (&tool_worker_requests);
+
+  ide_diagnostic_tool_worker_request_async (worker,
+                                            state->file ? g_file_peek_path (state->file) : NULL,
+                                            state->language_id,
+                                            state->stdin_bytes,
+                                            ide_task_get_cancellable (task),
+                                            ide_diagnostic_tool_worker_request_cb,
+                                            g_object_ref (task));
+
+  IDE_EXIT;
+}
+
+
+static void
+ide_diagnostic_tool_load_cached_cb (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  GFile *file = (GFile *)object;
+  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  IdeDiagnosticTool *self;
+  DiagnoseState *state;
+  const char *stdout_buf;
+  const char *stderr_buf;
+  gint64 stored_at;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_FILE (file));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_TASK (task));
+
+  self = ide_task_get_source_object (task);
+  state = ide_task_get_task_data (task);
+
+  if (ide_task_return_error_if_cancelled (task))
+    IDE_EXIT;
+
+  if (!(bytes = g_file_load_bytes_finish (file, result, NULL, NULL)))
+    IDE_GOTO (miss);
+
+  variant = g_variant_new_from_bytes (G_VARIANT_TYPE ("(xss)"), bytes, FALSE);
+  if (!g_variant_is_normal_form (variant))
+    IDE_GOTO (miss);
+
+  g_variant_get (variant, "(x&s&s)", &stored_at, &stdout_buf, &stderr_buf);
+  if (stored_at + RESULT_CACHE_MAX_AGE_SEC < g_get_real_time () / G_USEC_PER_SEC)
+    IDE_GOTO (miss);
+
+  tool_state_get (G_OBJECT_TYPE (self))->cache_hits++;
+  ide_counter_inc (&tool_cache_hits);
+
+  result_cache_insert (state->cache_key, stdout_buf, stderr_buf);
+  ide_diagnostic_tool_complete (task, stdout_buf, stderr_buf, TRUE);
+
+  IDE_EXIT;
+
+miss:
+  tool_state_get (G_OBJECT_TYPE (self))->cache_misses++;
+  ide_diagnostic_tool_run (task);
+
+  IDE_EXIT;
+}
+
+static void
+ide_diagnostic_tool_compute_cache_key_cb (GObject      *object,
+                                          GAsyncResult *result,
+                                          gpointer      user_data)
+{
+  IdeDiagnosticTool *self = (IdeDiagnosticTool *)object;
+  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(IdeContext) context = NULL;
+  g_autoptr(GError) error = NULL;
+  const CacheEntry *cached;
+  DiagnoseState *state;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_DIAGNOSTIC_TOOL (self));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_TASK (task));
+
+  state = ide_task_get_task_data (task);
+
+  if (!(state->cache_key = ide_diagnostic_tool_compute_cache_key_finish (self, result, &error)))
+    {
+      ide_task_return_error (task, g_steal_pointer (&error));
+      IDE_EXIT;
+    }
+
+  if ((cached = result_cache_lookup (state->cache_key)))
+    {
+      IDE_TRACE_MSG ("Using cached result for %s", G_OBJECT_TYPE_NAME (self));
+      tool_state_get (G_OBJECT_TYPE (self))->cache_hits++;
+      ide_counter_inc (&tool_cache_hits);
+      ide_diagnostic_tool_complete (task, cached->stdout_buf, cached->stderr_buf, TRUE);
+      IDE_EXIT;
+    }
+
+  if ((context = ide_object_ref_context (IDE_OBJECT (self))))
+    {
+      char prefix[3] = { state->cache_key[0], state->cache_key[1], 0 };
+      g_autofree char *path = ide_context_cache_filename (context, "diagnostics", prefix, state->cache_key, NULL);
+
+      state->cache_file = g_file_new_for_path (path);
+      g_file_load_bytes_async (state->cache_file,
+                               ide_task_get_cancellable (task),
+                               ide_diagnostic_tool_load_cached_cb,
+                               g_steal_pointer (&task));
+      IDE_EXIT;
+    }
+
+  tool_state_get (G_OBJECT_TYPE (self))->cache_misses++;
+  ide_diagnostic_tool_run (task);
 
   IDE_EXIT;
 }
@@ -444,13 +1363,10 @@ ide_diagnostic_tool_diagnose_async (IdeDiagnosticProvider *provider,
 {
   IdeDiagnosticTool *self = (IdeDiagnosticTool *)provider;
   IdeDiagnosticToolPrivate *priv = ide_diagnostic_tool_get_instance_private (self);
-  g_autoptr(IdeSubprocessLauncher) launcher = NULL;
   g_autoptr(IdeRunContext) run_context = NULL;
-  g_autoptr(IdeSubprocess) subprocess = NULL;
   g_autoptr(IdeTask) task = NULL;
   g_autoptr(GError) error = NULL;
   DiagnoseState *state;
-  const char *stdin_data;
 
   IDE_ENTRY;
 
@@ -475,7 +1391,9 @@ ide_diagnostic_tool_diagnose_async (IdeDiagnosticProvider *provider,
 
   state = g_slice_new0 (DiagnoseState);
   state->file = file ? g_object_ref (file) : NULL;
+  state->language_id = g_strdup (lang_id);
   state->stdin_bytes = IDE_DIAGNOSTIC_TOOL_GET_CLASS (self)->get_stdin_bytes (self, file, contents, lang_id);
+  state->begin_time = g_get_monotonic_time ();
   ide_task_set_task_data (task, state, diagnose_state_free);
 
   if (priv->program_name == NULL)
@@ -490,7 +1408,7 @@ ide_diagnostic_tool_diagnose_async (IdeDiagnosticProvider *provider,
   run_context = ide_run_context_new ();
 
   if (!IDE_DIAGNOSTIC_TOOL_GET_CLASS (self)->prepare_run_context (self, run_context, file, contents, lang_id, &error) ||
-      !(launcher = ide_run_context_end (run_context, &error)))
+      !(state->launcher = ide_run_context_end (run_context, &error)))
     {
       g_assert (error != NULL);
 
@@ -498,26 +1416,25 @@ ide_diagnostic_tool_diagnose_async (IdeDiagnosticProvider *provider,
       IDE_EXIT;
     }
 
-  ide_subprocess_launcher_set_flags (launcher, priv->flags);
+  ide_subprocess_launcher_set_flags (state->launcher, priv->flags);
 
-  if (!(subprocess = ide_subprocess_launcher_spawn (launcher, cancellable, &error)))
+  /* Only results for contents we sent to the tool can be cached, tools
+   * reading the file from disk may see something else.
+   */
+  if (state->stdin_bytes == NULL)
     {
-      g_assert (error != NULL);
-
-      ide_task_return_error (task, g_steal_pointer (&error));
+      ide_diagnostic_tool_run (task);
       IDE_EXIT;
     }
 
-  if (state->stdin_bytes != NULL)
-    stdin_data = (char *)g_bytes_get_data (state->stdin_bytes, NULL);
-  else
-    stdin_data = NULL;
-
-  ide_subprocess_communicate_utf8_async (subprocess,
-                                         stdin_data,
-                                         cancellable,
-                                         ide_diagnostic_tool_communicate_cb,
-                                         g_steal_pointer (&task));
+  ide_diagnostic_tool_compute_cache_key_async (self,
+                                               state->launcher,
+                                               file,
+                                               lang_id,
+                                               state->stdin_bytes,
+                                               cancellable,
+                                               ide_diagnostic_tool_compute_cache_key_cb,
+                                               g_steal_pointer (&task));
 
   IDE_EXIT;
 }
@@ -642,3 +1559,45 @@ ide_diagnostic_tool_set_subprocess_flags (IdeDiagnosticTool *self,
       g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_SUBPROCESS_FLAGS]);
     }
 }
+
+/**
+ * ide_diagnostic_tool_dup_stats:
+ * @self: a #IdeDiagnosticTool
+ *
+ * Gets statistics shared by all instances of the type of @self.
+ *
+ * The vardict contains the number of processes started in "spawns" and
+ * "worker-spawns", the number of "worker-requests", "cache-hits" and
+ * "cache-misses", the "mean-latency-usec" and "max-latency-usec" of
+ * runs which were not cached, and "max-waiting" which is the deepest
+ * queue of requests waiting for a free slot.
+ *
+ * Returns: (transfer full): a #GVariant of type `a{sv}`
+ *
+ * Since: 50
+ */
+GVariant *
+ide_diagnostic_tool_dup_stats (IdeDiagnosticTool *self)
+{
+  GVariantBuilder builder;
+  ToolState *tool_state;
+  guint64 mean;
+
+  g_return_val_if_fail (IDE_IS_MAIN_THREAD (), NULL);
+  g_return_val_if_fail (IDE_IS_DIAGNOSTIC_TOOL (self), NULL);
+
+  tool_state = tool_state_get (G_OBJECT_TYPE (self));
+  mean = tool_state->completed ? tool_state->total_latency_usec / tool_state->completed : 0;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add_parsed (&builder, "{'spawns', <%t>}", tool_state->spawns);
+  g_variant_builder_add_parsed (&builder, "{'worker-spawns', <%t>}", tool_state->worker_spawns);
+  g_variant_builder_add_parsed (&builder, "{'worker-requests', <%t>}", tool_state->worker_requests);
+  g_variant_builder_add_parsed (&builder, "{'cache-hits', <%t>}", tool_state->cache_hits);
+  g_variant_builder_add_parsed (&builder, "{'cache-misses', <%t>}", tool_state->cache_misses);
+  g_variant_builder_add_parsed (&builder, "{'mean-latency-usec', <%t>}", mean);
+  g_variant_builder_add_parsed (&builder, "{'max-latency-usec', <%t>}", tool_state->max_latency_usec);
+  g_variant_builder_add_parsed (&builder, "{'max-waiting', <%u>}", tool_state->max_waiting);
+
+  return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
@@ -56,6 +56,9 @@ struct _IdeDiagnosticToolClass
                                                   GBytes                 *contents,
                                                   const char             *language_id,
                                                   GError                **error);
+  gboolean               (*prepare_worker_run_context) (IdeDiagnosticTool      *self,
+                                                        IdeRunContext          *run_context,
+                                                        GError                **error);
 };
 
 IDE_AVAILABLE_IN_ALL
@@ -78,5 +81,7 @@ GSubprocessFlags  ide_diagnostic_tool_get_subprocess_flags     (IdeDiagnosticToo
 IDE_AVAILABLE_IN_44
 void              ide_diagnostic_tool_set_subprocess_flags     (IdeDiagnosticTool *self,
                                                                 GSubprocessFlags   subprocess_flags);
+IDE_AVAILABLE_IN_50
+GVariant         *ide_diagnostic_tool_dup_stats                (IdeDiagnosticTool *self);
 
 G_END_DECLS
@@ -0,0 +1,54 @@
+/* ide-ninja-log-private.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_NINJA_LOG (ide_ninja_log_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeNinjaLog, ide_ninja_log, IDE, NINJA_LOG, GObject)
+
+typedef struct
+{
+  const char *output;
+  guint       begin_msec;
+  guint       end_msec;
+} IdeNinjaLogEntry;
+
+#define IDE_NINJA_LOG_ENTRY_DURATION(e) ((e)->end_msec - (e)->begin_msec)
+
+IdeNinjaLog            *ide_ninja_log_new_from_bytes    (GBytes               *bytes,
+                                                         GError              **error);
+void                    ide_ninja_log_load_async        (GFile                *file,
+                                                         GCancellable         *cancellable,
+                                                         GAsyncReadyCallback   callback,
+                                                         gpointer              user_data);
+IdeNinjaLog            *ide_ninja_log_load_finish       (GAsyncResult         *result,
+                                                         GError              **error);
+guint                   ide_ninja_log_get_n_entries     (IdeNinjaLog          *self);
+const IdeNinjaLogEntry *ide_ninja_log_get_entry         (IdeNinjaLog          *self,
+                                                         guint                 position);
+guint                   ide_ninja_log_get_duration      (IdeNinjaLog          *self);
+GPtrArray              *ide_ninja_log_get_critical_path (IdeNinjaLog          *self);
+
+G_END_DECLS
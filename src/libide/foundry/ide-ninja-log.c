@@ -0,0 +1,446 @@
+/* ide-ninja-log.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "ide-ninja-log"
+
+#include "config.h"
+
+#include <string.h>
+
+#include <libide-threading.h>
+
+#include "ide-ninja-log-private.h"
+
+/* Parses the .ninja_log found in the build directory of ninja based
+ * build systems. Each line contains the start and end time of a command
+ * in milliseconds relative to the start of the build, the mtime of the
+ * output, the output path, and a hash of the command line:
+ *
+ *   # ninja log v5
+ *   0\t120\t1700000000\tfoo.o\t7a1c...
+ *
+ * The log is appended to by every build and only compacted every so
+ * often, so we only keep the entries of the most recent build. Those
+ * follow the last point where the end time goes backwards.
+ */
+
+struct _IdeNinjaLog
+{
+  GObject       parent_instance;
+  GStringChunk *strings;
+  /* IdeNinjaLogEntry sorted by duration, longest first */
+  GArray       *entries;
+  guint         duration;
+};
+
+G_DEFINE_FINAL_TYPE (IdeNinjaLog, ide_ninja_log, G_TYPE_OBJECT)
+
+static void
+ide_ninja_log_finalize (GObject *object)
+{
+  IdeNinjaLog *self = (IdeNinjaLog *)object;
+
+  g_clear_pointer (&self->entries, g_array_unref);
+  g_clear_pointer (&self->strings, g_string_chunk_free);
+
+  G_OBJECT_CLASS (ide_ninja_log_parent_class)->finalize (object);
+}
+
+static void
+ide_ninja_log_class_init (IdeNinjaLogClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_ninja_log_finalize;
+}
+
+static void
+ide_ninja_log_init (IdeNinjaLog *self)
+{
+  self->strings = g_string_chunk_new (4096);
+  self->entries = g_array_new (FALSE, FALSE, sizeof (IdeNinjaLogEntry));
+}
+
+static int
+compare_by_duration (gconstpointer a,
+                     gconstpointer b)
+{
+  const IdeNinjaLogEntry *entry_a = a;
+  const IdeNinjaLogEntry *entry_b = b;
+  guint duration_a = IDE_NINJA_LOG_ENTRY_DURATION (entry_a);
+  guint duration_b = IDE_NINJA_LOG_ENTRY_DURATION (entry_b);
+
+  if (duration_a > duration_b)
+    return -1;
+  else if (duration_a < duration_b)
+    return 1;
+  else
+    return strcmp (entry_a->output, entry_b->output);
+}
+
+static int
+compare_by_end (gconstpointer a,
+                gconstpointer b)
+{
+  const IdeNinjaLogEntry *entry_a = *(const IdeNinjaLogEntry * const *)a;
+  const IdeNinjaLogEntry *entry_b = *(const IdeNinjaLogEntry * const *)b;
+
+  if (entry_a->end_msec < entry_b->end_msec)
+    return -1;
+  else if (entry_a->end_msec > entry_b->end_msec)
+    return 1;
+  else
+    return 0;
+}
+
+static gboolean
+parse_uint (const char *str,
+            const char *end,
+            guint      *value)
+{
+  guint64 v = 0;
+
+  if (str == end)
+    return FALSE;
+
+  for (; str < end; str++)
+    {
+      if (!g_ascii_isdigit (*str))
+        return FALSE;
+
+      v = v * 10 + (*str - '0');
+
+      if (v > G_MAXUINT)
+        return FALSE;
+    }
+
+  *value = v;
+
+  return TRUE;
+}
+
+/**
+ * ide_ninja_log_new_from_bytes:
+ * @bytes: the contents of a .ninja_log
+ * @error: a location for a #GError
+ *
+ * Parses the entries of the most recent build found in @bytes.
+ *
+ * Returns: (transfer full): an #IdeNinjaLog or %NULL and @error is set
+ */
+IdeNinjaLog *
+ide_ninja_log_new_from_bytes (GBytes  *bytes,
+                              GError **error)
+{
+  g_autoptr(IdeNinjaLog) self = NULL;
+  const char *data;
+  const char *iter;
+  const char *end;
+  gsize len;
+  guint first = 0;
+  guint last_end = 0;
+  guint min_begin = G_MAXUINT;
+  guint max_end = 0;
+
+  g_return_val_if_fail (bytes != NULL, NULL);
+
+  data = g_bytes_get_data (bytes, &len);
+  end = data + len;
+
+  if (len < 14 ||
+      !g_str_has_prefix (data, "# ninja log v") ||
+      !(data[13] >= '5' && data[13] <= '7'))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_SUPPORTED,
+                   "Unsupported .ninja_log format");
+      return NULL;
+    }
+
+  self = g_object_new (IDE_TYPE_NINJA_LOG, NULL);
+
+  for (iter = data; iter < end; )
+    {
+      const char *eol = memchr (iter, '\n', end - iter);
+      const char *fields[5];
+      const char *field_ends[5];
+      IdeNinjaLogEntry entry;
+      const char *p;
+      guint n_fields = 0;
+
+      if (eol == NULL)
+        eol = end;
+
+      if (*iter == '#')
+        goto next_line;
+
+      for (p = iter; n_fields < G_N_ELEMENTS (fields); n_fields++)
+        {
+          const char *tab = memchr (p, '\t', eol - p);
+
+          fields[n_fields] = p;
+          field_ends[n_fields] = tab ? tab : eol;
+
+          if (tab == NULL)
+            {
+              n_fields++;
+              break;
+            }
+
+          p = tab + 1;
+        }
+
+      if (n_fields < 4 ||
+          !parse_uint (fields[0], field_ends[0], &entry.begin_msec) ||
+          !parse_uint (fields[1], field_ends[1], &entry.end_msec) ||
+          entry.end_msec < entry.begin_msec)
+        goto next_line;
+
+      /* A new build restarts the clock */
+      if (entry.end_msec < last_end)
+        first = self->entries->len;
+      last_end = entry.end_msec;
+
+      /* Edges with multiple outputs have an entry for each of them */
+      if (self->entries->len > first)
+        {
+          const IdeNinjaLogEntry *prev = &g_array_index (self->entries, IdeNinjaLogEntry, self->entries->len - 1);
+
+          if (prev->begin_msec == entry.begin_msec && prev->end_msec == entry.end_msec)
+            goto next_line;
+        }
+
+      entry.output = g_string_chunk_insert_len (self->strings,
+                                                fields[3],
+                                                field_ends[3] - fields[3]);
+      g_array_append_val (self->entries, entry);
+
+    next_line:
+      iter = eol + 1;
+    }
+
+  if (first > 0)
+    g_array_remove_range (self->entries, 0, first);
+
+  for (guint i = 0; i < self->entries->len; i++)
+    {
+      const IdeNinjaLogEntry *entry = &g_array_index (self->entries, IdeNinjaLogEntry, i);
+
+      min_begin = MIN (min_begin, entry->begin_msec);
+      max_end = MAX (max_end, entry->end_msec);
+    }
+
+  if (self->entries->len > 0)
+    self->duration = max_end - min_begin;
+
+  g_array_sort (self->entries, compare_by_duration);
+
+  return g_steal_pointer (&self);
+}
+
+static void
+ide_ninja_log_load_worker (IdeTask      *task,
+                           gpointer      source_object,
+                           gpointer      task_data,
+                           GCancellable *cancellable)
+{
+  GFile *file = task_data;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GError) error = NULL;
+  IdeNinjaLog *self;
+
+  g_assert (IDE_IS_TASK (task));
+  g_assert (G_IS_FILE (file));
+
+  if (!(bytes = g_file_load_bytes (file, cancellable, NULL, &error)) ||
+      !(self = ide_ninja_log_new_from_bytes (bytes, &error)))
+    ide_task_return_error (task, g_steal_pointer (&error));
+  else
+    ide_task_return_object (task, self);
+}
+
+/**
+ * ide_ninja_log_load_async:
+ * @file: a .ninja_log file
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: a callback to execute upon completion
+ * @user_data: closure data for @callback
+ *
+ * Loads and parses @file in a thread as the log can get rather large
+ * for big projects.
+ */
+void
+ide_ninja_log_load_async (GFile               *file,
+                          GCancellable        *cancellable,
+                          GAsyncReadyCallback  callback,
+                          gpointer             user_data)
+{
+  g_autoptr(IdeTask) task = NULL;
+
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = ide_task_new (NULL, cancellable, callback, user_data);
+  ide_task_set_source_tag (task, ide_ninja_log_load_async);
+  ide_task_set_kind (task, IDE_TASK_KIND_IO);
+  ide_task_set_task_data (task, g_object_ref (file), g_object_unref);
+  ide_task_run_in_thread (task, ide_ninja_log_load_worker);
+}
+
+/**
+ * ide_ninja_log_load_finish:
+ * @result: a #GAsyncResult
+ * @error: a location for a #GError
+ *
+ * Returns: (transfer full): an #IdeNinjaLog or %NULL and @error is set
+ */
+IdeNinjaLog *
+ide_ninja_log_load_finish (GAsyncResult  *result,
+                           GError       **error)
+{
+  g_return_val_if_fail (IDE_IS_TASK (result), NULL);
+
+  return ide_task_propagate_object (IDE_TASK (result), error);
+}
+
+guint
+ide_ninja_log_get_n_entries (IdeNinjaLog *self)
+{
+  g_return_val_if_fail (IDE_IS_NINJA_LOG (self), 0);
+
+  return self->entries->len;
+}
+
+/**
+ * ide_ninja_log_get_entry:
+ * @self: a #IdeNinjaLog
+ * @position: the position of the entry
+ *
+ * Gets an entry of the most recent build. Entries are sorted by their
+ * duration so that the slowest commands come first.
+ *
+ * Returns: (transfer none) (nullable): an #IdeNinjaLogEntry or %NULL
+ */
+const IdeNinjaLogEntry *
+ide_ninja_log_get_entry (IdeNinjaLog *self,
+                         guint        position)
+{
+  g_return_val_if_fail (IDE_IS_NINJA_LOG (self), NULL);
+
+  if (position >= self->entries->len)
+    return NULL;
+
+  return &g_array_index (self->entries, IdeNinjaLogEntry, position);
+}
+
+/**
+ * ide_ninja_log_get_duration:
+ * @self: a #IdeNinjaLog
+ *
+ * Gets the wall-clock time spent running commands in the most recent
+ * build, in milliseconds.
+ */
+guint
+ide_ninja_log_get_duration (IdeNinjaLog *self)
+{
+  g_return_val_if_fail (IDE_IS_NINJA_LOG (self), 0);
+
+  return self->duration;
+}
+
+/**
+ * ide_ninja_log_get_critical_path:
+ * @self: a #IdeNinjaLog
+ *
+ * Estimates the chain of commands which bounded the duration of the most
+ * recent build.
+ *
+ * The log does not contain the dependency graph, so this starts from the
+ * command which finished last and repeatedly walks back to the command
+ * which finished most recently before it started. As ninja starts a
+ * command as soon as its inputs are ready and a job slot is free, that
+ * is usually the input it was waiting on.
+ *
+ * Returns: (transfer container) (element-type IdeNinjaLogEntry): the
+ *   entries of the critical path in the order they ran
+ */
+GPtrArray *
+ide_ninja_log_get_critical_path (IdeNinjaLog *self)
+{
+  g_autoptr(GPtrArray) by_end = NULL;
+  GPtrArray *path;
+  const IdeNinjaLogEntry *entry;
+  guint pos;
+
+  g_return_val_if_fail (IDE_IS_NINJA_LOG (self), NULL);
+
+  path = g_ptr_array_new ();
+
+  if (self->entries->len == 0)
+    return path;
+
+  by_end = g_ptr_array_sized_new (self->entries->len);
+  for (guint i = 0; i < self->entries->len; i++)
+    g_ptr_array_add (by_end, &g_array_index (self->entries, IdeNinjaLogEntry, i));
+  g_ptr_array_sort (by_end, compare_by_end);
+
+  pos = by_end->len - 1;
+  entry = g_ptr_array_index (by_end, pos);
+  g_ptr_array_add (path, (gpointer)entry);
+
+  for (;;)
+    {
+      guint lo = 0;
+      guint hi = pos;
+
+      /* Find the last entry, before @pos, which ended by the time
+       * @entry began. Everything before @pos ended no later than it.
+       */
+      while (lo < hi)
+        {
+          guint mid = lo + (hi - lo) / 2;
+          const IdeNinjaLogEntry *probe = g_ptr_array_index (by_end, mid);
+
+          if (probe->end_msec <= entry->begin_msec)
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+
+      if (lo == 0)
+        break;
+
+      pos = lo - 1;
+      entry = g_ptr_array_index (by_end, pos);
+      g_ptr_array_add (path, (gpointer)entry);
+    }
+
+  /* Reverse so the path reads in the order commands ran */
+  for (guint i = 0; i < path->len / 2; i++)
+    {
+      gpointer tmp = path->pdata[i];
+
+      path->pdata[i] = path->pdata[path->len - 1 - i];
+      path->pdata[path->len - 1 - i] = tmp;
+    }
+
+  return path;
+}
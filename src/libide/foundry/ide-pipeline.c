@@ -197,6 +197,12 @@ struct _IdePipeline
    */
   IdeBuildLog *log;
 
+  /*
+   * The org.gnome.builder.build settings, to resize the log buffers
+   * when the limits are changed by the user.
+   */
+  GSettings *settings;
+
   /*
    * These are our builddir/srcdir paths. Useful for building paths
    * by addins. We try to create a new builddir that will be unique
@@ -290,6 +296,15 @@ struct _IdePipeline
    */
   guint idle_addins_load_source;
 
+  /*
+   * Records how long builds and their stages take so that regressions
+   * can be surfaced to the user. The history is persisted per config.
+   * stage_begin and stage_phase describe the currently executing stage.
+   */
+  IdeBuildHistory  *history;
+  gint64            stage_begin;
+  IdePipelinePhase  stage_phase;
+
   /*
    * If we failed to build, this should be set.
    */
@@ -1389,6 +1404,22 @@ ide_pipeline_load_get_info_cb (GObject      *object,
   ide_pipeline_load (self);
 }
 
+static void
+ide_pipeline_load_history_cb (GObject      *object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+  IdeBuildHistory *history = (IdeBuildHistory *)object;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_BUILD_HISTORY (history));
+  g_assert (G_IS_ASYNC_RESULT (result));
+
+  if (!ide_build_history_load_finish (history, result, &error) &&
+      !ide_error_ignore (error))
+    g_warning ("Failed to load build history: %s", error->message);
+}
+
 static void
 ide_pipeline_begin_load (IdePipeline *self)
 {
@@ -1410,6 +1441,22 @@ ide_pipeline_begin_load (IdePipeline *self)
       (srcdir = ide_build_system_get_srcdir (build_system)))
     g_set_str (&self->srcdir, srcdir);
 
+  /* Load the timings of previous builds for this configuration */
+  if (context != NULL && self->history == NULL)
+    {
+      g_autofree char *name = g_strdup_printf ("%s.gvariant", ide_config_get_id (self->config));
+      g_autoptr(GFile) file = NULL;
+
+      g_strdelimit (name, "@:/ ", '-');
+      file = ide_context_cache_file (context, "build-history", name, NULL);
+
+      self->history = ide_build_history_new (file);
+      ide_build_history_load_async (self->history,
+                                    self->cancellable,
+                                    ide_pipeline_load_history_cb,
+                                    NULL);
+    }
+
   /*
    * The first thing we need to do is get some information from the
    * configured device. We want to know the arch/kernel/system triplet
@@ -1495,6 +1542,8 @@ ide_pipeline_finalize (GObject *object)
 
   g_clear_object (&self->cancellable);
   g_clear_object (&self->log);
+  g_clear_object (&self->settings);
+  g_clear_object (&self->history);
   g_clear_object (&self->device);
   g_clear_object (&self->device_info);
   g_clear_object (&self->runtime);
@@ -1881,6 +1930,19 @@ ide_pipeline_class_init (IdePipelineClass *klass)
                               ide_marshal_VOID__OBJECTv);
 }
 
+static void
+ide_pipeline_log_limits_changed_cb (IdePipeline *self,
+                                    const char  *key,
+                                    GSettings   *settings)
+{
+  g_assert (IDE_IS_PIPELINE (self));
+  g_assert (G_IS_SETTINGS (settings));
+
+  ide_build_log_set_limits (self->log,
+                            (gsize)g_settings_get_uint (settings, "log-buffer-size") * 1024 * 1024,
+                            (gsize)g_settings_get_uint (settings, "log-history-size") * 1024 * 1024);
+}
+
 static void
 ide_pipeline_init (IdePipeline *self)
 {
@@ -1901,6 +1963,19 @@ ide_pipeline_init (IdePipeline *self)
   self->chained_bindings = g_ptr_array_new_with_free_func ((GDestroyNotify)chained_binding_clear);
 
   self->log = ide_build_log_new ();
+
+  self->settings = g_settings_new ("org.gnome.builder.build");
+  g_signal_connect_object (self->settings,
+                           "changed::log-buffer-size",
+                           G_CALLBACK (ide_pipeline_log_limits_changed_cb),
+                           self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->settings,
+                           "changed::log-history-size",
+                           G_CALLBACK (ide_pipeline_log_limits_changed_cb),
+                           self,
+                           G_CONNECT_SWAPPED);
+  ide_pipeline_log_limits_changed_cb (self, NULL, self->settings);
 }
 
 static void
@@ -1922,6 +1997,12 @@ ide_pipeline_stage_build_cb (GObject      *object,
   self = ide_task_get_source_object (task);
   g_assert (IDE_IS_PIPELINE (self));
 
+  if (self->history != NULL)
+    ide_build_history_add_stage (self->history,
+                                 ide_pipeline_stage_get_name (stage) ?: G_OBJECT_TYPE_NAME (stage),
+                                 self->stage_phase,
+                                 g_get_monotonic_time () - self->stage_begin);
+
   if (!_ide_pipeline_stage_build_with_query_finish (stage, result, &error))
     {
       g_debug ("stage of type %s failed: %s",
@@ -2106,6 +2187,9 @@ ide_pipeline_tick_build (IdePipeline *self,
            */
           ide_pipeline_try_chain (self, entry->stage, self->position + 1);
 
+          self->stage_begin = g_get_monotonic_time ();
+          self->stage_phase = entry->phase & IDE_PIPELINE_PHASE_MASK;
+
           _ide_pipeline_stage_build_with_query_async (entry->stage,
                                                       self,
                                                       targets,
@@ -2152,6 +2236,10 @@ ide_pipeline_task_notify_completed (IdePipeline *self,
    */
   ide_pipeline_release_transients (self);
 
+  /* Only builds are recorded, see ide_pipeline_do_flush() */
+  if (self->history != NULL)
+    ide_build_history_end (self->history, self->failed);
+
   g_signal_emit (self, signals [FINISHED], 0, self->failed);
 
   g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_BUSY]);
@@ -2498,6 +2586,10 @@ ide_pipeline_do_flush (gpointer data)
       }
   }
 
+  /* Clean operations say nothing about how long building takes */
+  if (self->history != NULL && task_data->type != TASK_CLEAN)
+    ide_build_history_begin (self->history);
+
   /* Notify any observers that a build (of some sort) is about to start. */
   g_signal_emit (self, signals [STARTED], 0, task_data->phase);
 
@@ -3210,6 +3302,33 @@ ide_pipeline_remove_log_observer (IdePipeline *self,
   return ide_build_log_remove_observer (self->log, observer_id);
 }
 
+/**
+ * ide_pipeline_search_log:
+ * @self: a #IdePipeline
+ * @needle: the text to search for
+ * @max_matches: the max number of lines to return, or 0 for unlimited
+ *
+ * Searches the most recent build output retained by the pipeline for
+ * lines containing @needle.
+ *
+ * The amount of output retained is controlled by the "log-history-size"
+ * setting, so older output may no longer be available.
+ *
+ * Returns: (transfer full): a %NULL-terminated array of matching lines
+ *
+ * Since: 50
+ */
+char **
+ide_pipeline_search_log (IdePipeline *self,
+                         const char  *needle,
+                         guint        max_matches)
+{
+  g_return_val_if_fail (IDE_IS_PIPELINE (self), NULL);
+  g_return_val_if_fail (needle != NULL, NULL);
+
+  return ide_build_log_search (self->log, needle, max_matches);
+}
+
 void
 ide_pipeline_emit_diagnostic (IdePipeline   *self,
                               IdeDiagnostic *diagnostic)
@@ -4140,6 +4259,22 @@ _ide_pipeline_set_pty_size (IdePipeline *self,
     ide_pty_intercept_set_size (&self->intercept, rows, columns);
 }
 
+/**
+ * _ide_pipeline_get_history:
+ * @self: a #IdePipeline
+ *
+ * Gets the timings of previous builds using this pipeline's configuration.
+ *
+ * Returns: (transfer none) (nullable): an #IdeBuildHistory or %NULL
+ */
+IdeBuildHistory *
+_ide_pipeline_get_history (IdePipeline *self)
+{
+  g_return_val_if_fail (IDE_IS_PIPELINE (self), NULL);
+
+  return self->history;
+}
+
 void
 _ide_pipeline_set_runtime (IdePipeline *self,
                            IdeRuntime  *runtime)
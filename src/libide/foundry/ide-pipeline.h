@@ -140,6 +140,10 @@ guint                  ide_pipeline_add_log_observer         (IdePipeline
 IDE_AVAILABLE_IN_ALL
 gboolean               ide_pipeline_remove_log_observer      (IdePipeline            *self,
                                                               guint                   observer_id);
+IDE_AVAILABLE_IN_50
+char                 **ide_pipeline_search_log               (IdePipeline            *self,
+                                                              const char             *needle,
+                                                              guint                   max_matches);
 IDE_AVAILABLE_IN_ALL
 void                   ide_pipeline_emit_diagnostic          (IdePipeline            *self,
                                                               IdeDiagnostic          *diagnostic);
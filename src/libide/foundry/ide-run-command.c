@@ -38,6 +38,8 @@ typedef struct
   char **environ;
   char **argv;
   char **languages;
+  char **sources;
+  char **tags;
   int priority;
   IdeRunCommandKind kind : 8;
   guint can_default : 1;
@@ -55,6 +57,8 @@ enum {
   PROP_KIND,
   PROP_LANGUAGES,
   PROP_PRIORITY,
+  PROP_SOURCES,
+  PROP_TAGS,
   PROP_TITLE,
 
   /* Just for making listview's easier */
@@ -189,6 +193,8 @@ ide_run_command_finalize (GObject *object)
   g_clear_pointer (&priv->environ, g_strfreev);
   g_clear_pointer (&priv->argv, g_strfreev);
   g_clear_pointer (&priv->languages, g_strfreev);
+  g_clear_pointer (&priv->sources, g_strfreev);
+  g_clear_pointer (&priv->tags, g_strfreev);
 
   G_OBJECT_CLASS (ide_run_command_parent_class)->finalize (object);
 }
@@ -265,6 +271,14 @@ ide_run_command_get_property (GObject    *object,
       g_value_take_string (value, ide_run_command_get_shell_command (self));
       break;
 
+    case PROP_SOURCES:
+      g_value_set_boxed (value, ide_run_command_get_sources (self));
+      break;
+
+    case PROP_TAGS:
+      g_value_set_boxed (value, ide_run_command_get_tags (self));
+      break;
+
     case PROP_TITLE:
       g_value_set_string (value, ide_run_command_get_title (self));
       break;
@@ -320,6 +334,14 @@ ide_run_command_set_property (GObject      *object,
       ide_run_command_set_priority (self, g_value_get_int (value));
       break;
 
+    case PROP_SOURCES:
+      ide_run_command_set_sources (self, g_value_get_boxed (value));
+      break;
+
+    case PROP_TAGS:
+      ide_run_command_set_tags (self, g_value_get_boxed (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     }
@@ -412,6 +434,33 @@ ide_run_command_class_init (IdeRunCommandClass *klass)
                       G_MININT, G_MAXINT, 0,
                       (G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * IdeRunCommand:sources:
+   *
+   * Contains the paths of the source files the program is built from.
+   *
+   * This is to be set by run command providers which can introspect the
+   * build system. The test manager uses it to select the tests affected
+   * by changes to the project.
+   */
+  properties [PROP_SOURCES] =
+    g_param_spec_boxed ("sources", NULL, NULL,
+                        G_TYPE_STRV,
+                        (G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * IdeRunCommand:tags:
+   *
+   * Contains tags describing the resources used by the command.
+   *
+   * The test manager will not run a test tagged "exclusive" alongside any
+   * other test, nor two tests tagged "serial" at the same time.
+   */
+  properties [PROP_TAGS] =
+    g_param_spec_boxed ("tags", NULL, NULL,
+                        G_TYPE_STRV,
+                        (G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS));
+
   /* Read-only helper for property bindings */
   properties [PROP_SHELL_COMMAND] =
     g_param_spec_string ("shell-command", NULL, NULL,
@@ -654,6 +703,99 @@ ide_run_command_set_languages (IdeRunCommand      *self,
   g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_LANGUAGES]);
 }
 
+/**
+ * ide_run_command_get_sources:
+ * @self: a #IdeRunCommand
+ *
+ * Gets the source files the program is built from, if known.
+ *
+ * Returns: (transfer none) (nullable): a %NULL-terminated array of paths
+ */
+const char * const *
+ide_run_command_get_sources (IdeRunCommand *self)
+{
+  IdeRunCommandPrivate *priv = ide_run_command_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_RUN_COMMAND (self), NULL);
+
+  return (const char * const *)priv->sources;
+}
+
+void
+ide_run_command_set_sources (IdeRunCommand      *self,
+                             const char * const *sources)
+{
+  IdeRunCommandPrivate *priv = ide_run_command_get_instance_private (self);
+
+  g_return_if_fail (IDE_IS_RUN_COMMAND (self));
+
+  if (sources == (const char * const *)priv->sources ||
+      (sources != NULL &&
+       priv->sources != NULL &&
+       g_strv_equal ((const char * const *)priv->sources, sources)))
+    return;
+
+  g_strfreev (priv->sources);
+  priv->sources = g_strdupv ((char **)sources);
+  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_SOURCES]);
+}
+
+/**
+ * ide_run_command_get_tags:
+ * @self: a #IdeRunCommand
+ *
+ * Gets the tags for the command such as "exclusive" or "serial".
+ *
+ * Returns: (transfer none) (nullable): a %NULL-terminated array of tags
+ */
+const char * const *
+ide_run_command_get_tags (IdeRunCommand *self)
+{
+  IdeRunCommandPrivate *priv = ide_run_command_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_RUN_COMMAND (self), NULL);
+
+  return (const char * const *)priv->tags;
+}
+
+void
+ide_run_command_set_tags (IdeRunCommand      *self,
+                          const char * const *tags)
+{
+  IdeRunCommandPrivate *priv = ide_run_command_get_instance_private (self);
+
+  g_return_if_fail (IDE_IS_RUN_COMMAND (self));
+
+  if (tags == (const char * const *)priv->tags ||
+      (tags != NULL &&
+       priv->tags != NULL &&
+       g_strv_equal ((const char * const *)priv->tags, tags)))
+    return;
+
+  g_strfreev (priv->tags);
+  priv->tags = g_strdupv ((char **)tags);
+  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_TAGS]);
+}
+
+/**
+ * ide_run_command_has_tag:
+ * @self: a #IdeRunCommand
+ * @tag: the tag to look for
+ *
+ * Returns: %TRUE if @self is tagged with @tag
+ */
+gboolean
+ide_run_command_has_tag (IdeRunCommand *self,
+                         const char    *tag)
+{
+  IdeRunCommandPrivate *priv = ide_run_command_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_RUN_COMMAND (self), FALSE);
+  g_return_val_if_fail (tag != NULL, FALSE);
+
+  return priv->tags != NULL && g_strv_contains ((const char * const *)priv->tags, tag);
+}
+
 /**
  * ide_run_command_prepare_to_run:
  * @self: a #IdeRunCommand
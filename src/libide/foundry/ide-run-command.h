@@ -122,6 +122,19 @@ gboolean            ide_run_command_get_can_default  (IdeRunCommand      *self);
 IDE_AVAILABLE_IN_ALL
 void                ide_run_command_set_can_default  (IdeRunCommand      *self,
                                                       gboolean            can_default);
+IDE_AVAILABLE_IN_50
+const char * const *ide_run_command_get_sources      (IdeRunCommand      *self);
+IDE_AVAILABLE_IN_50
+void                ide_run_command_set_sources      (IdeRunCommand      *self,
+                                                      const char * const *sources);
+IDE_AVAILABLE_IN_50
+const char * const *ide_run_command_get_tags         (IdeRunCommand      *self);
+IDE_AVAILABLE_IN_50
+void                ide_run_command_set_tags         (IdeRunCommand      *self,
+                                                      const char * const *tags);
+IDE_AVAILABLE_IN_50
+gboolean            ide_run_command_has_tag          (IdeRunCommand      *self,
+                                                      const char         *tag);
 IDE_AVAILABLE_IN_ALL
 void                ide_run_command_prepare_to_run   (IdeRunCommand      *self,
                                                       IdeRunContext      *run_context,
@@ -0,0 +1,53 @@
+/* ide-test-history-private.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_TEST_HISTORY (ide_test_history_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeTestHistory, ide_test_history, IDE, TEST_HISTORY, GObject)
+
+IdeTestHistory *ide_test_history_new         (GFile                *file);
+GFile          *ide_test_history_get_file    (IdeTestHistory       *self);
+void            ide_test_history_load_async  (IdeTestHistory       *self,
+                                              GCancellable         *cancellable,
+                                              GAsyncReadyCallback   callback,
+                                              gpointer              user_data);
+gboolean        ide_test_history_load_finish (IdeTestHistory       *self,
+                                              GAsyncResult         *result,
+                                              GError              **error);
+void            ide_test_history_save        (IdeTestHistory       *self);
+void            ide_test_history_record      (IdeTestHistory       *self,
+                                              const char           *test_id,
+                                              GTimeSpan             duration,
+                                              gboolean              failed);
+gboolean        ide_test_history_lookup      (IdeTestHistory       *self,
+                                              const char           *test_id,
+                                              GTimeSpan            *duration,
+                                              gboolean             *failed);
+void            ide_test_history_sort        (IdeTestHistory       *self,
+                                              GPtrArray            *tests,
+                                              gboolean              failed_first);
+
+G_END_DECLS
@@ -0,0 +1,421 @@
+/* ide-test-history.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "ide-test-history"
+
+#include "config.h"
+
+#include <libide-threading.h>
+
+#include "ide-test.h"
+#include "ide-test-history-private.h"
+
+/* Each test is stored by id as (duration, failed) where duration is
+ * the smoothed run time in microseconds.
+ */
+#define HISTORY_FORMAT "a{s(xb)}"
+
+typedef struct
+{
+  GTimeSpan duration;
+  gboolean  failed;
+} TestRecord;
+
+struct _IdeTestHistory
+{
+  GObject     parent_instance;
+  GFile      *file;
+  GHashTable *records;
+};
+
+G_DEFINE_FINAL_TYPE (IdeTestHistory, ide_test_history, G_TYPE_OBJECT)
+
+static void
+test_record_free (TestRecord *record)
+{
+  g_slice_free (TestRecord, record);
+}
+
+static void
+ide_test_history_finalize (GObject *object)
+{
+  IdeTestHistory *self = (IdeTestHistory *)object;
+
+  g_clear_pointer (&self->records, g_hash_table_unref);
+  g_clear_object (&self->file);
+
+  G_OBJECT_CLASS (ide_test_history_parent_class)->finalize (object);
+}
+
+static void
+ide_test_history_class_init (IdeTestHistoryClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_test_history_finalize;
+}
+
+static void
+ide_test_history_init (IdeTestHistory *self)
+{
+  self->records = g_hash_table_new_full (g_str_hash,
+                                         g_str_equal,
+                                         g_free,
+                                         (GDestroyNotify)test_record_free);
+}
+
+/**
+ * ide_test_history_new:
+ * @file: the file to persist the history to
+ *
+ * Creates a new #IdeTestHistory which records how long each test took
+ * and whether it failed the last time it ran for a single configuration.
+ *
+ * Returns: (transfer full): a new #IdeTestHistory
+ */
+IdeTestHistory *
+ide_test_history_new (GFile *file)
+{
+  IdeTestHistory *self;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  self = g_object_new (IDE_TYPE_TEST_HISTORY, NULL);
+  self->file = g_object_ref (file);
+
+  return self;
+}
+
+GFile *
+ide_test_history_get_file (IdeTestHistory *self)
+{
+  g_return_val_if_fail (IDE_IS_TEST_HISTORY (self), NULL);
+
+  return self->file;
+}
+
+static void
+ide_test_history_load_cb (GObject      *object,
+                          GAsyncResult *result,
+                          gpointer      user_data)
+{
+  GFile *file = (GFile *)object;
+  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GError) error = NULL;
+  IdeTestHistory *self;
+  GVariantIter iter;
+  const char *test_id;
+  gboolean failed;
+  gint64 duration;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_FILE (file));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_TASK (task));
+
+  self = ide_task_get_source_object (task);
+
+  if (!(bytes = g_file_load_bytes_finish (file, result, NULL, &error)))
+    {
+      /* No history yet is not an error */
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        ide_task_return_boolean (task, TRUE);
+      else
+        ide_task_return_error (task, g_steal_pointer (&error));
+      IDE_EXIT;
+    }
+
+  variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (HISTORY_FORMAT), bytes, FALSE));
+
+  if (!g_variant_is_normal_form (variant))
+    {
+      ide_task_return_new_error (task,
+                                 G_IO_ERROR,
+                                 G_IO_ERROR_INVALID_DATA,
+                                 "Test history is corrupted");
+      IDE_EXIT;
+    }
+
+  g_variant_iter_init (&iter, variant);
+
+  while (g_variant_iter_next (&iter, "{&s(xb)}", &test_id, &duration, &failed))
+    {
+      TestRecord *record;
+
+      /* Keep anything recorded while we were loading */
+      if (g_hash_table_contains (self->records, test_id))
+        continue;
+
+      record = g_slice_new0 (TestRecord);
+      record->duration = duration;
+      record->failed = !!failed;
+
+      g_hash_table_insert (self->records, g_strdup (test_id), record);
+    }
+
+  ide_task_return_boolean (task, TRUE);
+
+  IDE_EXIT;
+}
+
+void
+ide_test_history_load_async (IdeTestHistory      *self,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
+{
+  g_autoptr(IdeTask) task = NULL;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_TEST_HISTORY (self));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = ide_task_new (self, cancellable, callback, user_data);
+  ide_task_set_source_tag (task, ide_test_history_load_async);
+
+  g_file_load_bytes_async (self->file,
+                           cancellable,
+                           ide_test_history_load_cb,
+                           g_steal_pointer (&task));
+
+  IDE_EXIT;
+}
+
+gboolean
+ide_test_history_load_finish (IdeTestHistory  *self,
+                              GAsyncResult    *result,
+                              GError         **error)
+{
+  g_return_val_if_fail (IDE_IS_TEST_HISTORY (self), FALSE);
+  g_return_val_if_fail (IDE_IS_TASK (result), FALSE);
+
+  return ide_task_propagate_boolean (IDE_TASK (result), error);
+}
+
+static void
+ide_test_history_save_worker (IdeTask      *task,
+                              gpointer      source_object,
+                              gpointer      task_data,
+                              GCancellable *cancellable)
+{
+  IdeTestHistory *self = source_object;
+  GBytes *bytes = task_data;
+  g_autoptr(GFile) parent = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_TASK (task));
+  g_assert (IDE_IS_TEST_HISTORY (self));
+  g_assert (bytes != NULL);
+
+  parent = g_file_get_parent (self->file);
+
+  if (!g_file_make_directory_with_parents (parent, cancellable, &error) &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+    {
+      ide_task_return_error (task, g_steal_pointer (&error));
+      return;
+    }
+
+  g_clear_error (&error);
+
+  if (!g_file_replace_contents (self->file,
+                                g_bytes_get_data (bytes, NULL),
+                                g_bytes_get_size (bytes),
+                                NULL, FALSE,
+                                G_FILE_CREATE_REPLACE_DESTINATION,
+                                NULL, cancellable, &error))
+    ide_task_return_error (task, g_steal_pointer (&error));
+  else
+    ide_task_return_boolean (task, TRUE);
+}
+
+/**
+ * ide_test_history_save:
+ * @self: a #IdeTestHistory
+ *
+ * Saves the history to disk from a thread.
+ */
+void
+ide_test_history_save (IdeTestHistory *self)
+{
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(IdeTask) task = NULL;
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  const char *test_id;
+  TestRecord *record;
+
+  g_return_if_fail (IDE_IS_TEST_HISTORY (self));
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (HISTORY_FORMAT));
+
+  g_hash_table_iter_init (&iter, self->records);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&test_id, (gpointer *)&record))
+    g_variant_builder_add (&builder, "{s(xb)}", test_id, (gint64)record->duration, record->failed);
+
+  variant = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  task = ide_task_new (self, NULL, NULL, NULL);
+  ide_task_set_source_tag (task, ide_test_history_save);
+  ide_task_set_kind (task, IDE_TASK_KIND_IO);
+  ide_task_set_task_data (task, g_variant_get_data_as_bytes (variant), g_bytes_unref);
+  ide_task_run_in_thread (task, ide_test_history_save_worker);
+}
+
+/**
+ * ide_test_history_record:
+ * @self: a #IdeTestHistory
+ * @test_id: the id of the test
+ * @duration: how long the test ran in microseconds
+ * @failed: if the test failed
+ *
+ * Records the outcome of a test. The duration is averaged with the
+ * previous runs so that a single slow run does not reorder the suite.
+ */
+void
+ide_test_history_record (IdeTestHistory *self,
+                         const char     *test_id,
+                         GTimeSpan       duration,
+                         gboolean        failed)
+{
+  TestRecord *record;
+
+  g_return_if_fail (IDE_IS_TEST_HISTORY (self));
+  g_return_if_fail (test_id != NULL);
+
+  duration = MAX (0, duration);
+
+  if ((record = g_hash_table_lookup (self->records, test_id)))
+    {
+      record->duration = (record->duration + duration) / 2;
+      record->failed = !!failed;
+      return;
+    }
+
+  record = g_slice_new0 (TestRecord);
+  record->duration = duration;
+  record->failed = !!failed;
+
+  g_hash_table_insert (self->records, g_strdup (test_id), record);
+}
+
+/**
+ * ide_test_history_lookup:
+ * @self: a #IdeTestHistory
+ * @test_id: the id of the test
+ * @duration: (out) (optional): a location for the duration
+ * @failed: (out) (optional): a location for if the test last failed
+ *
+ * Returns: %TRUE if @test_id has run before
+ */
+gboolean
+ide_test_history_lookup (IdeTestHistory *self,
+                         const char     *test_id,
+                         GTimeSpan      *duration,
+                         gboolean       *failed)
+{
+  const TestRecord *record;
+
+  g_return_val_if_fail (IDE_IS_TEST_HISTORY (self), FALSE);
+
+  if (test_id == NULL ||
+      !(record = g_hash_table_lookup (self->records, test_id)))
+    return FALSE;
+
+  if (duration != NULL)
+    *duration = record->duration;
+
+  if (failed != NULL)
+    *failed = record->failed;
+
+  return TRUE;
+}
+
+typedef struct
+{
+  IdeTest   *test;
+  GTimeSpan  duration;
+  guint      position;
+  guint      failed : 1;
+} SortItem;
+
+static int
+compare_sort_item (gconstpointer a,
+                   gconstpointer b,
+                   gpointer      user_data)
+{
+  const SortItem *item_a = a;
+  const SortItem *item_b = b;
+  gboolean failed_first = GPOINTER_TO_INT (user_data);
+
+  if (failed_first && item_a->failed != item_b->failed)
+    return item_a->failed ? -1 : 1;
+
+  if (item_a->duration != item_b->duration)
+    return item_a->duration > item_b->duration ? -1 : 1;
+
+  return item_a->position < item_b->position ? -1 : 1;
+}
+
+/**
+ * ide_test_history_sort:
+ * @self: a #IdeTestHistory
+ * @tests: (element-type IdeTest): the tests to sort
+ * @failed_first: if tests which failed last time should run first
+ *
+ * Sorts @tests so that the longest running tests start first, which
+ * keeps a few slow tests from running alone at the end of the suite.
+ *
+ * Tests which never ran are placed first as they may be slow, and
+ * tests with the same duration keep their relative order.
+ */
+void
+ide_test_history_sort (IdeTestHistory *self,
+                       GPtrArray      *tests,
+                       gboolean        failed_first)
+{
+  g_autoptr(GArray) items = NULL;
+
+  g_return_if_fail (IDE_IS_TEST_HISTORY (self));
+  g_return_if_fail (tests != NULL);
+
+  items = g_array_sized_new (FALSE, FALSE, sizeof (SortItem), tests->len);
+
+  for (guint i = 0; i < tests->len; i++)
+    {
+      IdeTest *test = g_ptr_array_index (tests, i);
+      SortItem item = { test, G_MAXINT64, i, FALSE };
+      gboolean failed = FALSE;
+
+      if (ide_test_history_lookup (self, ide_test_get_id (test), &item.duration, &failed))
+        item.failed = !!failed;
+
+      g_array_append_val (items, item);
+    }
+
+  g_array_sort_with_data (items, compare_sort_item, GINT_TO_POINTER (!!failed_first));
+
+  for (guint i = 0; i < items->len; i++)
+    g_ptr_array_index (tests, i) = g_array_index (items, SortItem, i).test;
+}
@@ -27,10 +27,12 @@
 #include <libide-core.h>
 #include <libide-io.h>
 #include <libide-threading.h>
+#include <libide-vcs.h>
 
 #include "ide-marshal.h"
 
 #include "ide-build-manager.h"
+#include "ide-config.h"
 #include "ide-foundry-compat.h"
 #include "ide-pipeline.h"
 #include "ide-pty.h"
@@ -38,11 +40,10 @@
 #include "ide-run-command.h"
 #include "ide-run-commands.h"
 #include "ide-run-manager.h"
+#include "ide-test-history-private.h"
 #include "ide-test-manager.h"
 #include "ide-test-private.h"
 
-#define MAX_UNIT_TESTS 4
-
 /**
  * SECTION:ide-test-manager
  * @title: IdeTestManager
@@ -54,6 +55,12 @@
  *
  * You can access the test manager using ide_context_get_text_manager()
  * using the #IdeContext for the loaded project.
+ *
+ * When running many tests, the duration and outcome of every test is
+ * recorded per configuration so that the longest tests can be started
+ * first. As many tests as there are CPUs run at once, except for tests
+ * whose #IdeRunCommand is tagged "exclusive" which run alone, and tests
+ * tagged "serial" which never run alongside another "serial" test.
  */
 
 struct _IdeTestManager
@@ -64,28 +71,50 @@ struct _IdeTestManager
   VtePty             *pty;
   GCancellable       *cancellable;
   IdePtyIntercept     intercept;
+  IdeTestHistory     *history;
   int                 pty_producer;
   guint               n_active;
+  guint               history_dirty : 1;
 };
 
 typedef struct
 {
   IdePipeline *pipeline;
+  /* Tests which have not started yet, in the order to start them */
   GPtrArray   *tests;
   VtePty      *pty;
   guint        n_active;
+  guint        max_active;
+  guint        n_serial;
+  guint        n_exclusive;
 } RunAll;
 
+typedef struct
+{
+  IdeTask *task;
+  guint    serial : 1;
+  guint    exclusive : 1;
+} RunAllJob;
+
+typedef struct
+{
+  IdeTestHistory *history;
+  gint64          begin_time;
+} RunOne;
+
 static void ide_test_manager_actions_cancel   (IdeTestManager *self,
                                                GVariant       *param);
 static void ide_test_manager_actions_test     (IdeTestManager *self,
                                                GVariant       *param);
 static void ide_test_manager_actions_test_all (IdeTestManager *self,
                                                GVariant       *param);
+static void ide_test_manager_actions_test_changed (IdeTestManager *self,
+                                                   GVariant       *param);
 
 IDE_DEFINE_ACTION_GROUP (IdeTestManager, ide_test_manager, {
   { "test", ide_test_manager_actions_test, "s" },
   { "test-all", ide_test_manager_actions_test_all },
+  { "test-changed", ide_test_manager_actions_test_changed },
   { "cancel", ide_test_manager_actions_cancel },
 })
 
@@ -132,6 +161,74 @@ run_all_free (RunAll *state)
   g_slice_free (RunAll, state);
 }
 
+static void
+run_one_free (RunOne *run)
+{
+  g_clear_object (&run->history);
+  g_slice_free (RunOne, run);
+}
+
+static void
+ide_test_manager_load_history_cb (GObject      *object,
+                                  GAsyncResult *result,
+                                  gpointer      user_data)
+{
+  IdeTestHistory *history = (IdeTestHistory *)object;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_TEST_HISTORY (history));
+  g_assert (G_IS_ASYNC_RESULT (result));
+
+  if (!ide_test_history_load_finish (history, result, &error) &&
+      !ide_error_ignore (error))
+    g_warning ("Failed to load test history: %s", error->message);
+}
+
+/*
+ * Gets the history for the configuration of @pipeline, replacing the
+ * history of the previous configuration if necessary. @created is set
+ * when the caller is responsible for loading the new history.
+ */
+static IdeTestHistory *
+ide_test_manager_ensure_history (IdeTestManager *self,
+                                 IdePipeline    *pipeline,
+                                 gboolean       *created)
+{
+  g_autofree char *name = NULL;
+  g_autoptr(GFile) file = NULL;
+  IdeContext *context;
+  IdeConfig *config;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_TEST_MANAGER (self));
+  g_assert (IDE_IS_PIPELINE (pipeline));
+  g_assert (created != NULL);
+
+  *created = FALSE;
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  config = ide_pipeline_get_config (pipeline);
+  name = g_strdup_printf ("%s.gvariant", ide_config_get_id (config));
+  g_strdelimit (name, "@:/ ", '-');
+  file = ide_context_cache_file (context, "test-history", name, NULL);
+
+  if (self->history != NULL &&
+      g_file_equal (file, ide_test_history_get_file (self->history)))
+    return self->history;
+
+  if (self->history != NULL && self->history_dirty)
+    ide_test_history_save (self->history);
+
+  g_clear_object (&self->history);
+
+  self->history = ide_test_history_new (file);
+  self->history_dirty = FALSE;
+
+  *created = TRUE;
+
+  return self->history;
+}
+
 static GCancellable *
 get_cancellable (IdeTestManager *self)
 {
@@ -204,6 +301,21 @@ ide_test_manager_actions_test_all (IdeTestManager *self,
   IDE_EXIT;
 }
 
+static void
+ide_test_manager_actions_test_changed (IdeTestManager *self,
+                                       GVariant       *param)
+{
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_TEST_MANAGER (self));
+  g_assert (param == NULL);
+
+  ide_test_manager_run_changed_async (self, get_cancellable (self), NULL, NULL);
+
+  IDE_EXIT;
+}
+
 static gpointer
 map_run_command_to_test (gpointer item,
                          gpointer user_data)
@@ -222,8 +334,12 @@ ide_test_manager_destroy (IdeObject *object)
   IdeTestManager *self = (IdeTestManager *)object;
   g_auto(IdePtyFd) fd = IDE_PTY_FD_INVALID;
 
+  if (self->history != NULL && self->history_dirty)
+    ide_test_history_save (self->history);
+
   g_clear_object (&self->cancellable);
   g_clear_object (&self->filtered);
+  g_clear_object (&self->history);
   g_clear_object (&self->tests);
 
   g_clear_object (&self->pty);
@@ -331,15 +447,18 @@ ide_test_manager_init (IdeTestManager *self)
   self->tests = ide_cached_list_model_new (G_LIST_MODEL (map));
 }
 
+static void ide_test_manager_run_all_schedule (IdeTestManager *self,
+                                               IdeTask        *task);
+
 static void
 ide_test_manager_run_all_cb (GObject      *object,
                              GAsyncResult *result,
                              gpointer      user_data)
 {
   IdeTestManager *self = (IdeTestManager *)object;
-  g_autoptr(IdeTask) task = user_data;
+  RunAllJob *job = user_data;
+  g_autoptr(IdeTask) task = NULL;
   g_autoptr(GError) error = NULL;
-  GCancellable *cancellable;
   RunAll *state;
 
   IDE_ENTRY;
@@ -347,9 +466,10 @@ ide_test_manager_run_all_cb (GObject      *object,
   g_assert (IDE_IS_MAIN_THREAD ());
   g_assert (IDE_IS_TEST_MANAGER (self));
   g_assert (G_IS_ASYNC_RESULT (result));
-  g_assert (IDE_IS_TASK (task));
+  g_assert (job != NULL);
+  g_assert (IDE_IS_TASK (job->task));
 
-  cancellable = ide_task_get_cancellable (task);
+  task = g_steal_pointer (&job->task);
   state = ide_task_get_task_data (task);
 
   g_assert (state != NULL);
@@ -359,21 +479,108 @@ ide_test_manager_run_all_cb (GObject      *object,
   if (!ide_test_manager_run_finish (self, result, &error))
     g_message ("%s", error->message);
 
-  if (state->tests->len > 0 &&
-      !g_cancellable_is_cancelled (cancellable))
+  state->n_active--;
+  state->n_serial -= job->serial;
+  state->n_exclusive -= job->exclusive;
+
+  g_slice_free (RunAllJob, job);
+
+  ide_test_manager_run_all_schedule (self, task);
+
+  if (state->n_active == 0)
+    ide_task_return_boolean (task, TRUE);
+
+  IDE_EXIT;
+}
+
+/*
+ * Starts as many of the pending tests as the resource tags allow. The
+ * tests are started in order except that a "serial" test may be skipped
+ * while another one is running. An "exclusive" test at the head of the
+ * queue waits for the running tests to complete instead of letting the
+ * tests behind it start, so that it does not starve.
+ */
+static void
+ide_test_manager_run_all_schedule (IdeTestManager *self,
+                                   IdeTask        *task)
+{
+  GCancellable *cancellable;
+  RunAll *state;
+  guint i = 0;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_TEST_MANAGER (self));
+  g_assert (IDE_IS_TASK (task));
+
+  state = ide_task_get_task_data (task);
+  cancellable = ide_task_get_cancellable (task);
+
+  if (g_cancellable_is_cancelled (cancellable))
+    return;
+
+  while (i < state->tests->len &&
+         state->n_active < state->max_active &&
+         state->n_exclusive == 0)
     {
-      g_autoptr(IdeTest) next_test = g_ptr_array_steal_index (state->tests, state->tests->len-1);
+      IdeTest *test = g_ptr_array_index (state->tests, i);
+      IdeRunCommand *run_command = ide_test_get_run_command (test);
+      gboolean exclusive = ide_run_command_has_tag (run_command, "exclusive");
+      gboolean serial = ide_run_command_has_tag (run_command, "serial");
+      g_autoptr(IdeTest) next_test = NULL;
+      RunAllJob *job;
+
+      if (exclusive && state->n_active > 0)
+        break;
+
+      if (serial && state->n_serial > 0)
+        {
+          i++;
+          continue;
+        }
+
+      next_test = g_ptr_array_steal_index (state->tests, i);
+
+      job = g_slice_new0 (RunAllJob);
+      job->task = g_object_ref (task);
+      job->serial = !!serial;
+      job->exclusive = !!exclusive;
 
       state->n_active++;
+      state->n_serial += job->serial;
+      state->n_exclusive += job->exclusive;
 
       ide_test_manager_run_async (self,
                                   next_test,
                                   cancellable,
                                   ide_test_manager_run_all_cb,
-                                  g_object_ref (task));
+                                  job);
     }
+}
 
-  state->n_active--;
+static void
+ide_test_manager_run_all_begin (IdeTestManager *self,
+                                IdeTask        *task)
+{
+  g_autoptr(IdeSettings) settings = NULL;
+  IdeContext *context;
+  RunAll *state;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_TEST_MANAGER (self));
+  g_assert (IDE_IS_TASK (task));
+
+  state = ide_task_get_task_data (task);
+  context = ide_object_get_context (IDE_OBJECT (self));
+  settings = ide_context_ref_settings (context, "org.gnome.builder.project");
+
+  if (self->history != NULL)
+    ide_test_history_sort (self->history,
+                           state->tests,
+                           ide_settings_get_boolean (settings, "unit-test-failed-first"));
+
+  ide_test_manager_run_all_schedule (self, task);
 
   if (state->n_active == 0)
     ide_task_return_boolean (task, TRUE);
@@ -381,12 +588,85 @@ ide_test_manager_run_all_cb (GObject      *object,
   IDE_EXIT;
 }
 
+static void
+ide_test_manager_run_all_load_cb (GObject      *object,
+                                  GAsyncResult *result,
+                                  gpointer      user_data)
+{
+  IdeTestHistory *history = (IdeTestHistory *)object;
+  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(GError) error = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_TEST_HISTORY (history));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_TASK (task));
+
+  /* Without history, tests just run in the order they were listed */
+  if (!ide_test_history_load_finish (history, result, &error) &&
+      !ide_error_ignore (error))
+    g_warning ("Failed to load test history: %s", error->message);
+
+  ide_test_manager_run_all_begin (ide_task_get_source_object (task), task);
+
+  IDE_EXIT;
+}
+
+static void
+ide_test_manager_run_tests (IdeTestManager *self,
+                            IdeTask        *task,
+                            IdePipeline    *pipeline,
+                            GPtrArray      *tests)
+{
+  IdeTestHistory *history;
+  gboolean created;
+  RunAll *state;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_TEST_MANAGER (self));
+  g_assert (IDE_IS_TASK (task));
+  g_assert (IDE_IS_PIPELINE (pipeline));
+  g_assert (tests != NULL);
+
+  state = g_slice_new0 (RunAll);
+  state->tests = g_ptr_array_ref (tests);
+  state->pipeline = g_object_ref (pipeline);
+  state->n_active = 0;
+  state->max_active = MAX (1, g_get_num_processors ());
+  ide_task_set_task_data (task, state, run_all_free);
+
+  history = ide_test_manager_ensure_history (self, pipeline, &created);
+
+  if (created)
+    ide_test_history_load_async (history,
+                                 ide_task_get_cancellable (task),
+                                 ide_test_manager_run_all_load_cb,
+                                 g_object_ref (task));
+  else
+    ide_test_manager_run_all_begin (self, task);
+}
+
 static void
 ide_test_manager_emit_end_test_all (IdeTestManager *self)
 {
   g_signal_emit (self, signals [END_TEST_ALL], 0);
 }
 
+static IdePipeline *
+ide_test_manager_get_pipeline (IdeTestManager *self)
+{
+  IdeBuildManager *build_manager;
+  IdeContext *context;
+
+  g_assert (IDE_IS_TEST_MANAGER (self));
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  build_manager = ide_build_manager_from_context (context);
+
+  return ide_build_manager_get_pipeline (build_manager);
+}
+
 /**
  * ide_test_manager_run_all_async:
  * @self: An #IdeTestManager
@@ -394,7 +674,8 @@ ide_test_manager_emit_end_test_all (IdeTestManager *self)
  * @callback: a callback to execute upon completion
  * @user_data: user data for @callback
  *
- * Executes all tests in an undefined order.
+ * Executes all tests, starting with those which took the longest the
+ * last time they ran.
  *
  * Upon completion, @callback will be executed which must call
  * ide_test_manager_run_all_finish() to get the result.
@@ -410,11 +691,8 @@ ide_test_manager_run_all_async (IdeTestManager      *self,
 {
   g_autoptr(IdeTask) task = NULL;
   g_autoptr(GPtrArray) ar = NULL;
-  IdeBuildManager *build_manager;
   IdePipeline *pipeline;
   GListModel *tests;
-  IdeContext *context;
-  RunAll *state;
   guint n_items;
 
   IDE_ENTRY;
@@ -428,11 +706,7 @@ ide_test_manager_run_all_async (IdeTestManager      *self,
   if (ide_task_return_error_if_cancelled (task))
     IDE_EXIT;
 
-  context = ide_object_get_context (IDE_OBJECT (self));
-  build_manager = ide_build_manager_from_context (context);
-  pipeline = ide_build_manager_get_pipeline (build_manager);
-
-  if (pipeline == NULL)
+  if (!(pipeline = ide_test_manager_get_pipeline (self)))
     {
       ide_task_return_new_error (task,
                                  G_IO_ERROR,
@@ -451,33 +725,13 @@ ide_test_manager_run_all_async (IdeTestManager      *self,
   n_items = g_list_model_get_n_items (tests);
 
   ar = g_ptr_array_new_with_free_func (g_object_unref);
-  for (guint i = n_items; i > 0; i--)
-    g_ptr_array_add (ar, g_list_model_get_item (tests, i-1));
-
-  state = g_slice_new0 (RunAll);
-  state->tests = g_ptr_array_ref (ar);
-  state->pipeline = g_object_ref (pipeline);
-  state->n_active = 0;
-  ide_task_set_task_data (task, state, run_all_free);
-
-  for (guint i = 0; i < MAX_UNIT_TESTS && ar->len > 0; i++)
-    {
-      g_autoptr(IdeTest) test = g_ptr_array_steal_index (state->tests, ar->len-1);
-
-      state->n_active++;
-
-      ide_test_manager_run_async (self,
-                                  test,
-                                  cancellable,
-                                  ide_test_manager_run_all_cb,
-                                  g_object_ref (task));
-    }
-
-  if (state->n_active == 0)
-    ide_task_return_boolean (task, TRUE);
+  for (guint i = 0; i < n_items; i++)
+    g_ptr_array_add (ar, g_list_model_get_item (tests, i));
 
   g_signal_emit (self, signals[BEGIN_TEST_ALL], 0);
 
+  ide_test_manager_run_tests (self, task, pipeline, ar);
+
   IDE_EXIT;
 }
 
@@ -512,6 +766,230 @@ ide_test_manager_run_all_finish (IdeTestManager  *self,
   IDE_RETURN (ret);
 }
 
+/*
+ * A test is affected by the changes if one of the files it is built from
+ * changed, or a file in the same directory as one of them. The latter
+ * catches headers and other files the build system does not report.
+ * Tests without any information from the build system always run.
+ */
+static gboolean
+test_is_affected (IdeTest    *test,
+                  GHashTable *changed_files,
+                  GHashTable *changed_dirs)
+{
+  const char * const *sources;
+
+  g_assert (IDE_IS_TEST (test));
+
+  sources = ide_run_command_get_sources (ide_test_get_run_command (test));
+
+  if (sources == NULL || sources[0] == NULL)
+    return TRUE;
+
+  for (guint i = 0; sources[i]; i++)
+    {
+      g_autofree char *dir = NULL;
+
+      if (g_hash_table_contains (changed_files, sources[i]))
+        return TRUE;
+
+      dir = g_path_get_dirname (sources[i]);
+
+      if (g_hash_table_contains (changed_dirs, dir))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+ide_test_manager_list_status_cb (GObject      *object,
+                                 GAsyncResult *result,
+                                 gpointer      user_data)
+{
+  IdeVcs *vcs = (IdeVcs *)object;
+  g_autoptr(GHashTable) changed_files = NULL;
+  g_autoptr(GHashTable) changed_dirs = NULL;
+  g_autoptr(GListModel) status = NULL;
+  g_autoptr(GPtrArray) ar = NULL;
+  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(GError) error = NULL;
+  IdeTestManager *self;
+  IdePipeline *pipeline;
+  GListModel *tests;
+  guint n_items;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_VCS (vcs));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_TASK (task));
+
+  self = ide_task_get_source_object (task);
+
+  if (!(status = ide_vcs_list_status_finish (vcs, result, &error)))
+    {
+      ide_task_return_error (task, g_steal_pointer (&error));
+      IDE_EXIT;
+    }
+
+  if (!(pipeline = ide_test_manager_get_pipeline (self)))
+    {
+      ide_task_return_new_error (task,
+                                 G_IO_ERROR,
+                                 G_IO_ERROR_NOT_INITIALIZED,
+                                 "Cannot run test until pipeline is ready");
+      IDE_EXIT;
+    }
+
+  changed_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  changed_dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  n_items = g_list_model_get_n_items (status);
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autoptr(IdeVcsFileInfo) info = g_list_model_get_item (status, i);
+      GFile *file = ide_vcs_file_info_get_file (info);
+      IdeVcsFileStatus file_status = ide_vcs_file_info_get_status (info);
+      const char *path;
+
+      if (file_status == IDE_VCS_FILE_STATUS_IGNORED ||
+          file_status == IDE_VCS_FILE_STATUS_UNCHANGED ||
+          file == NULL ||
+          !(path = g_file_peek_path (file)))
+        continue;
+
+      g_hash_table_add (changed_files, g_strdup (path));
+      g_hash_table_add (changed_dirs, g_path_get_dirname (path));
+    }
+
+  IDE_TRACE_MSG ("%u files changed", g_hash_table_size (changed_files));
+
+  tests = ide_test_manager_list_tests (self);
+  n_items = g_list_model_get_n_items (tests);
+
+  ar = g_ptr_array_new_with_free_func (g_object_unref);
+
+  if (g_hash_table_size (changed_files) > 0)
+    {
+      for (guint i = 0; i < n_items; i++)
+        {
+          g_autoptr(IdeTest) test = g_list_model_get_item (tests, i);
+
+          if (test_is_affected (test, changed_files, changed_dirs))
+            g_ptr_array_add (ar, g_steal_pointer (&test));
+        }
+    }
+
+  ide_test_manager_run_tests (self, task, pipeline, ar);
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_test_manager_run_changed_async:
+ * @self: An #IdeTestManager
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @callback: a callback to execute upon completion
+ * @user_data: user data for @callback
+ *
+ * Executes the tests affected by the files which were changed according
+ * to the version control system.
+ *
+ * Which files a test is built from is provided by the build system via
+ * #IdeRunCommand:sources. Tests for which that is unknown are always run.
+ *
+ * Upon completion, @callback will be executed which must call
+ * ide_test_manager_run_changed_finish() to get the result.
+ *
+ * Since: 50
+ */
+void
+ide_test_manager_run_changed_async (IdeTestManager      *self,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
+{
+  g_autoptr(IdeTask) task = NULL;
+  g_autoptr(GFile) workdir = NULL;
+  IdeContext *context;
+  IdeVcs *vcs;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_TEST_MANAGER (self));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = ide_task_new (self, cancellable, callback, user_data);
+  ide_task_set_source_tag (task, ide_test_manager_run_changed_async);
+
+  if (ide_task_return_error_if_cancelled (task))
+    IDE_EXIT;
+
+  if (ide_test_manager_get_pipeline (self) == NULL)
+    {
+      ide_task_return_new_error (task,
+                                 G_IO_ERROR,
+                                 G_IO_ERROR_NOT_INITIALIZED,
+                                 "Cannot run test until pipeline is ready");
+      IDE_EXIT;
+    }
+
+  g_signal_connect_object (task,
+                           "notify::completed",
+                           G_CALLBACK (ide_test_manager_emit_end_test_all),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  g_signal_emit (self, signals[BEGIN_TEST_ALL], 0);
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  vcs = ide_vcs_from_context (context);
+  workdir = ide_context_ref_workdir (context);
+
+  ide_vcs_list_status_async (vcs,
+                             workdir,
+                             TRUE,
+                             G_PRIORITY_LOW,
+                             cancellable,
+                             ide_test_manager_list_status_cb,
+                             g_steal_pointer (&task));
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_test_manager_run_changed_finish:
+ * @self: An #IdeTestManager
+ * @result: a #GAsyncResult
+ * @error: a location for a #GError, or %NULL
+ *
+ * Completes an asynchronous request to execute the tests affected by
+ * changes to the project.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ *
+ * Since: 50
+ */
+gboolean
+ide_test_manager_run_changed_finish (IdeTestManager  *self,
+                                     GAsyncResult    *result,
+                                     GError         **error)
+{
+  gboolean ret;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_TEST_MANAGER (self), FALSE);
+  g_return_val_if_fail (IDE_IS_TASK (result), FALSE);
+
+  ret = ide_task_propagate_boolean (IDE_TASK (result), error);
+
+  IDE_RETURN (ret);
+}
+
 static void
 ide_test_manager_run_cb (GObject      *object,
                          GAsyncResult *result,
@@ -520,6 +998,9 @@ ide_test_manager_run_cb (GObject      *object,
   IdeTest *test = (IdeTest *)object;
   g_autoptr(IdeTask) task = user_data;
   g_autoptr(GError) error = NULL;
+  IdeTestManager *self;
+  RunOne *run;
+  gboolean ret;
 
   IDE_ENTRY;
 
@@ -528,7 +1009,25 @@ ide_test_manager_run_cb (GObject      *object,
   g_assert (G_IS_ASYNC_RESULT (result));
   g_assert (IDE_IS_TASK (task));
 
-  if (!ide_test_run_finish (test, result, &error))
+  self = ide_task_get_source_object (task);
+  run = ide_task_get_task_data (task);
+  ret = ide_test_run_finish (test, result, &error);
+
+  /* A cancelled test says nothing about how long the test takes */
+  if (run != NULL &&
+      !g_cancellable_is_cancelled (ide_task_get_cancellable (task)) &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      ide_test_history_record (run->history,
+                               ide_test_get_id (test),
+                               g_get_monotonic_time () - run->begin_time,
+                               ide_test_get_status (test) == IDE_TEST_STATUS_FAILED);
+
+      if (run->history == self->history)
+        self->history_dirty = TRUE;
+    }
+
+  if (!ret)
     ide_task_return_error (task, g_steal_pointer (&error));
   else
     ide_task_return_boolean (task, TRUE);
@@ -548,7 +1047,15 @@ ide_test_manager_test_notify_completed_cb (IdeTestManager *self,
   self->n_active--;
 
   if (self->n_active == 0)
-    ide_test_manager_set_action_enabled (self, "cancel", FALSE);
+    {
+      ide_test_manager_set_action_enabled (self, "cancel", FALSE);
+
+      if (self->history != NULL && self->history_dirty)
+        {
+          self->history_dirty = FALSE;
+          ide_test_history_save (self->history);
+        }
+    }
 }
 
 /**
@@ -572,9 +1079,7 @@ ide_test_manager_run_async (IdeTestManager      *self,
                             gpointer             user_data)
 {
   g_autoptr(IdeTask) task = NULL;
-  IdeBuildManager *build_manager;
   IdePipeline *pipeline;
-  IdeContext *context;
 
   IDE_ENTRY;
 
@@ -599,9 +1104,7 @@ ide_test_manager_run_async (IdeTestManager      *self,
   if (ide_task_return_error_if_cancelled (task))
     IDE_EXIT;
 
-  context = ide_object_get_context (IDE_OBJECT (self));
-  build_manager = ide_build_manager_from_context (context);
-  pipeline = ide_build_manager_get_pipeline (build_manager);
+  pipeline = ide_test_manager_get_pipeline (self);
 
   if (self->pty_producer == -1)
     {
@@ -610,17 +1113,39 @@ ide_test_manager_run_async (IdeTestManager      *self,
     }
 
   if (pipeline == NULL)
-    ide_task_return_new_error (task,
-                               G_IO_ERROR,
-                               G_IO_ERROR_NOT_INITIALIZED,
-                               "Pipeline is not ready, cannot run test");
+    {
+      ide_task_return_new_error (task,
+                                 G_IO_ERROR,
+                                 G_IO_ERROR_NOT_INITIALIZED,
+                                 "Pipeline is not ready, cannot run test");
+    }
   else
-    ide_test_run_async (test,
-                        pipeline,
-                        self->pty_producer,
-                        cancellable,
-                        ide_test_manager_run_cb,
-                        g_steal_pointer (&task));
+    {
+      IdeTestHistory *history;
+      gboolean created;
+      RunOne *run;
+
+      history = ide_test_manager_ensure_history (self, pipeline, &created);
+
+      /* Anything recorded while loading is kept */
+      if (created)
+        ide_test_history_load_async (history,
+                                     NULL,
+                                     ide_test_manager_load_history_cb,
+                                     NULL);
+
+      run = g_slice_new0 (RunOne);
+      run->history = g_object_ref (history);
+      run->begin_time = g_get_monotonic_time ();
+      ide_task_set_task_data (task, run, run_one_free);
+
+      ide_test_run_async (test,
+                          pipeline,
+                          self->pty_producer,
+                          cancellable,
+                          ide_test_manager_run_cb,
+                          g_steal_pointer (&task));
+    }
 
   IDE_EXIT;
 }
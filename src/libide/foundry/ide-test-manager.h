@@ -62,5 +62,14 @@ IDE_AVAILABLE_IN_ALL
 gboolean         ide_test_manager_run_all_finish       (IdeTestManager       *self,
                                                         GAsyncResult         *result,
                                                         GError              **error);
+IDE_AVAILABLE_IN_50
+void             ide_test_manager_run_changed_async    (IdeTestManager       *self,
+                                                        GCancellable         *cancellable,
+                                                        GAsyncReadyCallback   callback,
+                                                        gpointer              user_data);
+IDE_AVAILABLE_IN_50
+gboolean         ide_test_manager_run_changed_finish   (IdeTestManager       *self,
+                                                        GAsyncResult         *result,
+                                                        GError              **error);
 
 G_END_DECLS
@@ -30,6 +30,7 @@
 #include <ide-build-ident.h>
 
 #include "ide-support-private.h"
+#include "ide-task-cache-private.h"
 
 typedef struct
 {
@@ -91,6 +92,7 @@ ide_get_support_log (void)
   GDateTime *now;
   GDateTime *started_at;
   GString *str;
+  GArray *caches;
   gchar *tmp;
   gchar **env;
   guint n_items;
@@ -207,6 +209,30 @@ ide_get_support_log (void)
     }
   g_string_append (str, "\n");
 
+  /*
+   * Log the caches and how well they are doing.
+   */
+  g_string_append (str, "[runtime.caches]\n");
+  caches = _ide_task_cache_list_stats ();
+  for (guint i = 0; i < caches->len; i++)
+    {
+      const IdeTaskCacheStats *stats = &g_array_index (caches, IdeTaskCacheStats, i);
+      guint64 n_requests = stats->n_hits + stats->n_misses;
+
+      g_string_append_printf (str,
+                              "\"%s\" = { entries = %u, bytes = %"G_GSIZE_FORMAT", "
+                              "max_bytes = %"G_GSIZE_FORMAT", hit_rate = %.2lf, "
+                              "evictions = %"G_GUINT64_FORMAT" }\n",
+                              stats->name,
+                              stats->n_items,
+                              stats->size,
+                              stats->max_size,
+                              n_requests ? (double)stats->n_hits / n_requests : .0,
+                              stats->n_evictions);
+    }
+  g_clear_pointer (&caches, g_array_unref);
+  g_string_append (str, "\n");
+
   /*
    * Log the environment variables.
    */
@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <glib-unix.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
@@ -38,25 +39,56 @@
 #include "ide-pty-intercept.h"
 
 /*
- * We really don't need all that much. A PTY on Linux has a some amount of
- * kernel memory that is non-pageable and therefore small in size. 4k is what
- * it appears to be. Anything more than that is really just an opportunity for
- * us to break some deadlock scenarios.
+ * Forwarding happens on a dedicated thread so that a process which
+ * spews output does not cost the main loop a wakeup per PTY buffer.
+ * Buffers start small and grow while the inferior keeps filling them.
+ *
+ * splice() would require one end to be a pipe, so the data is copied
+ * once through userspace with plain read() and write().
  */
-#define CHANNEL_BUFFER_SIZE (4096 * 4)
-#define SLAVE_READ_PRIORITY   G_PRIORITY_HIGH
-#define SLAVE_WRITE_PRIORITY  G_PRIORITY_DEFAULT_IDLE
-#define MASTER_READ_PRIORITY  G_PRIORITY_DEFAULT_IDLE
-#define MASTER_WRITE_PRIORITY G_PRIORITY_HIGH
-
-static void     _ide_pty_intercept_side_close (IdePtyInterceptSide *side);
-static gboolean _ide_pty_intercept_in_cb      (GIOChannel          *channel,
-                                               GIOCondition         condition,
-                                               gpointer             user_data);
-static gboolean _ide_pty_intercept_out_cb     (GIOChannel          *channel,
-                                               GIOCondition         condition,
-                                               gpointer             user_data);
-static void     clear_source                  (guint               *source_id);
+#define INITIAL_BUFFER_SIZE    (4096 * 4)
+#define MAX_BUFFER_SIZE        (1024 * 256)
+#define MAX_OBSERVED_SIZE      (1024 * 1024 * 4)
+#define DISPATCH_INTERVAL_USEC (G_USEC_PER_SEC / 30)
+#define DISPATCH_PRIORITY      G_PRIORITY_DEFAULT_IDLE
+
+enum {
+  DIRECTION_FROM_CONSUMER,
+  DIRECTION_FROM_PRODUCER,
+  N_DIRECTIONS
+};
+
+typedef struct
+{
+  guint8 *data;
+  gsize   size;
+  gsize   begin;
+  gsize   end;
+} PumpBuffer;
+
+typedef struct
+{
+  IdePtyFd    in_fd;
+  IdePtyFd    out_fd;
+  PumpBuffer  buffer;
+  /* Copy of what was read for the callback, protected by the mutex */
+  GByteArray *observed;
+  int         observe;
+} PumpDirection;
+
+struct _IdePtyInterceptPump
+{
+  GMutex         mutex;
+  GThread       *thread;
+  GSource       *dispatch;
+  IdePtyFd       wakeup[2];
+  PumpDirection  directions[N_DIRECTIONS];
+  gint64         last_dispatch;
+  int            stopping;
+  guint          dispatch_queued : 1;
+  guint          throttled : 1;
+  guint          closed : 1;
+};
 
 static gboolean
 _ide_pty_intercept_set_raw (IdePtyFd fd)
@@ -206,202 +238,410 @@ ide_pty_intercept_create_consumer (void)
 }
 
 static void
-clear_source (guint *source_id)
+pump_buffer_clear (PumpBuffer *buffer)
+{
+  g_clear_pointer (&buffer->data, g_free);
+  buffer->size = 0;
+  buffer->begin = 0;
+  buffer->end = 0;
+}
+
+static gboolean
+pump_buffer_has_room (const PumpBuffer *buffer)
 {
-  guint id = *source_id;
-  *source_id = 0;
-  if (id != 0)
-    g_source_remove (id);
+  return buffer->end - buffer->begin < MAX_BUFFER_SIZE;
 }
 
 static void
-_ide_pty_intercept_side_close (IdePtyInterceptSide *side)
+pump_wakeup (IdePtyInterceptPump *pump)
 {
-  g_assert (side != NULL);
+  static const char b = 1;
 
-  clear_source (&side->in_watch);
-  clear_source (&side->out_watch);
-  g_clear_pointer (&side->channel, g_io_channel_unref);
-  g_clear_pointer (&side->out_bytes, g_bytes_unref);
+  /* A full pipe means the thread is already going to wake up */
+  while (write (pump->wakeup[1], &b, 1) < 0 && errno == EINTR) { }
 }
 
+static void
+pump_queue_dispatch_locked (IdePtyInterceptPump *pump)
+{
+  if (!pump->dispatch_queued)
+    {
+      gint64 now = g_get_monotonic_time ();
+
+      pump->dispatch_queued = TRUE;
+      g_source_set_ready_time (pump->dispatch,
+                               MAX (now, pump->last_dispatch + DISPATCH_INTERVAL_USEC));
+    }
+}
+
+/*
+ * pump_flush:
+ *
+ * Writes as much of the pending data to the other side as it will
+ * currently accept. Anything left over is written after poll() tells
+ * us the other side is writable again.
+ *
+ * Returns: %FALSE if the other side has gone away.
+ */
 static gboolean
-_ide_pty_intercept_out_cb (GIOChannel   *channel,
-                           GIOCondition  condition,
-                           gpointer      user_data)
+pump_flush (PumpDirection *direction)
 {
-  IdePtyIntercept *self = user_data;
-  IdePtyInterceptSide *us, *them;
-  GIOStatus status;
-  const gchar *wrbuf;
-  gsize n_written = 0;
-  gsize len = 0;
+  PumpBuffer *buffer = &direction->buffer;
 
-  g_assert (channel != NULL);
-  g_assert (condition & (G_IO_ERR | G_IO_HUP | G_IO_OUT));
+  while (buffer->begin < buffer->end)
+    {
+      gssize n_written = write (direction->out_fd,
+                                buffer->data + buffer->begin,
+                                buffer->end - buffer->begin);
+
+      if (n_written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+      buffer->begin += n_written;
+    }
+
+  buffer->begin = 0;
+  buffer->end = 0;
+
+  return TRUE;
+}
+
+/*
+ * pump_read:
+ *
+ * Reads from one side directly into the buffer that will be written
+ * to the other side, so there is no copy unless somebody observes the
+ * data. The buffer doubles in size each time a read fills it so that
+ * noisy processes are drained with fewer wakeups.
+ *
+ * The caller is responsible for flushing what was read.
+ *
+ * Returns: %FALSE if this side has hung up.
+ */
+static gboolean
+pump_read (IdePtyInterceptPump *pump,
+           PumpDirection       *direction)
+{
+  PumpBuffer *buffer = &direction->buffer;
+  gssize n_read;
+  gsize avail;
 
-  if (channel == self->consumer.channel)
+  if (buffer->begin > 0 && buffer->end == buffer->size)
     {
-      us = &self->consumer;
-      them = &self->producer;
+      memmove (buffer->data, buffer->data + buffer->begin, buffer->end - buffer->begin);
+      buffer->end -= buffer->begin;
+      buffer->begin = 0;
     }
-  else
+
+  if (buffer->end == buffer->size)
     {
-      us = &self->producer;
-      them = &self->consumer;
+      buffer->size = buffer->size ? MIN (buffer->size * 2, MAX_BUFFER_SIZE) : INITIAL_BUFFER_SIZE;
+      buffer->data = g_realloc (buffer->data, buffer->size);
+
+      if (buffer->end == buffer->size)
+        return TRUE;
     }
 
-  if ((condition & G_IO_OUT) == 0 ||
-      us->out_bytes == NULL ||
-      us->channel == NULL ||
-      them->channel == NULL)
-    goto close_and_cleanup;
+  avail = buffer->size - buffer->end;
 
-  wrbuf = g_bytes_get_data (us->out_bytes, &len);
-  status = g_io_channel_write_chars (us->channel, wrbuf, len, &n_written, NULL);
-  if (status != G_IO_STATUS_NORMAL)
-    goto close_and_cleanup;
+  do
+    n_read = read (direction->in_fd, buffer->data + buffer->end, avail);
+  while (n_read < 0 && errno == EINTR);
 
-  g_assert (n_written > 0);
-  g_assert (them->in_watch == 0);
+  if (n_read < 0)
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+  else if (n_read == 0)
+    return FALSE;
 
-  /*
-   * If we didn't write all of our data, wait until another G_IO_OUT
-   * condition to write more data.
-   */
-  if (n_written < len)
+  if (g_atomic_int_get (&direction->observe))
     {
-      g_autoptr(GBytes) bytes = g_steal_pointer (&us->out_bytes);
-      us->out_bytes = g_bytes_new_from_bytes (bytes, n_written, len - n_written);
-      return G_SOURCE_CONTINUE;
-    }
+      g_mutex_lock (&pump->mutex);
 
-  g_clear_pointer (&us->out_bytes, g_bytes_unref);
+      if (direction->observed == NULL)
+        direction->observed = g_byte_array_sized_new (n_read);
+      g_byte_array_append (direction->observed, buffer->data + buffer->end, n_read);
 
-  /*
-   * We wrote all the data to this side, so now we can wait for more
-   * data from the input peer.
-   */
-  us->out_watch = 0;
-  them->in_watch =
-    g_io_add_watch_full (them->channel,
-                         them->read_prio,
-                         G_IO_IN | G_IO_ERR | G_IO_HUP,
-                         _ide_pty_intercept_in_cb,
-                         self, NULL);
+      /* Stop reading until the main thread catches up with us */
+      if (direction->observed->len >= MAX_OBSERVED_SIZE)
+        pump->throttled = TRUE;
 
-  return G_SOURCE_REMOVE;
+      pump_queue_dispatch_locked (pump);
 
-close_and_cleanup:
+      g_mutex_unlock (&pump->mutex);
+    }
+
+  buffer->end += n_read;
 
-  _ide_pty_intercept_side_close (us);
-  _ide_pty_intercept_side_close (them);
+  if ((gsize)n_read == avail && buffer->size < MAX_BUFFER_SIZE)
+    {
+      buffer->size = MIN (buffer->size * 2, MAX_BUFFER_SIZE);
+      buffer->data = g_realloc (buffer->data, buffer->size);
+    }
 
-  return G_SOURCE_REMOVE;
+  return TRUE;
 }
 
 /*
- * _ide_pty_intercept_in_cb:
- *
- * This function is called when we have received a condition that specifies
- * the channel has data to read. We read that data and then setup a watch
- * onto the other other side so that we can write that data.
- *
- * If the other-side of the of the connection can write, then we write
- * that data immediately.
+ * pump_drain:
  *
- * The in watch is disabled until we have completed the write.
+ * Called once the input side of @direction has hung up, such as when
+ * the inferior exits. Data already read may still be waiting for the
+ * other side to accept it and must not be dropped, so keep waiting for
+ * the other side to become writable until the buffer is empty, the
+ * other side goes away too, or the pump is stopped.
  */
-static gboolean
-_ide_pty_intercept_in_cb (GIOChannel   *channel,
-                          GIOCondition  condition,
-                          gpointer      user_data)
+static void
+pump_drain (IdePtyInterceptPump *pump,
+            PumpDirection       *direction)
 {
-  IdePtyIntercept *self = user_data;
-  IdePtyInterceptSide *us, *them;
-  GIOStatus status = G_IO_STATUS_AGAIN;
-  gchar buf[4096];
-  gchar *wrbuf = buf;
-  gsize n_read;
-
-  g_assert (channel != NULL);
-  g_assert (condition & (G_IO_ERR | G_IO_HUP | G_IO_IN));
-  g_assert (IDE_IS_PTY_INTERCEPT (self));
+  PumpBuffer *buffer = &direction->buffer;
 
-  if (channel == self->consumer.channel)
+  while (buffer->begin < buffer->end && !g_atomic_int_get (&pump->stopping))
     {
-      us = &self->consumer;
-      them = &self->producer;
-    }
-  else
-    {
-      us = &self->producer;
-      them = &self->consumer;
-    }
+      struct pollfd pfd[2] = {
+        { .fd = pump->wakeup[0], .events = POLLIN },
+        { .fd = direction->out_fd, .events = POLLOUT },
+      };
 
-  g_assert (us->in_watch != 0);
-  g_assert (them->out_watch == 0);
+      if (poll (pfd, G_N_ELEMENTS (pfd), -1) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          break;
+        }
 
-  if (condition & (G_IO_ERR | G_IO_HUP) || us->channel == NULL || them->channel == NULL)
-    goto close_and_cleanup;
+      if (pfd[0].revents & POLLIN)
+        {
+          char buf[32];
 
-  g_assert (condition & G_IO_IN);
+          while (read (pump->wakeup[0], buf, sizeof buf) > 0) { }
+        }
 
-  while (status == G_IO_STATUS_AGAIN)
-    {
-      n_read = 0;
-      status = g_io_channel_read_chars (us->channel, buf, sizeof buf, &n_read, NULL);
+      if (pfd[1].revents != 0 &&
+          (!(pfd[1].revents & POLLOUT) || !pump_flush (direction)))
+        break;
     }
+}
 
-  if (status == G_IO_STATUS_EOF)
-    goto close_and_cleanup;
+static gpointer
+pump_thread (gpointer data)
+{
+  IdePtyInterceptPump *pump = data;
 
-  if (n_read > 0 && us->callback != NULL)
-    us->callback (self, us, (const guint8 *)buf, n_read, us->callback_data);
+  g_assert (pump != NULL);
 
-  while (n_read > 0)
+  while (!g_atomic_int_get (&pump->stopping))
     {
-      gsize n_written = 0;
+      struct pollfd pfd[1 + N_DIRECTIONS * 2];
+      int in_index[N_DIRECTIONS];
+      int out_index[N_DIRECTIONS];
+      gboolean throttled;
+      guint n_pfd = 0;
+
+      g_mutex_lock (&pump->mutex);
+      throttled = pump->throttled;
+      g_mutex_unlock (&pump->mutex);
+
+      pfd[n_pfd].fd = pump->wakeup[0];
+      pfd[n_pfd].events = POLLIN;
+      pfd[n_pfd].revents = 0;
+      n_pfd++;
+
+      for (guint i = 0; i < N_DIRECTIONS; i++)
+        {
+          PumpDirection *direction = &pump->directions[i];
+
+          in_index[i] = -1;
+          out_index[i] = -1;
+
+          if (!throttled && pump_buffer_has_room (&direction->buffer))
+            {
+              in_index[i] = n_pfd;
+              pfd[n_pfd].fd = direction->in_fd;
+              pfd[n_pfd].events = POLLIN;
+              pfd[n_pfd].revents = 0;
+              n_pfd++;
+            }
+
+          if (direction->buffer.begin < direction->buffer.end)
+            {
+              out_index[i] = n_pfd;
+              pfd[n_pfd].fd = direction->out_fd;
+              pfd[n_pfd].events = POLLOUT;
+              pfd[n_pfd].revents = 0;
+              n_pfd++;
+            }
+        }
 
-      status = g_io_channel_write_chars (them->channel, buf, n_read, &n_written, NULL);
+      if (poll (pfd, n_pfd, -1) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          break;
+        }
 
-      wrbuf += n_written;
-      n_read -= n_written;
+      if (pfd[0].revents & POLLIN)
+        {
+          char buf[32];
+
+          while (read (pump->wakeup[0], buf, sizeof buf) > 0) { }
+        }
 
-      if (n_read > 0 && status == G_IO_STATUS_AGAIN)
+      for (guint i = 0; i < N_DIRECTIONS; i++)
         {
-          /* If we get G_IO_STATUS_AGAIN here, then we are in a situation where
-           * the other side is not in a position to handle the data. We need to
-           * setup a G_IO_OUT watch on the FD to wait until things are writeable.
-           *
-           * We'll cancel our G_IO_IN condition, and wait for the out condition
-           * to make forward progress.
-           */
-          them->out_bytes = g_bytes_new (wrbuf, n_read);
-          them->out_watch = g_io_add_watch_full (them->channel,
-                                                 them->write_prio,
-                                                 G_IO_OUT | G_IO_ERR | G_IO_HUP,
-                                                 _ide_pty_intercept_out_cb,
-                                                 self, NULL);
-          us->in_watch = 0;
-
-          return G_SOURCE_REMOVE;
+          PumpDirection *direction = &pump->directions[i];
+
+          if (out_index[i] != -1 && pfd[out_index[i]].revents != 0)
+            {
+              if (!(pfd[out_index[i]].revents & POLLOUT) || !pump_flush (direction))
+                goto hangup;
+            }
+
+          if (in_index[i] != -1 && pfd[in_index[i]].revents != 0)
+            {
+              /* Read what is left before honoring POLLHUP, then make sure
+               * everything read so far reaches the other side.
+               */
+              if (!(pfd[in_index[i]].revents & POLLIN) || !pump_read (pump, direction))
+                {
+                  pump_drain (pump, direction);
+                  goto hangup;
+                }
+
+              if (!pump_flush (direction))
+                goto hangup;
+            }
         }
+    }
+
+  return NULL;
+
+hangup:
+  g_mutex_lock (&pump->mutex);
+  pump->closed = TRUE;
+  pump_queue_dispatch_locked (pump);
+  g_mutex_unlock (&pump->mutex);
+
+  return NULL;
+}
+
+static gboolean
+pump_source_dispatch (GSource     *source,
+                      GSourceFunc  callback,
+                      gpointer     user_data)
+{
+  g_source_set_ready_time (source, -1);
+  return callback (user_data);
+}
 
-      if (status != G_IO_STATUS_NORMAL)
-        goto close_and_cleanup;
+static GSourceFuncs pump_source_funcs = {
+  .dispatch = pump_source_dispatch,
+};
 
-      g_io_channel_flush (them->channel, NULL);
+static void
+pump_stop (IdePtyInterceptPump *pump)
+{
+  g_assert (pump != NULL);
+
+  if (pump->thread != NULL)
+    {
+      g_atomic_int_set (&pump->stopping, TRUE);
+      pump_wakeup (pump);
+      g_clear_pointer (&pump->thread, g_thread_join);
     }
+}
 
-  return G_SOURCE_CONTINUE;
+static void
+pump_free (IdePtyInterceptPump *pump)
+{
+  pump_stop (pump);
 
-close_and_cleanup:
+  if (pump->dispatch != NULL)
+    {
+      g_source_destroy (pump->dispatch);
+      g_clear_pointer (&pump->dispatch, g_source_unref);
+    }
+
+  for (guint i = 0; i < N_DIRECTIONS; i++)
+    {
+      pump_buffer_clear (&pump->directions[i].buffer);
+      g_clear_pointer (&pump->directions[i].observed, g_byte_array_unref);
+    }
 
-  _ide_pty_intercept_side_close (us);
-  _ide_pty_intercept_side_close (them);
+  pty_fd_clear (&pump->wakeup[0]);
+  pty_fd_clear (&pump->wakeup[1]);
 
-  return G_SOURCE_REMOVE;
+  g_mutex_clear (&pump->mutex);
+  g_free (pump);
+}
+
+/*
+ * _ide_pty_intercept_deliver:
+ *
+ * Delivers everything the I/O thread read since the last delivery to
+ * the callbacks on the main context. This is rate limited to
+ * DISPATCH_INTERVAL_USEC so that a process flooding the PTY results in
+ * a few large chunks rather than thousands of main loop wakeups.
+ */
+static gboolean
+_ide_pty_intercept_deliver (gpointer user_data)
+{
+  IdePtyIntercept *self = user_data;
+  IdePtyInterceptPump *pump;
+  GByteArray *observed[N_DIRECTIONS];
+  IdePtyInterceptSide *sides[N_DIRECTIONS];
+  gboolean throttled;
+  gboolean closed;
+
+  g_assert (IDE_IS_PTY_INTERCEPT (self));
+  g_assert (self->pump != NULL);
+
+  pump = self->pump;
+  sides[DIRECTION_FROM_CONSUMER] = &self->consumer;
+  sides[DIRECTION_FROM_PRODUCER] = &self->producer;
+
+  g_mutex_lock (&pump->mutex);
+  pump->dispatch_queued = FALSE;
+  pump->last_dispatch = g_get_monotonic_time ();
+  for (guint i = 0; i < N_DIRECTIONS; i++)
+    observed[i] = g_steal_pointer (&pump->directions[i].observed);
+  throttled = pump->throttled;
+  pump->throttled = FALSE;
+  closed = pump->closed;
+  g_mutex_unlock (&pump->mutex);
+
+  if (throttled)
+    pump_wakeup (pump);
+
+  for (guint i = 0; i < N_DIRECTIONS; i++)
+    {
+      if (observed[i] == NULL)
+        continue;
+
+      if (observed[i]->len > 0 && sides[i]->callback != NULL)
+        sides[i]->callback (self,
+                            sides[i],
+                            observed[i]->data,
+                            observed[i]->len,
+                            sides[i]->callback_data);
+
+      g_byte_array_unref (observed[i]);
+    }
+
+  if (closed)
+    {
+      /* The thread has exited, so it is safe to close both sides */
+      pump_stop (pump);
+      pty_fd_clear (&self->consumer.fd);
+      pty_fd_clear (&self->producer.fd);
+    }
+
+  return G_SOURCE_CONTINUE;
 }
 
 /**
@@ -423,46 +663,19 @@ ide_pty_intercept_set_size (IdePtyIntercept *self,
 
   g_return_val_if_fail (IDE_IS_PTY_INTERCEPT (self), FALSE);
 
-  if (self->consumer.channel != NULL)
+  if (self->consumer.fd != IDE_PTY_FD_INVALID)
     {
-      IdePtyFd fd = g_io_channel_unix_get_fd (self->consumer.channel);
       struct winsize ws = {0};
 
       ws.ws_col = columns;
       ws.ws_row = rows;
 
-      return ioctl (fd, TIOCSWINSZ, &ws) == 0;
+      return ioctl (self->consumer.fd, TIOCSWINSZ, &ws) == 0;
     }
 
   return FALSE;
 }
 
-static guint
-_g_io_add_watch_full_with_context (GMainContext   *main_context,
-                                   GIOChannel     *channel,
-                                   gint            priority,
-                                   GIOCondition    condition,
-                                   GIOFunc         func,
-                                   gpointer        user_data,
-                                   GDestroyNotify  notify)
-{
-  GSource *source;
-  guint id;
-
-  g_return_val_if_fail (channel != NULL, 0);
-
-  source = g_io_create_watch (channel, condition);
-
-  if (priority != G_PRIORITY_DEFAULT)
-    g_source_set_priority (source, priority);
-  g_source_set_callback (source, (GSourceFunc)func, user_data, notify);
-
-  id = g_source_attach (source, main_context);
-  g_source_unref (source);
-
-  return id;
-}
-
 /**
  * ide_pty_intercept_init:
  * @self: a location of memory to store a #IdePtyIntercept
@@ -476,6 +689,10 @@ _g_io_add_watch_full_with_context (GMainContext   *main_context,
  * with another side, and will pass that information to @fd after
  * extracting any necessary information.
  *
+ * Data is forwarded between the two from a dedicated thread. Callbacks
+ * set with ide_pty_intercept_set_callback() are called from
+ * @main_context with the data batched up.
+ *
  * Returns: %TRUE if successful; otherwise %FALSE
  */
 gboolean
@@ -485,6 +702,7 @@ ide_pty_intercept_init (IdePtyIntercept *self,
 {
   g_auto(IdePtyFd) producer_fd = IDE_PTY_FD_INVALID;
   g_auto(IdePtyFd) consumer_fd = IDE_PTY_FD_INVALID;
+  IdePtyInterceptPump *pump;
   struct winsize ws;
 
   g_return_val_if_fail (self != NULL, FALSE);
@@ -492,6 +710,8 @@ ide_pty_intercept_init (IdePtyIntercept *self,
 
   memset (self, 0, sizeof *self);
   self->magic = IDE_PTY_INTERCEPT_MAGIC;
+  self->consumer.fd = IDE_PTY_FD_INVALID;
+  self->producer.fd = IDE_PTY_FD_INVALID;
 
   producer_fd = ide_pty_intercept_create_producer (fd, FALSE);
   if (producer_fd == IDE_PTY_FD_INVALID)
@@ -515,38 +735,33 @@ ide_pty_intercept_init (IdePtyIntercept *self,
   if (main_context == NULL)
     main_context = g_main_context_get_thread_default ();
 
-  self->consumer.read_prio = MASTER_READ_PRIORITY;
-  self->consumer.write_prio = MASTER_WRITE_PRIORITY;
-  self->producer.read_prio = SLAVE_READ_PRIORITY;
-  self->producer.write_prio = SLAVE_WRITE_PRIORITY;
-
-  self->consumer.channel = g_io_channel_unix_new (pty_fd_steal (&consumer_fd));
-  self->producer.channel = g_io_channel_unix_new (pty_fd_steal (&producer_fd));
+  pump = g_new0 (IdePtyInterceptPump, 1);
+  g_mutex_init (&pump->mutex);
+  pump->wakeup[0] = IDE_PTY_FD_INVALID;
+  pump->wakeup[1] = IDE_PTY_FD_INVALID;
+  self->pump = pump;
 
-  g_io_channel_set_close_on_unref (self->consumer.channel, TRUE);
-  g_io_channel_set_close_on_unref (self->producer.channel, TRUE);
+  if (!g_unix_open_pipe (pump->wakeup, FD_CLOEXEC, NULL) ||
+      !g_unix_set_fd_nonblocking (pump->wakeup[0], TRUE, NULL) ||
+      !g_unix_set_fd_nonblocking (pump->wakeup[1], TRUE, NULL))
+    return FALSE;
 
-  g_io_channel_set_encoding (self->consumer.channel, NULL, NULL);
-  g_io_channel_set_encoding (self->producer.channel, NULL, NULL);
+  self->consumer.fd = pty_fd_steal (&consumer_fd);
+  self->producer.fd = pty_fd_steal (&producer_fd);
 
-  g_io_channel_set_buffer_size (self->consumer.channel, CHANNEL_BUFFER_SIZE);
-  g_io_channel_set_buffer_size (self->producer.channel, CHANNEL_BUFFER_SIZE);
+  pump->directions[DIRECTION_FROM_CONSUMER].in_fd = self->consumer.fd;
+  pump->directions[DIRECTION_FROM_CONSUMER].out_fd = self->producer.fd;
+  pump->directions[DIRECTION_FROM_PRODUCER].in_fd = self->producer.fd;
+  pump->directions[DIRECTION_FROM_PRODUCER].out_fd = self->consumer.fd;
 
-  self->consumer.in_watch =
-    _g_io_add_watch_full_with_context (main_context,
-                                       self->consumer.channel,
-                                       self->consumer.read_prio,
-                                       G_IO_IN | G_IO_ERR | G_IO_HUP,
-                                       _ide_pty_intercept_in_cb,
-                                       self, NULL);
+  pump->dispatch = g_source_new (&pump_source_funcs, sizeof (GSource));
+  g_source_set_callback (pump->dispatch, _ide_pty_intercept_deliver, self, NULL);
+  g_source_set_priority (pump->dispatch, DISPATCH_PRIORITY);
+  g_source_set_static_name (pump->dispatch, "[ide-pty-intercept]");
+  g_source_attach (pump->dispatch, main_context);
 
-  self->producer.in_watch =
-    _g_io_add_watch_full_with_context (main_context,
-                                       self->producer.channel,
-                                       self->producer.read_prio,
-                                       G_IO_IN | G_IO_ERR | G_IO_HUP,
-                                       _ide_pty_intercept_in_cb,
-                                       self, NULL);
+  if (!(pump->thread = g_thread_try_new ("[ide-pty-intercept]", pump_thread, pump, NULL)))
+    return FALSE;
 
   return TRUE;
 }
@@ -558,8 +773,9 @@ ide_pty_intercept_init (IdePtyIntercept *self,
  * Cleans up a #IdePtyIntercept previously initialized with
  * ide_pty_intercept_init().
  *
- * This diconnects any #GIOChannel that have been attached and
- * releases any allocated memory.
+ * This stops the forwarding thread, closes the PTYs that were created
+ * and releases any allocated memory. Data which has not yet been
+ * delivered to the callbacks is discarded.
  *
  * It is invalid to use @self after calling this function.
  */
@@ -568,15 +784,10 @@ ide_pty_intercept_clear (IdePtyIntercept *self)
 {
   g_return_if_fail (IDE_IS_PTY_INTERCEPT (self));
 
-  clear_source (&self->producer.in_watch);
-  clear_source (&self->producer.out_watch);
-  g_clear_pointer (&self->producer.channel, g_io_channel_unref);
-  g_clear_pointer (&self->producer.out_bytes, g_bytes_unref);
+  g_clear_pointer (&self->pump, pump_free);
 
-  clear_source (&self->consumer.in_watch);
-  clear_source (&self->consumer.out_watch);
-  g_clear_pointer (&self->consumer.channel, g_io_channel_unref);
-  g_clear_pointer (&self->consumer.out_bytes, g_bytes_unref);
+  pty_fd_clear (&self->producer.fd);
+  pty_fd_clear (&self->consumer.fd);
 
   memset (self, 0, sizeof *self);
 }
@@ -594,9 +805,9 @@ IdePtyFd
 ide_pty_intercept_get_fd (IdePtyIntercept *self)
 {
   g_return_val_if_fail (IDE_IS_PTY_INTERCEPT (self), IDE_PTY_FD_INVALID);
-  g_return_val_if_fail (self->consumer.channel != NULL, IDE_PTY_FD_INVALID);
+  g_return_val_if_fail (self->consumer.fd != IDE_PTY_FD_INVALID, IDE_PTY_FD_INVALID);
 
-  return g_io_channel_unix_get_fd (self->consumer.channel);
+  return self->consumer.fd;
 }
 
 /**
@@ -609,6 +820,11 @@ ide_pty_intercept_get_fd (IdePtyIntercept *self)
  * This sets the callback to execute every time data is received
  * from a particular side of the intercept.
  *
+ * The callback is called from the #GMainContext provided to
+ * ide_pty_intercept_init(). Data read in quick succession is delivered
+ * in a single call, so @callback must not expect to be called once per
+ * line or per write() of the inferior.
+ *
  * You may only set one per side.
  */
 void
@@ -617,9 +833,21 @@ ide_pty_intercept_set_callback (IdePtyIntercept         *self,
                                 IdePtyInterceptCallback  callback,
                                 gpointer                 callback_data)
 {
+  PumpDirection *direction;
+
   g_return_if_fail (IDE_IS_PTY_INTERCEPT (self));
   g_return_if_fail (side == &self->consumer || side == &self->producer);
 
   side->callback = callback;
   side->callback_data = callback_data;
+
+  if (self->pump == NULL)
+    return;
+
+  if (side == &self->consumer)
+    direction = &self->pump->directions[DIRECTION_FROM_CONSUMER];
+  else
+    direction = &self->pump->directions[DIRECTION_FROM_PRODUCER];
+
+  g_atomic_int_set (&direction->observe, callback != NULL);
 }
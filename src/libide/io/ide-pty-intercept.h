@@ -36,6 +36,7 @@ G_BEGIN_DECLS
 typedef int                              IdePtyFd;
 typedef struct _IdePtyIntercept          IdePtyIntercept;
 typedef struct _IdePtyInterceptSide      IdePtyInterceptSide;
+typedef struct _IdePtyInterceptPump      IdePtyInterceptPump;
 typedef void (*IdePtyInterceptCallback) (const IdePtyIntercept     *intercept,
                                          const IdePtyInterceptSide *side,
                                          const guint8              *data,
@@ -44,21 +45,17 @@ typedef void (*IdePtyInterceptCallback) (const IdePtyIntercept     *intercept,
 
 struct _IdePtyInterceptSide
 {
-  GIOChannel              *channel;
-  guint                    in_watch;
-  guint                    out_watch;
-  gint                     read_prio;
-  gint                     write_prio;
-  GBytes                  *out_bytes;
+  IdePtyFd                 fd;
   IdePtyInterceptCallback  callback;
   gpointer                 callback_data;
 };
 
 struct _IdePtyIntercept
 {
-  gsize               magic;
-  IdePtyInterceptSide consumer;
-  IdePtyInterceptSide producer;
+  gsize                magic;
+  IdePtyInterceptSide  consumer;
+  IdePtyInterceptSide  producer;
+  IdePtyInterceptPump *pump;
 };
 
 static inline IdePtyFd
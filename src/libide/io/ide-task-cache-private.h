@@ -0,0 +1,41 @@
+/* ide-task-cache-private.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "ide-task-cache.h"
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+  char    *name;
+  guint    n_items;
+  gsize    size;
+  gsize    max_size;
+  guint64  n_hits;
+  guint64  n_misses;
+  guint64  n_evictions;
+} IdeTaskCacheStats;
+
+void    _ide_task_cache_stats_clear (IdeTaskCacheStats *stats);
+GArray *_ide_task_cache_list_stats  (void);
+
+G_END_DECLS
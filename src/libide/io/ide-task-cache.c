@@ -23,7 +23,7 @@
 #include <glib/gi18n.h>
 
 #include "ide-heap.h"
-#include "ide-task-cache.h"
+#include "ide-task-cache-private.h"
 
 typedef struct
 {
@@ -31,6 +31,8 @@ typedef struct
   gpointer      key;
   gpointer      value;
   gint64        evict_at;
+  gsize         size;
+  GList         lru_link;
 } CacheItem;
 
 typedef struct
@@ -68,11 +70,24 @@ struct _IdeTaskCache
 
   gchar                *name;
 
+  /* Our entry in all_caches */
+  GWeakRef             *registered;
+
   IdeHeap              *evict_heap;
   GSource              *evict_source;
   guint                 evict_source_id;
 
   gint64                time_to_live_usec;
+
+  /* Most recently used items are at the head */
+  GQueue                lru;
+  IdeTaskCacheSizeFunc  size_func;
+  gsize                 size;
+  gsize                 max_size;
+
+  guint64               n_hits;
+  guint64               n_misses;
+  guint64               n_evictions;
 };
 
 G_DEFINE_FINAL_TYPE (IdeTaskCache, ide_task_cache, G_TYPE_OBJECT)
@@ -94,6 +109,14 @@ enum {
 
 static GParamSpec *properties [LAST_PROP];
 
+/* Weak references to all caches of the process so that they may be
+ * trimmed together when the system is low on memory. Caches may be
+ * created and finalized from any thread, so access is locked.
+ */
+G_LOCK_DEFINE_STATIC (all_caches);
+static GPtrArray *all_caches;
+static GMemoryMonitor *memory_monitor;
+
 static gboolean
 evict_source_check (GSource *source)
 {
@@ -171,6 +194,9 @@ cache_item_free (gpointer data)
 {
   CacheItem *item = data;
 
+  g_queue_unlink (&item->self->lru, &item->lru_link);
+  item->self->size -= item->size;
+
   g_clear_pointer (&item->key, item->self->key_destroy_func);
   g_clear_pointer (&item->value, item->self->value_destroy_func);
   item->self = NULL;
@@ -216,8 +242,11 @@ cache_item_new (IdeTaskCache  *self,
   ret->self = self;
   ret->key = self->key_copy_func ((gpointer)key);
   ret->value = self->value_copy_func ((gpointer)value);
+  ret->lru_link.data = ret;
   if (self->time_to_live_usec > 0)
     ret->evict_at = g_get_monotonic_time () + self->time_to_live_usec;
+  if (self->size_func != NULL)
+    ret->size = self->size_func (ret->key, ret->value);
 
   return ret;
 }
@@ -275,7 +304,8 @@ ide_task_cache_evict_full (IdeTaskCache  *self,
 
   if ((item = g_hash_table_lookup (self->cache, key)))
     {
-      if (check_heap)
+      /* Only items with a time to live are tracked by the heap */
+      if (check_heap && item->evict_at != 0)
         {
           gsize i;
 
@@ -352,7 +382,15 @@ ide_task_cache_peek (IdeTaskCache  *self,
   g_return_val_if_fail (IDE_IS_TASK_CACHE (self), NULL);
 
   if (NULL != (item = g_hash_table_lookup (self->cache, key)))
-    return item->value;
+    {
+      if (self->lru.head != &item->lru_link)
+        {
+          g_queue_unlink (&self->lru, &item->lru_link);
+          g_queue_push_head_link (&self->lru, &item->lru_link);
+        }
+
+      return item->value;
+    }
 
   return NULL;
 }
@@ -385,6 +423,59 @@ ide_task_cache_propagate_error (IdeTaskCache  *self,
     }
 }
 
+static void
+ide_task_cache_measure (IdeTaskCache *self)
+{
+  g_assert (IDE_IS_TASK_CACHE (self));
+
+  if (self->size_func == NULL)
+    return;
+
+  /* Items such as lazily inflated indexes may grow after they have been
+   * inserted, so measure them again whenever the size is needed.
+   */
+  self->size = 0;
+
+  for (const GList *iter = self->lru.head; iter; iter = iter->next)
+    {
+      CacheItem *item = iter->data;
+
+      item->size = self->size_func (item->key, item->value);
+      self->size += item->size;
+    }
+}
+
+static void
+ide_task_cache_evict_lru (IdeTaskCache *self)
+{
+  CacheItem *item;
+
+  g_assert (IDE_IS_TASK_CACHE (self));
+  g_assert (self->lru.tail != NULL);
+
+  item = self->lru.tail->data;
+  self->n_evictions++;
+
+  ide_task_cache_evict_full (self, item->key, TRUE);
+}
+
+static void
+ide_task_cache_apply_max_size (IdeTaskCache *self)
+{
+  g_assert (IDE_IS_TASK_CACHE (self));
+
+  if (self->max_size == 0)
+    return;
+
+  ide_task_cache_measure (self);
+
+  /* Always keep the most recent item, even when it alone is over budget,
+   * so that the result of a request is not dropped as soon as it arrives.
+   */
+  while (self->size > self->max_size && self->lru.length > 1)
+    ide_task_cache_evict_lru (self);
+}
+
 static void
 ide_task_cache_populate (IdeTaskCache  *self,
                          gconstpointer  key,
@@ -399,7 +490,13 @@ ide_task_cache_populate (IdeTaskCache  *self,
   if (g_hash_table_contains (self->cache, key))
     ide_task_cache_evict (self, key);
   g_hash_table_replace (self->cache, item->key, item);
-  ide_heap_insert_val (self->evict_heap, item);
+  if (item->evict_at != 0)
+    ide_heap_insert_val (self->evict_heap, item);
+
+  g_queue_push_head_link (&self->lru, &item->lru_link);
+  self->size += item->size;
+
+  ide_task_cache_apply_max_size (self);
 
   if (self->evict_source != NULL)
     evict_source_rearm (self->evict_source);
@@ -578,12 +675,15 @@ ide_task_cache_get_async (IdeTaskCache        *self,
    */
   if (!force_update && (ret = ide_task_cache_peek (self, key)))
     {
+      self->n_hits++;
       g_task_return_pointer (task,
                              self->value_copy_func (ret),
                              self->value_destroy_func);
       return;
     }
 
+  self->n_misses++;
+
   /*
    * Always queue the request. If we need to dispatch the worker to
    * fetch the result, that will happen with another task.
@@ -672,6 +772,7 @@ ide_task_cache_do_eviction (gpointer user_data)
       if (item->evict_at <= now)
         {
           ide_heap_extract (self->evict_heap, NULL);
+          self->n_evictions++;
           ide_task_cache_evict_full (self, item->key, FALSE);
           continue;
         }
@@ -704,6 +805,82 @@ ide_task_cache_install_evict_source (IdeTaskCache *self)
   self->evict_source_id = g_source_attach (source, main_context);
 }
 
+static GPtrArray *
+ide_task_cache_list_all (void)
+{
+  GPtrArray *ar = g_ptr_array_new_with_free_func (g_object_unref);
+
+  G_LOCK (all_caches);
+
+  if (all_caches != NULL)
+    {
+      for (guint i = 0; i < all_caches->len; i++)
+        {
+          IdeTaskCache *cache = g_weak_ref_get (g_ptr_array_index (all_caches, i));
+
+          /* NULL if the cache is being finalized */
+          if (cache != NULL)
+            g_ptr_array_add (ar, cache);
+        }
+    }
+
+  G_UNLOCK (all_caches);
+
+  return ar;
+}
+
+static void
+ide_task_cache_low_memory_warning_cb (GMemoryMonitor             *monitor,
+                                      GMemoryMonitorWarningLevel  level,
+                                      gpointer                    user_data)
+{
+  g_autoptr(GPtrArray) caches = NULL;
+  double fraction;
+
+  g_assert (G_IS_MEMORY_MONITOR (monitor));
+
+  if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_CRITICAL)
+    fraction = .0;
+  else if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM)
+    fraction = .5;
+  else
+    fraction = .75;
+
+  caches = ide_task_cache_list_all ();
+
+  g_debug ("Low memory warning (level %u), trimming %u caches to %u%%",
+           level, caches->len, (guint)(fraction * 100));
+
+  for (guint i = 0; i < caches->len; i++)
+    ide_task_cache_trim (g_ptr_array_index (caches, i), fraction);
+}
+
+static void
+ide_task_cache_register (IdeTaskCache *self)
+{
+  g_assert (IDE_IS_TASK_CACHE (self));
+  g_assert (self->registered == NULL);
+
+  self->registered = g_new0 (GWeakRef, 1);
+  g_weak_ref_init (self->registered, self);
+
+  G_LOCK (all_caches);
+
+  if (all_caches == NULL)
+    {
+      all_caches = g_ptr_array_new ();
+      memory_monitor = g_memory_monitor_dup_default ();
+      g_signal_connect (memory_monitor,
+                        "low-memory-warning",
+                        G_CALLBACK (ide_task_cache_low_memory_warning_cb),
+                        NULL);
+    }
+
+  g_ptr_array_add (all_caches, self->registered);
+
+  G_UNLOCK (all_caches);
+}
+
 static void
 ide_task_cache_constructed (GObject *object)
 {
@@ -761,6 +938,8 @@ ide_task_cache_constructed (GObject *object)
    */
   if (self->time_to_live_usec > 0)
     ide_task_cache_install_evict_source (self);
+
+  ide_task_cache_register (self);
 }
 
 static void
@@ -808,6 +987,16 @@ ide_task_cache_finalize (GObject *object)
 {
   IdeTaskCache *self = (IdeTaskCache *)object;
 
+  if (self->registered != NULL)
+    {
+      G_LOCK (all_caches);
+      g_ptr_array_remove_fast (all_caches, self->registered);
+      G_UNLOCK (all_caches);
+
+      g_weak_ref_clear (self->registered);
+      g_clear_pointer (&self->registered, g_free);
+    }
+
   g_clear_pointer (&self->name, g_free);
 
   G_OBJECT_CLASS (ide_task_cache_parent_class)->finalize (object);
@@ -1040,3 +1229,180 @@ ide_task_cache_set_name (IdeTaskCache *self,
       g_source_set_name (self->evict_source, full_name);
     }
 }
+
+/**
+ * ide_task_cache_set_size_func:
+ * @self: an #IdeTaskCache
+ * @size_func: (scope forever) (nullable): a function to estimate the size
+ *   of an item, or %NULL
+ *
+ * Sets the function used to estimate the number of bytes used by each
+ * item in the cache. Items are measured again whenever the size of the
+ * cache is needed, so they may grow after being inserted.
+ *
+ * Since: 50
+ */
+void
+ide_task_cache_set_size_func (IdeTaskCache         *self,
+                              IdeTaskCacheSizeFunc  size_func)
+{
+  g_return_if_fail (IDE_IS_TASK_CACHE (self));
+
+  self->size_func = size_func;
+  self->size = 0;
+
+  for (const GList *iter = self->lru.head; iter; iter = iter->next)
+    ((CacheItem *)iter->data)->size = 0;
+
+  ide_task_cache_measure (self);
+  ide_task_cache_apply_max_size (self);
+}
+
+/**
+ * ide_task_cache_set_max_size:
+ * @self: an #IdeTaskCache
+ * @max_size: the budget in bytes, or 0 for no limit
+ *
+ * Sets the number of bytes the items of the cache may use, as measured
+ * by the function set with ide_task_cache_set_size_func().
+ *
+ * When the budget is exceeded, the least recently used items are evicted.
+ * The most recently inserted item is always kept.
+ *
+ * Since: 50
+ */
+void
+ide_task_cache_set_max_size (IdeTaskCache *self,
+                             gsize         max_size)
+{
+  g_return_if_fail (IDE_IS_TASK_CACHE (self));
+
+  self->max_size = max_size;
+
+  ide_task_cache_apply_max_size (self);
+}
+
+/**
+ * ide_task_cache_get_size:
+ * @self: an #IdeTaskCache
+ *
+ * Gets the number of bytes used by the items of the cache, as measured
+ * by the function set with ide_task_cache_set_size_func().
+ *
+ * Returns: the size of the cache in bytes
+ *
+ * Since: 50
+ */
+gsize
+ide_task_cache_get_size (IdeTaskCache *self)
+{
+  g_return_val_if_fail (IDE_IS_TASK_CACHE (self), 0);
+
+  ide_task_cache_measure (self);
+
+  return self->size;
+}
+
+/**
+ * ide_task_cache_trim:
+ * @self: an #IdeTaskCache
+ * @fraction: the fraction of the cache to keep, between 0 and 1
+ *
+ * Evicts the least recently used items until at most @fraction of the
+ * cache remains. The size of the items is used when a size function has
+ * been set, otherwise the number of items.
+ *
+ * This is used to release memory when the system is running low.
+ *
+ * Since: 50
+ */
+void
+ide_task_cache_trim (IdeTaskCache *self,
+                     double        fraction)
+{
+  guint n_evictions = 0;
+
+  g_return_if_fail (IDE_IS_TASK_CACHE (self));
+
+  fraction = CLAMP (fraction, .0, 1.);
+
+  ide_task_cache_measure (self);
+
+  if (fraction == .0)
+    {
+      while (self->lru.length > 0)
+        {
+          ide_task_cache_evict_lru (self);
+          n_evictions++;
+        }
+    }
+  else if (self->size > 0)
+    {
+      gsize target = self->size * fraction;
+
+      while (self->size > target && self->lru.length > 0)
+        {
+          ide_task_cache_evict_lru (self);
+          n_evictions++;
+        }
+    }
+  else
+    {
+      guint target = self->lru.length * fraction;
+
+      while (self->lru.length > target)
+        {
+          ide_task_cache_evict_lru (self);
+          n_evictions++;
+        }
+    }
+
+  if (n_evictions > 0)
+    g_debug ("Trimmed %u items from %s",
+             n_evictions, self->name ?: "unnamed cache");
+}
+
+void
+_ide_task_cache_stats_clear (IdeTaskCacheStats *stats)
+{
+  g_clear_pointer (&stats->name, g_free);
+}
+
+/**
+ * _ide_task_cache_list_stats:
+ *
+ * Gets the statistics of every #IdeTaskCache of the process.
+ *
+ * Returns: (transfer full) (element-type IdeTaskCacheStats): a #GArray
+ */
+GArray *
+_ide_task_cache_list_stats (void)
+{
+  g_autoptr(GPtrArray) caches = NULL;
+  GArray *ar;
+
+  ar = g_array_new (FALSE, FALSE, sizeof (IdeTaskCacheStats));
+  g_array_set_clear_func (ar, (GDestroyNotify)_ide_task_cache_stats_clear);
+
+  caches = ide_task_cache_list_all ();
+
+  for (guint i = 0; i < caches->len; i++)
+    {
+      IdeTaskCache *self = g_ptr_array_index (caches, i);
+      IdeTaskCacheStats stats;
+
+      ide_task_cache_measure (self);
+
+      stats.name = g_strdup (self->name ?: "unnamed cache");
+      stats.n_items = self->cache ? g_hash_table_size (self->cache) : 0;
+      stats.size = self->size;
+      stats.max_size = self->max_size;
+      stats.n_hits = self->n_hits;
+      stats.n_misses = self->n_misses;
+      stats.n_evictions = self->n_evictions;
+
+      g_array_append_val (ar, stats);
+    }
+
+  return ar;
+}
@@ -53,6 +53,22 @@ typedef void (*IdeTaskCacheCallback) (IdeTaskCache  *self,
                                       GTask         *task,
                                       gpointer       user_data);
 
+/**
+ * IdeTaskCacheSizeFunc:
+ * @key: the key of the item
+ * @value: the value of the item
+ *
+ * Estimates the number of bytes used by an item of the cache. This is
+ * used to apply the budget set with ide_task_cache_set_max_size() and to
+ * trim the caches proportionally when the system is low on memory.
+ *
+ * Returns: the size of the item in bytes
+ *
+ * Since: 50
+ */
+typedef gsize (*IdeTaskCacheSizeFunc) (gconstpointer key,
+                                       gconstpointer value);
+
 IDE_AVAILABLE_IN_ALL
 IdeTaskCache *ide_task_cache_new        (GHashFunc              key_hash_func,
                                          GEqualFunc             key_equal_func,
@@ -88,5 +104,16 @@ gpointer      ide_task_cache_peek       (IdeTaskCache          *self,
                                          gconstpointer          key);
 IDE_AVAILABLE_IN_ALL
 GPtrArray    *ide_task_cache_get_values (IdeTaskCache          *self);
+IDE_AVAILABLE_IN_50
+void          ide_task_cache_set_size_func (IdeTaskCache          *self,
+                                            IdeTaskCacheSizeFunc   size_func);
+IDE_AVAILABLE_IN_50
+void          ide_task_cache_set_max_size  (IdeTaskCache          *self,
+                                            gsize                  max_size);
+IDE_AVAILABLE_IN_50
+gsize         ide_task_cache_get_size      (IdeTaskCache          *self);
+IDE_AVAILABLE_IN_50
+void          ide_task_cache_trim          (IdeTaskCache          *self,
+                                            double                 fraction);
 
 G_END_DECLS
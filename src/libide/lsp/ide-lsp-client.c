@@ -33,50 +33,107 @@
 
 #include "ide-marshal.h"
 
-#include "ide-lsp-client.h"
+#include "ide-lsp-client-private.h"
 #include "ide-lsp-diagnostic.h"
 #include "ide-lsp-enums.h"
+#include "ide-lsp-reader-private.h"
+#include "ide-lsp-recorder-private.h"
 #include "ide-lsp-workspace-edit.h"
 
 typedef struct
 {
   JsonrpcClient *client;
   GVariant      *id;
+  char          *failure;
+  guint          n_active;
 } AsyncCall;
 
 typedef struct
 {
-  GList         link;
-  IdeTask      *task;
-  gchar        *method;
-  GVariant     *params;
-  GCancellable *cancellable;
-} PendingMessage;
+  guint64 issued;
+  guint64 coalesced;
+  guint64 cancelled;
+  guint64 superseded;
+  guint64 completed;
+  guint64 total_latency_usec;
+  guint64 max_latency_usec;
+} RequestStats;
+
+/* A Request is a single JSON-RPC call to the language server which may
+ * have many waiters when identical calls have been coalesced. It is kept
+ * in IdeLspClientPrivate.requests until a reply arrives or every waiter
+ * has gone away, at which point the server is told to cancel it.
+ */
+typedef struct
+{
+  GList                link;
+  IdeLspClient        *self;
+  RequestStats        *stats;
+  char                *method;
+  char                *uri;
+  GVariant            *params;
+  GVariant            *id;
+  GCancellable        *cancellable;
+  GPtrArray           *waiters;
+  gint64               begin_time;
+  guint                serial;
+  IdeLspRequestPolicy  policy;
+  guint                submitted : 1;
+  guint                finished : 1;
+} Request;
+
+typedef struct
+{
+  char           *method;
+  GVariant       *params;
+  GFile          *file;
+  IdeDiagnostics *diagnostics;
+} PreparedNotification;
 
 typedef struct
 {
   GWeakRef buffer_wr;
   GWeakRef client_wr;
+  gpointer buffer;
   guint    commit_notify;
 } NotifyBridge;
 
 typedef struct
 {
-  GSignalGroup   *buffer_manager_signals;
-  GSignalGroup   *project_signals;
-  JsonrpcClient  *rpc_client;
-  GIOStream      *io_stream;
-  GHashTable     *diagnostics_by_file;
-  GPtrArray      *languages;
-  GVariant       *server_capabilities;
-  GVariant       *initialization_options;
-  char           *root_uri;
-  char           *name;
-  IdeLspTrace     trace;
-  gboolean        initialized;
-  GQueue          pending_messages;
-  guint           use_markdown_in_diagnostics : 1;
-  guint           text_document_sync : 2;
+  GWeakRef      context_wr;
+  char         *uri;
+  char         *name;
+  GSignalGroup *buffer_manager_signals;
+} WorkspaceFolder;
+
+typedef struct
+{
+  GSignalGroup         *buffer_manager_signals;
+  GSignalGroup         *project_signals;
+  GPtrArray            *workspace_folders;
+  JsonrpcClient        *rpc_client;
+  GIOStream            *io_stream;
+  IdeLspReader         *reader;
+  PreparedNotification *prepared;
+  GHashTable           *diagnostics_by_file;
+  GHashTable           *bridges;
+  GPtrArray            *languages;
+  GVariant             *server_capabilities;
+  GVariant             *initialization_options;
+  char                 *root_uri;
+  char                 *name;
+  GHashTable           *request_policies;
+  GHashTable           *request_stats;
+  IdeLspTrace           trace;
+  gboolean              initialized;
+  GQueue                requests;
+  guint                 document_serial;
+  guint64               main_thread_usec;
+  /* Copy of use_markdown_in_diagnostics for the reader thread */
+  gint                  use_markdown_snapshot;
+  guint                 use_markdown_in_diagnostics : 1;
+  guint                 text_document_sync : 2;
+  guint                 primary_folder_removed : 1;
 } IdeLspClientPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (IdeLspClient, ide_lsp_client, IDE_TYPE_OBJECT)
@@ -126,13 +183,48 @@ enum {
   N_SIGNALS
 };
 
-static void ide_lsp_client_call_cb (GObject      *object,
-                                    GAsyncResult *result,
-                                    gpointer      user_data);
+static void ide_lsp_client_request_cb (GObject      *object,
+                                       GAsyncResult *result,
+                                       gpointer      user_data);
 
 static GParamSpec *properties [N_PROPS];
 static guint signals [N_SIGNALS];
 
+static const struct {
+  const char          *method;
+  IdeLspRequestPolicy  policy;
+} default_policies[] = {
+  { "textDocument/completion",
+    IDE_LSP_REQUEST_POLICY_CANCEL | IDE_LSP_REQUEST_POLICY_SUPERSEDE },
+  { "textDocument/hover",
+    IDE_LSP_REQUEST_POLICY_CANCEL | IDE_LSP_REQUEST_POLICY_SUPERSEDE | IDE_LSP_REQUEST_POLICY_COALESCE },
+  { "textDocument/signatureHelp",
+    IDE_LSP_REQUEST_POLICY_CANCEL | IDE_LSP_REQUEST_POLICY_SUPERSEDE | IDE_LSP_REQUEST_POLICY_COALESCE },
+  { "textDocument/documentSymbol",
+    IDE_LSP_REQUEST_POLICY_CANCEL | IDE_LSP_REQUEST_POLICY_SUPERSEDE | IDE_LSP_REQUEST_POLICY_COALESCE },
+  { "textDocument/documentHighlight",
+    IDE_LSP_REQUEST_POLICY_CANCEL | IDE_LSP_REQUEST_POLICY_SUPERSEDE | IDE_LSP_REQUEST_POLICY_COALESCE },
+  { "textDocument/diagnostic",
+    IDE_LSP_REQUEST_POLICY_CANCEL | IDE_LSP_REQUEST_POLICY_SUPERSEDE | IDE_LSP_REQUEST_POLICY_COALESCE },
+  { "textDocument/semanticTokens/full",
+    IDE_LSP_REQUEST_POLICY_CANCEL | IDE_LSP_REQUEST_POLICY_SUPERSEDE | IDE_LSP_REQUEST_POLICY_COALESCE },
+  { "textDocument/codeAction",
+    IDE_LSP_REQUEST_POLICY_CANCEL | IDE_LSP_REQUEST_POLICY_COALESCE },
+  { "textDocument/definition",
+    IDE_LSP_REQUEST_POLICY_CANCEL | IDE_LSP_REQUEST_POLICY_COALESCE },
+  { "textDocument/references",
+    IDE_LSP_REQUEST_POLICY_CANCEL | IDE_LSP_REQUEST_POLICY_COALESCE },
+  { "workspace/symbol",
+    IDE_LSP_REQUEST_POLICY_CANCEL | IDE_LSP_REQUEST_POLICY_SUPERSEDE },
+};
+
+IDE_DEFINE_COUNTER (lsp_issued, "LSP", "Requests", "Requests sent to language servers");
+IDE_DEFINE_COUNTER (lsp_coalesced, "LSP", "Coalesced", "Requests sharing an in-flight reply");
+IDE_DEFINE_COUNTER (lsp_cancelled, "LSP", "Cancelled", "Requests cancelled by the caller");
+IDE_DEFINE_COUNTER (lsp_superseded, "LSP", "Superseded", "Requests replaced by a newer request");
+IDE_DEFINE_COUNTER (lsp_latency_usec, "LSP", "Round Trip (usec)", "Time waiting for language server replies");
+IDE_DEFINE_COUNTER (lsp_main_thread_usec, "LSP", "Main Thread (usec)", "Time handling server messages on main thread");
+
 static void
 notify_bridge_commit_notify (GtkTextBuffer            *buffer,
                              GtkTextBufferNotifyFlags  flags,
@@ -361,12 +453,25 @@ static void
 notify_bridge_destroy (gpointer data)
 {
   NotifyBridge *bridge = data;
+  g_autoptr(IdeLspClient) client = NULL;
 
   /* Ignore registration, this can only be called when it becomes invalid
-   * from disposal of the buffer or notify_bridge_client_released().
+   * from disposal of the buffer, closing of the document or from
+   * notify_bridge_client_released().
    */
   bridge->commit_notify = 0;
 
+  /* If the client is still alive it must not notify us later */
+  if ((client = g_weak_ref_get (&bridge->client_wr)))
+    {
+      IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (client);
+
+      /* Only used as a key, the buffer may be in dispose */
+      g_hash_table_remove (priv->bridges, bridge->buffer);
+
+      g_object_weak_unref (G_OBJECT (client), notify_bridge_client_released, bridge);
+    }
+
   g_weak_ref_clear (&bridge->buffer_wr);
   g_weak_ref_clear (&bridge->client_wr);
 
@@ -377,15 +482,20 @@ static void
 notify_bridge (IdeLspClient *self,
                IdeBuffer    *buffer)
 {
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
   NotifyBridge *bridge;
 
   g_assert (IDE_IS_MAIN_THREAD ());
   g_assert (IDE_IS_LSP_CLIENT (self));
   g_assert (IDE_IS_BUFFER (buffer));
 
+  if (g_hash_table_contains (priv->bridges, buffer))
+    return;
+
   bridge = g_new0 (NotifyBridge, 1);
   g_weak_ref_init (&bridge->client_wr, self);
   g_weak_ref_init (&bridge->buffer_wr, buffer);
+  bridge->buffer = buffer;
   bridge->commit_notify = gtk_text_buffer_add_commit_notify (GTK_TEXT_BUFFER (buffer),
                                                              (GTK_TEXT_BUFFER_NOTIFY_AFTER_INSERT |
                                                               GTK_TEXT_BUFFER_NOTIFY_BEFORE_DELETE |
@@ -395,6 +505,25 @@ notify_bridge (IdeLspClient *self,
   g_object_weak_ref (G_OBJECT (self),
                      notify_bridge_client_released,
                      bridge);
+  g_hash_table_insert (priv->bridges, buffer, bridge);
+}
+
+static void
+notify_bridge_remove (IdeLspClient *self,
+                      IdeBuffer    *buffer)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  NotifyBridge *bridge;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_LSP_CLIENT (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  if ((bridge = g_hash_table_lookup (priv->bridges, buffer)) && bridge->commit_notify)
+    {
+      /* This will free @bridge and remove it from priv->bridges */
+      gtk_text_buffer_remove_commit_notify (GTK_TEXT_BUFFER (buffer), bridge->commit_notify);
+    }
 }
 
 static AsyncCall *
@@ -413,6 +542,7 @@ async_call_finalize (gpointer data)
   AsyncCall *ac = data;
   g_clear_object (&ac->client);
   g_clear_pointer (&ac->id, g_variant_unref);
+  g_clear_pointer (&ac->failure, g_free);
 }
 
 static void
@@ -423,53 +553,286 @@ async_call_unref (gpointer data)
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (AsyncCall, async_call_unref);
 
+static RequestStats *
+ide_lsp_client_get_stats (IdeLspClient *self,
+                          const char   *method)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  RequestStats *stats;
+
+  g_assert (IDE_IS_LSP_CLIENT (self));
+  g_assert (method != NULL);
+
+  if (!(stats = g_hash_table_lookup (priv->request_stats, method)))
+    {
+      stats = g_new0 (RequestStats, 1);
+      g_hash_table_insert (priv->request_stats, g_strdup (method), stats);
+    }
+
+  return stats;
+}
+
+static void
+request_finalize (gpointer data)
+{
+  Request *request = data;
+
+  g_assert (request->link.prev == NULL);
+  g_assert (request->link.next == NULL);
+  g_assert (request->waiters->len == 0);
+
+  g_clear_pointer (&request->method, g_free);
+  g_clear_pointer (&request->uri, g_free);
+  g_clear_pointer (&request->params, g_variant_unref);
+  g_clear_pointer (&request->id, g_variant_unref);
+  g_clear_pointer (&request->waiters, g_ptr_array_unref);
+  g_clear_object (&request->cancellable);
+}
+
+static Request *
+request_ref (Request *request)
+{
+  return g_rc_box_acquire (request);
+}
+
+static void
+request_unref (Request *request)
+{
+  g_rc_box_release_full (request, request_finalize);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (Request, request_unref);
+
+static void request_waiter_completed_cb (IdeTask    *task,
+                                         GParamSpec *pspec,
+                                         Request    *request);
+
+static Request *
+request_new (IdeLspClient        *self,
+             const char          *method,
+             const char          *uri,
+             GVariant            *params,
+             IdeLspRequestPolicy  policy)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  Request *request;
+
+  g_assert (IDE_IS_LSP_CLIENT (self));
+  g_assert (method != NULL);
+
+  request = g_rc_box_new0 (Request);
+  request->link.data = request;
+  request->self = self;
+  request->stats = ide_lsp_client_get_stats (self, method);
+  request->method = g_strdup (method);
+  request->uri = g_strdup (uri);
+  request->params = params ? g_variant_ref_sink (params) : NULL;
+  request->cancellable = g_cancellable_new ();
+  request->waiters = g_ptr_array_new_with_free_func (g_object_unref);
+  request->serial = priv->document_serial;
+  request->policy = policy;
+
+  return request;
+}
+
+static void
+request_add_waiter (Request *request,
+                    IdeTask *task)
+{
+  g_assert (request != NULL);
+  g_assert (!request->finished);
+  g_assert (IDE_IS_TASK (task));
+
+  /* Waiters return as soon as their own cancellable fires. We only cancel
+   * the request with the language server once every waiter has given up.
+   */
+  ide_task_set_return_on_cancel (task, TRUE);
+  g_signal_connect (task,
+                    "notify::completed",
+                    G_CALLBACK (request_waiter_completed_cb),
+                    request);
+  g_ptr_array_add (request->waiters, g_object_ref (task));
+}
+
+/* Detaches @request from the client and takes the waiters so the caller
+ * can complete them. The caller owns the reference which was held by
+ * IdeLspClientPrivate.requests.
+ */
+static GPtrArray *
+request_detach (Request *request)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (request->self);
+  g_autoptr(GPtrArray) waiters = NULL;
+
+  g_assert (request != NULL);
+  g_assert (!request->finished);
+
+  request->finished = TRUE;
+
+  g_queue_unlink (&priv->requests, &request->link);
+
+  waiters = g_steal_pointer (&request->waiters);
+  request->waiters = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (guint i = 0; i < waiters->len; i++)
+    g_signal_handlers_disconnect_by_func (g_ptr_array_index (waiters, i),
+                                          G_CALLBACK (request_waiter_completed_cb),
+                                          request);
+
+  return g_steal_pointer (&waiters);
+}
+
+static void
+request_cancel (Request    *request,
+                const char *message)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (request->self);
+  g_autoptr(GPtrArray) waiters = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (request != NULL);
+
+  waiters = request_detach (request);
+
+  for (guint i = 0; i < waiters->len; i++)
+    ide_task_return_new_error (g_ptr_array_index (waiters, i),
+                               G_IO_ERROR,
+                               G_IO_ERROR_CANCELLED,
+                               "%s", message);
+
+  /* Tell the server to stop working on it. The reply (most likely an
+   * error) will still arrive and be dropped by ide_lsp_client_request_cb().
+   */
+  if (request->submitted &&
+      request->id != NULL &&
+      priv->rpc_client != NULL &&
+      (request->policy & IDE_LSP_REQUEST_POLICY_CANCEL) != 0)
+    {
+      IDE_TRACE_MSG ("Cancelling %s request to language server", request->method);
+      jsonrpc_client_send_notification_async (priv->rpc_client,
+                                              "$/cancelRequest",
+                                              JSONRPC_MESSAGE_NEW ("id", JSONRPC_MESSAGE_PUT_VARIANT (request->id)),
+                                              NULL, NULL, NULL);
+    }
+
+  g_cancellable_cancel (request->cancellable);
+
+  request_unref (request);
+
+  IDE_EXIT;
+}
+
 static void
-pending_message_fail (PendingMessage *message)
+request_waiter_completed_cb (IdeTask    *task,
+                             GParamSpec *pspec,
+                             Request    *request)
 {
-  g_assert (message != NULL);
-  g_assert (message->link.prev == NULL);
-  g_assert (message->link.next == NULL);
-  g_assert (message->link.data == message);
-  g_assert (IDE_IS_TASK (message->task));
-  g_assert (!message->cancellable || G_IS_CANCELLABLE (message->cancellable));
-  g_assert (message->method != NULL);
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_TASK (task));
+  g_assert (request != NULL);
+  g_assert (!request->finished);
 
-  ide_task_return_new_error (message->task,
-                             G_IO_ERROR,
-                             G_IO_ERROR_CANCELLED,
-                             _("The operation has been cancelled"));
+  /* Only reached when the waiter returned early due to cancellation */
+  g_signal_handlers_disconnect_by_func (task,
+                                        G_CALLBACK (request_waiter_completed_cb),
+                                        request);
+  g_ptr_array_remove (request->waiters, task);
 
-  g_clear_object (&message->task);
-  g_clear_object (&message->cancellable);
-  g_clear_pointer (&message->method, g_free);
-  g_clear_pointer (&message->params, g_variant_unref);
-  g_slice_free (PendingMessage, message);
+  if (request->waiters->len == 0)
+    {
+      request->stats->cancelled++;
+      ide_counter_inc (&lsp_cancelled);
+      request_cancel (request, _("The operation has been cancelled"));
+    }
 }
 
 static void
-pending_message_submit (PendingMessage *message,
-                        JsonrpcClient  *rpc_client)
+request_submit (Request       *request,
+                JsonrpcClient *rpc_client)
 {
+  g_assert (request != NULL);
+  g_assert (!request->submitted);
+  g_assert (!request->finished);
   g_assert (JSONRPC_IS_CLIENT (rpc_client));
-  g_assert (message != NULL);
-  g_assert (message->link.prev == NULL);
-  g_assert (message->link.next == NULL);
-  g_assert (message->link.data == message);
-  g_assert (IDE_IS_TASK (message->task));
-  g_assert (!message->cancellable || G_IS_CANCELLABLE (message->cancellable));
-  g_assert (message->method != NULL);
-
-  jsonrpc_client_call_async (rpc_client,
-                             message->method,
-                             message->params,
-                             message->cancellable,
-                             ide_lsp_client_call_cb,
-                             g_steal_pointer (&message->task));
-
-  g_clear_object (&message->cancellable);
-  g_clear_pointer (&message->method, g_free);
-  g_clear_pointer (&message->params, g_variant_unref);
-  g_slice_free (PendingMessage, message);
+
+  request->submitted = TRUE;
+  request->begin_time = g_get_monotonic_time ();
+  request->stats->issued++;
+
+  ide_counter_inc (&lsp_issued);
+
+  jsonrpc_client_call_with_id_async (rpc_client,
+                                     request->method,
+                                     request->params,
+                                     &request->id,
+                                     request->cancellable,
+                                     ide_lsp_client_request_cb,
+                                     request_ref (request));
+}
+
+static void
+request_complete (Request  *request,
+                  GVariant *reply,
+                  GError   *error)
+{
+  g_autoptr(GPtrArray) waiters = NULL;
+  gint64 latency;
+
+  g_assert (request != NULL);
+
+  latency = g_get_monotonic_time () - request->begin_time;
+
+  request->stats->completed++;
+  request->stats->total_latency_usec += latency;
+  request->stats->max_latency_usec = MAX (request->stats->max_latency_usec, latency);
+
+  ide_counter_add (&lsp_latency_usec, latency);
+
+  waiters = request_detach (request);
+
+  for (guint i = 0; i < waiters->len; i++)
+    {
+      IdeTask *task = g_ptr_array_index (waiters, i);
+
+      if (error != NULL)
+        ide_task_return_error (task, g_error_copy (error));
+      else if (reply != NULL)
+        ide_task_return_pointer (task, g_variant_ref (reply), g_variant_unref);
+      else
+        ide_task_return_pointer (task, NULL, NULL);
+    }
+
+  request_unref (request);
+}
+
+static void
+ide_lsp_client_account (IdeLspClient *self,
+                        gint64        begin)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  gint64 elapsed = g_get_monotonic_time () - begin;
+
+  priv->main_thread_usec += elapsed;
+  ide_counter_add (&lsp_main_thread_usec, elapsed);
+}
+
+static char *
+extract_document_uri (GVariant *params)
+{
+  const char *uri = NULL;
+
+  if (params == NULL || !g_variant_is_of_type (params, G_VARIANT_TYPE_VARDICT))
+    return NULL;
+
+  if (JSONRPC_MESSAGE_PARSE (params,
+    "textDocument", "{",
+      "uri", JSONRPC_MESSAGE_GET_STRING (&uri),
+    "}"))
+    return g_strdup (uri);
+
+  return NULL;
 }
 
 static gboolean
@@ -626,6 +989,9 @@ ide_lsp_client_buffer_unloaded (IdeLspClient     *self,
   if (!ide_lsp_client_supports_buffer (self, buffer))
     IDE_EXIT;
 
+  /* Stop sending changes for a document the peer has released */
+  notify_bridge_remove (self, buffer);
+
   uri = ide_buffer_dup_uri (buffer);
 
   params = JSONRPC_MESSAGE_NEW (
@@ -642,39 +1008,498 @@ ide_lsp_client_buffer_unloaded (IdeLspClient     *self,
   IDE_EXIT;
 }
 
-static void
-ide_lsp_client_buffer_manager_bind (IdeLspClient     *self,
-                                    IdeBufferManager *buffer_manager,
-                                    GSignalGroup     *signal_group)
+static void
+ide_lsp_client_buffer_manager_bind (IdeLspClient     *self,
+                                    IdeBufferManager *buffer_manager,
+                                    GSignalGroup     *signal_group)
+{
+  guint n_items;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_LSP_CLIENT (self));
+  g_assert (IDE_IS_BUFFER_MANAGER (buffer_manager));
+  g_assert (G_IS_SIGNAL_GROUP (signal_group));
+
+  n_items = g_list_model_get_n_items (G_LIST_MODEL (buffer_manager));
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autoptr(IdeBuffer) buffer = NULL;
+
+      buffer = g_list_model_get_item (G_LIST_MODEL (buffer_manager), i);
+      ide_lsp_client_buffer_loaded (self, buffer, buffer_manager);
+    }
+}
+
+static void
+ide_lsp_client_buffer_manager_unbind (IdeLspClient   *self,
+                                      GSignalGroup   *signal_group)
+{
+  g_assert (IDE_IS_LSP_CLIENT (self));
+  g_assert (G_IS_SIGNAL_GROUP (signal_group));
+
+  /* TODO: We need to track everything we've notified so that we
+   *       can notify the peer to release its resources.
+   */
+}
+
+static void
+workspace_folder_free (WorkspaceFolder *folder)
+{
+  g_signal_group_set_target (folder->buffer_manager_signals, NULL);
+  g_weak_ref_clear (&folder->context_wr);
+  g_clear_pointer (&folder->uri, g_free);
+  g_clear_pointer (&folder->name, g_free);
+  g_clear_object (&folder->buffer_manager_signals);
+  g_slice_free (WorkspaceFolder, folder);
+}
+
+static char *
+ide_lsp_client_dup_primary_uri (IdeLspClient *self,
+                                IdeContext   *context)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  g_autoptr(GFile) workdir = NULL;
+
+  g_assert (IDE_IS_LSP_CLIENT (self));
+  g_assert (IDE_IS_CONTEXT (context));
+
+  if (priv->root_uri != NULL)
+    return g_strdup (priv->root_uri);
+
+  workdir = ide_context_ref_workdir (context);
+
+  return g_file_get_uri (workdir);
+}
+
+static void
+ide_lsp_client_close_buffers (IdeLspClient *self,
+                              GSignalGroup *buffer_manager_signals)
+{
+  g_autoptr(IdeBufferManager) buffer_manager = NULL;
+  guint n_items;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_LSP_CLIENT (self));
+  g_assert (G_IS_SIGNAL_GROUP (buffer_manager_signals));
+
+  if (!(buffer_manager = g_signal_group_dup_target (buffer_manager_signals)))
+    return;
+
+  n_items = g_list_model_get_n_items (G_LIST_MODEL (buffer_manager));
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autoptr(IdeBuffer) buffer = g_list_model_get_item (G_LIST_MODEL (buffer_manager), i);
+
+      ide_lsp_client_buffer_unloaded (self, buffer, buffer_manager);
+    }
+}
+
+static void
+ide_lsp_client_notify_workspace_folder (IdeLspClient *self,
+                                        const char   *uri,
+                                        const char   *name,
+                                        gboolean      added)
+{
+  g_autoptr(GVariant) params = NULL;
+
+  g_assert (IDE_IS_LSP_CLIENT (self));
+  g_assert (uri != NULL);
+
+  if (name == NULL)
+    name = "";
+
+  if (added)
+    params = JSONRPC_MESSAGE_NEW (
+      "event", "{",
+        "added", "[",
+          "{",
+            "uri", JSONRPC_MESSAGE_PUT_STRING (uri),
+            "name", JSONRPC_MESSAGE_PUT_STRING (name),
+          "}",
+        "]",
+        "removed", "[", "]",
+      "}"
+    );
+  else
+    params = JSONRPC_MESSAGE_NEW (
+      "event", "{",
+        "added", "[", "]",
+        "removed", "[",
+          "{",
+            "uri", JSONRPC_MESSAGE_PUT_STRING (uri),
+            "name", JSONRPC_MESSAGE_PUT_STRING (name),
+          "}",
+        "]",
+      "}"
+    );
+
+  ide_lsp_client_send_notification_async (self,
+                                          "workspace/didChangeWorkspaceFolders",
+                                          params,
+                                          NULL, NULL, NULL);
+}
+
+static GVariant *
+ide_lsp_client_dup_workspace_folders (IdeLspClient *self)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  GVariantBuilder builder;
+  IdeContext *context;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_LSP_CLIENT (self));
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+
+  if (!priv->primary_folder_removed &&
+      (context = ide_object_get_context (IDE_OBJECT (self))))
+    {
+      g_autofree char *uri = ide_lsp_client_dup_primary_uri (self, context);
+      g_autofree char *name = ide_context_dup_title (context);
+
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+      g_variant_builder_add_parsed (&builder, "{'uri', <%s>}", uri);
+      g_variant_builder_add_parsed (&builder, "{'name', <%s>}", name);
+      g_variant_builder_close (&builder);
+    }
+
+  for (guint i = 0; i < priv->workspace_folders->len; i++)
+    {
+      const WorkspaceFolder *folder = g_ptr_array_index (priv->workspace_folders, i);
+
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+      g_variant_builder_add_parsed (&builder, "{'uri', <%s>}", folder->uri);
+      g_variant_builder_add_parsed (&builder, "{'name', <%s>}", folder->name);
+      g_variant_builder_close (&builder);
+    }
+
+  return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+static gboolean
+uri_is_within (const char *uri,
+               const char *folder_uri)
+{
+  gsize len = strlen (folder_uri);
+
+  if (!g_str_has_prefix (uri, folder_uri))
+    return FALSE;
+
+  return uri[len] == 0 || uri[len] == '/' || (len > 0 && folder_uri[len - 1] == '/');
+}
+
+static gboolean
+text_mentions_folder (const char *text,
+                      const char *folder_uri)
+{
+  g_autofree char *path = NULL;
+
+  if (text == NULL)
+    return FALSE;
+
+  if (strstr (text, folder_uri) != NULL)
+    return TRUE;
+
+  return (path = g_filename_from_uri (folder_uri, NULL, NULL)) && strstr (text, path) != NULL;
+}
+
+/*
+ * ide_lsp_client_ref_context_for_uri:
+ *
+ * Finds the context owning @uri among the workspace folders of the peer,
+ * preferring the innermost folder when folders are nested. Falls back to
+ * the context the client was started for.
+ */
+static IdeContext *
+ide_lsp_client_ref_context_for_uri (IdeLspClient *self,
+                                    const char   *uri)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  g_autoptr(IdeContext) primary = NULL;
+  g_autoptr(IdeContext) best = NULL;
+  gsize best_len = 0;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_LSP_CLIENT (self));
+
+  if (!priv->primary_folder_removed)
+    primary = ide_object_ref_context (IDE_OBJECT (self));
+
+  if (uri == NULL)
+    return g_steal_pointer (&primary);
+
+  if (primary != NULL)
+    {
+      g_autofree char *primary_uri = ide_lsp_client_dup_primary_uri (self, primary);
+
+      if (uri_is_within (uri, primary_uri))
+        {
+          g_set_object (&best, primary);
+          best_len = strlen (primary_uri);
+        }
+    }
+
+  for (guint i = 0; i < priv->workspace_folders->len; i++)
+    {
+      WorkspaceFolder *folder = g_ptr_array_index (priv->workspace_folders, i);
+      g_autoptr(IdeContext) context = g_weak_ref_get (&folder->context_wr);
+      gsize len = strlen (folder->uri);
+
+      if (context != NULL && len > best_len && uri_is_within (uri, folder->uri))
+        {
+          g_set_object (&best, context);
+          best_len = len;
+        }
+    }
+
+  if (best != NULL)
+    return g_steal_pointer (&best);
+
+  return g_steal_pointer (&primary);
+}
+
+/*
+ * ide_lsp_client_ref_context_for_progress:
+ *
+ * Finds the context a `$/progress` notification belongs to. Reports for a
+ * token which already has a notification go to the context holding it.
+ * New progress goes to the folder mentioned by the token, title or
+ * message, if any, or else to the context the client was started for.
+ */
+static IdeContext *
+ide_lsp_client_ref_context_for_progress (IdeLspClient *self,
+                                         const char   *token,
+                                         const char   *title,
+                                         const char   *message)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  g_autoptr(IdeContext) primary = NULL;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IDE_IS_LSP_CLIENT (self));
+
+  if (!priv->primary_folder_removed)
+    primary = ide_object_ref_context (IDE_OBJECT (self));
+
+  if (token == NULL)
+    return g_steal_pointer (&primary);
+
+  for (guint i = 0; i < priv->workspace_folders->len; i++)
+    {
+      WorkspaceFolder *folder = g_ptr_array_index (priv->workspace_folders, i);
+      g_autoptr(IdeContext) context = g_weak_ref_get (&folder->context_wr);
+      IdeNotifications *notifications;
+
+      if (context == NULL)
+        continue;
+
+      notifications = ide_object_get_child_typed (IDE_OBJECT (context), IDE_TYPE_NOTIFICATIONS);
+
+      if (ide_notifications_find_by_id (notifications, token) != NULL)
+        return g_steal_pointer (&context);
+    }
+
+  if (primary != NULL)
+    {
+      IdeNotifications *notifications = ide_object_get_child_typed (IDE_OBJECT (primary), IDE_TYPE_NOTIFICATIONS);
+
+      if (ide_notifications_find_by_id (notifications, token) != NULL)
+        return g_steal_pointer (&primary);
+    }
+
+  for (guint i = 0; i < priv->workspace_folders->len; i++)
+    {
+      WorkspaceFolder *folder = g_ptr_array_index (priv->workspace_folders, i);
+      g_autoptr(IdeContext) context = g_weak_ref_get (&folder->context_wr);
+
+      if (context != NULL &&
+          (text_mentions_folder (token, folder->uri) ||
+           text_mentions_folder (title, folder->uri) ||
+           text_mentions_folder (message, folder->uri)))
+        return g_steal_pointer (&context);
+    }
+
+  return g_steal_pointer (&primary);
+}
+
+/**
+ * _ide_lsp_client_supports_workspace_folders:
+ * @self: a #IdeLspClient
+ *
+ * Checks if the peer has been initialized and accepts changes to the
+ * set of workspace folders after initialization.
+ *
+ * Returns: %TRUE if workspace folders may be added and removed
+ */
+gboolean
+_ide_lsp_client_supports_workspace_folders (IdeLspClient *self)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  const char *change_notifications_str = NULL;
+  gboolean change_notifications = FALSE;
+  gboolean supported = FALSE;
+
+  g_return_val_if_fail (IDE_IS_LSP_CLIENT (self), FALSE);
+
+  if (!priv->initialized || priv->server_capabilities == NULL)
+    return FALSE;
+
+  if (!JSONRPC_MESSAGE_PARSE (priv->server_capabilities,
+                              "workspace", "{",
+                                "workspaceFolders", "{",
+                                  "supported", JSONRPC_MESSAGE_GET_BOOLEAN (&supported),
+                                "}",
+                              "}") || !supported)
+    return FALSE;
+
+  /* changeNotifications may be a registration id instead of a boolean */
+  if (JSONRPC_MESSAGE_PARSE (priv->server_capabilities,
+                             "workspace", "{",
+                               "workspaceFolders", "{",
+                                 "changeNotifications", JSONRPC_MESSAGE_GET_BOOLEAN (&change_notifications),
+                               "}",
+                             "}"))
+    return change_notifications;
+
+  return JSONRPC_MESSAGE_PARSE (priv->server_capabilities,
+                                "workspace", "{",
+                                  "workspaceFolders", "{",
+                                    "changeNotifications", JSONRPC_MESSAGE_GET_STRING (&change_notifications_str),
+                                  "}",
+                                "}") && !ide_str_empty0 (change_notifications_str);
+}
+
+/**
+ * _ide_lsp_client_add_workspace_folder:
+ * @self: a #IdeLspClient
+ * @context: the #IdeContext of the folder to add
+ *
+ * Adds the working directory of @context as a workspace folder of the
+ * peer and synchronizes buffers opened in @context with it.
+ *
+ * This is used to share a single language server between projects.
+ */
+void
+_ide_lsp_client_add_workspace_folder (IdeLspClient *self,
+                                     IdeContext   *context)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  g_autoptr(GFile) workdir = NULL;
+  WorkspaceFolder *folder;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+  g_return_if_fail (IDE_IS_LSP_CLIENT (self));
+  g_return_if_fail (IDE_IS_CONTEXT (context));
+
+  for (guint i = 0; i < priv->workspace_folders->len; i++)
+    {
+      WorkspaceFolder *existing = g_ptr_array_index (priv->workspace_folders, i);
+      g_autoptr(IdeContext) existing_context = g_weak_ref_get (&existing->context_wr);
+
+      if (existing_context == context)
+        IDE_EXIT;
+    }
+
+  workdir = ide_context_ref_workdir (context);
+
+  folder = g_slice_new0 (WorkspaceFolder);
+  g_weak_ref_init (&folder->context_wr, context);
+  folder->uri = g_file_get_uri (workdir);
+  folder->name = ide_context_dup_title (context);
+  folder->buffer_manager_signals = g_signal_group_new (IDE_TYPE_BUFFER_MANAGER);
+  g_signal_group_connect_object (folder->buffer_manager_signals,
+                                 "buffer-loaded",
+                                 G_CALLBACK (ide_lsp_client_buffer_loaded),
+                                 self,
+                                 G_CONNECT_SWAPPED);
+  g_signal_group_connect_object (folder->buffer_manager_signals,
+                                 "buffer-saved",
+                                 G_CALLBACK (ide_lsp_client_buffer_saved),
+                                 self,
+                                 G_CONNECT_SWAPPED);
+  g_signal_group_connect_object (folder->buffer_manager_signals,
+                                 "buffer-unloaded",
+                                 G_CALLBACK (ide_lsp_client_buffer_unloaded),
+                                 self,
+                                 G_CONNECT_SWAPPED);
+  g_signal_connect_object (folder->buffer_manager_signals,
+                           "bind",
+                           G_CALLBACK (ide_lsp_client_buffer_manager_bind),
+                           self,
+                           G_CONNECT_SWAPPED);
+  g_ptr_array_add (priv->workspace_folders, folder);
+
+  IDE_TRACE_MSG ("Adding workspace folder %s", folder->uri);
+
+  /* The folder must be known before any of its documents are opened */
+  ide_lsp_client_notify_workspace_folder (self, folder->uri, folder->name, TRUE);
+  g_signal_group_set_target (folder->buffer_manager_signals,
+                             ide_buffer_manager_from_context (context));
+
+  IDE_EXIT;
+}
+
+/**
+ * _ide_lsp_client_remove_workspace_folder:
+ * @self: a #IdeLspClient
+ * @context: the #IdeContext of the folder to remove
+ *
+ * Closes the documents belonging to @context and removes its working
+ * directory from the workspace folders of the peer.
+ *
+ * If @context is the context the client was started for, the client
+ * will continue running without a primary workspace folder.
+ */
+void
+_ide_lsp_client_remove_workspace_folder (IdeLspClient *self,
+                                        IdeContext   *context)
 {
-  guint n_items;
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
 
-  g_assert (IDE_IS_MAIN_THREAD ());
-  g_assert (IDE_IS_LSP_CLIENT (self));
-  g_assert (IDE_IS_BUFFER_MANAGER (buffer_manager));
-  g_assert (G_IS_SIGNAL_GROUP (signal_group));
+  IDE_ENTRY;
 
-  n_items = g_list_model_get_n_items (G_LIST_MODEL (buffer_manager));
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+  g_return_if_fail (IDE_IS_LSP_CLIENT (self));
+  g_return_if_fail (IDE_IS_CONTEXT (context));
 
-  for (guint i = 0; i < n_items; i++)
+  for (guint i = 0; i < priv->workspace_folders->len; i++)
     {
-      g_autoptr(IdeBuffer) buffer = NULL;
+      WorkspaceFolder *folder = g_ptr_array_index (priv->workspace_folders, i);
+      g_autoptr(IdeContext) folder_context = g_weak_ref_get (&folder->context_wr);
 
-      buffer = g_list_model_get_item (G_LIST_MODEL (buffer_manager), i);
-      ide_lsp_client_buffer_loaded (self, buffer, buffer_manager);
+      if (folder_context == context)
+        {
+          IDE_TRACE_MSG ("Removing workspace folder %s", folder->uri);
+
+          ide_lsp_client_close_buffers (self, folder->buffer_manager_signals);
+          ide_lsp_client_notify_workspace_folder (self, folder->uri, folder->name, FALSE);
+          g_ptr_array_remove_index (priv->workspace_folders, i);
+
+          IDE_EXIT;
+        }
     }
-}
 
-static void
-ide_lsp_client_buffer_manager_unbind (IdeLspClient   *self,
-                                      GSignalGroup   *signal_group)
-{
-  g_assert (IDE_IS_LSP_CLIENT (self));
-  g_assert (G_IS_SIGNAL_GROUP (signal_group));
+  if (!priv->primary_folder_removed &&
+      context == ide_object_get_context (IDE_OBJECT (self)))
+    {
+      g_autofree char *uri = ide_lsp_client_dup_primary_uri (self, context);
+      g_autofree char *name = ide_context_dup_title (context);
 
-  /* TODO: We need to track everything we've notified so that we
-   *       can notify the peer to release its resources.
-   */
+      IDE_TRACE_MSG ("Removing primary workspace folder %s", uri);
+
+      priv->primary_folder_removed = TRUE;
+
+      ide_lsp_client_close_buffers (self, priv->buffer_manager_signals);
+      g_signal_group_set_target (priv->buffer_manager_signals, NULL);
+      g_signal_group_set_target (priv->project_signals, NULL);
+      ide_lsp_client_notify_workspace_folder (self, uri, name, FALSE);
+    }
+
+  IDE_EXIT;
 }
 
 static void
@@ -756,14 +1581,16 @@ ide_lsp_client_project_file_renamed (IdeLspClient *self,
 static IdeDiagnostics *
 ide_lsp_client_translate_diagnostics (IdeLspClient *self,
                                       GFile        *file,
-                                      GVariantIter *diagnostics)
+                                      GVariantIter *diagnostics,
+                                      gboolean      use_markdown)
 {
-  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
   g_autoptr(GPtrArray) ar = NULL;
   g_autoptr(IdeDiagnostics) ret = NULL;
   GVariant *value;
 
-  g_assert (IDE_IS_MAIN_THREAD ());
+  /* This is called from the reader thread for published diagnostics so
+   * it must not touch anything but immutable state on @self.
+   */
   g_assert (IDE_IS_LSP_CLIENT (self));
   g_assert (diagnostics != NULL);
 
@@ -854,7 +1681,7 @@ ide_lsp_client_translate_diagnostics (IdeLspClient *self,
         }
 
       diag = ide_lsp_diagnostic_new (severity, message, begin_loc, value);
-      if (priv->use_markdown_in_diagnostics)
+      if (use_markdown)
         ide_diagnostic_set_marked_kind (IDE_DIAGNOSTIC (diag), IDE_MARKED_KIND_MARKDOWN);
       ide_diagnostic_take_range (IDE_DIAGNOSTIC (diag), ide_range_new (begin_loc, end_loc));
 
@@ -895,7 +1722,7 @@ ide_lsp_client_translate_diagnostics (IdeLspClient *self,
           related_end_loc = ide_location_new (related_file, end.line, end.column);
 
           diag = ide_lsp_diagnostic_new (IDE_DIAGNOSTIC_NOTE, message, related_begin_loc, NULL);
-          if (priv->use_markdown_in_diagnostics)
+          if (use_markdown)
             ide_diagnostic_set_marked_kind (IDE_DIAGNOSTIC (diag), IDE_MARKED_KIND_MARKDOWN);
           ide_diagnostic_take_range (IDE_DIAGNOSTIC (diag), ide_range_new (related_begin_loc, related_end_loc));
 
@@ -934,14 +1761,30 @@ ide_lsp_client_text_document_publish_diagnostics (IdeLspClient *self,
     "diagnostics", JSONRPC_MESSAGE_GET_ITER (&json_diagnostics)
   );
 
-  if (success)
+  if (priv->prepared != NULL && priv->prepared->params == params)
+    {
+      /* Already translated in the reader thread */
+      IDE_TRACE_MSG ("%"G_GSIZE_FORMAT" prepared diagnostics received for %s",
+                     ide_diagnostics_get_size (priv->prepared->diagnostics),
+                     uri);
+
+      g_hash_table_insert (priv->diagnostics_by_file,
+                           g_object_ref (priv->prepared->file),
+                           g_object_ref (priv->prepared->diagnostics));
+
+      g_signal_emit (self, signals [PUBLISHED_DIAGNOSTICS], 0,
+                     priv->prepared->file,
+                     priv->prepared->diagnostics);
+    }
+  else if (success)
     {
       g_autoptr(GFile) file = NULL;
       g_autoptr(IdeDiagnostics) diagnostics = NULL;
 
       file = g_file_new_for_uri (uri);
 
-      diagnostics = ide_lsp_client_translate_diagnostics (self, file, json_diagnostics);
+      diagnostics = ide_lsp_client_translate_diagnostics (self, file, json_diagnostics,
+                                                          priv->use_markdown_in_diagnostics);
 
       IDE_TRACE_MSG ("%"G_GSIZE_FORMAT" diagnostics received for %s",
                      diagnostics ? ide_diagnostics_get_size (diagnostics) : 0,
@@ -989,7 +1832,7 @@ ide_lsp_client_real_notification (IdeLspClient *self,
           const gchar *title = NULL;
           const gchar *kind = NULL;
           gint64 percentage = -1;
-          IdeContext *context;
+          g_autoptr(IdeContext) context = NULL;
           IdeNotifications *notifications;
           IdeNotification *notification = NULL;
 
@@ -1006,7 +1849,13 @@ ide_lsp_client_real_notification (IdeLspClient *self,
           JSONRPC_MESSAGE_PARSE (params, "value", "{",
                                            "percentage", JSONRPC_MESSAGE_GET_INT64 (&percentage),
                                          "}");
-          context = ide_object_get_context (IDE_OBJECT (self));
+
+          /* Shared clients report progress for every workspace folder, and
+           * may be parked without a context of their own.
+           */
+          if (!(context = ide_lsp_client_ref_context_for_progress (self, token, title, message)))
+            IDE_EXIT;
+
           notifications = ide_object_get_child_typed (IDE_OBJECT (context), IDE_TYPE_NOTIFICATIONS);
           notification = ide_notifications_find_by_id (notifications, token);
           if (notification == NULL)
@@ -1106,12 +1955,26 @@ ide_lsp_client_real_notification (IdeLspClient *self,
   IDE_EXIT;
 }
 
+static void
+prepared_notification_free (gpointer data)
+{
+  PreparedNotification *prepared = data;
+
+  g_clear_pointer (&prepared->method, g_free);
+  g_clear_pointer (&prepared->params, g_variant_unref);
+  g_clear_object (&prepared->file);
+  g_clear_object (&prepared->diagnostics);
+  g_free (prepared);
+}
+
 static void
 ide_lsp_client_send_notification (IdeLspClient  *self,
                                   const gchar   *method,
                                   GVariant      *params,
                                   JsonrpcClient *rpc_client)
 {
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  gint64 begin;
   GQuark detail;
 
   IDE_ENTRY;
@@ -1121,8 +1984,31 @@ ide_lsp_client_send_notification (IdeLspClient  *self,
   g_assert (method != NULL);
   g_assert (JSONRPC_IS_CLIENT (rpc_client));
 
+  /* Stands in for a notification translated in the reader thread. Emit
+   * the original as if it came from the JsonrpcClient so subclasses and
+   * signal handlers still see it, but let publishDiagnostics reuse what
+   * was already translated.
+   */
+  if (priv->reader != NULL && g_str_equal (method, IDE_LSP_READER_PREPARED_METHOD))
+    {
+      PreparedNotification *prepared;
+
+      if ((prepared = ide_lsp_reader_steal_prepared (priv->reader, params)))
+        {
+          priv->prepared = prepared;
+          ide_lsp_client_send_notification (self, prepared->method, prepared->params, rpc_client);
+          priv->prepared = NULL;
+
+          prepared_notification_free (prepared);
+        }
+
+      IDE_EXIT;
+    }
+
   IDE_TRACE_MSG ("Notification: %s", method);
 
+  begin = g_get_monotonic_time ();
+
   /*
    * To avoid leaking quarks we do not create a quark for the string unless
    * it already exists. This should be fine in practice because we only need
@@ -1133,9 +2019,48 @@ ide_lsp_client_send_notification (IdeLspClient  *self,
 
   g_signal_emit (self, signals [NOTIFICATION], detail, method, params);
 
+  ide_lsp_client_account (self, begin);
+
   IDE_EXIT;
 }
 
+static gpointer
+ide_lsp_client_prepare_notification (GObject    *owner,
+                                     const char *method,
+                                     GVariant   *params)
+{
+  IdeLspClient *self = (IdeLspClient *)owner;
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  g_autoptr(GVariantIter) json_diagnostics = NULL;
+  PreparedNotification *prepared;
+  const char *uri = NULL;
+
+  g_assert (IDE_IS_LSP_CLIENT (self));
+  g_assert (method != NULL);
+
+  /* Runs in the reader thread. Only diagnostics are worth translating
+   * here, everything else is cheap enough to handle on the main thread.
+   */
+  if (params == NULL || !g_str_equal (method, "textDocument/publishDiagnostics"))
+    return NULL;
+
+  if (!JSONRPC_MESSAGE_PARSE (params,
+    "uri", JSONRPC_MESSAGE_GET_STRING (&uri),
+    "diagnostics", JSONRPC_MESSAGE_GET_ITER (&json_diagnostics)))
+    return NULL;
+
+  prepared = g_new0 (PreparedNotification, 1);
+  prepared->method = g_strdup (method);
+  prepared->params = g_variant_ref (params);
+  prepared->file = g_file_new_for_uri (uri);
+  prepared->diagnostics = ide_lsp_client_translate_diagnostics (self,
+                                                                prepared->file,
+                                                                json_diagnostics,
+                                                                g_atomic_int_get (&priv->use_markdown_snapshot));
+
+  return prepared;
+}
+
 static void
 ide_lsp_client_apply_edit_cb (GObject      *object,
                               GAsyncResult *result,
@@ -1154,11 +2079,18 @@ ide_lsp_client_apply_edit_cb (GObject      *object,
   g_assert (JSONRPC_IS_CLIENT (call->client));
   g_assert (call->id != NULL);
 
-  if (ide_buffer_manager_apply_edits_finish (bufmgr, result, &error))
+  if (!ide_buffer_manager_apply_edits_finish (bufmgr, result, &error) && call->failure == NULL)
+    call->failure = g_strdup (error->message);
+
+  /* Edits spanning workspace folders are applied by each buffer manager */
+  if (--call->n_active > 0)
+    IDE_EXIT;
+
+  if (call->failure == NULL)
     reply = JSONRPC_MESSAGE_NEW ("applied", JSONRPC_MESSAGE_PUT_BOOLEAN (TRUE));
   else
     reply = JSONRPC_MESSAGE_NEW ("applied", JSONRPC_MESSAGE_PUT_BOOLEAN (FALSE),
-                                 "failureReason", JSONRPC_MESSAGE_PUT_STRING (error->message));
+                                 "failureReason", JSONRPC_MESSAGE_PUT_STRING (call->failure));
 
   jsonrpc_client_reply_async (call->client,
                               call->id,
@@ -1195,14 +2127,46 @@ ide_lsp_client_handle_apply_edit (IdeLspClient  *self,
 
   if (edits->len > 0)
     {
-      g_autoptr(IdeContext) context = ide_object_ref_context (IDE_OBJECT (self));
-      IdeBufferManager *bufmgr = ide_buffer_manager_from_context (context);
+      g_autoptr(GHashTable) by_context = NULL;
+      g_autoptr(AsyncCall) call = NULL;
+      GHashTableIter iter;
+      gpointer key, value;
+
+      /* A shared client may edit files of several workspace folders, each
+       * of which must go through the buffer manager of its own context.
+       */
+      by_context = g_hash_table_new_full (NULL, NULL, g_object_unref, (GDestroyNotify)g_ptr_array_unref);
+
+      for (guint i = 0; i < edits->len; i++)
+        {
+          IdeTextEdit *edit = g_ptr_array_index (edits, i);
+          IdeLocation *begin = ide_range_get_begin (ide_text_edit_get_range (edit));
+          g_autofree char *uri = g_file_get_uri (ide_location_get_file (begin));
+          g_autoptr(IdeContext) context = ide_lsp_client_ref_context_for_uri (self, uri);
+          GPtrArray *group;
+
+          if (context == NULL)
+            IDE_GOTO (invalid_params);
+
+          if (!(group = g_hash_table_lookup (by_context, context)))
+            {
+              group = g_ptr_array_new_with_free_func (g_object_unref);
+              g_hash_table_insert (by_context, g_object_ref (context), group);
+            }
+
+          g_ptr_array_add (group, g_object_ref (edit));
+        }
 
-      ide_buffer_manager_apply_edits_async (bufmgr,
-                                            IDE_PTR_ARRAY_STEAL_FULL (&edits),
-                                            NULL,
-                                            ide_lsp_client_apply_edit_cb,
-                                            async_call_new (client, id));
+      call = async_call_new (client, id);
+      call->n_active = g_hash_table_size (by_context);
+
+      g_hash_table_iter_init (&iter, by_context);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        ide_buffer_manager_apply_edits_async (ide_buffer_manager_from_context (key),
+                                              g_ptr_array_ref (value),
+                                              NULL,
+                                              ide_lsp_client_apply_edit_cb,
+                                              g_atomic_rc_box_acquire (call));
 
       IDE_RETURN (TRUE);
     }
@@ -1212,11 +2176,11 @@ invalid_params:
 }
 
 static gboolean
-ide_lsp_client_handle_call (IdeLspClient  *self,
-                            const gchar   *method,
-                            GVariant      *id,
-                            GVariant      *params,
-                            JsonrpcClient *client)
+ide_lsp_client_real_handle_call (IdeLspClient  *self,
+                                 const gchar   *method,
+                                 GVariant      *id,
+                                 GVariant      *params,
+                                 JsonrpcClient *client)
 {
   IDE_ENTRY;
 
@@ -1266,10 +2230,33 @@ ide_lsp_client_handle_call (IdeLspClient  *self,
       jsonrpc_client_reply_async (client, id, NULL, NULL, NULL, NULL);
       IDE_RETURN (TRUE);
     }
+  else if (strcmp (method, "workspace/workspaceFolders") == 0)
+    {
+      g_autoptr(GVariant) reply = ide_lsp_client_dup_workspace_folders (self);
+
+      jsonrpc_client_reply_async (client, id, reply, NULL, NULL, NULL);
+      IDE_RETURN (TRUE);
+    }
 
   IDE_RETURN (FALSE);
 }
 
+static gboolean
+ide_lsp_client_handle_call (IdeLspClient  *self,
+                            const gchar   *method,
+                            GVariant      *id,
+                            GVariant      *params,
+                            JsonrpcClient *client)
+{
+  gint64 begin = g_get_monotonic_time ();
+  gboolean ret;
+
+  ret = ide_lsp_client_real_handle_call (self, method, id, params, client);
+  ide_lsp_client_account (self, begin);
+
+  return ret;
+}
+
 static void
 ide_lsp_client_destroy (IdeObject *object)
 {
@@ -1278,17 +2265,50 @@ ide_lsp_client_destroy (IdeObject *object)
 
   g_assert (IDE_IS_MAIN_THREAD ());
 
-  if (priv->rpc_client != NULL)
-    g_object_run_dispose (G_OBJECT (priv->rpc_client));
+  while (priv->requests.length > 0)
+    request_cancel (priv->requests.head->data,
+                    _("The operation has been cancelled"));
 
-  while (priv->pending_messages.length > 0)
+  /* Stop the reader thread first so nothing is dispatched to us
+   * while the JSON-RPC client is torn down.
+   */
+  if (priv->reader != NULL)
     {
-      PendingMessage *message = priv->pending_messages.head->data;
+      IdeLspReaderStats stats;
 
-      g_queue_unlink (&priv->pending_messages, &message->link);
-      pending_message_fail (message);
+      ide_lsp_reader_close (priv->reader);
+      ide_lsp_reader_get_stats (priv->reader, &stats);
+
+      IDE_TRACE_MSG ("%s: %"G_GUINT64_FORMAT" messages, %"G_GUINT64_FORMAT" bytes, "
+                     "decode=%"G_GUINT64_FORMAT"usec main-thread=%"G_GUINT64_FORMAT"usec",
+                     G_OBJECT_TYPE_NAME (self), stats.n_messages, stats.n_bytes,
+                     stats.decode_usec, priv->main_thread_usec);
     }
 
+  if (priv->rpc_client != NULL)
+    g_object_run_dispose (G_OBJECT (priv->rpc_client));
+
+  /* The JSON-RPC client only owned the reader pipe */
+  if (priv->reader != NULL && priv->io_stream != NULL)
+    g_input_stream_close (g_io_stream_get_input_stream (priv->io_stream), NULL, NULL);
+
+#ifdef IDE_ENABLE_TRACE
+  {
+    GHashTableIter iter;
+    const char *method;
+    RequestStats *stats;
+
+    g_hash_table_iter_init (&iter, priv->request_stats);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&method, (gpointer *)&stats))
+      IDE_TRACE_MSG ("%s: issued=%"G_GUINT64_FORMAT" coalesced=%"G_GUINT64_FORMAT
+                     " cancelled=%"G_GUINT64_FORMAT" superseded=%"G_GUINT64_FORMAT
+                     " max-latency=%"G_GUINT64_FORMAT"usec",
+                     method, stats->issued, stats->coalesced,
+                     stats->cancelled, stats->superseded,
+                     stats->max_latency_usec);
+  }
+#endif
+
   IDE_OBJECT_CLASS (ide_lsp_client_parent_class)->destroy (object);
 }
 
@@ -1300,14 +2320,19 @@ ide_lsp_client_finalize (GObject *object)
 
   g_assert (IDE_IS_MAIN_THREAD ());
 
+  g_clear_object (&priv->reader);
   g_clear_pointer (&priv->name, g_free);
   g_clear_pointer (&priv->diagnostics_by_file, g_hash_table_unref);
   g_clear_pointer (&priv->server_capabilities, g_variant_unref);
   g_clear_pointer (&priv->languages, g_ptr_array_unref);
   g_clear_pointer (&priv->root_uri, g_free);
+  g_clear_pointer (&priv->request_policies, g_hash_table_unref);
+  g_clear_pointer (&priv->request_stats, g_hash_table_unref);
   g_clear_object (&priv->rpc_client);
   g_clear_object (&priv->buffer_manager_signals);
   g_clear_object (&priv->project_signals);
+  g_clear_pointer (&priv->workspace_folders, g_ptr_array_unref);
+  g_clear_pointer (&priv->bridges, g_hash_table_unref);
 
   G_OBJECT_CLASS (ide_lsp_client_parent_class)->finalize (object);
 }
@@ -1389,6 +2414,7 @@ ide_lsp_client_set_property (GObject      *object,
     {
     case PROP_USE_MARKDOWN_IN_DIAGNOSTICS:
       priv->use_markdown_in_diagnostics = g_value_get_boolean (value);
+      g_atomic_int_set (&priv->use_markdown_snapshot, priv->use_markdown_in_diagnostics);
       break;
 
     case PROP_NAME:
@@ -1569,8 +2595,17 @@ ide_lsp_client_init (IdeLspClient *self)
 
   priv->trace = IDE_LSP_TRACE_OFF;
   priv->languages = g_ptr_array_new_with_free_func (g_free);
+  priv->workspace_folders = g_ptr_array_new_with_free_func ((GDestroyNotify)workspace_folder_free);
   priv->initialized = FALSE;
 
+  priv->request_stats = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  priv->request_policies = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (guint i = 0; i < G_N_ELEMENTS (default_policies); i++)
+    g_hash_table_insert (priv->request_policies,
+                         g_strdup (default_policies[i].method),
+                         GUINT_TO_POINTER (default_policies[i].policy));
+
+  priv->bridges = g_hash_table_new (NULL, NULL);
   priv->diagnostics_by_file = g_hash_table_new_full ((GHashFunc)g_file_hash,
                                                      (GEqualFunc)g_file_equal,
                                                      g_object_unref,
@@ -1630,16 +2665,17 @@ ide_lsp_client_flush_queue (IdeLspClient *self)
   g_assert (IDE_IS_LSP_CLIENT (self));
   g_return_if_fail (!priv->rpc_client || JSONRPC_IS_CLIENT (priv->rpc_client));
 
-  if (priv->pending_messages.length == 0 || priv->rpc_client == NULL)
+  if (priv->requests.length == 0 || priv->rpc_client == NULL)
     IDE_EXIT;
 
-  IDE_TRACE_MSG ("Flushing pending queue of length %u", priv->pending_messages.length);
+  IDE_TRACE_MSG ("Flushing queue of length %u", priv->requests.length);
 
-  while (priv->pending_messages.length > 0)
+  for (const GList *iter = priv->requests.head; iter; iter = iter->next)
     {
-      PendingMessage *message = priv->pending_messages.head->data;
-      g_queue_unlink (&priv->pending_messages, &message->link);
-      pending_message_submit (message, priv->rpc_client);
+      Request *request = iter->data;
+
+      if (!request->submitted)
+        request_submit (request, priv->rpc_client);
     }
 
   IDE_EXIT;
@@ -1772,7 +2808,10 @@ void
 ide_lsp_client_start (IdeLspClient *self)
 {
   IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  g_autoptr(IdeLspRecorder) recorder = NULL;
+  g_autoptr(GIOStream) io_stream = NULL;
   g_autoptr(GVariant) params = NULL;
+  g_autoptr(GError) error = NULL;
   g_autofree gchar *root_path = NULL;
   g_autofree gchar *root_uri = NULL;
   g_autofree gchar *basename = NULL;
@@ -1795,7 +2834,38 @@ ide_lsp_client_start (IdeLspClient *self)
       return;
     }
 
-  priv->rpc_client = jsonrpc_client_new (priv->io_stream);
+  /* Setting IDE_LSP_RECORD_DIR captures the session so that it can be
+   * replayed later without the language server (see IdeLspReplay).
+   */
+  if ((recorder = ide_lsp_recorder_new_for_environment (G_OBJECT_TYPE_NAME (self))))
+    io_stream = ide_lsp_recorder_wrap (recorder, priv->io_stream);
+  else
+    io_stream = g_object_ref (priv->io_stream);
+
+  /* Translate diagnostics on a dedicated thread so that diagnostics
+   * storms do not stall the main loop. Everything else is forwarded to
+   * the JSON-RPC client untouched, in the order it was received.
+   */
+  if (!(priv->reader = ide_lsp_reader_new (g_io_stream_get_input_stream (io_stream),
+                                           G_OBJECT (self),
+                                           IDE_STRV_INIT ("textDocument/publishDiagnostics"),
+                                           ide_lsp_client_prepare_notification,
+                                           prepared_notification_free,
+                                           &error)))
+    {
+      g_warning ("Failed to create reader thread, decoding on main thread: %s",
+                 error->message);
+      g_clear_error (&error);
+      priv->rpc_client = jsonrpc_client_new (io_stream);
+    }
+  else
+    {
+      g_autoptr(GIOStream) stream = NULL;
+
+      stream = g_simple_io_stream_new (ide_lsp_reader_get_input_stream (priv->reader),
+                                       g_io_stream_get_output_stream (io_stream));
+      priv->rpc_client = jsonrpc_client_new (stream);
+    }
 
   basename = ide_context_dup_title (context);
   workdir = ide_context_ref_workdir (context);
@@ -1859,6 +2929,7 @@ ide_lsp_client_start (IdeLspClient *self)
       "workspace", "{",
         "applyEdit", JSONRPC_MESSAGE_PUT_BOOLEAN (TRUE),
         "configuration", JSONRPC_MESSAGE_PUT_BOOLEAN (TRUE),
+        "workspaceFolders", JSONRPC_MESSAGE_PUT_BOOLEAN (TRUE),
         "symbol", "{",
           "SymbolKind", "{",
             "valueSet", "[",
@@ -2068,60 +3139,29 @@ ide_lsp_client_stop (IdeLspClient *self)
 }
 
 static void
-ide_lsp_client_call_cb (GObject      *object,
-                        GAsyncResult *result,
-                        gpointer      user_data)
+ide_lsp_client_request_cb (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
 {
   JsonrpcClient *client = (JsonrpcClient *)object;
+  g_autoptr(Request) request = user_data;
   g_autoptr(GVariant) reply = NULL;
   g_autoptr(GError) error = NULL;
-  g_autoptr(IdeTask) task = user_data;
 
   IDE_ENTRY;
 
   g_assert (IDE_IS_MAIN_THREAD ());
   g_assert (JSONRPC_IS_CLIENT (client));
   g_assert (G_IS_ASYNC_RESULT (result));
-  g_assert (IDE_IS_TASK (task));
-
-  if (!jsonrpc_client_call_finish (client, result, &reply, &error))
-    ide_task_return_error (task, g_steal_pointer (&error));
-  else
-    ide_task_return_pointer (task,
-                             g_steal_pointer (&reply),
-                             g_variant_unref);
-
-  IDE_EXIT;
-}
-
-static void
-ide_lsp_client_queue_message (IdeLspClient *self,
-                              const char   *method,
-                              GVariant     *params,
-                              GCancellable *cancellable,
-                              IdeTask      *task)
-
-{
-  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
-  PendingMessage *pending;
-
-  IDE_ENTRY;
-
-  g_assert (IDE_IS_LSP_CLIENT (self));
-  g_assert (method != NULL);
-  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
-  g_assert (IDE_IS_TASK (task));
+  g_assert (request != NULL);
 
-  IDE_TRACE_MSG ("Queuing LSP call to method %s", method);
+  jsonrpc_client_call_finish (client, result, &reply, &error);
 
-  pending = g_slice_new0 (PendingMessage);
-  pending->link.data = pending;
-  pending->task = g_steal_pointer (&task);
-  pending->method = g_strdup (method);
-  pending->params = params ? g_variant_ref (params) : NULL;
-  g_set_object (&pending->cancellable, cancellable);
+  /* Waiters were already completed when cancelled or superseded */
+  if (request->finished)
+    IDE_EXIT;
 
-  g_queue_push_tail_link (&priv->pending_messages, &pending->link);
+  request_complete (request, reply, error);
 
   IDE_EXIT;
 }
@@ -2137,6 +3177,12 @@ ide_lsp_client_queue_message (IdeLspClient *self,
  *
  * Asynchronously queries the Language Server using the JSON-RPC protocol.
  *
+ * The request is subject to the #IdeLspRequestPolicy registered for
+ * @method with ide_lsp_client_set_request_policy(). Depending on the
+ * policy, cancelling @cancellable sends `$/cancelRequest` to the server,
+ * an in-flight request of the same kind for the same document is
+ * superseded, and identical in-flight requests share a single reply.
+ *
  * If @params is floating, it's floating reference is consumed.
  */
 void
@@ -2148,7 +3194,12 @@ ide_lsp_client_call_async (IdeLspClient        *self,
                            gpointer             user_data)
 {
   IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  g_autoptr(GVariant) sunk = NULL;
   g_autoptr(IdeTask) task = NULL;
+  g_autofree char *uri = NULL;
+  IdeLspRequestPolicy policy;
+  RequestStats *stats;
+  Request *request;
 
   IDE_ENTRY;
 
@@ -2158,6 +3209,9 @@ ide_lsp_client_call_async (IdeLspClient        *self,
   g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
   g_return_if_fail (!priv->rpc_client || JSONRPC_IS_CLIENT (priv->rpc_client));
 
+  if (params != NULL)
+    sunk = g_variant_ref_sink (params);
+
   task = ide_task_new (self, cancellable, callback, user_data);
   ide_task_set_source_tag (task, ide_lsp_client_call_async);
 
@@ -2170,23 +3224,65 @@ ide_lsp_client_call_async (IdeLspClient        *self,
       IDE_EXIT;
     }
 
-  if (!priv->initialized &&
-      !(g_str_equal (method, "initialize") || g_str_equal (method, "initialized")))
+  if (ide_task_return_error_if_cancelled (task))
+    IDE_EXIT;
+
+  policy = ide_lsp_client_get_request_policy (self, method);
+  stats = ide_lsp_client_get_stats (self, method);
+  uri = extract_document_uri (sunk);
+
+  if (policy & IDE_LSP_REQUEST_POLICY_COALESCE)
     {
-      ide_lsp_client_queue_message (self,
-                                    method,
-                                    params,
-                                    cancellable,
-                                    g_steal_pointer (&task));
-      IDE_EXIT;
+      for (const GList *iter = priv->requests.head; iter; iter = iter->next)
+        {
+          request = iter->data;
+
+          /* Documents changing in between make the reply stale */
+          if (request->serial == priv->document_serial &&
+              g_str_equal (request->method, method) &&
+              ((sunk == NULL && request->params == NULL) ||
+               (sunk != NULL && request->params != NULL &&
+                g_variant_equal (sunk, request->params))))
+            {
+              IDE_TRACE_MSG ("Coalescing %s with in-flight request", method);
+              stats->coalesced++;
+              ide_counter_inc (&lsp_coalesced);
+              request_add_waiter (request, task);
+              IDE_EXIT;
+            }
+        }
     }
 
-  jsonrpc_client_call_async (priv->rpc_client,
-                             method,
-                             params,
-                             cancellable,
-                             ide_lsp_client_call_cb,
-                             g_steal_pointer (&task));
+  if (policy & IDE_LSP_REQUEST_POLICY_SUPERSEDE)
+    {
+      const GList *iter = priv->requests.head;
+
+      while (iter != NULL)
+        {
+          request = iter->data;
+          iter = iter->next;
+
+          if (g_str_equal (request->method, method) &&
+              g_strcmp0 (request->uri, uri) == 0)
+            {
+              IDE_TRACE_MSG ("Superseding in-flight %s request", method);
+              stats->superseded++;
+              ide_counter_inc (&lsp_superseded);
+              request_cancel (request, _("The request was superseded by a newer request"));
+            }
+        }
+    }
+
+  request = request_new (self, method, uri, sunk, policy);
+  request_add_waiter (request, task);
+  g_queue_push_tail_link (&priv->requests, &request->link);
+
+  if (priv->initialized ||
+      g_str_equal (method, "initialize") ||
+      g_str_equal (method, "initialized"))
+    request_submit (request, priv->rpc_client);
+  else
+    IDE_TRACE_MSG ("Queuing LSP call to method %s", method);
 
   IDE_EXIT;
 }
@@ -2272,6 +3368,10 @@ ide_lsp_client_send_notification_async (IdeLspClient        *self,
   task = ide_task_new (self, cancellable, notificationback, user_data);
   ide_task_set_source_tag (task, ide_lsp_client_send_notification_async);
 
+  /* Prevents coalescing requests across document changes */
+  if (g_str_has_prefix (method, "textDocument/did"))
+    priv->document_serial++;
+
   if (priv->rpc_client == NULL)
     ide_task_return_new_error (task,
                                G_IO_ERROR,
@@ -2525,3 +3625,150 @@ ide_lsp_client_set_name (IdeLspClient *self,
   if (g_set_str (&priv->name, name))
     g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_NAME]);
 }
+
+/**
+ * ide_lsp_client_set_request_policy:
+ * @self: a [class@LspClient]
+ * @method: the JSON-RPC method such as "textDocument/hover"
+ * @policy: the #IdeLspRequestPolicy for @method
+ *
+ * Sets how requests to @method are handled while in flight.
+ *
+ * Language servers which are slow to cancel, or which do not support a
+ * given optimization, may adjust the defaults here after creating the
+ * client.
+ *
+ * Since: 50
+ */
+void
+ide_lsp_client_set_request_policy (IdeLspClient        *self,
+                                   const char          *method,
+                                   IdeLspRequestPolicy  policy)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+
+  g_return_if_fail (IDE_IS_LSP_CLIENT (self));
+  g_return_if_fail (method != NULL);
+
+  g_hash_table_insert (priv->request_policies,
+                       g_strdup (method),
+                       GUINT_TO_POINTER (policy));
+}
+
+/**
+ * ide_lsp_client_get_request_policy:
+ * @self: a [class@LspClient]
+ * @method: the JSON-RPC method such as "textDocument/hover"
+ *
+ * Gets the policy used for requests to @method.
+ *
+ * Methods without an explicit policy use %IDE_LSP_REQUEST_POLICY_CANCEL.
+ *
+ * Returns: an #IdeLspRequestPolicy
+ *
+ * Since: 50
+ */
+IdeLspRequestPolicy
+ide_lsp_client_get_request_policy (IdeLspClient *self,
+                                   const char   *method)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  gpointer value;
+
+  g_return_val_if_fail (IDE_IS_LSP_CLIENT (self), 0);
+  g_return_val_if_fail (method != NULL, 0);
+
+  if (g_hash_table_lookup_extended (priv->request_policies, method, NULL, &value))
+    return GPOINTER_TO_UINT (value);
+
+  return IDE_LSP_REQUEST_POLICY_CANCEL;
+}
+
+/**
+ * ide_lsp_client_dup_request_stats:
+ * @self: a [class@LspClient]
+ *
+ * Gets statistics about requests made to the language server, keyed by
+ * method name.
+ *
+ * Each value is a vardict containing the number of requests "issued"
+ * to the server, "coalesced" into an in-flight request, "cancelled" by
+ * the caller and "superseded" by a newer request, as well as the
+ * "mean-latency-usec" and "max-latency-usec" of replies.
+ *
+ * Returns: (transfer full): a #GVariant of type `a{sa{sv}}`
+ *
+ * Since: 50
+ */
+GVariant *
+ide_lsp_client_dup_request_stats (IdeLspClient *self)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  const char *method;
+  RequestStats *stats;
+
+  g_return_val_if_fail (IDE_IS_LSP_CLIENT (self), NULL);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sa{sv}}"));
+
+  g_hash_table_iter_init (&iter, priv->request_stats);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&method, (gpointer *)&stats))
+    {
+      guint64 mean = stats->completed ? stats->total_latency_usec / stats->completed : 0;
+
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("{sa{sv}}"));
+      g_variant_builder_add (&builder, "s", method);
+      g_variant_builder_open (&builder, G_VARIANT_TYPE_VARDICT);
+      g_variant_builder_add_parsed (&builder, "{'issued', <%t>}", stats->issued);
+      g_variant_builder_add_parsed (&builder, "{'coalesced', <%t>}", stats->coalesced);
+      g_variant_builder_add_parsed (&builder, "{'cancelled', <%t>}", stats->cancelled);
+      g_variant_builder_add_parsed (&builder, "{'superseded', <%t>}", stats->superseded);
+      g_variant_builder_add_parsed (&builder, "{'mean-latency-usec', <%t>}", mean);
+      g_variant_builder_add_parsed (&builder, "{'max-latency-usec', <%t>}", stats->max_latency_usec);
+      g_variant_builder_close (&builder);
+      g_variant_builder_close (&builder);
+    }
+
+  return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+/**
+ * ide_lsp_client_dup_traffic_stats:
+ * @self: a [class@LspClient]
+ *
+ * Gets statistics about messages received from the language server.
+ *
+ * The vardict contains the number of "messages" and "bytes" read, how
+ * many were "prepared" off the main thread, the time spent decoding in
+ * "decode-usec", the time spent handling messages on the main thread in
+ * "main-thread-usec" and the deepest backlog of prepared messages
+ * waiting for the main thread in "max-pending".
+ *
+ * Returns: (transfer full): a #GVariant of type `a{sv}`
+ *
+ * Since: 50
+ */
+GVariant *
+ide_lsp_client_dup_traffic_stats (IdeLspClient *self)
+{
+  IdeLspClientPrivate *priv = ide_lsp_client_get_instance_private (self);
+  IdeLspReaderStats stats = {0};
+  GVariantBuilder builder;
+
+  g_return_val_if_fail (IDE_IS_LSP_CLIENT (self), NULL);
+
+  if (priv->reader != NULL)
+    ide_lsp_reader_get_stats (priv->reader, &stats);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add_parsed (&builder, "{'messages', <%t>}", stats.n_messages);
+  g_variant_builder_add_parsed (&builder, "{'bytes', <%t>}", stats.n_bytes);
+  g_variant_builder_add_parsed (&builder, "{'prepared', <%t>}", stats.n_prepared);
+  g_variant_builder_add_parsed (&builder, "{'decode-usec', <%t>}", stats.decode_usec);
+  g_variant_builder_add_parsed (&builder, "{'main-thread-usec', <%t>}", priv->main_thread_usec);
+  g_variant_builder_add_parsed (&builder, "{'max-pending', <%u>}", stats.max_pending);
+
+  return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
@@ -40,6 +40,26 @@ typedef enum
   IDE_LSP_TRACE_VERBOSE,
 } IdeLspTrace;
 
+/**
+ * IdeLspRequestPolicy:
+ * @IDE_LSP_REQUEST_POLICY_NONE: requests are sent as-is
+ * @IDE_LSP_REQUEST_POLICY_CANCEL: send `$/cancelRequest` when the caller
+ *   cancels the request
+ * @IDE_LSP_REQUEST_POLICY_SUPERSEDE: a new request cancels in-flight
+ *   requests of the same method for the same document
+ * @IDE_LSP_REQUEST_POLICY_COALESCE: identical in-flight requests share
+ *   a single reply from the language server
+ *
+ * Since: 50
+ */
+typedef enum
+{
+  IDE_LSP_REQUEST_POLICY_NONE      = 0,
+  IDE_LSP_REQUEST_POLICY_CANCEL    = 1 << 0,
+  IDE_LSP_REQUEST_POLICY_SUPERSEDE = 1 << 1,
+  IDE_LSP_REQUEST_POLICY_COALESCE  = 1 << 2,
+} IdeLspRequestPolicy;
+
 struct _IdeLspClientClass
 {
   IdeObjectClass parent_class;
@@ -122,5 +142,16 @@ void          ide_lsp_client_set_initialization_options (IdeLspClient         *s
                                                          GVariant             *options);
 IDE_AVAILABLE_IN_ALL
 GVariant     *ide_lsp_client_get_initialization_options (IdeLspClient         *self);
+IDE_AVAILABLE_IN_50
+void                ide_lsp_client_set_request_policy (IdeLspClient         *self,
+                                                       const char           *method,
+                                                       IdeLspRequestPolicy   policy);
+IDE_AVAILABLE_IN_50
+IdeLspRequestPolicy ide_lsp_client_get_request_policy (IdeLspClient         *self,
+                                                       const char           *method);
+IDE_AVAILABLE_IN_50
+GVariant           *ide_lsp_client_dup_request_stats  (IdeLspClient         *self);
+IDE_AVAILABLE_IN_50
+GVariant           *ide_lsp_client_dup_traffic_stats  (IdeLspClient         *self);
 
 G_END_DECLS
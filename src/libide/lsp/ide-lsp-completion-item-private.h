@@ -0,0 +1,33 @@
+/* ide-lsp-completion-item-private.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <libide-code.h>
+
+#include "ide-lsp-completion-item.h"
+
+G_BEGIN_DECLS
+
+IdeLspCompletionItem *_ide_lsp_completion_item_new_with_kind (GVariant      *variant,
+                                                              IdeSymbolKind  kind);
+IdeSymbolKind         _ide_lsp_completion_item_get_kind      (IdeLspCompletionItem *self);
+
+G_END_DECLS
@@ -26,7 +26,7 @@
 
 #include <jsonrpc-glib.h>
 
-#include "ide-lsp-completion-item.h"
+#include "ide-lsp-completion-item-private.h"
 #include "ide-lsp-util.h"
 
 struct _IdeLspCompletionItem
@@ -76,30 +76,65 @@ ide_lsp_completion_item_init (IdeLspCompletionItem *self)
 {
 }
 
-IdeLspCompletionItem *
-ide_lsp_completion_item_new (GVariant *variant)
+static IdeLspCompletionItem *
+ide_lsp_completion_item_new_internal (GVariant *variant,
+                                      gboolean  decode_kind,
+                                      guint     kind)
 {
   g_autoptr(GVariant) unboxed = NULL;
   IdeLspCompletionItem *self;
-  gint64 kind = 0;
+  gint64 lsp_kind = 0;
 
-  g_return_val_if_fail (variant != NULL, NULL);
+  g_assert (variant != NULL);
 
   if (g_variant_is_of_type (variant, G_VARIANT_TYPE_VARIANT))
     variant = unboxed = g_variant_get_variant (variant);
 
   self = g_object_new (IDE_TYPE_LSP_COMPLETION_ITEM, NULL);
   self->variant = g_variant_ref_sink (variant);
+  self->kind = kind;
 
   g_variant_lookup (variant, "label", "&s", &self->label);
   g_variant_lookup (variant, "detail", "&s", &self->detail);
 
-  if (JSONRPC_MESSAGE_PARSE (variant, "kind", JSONRPC_MESSAGE_GET_INT64 (&kind)))
-    self->kind = ide_lsp_decode_completion_kind (kind);
+  if (decode_kind &&
+      JSONRPC_MESSAGE_PARSE (variant, "kind", JSONRPC_MESSAGE_GET_INT64 (&lsp_kind)))
+    self->kind = ide_lsp_decode_completion_kind (lsp_kind);
 
   return self;
 }
 
+IdeLspCompletionItem *
+ide_lsp_completion_item_new (GVariant *variant)
+{
+  g_return_val_if_fail (variant != NULL, NULL);
+
+  return ide_lsp_completion_item_new_internal (variant, TRUE, IDE_SYMBOL_KIND_NONE);
+}
+
+/*
+ * _ide_lsp_completion_item_new_with_kind:
+ *
+ * Like ide_lsp_completion_item_new() but uses @kind, already decoded by
+ * IdeLspCompletionResults, instead of parsing it from @variant again.
+ */
+IdeLspCompletionItem *
+_ide_lsp_completion_item_new_with_kind (GVariant      *variant,
+                                        IdeSymbolKind  kind)
+{
+  g_return_val_if_fail (variant != NULL, NULL);
+
+  return ide_lsp_completion_item_new_internal (variant, FALSE, kind);
+}
+
+IdeSymbolKind
+_ide_lsp_completion_item_get_kind (IdeLspCompletionItem *self)
+{
+  g_return_val_if_fail (IDE_IS_LSP_COMPLETION_ITEM (self), IDE_SYMBOL_KIND_NONE);
+
+  return self->kind;
+}
+
 const gchar *
 ide_lsp_completion_item_get_return_type (IdeLspCompletionItem *self)
 {
@@ -29,7 +29,7 @@
 
 #include "ide-lsp-completion-provider.h"
 #include "ide-lsp-completion-item.h"
-#include "ide-lsp-completion-results.h"
+#include "ide-lsp-completion-results-private.h"
 #include "ide-lsp-util.h"
 
 typedef struct
@@ -38,11 +38,17 @@ typedef struct
   char          *word;
   char         **trigger_chars;
   char          *refilter_word;
+  GCancellable  *requery_cancellable;
   guint          has_loaded : 1;
 } IdeLspCompletionProviderPrivate;
 
 static void provider_iface_init (GtkSourceCompletionProviderInterface *iface);
 
+IDE_DEFINE_COUNTER (completion_populate, "Completion", "Populate", "Number of completion requests");
+IDE_DEFINE_COUNTER (completion_populate_usec, "Completion", "Populate (usec)", "Time until completion results were ready");
+IDE_DEFINE_COUNTER (completion_refilter, "Completion", "Refilter", "Number of completion refilters");
+IDE_DEFINE_COUNTER (completion_refilter_usec, "Completion", "Refilter (usec)", "Time spent refiltering completion results");
+
 G_DEFINE_ABSTRACT_TYPE_WITH_CODE (IdeLspCompletionProvider, ide_lsp_completion_provider, IDE_TYPE_OBJECT,
                                   G_ADD_PRIVATE (IdeLspCompletionProvider)
                                   G_IMPLEMENT_INTERFACE (GTK_SOURCE_TYPE_COMPLETION_PROVIDER, provider_iface_init))
@@ -68,7 +74,9 @@ ide_lsp_completion_provider_finalize (GObject *object)
 
   g_clear_object (&priv->client);
   g_clear_pointer (&priv->word, g_free);
+  g_clear_pointer (&priv->refilter_word, g_free);
   g_clear_pointer (&priv->trigger_chars, g_free);
+  g_clear_object (&priv->requery_cancellable);
 
   G_OBJECT_CLASS (ide_lsp_completion_provider_parent_class)->finalize (object);
 }
@@ -223,6 +231,42 @@ ide_lsp_completion_provider_get_priority (GtkSourceCompletionProvider *provider,
   return IDE_LSP_COMPLETION_PROVIDER_PRIORITY;
 }
 
+static GVariant *
+ide_lsp_completion_provider_create_params (IdeLspCompletionProvider   *self,
+                                           GtkSourceCompletionContext *context,
+                                           int                         trigger_kind)
+{
+  g_autofree char *uri = NULL;
+  GtkSourceBuffer *buffer;
+  GtkTextIter iter, end;
+  int line;
+  int column;
+
+  g_assert (IDE_IS_LSP_COMPLETION_PROVIDER (self));
+  g_assert (GTK_SOURCE_IS_COMPLETION_CONTEXT (context));
+
+  gtk_source_completion_context_get_bounds (context, &iter, &end);
+
+  buffer = gtk_source_completion_context_get_buffer (context);
+  uri = ide_buffer_dup_uri (IDE_BUFFER (buffer));
+
+  line = gtk_text_iter_get_line (&iter);
+  column = gtk_text_iter_get_line_offset (&iter);
+
+  return JSONRPC_MESSAGE_NEW (
+    "textDocument", "{",
+      "uri", JSONRPC_MESSAGE_PUT_STRING (uri),
+    "}",
+    "position", "{",
+      "line", JSONRPC_MESSAGE_PUT_INT32 (line),
+      "character", JSONRPC_MESSAGE_PUT_INT32 (column),
+    "}",
+    "context", "{",
+      "triggerKind", JSONRPC_MESSAGE_PUT_INT32 (trigger_kind),
+    "}"
+  );
+}
+
 static void
 ide_lsp_completion_provider_complete_cb (GObject      *object,
                                          GAsyncResult *result,
@@ -235,6 +279,7 @@ ide_lsp_completion_provider_complete_cb (GObject      *object,
   g_autoptr(IdeTask) task = user_data;
   g_autoptr(GError) error = NULL;
   IdeLspCompletionResults *ret;
+  const gint64 *begin;
 
   IDE_ENTRY;
 
@@ -263,6 +308,12 @@ ide_lsp_completion_provider_complete_cb (GObject      *object,
       ide_lsp_completion_results_refilter (ret, priv->word);
     }
 
+  begin = ide_task_get_task_data (task);
+  ide_counter_add (&completion_populate_usec, (ide_profiler_now () - *begin) / 1000);
+  IDE_PROFILER_SPAN_END (*begin, "Completion", "Populate", "%s: %u items",
+                         G_OBJECT_TYPE_NAME (self),
+                         g_list_model_get_n_items (G_LIST_MODEL (ret)));
+
   ide_task_return_object (task, g_steal_pointer (&ret));
 
   IDE_EXIT;
@@ -280,12 +331,8 @@ ide_lsp_completion_provider_populate_async (GtkSourceCompletionProvider *provide
   GtkSourceCompletionActivation activation;
   g_autoptr(IdeTask) task = NULL;
   g_autoptr(GVariant) params = NULL;
-  g_autofree char *uri = NULL;
-  GtkTextIter iter, end;
-  GtkSourceBuffer *buffer;
+  gint64 *begin;
   gint trigger_kind;
-  gint line;
-  gint column;
 
   IDE_ENTRY;
 
@@ -301,9 +348,18 @@ ide_lsp_completion_provider_populate_async (GtkSourceCompletionProvider *provide
   g_clear_pointer (&priv->refilter_word, g_free);
   g_clear_pointer (&priv->word, g_free);
 
+  g_cancellable_cancel (priv->requery_cancellable);
+  g_clear_object (&priv->requery_cancellable);
+
   task = ide_task_new (self, cancellable, callback, user_data);
   ide_task_set_source_tag (task, ide_lsp_completion_provider_populate_async);
 
+  begin = g_new (gint64, 1);
+  *begin = ide_profiler_now ();
+  ide_task_set_task_data (task, begin, g_free);
+
+  ide_counter_inc (&completion_populate);
+
   if (priv->client == NULL)
     {
       ide_task_return_new_error (task,
@@ -313,8 +369,6 @@ ide_lsp_completion_provider_populate_async (GtkSourceCompletionProvider *provide
       IDE_EXIT;
     }
 
-  gtk_source_completion_context_get_bounds (context, &iter, &end);
-
   activation = gtk_source_completion_context_get_activation (context);
 
   if (activation == GTK_SOURCE_COMPLETION_ACTIVATION_INTERACTIVE)
@@ -324,24 +378,7 @@ ide_lsp_completion_provider_populate_async (GtkSourceCompletionProvider *provide
 
   priv->word = gtk_source_completion_context_get_word (context);
 
-  buffer = gtk_source_completion_context_get_buffer (context);
-  uri = ide_buffer_dup_uri (IDE_BUFFER (buffer));
-
-  line = gtk_text_iter_get_line (&iter);
-  column = gtk_text_iter_get_line_offset (&iter);
-
-  params = JSONRPC_MESSAGE_NEW (
-    "textDocument", "{",
-      "uri", JSONRPC_MESSAGE_PUT_STRING (uri),
-    "}",
-    "position", "{",
-      "line", JSONRPC_MESSAGE_PUT_INT32 (line),
-      "character", JSONRPC_MESSAGE_PUT_INT32 (column),
-    "}",
-    "context", "{",
-      "triggerKind", JSONRPC_MESSAGE_PUT_INT32 (trigger_kind),
-    "}"
-  );
+  params = ide_lsp_completion_provider_create_params (self, context, trigger_kind);
 
   ide_lsp_client_call_async (priv->client,
                              "textDocument/completion",
@@ -370,6 +407,94 @@ ide_lsp_completion_provider_populate_finish (GtkSourceCompletionProvider  *provi
   IDE_RETURN (ret);
 }
 
+static void
+ide_lsp_completion_provider_requery_cb (GObject      *object,
+                                        GAsyncResult *result,
+                                        gpointer      user_data)
+{
+  IdeLspClient *client = (IdeLspClient *)object;
+  IdeLspCompletionProviderPrivate *priv;
+  IdeLspCompletionProvider *self;
+  IdeLspCompletionResults *results;
+  g_autoptr(GVariant) return_value = NULL;
+  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(GError) error = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_LSP_CLIENT (client));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_TASK (task));
+
+  if (!ide_lsp_client_call_finish (client, result, &return_value, &error))
+    {
+      IDE_TRACE_MSG ("Completion requery failed: %s", error->message);
+      ide_task_return_error (task, g_steal_pointer (&error));
+      IDE_EXIT;
+    }
+
+  if (ide_task_return_error_if_cancelled (task))
+    IDE_EXIT;
+
+  self = ide_task_get_source_object (task);
+  priv = ide_lsp_completion_provider_get_instance_private (self);
+  results = ide_task_get_task_data (task);
+
+  g_assert (IDE_IS_LSP_COMPLETION_PROVIDER (self));
+  g_assert (IDE_IS_LSP_COMPLETION_RESULTS (results));
+
+  if (return_value != NULL)
+    _ide_lsp_completion_results_update (results, return_value, priv->refilter_word);
+
+  ide_task_return_boolean (task, TRUE);
+
+  IDE_EXIT;
+}
+
+/* The server told us the results were incomplete, so filtering locally
+ * is not enough. Ask again for the current word and swap the new items
+ * into the model when they arrive. Local filtering still happens in the
+ * mean time so the list stays responsive.
+ */
+static void
+ide_lsp_completion_provider_requery (IdeLspCompletionProvider   *self,
+                                     GtkSourceCompletionContext *context,
+                                     IdeLspCompletionResults    *results)
+{
+  IdeLspCompletionProviderPrivate *priv = ide_lsp_completion_provider_get_instance_private (self);
+  g_autoptr(IdeTask) task = NULL;
+  g_autoptr(GVariant) params = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_LSP_COMPLETION_PROVIDER (self));
+  g_assert (GTK_SOURCE_IS_COMPLETION_CONTEXT (context));
+  g_assert (IDE_IS_LSP_COMPLETION_RESULTS (results));
+
+  if (priv->client == NULL)
+    IDE_EXIT;
+
+  g_cancellable_cancel (priv->requery_cancellable);
+  g_clear_object (&priv->requery_cancellable);
+  priv->requery_cancellable = g_cancellable_new ();
+
+  task = ide_task_new (self, priv->requery_cancellable, NULL, NULL);
+  ide_task_set_source_tag (task, ide_lsp_completion_provider_requery);
+  ide_task_set_task_data (task, g_object_ref (results), g_object_unref);
+
+  /* TriggerForIncompleteCompletions */
+  params = ide_lsp_completion_provider_create_params (self, context, 3);
+
+  ide_lsp_client_call_async (priv->client,
+                             "textDocument/completion",
+                             params,
+                             priv->requery_cancellable,
+                             ide_lsp_completion_provider_requery_cb,
+                             g_steal_pointer (&task));
+
+  IDE_EXIT;
+}
+
 static void
 ide_lsp_completion_provider_refilter (GtkSourceCompletionProvider *provider,
                                       GtkSourceCompletionContext  *context,
@@ -378,15 +503,25 @@ ide_lsp_completion_provider_refilter (GtkSourceCompletionProvider *provider,
   IdeLspCompletionProvider *self = (IdeLspCompletionProvider *)provider;
   IdeLspCompletionProviderPrivate *priv = ide_lsp_completion_provider_get_instance_private (self);
   IdeLspCompletionResults *results = (IdeLspCompletionResults *)model;
+  gint64 begin;
 
   g_assert (IDE_IS_LSP_COMPLETION_PROVIDER (self));
   g_assert (GTK_SOURCE_IS_COMPLETION_CONTEXT (context));
   g_assert (IDE_IS_LSP_COMPLETION_RESULTS (results));
 
+  begin = ide_profiler_now ();
+
   g_clear_pointer (&priv->refilter_word, g_free);
   priv->refilter_word = gtk_source_completion_context_get_word (context);
 
   ide_lsp_completion_results_refilter (results, priv->refilter_word);
+
+  if (ide_lsp_completion_results_get_incomplete (results))
+    ide_lsp_completion_provider_requery (self, context, results);
+
+  ide_counter_inc (&completion_refilter);
+  ide_counter_add (&completion_refilter_usec, (ide_profiler_now () - begin) / 1000);
+  IDE_PROFILER_SPAN_END (begin, "Completion", "Refilter", "%s", priv->refilter_word ? priv->refilter_word : "");
 }
 
 static void
@@ -22,36 +22,84 @@
 
 #include "config.h"
 
+#include <stdlib.h>
+
+#include <jsonrpc-glib.h>
 #include <libide-sourceview.h>
 
-#include "ide-lsp-completion-item.h"
-#include "ide-lsp-completion-results.h"
+#include "ide-lsp-completion-item-private.h"
+#include "ide-lsp-completion-results-private.h"
+#include "ide-lsp-util.h"
 
+/* Results are decoded once into parallel arrays indexed by the position
+ * of the item within the server reply so that refiltering never has to
+ * touch the GVariant again. Strings are packed into a single buffer and
+ * referenced by offset. Filter keys are casefolded up front since the
+ * query is casefolded too.
+ */
 struct _IdeLspCompletionResults
 {
   GObject   parent_instance;
+
   GVariant *results;
   GArray   *items;
+
+  /* Packed casefolded filterText/label and sortText/label strings */
+  GString  *strings;
+  guint32  *filter_offsets;
+  guint32  *sort_ranks;
+  guint8   *kinds;
+  guint     n_results;
+
+  /* Casefolded query used to build @items, if any */
+  char     *query;
+
+  guint     incomplete : 1;
 };
 
 typedef struct
 {
   guint index;
+  guint rank;
   guint priority;
 } Item;
 
+/* Kinds are stored as bytes */
+G_STATIC_ASSERT (IDE_SYMBOL_KIND_LAST <= G_MAXUINT8);
+
+typedef struct
+{
+  const char *sort_text;
+  guint       index;
+} SortEntry;
+
 static void list_model_iface_init (GListModelInterface *iface);
 
 G_DEFINE_FINAL_TYPE_WITH_CODE (IdeLspCompletionResults, ide_lsp_completion_results, G_TYPE_OBJECT,
                                G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, list_model_iface_init))
 
+static void
+ide_lsp_completion_results_clear (IdeLspCompletionResults *self)
+{
+  g_clear_pointer (&self->results, g_variant_unref);
+  g_clear_pointer (&self->filter_offsets, g_free);
+  g_clear_pointer (&self->sort_ranks, g_free);
+  g_clear_pointer (&self->kinds, g_free);
+  g_clear_pointer (&self->query, g_free);
+  g_string_truncate (self->strings, 0);
+  self->n_results = 0;
+  self->incomplete = FALSE;
+}
+
 static void
 ide_lsp_completion_results_finalize (GObject *object)
 {
   IdeLspCompletionResults *self = (IdeLspCompletionResults *)object;
 
-  g_clear_pointer (&self->results, g_variant_unref);
+  ide_lsp_completion_results_clear (self);
+
   g_clear_pointer (&self->items, g_array_unref);
+  g_string_free (self->strings, TRUE);
 
   G_OBJECT_CLASS (ide_lsp_completion_results_parent_class)->finalize (object);
 }
@@ -68,36 +116,187 @@ static void
 ide_lsp_completion_results_init (IdeLspCompletionResults *self)
 {
   self->items = g_array_new (FALSE, FALSE, sizeof (Item));
+  self->strings = g_string_new (NULL);
 }
 
-IdeLspCompletionResults *
-ide_lsp_completion_results_new (GVariant *results)
+static guint32
+pack_string (GString    *strings,
+             const char *str)
+{
+  guint32 offset = strings->len;
+
+  g_string_append_len (strings, str, strlen (str) + 1);
+
+  return offset;
+}
+
+static int
+compare_sort_entry (gconstpointer a,
+                    gconstpointer b)
+{
+  const SortEntry *entry_a = a;
+  const SortEntry *entry_b = b;
+  int ret;
+
+  if ((ret = g_strcmp0 (entry_a->sort_text, entry_b->sort_text)))
+    return ret;
+
+  return (int)entry_a->index - (int)entry_b->index;
+}
+
+static void
+ide_lsp_completion_results_decode (IdeLspCompletionResults *self,
+                                   GVariant                *results)
 {
-  IdeLspCompletionResults *self;
   g_autoptr(GVariant) items = NULL;
+  g_autofree SortEntry *entries = NULL;
+  g_autofree guint32 *sort_offsets = NULL;
+  gboolean incomplete = FALSE;
 
-  g_return_val_if_fail (results != NULL, NULL);
+  g_assert (IDE_IS_LSP_COMPLETION_RESULTS (self));
+  g_assert (results != NULL);
+
+  ide_lsp_completion_results_clear (self);
 
-  self = g_object_new (IDE_TYPE_LSP_COMPLETION_RESULTS, NULL);
   self->results = g_variant_ref_sink (results);
 
-  /* Possibly unwrap the {items: []} style result. */
-  if (g_variant_is_of_type (results, G_VARIANT_TYPE_VARDICT) &&
-      (items = g_variant_lookup_value (results, "items", NULL)))
+  /* Possibly unwrap the {isIncomplete: bool, items: []} style result. */
+  if (g_variant_is_of_type (results, G_VARIANT_TYPE_VARDICT))
     {
+      g_variant_lookup (results, "isIncomplete", "b", &incomplete);
+
       g_clear_pointer (&self->results, g_variant_unref);
 
-      if (g_variant_is_of_type (items, G_VARIANT_TYPE_VARIANT))
-        self->results = g_variant_get_variant (items);
+      if ((items = g_variant_lookup_value (results, "items", NULL)))
+        {
+          if (g_variant_is_of_type (items, G_VARIANT_TYPE_VARIANT))
+            self->results = g_variant_get_variant (items);
+          else
+            self->results = g_steal_pointer (&items);
+        }
+    }
+
+  self->incomplete = !!incomplete;
+
+  if (self->results == NULL || !g_variant_is_container (self->results))
+    {
+      g_clear_pointer (&self->results, g_variant_unref);
+      return;
+    }
+
+  self->n_results = g_variant_n_children (self->results);
+  self->filter_offsets = g_new (guint32, self->n_results);
+  self->sort_ranks = g_new (guint32, self->n_results);
+  self->kinds = g_new0 (guint8, self->n_results);
+  sort_offsets = g_new (guint32, self->n_results);
+
+  for (guint i = 0; i < self->n_results; i++)
+    {
+      g_autoptr(GVariant) child = g_variant_get_child_value (self->results, i);
+      g_autoptr(GVariant) node = NULL;
+      g_autofree char *folded = NULL;
+      const char *label = NULL;
+      const char *filter_text = NULL;
+      const char *sort_text = NULL;
+      gint64 kind = 0;
+
+      if (g_variant_is_of_type (child, G_VARIANT_TYPE_VARIANT))
+        node = g_variant_get_variant (child);
       else
-        self->results = g_steal_pointer (&items);
+        node = g_steal_pointer (&child);
+
+      if (g_variant_is_of_type (node, G_VARIANT_TYPE_VARDICT))
+        {
+          g_variant_lookup (node, "label", "&s", &label);
+          g_variant_lookup (node, "filterText", "&s", &filter_text);
+          g_variant_lookup (node, "sortText", "&s", &sort_text);
+
+          if (JSONRPC_MESSAGE_PARSE (node, "kind", JSONRPC_MESSAGE_GET_INT64 (&kind)))
+            self->kinds[i] = ide_lsp_decode_completion_kind (kind);
+        }
+
+      if (label == NULL)
+        label = "";
+
+      folded = g_utf8_casefold (filter_text ? filter_text : label, -1);
+
+      self->filter_offsets[i] = pack_string (self->strings, folded);
+      sort_offsets[i] = pack_string (self->strings, sort_text ? sort_text : label);
+    }
+
+  /* Offsets are only stable once the buffer stops growing, so resolve
+   * sort keys into ranks now and never compare strings while filtering.
+   */
+  entries = g_new (SortEntry, self->n_results);
+  for (guint i = 0; i < self->n_results; i++)
+    {
+      entries[i].sort_text = self->strings->str + sort_offsets[i];
+      entries[i].index = i;
     }
 
+  qsort (entries, self->n_results, sizeof (SortEntry), compare_sort_entry);
+
+  for (guint i = 0; i < self->n_results; i++)
+    self->sort_ranks[entries[i].index] = i;
+}
+
+IdeLspCompletionResults *
+ide_lsp_completion_results_new (GVariant *results)
+{
+  IdeLspCompletionResults *self;
+
+  g_return_val_if_fail (results != NULL, NULL);
+
+  self = g_object_new (IDE_TYPE_LSP_COMPLETION_RESULTS, NULL);
+  ide_lsp_completion_results_decode (self, results);
   ide_lsp_completion_results_refilter (self, NULL);
 
   return self;
 }
 
+/**
+ * _ide_lsp_completion_results_update:
+ * @self: a #IdeLspCompletionResults
+ * @results: the reply to a new "textDocument/completion" request
+ * @typed_text: (nullable): the text to filter the new results with
+ *
+ * Replaces the results with a new reply from the language server. This is
+ * used when a previous reply was marked as incomplete and the server had
+ * to be queried again.
+ */
+void
+_ide_lsp_completion_results_update (IdeLspCompletionResults *self,
+                                    GVariant                *results,
+                                    const char              *typed_text)
+{
+  g_return_if_fail (IDE_IS_LSP_COMPLETION_RESULTS (self));
+  g_return_if_fail (results != NULL);
+
+  /* Clears the previous query so refiltering rescans everything */
+  ide_lsp_completion_results_decode (self, results);
+  ide_lsp_completion_results_refilter (self, typed_text);
+}
+
+/**
+ * ide_lsp_completion_results_get_incomplete:
+ * @self: a #IdeLspCompletionResults
+ *
+ * Gets if the language server marked the results as incomplete, meaning
+ * further typing should query the server again rather than only filtering
+ * the existing results.
+ *
+ * Returns: %TRUE if the results are incomplete
+ *
+ * Since: 50
+ */
+gboolean
+ide_lsp_completion_results_get_incomplete (IdeLspCompletionResults *self)
+{
+  g_return_val_if_fail (IDE_IS_LSP_COMPLETION_RESULTS (self), FALSE);
+
+  return self->incomplete;
+}
+
 static GType
 ide_lsp_completion_results_get_item_type (GListModel *model)
 {
@@ -123,12 +322,16 @@ ide_lsp_completion_results_get_item (GListModel *model,
   const Item *item;
 
   g_assert (IDE_IS_LSP_COMPLETION_RESULTS (self));
+
+  if (position >= self->items->len)
+    return NULL;
+
   g_assert (self->results != NULL);
 
   item = &g_array_index (self->items, Item, position);
   child = g_variant_get_child_value (self->results, item->index);
 
-  return ide_lsp_completion_item_new (child);
+  return _ide_lsp_completion_item_new_with_kind (child, self->kinds[item->index]);
 }
 
 static void
@@ -143,64 +346,81 @@ static gint
 compare_items (const Item *a,
                const Item *b)
 {
-  return (gint)a->priority - (gint)b->priority;
+  if (a->priority < b->priority)
+    return -1;
+  else if (a->priority > b->priority)
+    return 1;
+
+  return (gint)a->rank - (gint)b->rank;
 }
 
-void
-ide_lsp_completion_results_refilter (IdeLspCompletionResults *self,
-                                     const char              *typed_text)
+static void
+ide_lsp_completion_results_narrow (IdeLspCompletionResults *self,
+                                   const char              *query)
 {
-  g_autofree gchar *query = NULL;
-  GVariantIter iter;
-  GVariant *node;
-  guint index = 0;
-  guint old_len;
+  guint pos = 0;
 
-  g_return_if_fail (IDE_IS_LSP_COMPLETION_RESULTS (self));
+  g_assert (IDE_IS_LSP_COMPLETION_RESULTS (self));
+  g_assert (query != NULL);
 
-  if ((old_len = self->items->len))
-    g_array_remove_range (self->items, 0, old_len);
+  /* Anything matching a longer query also matched the shorter one, so
+   * only the previous matches need to be checked again.
+   */
+  for (guint i = 0; i < self->items->len; i++)
+    {
+      Item item = g_array_index (self->items, Item, i);
+      const char *key = self->strings->str + self->filter_offsets[item.index];
 
-  if (self->results == NULL)
-    return;
+      if (gtk_source_completion_fuzzy_match (key, query, &item.priority))
+        g_array_index (self->items, Item, pos++) = item;
+    }
 
-  if (typed_text == NULL || *typed_text == 0)
-    {
-      guint n_items = g_variant_n_children (self->results);
+  g_array_set_size (self->items, pos);
+}
 
-      for (guint i = 0; i < n_items; i++)
-        {
-          Item item = { .index = i };
-          g_array_append_val (self->items, item);
-        }
+static void
+ide_lsp_completion_results_scan (IdeLspCompletionResults *self,
+                                 const char              *query)
+{
+  g_assert (IDE_IS_LSP_COMPLETION_RESULTS (self));
 
-      g_list_model_items_changed (G_LIST_MODEL (self), 0, old_len, n_items);
+  g_array_set_size (self->items, 0);
 
-      return;
-    }
+  for (guint i = 0; i < self->n_results; i++)
+    {
+      const char *key = self->strings->str + self->filter_offsets[i];
+      Item item = { .index = i, .rank = self->sort_ranks[i] };
 
-  query = g_utf8_casefold (typed_text, -1);
+      if (query == NULL || gtk_source_completion_fuzzy_match (key, query, &item.priority))
+        g_array_append_val (self->items, item);
+    }
+}
 
-  g_variant_iter_init (&iter, self->results);
+void
+ide_lsp_completion_results_refilter (IdeLspCompletionResults *self,
+                                     const char              *typed_text)
+{
+  g_autofree gchar *query = NULL;
+  guint old_len;
 
-  while (g_variant_iter_loop (&iter, "v", &node))
-    {
-      const gchar *label;
-      guint priority;
+  g_return_if_fail (IDE_IS_LSP_COMPLETION_RESULTS (self));
 
-      if (!g_variant_lookup (node, "label", "&s", &label))
-        continue;
+  old_len = self->items->len;
 
-      if (gtk_source_completion_fuzzy_match (label, query, &priority))
-        {
-          Item item = { .index = index, .priority = priority };
-          g_array_append_val (self->items, item);
-        }
+  if (!ide_str_empty0 (typed_text))
+    query = g_utf8_casefold (typed_text, -1);
 
-      index++;
-    }
+  if (self->query != NULL &&
+      query != NULL &&
+      g_str_has_prefix (query, self->query))
+    ide_lsp_completion_results_narrow (self, query);
+  else
+    ide_lsp_completion_results_scan (self, query);
 
   g_array_sort (self->items, (GCompareFunc)compare_items);
 
-  g_list_model_items_changed (G_LIST_MODEL (self), 0, old_len, index);
+  g_free (self->query);
+  self->query = g_steal_pointer (&query);
+
+  g_list_model_items_changed (G_LIST_MODEL (self), 0, old_len, self->items->len);
 }
@@ -0,0 +1,55 @@
+/* ide-lsp-pool-private.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <libide-threading.h>
+
+#include "ide-lsp-client.h"
+#include "ide-lsp-service.h"
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_LSP_POOL (ide_lsp_pool_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeLspPool, ide_lsp_pool, IDE, LSP_POOL, GObject)
+
+IdeLspPool              *ide_lsp_pool_get_default    (void);
+char                    *ide_lsp_pool_make_key       (GType                     service_type,
+                                                      IdeSubprocessLauncher    *launcher);
+void                     ide_lsp_pool_add            (IdeLspPool               *self,
+                                                      const char               *key,
+                                                      IdeLspService            *service,
+                                                      IdeSubprocessSupervisor  *supervisor,
+                                                      IdeLspClient             *client);
+IdeLspClient            *ide_lsp_pool_acquire        (IdeLspPool               *self,
+                                                      const char               *key,
+                                                      IdeLspService            *service,
+                                                      IdeSubprocessSupervisor **supervisor);
+gboolean                 ide_lsp_pool_release        (IdeLspPool               *self,
+                                                      IdeLspService            *service);
+void                     ide_lsp_pool_remove         (IdeLspPool               *self,
+                                                      IdeLspService            *service);
+IdeSubprocessSupervisor *ide_lsp_pool_get_supervisor (IdeLspPool               *self,
+                                                      IdeLspService            *service,
+                                                      guint                    *n_projects);
+guint64                  ide_lsp_pool_read_rss       (const char               *identifier);
+
+G_END_DECLS
@@ -0,0 +1,539 @@
+/* ide-lsp-pool.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "ide-lsp-pool"
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ide-lsp-client-private.h"
+#include "ide-lsp-pool-private.h"
+#include "ide-lsp-service-private.h"
+
+/*
+ * The pool allows language servers to be shared between projects. Each
+ * pooled server is owned by one service (the "home") which is the parent
+ * of the client object. Services of other projects with a compatible
+ * launcher become guests and add their working directory as a workspace
+ * folder of the running server.
+ *
+ * When the home goes away the server is handed to a guest. If there are
+ * no guests left, the server is parked without a context until it is
+ * either adopted by a new project or the idle timeout expires.
+ */
+
+typedef struct
+{
+  char                    *key;
+  IdeSubprocessSupervisor *supervisor;
+  IdeLspClient            *client;
+  IdeLspService           *home;
+  GPtrArray               *guests;
+  guint                    idle_source;
+} Entry;
+
+struct _IdeLspPool
+{
+  GObject    parent_instance;
+  GPtrArray *entries;
+  GSettings *settings;
+};
+
+G_DEFINE_FINAL_TYPE (IdeLspPool, ide_lsp_pool, G_TYPE_OBJECT)
+
+static void
+entry_free (Entry *entry)
+{
+  g_clear_handle_id (&entry->idle_source, g_source_remove);
+  g_clear_pointer (&entry->key, g_free);
+  g_clear_pointer (&entry->guests, g_ptr_array_unref);
+  g_clear_object (&entry->supervisor);
+  g_clear_object (&entry->client);
+  g_slice_free (Entry, entry);
+}
+
+static void
+ide_lsp_pool_finalize (GObject *object)
+{
+  IdeLspPool *self = (IdeLspPool *)object;
+
+  g_clear_pointer (&self->entries, g_ptr_array_unref);
+  g_clear_object (&self->settings);
+
+  G_OBJECT_CLASS (ide_lsp_pool_parent_class)->finalize (object);
+}
+
+static void
+ide_lsp_pool_class_init (IdeLspPoolClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_lsp_pool_finalize;
+}
+
+static void
+ide_lsp_pool_init (IdeLspPool *self)
+{
+  self->entries = g_ptr_array_new_with_free_func ((GDestroyNotify)entry_free);
+  self->settings = g_settings_new ("org.gnome.builder");
+}
+
+/**
+ * ide_lsp_pool_get_default:
+ *
+ * Returns: (transfer none): the process-wide #IdeLspPool
+ */
+IdeLspPool *
+ide_lsp_pool_get_default (void)
+{
+  static IdeLspPool *instance;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+
+  if (instance == NULL)
+    instance = g_object_new (IDE_TYPE_LSP_POOL, NULL);
+
+  return instance;
+}
+
+static int
+compare_strptr (gconstpointer a,
+                gconstpointer b)
+{
+  return g_strcmp0 (*(const char * const *)a, *(const char * const *)b);
+}
+
+/**
+ * ide_lsp_pool_make_key:
+ * @service_type: the #GType of the #IdeLspService
+ * @launcher: the launcher that would spawn the server
+ *
+ * Creates a key identifying servers which may be shared. Servers are only
+ * compatible if they would be spawned with the same arguments and
+ * environment, which also takes the runtime into account.
+ *
+ * Returns: (transfer full): a newly allocated key
+ */
+char *
+ide_lsp_pool_make_key (GType                  service_type,
+                       IdeSubprocessLauncher *launcher)
+{
+  g_autofree const char **sorted = NULL;
+  const char * const *argv;
+  const char * const *env;
+  GString *str;
+
+  g_return_val_if_fail (g_type_is_a (service_type, IDE_TYPE_LSP_SERVICE), NULL);
+  g_return_val_if_fail (IDE_IS_SUBPROCESS_LAUNCHER (launcher), NULL);
+
+  str = g_string_new (g_type_name (service_type));
+
+  if ((argv = ide_subprocess_launcher_get_argv (launcher)))
+    {
+      for (guint i = 0; argv[i]; i++)
+        {
+          g_string_append_c (str, '\n');
+          g_string_append (str, argv[i]);
+        }
+    }
+
+  g_string_append_c (str, '\n');
+
+  /* Order of the environment does not matter */
+  if ((env = ide_subprocess_launcher_get_environ (launcher)))
+    {
+      guint len = g_strv_length ((char **)env);
+
+      sorted = g_memdup2 (env, sizeof (char *) * (len + 1));
+      qsort (sorted, len, sizeof (char *), compare_strptr);
+
+      for (guint i = 0; sorted[i]; i++)
+        {
+          g_string_append_c (str, '\n');
+          g_string_append (str, sorted[i]);
+        }
+    }
+
+  return g_string_free (str, FALSE);
+}
+
+static Entry *
+ide_lsp_pool_find (IdeLspPool     *self,
+                   IdeLspService  *service,
+                   guint          *guest_index)
+{
+  g_assert (IDE_IS_LSP_POOL (self));
+  g_assert (IDE_IS_LSP_SERVICE (service));
+
+  for (guint i = 0; i < self->entries->len; i++)
+    {
+      Entry *entry = g_ptr_array_index (self->entries, i);
+
+      if (entry->home == service)
+        {
+          if (guest_index != NULL)
+            *guest_index = G_MAXUINT;
+          return entry;
+        }
+
+      for (guint j = 0; j < entry->guests->len; j++)
+        {
+          if (g_ptr_array_index (entry->guests, j) == service)
+            {
+              if (guest_index != NULL)
+                *guest_index = j;
+              return entry;
+            }
+        }
+    }
+
+  return NULL;
+}
+
+static void
+ide_lsp_pool_evict (IdeLspPool *self,
+                    Entry      *entry)
+{
+  g_assert (IDE_IS_LSP_POOL (self));
+  g_assert (entry != NULL);
+  g_assert (entry->home == NULL);
+  g_assert (entry->guests->len == 0);
+
+  g_debug ("Evicting idle language server %s",
+           G_OBJECT_TYPE_NAME (entry->client));
+
+  ide_lsp_client_stop (entry->client);
+  ide_object_destroy (IDE_OBJECT (entry->client));
+  ide_subprocess_supervisor_stop (entry->supervisor);
+
+  g_ptr_array_remove_fast (self->entries, entry);
+}
+
+static gboolean
+ide_lsp_pool_idle_timeout (gpointer data)
+{
+  Entry *entry = data;
+  IdeLspPool *self = ide_lsp_pool_get_default ();
+
+  g_assert (entry != NULL);
+
+  entry->idle_source = 0;
+  ide_lsp_pool_evict (self, entry);
+
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * ide_lsp_pool_add:
+ * @self: a #IdeLspPool
+ * @key: the key from ide_lsp_pool_make_key()
+ * @service: the #IdeLspService which spawned the server
+ * @supervisor: the supervisor of the server process
+ * @client: the #IdeLspClient connected to the server
+ *
+ * Registers a newly spawned server so that it may be shared with other
+ * projects once it has been initialized. @service remains the owner.
+ */
+void
+ide_lsp_pool_add (IdeLspPool              *self,
+                  const char              *key,
+                  IdeLspService           *service,
+                  IdeSubprocessSupervisor *supervisor,
+                  IdeLspClient            *client)
+{
+  Entry *entry;
+
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+  g_return_if_fail (IDE_IS_LSP_POOL (self));
+  g_return_if_fail (key != NULL);
+  g_return_if_fail (IDE_IS_LSP_SERVICE (service));
+  g_return_if_fail (IDE_IS_SUBPROCESS_SUPERVISOR (supervisor));
+  g_return_if_fail (IDE_IS_LSP_CLIENT (client));
+  g_return_if_fail (ide_lsp_pool_find (self, service, NULL) == NULL);
+
+  entry = g_slice_new0 (Entry);
+  entry->key = g_strdup (key);
+  entry->supervisor = g_object_ref (supervisor);
+  entry->client = g_object_ref (client);
+  entry->home = service;
+  entry->guests = g_ptr_array_new ();
+
+  g_ptr_array_add (self->entries, entry);
+}
+
+/**
+ * ide_lsp_pool_acquire:
+ * @self: a #IdeLspPool
+ * @key: the key from ide_lsp_pool_make_key()
+ * @service: the #IdeLspService requesting a server
+ * @supervisor: (out) (transfer full) (nullable): location for the supervisor
+ *   if @service became the owner of a parked server
+ *
+ * Looks for a running server compatible with @key and adds the working
+ * directory of @service's context as a workspace folder.
+ *
+ * If the server was parked, @service becomes its owner and @supervisor is
+ * set. Otherwise @service is a guest and must not stop the client.
+ *
+ * Returns: (transfer full) (nullable): an #IdeLspClient or %NULL
+ */
+IdeLspClient *
+ide_lsp_pool_acquire (IdeLspPool               *self,
+                      const char               *key,
+                      IdeLspService            *service,
+                      IdeSubprocessSupervisor **supervisor)
+{
+  IdeContext *context;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_MAIN_THREAD (), NULL);
+  g_return_val_if_fail (IDE_IS_LSP_POOL (self), NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+  g_return_val_if_fail (IDE_IS_LSP_SERVICE (service), NULL);
+  g_return_val_if_fail (supervisor != NULL, NULL);
+
+  *supervisor = NULL;
+
+  if (!(context = ide_object_get_context (IDE_OBJECT (service))))
+    IDE_RETURN (NULL);
+
+  for (guint i = 0; i < self->entries->len; i++)
+    {
+      Entry *entry = g_ptr_array_index (self->entries, i);
+
+      if (!ide_str_equal0 (entry->key, key) ||
+          !_ide_lsp_client_supports_workspace_folders (entry->client))
+        continue;
+
+      if (entry->home == NULL)
+        {
+          g_debug ("Adopting parked language server %s",
+                   G_OBJECT_TYPE_NAME (service));
+
+          g_clear_handle_id (&entry->idle_source, g_source_remove);
+
+          entry->home = service;
+          ide_object_append (IDE_OBJECT (service), IDE_OBJECT (entry->client));
+          *supervisor = g_object_ref (entry->supervisor);
+        }
+      else
+        {
+          if (ide_object_get_context (IDE_OBJECT (entry->home)) == context)
+            continue;
+
+          g_debug ("Sharing language server %s with another project",
+                   G_OBJECT_TYPE_NAME (service));
+
+          g_ptr_array_add (entry->guests, service);
+        }
+
+      _ide_lsp_client_add_workspace_folder (entry->client, context);
+
+      IDE_RETURN (g_object_ref (entry->client));
+    }
+
+  IDE_RETURN (NULL);
+}
+
+/**
+ * ide_lsp_pool_release:
+ * @self: a #IdeLspPool
+ * @service: an #IdeLspService
+ *
+ * Releases the server used by @service, removing its workspace folder.
+ *
+ * If @service owned the server it is handed to a guest or parked until
+ * the idle timeout expires. In that case %TRUE is returned and @service
+ * must drop its references without stopping the server.
+ *
+ * Returns: %TRUE if ownership of the server was transferred
+ */
+gboolean
+ide_lsp_pool_release (IdeLspPool    *self,
+                      IdeLspService *service)
+{
+  IdeLspService *new_home;
+  IdeContext *context;
+  Entry *entry;
+  guint guest_index;
+  guint timeout;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_MAIN_THREAD (), FALSE);
+  g_return_val_if_fail (IDE_IS_LSP_POOL (self), FALSE);
+  g_return_val_if_fail (IDE_IS_LSP_SERVICE (service), FALSE);
+
+  if (!(entry = ide_lsp_pool_find (self, service, &guest_index)))
+    IDE_RETURN (FALSE);
+
+  context = ide_object_get_context (IDE_OBJECT (service));
+
+  if (guest_index != G_MAXUINT)
+    {
+      g_ptr_array_remove_index (entry->guests, guest_index);
+
+      if (context != NULL)
+        _ide_lsp_client_remove_workspace_folder (entry->client, context);
+
+      IDE_RETURN (FALSE);
+    }
+
+  if (context != NULL)
+    _ide_lsp_client_remove_workspace_folder (entry->client, context);
+
+  /* Nothing from the old owner may be called again */
+  g_signal_handlers_disconnect_by_data (entry->supervisor, service);
+  g_signal_handlers_disconnect_by_data (entry->client, service);
+  ide_object_remove (IDE_OBJECT (service), IDE_OBJECT (entry->client));
+  entry->home = NULL;
+
+  if (entry->guests->len > 0)
+    {
+      new_home = g_ptr_array_steal_index (entry->guests, 0);
+
+      g_debug ("Handing language server %s to another project",
+               G_OBJECT_TYPE_NAME (new_home));
+
+      entry->home = new_home;
+      ide_object_append (IDE_OBJECT (new_home), IDE_OBJECT (entry->client));
+      _ide_lsp_service_take_over (new_home, entry->supervisor);
+
+      IDE_RETURN (TRUE);
+    }
+
+  timeout = g_settings_get_int (self->settings, "lsp-idle-timeout");
+
+  if (timeout == 0)
+    {
+      ide_lsp_pool_evict (self, entry);
+      IDE_RETURN (TRUE);
+    }
+
+  g_debug ("Parking language server %s for %u seconds",
+           G_OBJECT_TYPE_NAME (entry->client), timeout);
+
+  entry->idle_source = g_timeout_add_seconds (timeout, ide_lsp_pool_idle_timeout, entry);
+
+  IDE_RETURN (TRUE);
+}
+
+/**
+ * ide_lsp_pool_remove:
+ * @self: a #IdeLspPool
+ * @service: an #IdeLspService
+ *
+ * Stops sharing the server owned by @service, such as when it is about to
+ * be restarted. @service keeps ownership of the server while guests are
+ * restarted so they spawn or find another server.
+ */
+void
+ide_lsp_pool_remove (IdeLspPool    *self,
+                     IdeLspService *service)
+{
+  g_autoptr(GPtrArray) guests = NULL;
+  Entry *entry;
+  guint guest_index;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+  g_return_if_fail (IDE_IS_LSP_POOL (self));
+  g_return_if_fail (IDE_IS_LSP_SERVICE (service));
+
+  if (!(entry = ide_lsp_pool_find (self, service, &guest_index)) ||
+      guest_index != G_MAXUINT)
+    IDE_EXIT;
+
+  guests = g_steal_pointer (&entry->guests);
+  g_ptr_array_remove_fast (self->entries, entry);
+
+  /* The guests will not find the entry and just drop the client */
+  for (guint i = 0; i < guests->len; i++)
+    ide_lsp_service_restart (g_ptr_array_index (guests, i));
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_lsp_pool_get_supervisor:
+ * @self: a #IdeLspPool
+ * @service: an #IdeLspService
+ * @n_projects: (out) (optional): the number of projects using the server
+ *
+ * Gets the supervisor of the server used by @service, which may be owned
+ * by another project.
+ *
+ * Returns: (transfer none) (nullable): an #IdeSubprocessSupervisor or %NULL
+ */
+IdeSubprocessSupervisor *
+ide_lsp_pool_get_supervisor (IdeLspPool    *self,
+                             IdeLspService *service,
+                             guint         *n_projects)
+{
+  Entry *entry;
+
+  g_return_val_if_fail (IDE_IS_LSP_POOL (self), NULL);
+  g_return_val_if_fail (IDE_IS_LSP_SERVICE (service), NULL);
+
+  if (n_projects != NULL)
+    *n_projects = 0;
+
+  if (!(entry = ide_lsp_pool_find (self, service, NULL)))
+    return NULL;
+
+  if (n_projects != NULL)
+    *n_projects = entry->guests->len + (entry->home != NULL);
+
+  return entry->supervisor;
+}
+
+/**
+ * ide_lsp_pool_read_rss:
+ * @identifier: the identifier of an #IdeSubprocess
+ *
+ * Reads the resident set size of a process from /proc. This only works
+ * for processes within our PID namespace.
+ *
+ * Returns: the resident set size in kilobytes, or 0 if unknown
+ */
+guint64
+ide_lsp_pool_read_rss (const char *identifier)
+{
+  g_autofree char *path = NULL;
+  g_autofree char *contents = NULL;
+  const char *line;
+
+  if (identifier == NULL || !g_ascii_isdigit (*identifier))
+    return 0;
+
+  path = g_strdup_printf ("/proc/%s/status", identifier);
+
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    return 0;
+
+  if (!(line = strstr (contents, "\nVmRSS:")))
+    return 0;
+
+  return g_ascii_strtoull (line + strlen ("\nVmRSS:"), NULL, 10);
+}
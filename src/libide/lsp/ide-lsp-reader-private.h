@@ -0,0 +1,72 @@
+/* ide-lsp-reader-private.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_LSP_READER (ide_lsp_reader_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeLspReader, ide_lsp_reader, IDE, LSP_READER, GObject)
+
+/* The placeholder notification written in place of a prepared one */
+#define IDE_LSP_READER_PREPARED_METHOD "$/ide/prepared"
+
+/**
+ * IdeLspReaderPrepare:
+ * @owner: the owner of the reader
+ * @method: the method of the notification
+ * @params: (nullable): the params of the notification
+ *
+ * Called from the reader thread for notifications whose method was listed
+ * when creating the reader. Return a non-%NULL pointer to take over the
+ * notification. An %IDE_LSP_READER_PREPARED_METHOD notification is then
+ * delivered by the JSON-RPC client in its place, which the owner exchanges
+ * for the pointer with ide_lsp_reader_steal_prepared().
+ */
+typedef gpointer (*IdeLspReaderPrepare) (GObject    *owner,
+                                         const char *method,
+                                         GVariant   *params);
+
+typedef struct
+{
+  guint64 n_messages;
+  guint64 n_bytes;
+  guint64 n_prepared;
+  guint64 decode_usec;
+  guint   max_pending;
+} IdeLspReaderStats;
+
+IdeLspReader *ide_lsp_reader_new              (GInputStream          *base_stream,
+                                               GObject               *owner,
+                                               const char * const    *prepare_methods,
+                                               IdeLspReaderPrepare    prepare,
+                                               GDestroyNotify         prepared_destroy,
+                                               GError               **error);
+GInputStream *ide_lsp_reader_get_input_stream (IdeLspReader          *self);
+gpointer      ide_lsp_reader_steal_prepared   (IdeLspReader          *self,
+                                               GVariant              *params);
+void          ide_lsp_reader_close            (IdeLspReader          *self);
+void          ide_lsp_reader_get_stats        (IdeLspReader          *self,
+                                               IdeLspReaderStats     *stats);
+
+G_END_DECLS
@@ -0,0 +1,663 @@
+/* ide-lsp-reader.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "ide-lsp-reader"
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <glib-unix.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+#include <json-glib/json-glib.h>
+
+#include <libide-core.h>
+
+#include "ide-lsp-reader-private.h"
+
+/* IdeLspReader moves parsing of language server traffic off the main
+ * thread. A dedicated thread reads JSON-RPC frames from the server and
+ * peeks at the top-level "method" and "id" members without building a
+ * tree. Only notifications the owner asked for are fully decoded and
+ * handed to the owner to be prepared in the thread. Everything else is
+ * forwarded unchanged, as JSON, to a pipe which the JsonrpcClient reads
+ * from, so it is parsed exactly once.
+ *
+ * Prepared notifications are kept by the reader and a small placeholder
+ * notification (IDE_LSP_READER_PREPARED_METHOD) is written to the pipe in
+ * their place. The owner exchanges the placeholder for the prepared data
+ * with ide_lsp_reader_steal_prepared() when the JsonrpcClient delivers
+ * it, which keeps every message in the order the server sent it.
+ *
+ * Messages must not be re-encoded as GVariant frames for the
+ * JsonrpcClient. Once jsonrpc-glib sees a GVariant frame it answers in
+ * the same encoding, which JSON-only language servers cannot read.
+ *
+ * The pipe bounds how far the reader may get ahead of the JsonrpcClient
+ * and MAX_PENDING_PREPARED bounds the number of prepared messages waiting
+ * for the main loop, so a chatty server cannot flood the UI thread.
+ */
+
+#define MAX_PENDING_PREPARED 32
+#define MAX_MESSAGE_SIZE     (256 * 1024 * 1024)
+
+IDE_DEFINE_COUNTER (lsp_decode_usec, "LSP", "Decode (usec)", "Time decoding server messages off the main thread");
+
+struct _IdeLspReader
+{
+  GObject               parent_instance;
+
+  GInputStream         *base_stream;
+  GInputStream         *pipe_in;
+  GOutputStream        *pipe_out;
+  GCancellable         *cancellable;
+  GThread              *thread;
+
+  /* Unowned, valid until ide_lsp_reader_close() */
+  GObject              *owner;
+  char                **prepare_methods;
+  IdeLspReaderPrepare   prepare;
+  GDestroyNotify        prepared_destroy;
+
+  GMutex                mutex;
+  GCond                 cond;
+  /* serial -> prepared data, waiting for their placeholder */
+  GHashTable           *prepared;
+  guint                 last_serial;
+  IdeLspReaderStats     stats;
+  guint                 closed : 1;
+};
+
+G_DEFINE_FINAL_TYPE (IdeLspReader, ide_lsp_reader, G_TYPE_OBJECT)
+
+static void
+ide_lsp_reader_finalize (GObject *object)
+{
+  IdeLspReader *self = (IdeLspReader *)object;
+
+  g_assert (self->thread == NULL);
+
+  g_clear_object (&self->base_stream);
+  g_clear_object (&self->pipe_in);
+  g_clear_object (&self->pipe_out);
+  g_clear_object (&self->cancellable);
+  g_clear_pointer (&self->prepare_methods, g_strfreev);
+  g_clear_pointer (&self->prepared, g_hash_table_unref);
+
+  g_mutex_clear (&self->mutex);
+  g_cond_clear (&self->cond);
+
+  G_OBJECT_CLASS (ide_lsp_reader_parent_class)->finalize (object);
+}
+
+static void
+ide_lsp_reader_class_init (IdeLspReaderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_lsp_reader_finalize;
+}
+
+static void
+ide_lsp_reader_init (IdeLspReader *self)
+{
+  g_mutex_init (&self->mutex);
+  g_cond_init (&self->cond);
+  self->cancellable = g_cancellable_new ();
+}
+
+static GBytes *
+read_frame (GDataInputStream  *input,
+            GCancellable      *cancellable,
+            GError           **error)
+{
+  g_autofree guint8 *data = NULL;
+  gsize content_length = 0;
+  gsize n_read = 0;
+
+  for (;;)
+    {
+      g_autofree char *line = NULL;
+      gsize len = 0;
+
+      if (!(line = g_data_input_stream_read_line (input, &len, cancellable, error)))
+        {
+          if (error != NULL && *error == NULL)
+            g_set_error_literal (error,
+                                 G_IO_ERROR,
+                                 G_IO_ERROR_CLOSED,
+                                 "The language server closed the stream");
+          return NULL;
+        }
+
+      if (len > 0 && line[len - 1] == '\r')
+        line[--len] = 0;
+
+      if (len == 0)
+        break;
+
+      if (g_ascii_strncasecmp (line, "Content-Length:", 15) == 0)
+        content_length = g_ascii_strtoull (line + 15, NULL, 10);
+    }
+
+  if (content_length == 0 || content_length > MAX_MESSAGE_SIZE)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "Invalid Content-Length %"G_GSIZE_FORMAT" from language server",
+                   content_length);
+      return NULL;
+    }
+
+  data = g_malloc (content_length + 1);
+
+  if (!g_input_stream_read_all (G_INPUT_STREAM (input), data, content_length, &n_read, cancellable, error))
+    return NULL;
+
+  if (n_read != content_length)
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_CLOSED,
+                           "The language server closed the stream");
+      return NULL;
+    }
+
+  data[content_length] = 0;
+
+  return g_bytes_new_take (g_steal_pointer (&data), content_length);
+}
+
+static inline const char *
+skip_space (const char *p,
+            const char *end)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+    p++;
+  return p;
+}
+
+/* Returns a pointer to the closing quote of the string starting at @p */
+static const char *
+skip_string (const char *p,
+             const char *end)
+{
+  g_assert (p < end && *p == '"');
+
+  for (p++; p < end; p++)
+    {
+      if (*p == '\\')
+        p++;
+      else if (*p == '"')
+        return p;
+    }
+
+  return NULL;
+}
+
+/* Returns a pointer just past the value starting at @p */
+static const char *
+skip_value (const char *p,
+            const char *end)
+{
+  guint depth = 0;
+
+  for (; p < end; p++)
+    {
+      switch (*p)
+        {
+        case '"':
+          if (!(p = skip_string (p, end)))
+            return NULL;
+          if (depth == 0)
+            return p + 1;
+          break;
+
+        case '{':
+        case '[':
+          depth++;
+          break;
+
+        case '}':
+        case ']':
+          if (depth == 0)
+            return p;
+          if (--depth == 0)
+            return p + 1;
+          break;
+
+        case ',':
+          if (depth == 0)
+            return p;
+          break;
+
+        default:
+          break;
+        }
+    }
+
+  return depth == 0 ? p : NULL;
+}
+
+/*
+ * Scans the top-level members of a JSON-RPC message without decoding it.
+ * @method is set to the raw contents of the "method" string, which is
+ * enough to compare against the plain ASCII method names we care about.
+ */
+static gboolean
+sniff_message (GBytes      *body,
+               const char **method,
+               gsize       *method_len,
+               gboolean    *has_id)
+{
+  gsize len;
+  const char *p = g_bytes_get_data (body, &len);
+  const char *end = p + len;
+
+  *method = NULL;
+  *method_len = 0;
+  *has_id = FALSE;
+
+  p = skip_space (p, end);
+  if (p >= end || *p != '{')
+    return FALSE;
+
+  for (p++;;)
+    {
+      const char *key;
+      gsize key_len;
+
+      p = skip_space (p, end);
+      if (p >= end)
+        return FALSE;
+
+      if (*p == '}')
+        return TRUE;
+
+      if (*p != '"')
+        return FALSE;
+
+      key = p + 1;
+      if (!(p = skip_string (p, end)))
+        return FALSE;
+      key_len = p - key;
+
+      p = skip_space (p + 1, end);
+      if (p >= end || *p != ':')
+        return FALSE;
+      p = skip_space (p + 1, end);
+      if (p >= end)
+        return FALSE;
+
+      if (key_len == 2 && memcmp (key, "id", 2) == 0)
+        {
+          *has_id = TRUE;
+        }
+      else if (key_len == 6 && memcmp (key, "method", 6) == 0 && *p == '"')
+        {
+          const char *close = skip_string (p, end);
+
+          if (close == NULL)
+            return FALSE;
+
+          *method = p + 1;
+          *method_len = close - *method;
+        }
+
+      if (!(p = skip_value (p, end)))
+        return FALSE;
+
+      p = skip_space (p, end);
+      if (p < end && *p == ',')
+        p++;
+    }
+}
+
+static gboolean
+ide_lsp_reader_wants (IdeLspReader *self,
+                      const char   *method,
+                      gsize         method_len)
+{
+  g_assert (IDE_IS_LSP_READER (self));
+
+  if (self->prepare == NULL || method == NULL)
+    return FALSE;
+
+  for (guint i = 0; self->prepare_methods[i]; i++)
+    {
+      if (strlen (self->prepare_methods[i]) == method_len &&
+          memcmp (self->prepare_methods[i], method, method_len) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static GVariant *
+decode_message (GBytes *body)
+{
+  g_autoptr(JsonParser) parser = json_parser_new_immutable ();
+  g_autoptr(GVariant) message = NULL;
+  JsonNode *root;
+  gsize len;
+  const char *data = g_bytes_get_data (body, &len);
+
+  if (!json_parser_load_from_data (parser, data, len, NULL))
+    return NULL;
+
+  if (!(root = json_parser_get_root (parser)) || !JSON_NODE_HOLDS_OBJECT (root))
+    return NULL;
+
+  if (!(message = json_gvariant_deserialize (root, NULL, NULL)))
+    return NULL;
+
+  g_variant_take_ref (message);
+
+  if (!g_variant_is_of_type (message, G_VARIANT_TYPE_VARDICT))
+    return NULL;
+
+  return g_steal_pointer (&message);
+}
+
+static gboolean
+write_frame (IdeLspReader  *self,
+             const char    *body,
+             gsize          len,
+             GError       **error)
+{
+  g_autofree char *header = NULL;
+
+  /* No Content-Type so jsonrpc-glib treats the body as JSON */
+  header = g_strdup_printf ("Content-Length: %"G_GSIZE_FORMAT"\r\n"
+                            "\r\n",
+                            len);
+
+  return g_output_stream_write_all (self->pipe_out, header, strlen (header), NULL, self->cancellable, error) &&
+         g_output_stream_write_all (self->pipe_out, body, len, NULL, self->cancellable, error);
+}
+
+static gboolean
+ide_lsp_reader_queue (IdeLspReader  *self,
+                      gpointer       prepared,
+                      GError       **error)
+{
+  g_autofree char *placeholder = NULL;
+  guint serial;
+
+  g_assert (IDE_IS_LSP_READER (self));
+  g_assert (prepared != NULL);
+
+  g_mutex_lock (&self->mutex);
+
+  while (g_hash_table_size (self->prepared) >= MAX_PENDING_PREPARED && !self->closed)
+    g_cond_wait (&self->cond, &self->mutex);
+
+  if (self->closed)
+    {
+      g_mutex_unlock (&self->mutex);
+      if (self->prepared_destroy != NULL)
+        self->prepared_destroy (prepared);
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_CANCELLED,
+                           "The reader was closed");
+      return FALSE;
+    }
+
+  serial = ++self->last_serial;
+  g_hash_table_insert (self->prepared, GUINT_TO_POINTER (serial), prepared);
+
+  self->stats.n_prepared++;
+  self->stats.max_pending = MAX (self->stats.max_pending, g_hash_table_size (self->prepared));
+
+  g_mutex_unlock (&self->mutex);
+
+  placeholder = g_strdup_printf ("{\"jsonrpc\":\"2.0\","
+                                 "\"method\":\"%s\","
+                                 "\"params\":{\"serial\":%u}}",
+                                 IDE_LSP_READER_PREPARED_METHOD,
+                                 serial);
+
+  return write_frame (self, placeholder, strlen (placeholder), error);
+}
+
+static gpointer
+ide_lsp_reader_thread (gpointer data)
+{
+  g_autoptr(IdeLspReader) self = data;
+  g_autoptr(GDataInputStream) input = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_LSP_READER (self));
+
+  input = g_data_input_stream_new (self->base_stream);
+  g_data_input_stream_set_newline_type (input, G_DATA_STREAM_NEWLINE_TYPE_LF);
+  g_filter_input_stream_set_close_base_stream (G_FILTER_INPUT_STREAM (input), FALSE);
+
+  for (;;)
+    {
+      g_autoptr(GVariant) message = NULL;
+      g_autoptr(GVariant) params = NULL;
+      g_autoptr(GBytes) body = NULL;
+      const char *method = NULL;
+      gpointer prepared = NULL;
+      gboolean has_id = FALSE;
+      gsize method_len = 0;
+      gint64 begin;
+      gsize len;
+
+      if (!(body = read_frame (input, self->cancellable, &error)))
+        break;
+
+      begin = g_get_monotonic_time ();
+      len = g_bytes_get_size (body);
+
+      /* Only notifications may be taken over. Replies and calls from
+       * the server go through the JsonrpcClient, which parses them.
+       */
+      if (sniff_message (body, &method, &method_len, &has_id) &&
+          !has_id &&
+          ide_lsp_reader_wants (self, method, method_len) &&
+          (message = decode_message (body)) &&
+          g_variant_lookup (message, "method", "&s", &method))
+        {
+          params = g_variant_lookup_value (message, "params", NULL);
+          prepared = self->prepare (self->owner, method, params);
+        }
+
+      g_mutex_lock (&self->mutex);
+      self->stats.n_messages++;
+      self->stats.n_bytes += len;
+      self->stats.decode_usec += g_get_monotonic_time () - begin;
+      g_mutex_unlock (&self->mutex);
+
+      ide_counter_add (&lsp_decode_usec, g_get_monotonic_time () - begin);
+
+      if (prepared != NULL)
+        {
+          if (!ide_lsp_reader_queue (self, g_steal_pointer (&prepared), &error))
+            break;
+        }
+      else if (!write_frame (self, g_bytes_get_data (body, NULL), len, &error))
+        break;
+    }
+
+  if (error != NULL &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CLOSED))
+    g_debug ("Language server reader stopped: %s", error->message);
+
+  /* Closing our end of the pipe propagates EOF to the JsonrpcClient */
+  g_output_stream_close (self->pipe_out, NULL, NULL);
+
+  return NULL;
+}
+
+/**
+ * ide_lsp_reader_new:
+ * @base_stream: the stream to read from the language server
+ * @owner: the object owning the reader, which must call
+ *   ide_lsp_reader_close() before it is finalized
+ * @prepare_methods: (nullable): the notifications to pass to @prepare
+ * @prepare: (nullable): a function to prepare notifications in the thread
+ * @prepared_destroy: (nullable): a function to free prepared notifications
+ * @error: a location for a #GError
+ *
+ * Creates a new reader and starts its thread.
+ *
+ * Returns: (transfer full): an #IdeLspReader or %NULL and @error is set
+ */
+IdeLspReader *
+ide_lsp_reader_new (GInputStream          *base_stream,
+                    GObject               *owner,
+                    const char * const    *prepare_methods,
+                    IdeLspReaderPrepare    prepare,
+                    GDestroyNotify         prepared_destroy,
+                    GError               **error)
+{
+  IdeLspReader *self;
+  int fds[2];
+
+  g_return_val_if_fail (G_IS_INPUT_STREAM (base_stream), NULL);
+  g_return_val_if_fail (G_IS_OBJECT (owner), NULL);
+  g_return_val_if_fail (!prepare || prepare_methods, NULL);
+
+  if (!g_unix_open_pipe (fds, FD_CLOEXEC, error))
+    return NULL;
+
+  self = g_object_new (IDE_TYPE_LSP_READER, NULL);
+  self->base_stream = g_object_ref (base_stream);
+  self->pipe_in = g_unix_input_stream_new (fds[0], TRUE);
+  self->pipe_out = g_unix_output_stream_new (fds[1], TRUE);
+  self->owner = owner;
+  self->prepare_methods = g_strdupv ((char **)prepare_methods);
+  self->prepare = prepare;
+  self->prepared_destroy = prepared_destroy;
+  self->prepared = g_hash_table_new_full (NULL, NULL, NULL, prepared_destroy);
+  self->thread = g_thread_new ("[ide-lsp-reader]",
+                               ide_lsp_reader_thread,
+                               g_object_ref (self));
+
+  return self;
+}
+
+/**
+ * ide_lsp_reader_get_input_stream:
+ * @self: a #IdeLspReader
+ *
+ * Gets the stream to hand to the #JsonrpcClient in place of the stream
+ * from the language server.
+ *
+ * Returns: (transfer none): a #GInputStream
+ */
+GInputStream *
+ide_lsp_reader_get_input_stream (IdeLspReader *self)
+{
+  g_return_val_if_fail (IDE_IS_LSP_READER (self), NULL);
+
+  return self->pipe_in;
+}
+
+/**
+ * ide_lsp_reader_close:
+ * @self: a #IdeLspReader
+ *
+ * Stops the reader thread and waits for it to exit. Prepared notifications
+ * which have not yet been stolen are dropped.
+ */
+void
+ide_lsp_reader_close (IdeLspReader *self)
+{
+  GThread *thread;
+
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+  g_return_if_fail (IDE_IS_LSP_READER (self));
+
+  if (self->thread == NULL)
+    return;
+
+  g_mutex_lock (&self->mutex);
+  self->closed = TRUE;
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->mutex);
+
+  g_cancellable_cancel (self->cancellable);
+
+  thread = g_steal_pointer (&self->thread);
+  g_thread_join (thread);
+
+  g_hash_table_remove_all (self->prepared);
+
+  self->owner = NULL;
+}
+
+/**
+ * ide_lsp_reader_steal_prepared:
+ * @self: a #IdeLspReader
+ * @params: the params of an %IDE_LSP_READER_PREPARED_METHOD notification
+ *
+ * Takes the prepared notification which the placeholder notification
+ * received from the #JsonrpcClient stands for.
+ *
+ * Returns: (transfer full) (nullable): the prepared data, to be freed with
+ *   the @prepared_destroy function given to ide_lsp_reader_new()
+ */
+gpointer
+ide_lsp_reader_steal_prepared (IdeLspReader *self,
+                               GVariant     *params)
+{
+  gpointer prepared = NULL;
+  gint64 serial = 0;
+
+  g_return_val_if_fail (IDE_IS_MAIN_THREAD (), NULL);
+  g_return_val_if_fail (IDE_IS_LSP_READER (self), NULL);
+
+  if (params == NULL ||
+      !g_variant_is_of_type (params, G_VARIANT_TYPE_VARDICT) ||
+      !g_variant_lookup (params, "serial", "x", &serial))
+    return NULL;
+
+  g_mutex_lock (&self->mutex);
+  if (g_hash_table_steal_extended (self->prepared, GUINT_TO_POINTER ((guint)serial), NULL, &prepared))
+    g_cond_signal (&self->cond);
+  g_mutex_unlock (&self->mutex);
+
+  return prepared;
+}
+
+/**
+ * ide_lsp_reader_get_stats:
+ * @self: a #IdeLspReader
+ * @stats: (out): location for the statistics
+ *
+ * Gets statistics about the traffic handled by the reader.
+ */
+void
+ide_lsp_reader_get_stats (IdeLspReader      *self,
+                          IdeLspReaderStats *stats)
+{
+  g_return_if_fail (IDE_IS_LSP_READER (self));
+  g_return_if_fail (stats != NULL);
+
+  g_mutex_lock (&self->mutex);
+  *stats = self->stats;
+  g_mutex_unlock (&self->mutex);
+}
@@ -0,0 +1,38 @@
+/* ide-lsp-recorder-private.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_LSP_RECORDER (ide_lsp_recorder_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeLspRecorder, ide_lsp_recorder, IDE, LSP_RECORDER, GObject)
+
+IdeLspRecorder *ide_lsp_recorder_new                  (const char      *path,
+                                                       GError         **error);
+IdeLspRecorder *ide_lsp_recorder_new_for_environment  (const char      *name);
+const char     *ide_lsp_recorder_get_path             (IdeLspRecorder  *self);
+GIOStream      *ide_lsp_recorder_wrap                 (IdeLspRecorder  *self,
+                                                       GIOStream       *stream);
+
+G_END_DECLS
@@ -0,0 +1,519 @@
+/* ide-lsp-recorder.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "ide-lsp-recorder"
+
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+
+#include "ide-lsp-recorder-private.h"
+
+/* IdeLspRecorder tees the traffic between Builder and a language server
+ * into a file so that a session can later be replayed without the server
+ * using IdeLspReplay. Each JSON-RPC message is written as a single line:
+ *
+ *   {"time":1234,"direction":"send","message":{...}}
+ *
+ * where "time" is in microseconds since the recorder was created and
+ * "direction" is "send" for messages to the server and "recv" for
+ * messages from the server.
+ *
+ * Bodies framed with "Content-Type: application/gvariant", which
+ * jsonrpc-glib may use when both peers support it, are converted to JSON
+ * so that the recording stays readable and replayable.
+ *
+ * Recording is enabled by setting IDE_LSP_RECORD_DIR to a directory
+ * before starting Builder.
+ */
+
+typedef struct
+{
+  GByteArray *buffer;
+  gssize      content_length;
+  guint       is_gvariant : 1;
+} Framer;
+
+struct _IdeLspRecorder
+{
+  GObject        parent_instance;
+  GMutex         mutex;
+  char          *path;
+  GOutputStream *output;
+  gint64         begin_time;
+  Framer         send;
+  Framer         recv;
+};
+
+G_DEFINE_FINAL_TYPE (IdeLspRecorder, ide_lsp_recorder, G_TYPE_OBJECT)
+
+#define IDE_TYPE_LSP_RECORDER_INPUT (ide_lsp_recorder_input_get_type())
+G_DECLARE_FINAL_TYPE (IdeLspRecorderInput, ide_lsp_recorder_input, IDE, LSP_RECORDER_INPUT, GFilterInputStream)
+
+struct _IdeLspRecorderInput
+{
+  GFilterInputStream  parent_instance;
+  IdeLspRecorder     *recorder;
+};
+
+G_DEFINE_FINAL_TYPE (IdeLspRecorderInput, ide_lsp_recorder_input, G_TYPE_FILTER_INPUT_STREAM)
+
+#define IDE_TYPE_LSP_RECORDER_OUTPUT (ide_lsp_recorder_output_get_type())
+G_DECLARE_FINAL_TYPE (IdeLspRecorderOutput, ide_lsp_recorder_output, IDE, LSP_RECORDER_OUTPUT, GFilterOutputStream)
+
+struct _IdeLspRecorderOutput
+{
+  GFilterOutputStream  parent_instance;
+  IdeLspRecorder      *recorder;
+};
+
+G_DEFINE_FINAL_TYPE (IdeLspRecorderOutput, ide_lsp_recorder_output, G_TYPE_FILTER_OUTPUT_STREAM)
+
+static void
+framer_init (Framer *framer)
+{
+  framer->buffer = g_byte_array_new ();
+  framer->content_length = -1;
+}
+
+static void
+framer_clear (Framer *framer)
+{
+  g_clear_pointer (&framer->buffer, g_byte_array_unref);
+  framer->content_length = -1;
+  framer->is_gvariant = FALSE;
+}
+
+static gssize
+find_header_end (const GByteArray *buffer)
+{
+  for (guint i = 0; i + 3 < buffer->len; i++)
+    {
+      if (memcmp (&buffer->data[i], "\r\n\r\n", 4) == 0)
+        return i;
+    }
+
+  return -1;
+}
+
+static gssize
+parse_headers (const char *headers,
+               gsize       len,
+               gboolean   *is_gvariant)
+{
+  g_autofree char *copy = g_strndup (headers, len);
+  g_auto(GStrv) lines = g_strsplit (copy, "\r\n", 0);
+  gssize content_length = -1;
+
+  *is_gvariant = FALSE;
+
+  for (guint i = 0; lines[i]; i++)
+    {
+      if (g_ascii_strncasecmp (lines[i], "Content-Length:", 15) == 0)
+        {
+          guint64 value;
+
+          if (g_ascii_string_to_unsigned (g_strstrip (lines[i] + 15), 10, 0, G_MAXSSIZE, &value, NULL))
+            content_length = value;
+        }
+      else if (g_ascii_strncasecmp (lines[i], "Content-Type:", 13) == 0)
+        {
+          *is_gvariant = g_str_has_prefix (g_strstrip (lines[i] + 13), "application/gvariant");
+        }
+    }
+
+  return content_length;
+}
+
+static char *
+gvariant_to_json (const guint8 *body,
+                  gsize         len)
+{
+  g_autoptr(GBytes) bytes = g_bytes_new (body, len);
+  g_autoptr(GVariant) message = NULL;
+  g_autoptr(JsonNode) node = NULL;
+
+  message = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE_VARDICT, bytes, FALSE));
+
+  if (!g_variant_is_normal_form (message))
+    return NULL;
+
+  if (!(node = json_gvariant_serialize (message)))
+    return NULL;
+
+  return json_to_string (node, FALSE);
+}
+
+static void
+ide_lsp_recorder_write_record (IdeLspRecorder *self,
+                               const char     *direction,
+                               gboolean        is_gvariant,
+                               const guint8   *body,
+                               gsize           len)
+{
+  g_autoptr(GString) line = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *json = NULL;
+
+  g_assert (IDE_IS_LSP_RECORDER (self));
+
+  if (self->output == NULL)
+    return;
+
+  if (is_gvariant)
+    {
+      if (!(json = gvariant_to_json (body, len)))
+        {
+          g_debug ("Dropping malformed GVariant message from recording");
+          return;
+        }
+
+      body = (const guint8 *)json;
+      len = strlen (json);
+    }
+
+  /* Only JSON bodies can be replayed, skip anything else */
+  if (len == 0 || (body[0] != '{' && body[0] != '['))
+    return;
+
+  line = g_string_sized_new (len + 64);
+  g_string_append_printf (line,
+                          "{\"time\":%"G_GINT64_FORMAT",\"direction\":\"%s\",\"message\":",
+                          g_get_monotonic_time () - self->begin_time,
+                          direction);
+
+  /* Newlines may only appear as whitespace in JSON (they must be escaped
+   * within strings) so folding them keeps one message per line.
+   */
+  for (gsize i = 0; i < len; i++)
+    g_string_append_c (line, body[i] == '\n' || body[i] == '\r' ? ' ' : body[i]);
+
+  g_string_append (line, "}\n");
+
+  if (!g_output_stream_write_all (self->output, line->str, line->len, NULL, NULL, &error))
+    {
+      g_warning ("Failed to record language server traffic to %s: %s",
+                 self->path, error->message);
+      g_clear_object (&self->output);
+    }
+}
+
+static void
+ide_lsp_recorder_feed (IdeLspRecorder *self,
+                       Framer         *framer,
+                       const char     *direction,
+                       const guint8   *data,
+                       gsize           len)
+{
+  g_assert (IDE_IS_LSP_RECORDER (self));
+  g_assert (framer != NULL);
+
+  g_mutex_lock (&self->mutex);
+
+  g_byte_array_append (framer->buffer, data, len);
+
+  for (;;)
+    {
+      if (framer->content_length < 0)
+        {
+          gboolean is_gvariant;
+          gssize header_end;
+
+          if ((header_end = find_header_end (framer->buffer)) < 0)
+            break;
+
+          framer->content_length = parse_headers ((const char *)framer->buffer->data,
+                                                  header_end,
+                                                  &is_gvariant);
+          framer->is_gvariant = is_gvariant;
+          g_byte_array_remove_range (framer->buffer, 0, header_end + 4);
+
+          /* Lost track of framing, drop what we have and resync */
+          if (framer->content_length < 0)
+            {
+              g_byte_array_set_size (framer->buffer, 0);
+              break;
+            }
+        }
+
+      if (framer->buffer->len < (gsize)framer->content_length)
+        break;
+
+      ide_lsp_recorder_write_record (self,
+                                     direction,
+                                     framer->is_gvariant,
+                                     framer->buffer->data,
+                                     framer->content_length);
+      g_byte_array_remove_range (framer->buffer, 0, framer->content_length);
+      framer->content_length = -1;
+    }
+
+  g_mutex_unlock (&self->mutex);
+}
+
+static gssize
+ide_lsp_recorder_input_read (GInputStream  *stream,
+                             void          *buffer,
+                             gsize          count,
+                             GCancellable  *cancellable,
+                             GError       **error)
+{
+  IdeLspRecorderInput *self = (IdeLspRecorderInput *)stream;
+  GInputStream *base_stream = g_filter_input_stream_get_base_stream (G_FILTER_INPUT_STREAM (self));
+  gssize n_read;
+
+  if ((n_read = g_input_stream_read (base_stream, buffer, count, cancellable, error)) > 0)
+    ide_lsp_recorder_feed (self->recorder, &self->recorder->recv, "recv", buffer, n_read);
+
+  return n_read;
+}
+
+static void
+ide_lsp_recorder_input_finalize (GObject *object)
+{
+  IdeLspRecorderInput *self = (IdeLspRecorderInput *)object;
+
+  g_clear_object (&self->recorder);
+
+  G_OBJECT_CLASS (ide_lsp_recorder_input_parent_class)->finalize (object);
+}
+
+static void
+ide_lsp_recorder_input_class_init (IdeLspRecorderInputClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GInputStreamClass *input_stream_class = G_INPUT_STREAM_CLASS (klass);
+
+  object_class->finalize = ide_lsp_recorder_input_finalize;
+
+  input_stream_class->read_fn = ide_lsp_recorder_input_read;
+}
+
+static void
+ide_lsp_recorder_input_init (IdeLspRecorderInput *self)
+{
+}
+
+static gssize
+ide_lsp_recorder_output_write (GOutputStream  *stream,
+                               const void     *buffer,
+                               gsize           count,
+                               GCancellable   *cancellable,
+                               GError        **error)
+{
+  IdeLspRecorderOutput *self = (IdeLspRecorderOutput *)stream;
+  GOutputStream *base_stream = g_filter_output_stream_get_base_stream (G_FILTER_OUTPUT_STREAM (self));
+  gssize n_written;
+
+  if ((n_written = g_output_stream_write (base_stream, buffer, count, cancellable, error)) > 0)
+    ide_lsp_recorder_feed (self->recorder, &self->recorder->send, "send", buffer, n_written);
+
+  return n_written;
+}
+
+static void
+ide_lsp_recorder_output_finalize (GObject *object)
+{
+  IdeLspRecorderOutput *self = (IdeLspRecorderOutput *)object;
+
+  g_clear_object (&self->recorder);
+
+  G_OBJECT_CLASS (ide_lsp_recorder_output_parent_class)->finalize (object);
+}
+
+static void
+ide_lsp_recorder_output_class_init (IdeLspRecorderOutputClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GOutputStreamClass *output_stream_class = G_OUTPUT_STREAM_CLASS (klass);
+
+  object_class->finalize = ide_lsp_recorder_output_finalize;
+
+  output_stream_class->write_fn = ide_lsp_recorder_output_write;
+}
+
+static void
+ide_lsp_recorder_output_init (IdeLspRecorderOutput *self)
+{
+}
+
+static void
+ide_lsp_recorder_finalize (GObject *object)
+{
+  IdeLspRecorder *self = (IdeLspRecorder *)object;
+
+  if (self->output != NULL)
+    g_output_stream_close (self->output, NULL, NULL);
+
+  g_clear_object (&self->output);
+  g_clear_pointer (&self->path, g_free);
+  framer_clear (&self->send);
+  framer_clear (&self->recv);
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (ide_lsp_recorder_parent_class)->finalize (object);
+}
+
+static void
+ide_lsp_recorder_class_init (IdeLspRecorderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_lsp_recorder_finalize;
+}
+
+static void
+ide_lsp_recorder_init (IdeLspRecorder *self)
+{
+  g_mutex_init (&self->mutex);
+  framer_init (&self->send);
+  framer_init (&self->recv);
+  self->begin_time = g_get_monotonic_time ();
+}
+
+/**
+ * ide_lsp_recorder_new:
+ * @path: the file to write the recording to
+ * @error: a location for a #GError
+ *
+ * Creates a new recorder which writes to @path, replacing any existing
+ * file.
+ *
+ * Returns: (transfer full): an #IdeLspRecorder or %NULL and @error is set
+ */
+IdeLspRecorder *
+ide_lsp_recorder_new (const char  *path,
+                      GError     **error)
+{
+  g_autoptr(GFileOutputStream) output = NULL;
+  g_autoptr(GFile) file = NULL;
+  IdeLspRecorder *self;
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  file = g_file_new_for_path (path);
+
+  if (!(output = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_REPLACE_DESTINATION, NULL, error)))
+    return NULL;
+
+  self = g_object_new (IDE_TYPE_LSP_RECORDER, NULL);
+  self->path = g_strdup (path);
+  self->output = G_OUTPUT_STREAM (g_steal_pointer (&output));
+
+  return self;
+}
+
+/**
+ * ide_lsp_recorder_new_for_environment:
+ * @name: a name for the recording such as the client type name
+ *
+ * Creates a new recorder within the directory named by the
+ * `IDE_LSP_RECORD_DIR` environment variable.
+ *
+ * Returns: (transfer full) (nullable): an #IdeLspRecorder or %NULL if
+ *   recording is disabled or the recording could not be created
+ */
+IdeLspRecorder *
+ide_lsp_recorder_new_for_environment (const char *name)
+{
+  static guint serial;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *basename = NULL;
+  g_autofree char *path = NULL;
+  IdeLspRecorder *self;
+  const char *dir;
+
+  g_return_val_if_fail (name != NULL, NULL);
+
+  if (!(dir = g_getenv ("IDE_LSP_RECORD_DIR")) || dir[0] == 0)
+    return NULL;
+
+  if (g_mkdir_with_parents (dir, 0750) != 0)
+    {
+      g_warning ("Failed to create %s, not recording language server traffic", dir);
+      return NULL;
+    }
+
+  basename = g_strdup_printf ("%s-%d-%u.jsonl", name, getpid (), g_atomic_int_add (&serial, 1));
+  path = g_build_filename (dir, basename, NULL);
+
+  if (!(self = ide_lsp_recorder_new (path, &error)))
+    {
+      g_warning ("Failed to record language server traffic: %s", error->message);
+      return NULL;
+    }
+
+  g_debug ("Recording language server traffic to %s", path);
+
+  return self;
+}
+
+const char *
+ide_lsp_recorder_get_path (IdeLspRecorder *self)
+{
+  g_return_val_if_fail (IDE_IS_LSP_RECORDER (self), NULL);
+
+  return self->path;
+}
+
+/**
+ * ide_lsp_recorder_wrap:
+ * @self: a #IdeLspRecorder
+ * @stream: the stream connected to the language server
+ *
+ * Creates a stream which passes everything through to @stream while
+ * recording complete JSON-RPC messages in both directions.
+ *
+ * Closing the returned stream closes @stream.
+ *
+ * Returns: (transfer full): a #GIOStream
+ */
+GIOStream *
+ide_lsp_recorder_wrap (IdeLspRecorder *self,
+                       GIOStream      *stream)
+{
+  IdeLspRecorderInput *input;
+  IdeLspRecorderOutput *output;
+  GIOStream *ret;
+
+  g_return_val_if_fail (IDE_IS_LSP_RECORDER (self), NULL);
+  g_return_val_if_fail (G_IS_IO_STREAM (stream), NULL);
+
+  input = g_object_new (IDE_TYPE_LSP_RECORDER_INPUT,
+                        "base-stream", g_io_stream_get_input_stream (stream),
+                        NULL);
+  input->recorder = g_object_ref (self);
+
+  output = g_object_new (IDE_TYPE_LSP_RECORDER_OUTPUT,
+                         "base-stream", g_io_stream_get_output_stream (stream),
+                         NULL);
+  output->recorder = g_object_ref (self);
+
+  ret = g_simple_io_stream_new (G_INPUT_STREAM (input), G_OUTPUT_STREAM (output));
+
+  g_object_unref (input);
+  g_object_unref (output);
+
+  return ret;
+}
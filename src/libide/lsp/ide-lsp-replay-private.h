@@ -0,0 +1,40 @@
+/* ide-lsp-replay-private.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_LSP_REPLAY (ide_lsp_replay_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeLspReplay, ide_lsp_replay, IDE, LSP_REPLAY, GObject)
+
+IdeLspReplay *ide_lsp_replay_new             (GFile         *file,
+                                              GError       **error);
+void          ide_lsp_replay_set_speed       (IdeLspReplay  *self,
+                                              double         speed);
+GIOStream    *ide_lsp_replay_start           (IdeLspReplay  *self,
+                                              GError       **error);
+void          ide_lsp_replay_stop            (IdeLspReplay  *self);
+guint         ide_lsp_replay_get_n_unmatched (IdeLspReplay  *self);
+
+G_END_DECLS
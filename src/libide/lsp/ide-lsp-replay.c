@@ -0,0 +1,579 @@
+/* ide-lsp-replay.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "ide-lsp-replay"
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+#include <json-glib/json-glib.h>
+
+#include "ide-lsp-replay-private.h"
+
+/* IdeLspReplay is a fake language server which plays back a session
+ * captured by IdeLspRecorder. It runs in a thread of its own so that the
+ * client under test sees the same kind of I/O as with a real server.
+ *
+ * The recording is followed in order. For every message the client sent
+ * during the recording, the replay waits for the client to send a message
+ * with the same method (or another reply) and remembers the request id
+ * so that recorded replies can be rewritten to the id the client expects.
+ * Messages from the client which have no counterpart in the recording
+ * are dropped and counted. Messages the server sent are delivered with
+ * the same delay, relative to the last message from the client, as in
+ * the recording, divided by the replay speed.
+ *
+ * Messages from the client framed as GVariant are converted to JSON
+ * before they are matched. Replies are always written as JSON.
+ */
+
+typedef struct
+{
+  gint64    time;
+  JsonNode *message;
+  char     *method;
+  guint     send : 1;
+} Record;
+
+struct _IdeLspReplay
+{
+  GObject        parent_instance;
+
+  GArray        *records;
+  double         speed;
+
+  GInputStream  *from_client;
+  GOutputStream *to_client;
+  GCancellable  *cancellable;
+  GThread       *thread;
+
+  GMutex         mutex;
+  GCond          cond;
+  guint          n_unmatched;
+  guint          stopped : 1;
+};
+
+G_DEFINE_FINAL_TYPE (IdeLspReplay, ide_lsp_replay, G_TYPE_OBJECT)
+
+static void
+record_clear (gpointer data)
+{
+  Record *record = data;
+
+  g_clear_pointer (&record->message, json_node_unref);
+  g_clear_pointer (&record->method, g_free);
+}
+
+static char *
+dup_method (JsonNode *message)
+{
+  JsonObject *object;
+
+  if (!JSON_NODE_HOLDS_OBJECT (message) ||
+      !(object = json_node_get_object (message)) ||
+      !json_object_has_member (object, "method"))
+    return NULL;
+
+  return g_strdup (json_object_get_string_member (object, "method"));
+}
+
+static char *
+dup_id_key (JsonNode *message)
+{
+  JsonObject *object;
+  JsonNode *id;
+
+  if (!JSON_NODE_HOLDS_OBJECT (message) ||
+      !(object = json_node_get_object (message)) ||
+      !(id = json_object_get_member (object, "id")))
+    return NULL;
+
+  return json_to_string (id, FALSE);
+}
+
+static void
+ide_lsp_replay_dispose (GObject *object)
+{
+  IdeLspReplay *self = (IdeLspReplay *)object;
+
+  ide_lsp_replay_stop (self);
+
+  G_OBJECT_CLASS (ide_lsp_replay_parent_class)->dispose (object);
+}
+
+static void
+ide_lsp_replay_finalize (GObject *object)
+{
+  IdeLspReplay *self = (IdeLspReplay *)object;
+
+  g_assert (self->thread == NULL);
+
+  g_clear_pointer (&self->records, g_array_unref);
+  g_clear_object (&self->from_client);
+  g_clear_object (&self->to_client);
+  g_clear_object (&self->cancellable);
+
+  g_mutex_clear (&self->mutex);
+  g_cond_clear (&self->cond);
+
+  G_OBJECT_CLASS (ide_lsp_replay_parent_class)->finalize (object);
+}
+
+static void
+ide_lsp_replay_class_init (IdeLspReplayClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = ide_lsp_replay_dispose;
+  object_class->finalize = ide_lsp_replay_finalize;
+}
+
+static void
+ide_lsp_replay_init (IdeLspReplay *self)
+{
+  g_mutex_init (&self->mutex);
+  g_cond_init (&self->cond);
+  self->cancellable = g_cancellable_new ();
+  self->records = g_array_new (FALSE, FALSE, sizeof (Record));
+  g_array_set_clear_func (self->records, record_clear);
+  self->speed = 1.0;
+}
+
+static JsonNode *
+read_message (GDataInputStream  *input,
+              GCancellable      *cancellable,
+              GError           **error)
+{
+  g_autoptr(JsonParser) parser = NULL;
+  g_autofree char *data = NULL;
+  gboolean is_gvariant = FALSE;
+  gsize content_length = 0;
+  gsize n_read = 0;
+
+  for (;;)
+    {
+      g_autofree char *line = NULL;
+      gsize len = 0;
+
+      if (!(line = g_data_input_stream_read_line (input, &len, cancellable, error)))
+        {
+          if (error != NULL && *error == NULL)
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED, "The client closed the stream");
+          return NULL;
+        }
+
+      if (len > 0 && line[len - 1] == '\r')
+        line[--len] = 0;
+
+      if (len == 0)
+        break;
+
+      if (g_ascii_strncasecmp (line, "Content-Length:", 15) == 0)
+        content_length = g_ascii_strtoull (line + 15, NULL, 10);
+      else if (g_ascii_strncasecmp (line, "Content-Type:", 13) == 0)
+        is_gvariant = g_str_has_prefix (g_strstrip (line + 13), "application/gvariant");
+    }
+
+  data = g_malloc (content_length + 1);
+
+  if (!g_input_stream_read_all (G_INPUT_STREAM (input), data, content_length, &n_read, cancellable, error))
+    return NULL;
+
+  if (n_read != content_length)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED, "The client closed the stream");
+      return NULL;
+    }
+
+  data[content_length] = 0;
+
+  if (is_gvariant)
+    {
+      g_autoptr(GBytes) bytes = g_bytes_new_take (g_steal_pointer (&data), content_length);
+      g_autoptr(GVariant) message = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE_VARDICT, bytes, FALSE));
+
+      if (!g_variant_is_normal_form (message))
+        {
+          g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Malformed GVariant message from client");
+          return NULL;
+        }
+
+      return json_gvariant_serialize (message);
+    }
+
+  parser = json_parser_new_immutable ();
+
+  if (!json_parser_load_from_data (parser, data, content_length, error))
+    return NULL;
+
+  return json_parser_steal_root (parser);
+}
+
+static gboolean
+write_message (IdeLspReplay  *self,
+               JsonNode      *message,
+               GError       **error)
+{
+  g_autofree char *body = json_to_string (message, FALSE);
+  g_autofree char *header = NULL;
+  gsize len = strlen (body);
+
+  header = g_strdup_printf ("Content-Length: %"G_GSIZE_FORMAT"\r\n\r\n", len);
+
+  return g_output_stream_write_all (self->to_client, header, strlen (header), NULL, self->cancellable, error) &&
+         g_output_stream_write_all (self->to_client, body, len, NULL, self->cancellable, error);
+}
+
+static gboolean
+ide_lsp_replay_wait_until (IdeLspReplay *self,
+                           gint64        deadline)
+{
+  gboolean stopped;
+
+  g_mutex_lock (&self->mutex);
+  while (!self->stopped)
+    {
+      if (!g_cond_wait_until (&self->cond, &self->mutex, deadline))
+        break;
+    }
+  stopped = self->stopped;
+  g_mutex_unlock (&self->mutex);
+
+  return !stopped;
+}
+
+static gpointer
+ide_lsp_replay_thread (gpointer data)
+{
+  g_autoptr(IdeLspReplay) self = data;
+  g_autoptr(GDataInputStream) input = NULL;
+  g_autoptr(GHashTable) ids = NULL;
+  g_autoptr(GError) error = NULL;
+  gint64 recorded_anchor = 0;
+  gint64 live_anchor;
+
+  g_assert (IDE_IS_LSP_REPLAY (self));
+
+  input = g_data_input_stream_new (self->from_client);
+  g_data_input_stream_set_newline_type (input, G_DATA_STREAM_NEWLINE_TYPE_LF);
+  g_filter_input_stream_set_close_base_stream (G_FILTER_INPUT_STREAM (input), FALSE);
+
+  /* Recorded request id -> request id used by the client */
+  ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)json_node_unref);
+
+  if (self->records->len > 0)
+    recorded_anchor = g_array_index (self->records, Record, 0).time;
+  live_anchor = g_get_monotonic_time ();
+
+  for (guint i = 0; i < self->records->len; i++)
+    {
+      const Record *record = &g_array_index (self->records, Record, i);
+
+      if (record->send)
+        {
+          for (;;)
+            {
+              g_autoptr(JsonNode) message = NULL;
+              g_autofree char *method = NULL;
+
+              if (!(message = read_message (input, self->cancellable, &error)))
+                goto finish;
+
+              method = dup_method (message);
+
+              if (g_strcmp0 (method, record->method) == 0)
+                {
+                  g_autofree char *key = dup_id_key (record->message);
+                  JsonNode *id;
+
+                  if (key != NULL && method != NULL &&
+                      (id = json_object_get_member (json_node_get_object (message), "id")))
+                    g_hash_table_insert (ids, g_steal_pointer (&key), json_node_copy (id));
+
+                  break;
+                }
+
+              g_mutex_lock (&self->mutex);
+              self->n_unmatched++;
+              g_mutex_unlock (&self->mutex);
+            }
+
+          live_anchor = g_get_monotonic_time ();
+          recorded_anchor = record->time;
+        }
+      else
+        {
+          g_autoptr(JsonNode) message = json_node_copy (record->message);
+
+          if (self->speed > 0)
+            {
+              gint64 delay = (record->time - recorded_anchor) / self->speed;
+
+              if (!ide_lsp_replay_wait_until (self, live_anchor + MAX (0, delay)))
+                goto finish;
+            }
+
+          /* Replies must carry the id the client used for the request */
+          if (record->method == NULL && JSON_NODE_HOLDS_OBJECT (message))
+            {
+              g_autofree char *key = dup_id_key (message);
+              JsonNode *id;
+
+              if (key != NULL && (id = g_hash_table_lookup (ids, key)))
+                json_object_set_member (json_node_get_object (message), "id", json_node_copy (id));
+            }
+
+          if (!write_message (self, message, &error))
+            goto finish;
+        }
+    }
+
+  /* Keep consuming so the client never blocks writing to us */
+  for (;;)
+    {
+      g_autoptr(JsonNode) message = NULL;
+
+      if (!(message = read_message (input, self->cancellable, NULL)))
+        break;
+    }
+
+finish:
+  if (error != NULL &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CLOSED))
+    g_debug ("Replay stopped: %s", error->message);
+
+  /* Closing our end propagates EOF to the client */
+  g_output_stream_close (self->to_client, NULL, NULL);
+
+  return NULL;
+}
+
+static gboolean
+ide_lsp_replay_load (IdeLspReplay  *self,
+                     GFile         *file,
+                     GError       **error)
+{
+  g_autofree char *contents = NULL;
+  g_auto(GStrv) lines = NULL;
+  gsize len;
+
+  g_assert (IDE_IS_LSP_REPLAY (self));
+  g_assert (G_IS_FILE (file));
+
+  if (!g_file_load_contents (file, NULL, &contents, &len, NULL, error))
+    return FALSE;
+
+  lines = g_strsplit (contents, "\n", 0);
+
+  for (guint i = 0; lines[i]; i++)
+    {
+      g_autoptr(JsonParser) parser = NULL;
+      const char *direction;
+      JsonObject *object;
+      JsonNode *root;
+      Record record = {0};
+
+      if (lines[i][0] == 0)
+        continue;
+
+      parser = json_parser_new_immutable ();
+
+      if (!json_parser_load_from_data (parser, lines[i], -1, error))
+        {
+          g_prefix_error (error, "Line %u: ", i + 1);
+          return FALSE;
+        }
+
+      root = json_parser_get_root (parser);
+
+      if (!JSON_NODE_HOLDS_OBJECT (root) ||
+          !(object = json_node_get_object (root)) ||
+          !json_object_has_member (object, "message") ||
+          !(direction = json_object_get_string_member_with_default (object, "direction", NULL)))
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "Line %u: not a recorded message",
+                       i + 1);
+          return FALSE;
+        }
+
+      record.time = json_object_get_int_member_with_default (object, "time", 0);
+      record.send = g_str_equal (direction, "send");
+      record.message = json_node_ref (json_object_get_member (object, "message"));
+      record.method = dup_method (record.message);
+
+      g_array_append_val (self->records, record);
+    }
+
+  return TRUE;
+}
+
+/**
+ * ide_lsp_replay_new:
+ * @file: a recording made with IdeLspRecorder
+ * @error: a location for a #GError
+ *
+ * Loads the recording in @file.
+ *
+ * Returns: (transfer full): an #IdeLspReplay or %NULL and @error is set
+ */
+IdeLspReplay *
+ide_lsp_replay_new (GFile   *file,
+                    GError **error)
+{
+  g_autoptr(IdeLspReplay) self = NULL;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  self = g_object_new (IDE_TYPE_LSP_REPLAY, NULL);
+
+  if (!ide_lsp_replay_load (self, file, error))
+    return NULL;
+
+  return g_steal_pointer (&self);
+}
+
+/**
+ * ide_lsp_replay_set_speed:
+ * @self: a #IdeLspReplay
+ * @speed: the speed factor, or 0 to deliver messages immediately
+ *
+ * Sets how fast the recording is played back. The default of 1.0 uses
+ * the timing of the recording.
+ */
+void
+ide_lsp_replay_set_speed (IdeLspReplay *self,
+                          double        speed)
+{
+  g_return_if_fail (IDE_IS_LSP_REPLAY (self));
+  g_return_if_fail (self->thread == NULL);
+  g_return_if_fail (speed >= 0);
+
+  self->speed = speed;
+}
+
+/**
+ * ide_lsp_replay_start:
+ * @self: a #IdeLspReplay
+ * @error: a location for a #GError
+ *
+ * Starts playing back the recording.
+ *
+ * Returns: (transfer full): a #GIOStream to give to the client in place
+ *   of the stream to a language server, or %NULL and @error is set
+ */
+GIOStream *
+ide_lsp_replay_start (IdeLspReplay  *self,
+                      GError       **error)
+{
+  g_autoptr(GInputStream) client_in = NULL;
+  g_autoptr(GOutputStream) client_out = NULL;
+  int to_client[2];
+  int to_server[2];
+
+  g_return_val_if_fail (IDE_IS_LSP_REPLAY (self), NULL);
+  g_return_val_if_fail (self->thread == NULL, NULL);
+
+  if (!g_unix_open_pipe (to_client, FD_CLOEXEC, error))
+    return NULL;
+
+  if (!g_unix_open_pipe (to_server, FD_CLOEXEC, error))
+    {
+      close (to_client[0]);
+      close (to_client[1]);
+      return NULL;
+    }
+
+  client_in = g_unix_input_stream_new (to_client[0], TRUE);
+  client_out = g_unix_output_stream_new (to_server[1], TRUE);
+  self->from_client = g_unix_input_stream_new (to_server[0], TRUE);
+  self->to_client = g_unix_output_stream_new (to_client[1], TRUE);
+
+  self->thread = g_thread_new ("[ide-lsp-replay]",
+                               ide_lsp_replay_thread,
+                               g_object_ref (self));
+
+  return g_simple_io_stream_new (client_in, client_out);
+}
+
+/**
+ * ide_lsp_replay_stop:
+ * @self: a #IdeLspReplay
+ *
+ * Stops playing back the recording and waits for the thread to exit.
+ */
+void
+ide_lsp_replay_stop (IdeLspReplay *self)
+{
+  GThread *thread;
+
+  g_return_if_fail (IDE_IS_LSP_REPLAY (self));
+
+  if (self->thread == NULL)
+    return;
+
+  g_mutex_lock (&self->mutex);
+  self->stopped = TRUE;
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->mutex);
+
+  g_cancellable_cancel (self->cancellable);
+
+  thread = g_steal_pointer (&self->thread);
+
+  /* The thread may drop the last reference once the client goes away */
+  if (thread == g_thread_self ())
+    g_thread_unref (thread);
+  else
+    g_thread_join (thread);
+}
+
+/**
+ * ide_lsp_replay_get_n_unmatched:
+ * @self: a #IdeLspReplay
+ *
+ * Gets the number of messages from the client which did not match the
+ * recording. A non-zero value means the client behaved differently than
+ * when the recording was made.
+ *
+ * Returns: the number of unmatched messages
+ */
+guint
+ide_lsp_replay_get_n_unmatched (IdeLspReplay *self)
+{
+  guint ret;
+
+  g_return_val_if_fail (IDE_IS_LSP_REPLAY (self), 0);
+
+  g_mutex_lock (&self->mutex);
+  ret = self->n_unmatched;
+  g_mutex_unlock (&self->mutex);
+
+  return ret;
+}
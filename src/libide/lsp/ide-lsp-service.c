@@ -24,7 +24,8 @@
 
 #include <glib/gi18n.h>
 
-#include "ide-lsp-service.h"
+#include "ide-lsp-pool-private.h"
+#include "ide-lsp-service-private.h"
 
 /**
  * SECTION:ide-lsp-service
@@ -38,7 +39,9 @@ typedef struct
   IdeLspClient *client;
   char *program;
   char **search_path;
+  char *pool_key;
   guint has_started : 1;
+  guint is_guest : 1;
   guint inherit_stderr : 1;
   guint has_seen_autostart : 1;
 } IdeLspServicePrivate;
@@ -63,6 +66,7 @@ ide_lsp_service_stop (IdeLspService *self)
   IdeLspServicePrivate *priv = ide_lsp_service_get_instance_private (self);
   gboolean notify_client = FALSE;
   gboolean notify_supervisor = FALSE;
+  gboolean shared = FALSE;
 
   IDE_ENTRY;
 
@@ -72,22 +76,38 @@ ide_lsp_service_stop (IdeLspService *self)
   if (priv->has_started)
     g_debug ("Stopping LSP client %s", G_OBJECT_TYPE_NAME (self));
 
+  /* If the server is used by other projects it must keep running, in
+   * which case we only drop our references to it.
+   */
+  if (priv->pool_key != NULL)
+    shared = ide_lsp_pool_release (ide_lsp_pool_get_default (), self) || priv->is_guest;
+
   if (priv->client != NULL)
     {
-      ide_lsp_client_stop (priv->client);
-      ide_object_destroy (IDE_OBJECT (priv->client));
-      priv->client = NULL;
+      if (shared)
+        {
+          g_clear_object (&priv->client);
+        }
+      else
+        {
+          ide_lsp_client_stop (priv->client);
+          ide_object_destroy (IDE_OBJECT (priv->client));
+          priv->client = NULL;
+        }
       notify_client = TRUE;
     }
 
   if (priv->supervisor != NULL)
     {
-      ide_subprocess_supervisor_stop (priv->supervisor);
+      if (!shared)
+        ide_subprocess_supervisor_stop (priv->supervisor);
       g_clear_object (&priv->supervisor);
       notify_supervisor = TRUE;
     }
 
+  g_clear_pointer (&priv->pool_key, g_free);
   priv->has_started = FALSE;
+  priv->is_guest = FALSE;
 
   if (notify_client)
     g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_CLIENT]);
@@ -182,6 +202,51 @@ ide_lsp_service_destroy (IdeObject *object)
   IDE_EXIT;
 }
 
+static char *
+ide_lsp_service_repr (IdeObject *object)
+{
+  IdeLspService *self = (IdeLspService *)object;
+  IdeLspServicePrivate *priv = ide_lsp_service_get_instance_private (self);
+  IdeSubprocessSupervisor *supervisor = priv->supervisor;
+  IdeSubprocess *subprocess;
+  const char *identifier;
+  guint n_projects = 0;
+  GString *str;
+
+  g_assert (IDE_IS_LSP_SERVICE (self));
+
+  str = g_string_new (G_OBJECT_TYPE_NAME (self));
+
+  if (priv->program != NULL)
+    g_string_append_printf (str, " program=\"%s\"", priv->program);
+
+  if (priv->pool_key != NULL)
+    {
+      IdeSubprocessSupervisor *pooled;
+
+      if ((pooled = ide_lsp_pool_get_supervisor (ide_lsp_pool_get_default (), self, &n_projects)))
+        supervisor = pooled;
+    }
+
+  if (supervisor != NULL &&
+      (subprocess = ide_subprocess_supervisor_get_subprocess (supervisor)) &&
+      (identifier = ide_subprocess_get_identifier (subprocess)))
+    {
+      guint64 rss = ide_lsp_pool_read_rss (identifier);
+
+      g_string_append_printf (str, " pid=%s", identifier);
+
+      if (rss > 0)
+        g_string_append_printf (str, " rss=%"G_GUINT64_FORMAT"kB", rss);
+    }
+
+  if (n_projects > 0)
+    g_string_append_printf (str, " shared=%s projects=%u",
+                            priv->is_guest ? "guest" : "owner", n_projects);
+
+  return g_string_free (str, FALSE);
+}
+
 static void
 ide_lsp_service_prepare_tooling (IdeLspService *self,
                                  IdeRunContext *run_context)
@@ -373,6 +438,7 @@ ide_lsp_service_class_init (IdeLspServiceClass *klass)
   object_class->set_property = ide_lsp_service_set_property;
 
   ide_object_class->destroy = ide_lsp_service_destroy;
+  ide_object_class->repr = ide_lsp_service_repr;
 
   service_class->configure_client = ide_lsp_service_real_configure_client;
   service_class->configure_supervisor = ide_lsp_service_real_configure_supervisor;
@@ -544,6 +610,10 @@ on_supervisor_spawned_cb (IdeLspService           *self,
   to_stdout = ide_subprocess_get_stdout_pipe (subprocess);
   iostream = g_simple_io_stream_new (to_stdout, to_stdin);
 
+  /* Guests of a previous process cannot continue with the new one */
+  if (priv->pool_key != NULL)
+    ide_lsp_pool_remove (ide_lsp_pool_get_default (), self);
+
   if (priv->client != NULL)
     {
       ide_lsp_client_stop (priv->client);
@@ -563,6 +633,9 @@ on_supervisor_spawned_cb (IdeLspService           *self,
 
   ide_lsp_client_start (client);
 
+  if (priv->pool_key != NULL)
+    ide_lsp_pool_add (ide_lsp_pool_get_default (), priv->pool_key, self, supervisor, client);
+
   priv->client = g_steal_pointer (&client);
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_CLIENT]);
 
@@ -577,6 +650,7 @@ ensure_started (IdeLspService *self,
   g_autoptr(IdeSubprocessLauncher) launcher = NULL;
   g_autoptr(IdeSubprocessSupervisor) supervisor = NULL;
   g_autoptr(GSettings) settings = NULL;
+  g_autofree char *pool_key = NULL;
   IdeBuildManager *build_manager;
   IdeLspServiceClass *klass;
   IdePipeline *pipeline = NULL;
@@ -611,6 +685,31 @@ ensure_started (IdeLspService *self,
   if (!(launcher = ide_lsp_service_create_launcher (self, pipeline, flags)))
     IDE_EXIT;
 
+  /* Try to reuse a compatible server from another project first */
+  if (g_settings_get_boolean (settings, "lsp-share-servers"))
+    {
+      g_autoptr(IdeSubprocessSupervisor) adopted = NULL;
+      g_autoptr(IdeLspClient) client = NULL;
+
+      pool_key = ide_lsp_pool_make_key (G_OBJECT_TYPE (self), launcher);
+
+      if ((client = ide_lsp_pool_acquire (ide_lsp_pool_get_default (), pool_key, self, &adopted)))
+        {
+          priv->has_started = TRUE;
+          priv->pool_key = g_steal_pointer (&pool_key);
+          priv->client = g_steal_pointer (&client);
+
+          if (adopted != NULL)
+            _ide_lsp_service_take_over (self, adopted);
+          else
+            priv->is_guest = TRUE;
+
+          g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_CLIENT]);
+
+          IDE_EXIT;
+        }
+    }
+
   supervisor = ide_subprocess_supervisor_new ();
   ide_subprocess_supervisor_set_launcher (supervisor, launcher);
   g_signal_connect_object (supervisor,
@@ -625,6 +724,7 @@ ensure_started (IdeLspService *self,
                            G_CONNECT_SWAPPED);
 
   priv->has_started = TRUE;
+  priv->pool_key = g_steal_pointer (&pool_key);
 
   klass->configure_supervisor (self, supervisor);
   ide_subprocess_supervisor_start (supervisor);
@@ -655,6 +755,9 @@ ide_lsp_service_restart (IdeLspService *self)
   g_debug ("Request to restart LSP service %s",
            G_OBJECT_TYPE_NAME (self));
 
+  /* Really restart the process even if other projects share it */
+  ide_lsp_pool_remove (ide_lsp_pool_get_default (), self);
+
   ide_lsp_service_stop (self);
 
   if ((context = ide_object_get_context (IDE_OBJECT (self))))
@@ -663,6 +766,46 @@ ide_lsp_service_restart (IdeLspService *self)
   IDE_EXIT;
 }
 
+/**
+ * _ide_lsp_service_take_over:
+ * @self: a [class@LspService]
+ * @supervisor: the supervisor of a shared language server
+ *
+ * Makes @self the owner of a shared language server whose client has
+ * already been added to @self by the pool.
+ */
+void
+_ide_lsp_service_take_over (IdeLspService           *self,
+                            IdeSubprocessSupervisor *supervisor)
+{
+  IdeLspServicePrivate *priv = ide_lsp_service_get_instance_private (self);
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+  g_return_if_fail (IDE_IS_LSP_SERVICE (self));
+  g_return_if_fail (IDE_IS_SUBPROCESS_SUPERVISOR (supervisor));
+  g_return_if_fail (priv->supervisor == NULL);
+
+  priv->is_guest = FALSE;
+  priv->supervisor = g_object_ref (supervisor);
+
+  g_signal_connect_object (supervisor,
+                           "spawned",
+                           G_CALLBACK (on_supervisor_spawned_cb),
+                           self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (supervisor,
+                           "exited",
+                           G_CALLBACK (on_supervisor_exited_cb),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_SUPERVISOR]);
+
+  IDE_EXIT;
+}
+
 static void
 on_pipeline_loaded_cb (IdeLspService *self,
                        IdePipeline   *pipeline)
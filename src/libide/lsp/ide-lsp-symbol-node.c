@@ -99,6 +99,26 @@ ide_lsp_symbol_node_get_location_finish (IdeSymbolNode  *node,
   IDE_RETURN (ret);
 }
 
+static gboolean
+ide_lsp_symbol_node_get_range (IdeSymbolNode *node,
+                               guint         *begin_line,
+                               guint         *begin_line_offset,
+                               guint         *end_line,
+                               guint         *end_line_offset)
+{
+  IdeLspSymbolNode *self = (IdeLspSymbolNode *)node;
+  IdeLspSymbolNodePrivate *priv = ide_lsp_symbol_node_get_instance_private (self);
+
+  g_assert (IDE_IS_LSP_SYMBOL_NODE (node));
+
+  *begin_line = priv->begin.line;
+  *begin_line_offset = priv->begin.column;
+  *end_line = priv->end.line;
+  *end_line_offset = priv->end.column;
+
+  return TRUE;
+}
+
 static void
 ide_lsp_symbol_node_finalize (GObject *object)
 {
@@ -121,6 +141,7 @@ ide_lsp_symbol_node_class_init (IdeLspSymbolNodeClass *klass)
 
   symbol_node_class->get_location_async = ide_lsp_symbol_node_get_location_async;
   symbol_node_class->get_location_finish = ide_lsp_symbol_node_get_location_finish;
+  symbol_node_class->get_range = ide_lsp_symbol_node_get_range;
 }
 
 static void
@@ -34,30 +34,57 @@
 
 #define DEFAULT_MAX_RESULTS 100
 
+/* How long we wait for providers before publishing the results we have.
+ * Providers which complete later are merged into the published results.
+ */
+#define DEFAULT_DEADLINE_MSEC 100
+#define MIN_DEADLINE_MSEC     25
+#define MAX_DEADLINE_MSEC     250
+
 struct _IdeSearchEngine
 {
   IdeObject               parent_instance;
   IdeExtensionSetAdapter *extensions;
   GPtrArray              *custom_provider;
+  GHashTable             *stats;
+  GPtrArray              *requests;
   guint                   active_count;
   GListStore             *list;
 };
 
+typedef struct
+{
+  guint  n_searches;
+  guint  n_late;
+  guint  n_failed;
+  gint64 total_usec;
+  gint64 max_usec;
+  gint64 expected_usec;
+} ProviderStats;
+
 typedef struct
 {
   IdeSearchProvider *provider;
   GListModel        *results;
+  gint64             begin_time;
   guint              truncated : 1;
+  guint              done : 1;
+  guint              in_store : 1;
 } SortInfo;
 
 typedef struct
 {
+  IdeSearchEngine   *self;
   IdeTask           *task;
+  GCancellable      *cancellable;
+  GListStore        *store;
   char              *query;
   GArray            *sorted;
   IdeSearchCategory  category;
   guint              outstanding;
   guint              max_results;
+  guint              deadline_msec;
+  guint              deadline_source;
 } Request;
 
 enum {
@@ -80,27 +107,83 @@ sort_info_clear (gpointer item)
 }
 
 static Request *
-request_new (void)
+request_new (IdeSearchEngine *self)
 {
   Request *r;
 
-  r = g_slice_new0 (Request);
-  r->outstanding = 0;
-  r->query = NULL;
+  r = g_atomic_rc_box_new0 (Request);
+  r->self = g_object_ref (self);
+  r->cancellable = g_cancellable_new ();
+  r->store = g_list_store_new (G_TYPE_LIST_MODEL);
   r->sorted = g_array_new (FALSE, FALSE, sizeof (SortInfo));
   g_array_set_clear_func (r->sorted, sort_info_clear);
 
   return r;
 }
 
+static Request *
+request_ref (Request *r)
+{
+  return g_atomic_rc_box_acquire (r);
+}
+
 static void
-request_destroy (Request *r)
+request_finalize (gpointer data)
 {
+  Request *r = data;
+
   g_assert (r->outstanding == 0);
+  g_assert (r->deadline_source == 0);
+
+  g_clear_object (&r->self);
+  g_clear_object (&r->task);
+  g_clear_object (&r->cancellable);
+  g_clear_object (&r->store);
   g_clear_pointer (&r->query, g_free);
   g_clear_pointer (&r->sorted, g_array_unref);
-  r->task = NULL;
-  g_slice_free (Request, r);
+}
+
+static void
+request_unref (Request *r)
+{
+  g_atomic_rc_box_release_full (r, request_finalize);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (Request, request_unref)
+
+static guint
+provider_stats_get_deadline_msec (const ProviderStats *stats)
+{
+  if (stats == NULL || stats->n_searches == 0)
+    return DEFAULT_DEADLINE_MSEC;
+
+  /* Give providers which are usually quick a bit of slack, but don't
+   * hold back everything else for providers which are always slow.
+   */
+  return CLAMP (stats->expected_usec * 3 / 2 / 1000, MIN_DEADLINE_MSEC, MAX_DEADLINE_MSEC);
+}
+
+static ProviderStats *
+ide_search_engine_get_stats (IdeSearchEngine   *self,
+                             IdeSearchProvider *provider)
+{
+  const char *type_name = G_OBJECT_TYPE_NAME (provider);
+  ProviderStats *stats;
+
+  g_assert (IDE_IS_SEARCH_ENGINE (self));
+  g_assert (IDE_IS_SEARCH_PROVIDER (provider));
+
+  /* Providers may complete after the engine was destroyed */
+  if (self->stats == NULL)
+    return NULL;
+
+  if (!(stats = g_hash_table_lookup (self->stats, type_name)))
+    {
+      stats = g_new0 (ProviderStats, 1);
+      g_hash_table_insert (self->stats, (char *)type_name, stats);
+    }
+
+  return stats;
 }
 
 static void
@@ -192,8 +275,23 @@ ide_search_engine_destroy (IdeObject *object)
 {
   IdeSearchEngine *self = (IdeSearchEngine *)object;
 
+  /* Stop the providers which are still running, their results are
+   * no longer wanted.
+   */
+  if (self->requests != NULL)
+    {
+      for (guint i = 0; i < self->requests->len; i++)
+        {
+          Request *r = g_ptr_array_index (self->requests, i);
+
+          g_cancellable_cancel (r->cancellable);
+        }
+    }
+
+  g_clear_pointer (&self->requests, g_ptr_array_unref);
   g_clear_object (&self->extensions);
   g_clear_pointer (&self->custom_provider, g_ptr_array_unref);
+  g_clear_pointer (&self->stats, g_hash_table_unref);
   g_clear_object (&self->list);
 
   IDE_OBJECT_CLASS (ide_search_engine_parent_class)->destroy (object);
@@ -243,6 +341,8 @@ static void
 ide_search_engine_init (IdeSearchEngine *self)
 {
   self->custom_provider = g_ptr_array_new_with_free_func (g_object_unref);
+  self->stats = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+  self->requests = g_ptr_array_new_with_free_func ((GDestroyNotify)request_unref);
   self->list = g_list_store_new (IDE_TYPE_SEARCH_PROVIDER);
 }
 
@@ -268,77 +368,199 @@ ide_search_engine_get_busy (IdeSearchEngine *self)
   return self->active_count > 0;
 }
 
+static void
+request_publish (Request *r)
+{
+  g_autoptr(GtkFlattenListModel) flatten = NULL;
+  g_autoptr(IdeTask) task = NULL;
+  gboolean truncated = FALSE;
+
+  g_assert (r != NULL);
+  g_assert (IDE_IS_TASK (r->task));
+
+  task = g_steal_pointer (&r->task);
+
+  g_clear_handle_id (&r->deadline_source, g_source_remove);
+
+  for (guint i = 0; i < r->sorted->len; i++)
+    {
+      SortInfo *info = &g_array_index (r->sorted, SortInfo, i);
+
+      if (info->results != NULL)
+        {
+          g_list_store_append (r->store, info->results);
+          info->in_store = TRUE;
+        }
+
+      truncated |= info->truncated;
+    }
+
+  /* Results which are still to come would be missed by refiltering */
+  if (r->outstanding > 0)
+    truncated = TRUE;
+
+  flatten = gtk_flatten_list_model_new (G_LIST_MODEL (g_object_ref (r->store)));
+
+  ide_task_return_pointer (task,
+                           _ide_search_results_new (G_LIST_MODEL (flatten), r->query, truncated),
+                           g_object_unref);
+}
+
+static void
+request_merge_late (Request  *r,
+                    SortInfo *info)
+{
+  guint position = 0;
+
+  g_assert (r != NULL);
+  g_assert (info != NULL);
+  g_assert (info->results != NULL);
+  g_assert (!info->in_store);
+
+  /* Keep the order of providers stable no matter when they complete so
+   * that rows which are already visible are not shuffled around.
+   */
+  for (guint i = 0; i < r->sorted->len; i++)
+    {
+      const SortInfo *other = &g_array_index (r->sorted, SortInfo, i);
+
+      if (other == info)
+        break;
+
+      if (other->in_store)
+        position++;
+    }
+
+  g_list_store_insert (r->store, position, info->results);
+  info->in_store = TRUE;
+}
+
+static gboolean
+request_deadline_cb (gpointer data)
+{
+  Request *r = data;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (r != NULL);
+
+  r->deadline_source = 0;
+
+  if (r->task == NULL)
+    return G_SOURCE_REMOVE;
+
+  for (guint i = 0; i < r->sorted->len; i++)
+    {
+      const SortInfo *info = &g_array_index (r->sorted, SortInfo, i);
+
+      if (!info->done)
+        g_debug ("%s missed the %ums search deadline, results will be merged late",
+                 G_OBJECT_TYPE_NAME (info->provider), r->deadline_msec);
+    }
+
+  request_publish (r);
+
+  return G_SOURCE_REMOVE;
+}
+
 static void
 ide_search_engine_search_cb (GObject      *object,
                              GAsyncResult *result,
                              gpointer      user_data)
 {
   IdeSearchProvider *provider = (IdeSearchProvider *)object;
-  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(Request) r = user_data;
   g_autoptr(GError) error = NULL;
-  Request *r;
+  IdeSearchEngine *self;
 
   g_assert (IDE_IS_SEARCH_PROVIDER (provider));
   g_assert (G_IS_ASYNC_RESULT (result));
-  g_assert (IDE_IS_TASK (task));
-
-  r = ide_task_get_task_data (task);
   g_assert (r != NULL);
-  g_assert (r->task == task);
   g_assert (r->outstanding > 0);
 
+  self = r->self;
+
   for (guint i = 0; i < r->sorted->len; i++)
     {
       SortInfo *info = &g_array_index (r->sorted, SortInfo, i);
+      ProviderStats *stats;
       gboolean truncated = FALSE;
+      gint64 duration;
 
       if (info->provider != provider)
         continue;
 
       g_assert (info->results == NULL);
+      g_assert (!info->done);
+
+      info->done = TRUE;
+      duration = g_get_monotonic_time () - info->begin_time;
+      stats = ide_search_engine_get_stats (self, provider);
 
       if (!(info->results = ide_search_provider_search_finish (provider, result, &truncated, &error)))
         {
           IDE_TRACE_MSG ("%s: %s", G_OBJECT_TYPE_NAME (provider), error->message);
 
           if (!ide_error_ignore (error))
-            g_warning ("%s", error->message);
+            {
+              g_warning ("%s", error->message);
+
+              if (stats != NULL)
+                stats->n_failed++;
+            }
         }
 
       info->truncated = info->results != NULL && truncated;
 
+      /* Cancelled searches would make the provider look faster than it is */
+      if (stats != NULL && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          stats->n_searches++;
+          stats->total_usec += duration;
+          stats->max_usec = MAX (stats->max_usec, duration);
+
+          if (stats->n_searches == 1)
+            stats->expected_usec = duration;
+          else
+            stats->expected_usec = (stats->expected_usec * 7 + duration) / 8;
+
+          if (r->task == NULL)
+            stats->n_late++;
+        }
+
 #ifdef IDE_ENABLE_TRACE
       if (info->results != NULL)
-        IDE_TRACE_MSG ("%s: %d results%s",
+        IDE_TRACE_MSG ("%s: %d results%s in %"G_GINT64_FORMAT"usec",
                        G_OBJECT_TYPE_NAME (provider),
                        g_list_model_get_n_items (info->results),
-                       info->truncated ? " [truncated]" : "");
+                       info->truncated ? " [truncated]" : "",
+                       duration);
 #endif
 
+      if (r->task == NULL && info->results != NULL)
+        request_merge_late (r, info);
+
       break;
     }
 
   r->outstanding--;
 
-  if (r->outstanding == 0)
+  if (self->active_count > 0)
     {
-      g_autoptr(GListStore) store = g_list_store_new (G_TYPE_LIST_MODEL);
-      g_autoptr(GtkFlattenListModel) flatten = gtk_flatten_list_model_new (G_LIST_MODEL (g_object_ref (store)));
-      gboolean truncated = FALSE;
+      self->active_count--;
 
-      for (guint i = 0; i < r->sorted->len; i++)
-        {
-          SortInfo *info = &g_array_index (r->sorted, SortInfo, i);
+      if (self->active_count == 0)
+        g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_BUSY]);
+    }
 
-          if (info->results != NULL)
-            g_list_store_append (store, info->results);
+  if (r->outstanding == 0)
+    {
+      g_clear_handle_id (&r->deadline_source, g_source_remove);
 
-          truncated |= info->truncated;
-        }
+      if (self->requests != NULL)
+        g_ptr_array_remove_fast (self->requests, r);
 
-      ide_task_return_pointer (task,
-                               _ide_search_results_new (G_LIST_MODEL (flatten), r->query, truncated),
-                               g_object_unref);
+      if (r->task != NULL)
+        request_publish (r);
     }
 }
 
@@ -346,7 +568,8 @@ static void
 _provider_search_async (IdeSearchProvider *provider,
                         Request           *r)
 {
-  SortInfo sort_info;
+  SortInfo sort_info = {0};
+  ProviderStats *stats;
 
   g_assert (IDE_IS_SEARCH_PROVIDER (provider));
   g_assert (r != NULL);
@@ -358,16 +581,19 @@ _provider_search_async (IdeSearchProvider *provider,
 
   r->outstanding++;
 
+  stats = r->self->stats ? g_hash_table_lookup (r->self->stats, G_OBJECT_TYPE_NAME (provider)) : NULL;
+  r->deadline_msec = MAX (r->deadline_msec, provider_stats_get_deadline_msec (stats));
+
   sort_info.provider = g_object_ref (provider);
-  sort_info.results = NULL;
+  sort_info.begin_time = g_get_monotonic_time ();
   g_array_append_val (r->sorted, sort_info);
 
   ide_search_provider_search_async (provider,
                                     r->query,
                                     r->max_results,
-                                    ide_task_get_cancellable (r->task),
+                                    r->cancellable,
                                     ide_search_engine_search_cb,
-                                    g_object_ref (r->task));
+                                    request_ref (r));
 }
 
 static void
@@ -402,6 +628,26 @@ ide_search_engine_search_foreach_custom_provider (gpointer data,
   _provider_search_async (provider, r);
 }
 
+/**
+ * ide_search_engine_search_async:
+ * @self: a #IdeSearchEngine
+ * @category: the category of providers to query
+ * @query: the search query
+ * @max_results: the max number of results per provider, or 0
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @callback: a #GAsyncReadyCallback to execute upon completion
+ * @user_data: closure data for @callback
+ *
+ * Asynchronously queries the search providers.
+ *
+ * Rather than waiting for the slowest provider, the results are completed
+ * once every provider finished or a short deadline has passed. Providers
+ * which complete after that are merged into the #IdeSearchResults as they
+ * arrive, so the result set may continue to grow.
+ *
+ * Cancel @cancellable when the results are no longer needed so that the
+ * providers which are still running may stop.
+ */
 void
 ide_search_engine_search_async (IdeSearchEngine     *self,
                                 IdeSearchCategory    category,
@@ -412,7 +658,7 @@ ide_search_engine_search_async (IdeSearchEngine     *self,
                                 gpointer             user_data)
 {
   g_autoptr(IdeTask) task = NULL;
-  Request *r;
+  g_autoptr(Request) r = NULL;
 
   g_return_if_fail (IDE_IS_SEARCH_ENGINE (self));
   g_return_if_fail (query != NULL);
@@ -424,13 +670,14 @@ ide_search_engine_search_async (IdeSearchEngine     *self,
   ide_task_set_source_tag (task, ide_search_engine_search_async);
   ide_task_set_priority (task, G_PRIORITY_LOW);
 
-  r = request_new ();
+  r = request_new (self);
   r->category = category;
   r->query = g_strdup (query);
   r->max_results = max_results;
-  r->task = task;
-  r->outstanding = 0;
-  ide_task_set_task_data (task, r, request_destroy);
+  r->task = g_object_ref (task);
+
+  /* Stale provider searches are cancelled along with the request */
+  ide_cancellable_chain (r->cancellable, cancellable);
 
   g_ptr_array_foreach (self->custom_provider,
                        ide_search_engine_search_foreach_custom_provider,
@@ -439,10 +686,26 @@ ide_search_engine_search_async (IdeSearchEngine     *self,
                                                  ide_search_engine_search_foreach,
                                                  r);
 
-  self->active_count += r->outstanding;
+  if (r->sorted->len == 0)
+    {
+      g_clear_object (&r->task);
+      ide_task_return_unsupported_error (task);
+      return;
+    }
 
-  if (r->outstanding == 0)
-    ide_task_return_unsupported_error (task);
+  /* Providers may have completed synchronously */
+  if (r->task != NULL)
+    r->deadline_source = g_timeout_add_full (G_PRIORITY_DEFAULT,
+                                             r->deadline_msec,
+                                             request_deadline_cb,
+                                             request_ref (r),
+                                             (GDestroyNotify)request_unref);
+
+  /* Keep track of the request so it may be cancelled on destroy */
+  if (r->outstanding > 0)
+    g_ptr_array_add (self->requests, request_ref (r));
+
+  self->active_count += r->outstanding;
 
   g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_BUSY]);
 }
@@ -596,3 +859,54 @@ ide_search_engine_find_by_module_name (IdeSearchEngine *self,
 
   return IDE_SEARCH_PROVIDER (find.extension);
 }
+
+/**
+ * ide_search_engine_dup_statistics:
+ * @self: a #IdeSearchEngine
+ *
+ * Gets latency statistics for the search providers which have been
+ * queried so that slow providers may be found.
+ *
+ * The result is a dictionary of type `a{sa{sv}}` keyed by the type name
+ * of the provider. Each entry contains the number of "searches", how many
+ * were "late" to the deadline or "failed", and the "mean-usec",
+ * "max-usec" and "expected-usec" durations.
+ *
+ * Returns: (transfer full): a #GVariant
+ *
+ * Since: 50
+ */
+GVariant *
+ide_search_engine_dup_statistics (IdeSearchEngine *self)
+{
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  const char *type_name;
+  const ProviderStats *stats;
+
+  g_return_val_if_fail (IDE_IS_SEARCH_ENGINE (self), NULL);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sa{sv}}"));
+
+  if (self->stats == NULL)
+    return g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  g_hash_table_iter_init (&iter, self->stats);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&type_name, (gpointer *)&stats))
+    {
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("{sa{sv}}"));
+      g_variant_builder_add (&builder, "s", type_name);
+      g_variant_builder_open (&builder, G_VARIANT_TYPE_VARDICT);
+      g_variant_builder_add_parsed (&builder, "{'searches', <%u>}", stats->n_searches);
+      g_variant_builder_add_parsed (&builder, "{'late', <%u>}", stats->n_late);
+      g_variant_builder_add_parsed (&builder, "{'failed', <%u>}", stats->n_failed);
+      g_variant_builder_add_parsed (&builder, "{'mean-usec', <%x>}",
+                                    stats->n_searches ? stats->total_usec / stats->n_searches : 0);
+      g_variant_builder_add_parsed (&builder, "{'max-usec', <%x>}", stats->max_usec);
+      g_variant_builder_add_parsed (&builder, "{'expected-usec', <%x>}", stats->expected_usec);
+      g_variant_builder_close (&builder);
+      g_variant_builder_close (&builder);
+    }
+
+  return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
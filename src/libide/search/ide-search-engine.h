@@ -63,5 +63,7 @@ GListModel        *ide_search_engine_list_providers      (IdeSearchEngine      *
 IDE_AVAILABLE_IN_47
 IdeSearchProvider *ide_search_engine_find_by_module_name (IdeSearchEngine      *self,
                                                           const char           *module_name);
+IDE_AVAILABLE_IN_50
+GVariant          *ide_search_engine_dup_statistics      (IdeSearchEngine      *self);
 
 G_END_DECLS
@@ -22,6 +22,7 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <locale.h>
 #include <sched.h>
 #include <stdlib.h>
@@ -68,9 +69,21 @@ current_cpu (void)
 #endif
 }
 
+/* When recording to a file (rather than to the Sysprof instance that
+ * spawned us) everything goes through a single capture writer which is
+ * not thread-safe, so it is protected by @capture_mutex.
+ */
+static GMutex                capture_mutex;
+static SysprofCaptureWriter *capture_writer;
+static GArray               *capture_counter_ids;
+static gboolean              capture_to_collector;
+static gboolean              spawned_by_sysprof;
+
 static void
 trace_load (void)
 {
+  spawned_by_sysprof = g_getenv ("SYSPROF_TRACE_FD") != NULL;
+
   sysprof_clock_init ();
   sysprof_collector_init ();
 }
@@ -98,6 +111,190 @@ trace_log (GLogLevelFlags  log_level,
            const gchar    *message)
 {
   sysprof_collector_log (log_level, domain, message);
+
+  g_mutex_lock (&capture_mutex);
+  if (capture_writer != NULL)
+    sysprof_capture_writer_add_log (capture_writer,
+                                    SYSPROF_CAPTURE_CURRENT_TIME,
+                                    current_cpu (),
+                                    getpid (),
+                                    log_level,
+                                    domain,
+                                    message);
+  g_mutex_unlock (&capture_mutex);
+}
+
+static gboolean
+trace_begin_capture (const char  *filename,
+                     GError     **error)
+{
+  gboolean ret = TRUE;
+
+  g_mutex_lock (&capture_mutex);
+
+  g_assert (capture_writer == NULL);
+  g_assert (capture_counter_ids == NULL);
+
+  capture_counter_ids = g_array_new (FALSE, TRUE, sizeof (guint));
+
+  if (filename == NULL)
+    {
+      if (!(capture_to_collector = spawned_by_sysprof))
+        {
+          g_set_error_literal (error,
+                               G_IO_ERROR,
+                               G_IO_ERROR_NOT_SUPPORTED,
+                               "Builder was not started by Sysprof");
+          ret = FALSE;
+        }
+    }
+  else if (!(capture_writer = sysprof_capture_writer_new (filename, 0)))
+    {
+      int errsv = errno;
+
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errsv),
+                   "Failed to create capture %s: %s",
+                   filename, g_strerror (errsv));
+      ret = FALSE;
+    }
+
+  if (!ret)
+    g_clear_pointer (&capture_counter_ids, g_array_unref);
+
+  g_mutex_unlock (&capture_mutex);
+
+  return ret;
+}
+
+static void
+trace_end_capture (void)
+{
+  g_mutex_lock (&capture_mutex);
+
+  if (capture_writer != NULL)
+    {
+      sysprof_capture_writer_flush (capture_writer);
+      g_clear_pointer (&capture_writer, sysprof_capture_writer_unref);
+    }
+
+  g_clear_pointer (&capture_counter_ids, g_array_unref);
+  capture_to_collector = FALSE;
+
+  g_mutex_unlock (&capture_mutex);
+}
+
+static void
+trace_mark (gint64      begin_time_nsec,
+            gint64      duration_nsec,
+            const char *group,
+            const char *name,
+            const char *message)
+{
+  g_mutex_lock (&capture_mutex);
+
+  if (capture_writer != NULL)
+    sysprof_capture_writer_add_mark (capture_writer,
+                                     begin_time_nsec,
+                                     current_cpu (),
+                                     getpid (),
+                                     duration_nsec,
+                                     group,
+                                     name,
+                                     message);
+  else if (capture_to_collector)
+    sysprof_collector_mark (begin_time_nsec, duration_nsec, group, name, message);
+
+  g_mutex_unlock (&capture_mutex);
+}
+
+static void
+trace_define_counter (guint       id,
+                      const char *category,
+                      const char *name,
+                      const char *description)
+{
+  SysprofCaptureCounter counter = {0};
+
+  g_mutex_lock (&capture_mutex);
+
+  if (capture_counter_ids == NULL)
+    goto unlock;
+
+  /* Capture counter ids must be unique across every process in the
+   * capture, so map our ids onto ones handed out by the writer.
+   */
+  if (capture_writer != NULL)
+    counter.id = sysprof_capture_writer_request_counter (capture_writer, 1);
+  else if (capture_to_collector)
+    counter.id = sysprof_collector_request_counters (1);
+  else
+    goto unlock;
+
+  counter.type = SYSPROF_CAPTURE_COUNTER_INT64;
+  g_strlcpy (counter.category, category, sizeof counter.category);
+  g_strlcpy (counter.name, name, sizeof counter.name);
+  g_strlcpy (counter.description, description, sizeof counter.description);
+
+  if (capture_counter_ids->len < id)
+    g_array_set_size (capture_counter_ids, id);
+  g_array_index (capture_counter_ids, guint, id - 1) = counter.id;
+
+  if (capture_writer != NULL)
+    sysprof_capture_writer_define_counters (capture_writer,
+                                            SYSPROF_CAPTURE_CURRENT_TIME,
+                                            current_cpu (),
+                                            getpid (),
+                                            &counter,
+                                            1);
+  else
+    sysprof_collector_define_counters (&counter, 1);
+
+unlock:
+  g_mutex_unlock (&capture_mutex);
+}
+
+static void
+trace_set_counters (const guint  *ids,
+                    const gint64 *values,
+                    guint         n_values)
+{
+  g_autofree guint *capture_ids = g_new0 (guint, n_values);
+  g_autofree SysprofCaptureCounterValue *capture_values = g_new0 (SysprofCaptureCounterValue, n_values);
+  guint n = 0;
+
+  g_mutex_lock (&capture_mutex);
+
+  if (capture_counter_ids == NULL)
+    goto unlock;
+
+  for (guint i = 0; i < n_values; i++)
+    {
+      if (ids[i] == 0 || ids[i] > capture_counter_ids->len)
+        continue;
+
+      capture_ids[n] = g_array_index (capture_counter_ids, guint, ids[i] - 1);
+      capture_values[n].v64 = values[i];
+      n++;
+    }
+
+  if (n == 0)
+    goto unlock;
+
+  if (capture_writer != NULL)
+    sysprof_capture_writer_set_counters (capture_writer,
+                                         SYSPROF_CAPTURE_CURRENT_TIME,
+                                         current_cpu (),
+                                         getpid (),
+                                         capture_ids,
+                                         capture_values,
+                                         n);
+  else if (capture_to_collector)
+    sysprof_collector_set_counters (capture_ids, capture_values, n);
+
+unlock:
+  g_mutex_unlock (&capture_mutex);
 }
 
 static IdeTraceVTable trace_vtable = {
@@ -105,6 +302,11 @@ static IdeTraceVTable trace_vtable = {
   trace_unload,
   trace_function,
   trace_log,
+  trace_begin_capture,
+  trace_end_capture,
+  trace_mark,
+  trace_define_counter,
+  trace_set_counters,
 };
 #endif
 
@@ -122,7 +324,8 @@ static void
 early_params_check (gint       *argc,
                     gchar    ***argv,
                     gboolean   *standalone,
-                    gboolean   *version)
+                    gboolean   *version,
+                    char      **profile)
 {
   g_autoptr(GOptionContext) context = NULL;
   g_autoptr(GOptionGroup) gir_group = NULL;
@@ -130,6 +333,7 @@ early_params_check (gint       *argc,
     { "standalone", 's', 0, G_OPTION_ARG_NONE, standalone, N_("Run a new instance of Builder") },
     { "verbose", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK, verbose_cb },
     { "version", 'V', 0, G_OPTION_ARG_NONE, version },
+    { "profile", 0, 0, G_OPTION_ARG_FILENAME, profile, N_("Record counters and marks to a Sysprof capture"), N_("FILE") },
     { NULL }
   };
 
@@ -190,6 +394,7 @@ main (gint   argc,
       gchar *argv[])
 {
   g_autofree char *messages_debug = NULL;
+  g_autofree char *profile = NULL;
   IdeApplication *app;
   const gchar *desktop;
   gboolean standalone = FALSE;
@@ -232,7 +437,7 @@ main (gint   argc,
   ide_log_init (TRUE, NULL, messages_debug);
 
   /* Extract options like -vvvv */
-  early_params_check (&argc, &argv, &standalone, &version);
+  early_params_check (&argc, &argv, &standalone, &version, &profile);
 
   /* Log some info so it shows up in logs */
   g_message ("GNOME Builder %s (%s) from channel \"%s\" starting with ABI %s",
@@ -270,8 +475,22 @@ main (gint   argc,
 
 #ifdef ENABLE_TRACING_SYSCAP
   _ide_trace_init (&trace_vtable);
+
+  /* Export counters automatically when Sysprof spawned us so that
+   * "Allow Application Integration" just works.
+   */
+  if (profile == NULL && spawned_by_sysprof)
+    ide_profiler_start (NULL, NULL);
 #endif
 
+  if (profile != NULL)
+    {
+      g_autoptr(GError) error = NULL;
+
+      if (!ide_profiler_start (profile, &error))
+        g_warning ("Cannot record profile: %s", error->message);
+    }
+
   g_message ("Initializing with %s desktop and GTK+ %d.%d.%d.",
              desktop,
              gtk_get_major_version (),
@@ -312,6 +531,8 @@ main (gint   argc,
   /* Cleanup GtkSourceView singletons to improve valgrind output */
   gtk_source_finalize ();
 
+  ide_profiler_stop ();
+
 #ifdef ENABLE_TRACING_SYSCAP
   _ide_trace_shutdown ();
 #endif
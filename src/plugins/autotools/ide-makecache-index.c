@@ -0,0 +1,618 @@
+/* ide-makecache-index.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "ide-makecache-index"
+
+#include "config.h"
+
+#include <string.h>
+
+#include <libide-io.h>
+
+#include "ide-makecache-index.h"
+
+/*
+ * The index is built with a single pass over the output of `make -p`.
+ * Every object target (.o or .lo) is recorded along with the basenames
+ * of its prerequisites so that finding the targets for a file does not
+ * require scanning the database again. Targets are also grouped by the
+ * directory make must be run from so that flags may be extracted for a
+ * whole directory with a single dry-run.
+ */
+
+#define TOP_SUBDIR "."
+
+typedef struct
+{
+  /* NULL for the top directory, like IdeMakecacheTarget */
+  char      *subdir;
+  char      *target;
+  /* The first prerequisite that is compiled, as make knows it */
+  char      *source;
+  GPtrArray *prerequisites;
+} IndexEntry;
+
+struct _IdeMakecacheIndex
+{
+  GPtrArray  *entries;
+  /* Prerequisite basename to a GPtrArray of IndexEntry */
+  GHashTable *by_basename;
+  /* Subdir (or TOP_SUBDIR) to a GPtrArray of IndexEntry */
+  GHashTable *by_subdir;
+};
+
+static void
+index_entry_free (IndexEntry *entry)
+{
+  g_clear_pointer (&entry->subdir, g_free);
+  g_clear_pointer (&entry->target, g_free);
+  g_clear_pointer (&entry->source, g_free);
+  g_clear_pointer (&entry->prerequisites, g_ptr_array_unref);
+  g_slice_free (IndexEntry, entry);
+}
+
+static void
+ide_makecache_index_finalize (IdeMakecacheIndex *self)
+{
+  g_clear_pointer (&self->by_basename, g_hash_table_unref);
+  g_clear_pointer (&self->by_subdir, g_hash_table_unref);
+  g_clear_pointer (&self->entries, g_ptr_array_unref);
+}
+
+IdeMakecacheIndex *
+ide_makecache_index_ref (IdeMakecacheIndex *self)
+{
+  return g_atomic_rc_box_acquire (self);
+}
+
+void
+ide_makecache_index_unref (IdeMakecacheIndex *self)
+{
+  g_atomic_rc_box_release_full (self, (GDestroyNotify)ide_makecache_index_finalize);
+}
+
+static gboolean
+is_target_interesting (const char *target,
+                       gsize       len)
+{
+  return (len > 0 &&
+          target[0] != '#' &&
+          target[0] != '.' &&
+          memchr (target, '%', len) == NULL &&
+          ((len > 3 && memcmp (target + len - 3, ".lo", 3) == 0) ||
+           (len > 2 && memcmp (target + len - 2, ".o", 2) == 0)));
+}
+
+static gboolean
+is_source_compiled (const char *path)
+{
+  static const char *suffixes[] = {
+    ".c", ".cc", ".cpp", ".cxx", ".c++", ".C", ".m", ".mm", ".s", ".S", ".vala",
+  };
+  const char *dot = strrchr (path, '.');
+
+  if (dot == NULL)
+    return FALSE;
+
+  for (guint i = 0; i < G_N_ELEMENTS (suffixes); i++)
+    {
+      if (strcmp (dot, suffixes[i]) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static const char *
+get_basename (const char *path)
+{
+  const char *slash = strrchr (path, '/');
+
+  return slash ? slash + 1 : path;
+}
+
+static char *
+normalize_subdir (const char *subdir,
+                  gsize       len)
+{
+  if (subdir == NULL || len == 0 || subdir[0] == '.')
+    return NULL;
+
+  return g_strndup (subdir, len);
+}
+
+static IdeMakecacheIndex *
+ide_makecache_index_alloc (void)
+{
+  IdeMakecacheIndex *self;
+
+  self = g_atomic_rc_box_new0 (IdeMakecacheIndex);
+  self->entries = g_ptr_array_new_with_free_func ((GDestroyNotify)index_entry_free);
+  self->by_basename = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify)g_ptr_array_unref);
+  self->by_subdir = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify)g_ptr_array_unref);
+
+  return self;
+}
+
+static void
+add_to_table (GHashTable *table,
+              const char *key,
+              IndexEntry *entry)
+{
+  GPtrArray *ar;
+
+  if (!(ar = g_hash_table_lookup (table, key)))
+    {
+      ar = g_ptr_array_new ();
+      g_hash_table_insert (table, (char *)key, ar);
+    }
+
+  if (ar->len == 0 || g_ptr_array_index (ar, ar->len - 1) != entry)
+    g_ptr_array_add (ar, entry);
+}
+
+/* Builds the lookup tables once all entries are known. Keys point
+ * into the entries so the tables must be released first.
+ */
+static void
+ide_makecache_index_build_tables (IdeMakecacheIndex *self)
+{
+  for (guint i = 0; i < self->entries->len; i++)
+    {
+      IndexEntry *entry = g_ptr_array_index (self->entries, i);
+
+      add_to_table (self->by_subdir, entry->subdir ?: TOP_SUBDIR, entry);
+
+      for (guint j = 0; j < entry->prerequisites->len; j++)
+        add_to_table (self->by_basename, g_ptr_array_index (entry->prerequisites, j), entry);
+    }
+}
+
+static void
+index_entry_add_prerequisite (IndexEntry *entry,
+                              const char *word,
+                              gsize       len)
+{
+  g_autofree char *path = g_strndup (word, len);
+  const char *basename = get_basename (path);
+
+  if (entry->source == NULL && is_source_compiled (path))
+    entry->source = g_strdup (path);
+
+  for (guint i = 0; i < entry->prerequisites->len; i++)
+    {
+      if (strcmp (g_ptr_array_index (entry->prerequisites, i), basename) == 0)
+        return;
+    }
+
+  g_ptr_array_add (entry->prerequisites, g_strdup (basename));
+}
+
+/**
+ * ide_makecache_index_new:
+ * @contents: the output of `make -p`
+ * @len: the length of @contents
+ *
+ * Parses the make database and indexes the object targets found.
+ *
+ * Like the lookups it replaces, "subdir = " assignments are tracked
+ * to know which directory a rule belongs to.
+ *
+ * Returns: (transfer full): an #IdeMakecacheIndex
+ */
+IdeMakecacheIndex *
+ide_makecache_index_new (const char *contents,
+                         gsize       len)
+{
+  g_autoptr(GHashTable) seen = NULL;
+  g_autofree char *subdir = NULL;
+  IdeMakecacheIndex *self;
+  IdeLineReader reader;
+  const char *line;
+  gsize line_len;
+
+  g_return_val_if_fail (contents != NULL || len == 0, NULL);
+
+  self = ide_makecache_index_alloc ();
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  ide_line_reader_init (&reader, (char *)contents, len);
+
+  while ((line = ide_line_reader_next (&reader, &line_len)))
+    {
+      g_autofree char *key = NULL;
+      const char *colon;
+      const char *iter;
+      const char *end = line + line_len;
+      IndexEntry *entry;
+
+      if (line_len > 9 && memcmp (line, "subdir = ", 9) == 0)
+        {
+          g_free (subdir);
+          subdir = normalize_subdir (line + 9, line_len - 9);
+          continue;
+        }
+
+      /* Recipes, comments and special targets */
+      if (line_len == 0 || line[0] == '\t' || line[0] == ' ' || line[0] == '#' || line[0] == '.')
+        continue;
+
+      if (!(colon = memchr (line, ':', line_len)) ||
+          memchr (line, ' ', colon - line) != NULL ||
+          !is_target_interesting (line, colon - line))
+        continue;
+
+      /* Skip "::" rules, ":=" and target-specific variables */
+      if (colon + 1 < end && (colon[1] == ':' || colon[1] == '='))
+        continue;
+      if (memchr (colon, '=', end - colon) != NULL)
+        continue;
+
+      key = g_strdup_printf ("%s:%.*s", subdir ?: TOP_SUBDIR, (int)(colon - line), line);
+
+      if (!(entry = g_hash_table_lookup (seen, key)))
+        {
+          entry = g_slice_new0 (IndexEntry);
+          entry->subdir = g_strdup (subdir);
+          entry->target = g_strndup (line, colon - line);
+          entry->prerequisites = g_ptr_array_new_with_free_func (g_free);
+          g_ptr_array_add (self->entries, entry);
+          g_hash_table_insert (seen, g_steal_pointer (&key), entry);
+        }
+
+      iter = colon + 1;
+
+      while (iter < end)
+        {
+          const char *word;
+
+          while (iter < end && (*iter == ' ' || *iter == '\t'))
+            iter++;
+
+          word = iter;
+
+          while (iter < end && *iter != ' ' && *iter != '\t')
+            iter++;
+
+          /* Order-only prerequisites follow "|" */
+          if (iter > word && !(iter - word == 1 && *word == '|'))
+            index_entry_add_prerequisite (entry, word, iter - word);
+        }
+    }
+
+  ide_makecache_index_build_tables (self);
+
+  return self;
+}
+
+/**
+ * ide_makecache_index_new_from_variant:
+ * @variant: a #GVariant from ide_makecache_index_to_variant()
+ *
+ * Returns: (transfer full) (nullable): an #IdeMakecacheIndex or %NULL
+ *   if @variant is not in the expected format
+ */
+IdeMakecacheIndex *
+ide_makecache_index_new_from_variant (GVariant *variant)
+{
+  g_autoptr(GVariantIter) iter = NULL;
+  g_autofree const char **prerequisites = NULL;
+  IdeMakecacheIndex *self;
+  const char *subdir;
+  const char *target;
+  const char *source;
+
+  g_return_val_if_fail (variant != NULL, NULL);
+
+  if (!g_variant_is_of_type (variant, G_VARIANT_TYPE ("a(sssas)")))
+    return NULL;
+
+  self = ide_makecache_index_alloc ();
+
+  g_variant_get (variant, "a(sssas)", &iter);
+
+  while (g_variant_iter_next (iter, "(&s&s&s^a&s)", &subdir, &target, &source, &prerequisites))
+    {
+      IndexEntry *entry = g_slice_new0 (IndexEntry);
+
+      entry->subdir = normalize_subdir (subdir, strlen (subdir));
+      entry->target = g_strdup (target);
+      entry->source = source[0] ? g_strdup (source) : NULL;
+      entry->prerequisites = g_ptr_array_new_with_free_func (g_free);
+
+      for (guint i = 0; prerequisites[i]; i++)
+        g_ptr_array_add (entry->prerequisites, g_strdup (prerequisites[i]));
+
+      g_ptr_array_add (self->entries, entry);
+
+      g_clear_pointer (&prerequisites, g_free);
+    }
+
+  ide_makecache_index_build_tables (self);
+
+  return self;
+}
+
+/**
+ * ide_makecache_index_to_variant:
+ * @self: an #IdeMakecacheIndex
+ *
+ * Serializes @self so that it may be stored next to the makecache and
+ * loaded again with ide_makecache_index_new_from_variant().
+ *
+ * Returns: (transfer full): a floating #GVariant
+ */
+GVariant *
+ide_makecache_index_to_variant (IdeMakecacheIndex *self)
+{
+  GVariantBuilder builder;
+
+  g_return_val_if_fail (self != NULL, NULL);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sssas)"));
+
+  for (guint i = 0; i < self->entries->len; i++)
+    {
+      const IndexEntry *entry = g_ptr_array_index (self->entries, i);
+
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("(sssas)"));
+      g_variant_builder_add (&builder, "s", entry->subdir ?: "");
+      g_variant_builder_add (&builder, "s", entry->target);
+      g_variant_builder_add (&builder, "s", entry->source ?: "");
+      g_variant_builder_add_value (&builder,
+                                   g_variant_new_strv ((const char * const *)entry->prerequisites->pdata,
+                                                       entry->prerequisites->len));
+      g_variant_builder_close (&builder);
+    }
+
+  return g_variant_builder_end (&builder);
+}
+
+guint
+ide_makecache_index_get_n_targets (IdeMakecacheIndex *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->entries->len;
+}
+
+/**
+ * ide_makecache_index_lookup:
+ * @self: an #IdeMakecacheIndex
+ * @path: the path of a file, only the basename is used
+ *
+ * Gets the targets which have a file named like @path as prerequisite.
+ *
+ * Returns: (transfer container) (nullable) (element-type IdeMakecacheTarget):
+ *   new targets which the caller may modify, or %NULL
+ */
+GPtrArray *
+ide_makecache_index_lookup (IdeMakecacheIndex *self,
+                            const char        *path)
+{
+  g_autofree char *basename = NULL;
+  GPtrArray *entries;
+  GPtrArray *ret;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+
+  basename = g_path_get_basename (path);
+
+  if (!(entries = g_hash_table_lookup (self->by_basename, basename)))
+    return NULL;
+
+  ret = g_ptr_array_new_with_free_func ((GDestroyNotify)ide_makecache_target_unref);
+
+  for (guint i = 0; i < entries->len; i++)
+    {
+      const IndexEntry *entry = g_ptr_array_index (entries, i);
+
+      g_ptr_array_add (ret, ide_makecache_target_new (entry->subdir, entry->target));
+    }
+
+  return ret;
+}
+
+/**
+ * ide_makecache_index_get_dry_run:
+ * @self: an #IdeMakecacheIndex
+ * @subdir: (nullable): the directory as returned from
+ *   ide_makecache_target_get_subdir()
+ * @targets: a #GPtrArray with g_free() as free func for the targets
+ * @sources: a #GPtrArray with g_free() as free func for the sources
+ *
+ * Collects every object target of @subdir along with the source to
+ * pass to make with -W for each of them, so that a single `make -n`
+ * prints the commands for the whole directory. @sources is filled in
+ * parallel to @targets and contains %NULL when the source of a target
+ * is unknown.
+ *
+ * Returns: %TRUE if @subdir contains targets
+ */
+gboolean
+ide_makecache_index_get_dry_run (IdeMakecacheIndex *self,
+                                 const char        *subdir,
+                                 GPtrArray         *targets,
+                                 GPtrArray         *sources)
+{
+  GPtrArray *entries;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (targets != NULL, FALSE);
+  g_return_val_if_fail (sources != NULL, FALSE);
+
+  if (!(entries = g_hash_table_lookup (self->by_subdir, subdir ?: TOP_SUBDIR)))
+    return FALSE;
+
+  for (guint i = 0; i < entries->len; i++)
+    {
+      const IndexEntry *entry = g_ptr_array_index (entries, i);
+
+      g_ptr_array_add (targets, g_strdup (entry->target));
+      g_ptr_array_add (sources, g_strdup (entry->source));
+    }
+
+  return TRUE;
+}
+
+static gboolean
+line_has_word (const char *line,
+               const char *word)
+{
+  gsize len = strlen (word);
+  const char *iter = line;
+
+  while ((iter = strstr (iter, word)))
+    {
+      char before = iter == line ? ' ' : iter[-1];
+      char after = iter[len];
+
+      /* Sources may be quoted by libtool rules or prefixed by a directory */
+      if (strchr (" \t/'\"`", before) && (after == '\0' || strchr (" \t'\"`;", after)))
+        return TRUE;
+
+      iter++;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+command_has_output (const char *command,
+                    const char *target)
+{
+  gsize len = strlen (target);
+  const char *iter = command;
+
+  while ((iter = strstr (iter, "-o")))
+    {
+      const char *out = iter + 2;
+      const char *out_end;
+
+      if (iter != command && !strchr (" \t", iter[-1]))
+        {
+          iter += 2;
+          continue;
+        }
+
+      iter += 2;
+
+      /* Both "-o target" and "-otarget", maybe quoted or with a directory */
+      while (*out == ' ' || *out == '\t')
+        out++;
+      if (*out == '\'' || *out == '"')
+        out++;
+
+      out_end = out + strcspn (out, " \t'\"`;");
+
+      if ((gsize)(out_end - out) >= len &&
+          memcmp (out_end - len, target, len) == 0 &&
+          (out_end - len == out || out_end[-(gssize)len - 1] == '/'))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/**
+ * ide_makecache_match_commands:
+ * @commands: the compile commands printed by a dry-run, one per element
+ * @targets: the targets passed to the dry-run
+ * @sources: the source of each target, or %NULL
+ * @begin: the first target of the dry-run
+ * @end: the end of the targets of the dry-run
+ * @matches: (out caller-allocates): location for @end - @begin indexes
+ *   into @commands, or -1 for targets without a command
+ *
+ * Finds the command which builds each target. Commands are matched by
+ * the object they write with -o first, since with per-target flags
+ * automake compiles the same source once per target, for example into
+ * `libx_la-foo.lo` and `liby_la-foo.lo`. Targets which are not the
+ * output of any command, such as vala stamp files, fall back to the
+ * first command mentioning their source, preferring commands which
+ * do not build another of @targets.
+ */
+void
+ide_makecache_match_commands (GPtrArray *commands,
+                              GPtrArray *targets,
+                              GPtrArray *sources,
+                              guint      begin,
+                              guint      end,
+                              int       *matches)
+{
+  g_autofree gboolean *claimed = NULL;
+
+  g_return_if_fail (commands != NULL);
+  g_return_if_fail (targets != NULL);
+  g_return_if_fail (sources != NULL);
+  g_return_if_fail (targets->len == sources->len);
+  g_return_if_fail (begin <= end);
+  g_return_if_fail (end <= targets->len);
+  g_return_if_fail (matches != NULL);
+
+  claimed = g_new0 (gboolean, commands->len);
+
+  for (guint i = begin; i < end; i++)
+    matches[i - begin] = -1;
+
+  /* Targets outside of the range still claim the commands building them */
+  for (guint i = 0; i < targets->len; i++)
+    {
+      const char *target = g_ptr_array_index (targets, i);
+
+      for (guint j = 0; j < commands->len; j++)
+        {
+          if (command_has_output (g_ptr_array_index (commands, j), target))
+            {
+              if (i >= begin && i < end)
+                matches[i - begin] = j;
+              claimed[j] = TRUE;
+              break;
+            }
+        }
+    }
+
+  for (guint i = begin; i < end; i++)
+    {
+      const char *source = g_ptr_array_index (sources, i);
+      int fallback = -1;
+
+      if (matches[i - begin] != -1 || source == NULL)
+        continue;
+
+      for (guint j = 0; j < commands->len; j++)
+        {
+          if (line_has_word (g_ptr_array_index (commands, j), source))
+            {
+              if (!claimed[j])
+                {
+                  fallback = j;
+                  break;
+                }
+
+              if (fallback == -1)
+                fallback = j;
+            }
+        }
+
+      matches[i - begin] = fallback;
+    }
+}
@@ -0,0 +1,53 @@
+/* ide-makecache-index.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+#include "ide-makecache-target.h"
+
+G_BEGIN_DECLS
+
+typedef struct _IdeMakecacheIndex IdeMakecacheIndex;
+
+IdeMakecacheIndex *ide_makecache_index_new              (const char        *contents,
+                                                         gsize              len);
+IdeMakecacheIndex *ide_makecache_index_new_from_variant (GVariant          *variant);
+IdeMakecacheIndex *ide_makecache_index_ref              (IdeMakecacheIndex *self);
+void               ide_makecache_index_unref            (IdeMakecacheIndex *self);
+GVariant          *ide_makecache_index_to_variant       (IdeMakecacheIndex *self);
+guint              ide_makecache_index_get_n_targets    (IdeMakecacheIndex *self);
+GPtrArray         *ide_makecache_index_lookup           (IdeMakecacheIndex *self,
+                                                         const char        *path);
+gboolean           ide_makecache_index_get_dry_run      (IdeMakecacheIndex *self,
+                                                         const char        *subdir,
+                                                         GPtrArray         *targets,
+                                                         GPtrArray         *sources);
+void               ide_makecache_match_commands         (GPtrArray         *commands,
+                                                         GPtrArray         *targets,
+                                                         GPtrArray         *sources,
+                                                         guint              begin,
+                                                         guint              end,
+                                                         int               *matches);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (IdeMakecacheIndex, ide_makecache_index_unref)
+
+G_END_DECLS
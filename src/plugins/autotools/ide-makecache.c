@@ -38,6 +38,7 @@
 
 #include "ide-autotools-build-target.h"
 #include "ide-makecache.h"
+#include "ide-makecache-index.h"
 #include "ide-makecache-target.h"
 
 #define FAKE_CC      "__LIBIDE_FAKE_CC__"
@@ -45,20 +46,38 @@
 #define FAKE_VALAC   "__LIBIDE_FAKE_VALAC__"
 #define PRINT_VARS   "include Makefile\nprint-%: ; @echo $* = $($*)\n"
 
+/* Keep the command line of batched dry-runs within reason */
+#define MAX_TARGETS_PER_DRY_RUN 256
+
 struct _IdeMakecache
 {
-  IdeObject     parent_instance;
-
-  GFile        *parent;
-  GMappedFile  *mapped;
-  IdeTaskCache *file_targets_cache;
-  IdeTaskCache *file_flags_cache;
-  GPtrArray    *build_targets;
-  IdeRuntime   *runtime;
-  IdePipeline  *pipeline;
-  const gchar  *make_name;
+  IdeObject          parent_instance;
+
+  GFile             *parent;
+  GFile             *cache_file;
+  IdeMakecacheIndex *index;
+  IdeTaskCache      *file_targets_cache;
+  IdeTaskCache      *file_flags_cache;
+  GPtrArray         *build_targets;
+  IdeRuntime        *runtime;
+  IdePipeline       *pipeline;
+  const gchar       *make_name;
+  gchar             *index_path;
+  gchar             *flags_path;
+
+  /* Subdir (or ".") to DirFlags, shared by the flags workers */
+  GMutex             dir_flags_mutex;
+  GHashTable        *dir_flags;
 };
 
+typedef struct
+{
+  /* Modification time of the Makefile the flags were extracted from */
+  gint64      mtime;
+  /* Target to flags, or %NULL if make did not print a command for it */
+  GHashTable *flags;
+} DirFlags;
+
 typedef struct
 {
   IdeMakecache *self;
@@ -69,8 +88,8 @@ typedef struct
 
 typedef struct
 {
-  GMappedFile *mapped;
-  gchar       *path;
+  IdeMakecacheIndex *index;
+  gchar             *path;
 } FileTargetsLookup;
 
 typedef struct
@@ -97,6 +116,25 @@ get_build_targets_free (GetBuildTargets *data)
   g_slice_free (GetBuildTargets, data);
 }
 
+static DirFlags *
+dir_flags_new (gint64 mtime)
+{
+  DirFlags *dir;
+
+  dir = g_slice_new0 (DirFlags);
+  dir->mtime = mtime;
+  dir->flags = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_strfreev);
+
+  return dir;
+}
+
+static void
+dir_flags_free (DirFlags *dir)
+{
+  g_clear_pointer (&dir->flags, g_hash_table_unref);
+  g_slice_free (DirFlags, dir);
+}
+
 static void
 file_flags_lookup_free (gpointer data)
 {
@@ -115,7 +153,7 @@ file_targets_lookup_free (gpointer data)
   FileTargetsLookup *lookup = data;
 
   g_clear_pointer (&lookup->path, g_free);
-  g_clear_pointer (&lookup->mapped, g_mapped_file_unref);
+  g_clear_pointer (&lookup->index, ide_makecache_index_unref);
   g_slice_free (FileTargetsLookup, lookup);
 }
 
@@ -155,159 +193,6 @@ ide_makecache_get_relative_path (IdeMakecache *self,
 }
 
 
-static gboolean
-is_target_interesting (const gchar *target)
-{
-  return ((target [0] != '#') &&
-          (target [0] != '.') &&
-          (g_str_has_suffix (target, ".lo") ||
-           g_str_has_suffix (target, ".o")));
-}
-
-/**
- * ide_makecache_get_file_targets_searched:
- *
- * Returns: (transfer container): a #GPtrArray of #IdeMakecacheTarget.
- */
-static GPtrArray *
-ide_makecache_get_file_targets_searched (GMappedFile *mapped,
-                                         const gchar *path)
-{
-  g_autofree gchar *escaped = NULL;
-  g_autofree gchar *name = NULL;
-  g_autofree gchar *regexstr = NULL;
-  g_autofree gchar *subdir = NULL;
-  g_autoptr(GHashTable) found = NULL;
-  g_autoptr(GPtrArray) targets = NULL;
-  g_autoptr(GRegex) regex = NULL;
-  const gchar *content;
-  const gchar *line;
-  IdeLineReader rl;
-  gsize len;
-  gsize line_len;
-
-  IDE_ENTRY;
-
-  g_assert (path);
-
-  /*
-   * TODO:
-   *
-   * We can end up with the same filename in multiple subdirectories. We should be careful about
-   * that later when we extract flags to choose the best match first.
-   */
-  name = g_path_get_basename (path);
-  escaped = g_regex_escape_string (name, -1);
-  regexstr = g_strdup_printf ("^([^:\n ]+):.*\\b(%s)\\b", escaped);
-
-  regex = g_regex_new (regexstr, 0, 0, NULL);
-  if (!regex)
-    IDE_RETURN (NULL);
-
-  content = g_mapped_file_get_contents (mapped);
-  len = g_mapped_file_get_length (mapped);
-
-  targets = g_ptr_array_new_with_free_func ((GDestroyNotify)ide_makecache_target_unref);
-  found = g_hash_table_new (ide_makecache_target_hash, ide_makecache_target_equal);
-
-#ifdef IDE_ENABLE_TRACE
-  {
-    gchar *fmtsize;
-
-    fmtsize = g_format_size (len);
-    IDE_TRACE_MSG ("Beginning regex lookup across %s of UTF-8 text", fmtsize);
-    g_free (fmtsize);
-  }
-#endif
-
-  if (len > G_MAXSSIZE)
-    IDE_RETURN (NULL);
-
-  ide_line_reader_init (&rl, (gchar *)content, len);
-
-  while ((line = ide_line_reader_next (&rl, &line_len)))
-    {
-      g_autoptr(GMatchInfo) match_info = NULL;
-
-      /*
-       * Keep track of "subdir = <dir>" changes so we know what directory
-       * to launch make from.
-       */
-      if ((line_len > 9) && (memcmp (line, "subdir = ", 9) == 0))
-        {
-          g_free (subdir);
-          subdir = g_strndup (line + 9, line_len - 9);
-          continue;
-        }
-
-      if (g_regex_match_full (regex, line, line_len, 0, 0, &match_info, NULL))
-        {
-          while (g_match_info_matches (match_info))
-            {
-              g_autofree gchar *targetstr = NULL;
-
-              targetstr = g_match_info_fetch (match_info, 1);
-
-              if (is_target_interesting (targetstr))
-                {
-                  g_autoptr(IdeMakecacheTarget) target = NULL;
-
-                  target = ide_makecache_target_new (subdir, targetstr);
-
-                  if (!g_hash_table_contains (found, target))
-                    {
-                      g_hash_table_insert (found, target, NULL);
-                      g_ptr_array_add (targets, g_steal_pointer (&target));
-                    }
-                }
-
-              g_match_info_next (match_info, NULL);
-            }
-        }
-    }
-
-  IDE_TRACE_MSG ("Regex scan complete");
-
-  if (targets->len > 0)
-    {
-#ifdef IDE_ENABLE_TRACE
-      {
-        GString *str;
-        gsize i;
-
-        str = g_string_new (NULL);
-
-        for (i = 0; i < targets->len; i++)
-          {
-            const gchar *target_subdir;
-            const gchar *target;
-            IdeMakecacheTarget *cur;
-
-            cur = g_ptr_array_index (targets, i);
-
-            target_subdir = ide_makecache_target_get_subdir (cur);
-            target = ide_makecache_target_get_target (cur);
-
-            if (target_subdir != NULL)
-              g_string_append_printf (str, " (%s of subdir %s)", target, target_subdir);
-            else
-              g_string_append_printf (str, " %s", target);
-          }
-
-
-        IDE_TRACE_MSG ("File \"%s\" found in targets: %s", path, str->str);
-        g_string_free (str, TRUE);
-      }
-#endif
-
-      g_ptr_array_ref (targets);
-
-      IDE_RETURN (targets);
-    }
-
-  IDE_RETURN (NULL);
-}
-
 static gboolean
 ide_makecache_validate_mapped_file (GMappedFile  *mapped,
                                     GError      **error)
@@ -628,6 +513,307 @@ ide_makecache_parse_line (IdeMakecache *self,
   IDE_RETURN (NULL);
 }
 
+static gint64
+get_mtime (GFileInfo *info)
+{
+  return g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+         g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+}
+
+static gint64
+ide_makecache_get_makefile_mtime (IdeMakecache *self,
+                                  const gchar  *subdir)
+{
+  g_autoptr(GFileInfo) info = NULL;
+  g_autoptr(GFile) makefile = NULL;
+  g_autofree gchar *path = NULL;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+
+  path = g_build_filename (subdir ?: ".", "Makefile", NULL);
+  makefile = g_file_resolve_relative_path (self->parent, path);
+  info = g_file_query_info (makefile,
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL,
+                            NULL);
+
+  return info ? get_mtime (info) : 0;
+}
+
+/*
+ * ide_makecache_run_dry_run:
+ *
+ * Runs a single `make -n` for the targets between @begin and @end,
+ * marking their sources as new with -W so that make prints the
+ * compile command for each of them. The flags found are stored in
+ * @flags for every target, see ide_makecache_match_commands() for how
+ * commands are matched to targets.
+ */
+static gboolean
+ide_makecache_run_dry_run (IdeMakecache  *self,
+                           const gchar   *subdir,
+                           GPtrArray     *targets,
+                           GPtrArray     *sources,
+                           guint          begin,
+                           guint          end,
+                           GHashTable    *flags,
+                           GCancellable  *cancellable,
+                           GError       **error)
+{
+  g_autoptr(IdeSubprocessLauncher) launcher = NULL;
+  g_autoptr(IdeSubprocess) subprocess = NULL;
+  g_autoptr(GHashTable) seen = NULL;
+  g_autoptr(GPtrArray) commands = NULL;
+  g_autoptr(GPtrArray) parsed = NULL;
+  g_autofree gchar *stdoutstr = NULL;
+  g_autofree int *matches = NULL;
+  g_autofree gchar *cwd = NULL;
+  g_auto(GStrv) lines = NULL;
+  gchar *tmp;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+  g_assert (targets->len == sources->len);
+  g_assert (begin < end);
+  g_assert (end <= targets->len);
+
+  if (!(launcher = ide_pipeline_create_launcher (self->pipeline, error)))
+    IDE_RETURN (FALSE);
+
+  cwd = g_file_get_path (self->parent);
+
+  ide_subprocess_launcher_set_flags (launcher, (G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+                                                G_SUBPROCESS_FLAGS_STDERR_SILENCE));
+  ide_subprocess_launcher_set_cwd (launcher, cwd);
+  ide_subprocess_launcher_push_args (launcher,
+                                     IDE_STRV_INIT (self->make_name, "-C", subdir ?: ".", "-s", "-i", "-n"));
+
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (guint i = begin; i < end; i++)
+    {
+      const gchar *source = g_ptr_array_index (sources, i);
+
+      if (source != NULL && g_hash_table_add (seen, (gchar *)source))
+        {
+          ide_subprocess_launcher_push_argv (launcher, "-W");
+          ide_subprocess_launcher_push_argv (launcher, source);
+        }
+    }
+
+  for (guint i = begin; i < end; i++)
+    ide_subprocess_launcher_push_argv (launcher, g_ptr_array_index (targets, i));
+
+  ide_subprocess_launcher_push_args (launcher,
+                                     IDE_STRV_INIT ("V=1",
+                                                    "CC="FAKE_CC,
+                                                    "CXX="FAKE_CXX,
+                                                    "VALAC="FAKE_VALAC));
+
+  IDE_TRACE_MSG ("Extracting flags for %u targets of subdir %s", end - begin, subdir ?: ".");
+
+  if (!(subprocess = ide_subprocess_launcher_spawn (launcher, cancellable, error)))
+    IDE_RETURN (FALSE);
+
+  /* Don't let ourselves be cancelled from this operation */
+  if (!ide_subprocess_communicate_utf8 (subprocess, NULL, NULL, &stdoutstr, NULL, error))
+    IDE_RETURN (FALSE);
+
+  /*
+   * Replace escaped newlines with " " to simplify command parsing
+   */
+  tmp = stdoutstr;
+  while (NULL != (tmp = strstr (tmp, "\\\n")))
+    {
+      tmp[0] = ' ';
+      tmp[1] = ' ';
+    }
+
+  lines = g_strsplit (stdoutstr, "\n", 0);
+  commands = g_ptr_array_new ();
+  parsed = g_ptr_array_new_with_free_func ((GDestroyNotify)g_strfreev);
+
+  for (guint i = 0; lines[i]; i++)
+    {
+      gchar **ret;
+      gchar *line = lines[i];
+      gsize linelen;
+
+      if (line[0] == '\0')
+        continue;
+
+      linelen = strlen (line);
+
+      if (line[linelen - 1] == '\\')
+        line[linelen - 1] = '\0';
+
+      if (!(ret = ide_makecache_parse_line (self, line, subdir ?: ".", subdir ?: ".")))
+        continue;
+
+      g_ptr_array_add (commands, line);
+      g_ptr_array_add (parsed, ret);
+    }
+
+  matches = g_new (int, end - begin);
+  ide_makecache_match_commands (commands, targets, sources, begin, end, matches);
+
+  for (guint i = begin; i < end; i++)
+    {
+      const gchar *target = g_ptr_array_index (targets, i);
+
+      if (matches[i - begin] == -1 || g_hash_table_lookup (flags, target) != NULL)
+        continue;
+
+      g_hash_table_insert (flags,
+                           g_strdup (target),
+                           g_strdupv (g_ptr_array_index (parsed, matches[i - begin])));
+    }
+
+  /* Remember targets without a command so we don't ask make again */
+  for (guint i = begin; i < end; i++)
+    {
+      const gchar *target = g_ptr_array_index (targets, i);
+
+      if (!g_hash_table_contains (flags, target))
+        g_hash_table_insert (flags, g_strdup (target), NULL);
+    }
+
+  IDE_RETURN (TRUE);
+}
+
+static void
+ide_makecache_save_flags_locked (IdeMakecache *self)
+{
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GError) error = NULL;
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  const gchar *subdir;
+  DirFlags *dir;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{s(xa{sas})}"));
+
+  g_hash_table_iter_init (&iter, self->dir_flags);
+
+  while (g_hash_table_iter_next (&iter, (gpointer *)&subdir, (gpointer *)&dir))
+    {
+      GHashTableIter flags_iter;
+      const gchar *target;
+      const gchar * const *flags;
+
+      if (dir->mtime == 0)
+        continue;
+
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("{s(xa{sas})}"));
+      g_variant_builder_add (&builder, "s", subdir);
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("(xa{sas})"));
+      g_variant_builder_add (&builder, "x", dir->mtime);
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sas}"));
+
+      g_hash_table_iter_init (&flags_iter, dir->flags);
+      while (g_hash_table_iter_next (&flags_iter, (gpointer *)&target, (gpointer *)&flags))
+        {
+          if (flags != NULL)
+            g_variant_builder_add (&builder, "{s^as}", target, flags);
+        }
+
+      g_variant_builder_close (&builder);
+      g_variant_builder_close (&builder);
+      g_variant_builder_close (&builder);
+    }
+
+  variant = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  if (!g_file_set_contents (self->flags_path,
+                            g_variant_get_data (variant),
+                            g_variant_get_size (variant),
+                            &error))
+    g_debug ("Failed to save makecache flags: %s", error->message);
+}
+
+/*
+ * ide_makecache_get_target_flags:
+ *
+ * Gets the flags for @target of @subdir. The first time flags are
+ * needed from a directory, they are extracted for all of its targets
+ * at once and saved to disk along with the modification time of the
+ * Makefile so that they survive restarts until the Makefile changes.
+ *
+ * Returns: (transfer full) (nullable): the flags, or %NULL if make did
+ *   not print a command for @target or @error is set
+ */
+static gchar **
+ide_makecache_get_target_flags (IdeMakecache  *self,
+                                const gchar   *subdir,
+                                const gchar   *target,
+                                const gchar   *source,
+                                GCancellable  *cancellable,
+                                GError       **error)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+  g_autoptr(GPtrArray) targets = NULL;
+  g_autoptr(GPtrArray) sources = NULL;
+  DirFlags *dir;
+  gint64 mtime;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+  g_assert (target != NULL);
+
+  locker = g_mutex_locker_new (&self->dir_flags_mutex);
+
+  mtime = ide_makecache_get_makefile_mtime (self, subdir);
+  dir = g_hash_table_lookup (self->dir_flags, subdir ?: ".");
+
+  if (dir != NULL && dir->mtime == mtime && g_hash_table_contains (dir->flags, target))
+    IDE_RETURN (g_strdupv (g_hash_table_lookup (dir->flags, target)));
+
+  targets = g_ptr_array_new_with_free_func (g_free);
+  sources = g_ptr_array_new_with_free_func (g_free);
+
+  /*
+   * Extract flags for the whole directory unless we already did and only
+   * miss a target that is not in the make database, such as the stamp
+   * file of vala sources.
+   */
+  if (dir == NULL || dir->mtime != mtime)
+    {
+      dir = dir_flags_new (mtime);
+      g_hash_table_insert (self->dir_flags, g_strdup (subdir ?: "."), dir);
+      ide_makecache_index_get_dry_run (self->index, subdir, targets, sources);
+    }
+
+  if (!g_ptr_array_find_with_equal_func (targets, target, g_str_equal, NULL))
+    {
+      g_ptr_array_add (targets, g_strdup (target));
+      g_ptr_array_add (sources, g_strdup (source));
+    }
+
+  for (guint i = 0; i < targets->len; i += MAX_TARGETS_PER_DRY_RUN)
+    {
+      if (!ide_makecache_run_dry_run (self,
+                                      subdir,
+                                      targets,
+                                      sources,
+                                      i,
+                                      MIN (i + MAX_TARGETS_PER_DRY_RUN, targets->len),
+                                      dir->flags,
+                                      cancellable,
+                                      error))
+        IDE_RETURN (NULL);
+    }
+
+  ide_makecache_save_flags_locked (self);
+
+  IDE_RETURN (g_strdupv (g_hash_table_lookup (dir->flags, target)));
+}
+
 static void
 ide_makecache_get_file_flags_worker (GTask        *task,
                                      gpointer      source_object,
@@ -635,8 +821,6 @@ ide_makecache_get_file_flags_worker (GTask        *task,
                                      GCancellable *cancellable)
 {
   FileFlagsLookup *lookup = task_data;
-  gsize i;
-  gsize j;
 
   IDE_ENTRY;
 
@@ -649,21 +833,14 @@ ide_makecache_get_file_flags_worker (GTask        *task,
   g_assert (IDE_IS_MAKECACHE (lookup->self));
   g_assert (lookup->targets != NULL);
 
-  for (j = 0; j < lookup->targets->len; j++)
+  for (guint j = 0; j < lookup->targets->len; j++)
     {
       IdeMakecacheTarget *target;
-      g_autoptr(IdeSubprocessLauncher) launcher = NULL;
-      g_autoptr(IdeSubprocess) subprocess = NULL;
-      g_autoptr(GPtrArray) argv = NULL;
-      g_autofree gchar *stdoutstr = NULL;
-      g_autofree gchar *cwd = NULL;
+      g_autoptr(GError) error = NULL;
       const gchar *subdir;
       const gchar *targetstr;
       const gchar *relpath;
-      g_autoptr(GError) error = NULL;
-      gchar **lines;
-      gchar **ret = NULL;
-      gchar *tmp;
+      gchar **ret;
 
       if (g_cancellable_is_cancelled (cancellable))
         break;
@@ -673,8 +850,6 @@ ide_makecache_get_file_flags_worker (GTask        *task,
       subdir = ide_makecache_target_get_subdir (target);
       targetstr = ide_makecache_target_get_target (target);
 
-      cwd = g_file_get_path (lookup->self->parent);
-
       if ((subdir != NULL) && g_str_has_prefix (lookup->relative_path, subdir))
         relpath = lookup->relative_path + strlen (subdir);
       else
@@ -683,91 +858,14 @@ ide_makecache_get_file_flags_worker (GTask        *task,
       while (*relpath == G_DIR_SEPARATOR)
         relpath++;
 
-      argv = g_ptr_array_new ();
-      g_ptr_array_add (argv, (gchar *)lookup->self->make_name);
-      g_ptr_array_add (argv, (gchar *)"-C");
-      g_ptr_array_add (argv, (gchar *)(subdir ?: "."));
-      g_ptr_array_add (argv, (gchar *)"-s");
-      g_ptr_array_add (argv, (gchar *)"-i");
-      g_ptr_array_add (argv, (gchar *)"-n");
-      g_ptr_array_add (argv, (gchar *)"-W");
-      g_ptr_array_add (argv, (gchar *)relpath);
-      g_ptr_array_add (argv, (gchar *)targetstr);
-      g_ptr_array_add (argv, (gchar *)"V=1");
-      g_ptr_array_add (argv, (gchar *)"CC="FAKE_CC);
-      g_ptr_array_add (argv, (gchar *)"CXX="FAKE_CXX);
-      g_ptr_array_add (argv, (gchar *)"VALAC="FAKE_VALAC);
-      g_ptr_array_add (argv, NULL);
-
-#ifdef IDE_ENABLE_TRACE
-      {
-        gchar *cmdline;
-
-        cmdline = g_strjoinv (" ", (gchar **)argv->pdata);
-        IDE_TRACE_MSG ("subdir=%s %s", subdir ?: ".", cmdline);
-        g_free (cmdline);
-      }
-#endif
-
-      if (!(launcher = ide_pipeline_create_launcher (lookup->self->pipeline, &error)))
-        {
-          g_task_return_error (task, g_steal_pointer (&error));
-          IDE_EXIT;
-        }
-
-      ide_subprocess_launcher_set_flags (launcher, (G_SUBPROCESS_FLAGS_STDOUT_PIPE |
-                                                    G_SUBPROCESS_FLAGS_STDERR_SILENCE));
-      ide_subprocess_launcher_set_cwd (launcher, cwd);
-      ide_subprocess_launcher_push_args (launcher, (const gchar * const *)argv->pdata);
+      ret = ide_makecache_get_target_flags (lookup->self, subdir, targetstr, relpath, cancellable, &error);
 
-      subprocess = ide_subprocess_launcher_spawn (launcher, cancellable, &error);
-
-      if (subprocess == NULL)
+      if (error != NULL)
         {
-          g_assert (error != NULL);
           g_task_return_error (task, g_steal_pointer (&error));
           IDE_EXIT;
         }
 
-      /* Don't let ourselves be cancelled from this operation */
-      if (!ide_subprocess_communicate_utf8 (subprocess, NULL, NULL, &stdoutstr, NULL, &error))
-        {
-          g_assert (error != NULL);
-          g_task_return_error (task, g_steal_pointer (&error));
-          IDE_EXIT;
-        }
-
-      /*
-       * Replace escaped newlines with " " to simplify command parsing
-       */
-      tmp = stdoutstr;
-      while (NULL != (tmp = strstr (tmp, "\\\n")))
-        {
-          tmp[0] = ' ';
-          tmp[1] = ' ';
-        }
-
-      lines = g_strsplit (stdoutstr, "\n", 0);
-
-      for (i = 0; lines [i]; i++)
-        {
-          gchar *line = lines [i];
-          gsize linelen;
-
-          if (line [0] == '\0')
-            continue;
-
-          linelen = strlen (line);
-
-          if (line [linelen - 1] == '\\')
-            line [linelen - 1] = '\0';
-
-          if ((ret = ide_makecache_parse_line (lookup->self, line, relpath, subdir ?: ".")))
-            break;
-        }
-
-      g_strfreev (lines);
-
       if (ret == NULL)
         continue;
 
@@ -829,7 +927,7 @@ ide_makecache_get_file_targets_worker (GTask        *task,
   g_assert (IDE_IS_TASK_CACHE (source_object));
   g_assert (G_IS_TASK (task));
   g_assert (lookup != NULL);
-  g_assert (lookup->mapped != NULL);
+  g_assert (lookup->index != NULL);
   g_assert (lookup->path != NULL);
 
   path = lookup->path;
@@ -841,7 +939,7 @@ ide_makecache_get_file_targets_worker (GTask        *task,
   base = g_path_get_basename (path);
 
   /* we use an empty GPtrArray to get negative cache hits. a bit heavy handed? sure. */
-  if (!(ret = ide_makecache_get_file_targets_searched (lookup->mapped, path)))
+  if (!(ret = ide_makecache_index_lookup (lookup->index, path)))
     ret = g_ptr_array_new ();
 
   /* If we had a vala file, we might need to translate the target */
@@ -913,7 +1011,7 @@ ide_makecache_get_file_targets_dispatch (IdeTaskCache  *cache,
   g_assert (G_IS_TASK (task));
 
   lookup = g_slice_new0 (FileTargetsLookup);
-  lookup->mapped = g_mapped_file_ref (self->mapped);
+  lookup->index = ide_makecache_index_ref (self->index);
 
   if (!(lookup->path = ide_makecache_get_relative_path (self, file)) &&
       !(lookup->path = g_file_get_path (file)) &&
@@ -1043,9 +1141,15 @@ ide_makecache_finalize (GObject *object)
   g_clear_object (&self->runtime);
   g_clear_object (&self->pipeline);
   g_clear_object (&self->parent);
+  g_clear_object (&self->cache_file);
 
-  g_clear_pointer (&self->mapped, g_mapped_file_unref);
+  g_clear_pointer (&self->index, ide_makecache_index_unref);
   g_clear_pointer (&self->build_targets, g_ptr_array_unref);
+  g_clear_pointer (&self->dir_flags, g_hash_table_unref);
+  g_clear_pointer (&self->index_path, g_free);
+  g_clear_pointer (&self->flags_path, g_free);
+
+  g_mutex_clear (&self->dir_flags_mutex);
 
   G_OBJECT_CLASS (ide_makecache_parent_class)->finalize (object);
 }
@@ -1063,6 +1167,9 @@ ide_makecache_init (IdeMakecache *self)
 {
   self->make_name = "make";
 
+  g_mutex_init (&self->dir_flags_mutex);
+  self->dir_flags = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)dir_flags_free);
+
   self->file_targets_cache = ide_task_cache_new ((GHashFunc)g_file_hash,
                                                  (GEqualFunc)g_file_equal,
                                                  g_object_ref,
@@ -1090,24 +1197,166 @@ ide_makecache_init (IdeMakecache *self)
   ide_task_cache_set_name (self->file_flags_cache, "makecache: file-flags-cache");
 }
 
+static IdeMakecacheIndex *
+ide_makecache_load_index (IdeMakecache *self,
+                          gint64        mtime,
+                          guint64       size)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GVariant) entries = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  gint64 saved_mtime;
+  guint64 saved_size;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+
+  if (!(mapped = g_mapped_file_new (self->index_path, FALSE, NULL)))
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE ("(xt@a(sssas))"), bytes, FALSE));
+  g_variant_get (variant, "(xt@a(sssas))", &saved_mtime, &saved_size, &entries);
+
+  /* The makecache is regenerated whenever a Makefile changes */
+  if (saved_mtime != mtime || saved_size != size)
+    return NULL;
+
+  return ide_makecache_index_new_from_variant (entries);
+}
+
+static void
+ide_makecache_save_index (IdeMakecache      *self,
+                          IdeMakecacheIndex *index,
+                          gint64             mtime,
+                          guint64            size)
+{
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+  g_assert (index != NULL);
+
+  variant = g_variant_ref_sink (g_variant_new ("(xt@a(sssas))",
+                                               mtime,
+                                               size,
+                                               ide_makecache_index_to_variant (index)));
+
+  if (!g_file_set_contents (self->index_path,
+                            g_variant_get_data (variant),
+                            g_variant_get_size (variant),
+                            &error))
+    g_debug ("Failed to save makecache index: %s", error->message);
+}
+
+static void
+ide_makecache_load_flags (IdeMakecache *self)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  GVariantIter iter;
+  GVariantIter *flags_iter;
+  const gchar *subdir;
+  gint64 mtime;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+
+  if (!(mapped = g_mapped_file_new (self->flags_path, FALSE, NULL)))
+    return;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE ("a{s(xa{sas})}"), bytes, FALSE));
+
+  g_variant_iter_init (&iter, variant);
+
+  while (g_variant_iter_loop (&iter, "{&s(xa{sas})}", &subdir, &mtime, &flags_iter))
+    {
+      DirFlags *dir;
+      gchar *target;
+      gchar **flags;
+
+      /* Drop flags of directories whose Makefile changed since */
+      if (mtime != ide_makecache_get_makefile_mtime (self, g_str_equal (subdir, ".") ? NULL : subdir))
+        continue;
+
+      dir = dir_flags_new (mtime);
+
+      while (g_variant_iter_next (flags_iter, "{s^as}", &target, &flags))
+        g_hash_table_insert (dir->flags, target, flags);
+
+      g_hash_table_insert (self->dir_flags, g_strdup (subdir), dir);
+    }
+}
+
+/*
+ * ide_makecache_load_worker:
+ *
+ * Indexes the make database so that looking up the targets of a file
+ * does not require scanning it again. The index is saved next to the
+ * makecache and reused as long as the makecache was not regenerated.
+ */
 static void
-ide_makecache_validate_worker (GTask        *task,
-                               gpointer      source_object,
-                               gpointer      task_data,
-                               GCancellable *cancellable)
+ide_makecache_load_worker (GTask        *task,
+                           gpointer      source_object,
+                           gpointer      task_data,
+                           GCancellable *cancellable)
 {
   IdeMakecache *self = task_data;
+  g_autoptr(IdeMakecacheIndex) index = NULL;
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GFileInfo) info = NULL;
   g_autoptr(GError) error = NULL;
+  g_autofree gchar *cache_path = NULL;
+  gint64 mtime;
+  guint64 size;
 
   IDE_ENTRY;
 
   g_assert (IDE_IS_MAKECACHE (self));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-  if (!ide_makecache_validate_mapped_file (self->mapped, &error))
-    g_task_return_error (task, g_steal_pointer (&error));
-  else
-    g_task_return_pointer (task, g_object_ref (self), g_object_unref);
+  info = g_file_query_info (self->cache_file,
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE,
+                            cancellable,
+                            &error);
+
+  if (info == NULL)
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      IDE_EXIT;
+    }
+
+  mtime = get_mtime (info);
+  size = g_file_info_get_size (info);
+
+  if (!(index = ide_makecache_load_index (self, mtime, size)))
+    {
+      cache_path = g_file_get_path (self->cache_file);
+
+      if (!(mapped = g_mapped_file_new (cache_path, FALSE, &error)) ||
+          !ide_makecache_validate_mapped_file (mapped, &error))
+        {
+          g_task_return_error (task, g_steal_pointer (&error));
+          IDE_EXIT;
+        }
+
+      index = ide_makecache_index_new (g_mapped_file_get_contents (mapped),
+                                       g_mapped_file_get_length (mapped));
+      ide_makecache_save_index (self, index, mtime, size);
+    }
+
+  IDE_TRACE_MSG ("Makecache contains %u object targets",
+                 ide_makecache_index_get_n_targets (index));
+
+  self->index = g_steal_pointer (&index);
+
+  ide_makecache_load_flags (self);
+
+  g_task_return_pointer (task, g_object_ref (self), g_object_unref);
 
   IDE_EXIT;
 }
@@ -1123,8 +1372,6 @@ ide_makecache_new_for_cache_file_async (IdeRuntime          *runtime,
   g_autoptr(GTask) task = NULL;
   g_autoptr(IdeMakecache) self = NULL;
   g_autoptr(GFile) parent = NULL;
-  g_autoptr(GMappedFile) mapped = NULL;
-  g_autoptr(GError) error = NULL;
   g_autofree gchar *cache_path = NULL;
 
   IDE_ENTRY;
@@ -1169,17 +1416,10 @@ ide_makecache_new_for_cache_file_async (IdeRuntime          *runtime,
     }
 
   self = g_object_new (IDE_TYPE_MAKECACHE, NULL);
-
-  mapped = g_mapped_file_new (cache_path, FALSE, &error);
-
-  if (mapped == NULL)
-    {
-      g_task_return_error (task, g_steal_pointer (&error));
-      IDE_EXIT;
-    }
-
   self->parent = g_steal_pointer (&parent);
-  self->mapped = g_steal_pointer (&mapped);
+  self->cache_file = g_object_ref (cache_file);
+  self->index_path = g_strconcat (cache_path, ".index", NULL);
+  self->flags_path = g_strconcat (cache_path, ".flags", NULL);
   self->runtime = g_object_ref (runtime);
   self->pipeline = g_object_ref (pipeline);
 
@@ -1187,7 +1427,7 @@ ide_makecache_new_for_cache_file_async (IdeRuntime          *runtime,
     self->make_name = "gmake";
 
   g_task_set_task_data (task, g_steal_pointer (&self), g_object_unref);
-  g_task_run_in_thread (task, ide_makecache_validate_worker);
+  g_task_run_in_thread (task, ide_makecache_load_worker);
 
   IDE_EXIT;
 }
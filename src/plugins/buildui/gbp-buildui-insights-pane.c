@@ -0,0 +1,415 @@
+/* gbp-buildui-insights-pane.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "gbp-buildui-insights-pane"
+
+#include "config.h"
+
+#include <glib/gi18n.h>
+
+#include <libide-gtk.h>
+
+#include "ide-build-private.h"
+#include "ide-ninja-log-private.h"
+
+#include "gbp-buildui-insights-pane.h"
+
+/* The number of previous builds the most recent build is compared to */
+#define N_BASELINE_BUILDS 5
+/* The number of targets to show from the ninja log */
+#define N_SLOWEST_TARGETS 10
+/* Taking a fifth and at least half a second longer is a regression */
+#define REGRESSION_DIVISOR  5
+#define REGRESSION_MIN_USEC (G_USEC_PER_SEC / 2)
+
+struct _GbpBuilduiInsightsPane
+{
+  IdePane       parent_instance;
+
+  /* Owned references */
+  IdePipeline  *pipeline;
+  GSignalGroup *pipeline_signals;
+  GCancellable *cancellable;
+
+  /* Template widgets */
+  GtkLabel     *summary_label;
+  GtkListBox   *stages_list_box;
+  GtkWidget    *ninja_box;
+  GtkLabel     *ninja_summary_label;
+  GtkListBox   *targets_list_box;
+  GtkListBox   *critical_path_list_box;
+};
+
+G_DEFINE_FINAL_TYPE (GbpBuilduiInsightsPane, gbp_buildui_insights_pane, IDE_TYPE_PANE)
+
+static char *
+format_duration (GTimeSpan span)
+{
+  if (span < G_USEC_PER_SEC)
+    return g_strdup_printf (_("%u ms"), (guint)(span / 1000));
+  else if (span < 60 * G_USEC_PER_SEC)
+    return g_strdup_printf (_("%.1lf s"), span / (double)G_USEC_PER_SEC);
+  else
+    return ide_g_time_span_to_label (span);
+}
+
+static gboolean
+is_regression (GTimeSpan value,
+               GTimeSpan baseline)
+{
+  return baseline > 0 &&
+         value - baseline > MAX (baseline / REGRESSION_DIVISOR, REGRESSION_MIN_USEC);
+}
+
+static void
+add_row (GtkListBox *list_box,
+         const char *title,
+         GTimeSpan   value,
+         GTimeSpan   baseline)
+{
+  g_autofree char *value_text = format_duration (value);
+  GtkWidget *title_label;
+  GtkWidget *value_label;
+  GtkWidget *box;
+
+  g_assert (GTK_IS_LIST_BOX (list_box));
+
+  box = g_object_new (GTK_TYPE_BOX,
+                      "orientation", GTK_ORIENTATION_HORIZONTAL,
+                      "spacing", 6,
+                      NULL);
+
+  title_label = g_object_new (GTK_TYPE_LABEL,
+                              "label", title,
+                              "tooltip-text", title,
+                              "ellipsize", PANGO_ELLIPSIZE_MIDDLE,
+                              "hexpand", TRUE,
+                              "xalign", 0.0f,
+                              NULL);
+  gtk_box_append (GTK_BOX (box), title_label);
+
+  if (baseline > 0)
+    {
+      g_autofree char *delta_text = NULL;
+      g_autofree char *baseline_text = format_duration (baseline);
+      g_autofree char *tooltip = g_strdup_printf (_("Previously %s on average"), baseline_text);
+      int percent = (int)((value - baseline) * 100 / baseline);
+      GtkWidget *delta_label;
+
+      delta_text = g_strdup_printf ("%+d%%", percent);
+      delta_label = g_object_new (GTK_TYPE_LABEL,
+                                  "label", delta_text,
+                                  "tooltip-text", tooltip,
+                                  NULL);
+
+      if (is_regression (value, baseline))
+        gtk_widget_add_css_class (delta_label, "error");
+      else
+        gtk_widget_add_css_class (delta_label, "dim-label");
+
+      gtk_box_append (GTK_BOX (box), delta_label);
+    }
+
+  value_label = g_object_new (GTK_TYPE_LABEL,
+                              "label", value_text,
+                              "xalign", 1.0f,
+                              "width-chars", 8,
+                              NULL);
+  gtk_widget_add_css_class (value_label, "numeric");
+  gtk_box_append (GTK_BOX (box), value_label);
+
+  gtk_list_box_append (list_box, box);
+}
+
+static void
+gbp_buildui_insights_pane_update_history (GbpBuilduiInsightsPane *self)
+{
+  g_autoptr(GVariantIter) iter = NULL;
+  g_autoptr(GVariant) build = NULL;
+  g_autofree char *duration_text = NULL;
+  IdeBuildHistory *history;
+  const char *name;
+  GTimeSpan baseline;
+  guint64 stage_duration;
+  gint64 begin;
+  gint64 duration;
+  gboolean failed;
+  guint phase;
+
+  g_assert (GBP_IS_BUILDUI_INSIGHTS_PANE (self));
+
+  gtk_list_box_remove_all (self->stages_list_box);
+  gtk_widget_remove_css_class (GTK_WIDGET (self->summary_label), "error");
+
+  if (self->pipeline == NULL ||
+      !(history = _ide_pipeline_get_history (self->pipeline)) ||
+      !(build = ide_build_history_dup_build (history, 0)))
+    {
+      gtk_label_set_label (self->summary_label, _("No builds have been recorded yet"));
+      return;
+    }
+
+  g_variant_get (build, "(xxba(sut))", &begin, &duration, &failed, &iter);
+
+  baseline = ide_build_history_get_baseline (history, NULL, N_BASELINE_BUILDS);
+  duration_text = format_duration (duration);
+
+  if (failed)
+    {
+      g_autofree char *text = g_strdup_printf (_("Last build failed after %s"), duration_text);
+      gtk_label_set_label (self->summary_label, text);
+    }
+  else if (baseline > 0)
+    {
+      g_autofree char *baseline_text = format_duration (baseline);
+      g_autofree char *text = g_strdup_printf (_("Last build took %s, previously %s on average"),
+                                               duration_text, baseline_text);
+      gtk_label_set_label (self->summary_label, text);
+
+      if (is_regression (duration, baseline))
+        gtk_widget_add_css_class (GTK_WIDGET (self->summary_label), "error");
+    }
+  else
+    {
+      g_autofree char *text = g_strdup_printf (_("Last build took %s"), duration_text);
+      gtk_label_set_label (self->summary_label, text);
+    }
+
+  while (g_variant_iter_next (iter, "(&sut)", &name, &phase, &stage_duration))
+    add_row (self->stages_list_box,
+             name,
+             stage_duration,
+             ide_build_history_get_baseline (history, name, N_BASELINE_BUILDS));
+}
+
+static void
+gbp_buildui_insights_pane_load_ninja_log_cb (GObject      *object,
+                                             GAsyncResult *result,
+                                             gpointer      user_data)
+{
+  g_autoptr(GbpBuilduiInsightsPane) self = user_data;
+  g_autoptr(IdeNinjaLog) ninja_log = NULL;
+  g_autoptr(GPtrArray) critical_path = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *duration_text = NULL;
+  g_autofree char *path_text = NULL;
+  g_autofree char *summary = NULL;
+  guint path_duration = 0;
+  guint n_entries;
+
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (GBP_IS_BUILDUI_INSIGHTS_PANE (self));
+
+  if (!(ninja_log = ide_ninja_log_load_finish (result, &error)))
+    {
+      if (!ide_error_ignore (error))
+        gtk_widget_set_visible (self->ninja_box, FALSE);
+      return;
+    }
+
+  gtk_list_box_remove_all (self->targets_list_box);
+  gtk_list_box_remove_all (self->critical_path_list_box);
+
+  n_entries = ide_ninja_log_get_n_entries (ninja_log);
+
+  for (guint i = 0; i < MIN (n_entries, N_SLOWEST_TARGETS); i++)
+    {
+      const IdeNinjaLogEntry *entry = ide_ninja_log_get_entry (ninja_log, i);
+
+      add_row (self->targets_list_box,
+               entry->output,
+               (GTimeSpan)IDE_NINJA_LOG_ENTRY_DURATION (entry) * 1000,
+               -1);
+    }
+
+  critical_path = ide_ninja_log_get_critical_path (ninja_log);
+
+  for (guint i = 0; i < critical_path->len; i++)
+    {
+      const IdeNinjaLogEntry *entry = g_ptr_array_index (critical_path, i);
+
+      path_duration += IDE_NINJA_LOG_ENTRY_DURATION (entry);
+      add_row (self->critical_path_list_box,
+               entry->output,
+               (GTimeSpan)IDE_NINJA_LOG_ENTRY_DURATION (entry) * 1000,
+               -1);
+    }
+
+  duration_text = format_duration ((GTimeSpan)ide_ninja_log_get_duration (ninja_log) * 1000);
+  path_text = format_duration ((GTimeSpan)path_duration * 1000);
+  /* translators: the first %s is the time spent running commands, the second the time spent on the critical path */
+  summary = g_strdup_printf (_("Ninja ran commands for %s, %s of which were on the critical path"),
+                             duration_text, path_text);
+  gtk_label_set_label (self->ninja_summary_label, summary);
+
+  gtk_widget_set_visible (self->ninja_box, n_entries > 0);
+}
+
+static void
+gbp_buildui_insights_pane_reload (GbpBuilduiInsightsPane *self)
+{
+  g_autoptr(GFile) file = NULL;
+  const char *builddir;
+
+  g_assert (GBP_IS_BUILDUI_INSIGHTS_PANE (self));
+
+  gbp_buildui_insights_pane_update_history (self);
+
+  g_cancellable_cancel (self->cancellable);
+  g_clear_object (&self->cancellable);
+
+  if (self->pipeline == NULL ||
+      !(builddir = ide_pipeline_get_builddir (self->pipeline)))
+    {
+      gtk_widget_set_visible (self->ninja_box, FALSE);
+      return;
+    }
+
+  /* Only ninja based build systems leave this behind */
+  self->cancellable = g_cancellable_new ();
+  file = g_file_new_build_filename (builddir, ".ninja_log", NULL);
+  ide_ninja_log_load_async (file,
+                            self->cancellable,
+                            gbp_buildui_insights_pane_load_ninja_log_cb,
+                            g_object_ref (self));
+}
+
+static void
+gbp_buildui_insights_pane_bind_pipeline (GbpBuilduiInsightsPane *self,
+                                         IdePipeline            *pipeline,
+                                         GSignalGroup           *signals)
+{
+  IdeBuildHistory *history;
+
+  g_assert (GBP_IS_BUILDUI_INSIGHTS_PANE (self));
+  g_assert (IDE_IS_PIPELINE (pipeline));
+  g_assert (self->pipeline == NULL);
+  g_assert (G_IS_SIGNAL_GROUP (signals));
+
+  self->pipeline = g_object_ref (pipeline);
+
+  if ((history = _ide_pipeline_get_history (pipeline)))
+    g_signal_connect_object (history,
+                             "changed",
+                             G_CALLBACK (gbp_buildui_insights_pane_update_history),
+                             self,
+                             G_CONNECT_SWAPPED);
+
+  gbp_buildui_insights_pane_reload (self);
+}
+
+static void
+gbp_buildui_insights_pane_unbind_pipeline (GbpBuilduiInsightsPane *self,
+                                           GSignalGroup           *signals)
+{
+  IdeBuildHistory *history;
+
+  g_assert (GBP_IS_BUILDUI_INSIGHTS_PANE (self));
+  g_assert (G_IS_SIGNAL_GROUP (signals));
+
+  if (self->pipeline != NULL &&
+      (history = _ide_pipeline_get_history (self->pipeline)))
+    g_signal_handlers_disconnect_by_func (history,
+                                          G_CALLBACK (gbp_buildui_insights_pane_update_history),
+                                          self);
+
+  g_clear_object (&self->pipeline);
+
+  if (!gtk_widget_in_destruction (GTK_WIDGET (self)))
+    gbp_buildui_insights_pane_reload (self);
+}
+
+void
+gbp_buildui_insights_pane_set_pipeline (GbpBuilduiInsightsPane *self,
+                                        IdePipeline            *pipeline)
+{
+  g_return_if_fail (GBP_IS_BUILDUI_INSIGHTS_PANE (self));
+  g_return_if_fail (!pipeline || IDE_IS_PIPELINE (pipeline));
+
+  if (self->pipeline_signals != NULL)
+    g_signal_group_set_target (self->pipeline_signals, pipeline);
+}
+
+static void
+gbp_buildui_insights_pane_dispose (GObject *object)
+{
+  GbpBuilduiInsightsPane *self = (GbpBuilduiInsightsPane *)object;
+
+  g_cancellable_cancel (self->cancellable);
+  g_clear_object (&self->cancellable);
+
+  g_signal_group_set_target (self->pipeline_signals, NULL);
+  g_clear_object (&self->pipeline);
+
+  G_OBJECT_CLASS (gbp_buildui_insights_pane_parent_class)->dispose (object);
+}
+
+static void
+gbp_buildui_insights_pane_finalize (GObject *object)
+{
+  GbpBuilduiInsightsPane *self = (GbpBuilduiInsightsPane *)object;
+
+  g_clear_object (&self->pipeline_signals);
+
+  G_OBJECT_CLASS (gbp_buildui_insights_pane_parent_class)->finalize (object);
+}
+
+static void
+gbp_buildui_insights_pane_class_init (GbpBuilduiInsightsPaneClass *klass)
+{
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = gbp_buildui_insights_pane_dispose;
+  object_class->finalize = gbp_buildui_insights_pane_finalize;
+
+  gtk_widget_class_set_template_from_resource (widget_class, "/plugins/buildui/gbp-buildui-insights-pane.ui");
+  gtk_widget_class_bind_template_child (widget_class, GbpBuilduiInsightsPane, critical_path_list_box);
+  gtk_widget_class_bind_template_child (widget_class, GbpBuilduiInsightsPane, ninja_box);
+  gtk_widget_class_bind_template_child (widget_class, GbpBuilduiInsightsPane, ninja_summary_label);
+  gtk_widget_class_bind_template_child (widget_class, GbpBuilduiInsightsPane, stages_list_box);
+  gtk_widget_class_bind_template_child (widget_class, GbpBuilduiInsightsPane, summary_label);
+  gtk_widget_class_bind_template_child (widget_class, GbpBuilduiInsightsPane, targets_list_box);
+}
+
+static void
+gbp_buildui_insights_pane_init (GbpBuilduiInsightsPane *self)
+{
+  gtk_widget_init_template (GTK_WIDGET (self));
+
+  self->pipeline_signals = g_signal_group_new (IDE_TYPE_PIPELINE);
+  g_signal_connect_object (self->pipeline_signals,
+                           "bind",
+                           G_CALLBACK (gbp_buildui_insights_pane_bind_pipeline),
+                           self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->pipeline_signals,
+                           "unbind",
+                           G_CALLBACK (gbp_buildui_insights_pane_unbind_pipeline),
+                           self,
+                           G_CONNECT_SWAPPED);
+  g_signal_group_connect_object (self->pipeline_signals,
+                                 "finished",
+                                 G_CALLBACK (gbp_buildui_insights_pane_reload),
+                                 self,
+                                 G_CONNECT_SWAPPED);
+
+  panel_widget_set_title (PANEL_WIDGET (self), _("Build Insights"));
+}
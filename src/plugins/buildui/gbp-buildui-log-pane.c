@@ -29,12 +29,17 @@
 
 #include "gbp-buildui-log-pane.h"
 
+#define MAX_SEARCH_MATCHES 500
+
 struct _GbpBuilduiLogPane
 {
-  IdePane      parent_instance;
-  IdePipeline *pipeline;
-  IdeTerminal *terminal;
-  guint        log_observer;
+  IdePane         parent_instance;
+  IdePipeline    *pipeline;
+  IdeTerminal    *terminal;
+  GtkSearchEntry *search_entry;
+  GtkListBox     *search_results;
+  GtkStringList  *search_matches;
+  guint           log_observer;
 };
 
 enum {
@@ -88,6 +93,62 @@ gbp_buildui_log_pane_notify_pty (GbpBuilduiLogPane *self,
     vte_terminal_set_pty (VTE_TERMINAL (self->terminal), pty);
 }
 
+static void
+gbp_buildui_log_pane_search_changed_cb (GbpBuilduiLogPane *self,
+                                        GtkSearchEntry    *entry)
+{
+  g_auto(GStrv) lines = NULL;
+  const char *text;
+
+  g_assert (GBP_IS_BUILDUI_LOG_PANE (self));
+  g_assert (GTK_IS_SEARCH_ENTRY (entry));
+
+  text = gtk_editable_get_text (GTK_EDITABLE (entry));
+
+  /* The terminal scrollback is limited, so search the output retained
+   * by the pipeline instead, which may go further back.
+   */
+  if (self->pipeline != NULL && !ide_str_empty0 (text))
+    lines = ide_pipeline_search_log (self->pipeline, text, MAX_SEARCH_MATCHES);
+
+  gtk_string_list_splice (self->search_matches,
+                          0,
+                          g_list_model_get_n_items (G_LIST_MODEL (self->search_matches)),
+                          (const char * const *)lines);
+}
+
+static void
+gbp_buildui_log_pane_search_popover_show_cb (GbpBuilduiLogPane *self,
+                                             GtkPopover        *popover)
+{
+  g_assert (GBP_IS_BUILDUI_LOG_PANE (self));
+  g_assert (GTK_IS_POPOVER (popover));
+
+  /* The build may have produced more output since the last search */
+  gbp_buildui_log_pane_search_changed_cb (self, self->search_entry);
+}
+
+static GtkWidget *
+gbp_buildui_log_pane_create_match_row (gpointer item,
+                                       gpointer user_data)
+{
+  GtkStringObject *string = item;
+
+  g_assert (GTK_IS_STRING_OBJECT (string));
+
+  return g_object_new (GTK_TYPE_LABEL,
+                       "css-classes", IDE_STRV_INIT ("monospace"),
+                       "label", gtk_string_object_get_string (string),
+                       "ellipsize", PANGO_ELLIPSIZE_END,
+                       "selectable", TRUE,
+                       "xalign", 0.0f,
+                       "margin-top", 3,
+                       "margin-bottom", 3,
+                       "margin-start", 6,
+                       "margin-end", 6,
+                       NULL);
+}
+
 void
 gbp_buildui_log_pane_set_pipeline (GbpBuilduiLogPane *self,
                                    IdePipeline  *pipeline)
@@ -105,6 +166,10 @@ gbp_buildui_log_pane_set_pipeline (GbpBuilduiLogPane *self,
           ide_pipeline_remove_log_observer (self->pipeline, self->log_observer);
           self->log_observer = 0;
           g_clear_object (&self->pipeline);
+          gtk_string_list_splice (self->search_matches,
+                                  0,
+                                  g_list_model_get_n_items (G_LIST_MODEL (self->search_matches)),
+                                  NULL);
         }
 
       if (pipeline != NULL)
@@ -171,6 +236,7 @@ gbp_buildui_log_pane_finalize (GObject *object)
   GbpBuilduiLogPane *self = (GbpBuilduiLogPane *)object;
 
   g_clear_object (&self->pipeline);
+  g_clear_object (&self->search_matches);
 
   G_OBJECT_CLASS (gbp_buildui_log_pane_parent_class)->finalize (object);
 }
@@ -239,6 +305,10 @@ gbp_buildui_log_pane_class_init (GbpBuilduiLogPaneClass *klass)
   gtk_widget_class_set_css_name (widget_class, "buildlogpanel");
   gtk_widget_class_set_template_from_resource (widget_class, "/plugins/buildui/gbp-buildui-log-pane.ui");
   gtk_widget_class_bind_template_child (widget_class, GbpBuilduiLogPane, terminal);
+  gtk_widget_class_bind_template_child (widget_class, GbpBuilduiLogPane, search_entry);
+  gtk_widget_class_bind_template_child (widget_class, GbpBuilduiLogPane, search_results);
+  gtk_widget_class_bind_template_callback (widget_class, gbp_buildui_log_pane_search_changed_cb);
+  gtk_widget_class_bind_template_callback (widget_class, gbp_buildui_log_pane_search_popover_show_cb);
 
   properties [PROP_PIPELINE] =
     g_param_spec_object ("pipeline",
@@ -372,8 +442,15 @@ gbp_buildui_log_pane_init (GbpBuilduiLogPane *self)
     { "save", gbp_buildui_log_pane_save_in_file },
   };
 
+  self->search_matches = gtk_string_list_new (NULL);
+
   gtk_widget_init_template (GTK_WIDGET (self));
 
+  gtk_list_box_bind_model (self->search_results,
+                           G_LIST_MODEL (self->search_matches),
+                           gbp_buildui_log_pane_create_match_row,
+                           NULL, NULL);
+
   g_signal_connect_object (IDE_APPLICATION_DEFAULT,
                            "notify::style-scheme",
                            G_CALLBACK (gbp_buildui_log_pane_notify_style_scheme_cb),
@@ -28,6 +28,7 @@
 #include <libide-foundry.h>
 #include <libide-gui.h>
 
+#include "gbp-buildui-insights-pane.h"
 #include "gbp-buildui-log-pane.h"
 #include "gbp-buildui-omni-bar-section.h"
 #include "gbp-buildui-pane.h"
@@ -45,6 +46,7 @@ struct _GbpBuilduiWorkspaceAddin
   GbpBuilduiOmniBarSection  *omni_bar_section;
   GbpBuilduiLogPane         *log_pane;
   GbpBuilduiPane            *pane;
+  GbpBuilduiInsightsPane    *insights_pane;
   GtkBox                    *diag_box;
   GtkImage                  *error_image;
   GtkLabel                  *error_label;
@@ -128,6 +130,7 @@ gbp_buildui_workspace_addin_notify_pipeline (GbpBuilduiWorkspaceAddin *self,
   pipeline = ide_build_manager_get_pipeline (build_manager);
   gbp_buildui_log_pane_set_pipeline (self->log_pane, pipeline);
   gbp_buildui_pane_set_pipeline (self->pane, pipeline);
+  gbp_buildui_insights_pane_set_pipeline (self->insights_pane, pipeline);
 }
 
 static void
@@ -260,6 +263,7 @@ gbp_buildui_workspace_addin_load (IdeWorkspaceAddin *addin,
                                   IdeWorkspace      *workspace)
 {
   GbpBuilduiWorkspaceAddin *self = (GbpBuilduiWorkspaceAddin *)addin;
+  g_autoptr(PanelPosition) insights_position = NULL;
   g_autoptr(PanelPosition) pane_position = NULL;
   g_autoptr(PanelPosition) log_position = NULL;
   PangoAttrList *small_attrs = NULL;
@@ -363,6 +367,13 @@ gbp_buildui_workspace_addin_load (IdeWorkspaceAddin *addin,
   self->pane = g_object_new (GBP_TYPE_BUILDUI_PANE, NULL);
   ide_workspace_add_pane (workspace, IDE_PANE (self->pane), pane_position);
 
+  insights_position = panel_position_new ();
+  panel_position_set_area (insights_position, PANEL_AREA_START);
+  panel_position_set_depth (insights_position, 2);
+
+  self->insights_pane = g_object_new (GBP_TYPE_BUILDUI_INSIGHTS_PANE, NULL);
+  ide_workspace_add_pane (workspace, IDE_PANE (self->insights_pane), insights_position);
+
   self->build_manager_signals = g_signal_group_new (IDE_TYPE_BUILD_MANAGER);
   g_signal_connect_object (self->build_manager_signals,
                            "bind",
@@ -41,6 +41,7 @@ struct _GbpCodeIndexBuilder
   IdePersistentMapBuilder *map;
   IdeFuzzyIndexBuilder    *fuzzy;
   guint                    next_file_id;
+  gint64                   begin_time;
   guint                    has_run : 1;
 };
 
@@ -52,6 +53,9 @@ typedef struct
 
 G_DEFINE_FINAL_TYPE (GbpCodeIndexBuilder, gbp_code_index_builder, IDE_TYPE_OBJECT)
 
+IDE_DEFINE_COUNTER (code_index_files, "Code Index", "Files Indexed", "Number of files indexed");
+IDE_DEFINE_COUNTER (code_index_build_usec, "Code Index", "Build (usec)", "Time spent building code indexes");
+
 static void
 run_free (Run *state)
 {
@@ -324,6 +328,8 @@ gbp_code_index_builder_index_file_cb (GObject      *object,
 
   gbp_code_index_builder_index_file_finish (self, result, &error);
 
+  ide_counter_inc (&code_index_files);
+
   state = ide_task_get_task_data (task);
   state->n_active--;
   state->completed++;
@@ -592,6 +598,7 @@ gbp_code_index_builder_run_async (GbpCodeIndexBuilder *self,
   ide_task_set_source_tag (task, gbp_code_index_builder_run_async);
 
   self->has_run = TRUE;
+  self->begin_time = ide_profiler_now ();
 
   gbp_code_index_builder_aggregate_async (self,
                                           cancellable,
@@ -616,6 +623,16 @@ gbp_code_index_builder_run_finish (GbpCodeIndexBuilder  *self,
 
   ret = ide_task_propagate_boolean (IDE_TASK (result), error);
 
+  if (self->begin_time != 0)
+    {
+      ide_counter_add (&code_index_build_usec, (ide_profiler_now () - self->begin_time) / 1000);
+      IDE_PROFILER_SPAN_END (self->begin_time, "Code Index", "Build",
+                             "%s (%u items)",
+                             self->source_dir ? g_file_peek_path (self->source_dir) : "",
+                             self->items ? self->items->len : 0);
+      self->begin_time = 0;
+    }
+
   /* Drop extraneous resources immediately */
   g_clear_object (&self->source_dir);
   g_clear_object (&self->index_dir);
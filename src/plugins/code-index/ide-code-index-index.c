@@ -55,6 +55,7 @@ typedef struct
   IdeHeap *fuzzy_matches;
   guint    curr_index;
   gsize    max_results;
+  gint64   begin_time;
 } PopulateTaskData;
 
 /*
@@ -71,6 +72,9 @@ typedef struct
 
 G_DEFINE_FINAL_TYPE (IdeCodeIndexIndex, ide_code_index_index, IDE_TYPE_OBJECT)
 
+IDE_DEFINE_COUNTER (code_index_queries, "Code Index", "Queries", "Number of code index queries");
+IDE_DEFINE_COUNTER (code_index_query_usec, "Code Index", "Query (usec)", "Time spent querying the code index");
+
 static void directory_index_free (DirectoryIndex *data);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (DirectoryIndex, directory_index_free)
@@ -448,6 +452,11 @@ ide_code_index_index_query_cb (GObject      *object,
       if (data->max_results == 0 && data->fuzzy_matches->len > 0)
         g_object_set_data (G_OBJECT (task), "TRUNCATED", GINT_TO_POINTER (TRUE));
 
+      ide_counter_add (&code_index_query_usec, (ide_profiler_now () - data->begin_time) / 1000);
+      IDE_PROFILER_SPAN_END (data->begin_time, "Code Index", "Query",
+                             "%u results from %u indexes",
+                             results->len, self->indexes->len);
+
       ide_task_return_pointer (task,
                                g_steal_pointer (&results),
                                g_ptr_array_unref);
@@ -476,9 +485,12 @@ ide_code_index_index_populate_async (IdeCodeIndexIndex   *self,
   ide_task_set_source_tag (task, ide_code_index_index_populate_async);
   ide_task_set_priority (task, G_PRIORITY_LOW);
 
+  ide_counter_inc (&code_index_queries);
+
   data = g_slice_new0 (PopulateTaskData);
   data->max_results = max_results;
   data->curr_index = 0;
+  data->begin_time = ide_profiler_now ();
   data->fuzzy_matches = ide_heap_new (sizeof (FuzzyMatch),
                                       (GCompareFunc)fuzzy_match_compare);
 
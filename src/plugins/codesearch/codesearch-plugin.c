@@ -26,6 +26,7 @@
 #include <libide-search.h>
 
 #include "gbp-codesearch-search-provider.h"
+#include "gbp-codesearch-workbench-addin.h"
 
 _IDE_EXTERN void
 _gbp_codesearch_register_types (PeasObjectModule *module)
@@ -33,4 +34,7 @@ _gbp_codesearch_register_types (PeasObjectModule *module)
   peas_object_module_register_extension_type (module,
                                               IDE_TYPE_SEARCH_PROVIDER,
                                               GBP_TYPE_CODESEARCH_SEARCH_PROVIDER);
+  peas_object_module_register_extension_type (module,
+                                              IDE_TYPE_WORKBENCH_ADDIN,
+                                              GBP_TYPE_CODESEARCH_WORKBENCH_ADDIN);
 }
@@ -0,0 +1,419 @@
+/* gbp-codesearch-indexer.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "gbp-codesearch-indexer"
+
+#include "config.h"
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "gbp-codesearch-indexer.h"
+
+/* Larger files are most likely generated or data */
+#define MAX_FILE_SIZE    (1024 * 1024)
+/* Files with a Nil byte within this range are considered binary */
+#define BINARY_PEEK_SIZE 4096
+#define MAX_TEXT_LEN     200
+
+void
+gbp_codesearch_hit_clear (GbpCodesearchHit *hit)
+{
+  g_clear_pointer (&hit->path, g_free);
+  g_clear_pointer (&hit->text, g_free);
+}
+
+static GMappedFile *
+map_document (GFile      *workdir,
+              const char *path)
+{
+  g_autoptr(GFile) file = g_file_resolve_relative_path (workdir, path);
+  GMappedFile *mapped;
+  const char *data;
+  gsize len;
+
+  if (g_file_peek_path (file) == NULL ||
+      !(mapped = g_mapped_file_new (g_file_peek_path (file), FALSE, NULL)))
+    return NULL;
+
+  data = g_mapped_file_get_contents (mapped);
+  len = g_mapped_file_get_length (mapped);
+
+  if (len == 0 ||
+      len > MAX_FILE_SIZE ||
+      memchr (data, 0, MIN (len, BINARY_PEEK_SIZE)) != NULL)
+    {
+      g_mapped_file_unref (mapped);
+      return NULL;
+    }
+
+  return mapped;
+}
+
+/**
+ * gbp_codesearch_indexer_add_file:
+ * @builder: a #CodeIndexBuilder
+ * @workdir: the directory being indexed
+ * @path: the path of the file relative to @workdir
+ *
+ * Adds the trigrams of @path to @builder. Files which are missing, empty,
+ * too large or binary are skipped.
+ *
+ * Returns: %TRUE if the file was added
+ */
+gboolean
+gbp_codesearch_indexer_add_file (CodeIndexBuilder *builder,
+                                 GFile            *workdir,
+                                 const char       *path)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  CodeTrigramIter iter;
+  CodeTrigram trigram;
+
+  g_return_val_if_fail (builder != NULL, FALSE);
+  g_return_val_if_fail (G_IS_FILE (workdir), FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+
+  if (!(mapped = map_document (workdir, path)))
+    return FALSE;
+
+  code_index_builder_begin (builder, path);
+  code_trigram_iter_init (&iter,
+                          g_mapped_file_get_contents (mapped),
+                          g_mapped_file_get_length (mapped));
+  while (code_trigram_iter_next (&iter, &trigram))
+    code_index_builder_add (builder, &trigram);
+  code_index_builder_commit (builder);
+
+  return TRUE;
+}
+
+/**
+ * gbp_codesearch_indexer_build:
+ * @workdir: the directory to index
+ * @ignore_func: (nullable): a function to skip files and directories
+ * @ignore_data: closure data for @ignore_func
+ * @cancellable: (nullable): a #GCancellable
+ * @error: a location for a #GError
+ *
+ * Indexes the regular files found within @workdir. Symbolic links are not
+ * followed since the files they point to are indexed in their rightful
+ * place when they are part of the project.
+ *
+ * This function is meant to be called from a thread.
+ *
+ * Returns: (transfer full): a #CodeIndexBuilder or %NULL if cancelled
+ */
+CodeIndexBuilder *
+gbp_codesearch_indexer_build (GFile                    *workdir,
+                              GbpCodesearchIgnoreFunc   ignore_func,
+                              gpointer                  ignore_data,
+                              GCancellable             *cancellable,
+                              GError                  **error)
+{
+  g_autoptr(CodeIndexBuilder) builder = NULL;
+  g_autoqueue(GFile) directories = NULL;
+  GFile *directory;
+
+  g_return_val_if_fail (G_IS_FILE (workdir), NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  builder = code_index_builder_new ();
+  directories = g_queue_new ();
+  g_queue_push_tail (directories, g_object_ref (workdir));
+
+  while ((directory = g_queue_pop_head (directories)))
+    {
+      g_autoptr(GFileEnumerator) enumerator = NULL;
+      g_autoptr(GFile) freeme = directory;
+      gpointer infoptr;
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return NULL;
+
+      enumerator = g_file_enumerate_children (directory,
+                                              G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                              G_FILE_ATTRIBUTE_STANDARD_IS_SYMLINK","
+                                              G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                              cancellable,
+                                              NULL);
+
+      if (enumerator == NULL)
+        continue;
+
+      while ((infoptr = g_file_enumerator_next_file (enumerator, cancellable, NULL)))
+        {
+          g_autoptr(GFileInfo) info = infoptr;
+          g_autoptr(GFile) file = NULL;
+          g_autofree char *path = NULL;
+          GFileType file_type;
+
+          if (g_file_info_get_is_symlink (info))
+            continue;
+
+          file_type = g_file_info_get_file_type (info);
+
+          if (file_type != G_FILE_TYPE_DIRECTORY &&
+              file_type != G_FILE_TYPE_REGULAR)
+            continue;
+
+          file = g_file_enumerator_get_child (enumerator, info);
+
+          if (ignore_func != NULL && ignore_func (file, ignore_data))
+            continue;
+
+          if (file_type == G_FILE_TYPE_DIRECTORY)
+            {
+              g_queue_push_tail (directories, g_steal_pointer (&file));
+              continue;
+            }
+
+          if ((path = g_file_get_relative_path (workdir, file)))
+            gbp_codesearch_indexer_add_file (builder, workdir, path);
+        }
+    }
+
+  return g_steal_pointer (&builder);
+}
+
+/**
+ * gbp_codesearch_indexer_write:
+ * @builder: a #CodeIndexBuilder
+ * @filename: the path to write the index to
+ * @error: a location for a #GError
+ *
+ * Atomically replaces @filename with the contents of @builder and loads
+ * the resulting index. Indexes which are already loaded keep using their
+ * own copy of the file.
+ *
+ * Returns: (transfer full): a #CodeIndex or %NULL and @error is set
+ */
+CodeIndex *
+gbp_codesearch_indexer_write (CodeIndexBuilder  *builder,
+                              const char        *filename,
+                              GError           **error)
+{
+  g_autoptr(GBytes) bytes = NULL;
+  g_autofree char *directory = NULL;
+
+  g_return_val_if_fail (builder != NULL, NULL);
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  directory = g_path_get_dirname (filename);
+
+  if (g_mkdir_with_parents (directory, 0750) != 0)
+    {
+      int errsv = errno;
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           g_io_error_from_errno (errsv),
+                           g_strerror (errsv));
+      return NULL;
+    }
+
+  bytes = code_index_builder_to_bytes (builder);
+
+  if (!g_file_set_contents_full (filename,
+                                 g_bytes_get_data (bytes, NULL),
+                                 g_bytes_get_size (bytes),
+                                 G_FILE_SET_CONTENTS_CONSISTENT,
+                                 0640,
+                                 error))
+    return NULL;
+
+  return code_index_new (filename, error);
+}
+
+static char *
+make_text (const char *line,
+           gsize       len)
+{
+  g_autofree char *valid = NULL;
+
+  while (len > 0 && g_ascii_isspace (*line))
+    line++, len--;
+
+  valid = g_utf8_make_valid (line, MIN (len, MAX_TEXT_LEN));
+
+  return g_strchomp (g_steal_pointer (&valid));
+}
+
+static void
+search_document (GArray     *hits,
+                 GFile      *workdir,
+                 const char *path,
+                 const char *needle,
+                 gsize       needle_len,
+                 guint       max_results)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  const char *line_start;
+  const char *data;
+  const char *end;
+  const char *pos;
+  guint line = 0;
+
+  if (!(mapped = map_document (workdir, path)))
+    return;
+
+  data = g_mapped_file_get_contents (mapped);
+  end = data + g_mapped_file_get_length (mapped);
+  line_start = data;
+  pos = data;
+
+  while (hits->len < max_results && pos < end)
+    {
+      GbpCodesearchHit hit;
+      const char *match;
+      const char *line_end;
+      const char *nl;
+
+      if (!(match = memmem (pos, end - pos, needle, needle_len)))
+        break;
+
+      while ((nl = memchr (line_start, '\n', match - line_start)))
+        {
+          line_start = nl + 1;
+          line++;
+        }
+
+      if (!(line_end = memchr (match, '\n', end - match)))
+        line_end = end;
+
+      hit.path = g_strdup (path);
+      hit.text = make_text (line_start, line_end - line_start);
+      hit.line = line;
+      hit.line_offset = g_utf8_strlen (line_start, match - line_start);
+
+      g_array_append_val (hits, hit);
+
+      /* Only report the first match of each line */
+      if (line_end == end)
+        break;
+
+      line_start = pos = line_end + 1;
+      line++;
+    }
+}
+
+/**
+ * gbp_codesearch_indexer_search:
+ * @indexes: (array length=n_indexes): the indexes to search
+ * @n_indexes: the number of indexes
+ * @workdir: the directory that was indexed
+ * @needle: the text to search for
+ * @max_results: the maximum number of hits
+ * @cancellable: (nullable): a #GCancellable
+ *
+ * Finds the lines containing @needle within the documents of @indexes.
+ *
+ * The index only narrows down the documents which may contain @needle,
+ * each of them is then read from disk to locate the matches. That way
+ * documents which changed since they were indexed never produce stale
+ * hits. A document found in more than one index is searched once.
+ *
+ * @needle must be at least 3 characters long to be found in the index.
+ *
+ * Returns: (transfer full) (element-type GbpCodesearchHit): the hits
+ */
+GArray *
+gbp_codesearch_indexer_search (CodeIndex * const *indexes,
+                               guint              n_indexes,
+                               GFile             *workdir,
+                               const char        *needle,
+                               guint              max_results,
+                               GCancellable      *cancellable)
+{
+  g_autoptr(GHashTable) seen = NULL;
+  g_autoptr(GArray) trigrams = NULL;
+  g_autofree CodeIndexIter *iters = NULL;
+  CodeTrigramIter titer;
+  CodeTrigram trigram;
+  GArray *hits;
+  gsize needle_len;
+
+  g_return_val_if_fail (indexes != NULL || n_indexes == 0, NULL);
+  g_return_val_if_fail (G_IS_FILE (workdir), NULL);
+  g_return_val_if_fail (needle != NULL, NULL);
+
+  hits = g_array_new (FALSE, FALSE, sizeof (GbpCodesearchHit));
+  g_array_set_clear_func (hits, (GDestroyNotify)gbp_codesearch_hit_clear);
+
+  needle_len = strlen (needle);
+  trigrams = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  code_trigram_iter_init (&titer, needle, needle_len);
+  while (code_trigram_iter_next (&titer, &trigram))
+    {
+      guint trigram_id = code_trigram_encode (&trigram);
+      gboolean found = FALSE;
+
+      for (guint i = 0; !found && i < trigrams->len; i++)
+        found = g_array_index (trigrams, guint, i) == trigram_id;
+
+      if (!found)
+        g_array_append_val (trigrams, trigram_id);
+    }
+
+  if (trigrams->len == 0)
+    return hits;
+
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+  iters = g_new0 (CodeIndexIter, trigrams->len);
+
+  for (guint i = 0; i < n_indexes && hits->len < max_results; i++)
+    {
+      CodeDocument document;
+      gboolean missing = FALSE;
+
+      for (guint j = 0; !missing && j < trigrams->len; j++)
+        {
+          trigram = code_trigram_decode (g_array_index (trigrams, guint, j));
+          missing = !code_index_iter_init (&iters[j], indexes[i], &trigram);
+        }
+
+      if (missing)
+        continue;
+
+      code_index_iter_sort (iters, trigrams->len);
+
+      while (hits->len < max_results &&
+             code_index_iter_intersect (iters, trigrams->len, &document))
+        {
+          if (g_cancellable_is_cancelled (cancellable))
+            return hits;
+
+          /* Paths point into the mapped index, which outlives @seen */
+          if (!g_hash_table_add (seen, (char *)document.path))
+            continue;
+
+          search_document (hits, workdir, document.path, needle, needle_len, max_results);
+        }
+    }
+
+  return hits;
+}
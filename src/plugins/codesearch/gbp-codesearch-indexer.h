@@ -0,0 +1,65 @@
+/* gbp-codesearch-indexer.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "code-index.h"
+
+G_BEGIN_DECLS
+
+/* These helpers do not depend on an IdeContext so that they may be used
+ * from a thread and tested without a project.
+ */
+
+typedef gboolean (*GbpCodesearchIgnoreFunc) (GFile    *file,
+                                             gpointer  user_data);
+
+typedef struct _GbpCodesearchHit
+{
+  /* Relative to the directory that was indexed */
+  char  *path;
+  /* The line containing the match, truncated */
+  char  *text;
+  guint  line;
+  guint  line_offset;
+} GbpCodesearchHit;
+
+void              gbp_codesearch_hit_clear        (GbpCodesearchHit         *hit);
+gboolean          gbp_codesearch_indexer_add_file (CodeIndexBuilder         *builder,
+                                                   GFile                    *workdir,
+                                                   const char               *path);
+CodeIndexBuilder *gbp_codesearch_indexer_build    (GFile                    *workdir,
+                                                   GbpCodesearchIgnoreFunc   ignore_func,
+                                                   gpointer                  ignore_data,
+                                                   GCancellable             *cancellable,
+                                                   GError                  **error);
+CodeIndex        *gbp_codesearch_indexer_write    (CodeIndexBuilder         *builder,
+                                                   const char               *filename,
+                                                   GError                  **error);
+GArray           *gbp_codesearch_indexer_search   (CodeIndex * const        *indexes,
+                                                   guint                     n_indexes,
+                                                   GFile                    *workdir,
+                                                   const char               *needle,
+                                                   guint                     max_results,
+                                                   GCancellable             *cancellable);
+
+G_END_DECLS
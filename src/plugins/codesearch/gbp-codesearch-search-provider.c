@@ -22,15 +22,173 @@
 
 #include "config.h"
 
+#include <string.h>
+
+#include <glib/gi18n.h>
+
+#include <libide-code.h>
 #include <libide-search.h>
+#include <libide-threading.h>
 
+#include "gbp-codesearch-indexer.h"
 #include "gbp-codesearch-search-provider.h"
+#include "gbp-codesearch-search-result.h"
+#include "gbp-codesearch-service.h"
+
+/* Trigrams are the smallest unit the index can answer */
+#define MIN_NEEDLE_LEN 3
 
 struct _GbpCodesearchSearchProvider
 {
   IdeObject parent_instance;
 };
 
+static void
+gbp_codesearch_search_provider_search_cb (GObject      *object,
+                                          GAsyncResult *result,
+                                          gpointer      user_data)
+{
+  GbpCodesearchService *service = (GbpCodesearchService *)object;
+  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(GListStore) store = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GArray) hits = NULL;
+  g_autoptr(GFile) workdir = NULL;
+  g_autoptr(GIcon) icon = NULL;
+  IdeContext *context;
+  guint max_results;
+
+  IDE_ENTRY;
+
+  g_assert (GBP_IS_CODESEARCH_SERVICE (service));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_TASK (task));
+
+  if (!(hits = gbp_codesearch_service_search_finish (service, result, &error)))
+    {
+      ide_task_return_error (task, g_steal_pointer (&error));
+      IDE_EXIT;
+    }
+
+  context = ide_object_get_context (IDE_OBJECT (service));
+  workdir = ide_context_ref_workdir (context);
+  icon = g_themed_icon_new ("edit-find-symbolic");
+  store = g_list_store_new (IDE_TYPE_SEARCH_RESULT);
+  max_results = GPOINTER_TO_UINT (ide_task_get_task_data (task));
+
+  for (guint i = 0; i < hits->len; i++)
+    {
+      const GbpCodesearchHit *hit = &g_array_index (hits, GbpCodesearchHit, i);
+      g_autoptr(GbpCodesearchSearchResult) item = NULL;
+      g_autoptr(IdeLocation) location = NULL;
+      g_autoptr(GFile) file = g_file_get_child (workdir, hit->path);
+      g_autofree char *subtitle = g_strdup_printf ("%s:%u", hit->path, hit->line + 1);
+
+      location = ide_location_new (file, hit->line, hit->line_offset);
+      item = gbp_codesearch_search_result_new (hit->text, subtitle, icon, location, 0);
+      g_list_store_append (store, item);
+    }
+
+  if (hits->len >= max_results)
+    g_object_set_data (G_OBJECT (task), "TRUNCATED", GINT_TO_POINTER (TRUE));
+
+  ide_task_return_pointer (task, g_steal_pointer (&store), g_object_unref);
+
+  IDE_EXIT;
+}
+
+static void
+gbp_codesearch_search_provider_search_async (IdeSearchProvider   *provider,
+                                             const char          *search_terms,
+                                             guint                max_results,
+                                             GCancellable        *cancellable,
+                                             GAsyncReadyCallback  callback,
+                                             gpointer             user_data)
+{
+  GbpCodesearchSearchProvider *self = (GbpCodesearchSearchProvider *)provider;
+  g_autoptr(IdeTask) task = NULL;
+  GbpCodesearchService *service;
+  IdeContext *context;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (GBP_IS_CODESEARCH_SEARCH_PROVIDER (self));
+  g_assert (search_terms != NULL);
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = ide_task_new (self, cancellable, callback, user_data);
+  ide_task_set_source_tag (task, gbp_codesearch_search_provider_search_async);
+  ide_task_set_priority (task, G_PRIORITY_LOW);
+  ide_task_set_task_data (task, GUINT_TO_POINTER (max_results), NULL);
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+
+  if (context == NULL || !ide_context_has_project (context))
+    {
+      ide_task_return_unsupported_error (task);
+      IDE_EXIT;
+    }
+
+  if (strlen (search_terms) < MIN_NEEDLE_LEN)
+    {
+      ide_task_return_pointer (task,
+                               g_list_store_new (IDE_TYPE_SEARCH_RESULT),
+                               g_object_unref);
+      IDE_EXIT;
+    }
+
+  service = gbp_codesearch_service_from_context (context);
+
+  gbp_codesearch_service_search_async (service,
+                                       search_terms,
+                                       max_results,
+                                       cancellable,
+                                       gbp_codesearch_search_provider_search_cb,
+                                       g_steal_pointer (&task));
+
+  IDE_EXIT;
+}
+
+static GListModel *
+gbp_codesearch_search_provider_search_finish (IdeSearchProvider  *provider,
+                                              GAsyncResult       *result,
+                                              gboolean           *truncated,
+                                              GError            **error)
+{
+  GListModel *ret;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (GBP_IS_CODESEARCH_SEARCH_PROVIDER (provider));
+  g_assert (IDE_IS_TASK (result));
+
+  ret = ide_task_propagate_pointer (IDE_TASK (result), error);
+
+  *truncated = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (result), "TRUNCATED"));
+
+  IDE_RETURN (ret);
+}
+
+static char *
+gbp_codesearch_search_provider_dup_title (IdeSearchProvider *provider)
+{
+  return g_strdup (_("Code Search"));
+}
+
+static GIcon *
+gbp_codesearch_search_provider_dup_icon (IdeSearchProvider *provider)
+{
+  return g_themed_icon_new ("edit-find-symbolic");
+}
+
+static IdeSearchCategory
+gbp_codesearch_search_provider_get_category (IdeSearchProvider *provider)
+{
+  return IDE_SEARCH_CATEGORY_OTHER;
+}
+
 static void
 gbp_codesearch_search_provider_load (IdeSearchProvider *provider)
 {
@@ -58,6 +216,11 @@ search_provider_iface_init (IdeSearchProviderInterface *iface)
 {
   iface->load = gbp_codesearch_search_provider_load;
   iface->unload = gbp_codesearch_search_provider_unload;
+  iface->search_async = gbp_codesearch_search_provider_search_async;
+  iface->search_finish = gbp_codesearch_search_provider_search_finish;
+  iface->dup_title = gbp_codesearch_search_provider_dup_title;
+  iface->dup_icon = gbp_codesearch_search_provider_dup_icon;
+  iface->get_category = gbp_codesearch_search_provider_get_category;
 }
 
 G_DEFINE_FINAL_TYPE_WITH_CODE (GbpCodesearchSearchProvider, gbp_codesearch_search_provider, IDE_TYPE_OBJECT,
@@ -0,0 +1,618 @@
+/* gbp-codesearch-service.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "gbp-codesearch-service"
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+
+#include <libide-threading.h>
+#include <libide-vcs.h>
+
+#include "gbp-codesearch-indexer.h"
+#include "gbp-codesearch-service.h"
+
+/* The project is indexed in full when it is loaded. Files changed after
+ * that are indexed again into a small delta index which is searched along
+ * with the full index. Once enough changes have accumulated, or enough
+ * time has passed, the delta is merged back into the full index.
+ */
+#define UPDATE_DELAY_SECS  5
+#define MERGE_THRESHOLD    250
+#define MERGE_INTERVAL_SEC (60 * 10)
+
+struct _GbpCodesearchService
+{
+  IdeObject     parent_instance;
+
+  GCancellable *cancellable;
+  GFile        *workdir;
+  char         *index_path;
+  char         *delta_path;
+
+  CodeIndex    *index;
+  CodeIndex    *delta;
+
+  /* Relative path to the serial of its last change, for every file which
+   * changed since the delta was last merged into the index.
+   */
+  GHashTable   *changed;
+  guint64       serial;
+
+  gint64        last_merge;
+  guint         update_source;
+
+  guint         started : 1;
+  guint         building : 1;
+};
+
+typedef struct
+{
+  GFile      *workdir;
+  IdeVcs     *vcs;
+  char       *index_path;
+  char       *delta_path;
+  CodeIndex  *index;
+  GHashTable *changed;
+  guint64     serial;
+  guint       merge : 1;
+} Update;
+
+typedef struct
+{
+  GFile     *workdir;
+  CodeIndex *indexes[2];
+  guint      n_indexes;
+  char      *needle;
+  guint      max_results;
+} Search;
+
+G_DEFINE_FINAL_TYPE (GbpCodesearchService, gbp_codesearch_service, IDE_TYPE_OBJECT)
+
+static void gbp_codesearch_service_queue_update (GbpCodesearchService *self);
+
+static void
+update_free (Update *update)
+{
+  g_clear_object (&update->workdir);
+  g_clear_object (&update->vcs);
+  g_clear_pointer (&update->index_path, g_free);
+  g_clear_pointer (&update->delta_path, g_free);
+  g_clear_pointer (&update->index, code_index_unref);
+  g_clear_pointer (&update->changed, g_hash_table_unref);
+  g_free (update);
+}
+
+static void
+search_free (Search *search)
+{
+  g_clear_object (&search->workdir);
+  for (guint i = 0; i < search->n_indexes; i++)
+    g_clear_pointer (&search->indexes[i], code_index_unref);
+  g_clear_pointer (&search->needle, g_free);
+  g_free (search);
+}
+
+static gboolean
+is_ignored (GFile    *file,
+            gpointer  user_data)
+{
+  return ide_vcs_is_ignored (IDE_VCS (user_data), file, NULL);
+}
+
+static gboolean
+is_unchanged (CodeIndex  *index,
+              const char *path,
+              gpointer    user_data)
+{
+  return !g_hash_table_contains (user_data, path);
+}
+
+static void
+log_index (CodeIndex *index,
+           GTimer    *timer,
+           gboolean   merged)
+{
+  CodeIndexStat stat;
+
+  code_index_stat (index, &stat);
+
+  g_debug ("%s %u documents in %lf seconds (%u trigrams, %u bytes of postings)",
+           merged ? "Indexed" : "Indexed changes to",
+           stat.n_documents - 1,
+           g_timer_elapsed (timer, NULL),
+           stat.n_trigrams,
+           stat.trigrams_data_bytes);
+}
+
+static void
+gbp_codesearch_service_build_worker (IdeTask      *task,
+                                     gpointer      source_object,
+                                     gpointer      task_data,
+                                     GCancellable *cancellable)
+{
+  g_autoptr(CodeIndexBuilder) builder = NULL;
+  g_autoptr(CodeIndex) index = NULL;
+  g_autoptr(GTimer) timer = g_timer_new ();
+  g_autoptr(GError) error = NULL;
+  Update *update = task_data;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_TASK (task));
+  g_assert (GBP_IS_CODESEARCH_SERVICE (source_object));
+  g_assert (update != NULL);
+  g_assert (G_IS_FILE (update->workdir));
+  g_assert (IDE_IS_VCS (update->vcs));
+
+  if (!(builder = gbp_codesearch_indexer_build (update->workdir,
+                                                is_ignored,
+                                                update->vcs,
+                                                cancellable,
+                                                &error)) ||
+      !(index = gbp_codesearch_indexer_write (builder, update->index_path, &error)))
+    {
+      ide_task_return_error (task, g_steal_pointer (&error));
+      IDE_EXIT;
+    }
+
+  log_index (index, timer, TRUE);
+
+  g_unlink (update->delta_path);
+
+  ide_task_return_pointer (task, g_steal_pointer (&index), code_index_unref);
+
+  IDE_EXIT;
+}
+
+static void
+gbp_codesearch_service_update_worker (IdeTask      *task,
+                                      gpointer      source_object,
+                                      gpointer      task_data,
+                                      GCancellable *cancellable)
+{
+  g_autoptr(CodeIndexBuilder) builder = NULL;
+  g_autoptr(CodeIndex) index = NULL;
+  g_autoptr(GTimer) timer = g_timer_new ();
+  g_autoptr(GError) error = NULL;
+  Update *update = task_data;
+  GHashTableIter iter;
+  const char *path;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_TASK (task));
+  g_assert (GBP_IS_CODESEARCH_SERVICE (source_object));
+  g_assert (update != NULL);
+  g_assert (update->changed != NULL);
+
+  builder = code_index_builder_new ();
+
+  /* Changed documents are left out of the index as they are added
+   * again below, with their new contents.
+   */
+  if (update->merge)
+    code_index_builder_merge_full (builder, update->index, is_unchanged, update->changed);
+
+  g_hash_table_iter_init (&iter, update->changed);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&path, NULL))
+    {
+      g_autoptr(GFile) file = g_file_get_child (update->workdir, path);
+
+      if (!is_ignored (file, update->vcs))
+        gbp_codesearch_indexer_add_file (builder, update->workdir, path);
+    }
+
+  if (!(index = gbp_codesearch_indexer_write (builder,
+                                              update->merge ? update->index_path : update->delta_path,
+                                              &error)))
+    {
+      ide_task_return_error (task, g_steal_pointer (&error));
+      IDE_EXIT;
+    }
+
+  log_index (index, timer, update->merge);
+
+  if (update->merge)
+    g_unlink (update->delta_path);
+
+  ide_task_return_pointer (task, g_steal_pointer (&index), code_index_unref);
+
+  IDE_EXIT;
+}
+
+static void
+gbp_codesearch_service_forget_changes (GbpCodesearchService *self,
+                                       guint64               serial)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_assert (GBP_IS_CODESEARCH_SERVICE (self));
+
+  /* Keep the files which changed again while we were indexing */
+  g_hash_table_iter_init (&iter, self->changed);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      if (*(guint64 *)value <= serial)
+        g_hash_table_iter_remove (&iter);
+    }
+}
+
+static void
+gbp_codesearch_service_update_cb (GObject      *object,
+                                  GAsyncResult *result,
+                                  gpointer      user_data)
+{
+  GbpCodesearchService *self = (GbpCodesearchService *)object;
+  g_autoptr(CodeIndex) index = NULL;
+  g_autoptr(GError) error = NULL;
+  Update *update;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (GBP_IS_CODESEARCH_SERVICE (self));
+  g_assert (IDE_IS_TASK (result));
+
+  self->building = FALSE;
+
+  if (ide_object_in_destruction (IDE_OBJECT (self)))
+    IDE_EXIT;
+
+  update = ide_task_get_task_data (IDE_TASK (result));
+
+  if (!(index = ide_task_propagate_pointer (IDE_TASK (result), &error)))
+    {
+      if (!ide_error_ignore (error))
+        g_warning ("Failed to index project: %s", error->message);
+      IDE_EXIT;
+    }
+
+  if (update->merge)
+    {
+      g_clear_pointer (&self->index, code_index_unref);
+      g_clear_pointer (&self->delta, code_index_unref);
+      self->index = g_steal_pointer (&index);
+      self->last_merge = g_get_monotonic_time ();
+
+      gbp_codesearch_service_forget_changes (self, update->serial);
+    }
+  else
+    {
+      g_clear_pointer (&self->delta, code_index_unref);
+      self->delta = g_steal_pointer (&index);
+    }
+
+  if (self->serial > update->serial)
+    gbp_codesearch_service_queue_update (self);
+
+  IDE_EXIT;
+}
+
+static Update *
+gbp_codesearch_service_create_update (GbpCodesearchService *self,
+                                      IdeContext           *context)
+{
+  Update *update;
+
+  g_assert (GBP_IS_CODESEARCH_SERVICE (self));
+  g_assert (IDE_IS_CONTEXT (context));
+
+  update = g_new0 (Update, 1);
+  update->workdir = g_object_ref (self->workdir);
+  update->vcs = ide_vcs_ref_from_context (context);
+  update->index_path = g_strdup (self->index_path);
+  update->delta_path = g_strdup (self->delta_path);
+  update->serial = self->serial;
+
+  return update;
+}
+
+static gboolean
+gbp_codesearch_service_update_source_cb (gpointer user_data)
+{
+  GbpCodesearchService *self = user_data;
+  g_autoptr(IdeContext) context = NULL;
+  g_autoptr(IdeTask) task = NULL;
+  GHashTableIter iter;
+  gpointer key;
+  Update *update;
+  gint64 now;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (GBP_IS_CODESEARCH_SERVICE (self));
+
+  self->update_source = 0;
+
+  /* Changes are picked up when the current build completes */
+  if (self->building ||
+      g_hash_table_size (self->changed) == 0 ||
+      !(context = ide_object_ref_context (IDE_OBJECT (self))))
+    IDE_RETURN (G_SOURCE_REMOVE);
+
+  now = g_get_monotonic_time ();
+
+  update = gbp_codesearch_service_create_update (self, context);
+  update->changed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  g_hash_table_iter_init (&iter, self->changed);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    g_hash_table_add (update->changed, g_strdup (key));
+
+  if (self->index != NULL &&
+      (g_hash_table_size (self->changed) >= MERGE_THRESHOLD ||
+       now - self->last_merge >= MERGE_INTERVAL_SEC * G_USEC_PER_SEC))
+    {
+      update->index = code_index_ref (self->index);
+      update->merge = TRUE;
+    }
+
+  self->building = TRUE;
+
+  task = ide_task_new (self, self->cancellable, gbp_codesearch_service_update_cb, NULL);
+  ide_task_set_source_tag (task, gbp_codesearch_service_update_source_cb);
+  ide_task_set_priority (task, G_PRIORITY_LOW);
+  ide_task_set_kind (task, IDE_TASK_KIND_INDEXER);
+  ide_task_set_task_data (task, update, update_free);
+  ide_task_run_in_thread (task, gbp_codesearch_service_update_worker);
+
+  IDE_RETURN (G_SOURCE_REMOVE);
+}
+
+static void
+gbp_codesearch_service_queue_update (GbpCodesearchService *self)
+{
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (GBP_IS_CODESEARCH_SERVICE (self));
+
+  if (self->update_source == 0)
+    self->update_source = g_timeout_add_seconds_full (G_PRIORITY_LOW,
+                                                      UPDATE_DELAY_SECS,
+                                                      gbp_codesearch_service_update_source_cb,
+                                                      self,
+                                                      NULL);
+}
+
+static void
+gbp_codesearch_service_destroy (IdeObject *object)
+{
+  GbpCodesearchService *self = (GbpCodesearchService *)object;
+
+  g_cancellable_cancel (self->cancellable);
+  g_clear_object (&self->cancellable);
+  g_clear_handle_id (&self->update_source, g_source_remove);
+
+  g_clear_pointer (&self->index, code_index_unref);
+  g_clear_pointer (&self->delta, code_index_unref);
+
+  IDE_OBJECT_CLASS (gbp_codesearch_service_parent_class)->destroy (object);
+}
+
+static void
+gbp_codesearch_service_finalize (GObject *object)
+{
+  GbpCodesearchService *self = (GbpCodesearchService *)object;
+
+  g_clear_object (&self->workdir);
+  g_clear_pointer (&self->index_path, g_free);
+  g_clear_pointer (&self->delta_path, g_free);
+  g_clear_pointer (&self->changed, g_hash_table_unref);
+
+  G_OBJECT_CLASS (gbp_codesearch_service_parent_class)->finalize (object);
+}
+
+static void
+gbp_codesearch_service_class_init (GbpCodesearchServiceClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  IdeObjectClass *i_object_class = IDE_OBJECT_CLASS (klass);
+
+  object_class->finalize = gbp_codesearch_service_finalize;
+
+  i_object_class->destroy = gbp_codesearch_service_destroy;
+}
+
+static void
+gbp_codesearch_service_init (GbpCodesearchService *self)
+{
+  self->cancellable = g_cancellable_new ();
+  self->changed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+void
+gbp_codesearch_service_start (GbpCodesearchService *self)
+{
+  g_autoptr(IdeContext) context = NULL;
+  g_autoptr(IdeTask) task = NULL;
+  g_autoptr(GError) error = NULL;
+  Update *update;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+  g_return_if_fail (GBP_IS_CODESEARCH_SERVICE (self));
+  g_return_if_fail (self->started == FALSE);
+
+  self->started = TRUE;
+
+  if (!(context = ide_object_ref_context (IDE_OBJECT (self))))
+    IDE_EXIT;
+
+  self->workdir = ide_context_ref_workdir (context);
+  self->index_path = ide_context_cache_filename (context, "codesearch", "project.index", NULL);
+  self->delta_path = ide_context_cache_filename (context, "codesearch", "delta.index", NULL);
+
+  /* Use the index from the previous session until the new one is ready,
+   * files might have changed while the project was closed.
+   */
+  if (!(self->index = code_index_new (self->index_path, &error)))
+    g_debug ("No previous index to load: %s", error->message);
+
+  update = gbp_codesearch_service_create_update (self, context);
+  update->merge = TRUE;
+
+  self->building = TRUE;
+
+  task = ide_task_new (self, self->cancellable, gbp_codesearch_service_update_cb, NULL);
+  ide_task_set_source_tag (task, gbp_codesearch_service_start);
+  ide_task_set_priority (task, G_PRIORITY_LOW);
+  ide_task_set_kind (task, IDE_TASK_KIND_INDEXER);
+  ide_task_set_task_data (task, update, update_free);
+  ide_task_run_in_thread (task, gbp_codesearch_service_build_worker);
+
+  IDE_EXIT;
+}
+
+GbpCodesearchService *
+gbp_codesearch_service_from_context (IdeContext *context)
+{
+  GbpCodesearchService *ret;
+
+  g_return_val_if_fail (IDE_IS_CONTEXT (context), NULL);
+
+  if (!(ret = ide_context_peek_child_typed (context, GBP_TYPE_CODESEARCH_SERVICE)))
+    {
+      g_autoptr(GbpCodesearchService) self = NULL;
+
+      self = g_object_new (GBP_TYPE_CODESEARCH_SERVICE,
+                           "parent", context,
+                           NULL);
+      gbp_codesearch_service_start (self);
+      ret = ide_context_peek_child_typed (context, GBP_TYPE_CODESEARCH_SERVICE);
+    }
+
+  return ret;
+}
+
+void
+gbp_codesearch_service_file_changed (GbpCodesearchService *self,
+                                     GFile                *file)
+{
+  g_autofree char *path = NULL;
+
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+  g_return_if_fail (GBP_IS_CODESEARCH_SERVICE (self));
+  g_return_if_fail (G_IS_FILE (file));
+
+  if (self->workdir == NULL ||
+      !(path = g_file_get_relative_path (self->workdir, file)))
+    return;
+
+  self->serial++;
+
+  g_hash_table_insert (self->changed,
+                       g_steal_pointer (&path),
+                       g_memdup2 (&self->serial, sizeof self->serial));
+
+  gbp_codesearch_service_queue_update (self);
+}
+
+static void
+gbp_codesearch_service_search_worker (IdeTask      *task,
+                                      gpointer      source_object,
+                                      gpointer      task_data,
+                                      GCancellable *cancellable)
+{
+  g_autoptr(GTimer) timer = g_timer_new ();
+  Search *search = task_data;
+  GArray *hits;
+
+  g_assert (IDE_IS_TASK (task));
+  g_assert (GBP_IS_CODESEARCH_SERVICE (source_object));
+  g_assert (search != NULL);
+
+  hits = gbp_codesearch_indexer_search (search->indexes,
+                                        search->n_indexes,
+                                        search->workdir,
+                                        search->needle,
+                                        search->max_results,
+                                        cancellable);
+
+  g_debug ("Found %u hits for `%s` in %lf seconds",
+           hits->len, search->needle, g_timer_elapsed (timer, NULL));
+
+  ide_task_return_pointer (task, hits, g_array_unref);
+}
+
+void
+gbp_codesearch_service_search_async (GbpCodesearchService *self,
+                                     const char           *needle,
+                                     guint                 max_results,
+                                     GCancellable         *cancellable,
+                                     GAsyncReadyCallback   callback,
+                                     gpointer              user_data)
+{
+  g_autoptr(IdeTask) task = NULL;
+  Search *search;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+  g_return_if_fail (GBP_IS_CODESEARCH_SERVICE (self));
+  g_return_if_fail (needle != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = ide_task_new (self, cancellable, callback, user_data);
+  ide_task_set_source_tag (task, gbp_codesearch_service_search_async);
+  ide_task_set_priority (task, G_PRIORITY_LOW);
+
+  if (self->index == NULL && self->delta == NULL)
+    {
+      ide_task_return_new_error (task,
+                                 G_IO_ERROR,
+                                 G_IO_ERROR_NOT_INITIALIZED,
+                                 "The project has not been indexed yet");
+      IDE_EXIT;
+    }
+
+  search = g_new0 (Search, 1);
+  search->workdir = g_object_ref (self->workdir);
+  search->needle = g_strdup (needle);
+  search->max_results = max_results;
+  if (self->index != NULL)
+    search->indexes[search->n_indexes++] = code_index_ref (self->index);
+  if (self->delta != NULL)
+    search->indexes[search->n_indexes++] = code_index_ref (self->delta);
+
+  ide_task_set_task_data (task, search, search_free);
+  ide_task_run_in_thread (task, gbp_codesearch_service_search_worker);
+
+  IDE_EXIT;
+}
+
+/**
+ * gbp_codesearch_service_search_finish:
+ *
+ * Returns: (transfer full) (element-type GbpCodesearchHit): the hits
+ */
+GArray *
+gbp_codesearch_service_search_finish (GbpCodesearchService  *self,
+                                      GAsyncResult          *result,
+                                      GError               **error)
+{
+  g_return_val_if_fail (GBP_IS_CODESEARCH_SERVICE (self), NULL);
+  g_return_val_if_fail (IDE_IS_TASK (result), NULL);
+
+  return ide_task_propagate_pointer (IDE_TASK (result), error);
+}
@@ -0,0 +1,45 @@
+/* gbp-codesearch-service.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <libide-core.h>
+
+G_BEGIN_DECLS
+
+#define GBP_TYPE_CODESEARCH_SERVICE (gbp_codesearch_service_get_type())
+
+G_DECLARE_FINAL_TYPE (GbpCodesearchService, gbp_codesearch_service, GBP, CODESEARCH_SERVICE, IdeObject)
+
+GbpCodesearchService *gbp_codesearch_service_from_context (IdeContext            *context);
+void                  gbp_codesearch_service_start        (GbpCodesearchService  *self);
+void                  gbp_codesearch_service_file_changed (GbpCodesearchService  *self,
+                                                           GFile                 *file);
+void                  gbp_codesearch_service_search_async (GbpCodesearchService  *self,
+                                                           const char            *needle,
+                                                           guint                  max_results,
+                                                           GCancellable          *cancellable,
+                                                           GAsyncReadyCallback    callback,
+                                                           gpointer               user_data);
+GArray               *gbp_codesearch_service_search_finish (GbpCodesearchService  *self,
+                                                            GAsyncResult          *result,
+                                                            GError               **error);
+
+G_END_DECLS
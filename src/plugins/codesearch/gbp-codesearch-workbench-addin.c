@@ -25,11 +25,13 @@
 
 #include <libide-gui.h>
 
+#include "gbp-codesearch-service.h"
 #include "gbp-codesearch-workbench-addin.h"
 
 struct _GbpCodesearchWorkbenchAddin
 {
   GObject       parent_instance;
+  IdeWorkbench *workbench;
   GSignalGroup *signals;
   GSignalGroup *monitor_signals;
 };
@@ -68,6 +70,36 @@ gbp_codesearch_workbench_addin_changed_cb (GbpCodesearchWorkbenchAddin *self,
   g_assert (!other_file || G_IS_FILE (other_file));
   g_assert (IDE_IS_VCS_MONITOR (vcs_monitor));
 
+  if (self->workbench == NULL || !ide_workbench_has_project (self->workbench))
+    IDE_EXIT;
+
+  switch (event)
+    {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+    case G_FILE_MONITOR_EVENT_RENAMED:
+      {
+        IdeContext *context = ide_workbench_get_context (self->workbench);
+        GbpCodesearchService *service = gbp_codesearch_service_from_context (context);
+
+        gbp_codesearch_service_file_changed (service, file);
+
+        if (other_file != NULL)
+          gbp_codesearch_service_file_changed (service, other_file);
+      }
+      break;
+
+    case G_FILE_MONITOR_EVENT_CHANGED:
+    case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+    case G_FILE_MONITOR_EVENT_PRE_UNMOUNT:
+    case G_FILE_MONITOR_EVENT_UNMOUNTED:
+    case G_FILE_MONITOR_EVENT_MOVED:
+    default:
+      break;
+    }
 
   IDE_EXIT;
 }
@@ -85,6 +117,8 @@ gbp_codesearch_workbench_addin_load (IdeWorkbenchAddin *addin,
   g_assert (GBP_IS_CODESEARCH_WORKBENCH_ADDIN (self));
   g_assert (IDE_IS_WORKBENCH (workbench));
 
+  self->workbench = workbench;
+
   vcs_monitor = ide_workbench_get_vcs_monitor (workbench);
 
   self->signals = g_signal_group_new (IDE_TYPE_WORKBENCH);
@@ -125,6 +159,29 @@ gbp_codesearch_workbench_addin_unload (IdeWorkbenchAddin *addin,
   g_clear_object (&self->signals);
   g_clear_object (&self->monitor_signals);
 
+  self->workbench = NULL;
+
+  IDE_EXIT;
+}
+
+static void
+gbp_codesearch_workbench_addin_project_loaded (IdeWorkbenchAddin *addin,
+                                               IdeProjectInfo    *project_info)
+{
+  GbpCodesearchWorkbenchAddin *self = (GbpCodesearchWorkbenchAddin *)addin;
+  IdeContext *context;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (GBP_IS_CODESEARCH_WORKBENCH_ADDIN (self));
+  g_assert (IDE_IS_PROJECT_INFO (project_info));
+  g_assert (IDE_IS_WORKBENCH (self->workbench));
+
+  /* Start indexing right away rather than on the first search */
+  context = ide_workbench_get_context (self->workbench);
+  gbp_codesearch_service_from_context (context);
+
   IDE_EXIT;
 }
 
@@ -133,6 +190,7 @@ workbench_addin_iface_init (IdeWorkbenchAddinInterface *iface)
 {
   iface->load = gbp_codesearch_workbench_addin_load;
   iface->unload = gbp_codesearch_workbench_addin_unload;
+  iface->project_loaded = gbp_codesearch_workbench_addin_project_loaded;
 }
 
 G_DEFINE_FINAL_TYPE_WITH_CODE (GbpCodesearchWorkbenchAddin, gbp_codesearch_workbench_addin, G_TYPE_OBJECT,
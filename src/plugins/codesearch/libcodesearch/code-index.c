@@ -25,8 +25,22 @@
 #include "code-sparse-set.h"
 
 #define CODE_INDEX_MAGIC     {0xC,0x0,0xD,0xE}
+#define CODE_INDEX_VERSION   2
 #define CODE_INDEX_ALIGNMENT 8
 
+/* Each posting list starts with a skip table holding the last document id
+ * of every block along with the offset of the block from the start of the
+ * list. That way seeking only decodes the block which may contain the
+ * document. Blocks hold up to CODE_INDEX_BLOCK_SIZE ids as the deltas
+ * between them (minus one), bit-packed at the width of the largest delta
+ * which is stored in the first byte of the block.
+ */
+typedef struct _CodeIndexSkip
+{
+  guint32 last_document_id;
+  guint32 offset;
+} CodeIndexSkip;
+
 G_DEFINE_BOXED_TYPE (CodeIndex, code_index,
                      code_index_ref, code_index_unref)
 G_DEFINE_BOXED_TYPE (CodeIndexBuilder, code_index_builder,
@@ -45,6 +59,80 @@ write_uint (GByteArray *bytes,
   while (value > 0);
 }
 
+static inline gboolean
+read_uint (const guint8 **pos,
+           const guint8  *end,
+           guint         *value)
+{
+  guint u = 0, o = 0;
+  guint8 b;
+
+  do
+    {
+      if (*pos >= end || o > 28)
+        return FALSE;
+
+      b = **pos;
+      u |= ((guint32)(b & 0x7F) << o);
+      o += 7;
+
+      (*pos)++;
+    }
+  while ((b & 0x80) != 0);
+
+  *value = u;
+
+  return TRUE;
+}
+
+static void
+write_block (GByteArray    *bytes,
+             const guint32 *ids,
+             guint          n_ids,
+             guint32        last)
+{
+  guint32 deltas[CODE_INDEX_BLOCK_SIZE];
+  guint32 max = 0;
+  guint64 acc = 0;
+  guint bits = 0;
+  guint8 width;
+
+  g_assert (n_ids > 0);
+  g_assert (n_ids <= CODE_INDEX_BLOCK_SIZE);
+
+  for (guint i = 0; i < n_ids; i++)
+    {
+      g_assert (ids[i] > last);
+
+      deltas[i] = ids[i] - last - 1;
+      last = ids[i];
+      max |= deltas[i];
+    }
+
+  width = max ? g_bit_storage (max) : 0;
+  g_byte_array_append (bytes, &width, 1);
+
+  for (guint i = 0; i < n_ids; i++)
+    {
+      acc |= (guint64)deltas[i] << bits;
+      bits += width;
+
+      while (bits >= 8)
+        {
+          guint8 b = acc & 0xFF;
+          g_byte_array_append (bytes, &b, 1);
+          acc >>= 8;
+          bits -= 8;
+        }
+    }
+
+  if (bits > 0)
+    {
+      guint8 b = acc & 0xFF;
+      g_byte_array_append (bytes, &b, 1);
+    }
+}
+
 static gboolean
 _code_trigram_iter_next_char (CodeTrigramIter *iter,
                               gunichar        *ch)
@@ -135,7 +223,9 @@ typedef struct _CodeIndexBuilderTrigrams
   GByteArray *buffer;
   guint32     id;
   guint32     position;
+  guint32     end;
   guint       last_document_id;
+  guint       n_documents;
 } CodeIndexBuilderTrigrams;
 
 typedef struct _CodeIndexBuilderDocument
@@ -149,6 +239,7 @@ typedef struct _CodeIndexBuilderDocument
 typedef struct _CodeIndexHeader
 {
   guint8  magic[4];
+  guint32 version;
   guint32 n_documents;
   guint32 documents;
   guint32 n_documents_bytes;
@@ -187,6 +278,7 @@ code_index_builder_trigrams_clear (gpointer data)
 
   g_clear_pointer (&trigrams->buffer, g_byte_array_unref);
   trigrams->last_document_id = 0;
+  trigrams->n_documents = 0;
 }
 
 static void
@@ -291,7 +383,9 @@ code_index_builder_commit (CodeIndexBuilder *builder)
           t.buffer = g_byte_array_new ();
           t.id = trigram_id;
           t.last_document_id = 0;
+          t.n_documents = 0;
           t.position = 0;
+          t.end = 0;
 
           trigrams_index = builder->trigrams->len;
           code_sparse_set_add_with_data (&builder->trigrams_set, trigram_id, trigrams_index);
@@ -301,6 +395,7 @@ code_index_builder_commit (CodeIndexBuilder *builder)
       trigrams = &g_array_index (builder->trigrams, CodeIndexBuilderTrigrams, trigrams_index);
       write_uint (trigrams->buffer, document.id - trigrams->last_document_id);
       trigrams->last_document_id = document.id;
+      trigrams->n_documents++;
     }
 
   builder->current_path = NULL;
@@ -332,28 +427,88 @@ sort_by_trigram (gconstpointer a,
 }
 
 static guint
-realign (GByteArray *buffer)
+realign_to (GByteArray *buffer,
+            guint       alignment)
 {
   static const guint8 zero[CODE_INDEX_ALIGNMENT] = {0};
-  gsize rem = buffer->len % CODE_INDEX_ALIGNMENT;
+  gsize rem = buffer->len % alignment;
+
+  g_assert (alignment <= CODE_INDEX_ALIGNMENT);
 
   if (rem > 0)
-    g_byte_array_append (buffer, zero, CODE_INDEX_ALIGNMENT-rem);
+    g_byte_array_append (buffer, zero, alignment-rem);
   return buffer->len;
 }
 
-DexFuture *
-code_index_builder_write (CodeIndexBuilder *builder,
-                          GOutputStream    *stream,
-                          int               io_priority)
+static inline guint
+realign (GByteArray *buffer)
+{
+  return realign_to (buffer, CODE_INDEX_ALIGNMENT);
+}
+
+static void
+code_index_builder_write_postings (GByteArray               *buffer,
+                                   CodeIndexBuilderTrigrams *trigrams)
+{
+  guint32 ids[CODE_INDEX_BLOCK_SIZE];
+  const guint8 *pos = trigrams->buffer->data;
+  const guint8 *end = pos + trigrams->buffer->len;
+  guint n_blocks = (trigrams->n_documents + CODE_INDEX_BLOCK_SIZE - 1) / CODE_INDEX_BLOCK_SIZE;
+  guint skip_pos = buffer->len;
+  guint32 last = 0;
+  guint32 block_last = 0;
+  guint n_ids = 0;
+  guint block = 0;
+  guint delta;
+
+  g_byte_array_set_size (buffer, buffer->len + n_blocks * sizeof (CodeIndexSkip));
+
+  /* The builder keeps postings as a varint stream since it is much more
+   * compact while indexing, re-encode them into blocks now.
+   */
+  for (guint i = 0; i < trigrams->n_documents; i++)
+    {
+      if (!read_uint (&pos, end, &delta))
+        g_assert_not_reached ();
+
+      last += delta;
+      ids[n_ids++] = last;
+
+      if (n_ids == CODE_INDEX_BLOCK_SIZE || i + 1 == trigrams->n_documents)
+        {
+          CodeIndexSkip skip = { last, buffer->len - skip_pos };
+
+          memcpy (&buffer->data[skip_pos + block * sizeof skip], &skip, sizeof skip);
+          write_block (buffer, ids, n_ids, block_last);
+
+          block_last = last;
+          n_ids = 0;
+          block++;
+        }
+    }
+
+  g_assert (block == n_blocks);
+  g_assert (pos == end);
+}
+
+/**
+ * code_index_builder_to_bytes:
+ * @builder: a #CodeIndexBuilder
+ *
+ * Serializes the index the same way code_index_builder_write() does so
+ * that callers already running on a thread may write it synchronously.
+ *
+ * Returns: (transfer full): a #GBytes containing the index
+ */
+GBytes *
+code_index_builder_to_bytes (CodeIndexBuilder *builder)
 {
   GByteArray *buffer;
-  DexFuture *future;
-  GBytes *bytes;
   guint begin_documents_pos;
 
   CodeIndexHeader header = {
     .magic = CODE_INDEX_MAGIC,
+    .version = CODE_INDEX_VERSION,
     .n_documents = builder->documents->len,
     .n_trigrams = builder->trigrams->len,
   };
@@ -388,12 +543,12 @@ code_index_builder_write (CodeIndexBuilder *builder,
     {
       CodeIndexBuilderTrigrams *trigrams = &g_array_index (builder->trigrams, CodeIndexBuilderTrigrams, i);
 
-      g_assert (trigrams->buffer->len > 0);
+      g_assert (trigrams->n_documents > 0);
 
-      trigrams->position = buffer->len;
-      g_byte_array_append (buffer,
-                           (const guint8 *)trigrams->buffer->data,
-                           trigrams->buffer->len);
+      /* Keep the skip table aligned */
+      trigrams->position = realign_to (buffer, 4);
+      code_index_builder_write_postings (buffer, trigrams);
+      trigrams->end = buffer->len;
     }
   header.trigrams_data_bytes = buffer->len - header.trigrams_data;
 
@@ -401,17 +556,28 @@ code_index_builder_write (CodeIndexBuilder *builder,
   for (guint i = 0; i < builder->trigrams->len; i++)
     {
       CodeIndexBuilderTrigrams *trigrams = &g_array_index (builder->trigrams, CodeIndexBuilderTrigrams, i);
-      guint32 end = trigrams->position + trigrams->buffer->len;
 
       g_byte_array_append (buffer, (const guint8 *)&trigrams->id, sizeof trigrams->id);
       g_byte_array_append (buffer, (const guint8 *)&trigrams->position, sizeof trigrams->position);
-      g_byte_array_append (buffer, (const guint8 *)&end, sizeof end);
+      g_byte_array_append (buffer, (const guint8 *)&trigrams->end, sizeof trigrams->end);
+      g_byte_array_append (buffer, (const guint8 *)&trigrams->n_documents, sizeof trigrams->n_documents);
     }
   header.n_trigrams_bytes = buffer->len - header.trigrams;
 
   memcpy (buffer->data, &header, sizeof header);
 
-  bytes = g_byte_array_free_to_bytes (buffer);
+  return g_byte_array_free_to_bytes (buffer);
+}
+
+DexFuture *
+code_index_builder_write (CodeIndexBuilder *builder,
+                          GOutputStream    *stream,
+                          int               io_priority)
+{
+  DexFuture *future;
+  GBytes *bytes;
+
+  bytes = code_index_builder_to_bytes (builder);
   future = dex_output_stream_write_bytes (stream, bytes, io_priority);
   g_bytes_unref (bytes);
 
@@ -467,6 +633,7 @@ typedef struct _CodeIndexTrigram
   guint32 trigram_id;
   guint32 position;
   guint32 end;
+  guint32 n_documents;
 } CodeIndexTrigram;
 
 struct _CodeIndex
@@ -491,6 +658,10 @@ has_space_for (gsize length,
   gsize avail;
   gsize needed;
 
+  /* An index without any trigram ends with its (empty) trigram table */
+  if (n_items == 0)
+    return offset <= length;
+
   if (offset >= length)
     return FALSE;
 
@@ -555,8 +726,20 @@ code_index_new (const char  *filename,
   index->loader_data = NULL;
   index->loader_data_destroy = NULL;
 
+  if (memcmp (&index->header.magic, magic, sizeof magic) == 0 &&
+      index->header.version != CODE_INDEX_VERSION)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_SUPPORTED,
+                   "Unsupported codeindex version %u",
+                   index->header.version);
+      code_index_unref (index);
+      return NULL;
+    }
+
   if (memcmp (&index->header.magic, magic, sizeof magic) != 0 ||
-      !has_space_for (len, index->header.trigrams, index->header.n_trigrams, 12) ||
+      !has_space_for (len, index->header.trigrams, index->header.n_trigrams, sizeof (CodeIndexTrigram)) ||
       !has_space_for (len, index->header.documents, index->header.n_documents, 4) ||
       index->header.trigrams % CODE_INDEX_ALIGNMENT != 0 ||
       index->header.documents % CODE_INDEX_ALIGNMENT != 0)
@@ -658,12 +841,29 @@ code_index_iter_init_raw (CodeIndexIter          *iter,
                           gsize                   len,
                           const CodeIndexTrigram *trigrams)
 {
-  if (trigrams->position >= len || trigrams->end >= len || trigrams->end < trigrams->position)
+  guint n_blocks;
+
+  if (trigrams->position >= len ||
+      trigrams->end > len ||
+      trigrams->end < trigrams->position ||
+      trigrams->position % 4 != 0 ||
+      trigrams->n_documents == 0)
+    return FALSE;
+
+  n_blocks = (trigrams->n_documents + CODE_INDEX_BLOCK_SIZE - 1) / CODE_INDEX_BLOCK_SIZE;
+
+  if ((gsize)n_blocks * sizeof (CodeIndexSkip) > trigrams->end - trigrams->position)
     return FALSE;
 
   iter->index = index;
-  iter->pos = &data[trigrams->position];
+  iter->data = &data[trigrams->position];
   iter->end = &data[trigrams->end];
+  iter->skip = (const guint32 *)(gconstpointer)iter->data;
+  iter->n_documents = trigrams->n_documents;
+  iter->n_blocks = n_blocks;
+  iter->block = 0;
+  iter->pos = 0;
+  iter->len = 0;
   iter->last = 0;
 
   return TRUE;
@@ -686,33 +886,103 @@ code_index_iter_init (CodeIndexIter     *iter,
 
   data = (const guint8 *)g_mapped_file_get_contents (index->map);
   len = g_mapped_file_get_length (index->map);
-  if (trigrams->position >= len || trigrams->end >= len || trigrams->end < trigrams->position)
-    return FALSE;
 
   return code_index_iter_init_raw (iter, index, data, len, trigrams);
 }
 
+static inline guint32
+code_index_iter_get_block_last (CodeIndexIter *iter,
+                                guint          block)
+{
+  return iter->skip[block * 2];
+}
+
+static void
+code_index_iter_finish (CodeIndexIter *iter)
+{
+  /* No document may have this id so seeking fails right away */
+  iter->block = iter->n_blocks;
+  iter->pos = 0;
+  iter->len = 0;
+  iter->last = G_MAXUINT;
+}
+
 static gboolean
-code_index_iter_next_id (CodeIndexIter *iter,
-                         guint         *out_document_id)
+code_index_iter_load_block (CodeIndexIter *iter,
+                            guint          block)
 {
-  guint u = 0, o = 0;
-  guint8 b;
+  const guint8 *pos;
+  guint64 acc = 0;
+  guint32 mask;
+  guint32 last;
+  guint bits = 0;
+  guint offset;
+  guint width;
+  guint n_ids;
+  gsize n_bytes;
+
+  g_assert (block < iter->n_blocks);
+
+  if (block + 1 < iter->n_blocks)
+    n_ids = CODE_INDEX_BLOCK_SIZE;
+  else
+    n_ids = iter->n_documents - block * CODE_INDEX_BLOCK_SIZE;
 
-  do
+  last = block > 0 ? code_index_iter_get_block_last (iter, block - 1) : 0;
+  offset = iter->skip[block * 2 + 1];
+
+  if (offset >= (gsize)(iter->end - iter->data))
+    return FALSE;
+
+  pos = &iter->data[offset];
+  width = *pos++;
+  n_bytes = ((gsize)n_ids * width + 7) / 8;
+
+  if (width > 32 || n_bytes > (gsize)(iter->end - pos))
+    return FALSE;
+
+  mask = width == 32 ? G_MAXUINT32 : (1U << width) - 1;
+
+  for (guint i = 0; i < n_ids; i++)
     {
-      if (iter->pos >= iter->end || o > 28)
-        return FALSE;
+      while (bits < width)
+        {
+          acc |= (guint64)*pos++ << bits;
+          bits += 8;
+        }
 
-      b = *iter->pos;;
-      u |= ((guint32)(b & 0x7F) << o);
-      o += 7;
+      last += (guint32)(acc & mask) + 1;
+      acc >>= width;
+      bits -= width;
 
-      iter->pos++;
+      iter->ids[i] = last;
+    }
+
+  if (last != code_index_iter_get_block_last (iter, block))
+    return FALSE;
+
+  iter->block = block + 1;
+  iter->pos = 0;
+  iter->len = n_ids;
+
+  return TRUE;
+}
+
+static gboolean
+code_index_iter_next_id (CodeIndexIter *iter,
+                         guint         *out_document_id)
+{
+  if (iter->pos >= iter->len)
+    {
+      if (iter->block >= iter->n_blocks ||
+          !code_index_iter_load_block (iter, iter->block))
+        {
+          code_index_iter_finish (iter);
+          return FALSE;
+        }
     }
-  while ((b & 0x80) != 0);
 
-  iter->last += u;
+  iter->last = iter->ids[iter->pos++];
 
   *out_document_id = iter->last;
 
@@ -740,46 +1010,232 @@ gboolean
 code_index_iter_seek_to (CodeIndexIter *iter,
                          guint          document_id)
 {
-  guint ignored;
+  if (iter->last >= document_id)
+    return iter->last == document_id;
 
-  do
+  /* Find the first block which may contain @document_id without decoding
+   * any of the blocks in between.
+   */
+  if (iter->len == 0 || iter->ids[iter->len - 1] < document_id)
     {
-      if (iter->last >= document_id)
-        break;
+      guint lo = iter->block;
+      guint hi = iter->n_blocks;
+
+      while (lo < hi)
+        {
+          guint mid = lo + (hi - lo) / 2;
+
+          if (code_index_iter_get_block_last (iter, mid) < document_id)
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+
+      if (lo >= iter->n_blocks || !code_index_iter_load_block (iter, lo))
+        {
+          code_index_iter_finish (iter);
+          return FALSE;
+        }
     }
-  while (code_index_iter_next_id (iter, &ignored));
+
+  /* The last id of the block is at least @document_id */
+  while (iter->ids[iter->pos] < document_id)
+    iter->pos++;
+
+  iter->last = iter->ids[iter->pos++];
 
   return iter->last == document_id;
 }
 
+/**
+ * code_index_iter_get_n_documents:
+ * @iter: a #CodeIndexIter
+ *
+ * Gets the number of documents in the posting list of @iter.
+ *
+ * Returns: the number of documents
+ */
+guint
+code_index_iter_get_n_documents (CodeIndexIter *iter)
+{
+  return iter->n_documents;
+}
+
+static int
+sort_by_n_documents (gconstpointer a,
+                     gconstpointer b)
+{
+  const CodeIndexIter *aiter = a;
+  const CodeIndexIter *biter = b;
+
+  if (aiter->n_documents < biter->n_documents)
+    return -1;
+  else if (aiter->n_documents > biter->n_documents)
+    return 1;
+  else
+    return 0;
+}
+
+/**
+ * code_index_iter_sort:
+ * @iters: (array length=n_iters): iterators of a single #CodeIndex
+ * @n_iters: the number of iterators
+ *
+ * Sorts @iters so that the shortest posting list comes first, which is
+ * the order expected by code_index_iter_intersect().
+ */
+void
+code_index_iter_sort (CodeIndexIter *iters,
+                      guint          n_iters)
+{
+  qsort (iters, n_iters, sizeof *iters, sort_by_n_documents);
+}
+
+/**
+ * code_index_iter_intersect:
+ * @iters: (array length=n_iters): iterators sorted with code_index_iter_sort()
+ * @n_iters: the number of iterators
+ * @out_document: (out): a location for the document
+ *
+ * Advances to the next document found in every posting list of @iters.
+ *
+ * The first iterator drives the intersection and the others are sought to
+ * its documents. Whenever one of them goes past the candidate, the others
+ * leapfrog to that document, skipping over whole blocks.
+ *
+ * Returns: %TRUE if a document was found
+ */
+gboolean
+code_index_iter_intersect (CodeIndexIter *iters,
+                           guint          n_iters,
+                           CodeDocument  *out_document)
+{
+  guint document_id;
+  guint i;
+
+  g_return_val_if_fail (iters != NULL, FALSE);
+  g_return_val_if_fail (n_iters > 0, FALSE);
+
+again:
+  if (!code_index_iter_next_id (&iters[0], &document_id))
+    return FALSE;
+
+  for (;;)
+    {
+      for (i = 1; i < n_iters; i++)
+        {
+          if (!code_index_iter_seek_to (&iters[i], document_id))
+            break;
+        }
+
+      if (i == n_iters)
+        break;
+
+      /* Exhausted lists have G_MAXUINT as their last document */
+      if (iters[i].last == G_MAXUINT)
+        return FALSE;
+
+      document_id = iters[i].last;
+
+      if (!code_index_iter_seek_to (&iters[0], document_id))
+        {
+          if (iters[0].last == G_MAXUINT)
+            return FALSE;
+
+          document_id = iters[0].last;
+        }
+    }
+
+  out_document->id = document_id;
+  out_document->path = code_index_get_document_path (iters[0].index, document_id);
+
+  if (out_document->path == NULL)
+    goto again;
+
+  return TRUE;
+}
+
+static CodeIndexBuilderTrigrams *
+code_index_builder_ensure_trigrams (CodeIndexBuilder *builder,
+                                    guint             trigram_id)
+{
+  guint trigrams_index;
+
+  if (!code_sparse_set_get (&builder->trigrams_set, trigram_id, &trigrams_index))
+    {
+      CodeIndexBuilderTrigrams t;
+
+      t.buffer = g_byte_array_new ();
+      t.id = trigram_id;
+      t.last_document_id = 0;
+      t.n_documents = 0;
+      t.position = 0;
+      t.end = 0;
+
+      trigrams_index = builder->trigrams->len;
+      code_sparse_set_add_with_data (&builder->trigrams_set, trigram_id, trigrams_index);
+      g_array_append_val (builder->trigrams, t);
+    }
+
+  return &g_array_index (builder->trigrams, CodeIndexBuilderTrigrams, trigrams_index);
+}
+
 gboolean
 code_index_builder_merge (CodeIndexBuilder *builder,
                           CodeIndex        *index)
 {
-  guint document_id_offset;
+  return code_index_builder_merge_full (builder, index, NULL, NULL);
+}
+
+/**
+ * code_index_builder_merge_full:
+ * @builder: a #CodeIndexBuilder
+ * @index: a #CodeIndex to merge into @builder
+ * @filter: (nullable) (scope call): a #CodeIndexFilter or %NULL
+ * @filter_data: closure data for @filter
+ *
+ * Like code_index_builder_merge() but documents for which @filter returns
+ * %FALSE are left out, along with their posting entries. This is useful to
+ * replace stale documents with those of a newer index.
+ *
+ * Returns: %TRUE if @index was merged
+ */
+gboolean
+code_index_builder_merge_full (CodeIndexBuilder *builder,
+                               CodeIndex        *index,
+                               CodeIndexFilter   filter,
+                               gpointer          filter_data)
+{
+  g_autofree guint *document_ids = NULL;
   const guint8 *data;
   gsize len;
 
   g_assert (builder->documents != NULL);
   g_assert (builder->documents->len >= 1);
 
-  /* get our starting document id */
-  document_id_offset = builder->documents->len - 1;
-
   /* Make sure enough space for document ids */
-  if (G_MAXUINT - document_id_offset < index->header.n_documents)
+  if (G_MAXUINT - builder->documents->len < index->header.n_documents)
     return FALSE;
 
-  /* Add all of the documents to the index */
+  /* Add the documents to the index, remembering the new identifier of
+   * each of them. Ids stay in order so the deltas remain positive.
+   */
+  document_ids = g_new0 (guint, MAX (1, index->header.n_documents));
+
   for (guint i = 1; i < index->header.n_documents; i++)
     {
       const char *path = code_index_get_document_path (index, i);
-      CodeIndexBuilderDocument document = {
-        .path = g_string_chunk_insert_const (builder->paths, path),
-        .collate = g_utf8_collate_key_for_filename (path, -1),
-        .id = builder->documents->len,
-        .position = 0,
-      };
+      CodeIndexBuilderDocument document;
+
+      if (path == NULL || (filter != NULL && !filter (index, path, filter_data)))
+        continue;
+
+      document.path = g_string_chunk_insert_const (builder->paths, path);
+      document.collate = g_utf8_collate_key_for_filename (path, -1);
+      document.id = builder->documents->len;
+      document.position = 0;
+
+      document_ids[i] = document.id;
 
       g_array_append_val (builder->documents, document);
     }
@@ -791,37 +1247,29 @@ code_index_builder_merge (CodeIndexBuilder *builder,
   for (guint i = 0; i < index->header.n_trigrams; i++)
     {
       const CodeIndexTrigram *trigrams = &index->trigrams[i];
-      CodeIndexBuilderTrigrams *builder_trigrams;
+      CodeIndexBuilderTrigrams *builder_trigrams = NULL;
       CodeIndexIter iter;
-      guint trigrams_index;
       guint id;
 
       if (!code_index_iter_init_raw (&iter, index, data, len, trigrams))
         continue;
 
-      if (!code_sparse_set_get (&builder->trigrams_set, trigrams->trigram_id, &trigrams_index))
+      while (code_index_iter_next_id (&iter, &id))
         {
-          CodeIndexBuilderTrigrams t;
+          if (id >= index->header.n_documents || document_ids[id] == 0)
+            continue;
 
-          t.buffer = g_byte_array_new ();
-          t.id = trigrams->trigram_id;
-          t.last_document_id = 0;
-          t.position = 0;
+          /* Only create the posting list once a document uses it so that
+           * no empty list is written.
+           */
+          if (builder_trigrams == NULL)
+            builder_trigrams = code_index_builder_ensure_trigrams (builder, trigrams->trigram_id);
 
-          trigrams_index = builder->trigrams->len;
-          code_sparse_set_add_with_data (&builder->trigrams_set, trigrams->trigram_id, trigrams_index);
-          g_array_append_val (builder->trigrams, t);
-        }
-
-      builder_trigrams = &g_array_index (builder->trigrams, CodeIndexBuilderTrigrams, trigrams_index);
-
-      while (code_index_iter_next_id (&iter, &id))
-        {
-          id += document_id_offset;
+          id = document_ids[id];
           write_uint (builder_trigrams->buffer, id - builder_trigrams->last_document_id);
           builder_trigrams->last_document_id = id;
+          builder_trigrams->n_documents++;
         }
-
     }
 
   return TRUE;
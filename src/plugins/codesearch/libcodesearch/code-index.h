@@ -45,12 +45,22 @@ typedef struct _CodeTrigramIter
   CodeTrigram trigram;
 } CodeTrigramIter;
 
+/* Number of document ids within each block of a posting list */
+#define CODE_INDEX_BLOCK_SIZE 128
+
 typedef struct _CodeIndexIter
 {
   CodeIndex *index;
-  const guint8 *pos;
+  const guint8 *data;
   const guint8 *end;
+  const guint32 *skip;
+  guint n_documents;
+  guint n_blocks;
+  guint block;
+  guint pos;
+  guint len;
   guint last;
+  guint32 ids[CODE_INDEX_BLOCK_SIZE];
 } CodeIndexIter;
 
 typedef struct _CodeDocument
@@ -88,6 +98,18 @@ typedef DexFuture *(*CodeIndexDocumentLoader) (CodeIndex  *index,
                                                const char *path,
                                                gpointer    user_data);
 
+/**
+ * CodeIndexFilter:
+ * @index: a #CodeIndex
+ * @path: the path of a document within @index
+ * @user_data: closure data supplied to code_index_builder_merge_full()
+ *
+ * Returns: %TRUE if the document should be kept
+ */
+typedef gboolean (*CodeIndexFilter) (CodeIndex  *index,
+                                     const char *path,
+                                     gpointer    user_data);
+
 GType             code_index_get_type                (void);
 GType             code_index_builder_get_type        (void);
 CodeIndexBuilder *code_index_builder_new             (void);
@@ -104,6 +126,11 @@ guint             code_index_builder_get_n_trigrams  (CodeIndexBuilder   *builde
 guint             code_index_builder_get_uncommitted (CodeIndexBuilder   *builder);
 gboolean          code_index_builder_merge           (CodeIndexBuilder   *builder,
                                                       CodeIndex          *index);
+gboolean          code_index_builder_merge_full      (CodeIndexBuilder   *builder,
+                                                      CodeIndex          *index,
+                                                      CodeIndexFilter     filter,
+                                                      gpointer            filter_data);
+GBytes           *code_index_builder_to_bytes        (CodeIndexBuilder   *builder);
 DexFuture        *code_index_builder_write           (CodeIndexBuilder   *builder,
                                                       GOutputStream      *stream,
                                                       int                 io_priority);
@@ -136,6 +163,12 @@ gboolean          code_index_iter_next               (CodeIndexIter      *iter,
                                                       CodeDocument       *out_document);
 gboolean          code_index_iter_seek_to            (CodeIndexIter      *iter,
                                                       guint               document_id);
+guint             code_index_iter_get_n_documents    (CodeIndexIter      *iter);
+void              code_index_iter_sort               (CodeIndexIter      *iters,
+                                                      guint               n_iters);
+gboolean          code_index_iter_intersect          (CodeIndexIter      *iters,
+                                                      guint               n_iters,
+                                                      CodeDocument       *out_document);
 guint             code_trigram_encode                (const CodeTrigram  *trigram);
 CodeTrigram       code_trigram_decode                (guint               encoded);
 void              code_trigram_iter_init             (CodeTrigramIter    *iter,
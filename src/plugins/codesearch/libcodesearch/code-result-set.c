@@ -169,15 +169,8 @@ next_document (CodeIndexIter *iters,
 {
   CodeDocument document;
 
-again:
-  if (!code_index_iter_next (&iters[0], &document))
-    return FALSE;
-
-  for (guint i = 1; i < n_iters; i++)
-    {
-      if (!code_index_iter_seek_to (&iters[i], document.id))
-        goto again;
-    }
+  if (!code_index_iter_intersect (iters, n_iters, &document))
+    return NULL;
 
   return document.path;
 }
@@ -199,7 +192,7 @@ code_result_set_populate_from_index (CodeResultSet *self,
   g_assert (trigrams != NULL);
   g_assert (n_trigrams > 0);
 
-  if (n_trigrams < 32)
+  if (n_trigrams < 8)
     iters = g_newa (CodeIndexIter, n_trigrams);
   else
     iters = freeme = g_new (CodeIndexIter, n_trigrams);
@@ -212,6 +205,9 @@ code_result_set_populate_from_index (CodeResultSet *self,
         return dex_future_new_for_boolean (TRUE);
     }
 
+  /* Let the rarest trigram drive the intersection */
+  code_index_iter_sort (iters, n_trigrams);
+
   futures = g_ptr_array_new_with_free_func (dex_unref);
 
 next_batch:
@@ -23,6 +23,7 @@
 #include <libide-vcs.h>
 
 #include "ide-ctags-builder.h"
+#include "ide-ctags-index.h"
 
 struct _IdeCtagsBuilder
 {
@@ -241,6 +242,15 @@ finish_subprocess:
       return FALSE;
     }
 
+  /* Emit the sorted binary sidecar while we are still on a worker thread
+   * so that loading the index later only needs to mmap() it.
+   */
+  if (!ide_ctags_index_write_binary (tags_file, cancellable, &error))
+    {
+      g_debug ("Failed to write binary ctags index: %s", error->message);
+      g_clear_error (&error);
+    }
+
   for (guint i = 0; i < directories->len; i++)
     {
       GFile *child = g_ptr_array_index (directories, i);
@@ -21,6 +21,7 @@
 #define G_LOG_DOMAIN "ide-ctags-index"
 
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -30,16 +31,62 @@
  * it can be used from threads safely.
  */
 
-struct _IdeCtagsIndex
+/* The binary sidecar ("tags.idx") is a header followed by fixed-width
+ * records sorted with ide_ctags_index_entry_compare() and a table of
+ * NUL-terminated strings. Records reference strings by offset so the
+ * file can be mmap()'d and binary-searched without parsing. Entries
+ * are only inflated into IdeCtagsIndexEntry for the ranges that are
+ * actually requested by a lookup.
+ */
+#define BINARY_MAGIC   "IDECTAGS"
+#define BINARY_VERSION 1
+#define BINARY_SUFFIX  ".idx"
+#define NO_STRING      G_MAXUINT32
+
+typedef struct
 {
-  IdeObject  parent_instance;
+  gchar   magic[8];
+  guint32 version;
+  guint32 n_records;
+  guint64 tags_mtime;
+  guint64 tags_size;
+  guint64 strings_offset;
+  guint64 strings_length;
+} BinaryHeader;
+
+typedef struct
+{
+  guint32 name;
+  guint32 path;
+  guint32 pattern;
+  guint32 keyval;
+  guint8  kind;
+  guint8  padding[3];
+} BinaryRecord;
 
-  GArray    *index;
-  GBytes    *buffer;
-  GFile     *file;
-  gchar     *path_root;
+G_STATIC_ASSERT (sizeof (BinaryHeader) == 48);
+G_STATIC_ASSERT (sizeof (BinaryRecord) == 20);
 
-  guint64    mtime;
+struct _IdeCtagsIndex
+{
+  IdeObject           parent_instance;
+
+  GArray             *index;
+  GBytes             *buffer;
+  GFile              *file;
+  gchar              *path_root;
+
+  /* Binary index, if loaded from a sidecar */
+  GMappedFile        *mapped;
+  const BinaryRecord *records;
+  const gchar        *strings;
+  gsize               strings_length;
+  guint               n_records;
+  GMutex              inflate_mutex;
+  IdeCtagsIndexEntry *inflated;
+  guint               n_inflated;
+
+  guint64             mtime;
 };
 
 enum {
@@ -183,6 +230,295 @@ ide_ctags_index_parse_line (gchar              *line,
   return TRUE;
 }
 
+static gboolean
+get_tags_file_stat (const gchar *path,
+                    guint64     *mtime,
+                    guint64     *size)
+{
+  GStatBuf st;
+
+  if (g_stat (path, &st) != 0)
+    return FALSE;
+
+  *mtime = st.st_mtime;
+  *size = st.st_size;
+
+  return TRUE;
+}
+
+static inline const gchar *
+ide_ctags_index_get_string (IdeCtagsIndex *self,
+                            guint32        offset)
+{
+  /* The string table is always NUL-terminated (checked at load), so any
+   * in-range offset yields a valid C string.
+   */
+  if (offset >= self->strings_length)
+    return NULL;
+
+  return &self->strings[offset];
+}
+
+static gboolean
+ide_ctags_index_load_binary (IdeCtagsIndex  *self,
+                             GError        **error)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *idx_path = NULL;
+  BinaryHeader header;
+  const gchar *data;
+  guint64 tags_mtime;
+  guint64 tags_size;
+  gsize length;
+
+  g_assert (IDE_IS_CTAGS_INDEX (self));
+  g_assert (G_IS_FILE (self->file));
+
+  if (!(path = g_file_get_path (self->file)))
+    return FALSE;
+
+  idx_path = g_strconcat (path, BINARY_SUFFIX, NULL);
+
+  if (!g_file_test (idx_path, G_FILE_TEST_IS_REGULAR) ||
+      !get_tags_file_stat (path, &tags_mtime, &tags_size) ||
+      !(mapped = g_mapped_file_new (idx_path, FALSE, error)))
+    return FALSE;
+
+  data = g_mapped_file_get_contents (mapped);
+  length = g_mapped_file_get_length (mapped);
+
+  if (length < sizeof header)
+    goto invalid;
+
+  memcpy (&header, data, sizeof header);
+
+  if (memcmp (header.magic, BINARY_MAGIC, sizeof header.magic) != 0 ||
+      GUINT32_FROM_LE (header.version) != BINARY_VERSION)
+    goto invalid;
+
+  /* Stale if the tags file was regenerated after the sidecar */
+  if (GUINT64_FROM_LE (header.tags_mtime) != tags_mtime ||
+      GUINT64_FROM_LE (header.tags_size) != tags_size)
+    goto invalid;
+
+  if ((guint64)GUINT32_FROM_LE (header.n_records) * sizeof (BinaryRecord) >
+      GUINT64_FROM_LE (header.strings_offset) - sizeof header ||
+      GUINT64_FROM_LE (header.strings_offset) < sizeof header ||
+      GUINT64_FROM_LE (header.strings_offset) > length ||
+      GUINT64_FROM_LE (header.strings_length) == 0 ||
+      GUINT64_FROM_LE (header.strings_length) > length - GUINT64_FROM_LE (header.strings_offset) ||
+      data[GUINT64_FROM_LE (header.strings_offset) + GUINT64_FROM_LE (header.strings_length) - 1] != 0)
+    goto invalid;
+
+  self->records = (const BinaryRecord *)(gconstpointer)(data + sizeof header);
+  self->n_records = GUINT32_FROM_LE (header.n_records);
+  self->strings = data + GUINT64_FROM_LE (header.strings_offset);
+  self->strings_length = GUINT64_FROM_LE (header.strings_length);
+  self->mapped = g_steal_pointer (&mapped);
+
+  return TRUE;
+
+invalid:
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_DATA,
+               "Binary ctags index is stale or corrupted");
+  return FALSE;
+}
+
+static inline const gchar *
+binary_record_get_name (IdeCtagsIndex *self,
+                        guint          position)
+{
+  const gchar *name = ide_ctags_index_get_string (self, GUINT32_FROM_LE (self->records[position].name));
+  return name ? name : "";
+}
+
+static void
+ide_ctags_index_inflate_record (IdeCtagsIndex      *self,
+                                guint               position,
+                                IdeCtagsIndexEntry *entry)
+{
+  const BinaryRecord *record = &self->records[position];
+  guint32 keyval = GUINT32_FROM_LE (record->keyval);
+
+  memset (entry, 0, sizeof *entry);
+
+  entry->name = binary_record_get_name (self, position);
+  entry->path = ide_ctags_index_get_string (self, GUINT32_FROM_LE (record->path));
+  entry->pattern = ide_ctags_index_get_string (self, GUINT32_FROM_LE (record->pattern));
+  entry->keyval = keyval == NO_STRING ? NULL : ide_ctags_index_get_string (self, keyval);
+  entry->kind = record->kind;
+}
+
+/*
+ * Returns a stable array of @count entries starting at @first. Records
+ * are inflated at most once into an array parallel to the records, so
+ * overlapping lookups share entries. The array is zeroed on allocation
+ * and only the pages of records that were looked up get touched. The
+ * entries live as long as @self so that callers may keep pointers to
+ * them, matching the semantics of the text index.
+ */
+static const IdeCtagsIndexEntry *
+ide_ctags_index_inflate_range (IdeCtagsIndex *self,
+                               guint          first,
+                               guint          count)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+
+  g_assert (IDE_IS_CTAGS_INDEX (self));
+  g_assert (first + count <= self->n_records);
+  g_assert (count > 0);
+
+  locker = g_mutex_locker_new (&self->inflate_mutex);
+
+  if (self->inflated == NULL)
+    self->inflated = g_new0 (IdeCtagsIndexEntry, self->n_records);
+
+  for (guint i = first; i < first + count; i++)
+    {
+      /* Inflated entries always have a name, possibly empty */
+      if (self->inflated[i].name == NULL)
+        {
+          ide_ctags_index_inflate_record (self, i, &self->inflated[i]);
+          self->n_inflated++;
+        }
+    }
+
+  return &self->inflated[first];
+}
+
+static const IdeCtagsIndexEntry *
+ide_ctags_index_lookup_binary (IdeCtagsIndex *self,
+                               const gchar   *keyword,
+                               gsize         *length,
+                               GCompareFunc   compare_func)
+{
+  IdeCtagsIndexEntry key = { 0 };
+  IdeCtagsIndexEntry probe = { 0 };
+  guint lo = 0;
+  guint hi = self->n_records;
+  guint first;
+  guint last;
+
+  key.name = keyword;
+
+  /* Find the first record that does not compare below @keyword */
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      probe.name = binary_record_get_name (self, mid);
+
+      if (compare_func (&key, &probe) > 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  first = lo;
+
+  for (last = first; last < self->n_records; last++)
+    {
+      probe.name = binary_record_get_name (self, last);
+
+      if (compare_func (&key, &probe) != 0)
+        break;
+    }
+
+  if (last == first)
+    return NULL;
+
+  if (length != NULL)
+    *length = last - first;
+
+  return ide_ctags_index_inflate_range (self, first, last - first);
+}
+
+static guint32
+intern_string (GHashTable  *offsets,
+               GByteArray  *strings,
+               const gchar *str)
+{
+  gpointer offset;
+
+  if (str == NULL)
+    return GUINT32_TO_LE (NO_STRING);
+
+  if (!g_hash_table_lookup_extended (offsets, str, NULL, &offset))
+    {
+      offset = GUINT_TO_POINTER (strings->len);
+      g_byte_array_append (strings, (const guint8 *)str, strlen (str) + 1);
+      g_hash_table_insert (offsets, (gpointer)str, offset);
+    }
+
+  return GUINT32_TO_LE (GPOINTER_TO_UINT (offset));
+}
+
+static gboolean
+ide_ctags_index_write_records (GArray        *index,
+                               const gchar   *idx_path,
+                               guint64        tags_mtime,
+                               guint64        tags_size,
+                               GError       **error)
+{
+  g_autoptr(GHashTable) offsets = NULL;
+  g_autoptr(GByteArray) strings = NULL;
+  g_autoptr(GByteArray) records = NULL;
+  g_autoptr(GByteArray) output = NULL;
+  BinaryHeader header = {{0}};
+
+  g_assert (index != NULL);
+  g_assert (idx_path != NULL);
+
+  offsets = g_hash_table_new (g_str_hash, g_str_equal);
+  strings = g_byte_array_new ();
+  records = g_byte_array_sized_new (index->len * sizeof (BinaryRecord));
+
+  for (guint i = 0; i < index->len; i++)
+    {
+      const IdeCtagsIndexEntry *entry = &g_array_index (index, IdeCtagsIndexEntry, i);
+      BinaryRecord record = {0};
+
+      record.name = intern_string (offsets, strings, entry->name);
+      record.path = intern_string (offsets, strings, entry->path);
+      record.pattern = intern_string (offsets, strings, entry->pattern);
+      record.keyval = intern_string (offsets, strings, entry->keyval);
+      record.kind = entry->kind;
+
+      if (strings->len >= NO_STRING)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_NO_SPACE,
+                       "Tags file is too large for binary index");
+          return FALSE;
+        }
+
+      g_byte_array_append (records, (const guint8 *)&record, sizeof record);
+    }
+
+  /* Ensure the string table is never empty so it is always terminated */
+  if (strings->len == 0)
+    g_byte_array_append (strings, (const guint8 *)"", 1);
+
+  memcpy (header.magic, BINARY_MAGIC, sizeof header.magic);
+  header.version = GUINT32_TO_LE (BINARY_VERSION);
+  header.n_records = GUINT32_TO_LE (index->len);
+  header.tags_mtime = GUINT64_TO_LE (tags_mtime);
+  header.tags_size = GUINT64_TO_LE (tags_size);
+  header.strings_offset = GUINT64_TO_LE (sizeof header + records->len);
+  header.strings_length = GUINT64_TO_LE (strings->len);
+
+  output = g_byte_array_sized_new (sizeof header + records->len + strings->len);
+  g_byte_array_append (output, (const guint8 *)&header, sizeof header);
+  g_byte_array_append (output, records->data, records->len);
+  g_byte_array_append (output, strings->data, strings->len);
+
+  return g_file_set_contents (idx_path, (const gchar *)output->data, output->len, error);
+}
+
 static void
 ide_ctags_index_build_index (IdeTask      *task,
                              gpointer      source_object,
@@ -204,6 +540,12 @@ ide_ctags_index_build_index (IdeTask      *task,
   g_assert (IDE_IS_CTAGS_INDEX (self));
   g_assert (G_IS_FILE (self->file));
 
+  if (ide_ctags_index_load_binary (self, NULL))
+    {
+      ide_task_return_boolean (task, TRUE);
+      IDE_EXIT;
+    }
+
   if (!g_file_load_contents (self->file, cancellable, &contents, &length, NULL, &error))
     IDE_GOTO (failure);
 
@@ -355,6 +697,9 @@ ide_ctags_index_finalize (GObject *object)
   g_clear_pointer (&self->index, g_array_unref);
   g_clear_pointer (&self->buffer, g_bytes_unref);
   g_clear_pointer (&self->path_root, g_free);
+  g_clear_pointer (&self->inflated, g_free);
+  g_clear_pointer (&self->mapped, g_mapped_file_unref);
+  g_mutex_clear (&self->inflate_mutex);
 
   G_OBJECT_CLASS (ide_ctags_index_parent_class)->finalize (object);
 }
@@ -397,6 +742,7 @@ ide_ctags_index_class_init (IdeCtagsIndexClass *klass)
 static void
 ide_ctags_index_init (IdeCtagsIndex *self)
 {
+  g_mutex_init (&self->inflate_mutex);
 }
 
 static void
@@ -483,7 +829,34 @@ ide_ctags_index_get_size (IdeCtagsIndex *self)
   if (self->index != NULL)
     return self->index->len;
 
-  return 0;
+  return self->n_records;
+}
+
+/* Estimates the memory used by the index for the service cache. Mapped
+ * sidecars are counted as well since the pages are touched by lookups,
+ * along with the records inflated so far.
+ */
+gsize
+ide_ctags_index_get_memory_size (IdeCtagsIndex *self)
+{
+  gsize ret = sizeof *self;
+
+  g_return_val_if_fail (IDE_IS_CTAGS_INDEX (self), 0);
+
+  g_mutex_lock (&self->inflate_mutex);
+  ret += (gsize)self->n_inflated * sizeof (IdeCtagsIndexEntry);
+  g_mutex_unlock (&self->inflate_mutex);
+
+  if (self->index != NULL)
+    ret += self->index->len * sizeof (IdeCtagsIndexEntry);
+
+  if (self->buffer != NULL)
+    ret += g_bytes_get_size (self->buffer);
+
+  if (self->mapped != NULL)
+    ret += g_mapped_file_get_length (self->mapped);
+
+  return ret;
 }
 
 static const IdeCtagsIndexEntry *
@@ -501,6 +874,9 @@ ide_ctags_index_lookup_full (IdeCtagsIndex *self,
   if (length != NULL)
     *length = 0;
 
+  if (self->mapped != NULL)
+    return ide_ctags_index_lookup_binary (self, keyword, length, compare_func);
+
   if ((self->index == NULL) || (self->index->data == NULL) || (self->index->len == 0))
     return NULL;
 
@@ -635,6 +1011,35 @@ ide_ctags_index_find_with_path (IdeCtagsIndex *self,
 
   ar = g_ptr_array_new ();
 
+  if (self->mapped != NULL)
+    {
+      guint32 path_offset = NO_STRING;
+
+      /* Strings are interned in the binary index, so once we find the
+       * offset for @relative_path we only need to compare integers.
+       */
+      for (guint i = 0; i < self->n_records; i++)
+        {
+          guint32 offset = GUINT32_FROM_LE (self->records[i].path);
+
+          if (path_offset == NO_STRING)
+            {
+              if (!ide_str_equal0 (ide_ctags_index_get_string (self, offset), relative_path))
+                continue;
+              path_offset = offset;
+            }
+          else if (offset != path_offset)
+            continue;
+
+          g_ptr_array_add (ar, (gpointer)ide_ctags_index_inflate_range (self, i, 1));
+        }
+
+      return ar;
+    }
+
+  if (self->index == NULL)
+    return ar;
+
   for (guint i = 0; i < self->index->len; i++)
     {
       IdeCtagsIndexEntry *entry = &g_array_index (self->index, IdeCtagsIndexEntry, i);
@@ -651,5 +1056,87 @@ ide_ctags_index_get_is_empty (IdeCtagsIndex *self)
 {
   g_return_val_if_fail (IDE_IS_CTAGS_INDEX (self), FALSE);
 
+  if (self->mapped != NULL)
+    return self->n_records == 0;
+
   return self->index == NULL || self->index->len == 0;
 }
+
+/**
+ * ide_ctags_index_write_binary:
+ * @tags_file: a #GFile containing ctags data
+ * @cancellable: (nullable): a #GCancellable
+ * @error: a location for a #GError
+ *
+ * Parses @tags_file and writes a sorted binary sidecar next to it which
+ * #IdeCtagsIndex will mmap() instead of parsing the tags file on load.
+ *
+ * This should be called from a thread as it parses the entire file.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+ide_ctags_index_write_binary (GFile         *tags_file,
+                              GCancellable  *cancellable,
+                              GError       **error)
+{
+  g_autoptr(GArray) index = NULL;
+  g_autofree gchar *contents = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *idx_path = NULL;
+  IdeLineReader reader;
+  guint64 tags_mtime;
+  guint64 tags_size;
+  gchar *line;
+  gsize length = 0;
+  gsize line_length;
+
+  g_return_val_if_fail (G_IS_FILE (tags_file), FALSE);
+
+  if (!(path = g_file_get_path (tags_file)))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_SUPPORTED,
+                   "Binary ctags index requires a local file");
+      return FALSE;
+    }
+
+  /* Stat before reading so a concurrent rewrite makes us look stale */
+  if (!get_tags_file_stat (path, &tags_mtime, &tags_size))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_FOUND,
+                   "Failed to stat %s", path);
+      return FALSE;
+    }
+
+  if (!g_file_load_contents (tags_file, cancellable, &contents, &length, NULL, error))
+    return FALSE;
+
+  index = g_array_new (FALSE, FALSE, sizeof (IdeCtagsIndexEntry));
+  ide_line_reader_init (&reader, contents, length);
+
+  while ((line = ide_line_reader_next (&reader, &line_length)))
+    {
+      IdeCtagsIndexEntry entry;
+
+      if (line [0] == '!')
+        continue;
+
+      line [line_length] = '\0';
+
+      if (ide_ctags_index_parse_line (line, &entry))
+        g_array_append_val (index, entry);
+    }
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    return FALSE;
+
+  g_array_sort (index, ide_ctags_index_entry_compare);
+
+  idx_path = g_strconcat (path, BINARY_SUFFIX, NULL);
+
+  return ide_ctags_index_write_records (index, idx_path, tags_mtime, tags_size, error);
+}
@@ -61,36 +61,40 @@ typedef struct
  * it can be used from threads safely.
  */
 
-IdeCtagsIndex            *ide_ctags_index_new           (GFile                    *file,
-                                                         const gchar              *path_root,
-                                                         guint64                   mtime);
-void                      ide_ctags_index_load_async    (IdeCtagsIndex            *self,
-                                                         GFile                    *file,
-                                                         GCancellable             *cancellable,
-                                                         GAsyncReadyCallback       callback,
-                                                         gpointer                  user_data);
-gboolean                  ide_ctags_index_load_finish   (IdeCtagsIndex            *index,
-                                                         GAsyncResult             *result,
-                                                         GError                  **error);
-GPtrArray                *ide_ctags_index_find_with_path(IdeCtagsIndex           *self,
-                                                         const gchar             *relative_path);
-gchar                    *ide_ctags_index_resolve_path  (IdeCtagsIndex            *self,
-                                                         const gchar              *path);
-GFile                    *ide_ctags_index_get_file      (IdeCtagsIndex            *self);
-gboolean                  ide_ctags_index_get_is_empty  (IdeCtagsIndex            *self);
-gsize                     ide_ctags_index_get_size      (IdeCtagsIndex            *self);
-const gchar              *ide_ctags_index_get_path_root (IdeCtagsIndex            *self);
-const IdeCtagsIndexEntry *ide_ctags_index_lookup        (IdeCtagsIndex            *self,
-                                                         const gchar              *keyword,
-                                                         gsize                    *length);
-const IdeCtagsIndexEntry *ide_ctags_index_lookup_prefix (IdeCtagsIndex            *self,
-                                                         const gchar              *keyword,
-                                                         gsize                    *length);
-guint64                   ide_ctags_index_get_mtime     (IdeCtagsIndex            *self);
-gint                      ide_ctags_index_entry_compare (gconstpointer             a,
-                                                         gconstpointer             b);
-IdeCtagsIndexEntry       *ide_ctags_index_entry_copy    (const IdeCtagsIndexEntry *entry);
-void                      ide_ctags_index_entry_free    (IdeCtagsIndexEntry       *entry);
+IdeCtagsIndex            *ide_ctags_index_new             (GFile                    *file,
+                                                           const gchar              *path_root,
+                                                           guint64                   mtime);
+void                      ide_ctags_index_load_async      (IdeCtagsIndex            *self,
+                                                           GFile                    *file,
+                                                           GCancellable             *cancellable,
+                                                           GAsyncReadyCallback       callback,
+                                                           gpointer                  user_data);
+gboolean                  ide_ctags_index_load_finish     (IdeCtagsIndex            *index,
+                                                           GAsyncResult             *result,
+                                                           GError                  **error);
+GPtrArray                *ide_ctags_index_find_with_path  (IdeCtagsIndex            *self,
+                                                           const gchar              *relative_path);
+gchar                    *ide_ctags_index_resolve_path    (IdeCtagsIndex            *self,
+                                                           const gchar              *path);
+GFile                    *ide_ctags_index_get_file        (IdeCtagsIndex            *self);
+gboolean                  ide_ctags_index_get_is_empty    (IdeCtagsIndex            *self);
+gsize                     ide_ctags_index_get_size        (IdeCtagsIndex            *self);
+gsize                     ide_ctags_index_get_memory_size (IdeCtagsIndex            *self);
+const gchar              *ide_ctags_index_get_path_root   (IdeCtagsIndex            *self);
+const IdeCtagsIndexEntry *ide_ctags_index_lookup          (IdeCtagsIndex            *self,
+                                                           const gchar              *keyword,
+                                                           gsize                    *length);
+const IdeCtagsIndexEntry *ide_ctags_index_lookup_prefix   (IdeCtagsIndex            *self,
+                                                           const gchar              *keyword,
+                                                           gsize                    *length);
+guint64                   ide_ctags_index_get_mtime       (IdeCtagsIndex            *self);
+gint                      ide_ctags_index_entry_compare   (gconstpointer             a,
+                                                           gconstpointer             b);
+IdeCtagsIndexEntry       *ide_ctags_index_entry_copy      (const IdeCtagsIndexEntry *entry);
+gboolean                  ide_ctags_index_write_binary    (GFile                    *tags_file,
+                                                           GCancellable             *cancellable,
+                                                           GError                  **error);
+void                      ide_ctags_index_entry_free      (IdeCtagsIndexEntry       *entry);
 
 static inline IdeSymbolKind
 ide_ctags_index_entry_kind_to_symbol_kind (IdeCtagsIndexEntryKind kind)
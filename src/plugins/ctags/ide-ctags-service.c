@@ -824,6 +824,13 @@ ide_ctags_service_class_init (IdeCtagsServiceClass *klass)
   g_object_class_install_properties (object_class, N_PROPS, properties);
 }
 
+static gsize
+ide_ctags_service_index_size (gconstpointer key,
+                              gconstpointer value)
+{
+  return ide_ctags_index_get_memory_size ((IdeCtagsIndex *)value);
+}
+
 static void
 ide_ctags_service_init (IdeCtagsService *self)
 {
@@ -846,6 +853,7 @@ ide_ctags_service_init (IdeCtagsService *self)
                                       NULL);
 
   ide_task_cache_set_name (self->indexes, "ctags index cache");
+  ide_task_cache_set_size_func (self->indexes, ide_ctags_service_index_size);
 }
 
 /**
@@ -19,6 +19,7 @@
  */
 
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 
 #include "ide-ctags-index.h"
 
@@ -32,6 +33,8 @@ init_cb (GObject      *object,
   GAsyncInitable *initable = (GAsyncInitable *)object;
   IdeCtagsIndex *index = (IdeCtagsIndex *)object;
   const IdeCtagsIndexEntry *entries;
+  const IdeCtagsIndexEntry *again;
+  GPtrArray *with_path;
   gsize n_entries = 0xFFFFFFFF;
   GError *error = NULL;
   gboolean ret;
@@ -73,6 +76,20 @@ init_cb (GObject      *object,
       g_assert_true (r);
     }
 
+  /* Entries must remain stable across lookups */
+  again = ide_ctags_index_lookup_prefix (index, "G_DEFINE_", &n_entries);
+  g_assert_true (again == entries);
+
+  entries = ide_ctags_index_lookup (index, "bug_buddy_init", &n_entries);
+  with_path = ide_ctags_index_find_with_path (index, entries[0].path);
+  g_assert_cmpint (with_path->len, >, 0);
+  for (i = 0; i < with_path->len; i++)
+    {
+      const IdeCtagsIndexEntry *entry = g_ptr_array_index (with_path, i);
+      g_assert_cmpstr (entry->path, ==, entries[0].path);
+    }
+  g_ptr_array_unref (with_path);
+
   g_main_loop_quit (main_loop);
 }
 
@@ -103,11 +120,70 @@ test_ctags_basic (void)
   g_object_unref (test_file);
 }
 
+static void
+test_ctags_binary (void)
+{
+  IdeCtagsIndex *index;
+  GFile *test_file;
+  GFile *copy;
+  GError *error = NULL;
+  gchar *path;
+  gchar *tmpdir;
+  gchar *copy_path;
+  gchar *idx_path;
+  gboolean ret;
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  path = g_build_filename (TEST_DATA_DIR, "../../plugins/ctags", "test-tags", NULL);
+  test_file = g_file_new_for_path (path);
+
+  tmpdir = g_dir_make_tmp ("test-ctags-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  copy_path = g_build_filename (tmpdir, "tags", NULL);
+  copy = g_file_new_for_path (copy_path);
+  ret = g_file_copy (test_file, copy, G_FILE_COPY_NONE, NULL, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+
+  ret = ide_ctags_index_write_binary (copy, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+
+  idx_path = g_strconcat (copy_path, ".idx", NULL);
+  g_assert_true (g_file_test (idx_path, G_FILE_TEST_IS_REGULAR));
+
+  index = ide_ctags_index_new (copy, NULL, 0);
+
+  g_async_initable_init_async (G_ASYNC_INITABLE (index),
+                               G_PRIORITY_DEFAULT,
+                               NULL,
+                               init_cb,
+                               NULL);
+
+  g_main_loop_run (main_loop);
+
+  g_object_unref (index);
+
+  g_unlink (idx_path);
+  g_unlink (copy_path);
+  g_rmdir (tmpdir);
+
+  g_free (idx_path);
+  g_free (copy_path);
+  g_free (tmpdir);
+  g_free (path);
+  g_object_unref (copy);
+  g_object_unref (test_file);
+}
+
 gint
 main (gint   argc,
       gchar *argv[])
 {
   g_test_init (&argc, &argv, NULL);
   g_test_add_func ("/Ide/CTags/basic", test_ctags_basic);
+  g_test_add_func ("/Ide/CTags/binary", test_ctags_binary);
   return g_test_run ();
 }
@@ -0,0 +1,145 @@
+/* gbp-editorui-placeholder-page.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "gbp-editorui-placeholder-page"
+
+#include "config.h"
+
+#include <adwaita.h>
+
+#include <libide-io.h>
+
+#include "gbp-editorui-placeholder-page.h"
+
+/* A page restored from the session which has not loaded its buffer yet.
+ * It keeps the session item around so that it may be saved again as-is
+ * and is replaced by an IdeEditorPage once the buffer is loaded.
+ */
+
+struct _GbpEditoruiPlaceholderPage
+{
+  IdePage         parent_instance;
+  IdeSessionItem *item;
+  GFile          *file;
+  guint           loading : 1;
+};
+
+G_DEFINE_FINAL_TYPE (GbpEditoruiPlaceholderPage, gbp_editorui_placeholder_page, IDE_TYPE_PAGE)
+
+static GFile *
+gbp_editorui_placeholder_page_get_file_or_directory (IdePage *page)
+{
+  return g_object_ref (GBP_EDITORUI_PLACEHOLDER_PAGE (page)->file);
+}
+
+static void
+gbp_editorui_placeholder_page_dispose (GObject *object)
+{
+  GbpEditoruiPlaceholderPage *self = (GbpEditoruiPlaceholderPage *)object;
+
+  g_clear_object (&self->item);
+  g_clear_object (&self->file);
+
+  G_OBJECT_CLASS (gbp_editorui_placeholder_page_parent_class)->dispose (object);
+}
+
+static void
+gbp_editorui_placeholder_page_class_init (GbpEditoruiPlaceholderPageClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  IdePageClass *page_class = IDE_PAGE_CLASS (klass);
+
+  object_class->dispose = gbp_editorui_placeholder_page_dispose;
+
+  page_class->get_file_or_directory = gbp_editorui_placeholder_page_get_file_or_directory;
+}
+
+static void
+gbp_editorui_placeholder_page_init (GbpEditoruiPlaceholderPage *self)
+{
+  GtkWidget *spinner;
+
+  spinner = g_object_new (ADW_TYPE_SPINNER,
+                          "height-request", 32,
+                          "width-request", 32,
+                          "halign", GTK_ALIGN_CENTER,
+                          "valign", GTK_ALIGN_CENTER,
+                          NULL);
+  ide_page_add_content_widget (IDE_PAGE (self), spinner);
+}
+
+IdePage *
+gbp_editorui_placeholder_page_new (IdeSessionItem *item,
+                                   GFile          *file)
+{
+  GbpEditoruiPlaceholderPage *self;
+  g_autofree char *name = NULL;
+  g_autofree char *content_type = NULL;
+  g_autoptr(GIcon) icon = NULL;
+
+  g_return_val_if_fail (IDE_IS_SESSION_ITEM (item), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  name = g_file_get_basename (file);
+  content_type = g_content_type_guess (name, NULL, 0, NULL);
+  icon = ide_g_content_type_get_symbolic_icon (content_type, name);
+
+  self = g_object_new (GBP_TYPE_EDITORUI_PLACEHOLDER_PAGE,
+                       "title", name,
+                       "icon", icon,
+                       NULL);
+  self->item = g_object_ref (item);
+  self->file = g_object_ref (file);
+
+  return IDE_PAGE (self);
+}
+
+IdeSessionItem *
+gbp_editorui_placeholder_page_get_item (GbpEditoruiPlaceholderPage *self)
+{
+  g_return_val_if_fail (GBP_IS_EDITORUI_PLACEHOLDER_PAGE (self), NULL);
+
+  return self->item;
+}
+
+GFile *
+gbp_editorui_placeholder_page_get_file (GbpEditoruiPlaceholderPage *self)
+{
+  g_return_val_if_fail (GBP_IS_EDITORUI_PLACEHOLDER_PAGE (self), NULL);
+
+  return self->file;
+}
+
+gboolean
+gbp_editorui_placeholder_page_get_loading (GbpEditoruiPlaceholderPage *self)
+{
+  g_return_val_if_fail (GBP_IS_EDITORUI_PLACEHOLDER_PAGE (self), FALSE);
+
+  return self->loading;
+}
+
+void
+gbp_editorui_placeholder_page_set_loading (GbpEditoruiPlaceholderPage *self,
+                                           gboolean                    loading)
+{
+  g_return_if_fail (GBP_IS_EDITORUI_PLACEHOLDER_PAGE (self));
+
+  self->loading = !!loading;
+}
@@ -0,0 +1,39 @@
+/* gbp-editorui-placeholder-page.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <libide-gui.h>
+
+G_BEGIN_DECLS
+
+#define GBP_TYPE_EDITORUI_PLACEHOLDER_PAGE (gbp_editorui_placeholder_page_get_type())
+
+G_DECLARE_FINAL_TYPE (GbpEditoruiPlaceholderPage, gbp_editorui_placeholder_page, GBP, EDITORUI_PLACEHOLDER_PAGE, IdePage)
+
+IdePage        *gbp_editorui_placeholder_page_new         (IdeSessionItem             *item,
+                                                           GFile                      *file);
+IdeSessionItem *gbp_editorui_placeholder_page_get_item    (GbpEditoruiPlaceholderPage *self);
+GFile          *gbp_editorui_placeholder_page_get_file    (GbpEditoruiPlaceholderPage *self);
+gboolean        gbp_editorui_placeholder_page_get_loading (GbpEditoruiPlaceholderPage *self);
+void            gbp_editorui_placeholder_page_set_loading (GbpEditoruiPlaceholderPage *self,
+                                                           gboolean                    loading);
+
+G_END_DECLS
@@ -29,6 +29,7 @@
 
 #include "ide-workspace-private.h"
 
+#include "gbp-editorui-placeholder-page.h"
 #include "gbp-editorui-position-label.h"
 #include "gbp-editorui-workspace-addin.h"
 
@@ -67,13 +68,28 @@ struct _GbpEditoruiWorkspaceAddin
 
   guint                     queued_cursor_moved;
 
+  /* Placeholder pages from the session which are loaded in the
+   * background unless they are shown first.
+   */
+  GQueue                    pending_pages;
+  guint                     n_loading_pages;
+  guint                     queued_pending_pages;
+  gint64                    restore_begin;
+
+  /* Monotonic time of the restore, reported once every page loaded */
+  gint64                    restore_started;
+  gint64                    restore_focused;
+  guint                     n_restored_pages;
+
   IdeEditorPage            *page;
 };
 
 typedef struct
 {
+  GbpEditoruiWorkspaceAddin *self;
   IdeWorkspace *workspace;
   PanelPosition *position;
+  IdePage *placeholder;
   char *uri;
   char *language_id;
   guint sel_insert_line;
@@ -81,10 +97,24 @@ typedef struct
   guint sel_bounds_line;
   guint sel_bounds_line_offset;
   gboolean has_focus;
+  gboolean is_front;
+  guint from_placeholder : 1;
 } RestorePage;
 
+/* Limit how many placeholder pages load their buffers at once in the
+ * background so that buffer addins don't all start at the same time.
+ */
+#define MAX_BACKGROUND_LOADS    2
+#define BACKGROUND_DELAY_MSEC 500
+
 static IdeActionMixin action_mixin;
 
+/* Set IDE_EAGER_SESSION_RESTORE to load every page right away, which
+ * is how sessions were restored before placeholders. Only useful to
+ * compare the two with bench-session-restore.py.
+ */
+static gboolean eager_session_restore;
+
 #define clear_from_statusbar(s,w) clear_from_statusbar(s, (GtkWidget **)w)
 
 static void
@@ -101,6 +131,10 @@ static void
 static void
 restore_page_free (RestorePage *rp)
 {
+  if (rp->placeholder != NULL)
+    ide_page_unobserve (rp->placeholder, &rp->placeholder);
+
+  g_clear_object (&rp->self);
   g_clear_object (&rp->workspace);
   g_clear_object (&rp->position);
   g_clear_pointer (&rp->uri, g_free);
@@ -609,6 +643,8 @@ gbp_editorui_workspace_addin_unload (IdeWorkspaceAddin *addin,
   g_clear_object (&self->editor_settings);
 
   g_clear_handle_id (&self->queued_cursor_moved, g_source_remove);
+  g_clear_handle_id (&self->queued_pending_pages, g_source_remove);
+  g_queue_clear_full (&self->pending_pages, g_object_unref);
 
   clear_from_statusbar (self->statusbar, &self->indentation);
   clear_from_statusbar (self->statusbar, &self->position);
@@ -674,6 +710,17 @@ gbp_editorui_workspace_addin_ref_action_group (IdeWorkspaceAddin *addin)
   return g_object_ref (G_ACTION_GROUP (ide_action_mixin_get_action_muxer (addin)));
 }
 
+static gboolean
+page_is_front (IdePage *page)
+{
+  GtkWidget *frame;
+
+  if ((frame = gtk_widget_get_ancestor (GTK_WIDGET (page), PANEL_TYPE_FRAME)))
+    return panel_frame_get_visible_child (PANEL_FRAME (frame)) == PANEL_WIDGET (page);
+
+  return FALSE;
+}
+
 static void
 gbp_editorui_workspace_addin_save_session_page_cb (IdePage  *page,
                                                    gpointer  user_data)
@@ -721,6 +768,18 @@ gbp_editorui_workspace_addin_save_session_page_cb (IdePage  *page,
       if (page == ide_workspace_get_most_recent_page (workspace))
         ide_session_item_set_metadata (item, "has-focus", "b", TRUE);
 
+      if (page_is_front (page))
+        ide_session_item_set_metadata (item, "is-front", "b", TRUE);
+
+      ide_session_append (session, item);
+    }
+  else if (GBP_IS_EDITORUI_PLACEHOLDER_PAGE (page))
+    {
+      IdeSessionItem *item = gbp_editorui_placeholder_page_get_item (GBP_EDITORUI_PLACEHOLDER_PAGE (page));
+      g_autoptr(PanelPosition) position = ide_page_get_position (page);
+
+      /* Save pages which were never loaded as they were restored */
+      ide_session_item_set_position (item, position);
       ide_session_append (session, item);
     }
 }
@@ -741,15 +800,63 @@ gbp_editorui_workspace_addin_save_session (IdeWorkspaceAddin *addin,
                               session);
 }
 
+typedef struct
+{
+  IdeBuffer *buffer;
+  IdePage   *page;
+} FindPage;
+
+static void
+find_page_for_buffer_cb (IdePage  *page,
+                         gpointer  user_data)
+{
+  FindPage *find = user_data;
+
+  if (find->page == NULL &&
+      IDE_IS_EDITOR_PAGE (page) &&
+      ide_editor_page_get_buffer (IDE_EDITOR_PAGE (page)) == find->buffer)
+    find->page = page;
+}
+
+static void gbp_editorui_workspace_addin_queue_pending (GbpEditoruiWorkspaceAddin *self,
+                                                        guint                      delay_msec);
+
+static void
+gbp_editorui_workspace_addin_restore_done (GbpEditoruiWorkspaceAddin *self)
+{
+  g_assert (GBP_IS_EDITORUI_WORKSPACE_ADDIN (self));
+
+  if (self->restore_started == 0 ||
+      self->n_loading_pages > 0 ||
+      self->pending_pages.length > 0)
+    return;
+
+  IDE_PROFILER_SPAN_END (self->restore_begin, "Session", "Restore All Pages", "%u pages", self->n_restored_pages);
+
+  g_debug ("Restored %u pages (%s): focused page after %"G_GINT64_FORMAT" usec, all pages after %"G_GINT64_FORMAT" usec",
+           self->n_restored_pages,
+           eager_session_restore ? "eager" : "lazy",
+           self->restore_focused ? self->restore_focused - self->restore_started : -1,
+           g_get_monotonic_time () - self->restore_started);
+
+  self->restore_begin = 0;
+  self->restore_started = 0;
+  self->restore_focused = 0;
+  self->n_restored_pages = 0;
+}
+
 static void
 restore_page_cb (GObject      *object,
                  GAsyncResult *result,
                  gpointer      user_data)
 {
   IdeBufferManager *buffer_manager = (IdeBufferManager *)object;
+  g_autoptr(PanelPosition) position = NULL;
   g_autoptr(IdeBuffer) buffer = NULL;
   g_autoptr(GError) error = NULL;
+  GbpEditoruiWorkspaceAddin *self;
   RestorePage *rp = user_data;
+  gboolean raise;
 
   IDE_ENTRY;
 
@@ -757,10 +864,44 @@ restore_page_cb (GObject      *object,
   g_assert (IDE_IS_BUFFER_MANAGER (buffer_manager));
   g_assert (G_IS_ASYNC_RESULT (result));
   g_assert (rp != NULL);
+  g_assert (GBP_IS_EDITORUI_WORKSPACE_ADDIN (rp->self));
+
+  self = rp->self;
+  self->n_loading_pages--;
+
+  buffer = ide_buffer_manager_load_file_finish (buffer_manager, result, &error);
 
-  if ((buffer = ide_buffer_manager_load_file_finish (buffer_manager, result, &error)))
+  /* The placeholder was closed while we were loading */
+  if (rp->from_placeholder && rp->placeholder == NULL)
+    IDE_GOTO (cleanup);
+
+  if (buffer != NULL)
     {
-      GtkWidget *page = ide_editor_page_new (buffer);
+      FindPage find = { buffer, NULL };
+      GtkWidget *page;
+
+      if (rp->placeholder != NULL)
+        {
+          position = ide_page_get_position (rp->placeholder);
+          raise = page_is_front (rp->placeholder);
+
+          /* The file may have been opened by other means in the mean time */
+          ide_workspace_foreach_page (rp->workspace, find_page_for_buffer_cb, &find);
+
+          if (find.page != NULL)
+            {
+              if (raise)
+                panel_widget_raise (PANEL_WIDGET (find.page));
+              IDE_GOTO (cleanup);
+            }
+        }
+      else
+        {
+          position = g_object_ref (rp->position);
+          raise = rp->is_front;
+        }
+
+      page = ide_editor_page_new (buffer);
 
       if (!ide_str_empty0 (rp->language_id))
         ide_buffer_set_language_id (buffer, rp->language_id);
@@ -782,40 +923,51 @@ restore_page_cb (GObject      *object,
           gtk_text_buffer_select_range (GTK_TEXT_BUFFER (buffer), &insert, &bounds);
         }
 
-      ide_workspace_add_page (rp->workspace, IDE_PAGE (page), rp->position);
+      ide_workspace_add_page (rp->workspace, IDE_PAGE (page), position);
 
       if (rp->has_focus)
         {
           panel_widget_raise (PANEL_WIDGET (page));
           gtk_widget_grab_focus (GTK_WIDGET (page));
+
+          self->restore_focused = g_get_monotonic_time ();
+          IDE_PROFILER_SPAN_END (self->restore_begin, "Session", "Restore Focused Page", "%s", rp->uri);
+        }
+      else if (raise)
+        {
+          panel_widget_raise (PANEL_WIDGET (page));
         }
     }
+  else
+    {
+      g_debug ("Failed to restore %s: %s", rp->uri, error->message);
+    }
+
+cleanup:
+  if (rp->placeholder != NULL)
+    ide_page_destroy (rp->placeholder);
+
+  if (self->workspace != NULL && self->pending_pages.length > 0)
+    gbp_editorui_workspace_addin_queue_pending (self, 0);
+
+  gbp_editorui_workspace_addin_restore_done (self);
 
   restore_page_free (rp);
 
   IDE_EXIT;
 }
 
-static void
-gbp_editorui_workspace_addin_restore_page (GbpEditoruiWorkspaceAddin *self,
-                                           IdeSessionItem            *item)
+static RestorePage *
+restore_page_new (GbpEditoruiWorkspaceAddin *self,
+                  IdeSessionItem            *item)
 {
-  IdeBufferManager *buffer_manager;
-  g_autoptr(IdeNotification) notif = NULL;
-  g_autoptr(GFile) file = NULL;
   RestorePage *rp;
-  IdeContext *context;
-
-  IDE_ENTRY;
 
-  g_assert (IDE_IS_MAIN_THREAD ());
   g_assert (GBP_IS_EDITORUI_WORKSPACE_ADDIN (self));
   g_assert (IDE_IS_SESSION_ITEM (item));
 
-  context = ide_workspace_get_context (self->workspace);
-  buffer_manager = ide_buffer_manager_from_context (context);
-
   rp = g_slice_new0 (RestorePage);
+  g_set_object (&rp->self, self);
   g_set_object (&rp->workspace, self->workspace);
   g_set_object (&rp->position, ide_session_item_get_position (item));
 
@@ -828,6 +980,9 @@ gbp_editorui_workspace_addin_restore_page (GbpEditoruiWorkspaceAddin *self,
   if (ide_session_item_has_metadata_with_type (item, "has-focus", G_VARIANT_TYPE ("b")))
     ide_session_item_get_metadata (item, "has-focus", "b", &rp->has_focus);
 
+  if (ide_session_item_has_metadata_with_type (item, "is-front", G_VARIANT_TYPE ("b")))
+    ide_session_item_get_metadata (item, "is-front", "b", &rp->is_front);
+
   if (ide_session_item_has_metadata_with_type (item, "selection", G_VARIANT_TYPE ("((uu)(uu))")))
     ide_session_item_get_metadata (item, "selection", "((uu)(uu))",
                                    &rp->sel_insert_line,
@@ -835,23 +990,172 @@ gbp_editorui_workspace_addin_restore_page (GbpEditoruiWorkspaceAddin *self,
                                    &rp->sel_bounds_line,
                                    &rp->sel_bounds_line_offset);
 
-  if (!(file = g_file_new_for_uri (rp->uri)))
-    IDE_GOTO (failure);
+  return rp;
+}
+
+static void
+gbp_editorui_workspace_addin_load_page (GbpEditoruiWorkspaceAddin *self,
+                                        RestorePage               *rp)
+{
+  g_autoptr(IdeNotification) notif = NULL;
+  g_autoptr(GFile) file = NULL;
+  IdeBufferManager *buffer_manager;
+  IdeContext *context;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (GBP_IS_EDITORUI_WORKSPACE_ADDIN (self));
+  g_assert (rp != NULL);
+  g_assert (rp->uri != NULL);
 
+  context = ide_workspace_get_context (self->workspace);
+  buffer_manager = ide_buffer_manager_from_context (context);
+  file = g_file_new_for_uri (rp->uri);
   notif = ide_notification_new ();
 
+  self->n_loading_pages++;
+
   ide_buffer_manager_load_file_async (buffer_manager,
                                       file,
                                       IDE_BUFFER_OPEN_FLAGS_NONE,
                                       notif,
                                       NULL,
                                       restore_page_cb,
-                                      g_steal_pointer (&rp));
+                                      rp);
+
+  IDE_EXIT;
+}
+
+static void
+gbp_editorui_workspace_addin_load_placeholder (GbpEditoruiWorkspaceAddin  *self,
+                                               GbpEditoruiPlaceholderPage *placeholder)
+{
+  RestorePage *rp;
+
+  IDE_ENTRY;
+
+  g_assert (GBP_IS_EDITORUI_WORKSPACE_ADDIN (self));
+  g_assert (GBP_IS_EDITORUI_PLACEHOLDER_PAGE (placeholder));
+
+  if (self->workspace == NULL ||
+      gbp_editorui_placeholder_page_get_loading (placeholder) ||
+      gtk_widget_get_parent (GTK_WIDGET (placeholder)) == NULL)
+    IDE_EXIT;
+
+  gbp_editorui_placeholder_page_set_loading (placeholder, TRUE);
+
+  rp = restore_page_new (self, gbp_editorui_placeholder_page_get_item (placeholder));
+  rp->from_placeholder = TRUE;
+  ide_page_observe (IDE_PAGE (placeholder), &rp->placeholder);
+
+  gbp_editorui_workspace_addin_load_page (self, rp);
 
   IDE_EXIT;
+}
+
+static gboolean
+gbp_editorui_workspace_addin_load_pending (gpointer data)
+{
+  GbpEditoruiWorkspaceAddin *self = data;
+
+  g_assert (GBP_IS_EDITORUI_WORKSPACE_ADDIN (self));
+
+  self->queued_pending_pages = 0;
+
+  while (self->n_loading_pages < MAX_BACKGROUND_LOADS &&
+         self->pending_pages.length > 0)
+    {
+      g_autoptr(GbpEditoruiPlaceholderPage) placeholder = g_queue_pop_head (&self->pending_pages);
+
+      gbp_editorui_workspace_addin_load_placeholder (self, placeholder);
+    }
+
+  /* Placeholders closed before they loaded leave nothing to wait for */
+  gbp_editorui_workspace_addin_restore_done (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gbp_editorui_workspace_addin_queue_pending (GbpEditoruiWorkspaceAddin *self,
+                                            guint                      delay_msec)
+{
+  g_assert (GBP_IS_EDITORUI_WORKSPACE_ADDIN (self));
+
+  if (self->queued_pending_pages != 0)
+    return;
+
+  self->queued_pending_pages = g_timeout_add_full (G_PRIORITY_LOW,
+                                                   delay_msec,
+                                                   gbp_editorui_workspace_addin_load_pending,
+                                                   self,
+                                                   NULL);
+}
+
+static void
+gbp_editorui_workspace_addin_placeholder_map_cb (GbpEditoruiWorkspaceAddin  *self,
+                                                 GbpEditoruiPlaceholderPage *placeholder)
+{
+  g_assert (GBP_IS_EDITORUI_WORKSPACE_ADDIN (self));
+  g_assert (GBP_IS_EDITORUI_PLACEHOLDER_PAGE (placeholder));
+
+  /* Shown pages skip the background queue and its limit */
+  gbp_editorui_workspace_addin_load_placeholder (self, placeholder);
+}
+
+static void
+gbp_editorui_workspace_addin_restore_page (GbpEditoruiWorkspaceAddin *self,
+                                           IdeSessionItem            *item)
+{
+  g_autoptr(GFile) file = NULL;
+  IdePage *placeholder;
+  RestorePage *rp;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (GBP_IS_EDITORUI_WORKSPACE_ADDIN (self));
+  g_assert (IDE_IS_SESSION_ITEM (item));
+
+  if (self->restore_begin == 0)
+    self->restore_begin = IDE_PROFILER_SPAN_BEGIN ();
+
+  if (self->restore_started == 0)
+    self->restore_started = g_get_monotonic_time ();
+  self->n_restored_pages++;
+
+  rp = restore_page_new (self, item);
+
+  if (ide_str_empty0 (rp->uri))
+    IDE_GOTO (failure);
+
+  /* Only the focused page and the visible page of each frame are loaded
+   * right away. Everything else gets a placeholder so that we don't start
+   * buffer addins for files nobody is looking at.
+   */
+  if (rp->has_focus || rp->is_front || eager_session_restore)
+    {
+      gbp_editorui_workspace_addin_load_page (self, g_steal_pointer (&rp));
+      IDE_EXIT;
+    }
+
+  file = g_file_new_for_uri (rp->uri);
+  placeholder = gbp_editorui_placeholder_page_new (item, file);
+
+  g_signal_connect_object (placeholder,
+                           "map",
+                           G_CALLBACK (gbp_editorui_workspace_addin_placeholder_map_cb),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  ide_workspace_add_page (self->workspace, placeholder, rp->position);
+
+  g_queue_push_tail (&self->pending_pages, g_object_ref (placeholder));
+  gbp_editorui_workspace_addin_queue_pending (self, BACKGROUND_DELAY_MSEC);
 
 failure:
-  restore_page_free (rp);
+  g_clear_pointer (&rp, restore_page_free);
 
   IDE_EXIT;
 }
@@ -906,6 +1210,8 @@ gbp_editorui_workspace_addin_class_init (GbpEditoruiWorkspaceAddinClass *klass)
   ide_action_mixin_init (&action_mixin, object_class);
   ide_action_mixin_install_action (&action_mixin, "page.go-to-line", NULL, show_go_to_line);
   ide_action_mixin_install_action (&action_mixin, "page.new", NULL, new_file);
+
+  eager_session_restore = g_getenv ("IDE_EAGER_SESSION_RESTORE") != NULL;
 }
 
 static void
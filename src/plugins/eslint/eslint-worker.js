@@ -0,0 +1,102 @@
+/* eslint-worker.js
+ *
+ * Copyright 2022 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* This script is run with "node -e" and the path to the eslint program
+ * as the only argument. It keeps a single ESLint instance alive and
+ * answers the requests of IdeDiagnosticToolWorker on standard input
+ * with the same JSON that "eslint -f json" would print.
+ */
+
+const fs = require('fs');
+const path = require('path');
+
+function findProgram(program) {
+  if (program.includes(path.sep))
+    return program;
+  for (const dir of (process.env.PATH || '').split(path.delimiter)) {
+    const candidate = path.join(dir, program);
+    if (fs.existsSync(candidate))
+      return candidate;
+  }
+  return program;
+}
+
+/* The program is eslint/bin/eslint.js, or a link to it */
+const program = fs.realpathSync(findProgram(process.argv[1]));
+const { ESLint } = require(path.join(path.dirname(program), '..'));
+
+let eslint;
+try {
+  eslint = new ESLint({ ignorePatterns: ['!node_modules/*', '!bower_components/*'] });
+} catch (e) {
+  /* Older releases do not accept ignorePatterns */
+  eslint = new ESLint();
+}
+
+let formatter = null;
+let buffer = Buffer.alloc(0);
+let queue = Promise.resolve();
+
+function reply(text) {
+  const body = Buffer.from(text, 'utf8');
+  process.stdout.write('Content-Length: ' + body.length + '\r\n\r\n');
+  process.stdout.write(body);
+}
+
+async function lint(filePath, text) {
+  try {
+    if (formatter === null)
+      formatter = await eslint.loadFormatter('json');
+    const results = await eslint.lintText(text, { filePath, warnIgnored: false });
+    reply(await formatter.format(results));
+  } catch (e) {
+    process.stderr.write(String(e) + '\n');
+    reply('[]');
+  }
+}
+
+process.stdin.on('data', (chunk) => {
+  buffer = Buffer.concat([buffer, chunk]);
+
+  for (;;) {
+    const end = buffer.indexOf('\r\n\r\n');
+    if (end < 0)
+      break;
+
+    const headers = {};
+    for (const line of buffer.subarray(0, end).toString('utf8').split('\r\n')) {
+      const colon = line.indexOf(':');
+      if (colon > 0)
+        headers[line.slice(0, colon).trim().toLowerCase()] = line.slice(colon + 1).trim();
+    }
+
+    const length = parseInt(headers['content-length'] || '0', 10);
+    if (buffer.length < end + 4 + length)
+      break;
+
+    const text = buffer.subarray(end + 4, end + 4 + length).toString('utf8');
+    const filePath = headers['x-path'];
+
+    buffer = buffer.subarray(end + 4 + length);
+    queue = queue.then(() => lint(filePath, text));
+  }
+});
+
+process.stdin.on('end', () => queue.then(() => process.exit(0)));
@@ -41,6 +41,8 @@ struct _GbpEslintDiagnosticProvider
 
 G_DEFINE_FINAL_TYPE (GbpEslintDiagnosticProvider, gbp_eslint_diagnostic_provider, IDE_TYPE_DIAGNOSTIC_TOOL)
 
+static GBytes *eslint_worker;
+
 static gboolean
 gbp_eslint_diagnostic_provider_prepare_run_context (IdeDiagnosticTool  *tool,
                                                     IdeRunContext      *run_context,
@@ -70,6 +72,40 @@ gbp_eslint_diagnostic_provider_prepare_run_context (IdeDiagnosticTool  *tool,
   return FALSE;
 }
 
+static gboolean
+gbp_eslint_diagnostic_provider_prepare_worker_run_context (IdeDiagnosticTool  *tool,
+                                                           IdeRunContext      *run_context,
+                                                           GError            **error)
+{
+  g_autofree char *program = NULL;
+  const char * const *argv;
+
+  g_assert (GBP_IS_ESLINT_DIAGNOSTIC_PROVIDER (tool));
+  g_assert (IDE_IS_RUN_CONTEXT (run_context));
+
+  /* The parent class left us with just the eslint program, which we hand
+   * to a small node script keeping a single ESLint instance around.
+   */
+  if (!(argv = ide_run_context_get_argv (run_context)) || argv[0] == NULL)
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_NOT_FOUND,
+                           "Failed to locate eslint");
+      return FALSE;
+    }
+
+  program = g_strdup (argv[g_strv_length ((char **)argv) - 1]);
+
+  ide_run_context_set_argv (run_context,
+                            IDE_STRV_INIT ("node",
+                                           "-e",
+                                           (const char *)g_bytes_get_data (eslint_worker, NULL),
+                                           program));
+
+  return TRUE;
+}
+
 static inline IdeDiagnosticSeverity
 parse_severity (int n)
 {
@@ -181,7 +217,10 @@ gbp_eslint_diagnostic_provider_class_init (GbpEslintDiagnosticProviderClass *kla
   IdeDiagnosticToolClass *diagnostic_tool_class = IDE_DIAGNOSTIC_TOOL_CLASS (klass);
 
   diagnostic_tool_class->prepare_run_context = gbp_eslint_diagnostic_provider_prepare_run_context;
+  diagnostic_tool_class->prepare_worker_run_context = gbp_eslint_diagnostic_provider_prepare_worker_run_context;
   diagnostic_tool_class->populate_diagnostics = gbp_eslint_diagnostic_provider_populate_diagnostics;
+
+  eslint_worker = g_resources_lookup_data ("/plugins/eslint/eslint-worker.js", 0, NULL);
 }
 
 static void
@@ -0,0 +1,966 @@
+/* blame-cache.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "blame-cache"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "blame-cache.h"
+
+/* The blame of a file is fully determined by the commit it was
+ * computed at, the path within the tree, and the contents of the
+ * blob at that path. We use that triplet as our cache key so that
+ * entries can be shared between checkouts of the same repository.
+ *
+ * Entries are kept in memory in LRU order and written to disk in a
+ * compact binary form so that re-opening a file (or restarting the
+ * daemon) does not require walking the entire history again.
+ *
+ * When HEAD moves, we walk back along first-parent history looking
+ * for a cached blame of an ancestor. If only a few commits touched
+ * the file since then, we ask libgit2 to stop at that ancestor and
+ * attribute the boundary lines using the cached ancestor blame. The
+ * names of the files on disk are indexed on first use so that the
+ * walk only reads the file of the ancestor it settles on.
+ */
+
+#define BLAME_CACHE_MAGIC         0x4C424247 /* GBBL */
+#define BLAME_CACHE_VERSION       1
+#define BLAME_CACHE_MEMORY_BUDGET (8 * 1024 * 1024)
+#define BLAME_CACHE_DISK_BUDGET   (64 * 1024 * 1024)
+#define MAX_INCREMENTAL_DEPTH     256
+#define MAX_INCREMENTAL_CHANGES   8
+
+typedef struct
+{
+  guint32 magic;
+  guint32 version;
+  guint32 n_hunks;
+  guint32 reserved;
+} BlameFileHeader;
+
+typedef struct
+{
+  guint32 final_start;
+  guint32 n_lines;
+  guint32 orig_start;
+  guint8  commit_id[BLAME_OID_SIZE];
+} BlameFileRecord;
+
+G_STATIC_ASSERT (sizeof (BlameFileHeader) == 16);
+G_STATIC_ASSERT (sizeof (BlameFileRecord) == 32);
+
+typedef struct
+{
+  GList   link;
+  char   *key;
+  GArray *hunks;
+  gsize   size;
+} BlameCacheEntry;
+
+struct _BlameCache
+{
+  GHashTable *entries;
+  GQueue      lru;
+  char       *directory;
+  /* Paths of the entries on disk, or NULL until scanned */
+  GHashTable *disk_paths;
+  gsize       memory_size;
+  gsize       memory_budget;
+  goffset     disk_size;
+  goffset     disk_budget;
+};
+
+typedef struct
+{
+  int old_start;
+  int old_lines;
+  int new_start;
+  int new_lines;
+} Range;
+
+typedef struct
+{
+  char    *path;
+  goffset  size;
+  gint64   mtime;
+} DiskEntry;
+
+static void
+blame_cache_entry_free (gpointer data)
+{
+  BlameCacheEntry *entry = data;
+
+  g_clear_pointer (&entry->key, g_free);
+  g_clear_pointer (&entry->hunks, g_array_unref);
+  g_free (entry);
+}
+
+static void
+disk_entry_clear (gpointer data)
+{
+  DiskEntry *entry = data;
+
+  g_clear_pointer (&entry->path, g_free);
+}
+
+static int
+disk_entry_compare (gconstpointer a,
+                    gconstpointer b)
+{
+  const DiskEntry *entry_a = a;
+  const DiskEntry *entry_b = b;
+
+  if (entry_a->mtime < entry_b->mtime)
+    return -1;
+  else if (entry_a->mtime > entry_b->mtime)
+    return 1;
+  else
+    return 0;
+}
+
+BlameCache *
+blame_cache_get_default (void)
+{
+  static BlameCache *instance;
+
+  if (instance == NULL)
+    {
+      instance = g_new0 (BlameCache, 1);
+      instance->entries = g_hash_table_new (g_str_hash, g_str_equal);
+      instance->directory = g_build_filename (g_get_user_cache_dir (),
+                                              "gnome-builder",
+                                              "git",
+                                              "blame",
+                                              NULL);
+      instance->memory_budget = BLAME_CACHE_MEMORY_BUDGET;
+      instance->disk_budget = BLAME_CACHE_DISK_BUDGET;
+      instance->disk_size = -1;
+    }
+
+  return instance;
+}
+
+static char *
+blame_cache_make_key (const char *commit_id,
+                      const char *path,
+                      const char *blob_id)
+{
+  return g_strdup_printf ("%s\n%s\n%s", commit_id, path, blob_id);
+}
+
+static char *
+blame_cache_get_filename (BlameCache *self,
+                          const char *key)
+{
+  g_autofree char *checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, key, -1);
+  g_autofree char *name = g_strdup_printf ("%s.blame", checksum);
+
+  return g_build_filename (self->directory, name, NULL);
+}
+
+static gboolean
+oid_hex_to_raw (const char *hex,
+                guint8      raw[BLAME_OID_SIZE])
+{
+  if (hex == NULL || strlen (hex) < BLAME_OID_SIZE * 2)
+    return FALSE;
+
+  for (guint i = 0; i < BLAME_OID_SIZE; i++)
+    {
+      int hi = g_ascii_xdigit_value (hex[i * 2]);
+      int lo = g_ascii_xdigit_value (hex[i * 2 + 1]);
+
+      if (hi < 0 || lo < 0)
+        return FALSE;
+
+      raw[i] = (hi << 4) | lo;
+    }
+
+  return TRUE;
+}
+
+char *
+blame_hunk_dup_commit (const BlameHunk *hunk)
+{
+  static const char hex[] = "0123456789abcdef";
+  char *ret;
+
+  g_return_val_if_fail (hunk != NULL, NULL);
+
+  ret = g_malloc (BLAME_OID_SIZE * 2 + 1);
+
+  for (guint i = 0; i < BLAME_OID_SIZE; i++)
+    {
+      ret[i * 2] = hex[hunk->commit_id[i] >> 4];
+      ret[i * 2 + 1] = hex[hunk->commit_id[i] & 0xF];
+    }
+
+  ret[BLAME_OID_SIZE * 2] = 0;
+
+  return ret;
+}
+
+static int
+compare_hunk_by_line (gconstpointer a,
+                      gconstpointer b)
+{
+  guint line = *(const guint *)a;
+  const BlameHunk *hunk = b;
+
+  if (line < hunk->final_start)
+    return -1;
+  else if (line >= hunk->final_start + hunk->n_lines)
+    return 1;
+  else
+    return 0;
+}
+
+const BlameHunk *
+blame_hunks_lookup (GArray *hunks,
+                    guint   line)
+{
+  if (hunks == NULL || hunks->len == 0)
+    return NULL;
+
+  return bsearch (&line, (gconstpointer)hunks->data,
+                  hunks->len, sizeof (BlameHunk),
+                  compare_hunk_by_line);
+}
+
+static void
+blame_hunks_append_line (GArray       *hunks,
+                         guint         final_line,
+                         guint         orig_line,
+                         const guint8  commit_id[BLAME_OID_SIZE])
+{
+  BlameHunk hunk;
+
+  if (hunks->len > 0)
+    {
+      BlameHunk *last = &g_array_index (hunks, BlameHunk, hunks->len - 1);
+
+      if (last->final_start + last->n_lines == final_line &&
+          last->orig_start + last->n_lines == orig_line &&
+          memcmp (last->commit_id, commit_id, BLAME_OID_SIZE) == 0)
+        {
+          last->n_lines++;
+          return;
+        }
+    }
+
+  hunk.final_start = final_line;
+  hunk.n_lines = 1;
+  hunk.orig_start = orig_line;
+  memcpy (hunk.commit_id, commit_id, BLAME_OID_SIZE);
+
+  g_array_append_val (hunks, hunk);
+}
+
+static gsize
+blame_hunks_get_size (GArray *hunks)
+{
+  return sizeof (BlameCacheEntry) + (hunks->len * sizeof (BlameHunk));
+}
+
+static GBytes *
+blame_hunks_serialize (GArray *hunks)
+{
+  BlameFileHeader header;
+  BlameFileRecord *records;
+  gsize len;
+  guint8 *data;
+
+  len = sizeof header + (hunks->len * sizeof (BlameFileRecord));
+  data = g_malloc (len);
+
+  header.magic = GUINT32_TO_LE (BLAME_CACHE_MAGIC);
+  header.version = GUINT32_TO_LE (BLAME_CACHE_VERSION);
+  header.n_hunks = GUINT32_TO_LE (hunks->len);
+  header.reserved = 0;
+  memcpy (data, &header, sizeof header);
+
+  records = (BlameFileRecord *)(gpointer)(data + sizeof header);
+
+  for (guint i = 0; i < hunks->len; i++)
+    {
+      const BlameHunk *hunk = &g_array_index (hunks, BlameHunk, i);
+
+      records[i].final_start = GUINT32_TO_LE (hunk->final_start);
+      records[i].n_lines = GUINT32_TO_LE (hunk->n_lines);
+      records[i].orig_start = GUINT32_TO_LE (hunk->orig_start);
+      memcpy (records[i].commit_id, hunk->commit_id, BLAME_OID_SIZE);
+    }
+
+  return g_bytes_new_take (data, len);
+}
+
+static GArray *
+blame_hunks_deserialize (const guint8 *data,
+                         gsize         len)
+{
+  g_autoptr(GArray) hunks = NULL;
+  BlameFileHeader header;
+  guint n_hunks;
+
+  if (len < sizeof header)
+    return NULL;
+
+  memcpy (&header, data, sizeof header);
+
+  if (GUINT32_FROM_LE (header.magic) != BLAME_CACHE_MAGIC ||
+      GUINT32_FROM_LE (header.version) != BLAME_CACHE_VERSION)
+    return NULL;
+
+  n_hunks = GUINT32_FROM_LE (header.n_hunks);
+
+  if ((len - sizeof header) / sizeof (BlameFileRecord) != n_hunks ||
+      (len - sizeof header) % sizeof (BlameFileRecord) != 0)
+    return NULL;
+
+  hunks = g_array_sized_new (FALSE, FALSE, sizeof (BlameHunk), n_hunks);
+
+  for (guint i = 0; i < n_hunks; i++)
+    {
+      BlameFileRecord record;
+      BlameHunk hunk;
+
+      memcpy (&record, data + sizeof header + (i * sizeof record), sizeof record);
+
+      hunk.final_start = GUINT32_FROM_LE (record.final_start);
+      hunk.n_lines = GUINT32_FROM_LE (record.n_lines);
+      hunk.orig_start = GUINT32_FROM_LE (record.orig_start);
+      memcpy (hunk.commit_id, record.commit_id, BLAME_OID_SIZE);
+
+      /* Hunks must be sorted and non-overlapping for bsearch() */
+      if (hunk.n_lines == 0 ||
+          (i > 0 && hunk.final_start < g_array_index (hunks, BlameHunk, i - 1).final_start +
+                                       g_array_index (hunks, BlameHunk, i - 1).n_lines))
+        return NULL;
+
+      g_array_append_val (hunks, hunk);
+    }
+
+  return g_steal_pointer (&hunks);
+}
+
+static void
+blame_cache_trim_memory (BlameCache *self)
+{
+  while (self->memory_size > self->memory_budget && self->lru.length > 1)
+    {
+      BlameCacheEntry *entry = g_queue_peek_tail (&self->lru);
+
+      g_queue_unlink (&self->lru, &entry->link);
+      g_hash_table_remove (self->entries, entry->key);
+      self->memory_size -= entry->size;
+      blame_cache_entry_free (entry);
+    }
+}
+
+static void
+blame_cache_insert_memory (BlameCache *self,
+                           const char *key,
+                           GArray     *hunks)
+{
+  BlameCacheEntry *entry;
+
+  if ((entry = g_hash_table_lookup (self->entries, key)))
+    {
+      g_queue_unlink (&self->lru, &entry->link);
+      g_hash_table_remove (self->entries, entry->key);
+      self->memory_size -= entry->size;
+      blame_cache_entry_free (entry);
+    }
+
+  entry = g_new0 (BlameCacheEntry, 1);
+  entry->link.data = entry;
+  entry->key = g_strdup (key);
+  entry->hunks = g_array_ref (hunks);
+  entry->size = blame_hunks_get_size (hunks) + strlen (key);
+
+  g_hash_table_insert (self->entries, entry->key, entry);
+  g_queue_push_head_link (&self->lru, &entry->link);
+  self->memory_size += entry->size;
+
+  blame_cache_trim_memory (self);
+}
+
+static void
+blame_cache_scan_disk (BlameCache  *self,
+                       GArray      *entries)
+{
+  g_autoptr(GDir) dir = NULL;
+  const char *name;
+
+  self->disk_size = 0;
+
+  g_clear_pointer (&self->disk_paths, g_hash_table_unref);
+  self->disk_paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  if (!(dir = g_dir_open (self->directory, 0, NULL)))
+    return;
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      g_autofree char *path = NULL;
+      GStatBuf st;
+
+      if (!g_str_has_suffix (name, ".blame"))
+        continue;
+
+      path = g_build_filename (self->directory, name, NULL);
+
+      if (g_stat (path, &st) != 0)
+        continue;
+
+      self->disk_size += st.st_size;
+      g_hash_table_add (self->disk_paths, g_strdup (path));
+
+      if (entries != NULL)
+        {
+          DiskEntry entry;
+
+          entry.path = g_steal_pointer (&path);
+          entry.size = st.st_size;
+          entry.mtime = st.st_mtime;
+
+          g_array_append_val (entries, entry);
+        }
+    }
+}
+
+static void
+blame_cache_trim_disk (BlameCache *self)
+{
+  g_autoptr(GArray) entries = NULL;
+  goffset target;
+
+  if (self->disk_size < 0)
+    blame_cache_scan_disk (self, NULL);
+
+  if (self->disk_size <= self->disk_budget)
+    return;
+
+  entries = g_array_new (FALSE, FALSE, sizeof (DiskEntry));
+  g_array_set_clear_func (entries, disk_entry_clear);
+  blame_cache_scan_disk (self, entries);
+  g_array_sort (entries, disk_entry_compare);
+
+  /* Leave some headroom so we don't rescan on every insertion */
+  target = self->disk_budget / 4 * 3;
+
+  for (guint i = 0; i < entries->len && self->disk_size > target; i++)
+    {
+      const DiskEntry *entry = &g_array_index (entries, DiskEntry, i);
+
+      if (g_unlink (entry->path) == 0)
+        {
+          self->disk_size -= entry->size;
+          g_hash_table_remove (self->disk_paths, entry->path);
+        }
+    }
+}
+
+static gboolean
+blame_cache_contains_file (BlameCache *self,
+                           const char *filename)
+{
+  if (self->disk_paths == NULL)
+    blame_cache_scan_disk (self, NULL);
+
+  return g_hash_table_contains (self->disk_paths, filename);
+}
+
+static GArray *
+blame_cache_lookup (BlameCache *self,
+                    const char *key)
+{
+  g_autofree char *filename = NULL;
+  g_autofree char *data = NULL;
+  BlameCacheEntry *entry;
+  GArray *hunks;
+  gsize len = 0;
+
+  if ((entry = g_hash_table_lookup (self->entries, key)))
+    {
+      g_queue_unlink (&self->lru, &entry->link);
+      g_queue_push_head_link (&self->lru, &entry->link);
+      return g_array_ref (entry->hunks);
+    }
+
+  filename = blame_cache_get_filename (self, key);
+
+  if (!blame_cache_contains_file (self, filename))
+    return NULL;
+
+  if (!g_file_get_contents (filename, &data, &len, NULL))
+    {
+      g_hash_table_remove (self->disk_paths, filename);
+      return NULL;
+    }
+
+  if (!(hunks = blame_hunks_deserialize ((const guint8 *)data, len)))
+    {
+      g_debug ("Discarding corrupted blame cache at %s", filename);
+      g_hash_table_remove (self->disk_paths, filename);
+      g_unlink (filename);
+      return NULL;
+    }
+
+  /* Bump mtime so that disk trimming evicts least-recently-used first */
+  g_utime (filename, NULL);
+
+  blame_cache_insert_memory (self, key, hunks);
+
+  return hunks;
+}
+
+static void
+blame_cache_store (BlameCache *self,
+                   const char *key,
+                   GArray     *hunks)
+{
+  g_autofree char *filename = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GError) error = NULL;
+  gconstpointer data;
+  gsize len;
+
+  blame_cache_insert_memory (self, key, hunks);
+
+  if (g_mkdir_with_parents (self->directory, 0750) != 0)
+    return;
+
+  filename = blame_cache_get_filename (self, key);
+  bytes = blame_hunks_serialize (hunks);
+  data = g_bytes_get_data (bytes, &len);
+
+  if (!g_file_set_contents (filename, data, len, &error))
+    {
+      g_debug ("Failed to write blame cache: %s", error->message);
+      return;
+    }
+
+  if (self->disk_size >= 0)
+    self->disk_size += len;
+
+  if (self->disk_paths != NULL)
+    g_hash_table_add (self->disk_paths, g_steal_pointer (&filename));
+
+  blame_cache_trim_disk (self);
+}
+
+static GgitOId *
+lookup_blob_id (GgitCommit *commit,
+                const char *path,
+                GError    **error)
+{
+  g_autoptr(GgitTree) tree = NULL;
+  GgitTreeEntry *entry;
+  GgitOId *ret;
+
+  if (!(tree = ggit_commit_get_tree (commit)))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_FOUND,
+                   _("Failed to locate tree for commit"));
+      return NULL;
+    }
+
+  if (!(entry = ggit_tree_get_by_path (tree, path, error)))
+    return NULL;
+
+  ret = ggit_tree_entry_get_id (entry);
+  ggit_tree_entry_unref (entry);
+
+  return ret;
+}
+
+static GgitCommit *
+get_first_parent (GgitCommit *commit)
+{
+  g_autoptr(GgitCommitParents) parents = NULL;
+
+  if (!(parents = ggit_commit_get_parents (commit)) ||
+      ggit_commit_parents_get_size (parents) == 0)
+    return NULL;
+
+  return ggit_commit_parents_get (parents, 0);
+}
+
+static GArray *
+blame_cache_find_ancestor (BlameCache  *self,
+                           GgitCommit  *head,
+                           GgitOId     *head_blob_id,
+                           const char  *path,
+                           GgitOId    **ancestor_id,
+                           guint       *n_changes)
+{
+  g_autoptr(GgitCommit) commit = g_object_ref (head);
+  g_autoptr(GgitOId) blob_id = ggit_oid_copy (head_blob_id);
+
+  *ancestor_id = NULL;
+  *n_changes = 0;
+
+  for (guint depth = 0; depth < MAX_INCREMENTAL_DEPTH; depth++)
+    {
+      g_autoptr(GgitCommit) parent = NULL;
+      g_autoptr(GgitOId) parent_blob_id = NULL;
+      g_autoptr(GgitOId) parent_id = NULL;
+      g_autofree char *parent_id_str = NULL;
+      g_autofree char *parent_blob_id_str = NULL;
+      g_autofree char *key = NULL;
+      GArray *hunks;
+
+      if (!(parent = get_first_parent (commit)) ||
+          !(parent_blob_id = lookup_blob_id (parent, path, NULL)))
+        break;
+
+      if (!ggit_oid_equal (parent_blob_id, blob_id))
+        {
+          if (++(*n_changes) > MAX_INCREMENTAL_CHANGES)
+            break;
+        }
+
+      parent_id = ggit_object_get_id (GGIT_OBJECT (parent));
+      parent_id_str = ggit_oid_to_string (parent_id);
+      parent_blob_id_str = ggit_oid_to_string (parent_blob_id);
+      key = blame_cache_make_key (parent_id_str, path, parent_blob_id_str);
+
+      if ((hunks = blame_cache_lookup (self, key)))
+        {
+          *ancestor_id = g_steal_pointer (&parent_id);
+          return hunks;
+        }
+
+      g_set_object (&commit, parent);
+      g_clear_pointer (&blob_id, ggit_oid_free);
+      blob_id = g_steal_pointer (&parent_blob_id);
+    }
+
+  return NULL;
+}
+
+static GArray *
+blame_hunks_new_from_blame (GgitBlame *blame,
+                            GArray    *ancestor_hunks)
+{
+  g_autoptr(GArray) hunks = NULL;
+  guint n_hunks;
+
+  n_hunks = ggit_blame_get_hunk_count (blame);
+  hunks = g_array_sized_new (FALSE, FALSE, sizeof (BlameHunk), n_hunks);
+
+  for (guint i = 0; i < n_hunks; i++)
+    {
+      GgitBlameHunk *hunk = ggit_blame_get_hunk_by_index (blame, i);
+      g_autofree char *commit_id = NULL;
+      guint8 raw[BLAME_OID_SIZE];
+      guint final_start;
+      guint orig_start;
+      guint n_lines;
+
+      if (hunk == NULL)
+        continue;
+
+      final_start = ggit_blame_hunk_get_final_start_line_number (hunk);
+      orig_start = ggit_blame_hunk_get_orig_start_line_number (hunk);
+      n_lines = ggit_blame_hunk_get_lines_in_hunk (hunk);
+      commit_id = ggit_oid_to_string (ggit_blame_hunk_get_final_commit_id (hunk));
+
+      if (ancestor_hunks != NULL && ggit_blame_hunk_is_boundary (hunk))
+        {
+          /* These lines were last touched at or before the ancestor we
+           * stopped at, so translate them through the ancestor's blame.
+           */
+          for (guint j = 0; j < n_lines; j++)
+            {
+              const BlameHunk *orig = blame_hunks_lookup (ancestor_hunks, orig_start + j);
+
+              if (orig == NULL)
+                continue;
+
+              blame_hunks_append_line (hunks,
+                                       final_start + j,
+                                       orig->orig_start + (orig_start + j - orig->final_start),
+                                       orig->commit_id);
+            }
+        }
+      else if (oid_hex_to_raw (commit_id, raw))
+        {
+          BlameHunk item;
+
+          item.final_start = final_start;
+          item.n_lines = n_lines;
+          item.orig_start = orig_start;
+          memcpy (item.commit_id, raw, BLAME_OID_SIZE);
+
+          if (n_lines > 0)
+            g_array_append_val (hunks, item);
+        }
+
+      ggit_blame_hunk_unref (hunk);
+    }
+
+  return g_steal_pointer (&hunks);
+}
+
+/**
+ * blame_cache_blame_file:
+ * @self: a #BlameCache
+ * @repository: a #GgitRepository
+ * @path: the absolute path to the file
+ * @blob_id: (out) (optional): location for the blob at HEAD
+ * @error: a location for a #GError
+ *
+ * Gets the blame for @path at HEAD, using the cache when possible.
+ *
+ * Returns: (transfer full): a #GArray of #BlameHunk sorted by line
+ */
+GArray *
+blame_cache_blame_file (BlameCache      *self,
+                        GgitRepository  *repository,
+                        const char      *path,
+                        GgitOId        **blob_id,
+                        GError         **error)
+{
+  g_autoptr(GgitBlame) blame = NULL;
+  g_autoptr(GgitCommit) commit = NULL;
+  g_autoptr(GgitRef) head = NULL;
+  g_autoptr(GgitOId) head_id = NULL;
+  g_autoptr(GgitOId) head_blob_id = NULL;
+  g_autoptr(GgitOId) ancestor_id = NULL;
+  g_autoptr(GArray) ancestor_hunks = NULL;
+  g_autoptr(GFile) workdir = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autofree char *relative_path = NULL;
+  g_autofree char *head_id_str = NULL;
+  g_autofree char *blob_id_str = NULL;
+  g_autofree char *key = NULL;
+  GArray *hunks;
+  guint n_changes = 0;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (GGIT_IS_REPOSITORY (repository), NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+
+  if (blob_id != NULL)
+    *blob_id = NULL;
+
+  file = g_file_new_for_path (path);
+  workdir = ggit_repository_get_workdir (repository);
+
+  if (workdir == NULL || !(relative_path = g_file_get_relative_path (workdir, file)))
+    relative_path = g_strdup (path);
+
+  if (!(head = ggit_repository_get_head (repository, error)) ||
+      !(head_id = ggit_ref_get_target (head)) ||
+      !(commit = ggit_repository_lookup_commit (repository, head_id, error)) ||
+      !(head_blob_id = lookup_blob_id (commit, relative_path, error)))
+    return NULL;
+
+  head_id_str = ggit_oid_to_string (head_id);
+  blob_id_str = ggit_oid_to_string (head_blob_id);
+  key = blame_cache_make_key (head_id_str, relative_path, blob_id_str);
+
+  if (blob_id != NULL)
+    *blob_id = ggit_oid_copy (head_blob_id);
+
+  if ((hunks = blame_cache_lookup (self, key)))
+    return hunks;
+
+  ancestor_hunks = blame_cache_find_ancestor (self, commit, head_blob_id, relative_path,
+                                              &ancestor_id, &n_changes);
+
+  if (ancestor_hunks != NULL && n_changes == 0)
+    {
+      /* Nothing touched the file since the ancestor, so the
+       * attribution of every line is unchanged.
+       */
+      hunks = g_array_ref (ancestor_hunks);
+    }
+  else
+    {
+      GgitBlameOptions *options = ggit_blame_options_new ();
+
+      if (ancestor_hunks != NULL)
+        ggit_blame_options_set_oldest_commit (options, ancestor_id);
+
+      blame = ggit_repository_blame_file (repository, file, options, error);
+      ggit_blame_options_free (options);
+
+      if (blame == NULL)
+        return NULL;
+
+      hunks = blame_hunks_new_from_blame (blame, ancestor_hunks);
+    }
+
+  blame_cache_store (self, key, hunks);
+
+  return hunks;
+}
+
+static int
+diff_hunk_cb (GgitDiffDelta *delta,
+              GgitDiffHunk  *hunk,
+              gpointer       user_data)
+{
+  GArray *ranges = user_data;
+  Range range;
+
+  range.old_start = ggit_diff_hunk_get_old_start (hunk);
+  range.old_lines = ggit_diff_hunk_get_old_lines (hunk);
+  range.new_start = ggit_diff_hunk_get_new_start (hunk);
+  range.new_lines = ggit_diff_hunk_get_new_lines (hunk);
+
+  g_array_append_val (ranges, range);
+
+  return 0;
+}
+
+static void
+blame_hunks_map_segment (GArray *hunks,
+                         GArray *ret,
+                         guint   old_first,
+                         guint   new_first,
+                         guint   n_lines,
+                         guint  *cursor)
+{
+  guint old_end = old_first + n_lines;
+
+  /* @cursor lets us avoid rescanning hunks that are before the
+   * segment since segments are visited in order.
+   */
+  for (guint i = *cursor; i < hunks->len; i++)
+    {
+      const BlameHunk *hunk = &g_array_index (hunks, BlameHunk, i);
+      guint hunk_end = hunk->final_start + hunk->n_lines;
+      guint begin;
+      guint end;
+      BlameHunk item;
+
+      if (hunk_end <= old_first)
+        {
+          *cursor = i + 1;
+          continue;
+        }
+
+      if (hunk->final_start >= old_end)
+        break;
+
+      begin = MAX (hunk->final_start, old_first);
+      end = MIN (hunk_end, old_end);
+
+      item.final_start = new_first + (begin - old_first);
+      item.n_lines = end - begin;
+      item.orig_start = hunk->orig_start + (begin - hunk->final_start);
+      memcpy (item.commit_id, hunk->commit_id, BLAME_OID_SIZE);
+
+      g_array_append_val (ret, item);
+    }
+}
+
+/**
+ * blame_hunks_apply_diff:
+ * @hunks: the #BlameHunk for @blob
+ * @blob: the blob at HEAD
+ * @path: the path used for diff labels
+ * @data: the current contents of the buffer
+ * @len: the length of @data
+ * @error: a location for a #GError
+ *
+ * Translates @hunks onto the modified contents in @data. Lines which
+ * differ from @blob are attributed to the zero commit id, like libgit2
+ * does for lines which are not committed yet.
+ *
+ * Returns: (transfer full): a #GArray of #BlameHunk
+ */
+GArray *
+blame_hunks_apply_diff (GArray        *hunks,
+                        GgitBlob      *blob,
+                        const char    *path,
+                        const guint8  *data,
+                        gsize          len,
+                        GError       **error)
+{
+  g_autoptr(GgitDiffOptions) options = NULL;
+  g_autoptr(GArray) ranges = NULL;
+  g_autoptr(GArray) ret = NULL;
+  g_autoptr(GError) local_error = NULL;
+  guint old_pos = 1;
+  guint new_pos = 1;
+  guint cursor = 0;
+
+  g_return_val_if_fail (hunks != NULL, NULL);
+  g_return_val_if_fail (GGIT_IS_BLOB (blob), NULL);
+
+  ranges = g_array_new (FALSE, FALSE, sizeof (Range));
+  options = ggit_diff_options_new ();
+  ggit_diff_options_set_n_context_lines (options, 0);
+
+  ggit_diff_blob_to_buffer (blob, path, data, len, path, options,
+                            NULL, NULL, diff_hunk_cb, NULL,
+                            ranges, &local_error);
+
+  if (local_error != NULL)
+    {
+      g_propagate_error (error, g_steal_pointer (&local_error));
+      return NULL;
+    }
+
+  if (ranges->len == 0)
+    return g_array_ref (hunks);
+
+  ret = g_array_sized_new (FALSE, FALSE, sizeof (BlameHunk), hunks->len + ranges->len);
+
+  for (guint i = 0; i < ranges->len; i++)
+    {
+      const Range *range = &g_array_index (ranges, Range, i);
+      guint old_begin = range->old_lines == 0 ? range->old_start + 1 : range->old_start;
+      guint new_begin = range->new_lines == 0 ? range->new_start + 1 : range->new_start;
+
+      if (old_begin > old_pos)
+        blame_hunks_map_segment (hunks, ret, old_pos, new_pos, old_begin - old_pos, &cursor);
+
+      if (range->new_lines > 0)
+        {
+          BlameHunk item = {0};
+
+          item.final_start = new_begin;
+          item.n_lines = range->new_lines;
+          item.orig_start = new_begin;
+
+          g_array_append_val (ret, item);
+        }
+
+      old_pos = old_begin + range->old_lines;
+      new_pos = new_begin + range->new_lines;
+    }
+
+  blame_hunks_map_segment (hunks, ret, old_pos, new_pos, G_MAXUINT - old_pos, &cursor);
+
+  return g_steal_pointer (&ret);
+}
@@ -0,0 +1,56 @@
+/* blame-cache.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <libgit2-glib/ggit.h>
+
+G_BEGIN_DECLS
+
+#define BLAME_OID_SIZE 20
+
+typedef struct _BlameCache BlameCache;
+
+/* Lines are 1-based to match libgit2 */
+typedef struct
+{
+  guint  final_start;
+  guint  n_lines;
+  guint  orig_start;
+  guint8 commit_id[BLAME_OID_SIZE];
+} BlameHunk;
+
+BlameCache      *blame_cache_get_default (void);
+GArray          *blame_cache_blame_file  (BlameCache       *self,
+                                          GgitRepository   *repository,
+                                          const char       *path,
+                                          GgitOId         **blob_id,
+                                          GError          **error);
+const BlameHunk *blame_hunks_lookup      (GArray           *hunks,
+                                          guint             line);
+GArray          *blame_hunks_apply_diff  (GArray           *hunks,
+                                          GgitBlob         *blob,
+                                          const char       *path,
+                                          const guint8     *data,
+                                          gsize             len,
+                                          GError          **error);
+char            *blame_hunk_dup_commit   (const BlameHunk  *hunk);
+
+G_END_DECLS
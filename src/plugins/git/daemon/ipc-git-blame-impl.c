@@ -22,6 +22,8 @@
 #define G_LOG_DOMAIN "ipc-git-blame-impl"
 
 #include <glib/gi18n.h>
+
+#include "blame-cache.h"
 #include "ipc-git-blame-impl.h"
 
 struct _IpcGitBlameImpl
@@ -30,8 +32,9 @@ struct _IpcGitBlameImpl
   char                *path;
   GgitRepository      *repository;
   GBytes              *contents;
-  GgitBlame           *blame;
-  GgitBlame           *base_blame;
+  GArray              *hunks;
+  GArray              *base_hunks;
+  GgitOId             *blob_id;
   gboolean             needs_refresh;
 };
 
@@ -39,11 +42,11 @@ static gboolean
 ipc_git_blame_impl_update_blame (IpcGitBlameImpl  *self,
                                  GError          **error)
 {
-  g_autoptr (GFile) file = NULL;
+  g_autoptr(GgitBlob) blob = NULL;
   const guint8 *buffer_data = NULL;
   gsize buffer_size = 0;
 
-  if (self->blame != NULL && !self->needs_refresh)
+  if (self->hunks != NULL && !self->needs_refresh)
     return TRUE;
 
   if (self->repository == NULL || self->path == NULL)
@@ -60,25 +63,25 @@ ipc_git_blame_impl_update_blame (IpcGitBlameImpl  *self,
       return FALSE;
     }
 
-  file = g_file_new_for_path (self->path);
-
-  if (!g_file_query_exists (file, NULL))
+  if (!g_file_test (self->path, G_FILE_TEST_EXISTS))
     {
       g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
                    "Non existent file at path");
       return FALSE;
     }
 
-  if (self->base_blame == NULL)
+  if (self->base_hunks == NULL)
     {
       g_autoptr(GError) blame_error = NULL;
 
-      self->base_blame = ggit_repository_blame_file (self->repository,
-                                                     file,
-                                                     NULL,
-                                                     &blame_error);
+      g_clear_pointer (&self->blob_id, ggit_oid_free);
+      self->base_hunks = blame_cache_blame_file (blame_cache_get_default (),
+                                                 self->repository,
+                                                 self->path,
+                                                 &self->blob_id,
+                                                 &blame_error);
 
-      if (self->base_blame == NULL)
+      if (self->base_hunks == NULL)
         {
           g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
                        "Could not create blame for file: %s",
@@ -94,12 +97,17 @@ ipc_git_blame_impl_update_blame (IpcGitBlameImpl  *self,
     return FALSE;
   }
 
-  g_clear_object (&self->blame);
-  self->blame = ggit_blame_from_buffer (self->base_blame,
+  if (!(blob = ggit_repository_lookup_blob (self->repository, self->blob_id, error)))
+    return FALSE;
+
+  g_clear_pointer (&self->hunks, g_array_unref);
+  self->hunks = blame_hunks_apply_diff (self->base_hunks,
+                                        blob,
+                                        self->path,
                                         buffer_data,
                                         buffer_size,
                                         error);
-  if (self->blame == NULL)
+  if (self->hunks == NULL)
     return FALSE;
 
   self->needs_refresh = FALSE;
@@ -113,9 +121,10 @@ ipc_git_blame_impl_handle_query_line (IpcGitBlame           *blame,
 {
   IpcGitBlameImpl *self = (IpcGitBlameImpl*)blame;
   g_autoptr (GError) error = NULL;
-  GgitBlameHunk *hunk = NULL;
+  const BlameHunk *hunk = NULL;
   guint start_final = 0;
   g_autoptr (GgitOId) commit_id = NULL;
+  g_autofree char *commit_id_str = NULL;
   g_autoptr (GgitCommit) commit = NULL;
   g_autoptr (GgitSignature) signature = NULL;
   g_autofree char *author_name = NULL;
@@ -130,15 +139,16 @@ ipc_git_blame_impl_handle_query_line (IpcGitBlame           *blame,
   if (!ipc_git_blame_impl_update_blame (self, &error))
     goto gerror;
 
-  if (!(hunk = ggit_blame_get_hunk_by_line (self->blame, line_number + 1)))
+  if (!(hunk = blame_hunks_lookup (self->hunks, line_number + 1)))
     {
       g_set_error (&error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
                    "Line number %u not found in blame data", line_number);
       goto gerror;
     }
 
-  if (!(commit_id = ggit_blame_hunk_get_final_commit_id (hunk)) ||
-      !(commit_id) ||
+  commit_id_str = blame_hunk_dup_commit (hunk);
+
+  if (!(commit_id = ggit_oid_new_from_string (commit_id_str)) ||
       !(commit = ggit_repository_lookup_commit (self->repository, commit_id, NULL)))
     {
       g_set_error (&error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
@@ -173,14 +183,14 @@ ipc_git_blame_impl_handle_query_line (IpcGitBlame           *blame,
   msg = ggit_commit_get_message (commit);
   commit_message = g_strdup (msg ? msg : "");
 
-  start_final = ggit_blame_hunk_get_final_start_line_number (hunk);
-  orig_start = ggit_blame_hunk_get_orig_start_line_number (hunk);
+  start_final = hunk->final_start;
+  orig_start = hunk->orig_start;
   line_offset = (line_number + 1) - start_final;
   line_in_commit = orig_start + line_offset;
 
   ipc_git_blame_complete_query_line (blame,
                                      invocation,
-                                     ggit_oid_to_string (commit_id),
+                                     commit_id_str,
                                      author_name,
                                      author_email,
                                      commit_message,
@@ -232,14 +242,15 @@ ipc_git_blame_impl_handle_query_line_range (IpcGitBlame           *blame,
     {
       gboolean line_found = FALSE;
       GVariantBuilder line_builder;
-      GgitBlameHunk *hunk;
+      const BlameHunk *hunk;
 
       g_variant_builder_init (&line_builder, G_VARIANT_TYPE ("a{sv}"));
 
-      if ((hunk = ggit_blame_get_hunk_by_line (self->blame, line_number + 1)))
+      if ((hunk = blame_hunks_lookup (self->hunks, line_number + 1)))
         {
           guint start_final = 0;
           g_autoptr (GgitOId) commit_id = NULL;
+          g_autofree char *commit_id_str = blame_hunk_dup_commit (hunk);
           g_autoptr (GgitCommit) commit = NULL;
           g_autoptr (GgitSignature) signature = NULL;
           g_autofree char *author_name = NULL;
@@ -251,8 +262,7 @@ ipc_git_blame_impl_handle_query_line_range (IpcGitBlame           *blame,
           guint line_offset = 0;
           guint line_in_commit = 0;
 
-          if (!(commit_id = ggit_blame_hunk_get_final_commit_id (hunk)) ||
-              !(commit_id) ||
+          if (!(commit_id = ggit_oid_new_from_string (commit_id_str)) ||
               !(commit = ggit_repository_lookup_commit (self->repository, commit_id, NULL)))
             {
               g_variant_builder_add (&line_builder,
@@ -294,8 +304,8 @@ ipc_git_blame_impl_handle_query_line_range (IpcGitBlame           *blame,
               msg = ggit_commit_get_message (commit);
               commit_message = g_strdup (msg ? msg : "");
 
-              start_final = ggit_blame_hunk_get_final_start_line_number (hunk);
-              orig_start = ggit_blame_hunk_get_orig_start_line_number (hunk);
+              start_final = hunk->final_start;
+              orig_start = hunk->orig_start;
               line_offset = (line_number + 1) - start_final;
               line_in_commit = orig_start + line_offset;
 
@@ -304,7 +314,7 @@ ipc_git_blame_impl_handle_query_line_range (IpcGitBlame           *blame,
                                      g_variant_new_uint32 (line_number));
               g_variant_builder_add (&line_builder, "{sv}",
                                      "commit_id",
-                                     g_variant_new_string (ggit_oid_to_string (commit_id)));
+                                     g_variant_new_string (commit_id_str));
               g_variant_builder_add (&line_builder, "{sv}",
                                      "author_name",
                                      g_variant_new_string (author_name));
@@ -395,7 +405,9 @@ ipc_git_blame_impl_finalize (GObject *object)
 
   self = (IpcGitBlameImpl*)object;
 
-  g_clear_object (&self->blame);
+  g_clear_pointer (&self->hunks, g_array_unref);
+  g_clear_pointer (&self->base_hunks, g_array_unref);
+  g_clear_pointer (&self->blob_id, ggit_oid_free);
   g_clear_object (&self->repository);
   g_clear_pointer (&self->contents, g_bytes_unref);
   g_clear_pointer (&self->path, g_free);
@@ -434,6 +446,12 @@ void
 ipc_git_blame_impl_reset (IpcGitBlameImpl *self)
 {
   g_return_if_fail (IPC_IS_GIT_BLAME_IMPL (self));
-  g_clear_object (&self->blame);
+
+  /* HEAD may have moved, so resolve the base blame again. This is
+   * cheap when the cache already has an entry for the new HEAD.
+   */
+  g_clear_pointer (&self->hunks, g_array_unref);
+  g_clear_pointer (&self->base_hunks, g_array_unref);
+  g_clear_pointer (&self->blob_id, ggit_oid_free);
   self->needs_refresh = TRUE;
 }
@@ -24,6 +24,12 @@
 
 #include "ipc-git-change-monitor-impl.h"
 #include "line-cache.h"
+#include "line-diff.h"
+
+/* Edits which need more than this many inserted and removed lines to
+ * align with the blob are diffed with libgit2 instead.
+ */
+#define WINDOW_MAX_COST 1000
 
 /* Some code from this file is loosely based around the git-diff
  * plugin from Atom. Namely, API usage for iterating through hunks
@@ -59,6 +65,21 @@ struct _IpcGitChangeMonitorImpl
   GgitRepository              *repository;
   GBytes                      *contents;
   GgitObject                  *blob;
+  LineIndex                   *blob_index;
+
+  /* The alignment of the blob and the contents from the last diff as
+   * an array of LineHunk, along with the line marks it produced.
+   */
+  GArray                      *hunks;
+  LineCache                   *cache;
+  guint                        n_lines;
+
+  /* Edits to the contents since the last diff, merged into one range */
+  guint                        edit_begin;
+  guint                        edit_old_end;
+  guint                        edit_new_end;
+  guint                        has_edit : 1;
+  guint                        needs_full : 1;
 };
 
 typedef struct
@@ -142,6 +163,83 @@ cleanup:
   return g_steal_pointer (&blob);
 }
 
+static void
+mark_hunk (LineCache      *cache,
+           const LineHunk *hunk)
+{
+  if (hunk->old_begin == hunk->old_end && hunk->new_begin < hunk->new_end)
+    {
+      line_cache_mark_range (cache, hunk->new_begin, hunk->new_end, LINE_MARK_ADDED);
+    }
+  else if (hunk->new_begin == hunk->new_end && hunk->old_begin < hunk->old_end)
+    {
+      if (hunk->new_begin == 0)
+        line_cache_mark_range (cache, 0, 0, LINE_MARK_PREVIOUS_REMOVED);
+      else
+        line_cache_mark_range (cache, hunk->new_begin, hunk->new_begin, LINE_MARK_REMOVED);
+    }
+  else
+    {
+      line_cache_mark_range (cache, hunk->new_begin, hunk->new_end, LINE_MARK_CHANGED);
+    }
+}
+
+static void
+ipc_git_change_monitor_impl_add_edit (IpcGitChangeMonitorImpl *self,
+                                      guint                    begin,
+                                      guint                    old_end,
+                                      guint                    new_end)
+{
+  guint merged_old_end;
+  guint merged_new_end;
+
+  g_assert (IPC_IS_GIT_CHANGE_MONITOR_IMPL (self));
+
+  if (old_end < begin || new_end < begin)
+    {
+      self->needs_full = TRUE;
+      return;
+    }
+
+  if (!self->has_edit)
+    {
+      self->edit_begin = begin;
+      self->edit_old_end = old_end;
+      self->edit_new_end = new_end;
+      self->has_edit = TRUE;
+      return;
+    }
+
+  /* @begin and @old_end are relative to the contents after the pending
+   * edit so translate them back to the contents of the last diff.
+   */
+  if (old_end >= self->edit_new_end)
+    merged_old_end = old_end - self->edit_new_end + self->edit_old_end;
+  else
+    merged_old_end = self->edit_old_end;
+
+  if (self->edit_new_end >= old_end)
+    merged_new_end = self->edit_new_end - old_end + new_end;
+  else
+    merged_new_end = new_end;
+
+  self->edit_begin = MIN (self->edit_begin, begin);
+  self->edit_old_end = merged_old_end;
+  self->edit_new_end = merged_new_end;
+}
+
+static void
+ipc_git_change_monitor_impl_set_contents (IpcGitChangeMonitorImpl *self,
+                                          const gchar             *contents)
+{
+  g_assert (IPC_IS_GIT_CHANGE_MONITOR_IMPL (self));
+  g_assert (contents != NULL);
+
+  /* Make a copy, but retain the trailing \0 */
+  g_clear_pointer (&self->contents, g_bytes_unref);
+  self->contents = g_bytes_new_take (g_strdup (contents), strlen (contents));
+}
+
 static gboolean
 ipc_git_change_monitor_impl_handle_update_content (IpcGitChangeMonitor   *monitor,
                                                    GDBusMethodInvocation *invocation,
@@ -153,43 +251,66 @@ ipc_git_change_monitor_impl_handle_update_content (IpcGitChangeMonitor   *monito
   g_assert (G_IS_DBUS_METHOD_INVOCATION (invocation));
   g_assert (contents != NULL);
 
-  /* Make a copy, but retain the trailing \0 */
-  g_clear_pointer (&self->contents, g_bytes_unref);
-  self->contents = g_bytes_new_take (g_strdup (contents), strlen (contents));
-
+  ipc_git_change_monitor_impl_update_content (self, contents, NULL);
   ipc_git_change_monitor_complete_update_content (monitor, invocation);
 
   return TRUE;
 }
 
 static gboolean
-ipc_git_change_monitor_impl_handle_list_changes (IpcGitChangeMonitor   *monitor,
-                                                 GDBusMethodInvocation *invocation)
+ipc_git_change_monitor_impl_handle_update_content_with_edits (IpcGitChangeMonitor   *monitor,
+                                                              GDBusMethodInvocation *invocation,
+                                                              const gchar           *contents,
+                                                              GVariant              *edits)
 {
   IpcGitChangeMonitorImpl *self = (IpcGitChangeMonitorImpl *)monitor;
-  g_autoptr(GgitDiffOptions) options = NULL;
-  g_autoptr(GgitObject) blob = NULL;
-  g_autoptr(GArray) ranges = NULL;
-  g_autoptr(GError) error = NULL;
-  g_autoptr(LineCache) cache = NULL;
-  g_autoptr(GVariant) ret = NULL;
-  const guint8 *data;
-  gsize len = 0;
 
   g_assert (IPC_IS_GIT_CHANGE_MONITOR_IMPL (self));
   g_assert (G_IS_DBUS_METHOD_INVOCATION (invocation));
+  g_assert (contents != NULL);
+  g_assert (g_variant_is_of_type (edits, G_VARIANT_TYPE ("a(uuu)")));
 
-  if (self->contents == NULL)
+  ipc_git_change_monitor_impl_update_content (self, contents, edits);
+  ipc_git_change_monitor_complete_update_content_with_edits (monitor, invocation);
+
+  return TRUE;
+}
+
+static LineIndex *
+ipc_git_change_monitor_impl_get_blob_index (IpcGitChangeMonitorImpl *self,
+                                            GgitBlob                *blob)
+{
+  g_assert (IPC_IS_GIT_CHANGE_MONITOR_IMPL (self));
+  g_assert (GGIT_IS_BLOB (blob));
+
+  if (self->blob_index == NULL)
     {
-      g_set_error (&error,
-                   G_IO_ERROR,
-                   G_IO_ERROR_NOT_INITIALIZED,
-                   _("No contents have been set to diff"));
-      goto gerror;
+      g_autoptr(GBytes) bytes = NULL;
+      const guchar *data;
+      gsize len = 0;
+
+      data = ggit_blob_get_raw_content (blob, &len);
+      bytes = g_bytes_new_with_free_func (data, len, g_object_unref, g_object_ref (blob));
+      self->blob_index = line_index_new (bytes);
     }
 
-  if (!(blob = ipc_git_change_monitor_impl_load_blob (self, &error)))
-    goto gerror;
+  return self->blob_index;
+}
+
+static gboolean
+ipc_git_change_monitor_impl_diff_full (IpcGitChangeMonitorImpl  *self,
+                                       GgitBlob                 *blob,
+                                       GError                  **error)
+{
+  g_autoptr(GgitDiffOptions) options = NULL;
+  g_autoptr(GArray) ranges = NULL;
+  g_autoptr(GArray) hunks = NULL;
+  g_autoptr(GError) local_error = NULL;
+  const guint8 *data;
+  gsize len = 0;
+
+  g_assert (IPC_IS_GIT_CHANGE_MONITOR_IMPL (self));
+  g_assert (GGIT_IS_BLOB (blob));
 
   ranges = g_array_new (FALSE, FALSE, sizeof (Range));
   options = ggit_diff_options_new ();
@@ -197,7 +318,7 @@ ipc_git_change_monitor_impl_handle_list_changes (IpcGitChangeMonitor   *monitor,
 
   data = g_bytes_get_data (self->contents, &len);
 
-  ggit_diff_blob_to_buffer (GGIT_BLOB (blob),
+  ggit_diff_blob_to_buffer (blob,
                             self->path,
                             data,
                             len,
@@ -208,67 +329,325 @@ ipc_git_change_monitor_impl_handle_list_changes (IpcGitChangeMonitor   *monitor,
                             diff_hunk_cb, /* Hunk Callback */
                             NULL,
                             ranges,
-                            &error);
+                            &local_error);
+
+  if (local_error != NULL)
+    {
+      g_propagate_error (error, g_steal_pointer (&local_error));
+      return FALSE;
+    }
 
-  if (error != NULL)
-    goto gerror;
+  hunks = g_array_sized_new (FALSE, FALSE, sizeof (LineHunk), ranges->len);
 
-  cache = line_cache_new ();
+  g_clear_pointer (&self->cache, line_cache_free);
+  self->cache = line_cache_new ();
 
   for (guint i = 0; i < ranges->len; i++)
     {
       const Range *range = &g_array_index (ranges, Range, i);
-      gint start_line = range->new_start - 1;
-      gint end_line = range->new_start + range->new_lines - 1;
-
-      if (range->old_lines == 0 && range->new_lines > 0)
-        {
-          line_cache_mark_range (cache, start_line, end_line, LINE_MARK_ADDED);
-        }
-      else if (range->new_lines == 0 && range->old_lines > 0)
-        {
-          if (start_line < 0)
-            line_cache_mark_range (cache, 0, 0, LINE_MARK_PREVIOUS_REMOVED);
-          else
-            line_cache_mark_range (cache, start_line + 1, start_line + 1, LINE_MARK_REMOVED);
-        }
-      else
-        {
-          line_cache_mark_range (cache, start_line, end_line, LINE_MARK_CHANGED);
-        }
+      LineHunk hunk;
+
+      /* git uses 1-based lines except for empty ranges, which are
+       * the line before the insertion or removal.
+       */
+      hunk.old_begin = range->old_lines ? range->old_start - 1 : range->old_start;
+      hunk.old_end = hunk.old_begin + range->old_lines;
+      hunk.new_begin = range->new_lines ? range->new_start - 1 : range->new_start;
+      hunk.new_end = hunk.new_begin + range->new_lines;
+
+      g_array_append_val (hunks, hunk);
+      mark_hunk (self->cache, &hunk);
     }
 
-  ret = line_cache_to_variant (cache);
+  g_clear_pointer (&self->hunks, g_array_unref);
+  self->hunks = g_steal_pointer (&hunks);
 
-  g_assert (ret != NULL);
-  g_assert (g_variant_is_of_type (ret, G_VARIANT_TYPE ("au")));
+  return TRUE;
+}
+
+/*
+ * Re-diffs the lines touched by the pending edit using the alignment
+ * from the last diff. The edited range is grown until both ends sit on
+ * lines outside of any hunk so that they map directly onto the blob.
+ */
+static gboolean
+ipc_git_change_monitor_impl_diff_edit (IpcGitChangeMonitorImpl *self,
+                                       GgitBlob                *blob,
+                                       const LineIndex         *index,
+                                       guint                   *begin_line,
+                                       guint                   *old_end_line,
+                                       guint                   *new_end_line)
+{
+  g_autoptr(GArray) window = NULL;
+  g_autoptr(LineCache) marks = NULL;
+  const LineIndex *blob_index;
+  gint64 delta;
+  gint64 offset = 0;
+  gint64 old_begin;
+  gint64 old_end;
+  guint n_lines;
+  guint begin;
+  guint end;
+  guint first;
+  guint last;
+
+  g_assert (IPC_IS_GIT_CHANGE_MONITOR_IMPL (self));
+  g_assert (GGIT_IS_BLOB (blob));
+  g_assert (index != NULL);
+  g_assert (self->hunks != NULL);
+  g_assert (self->cache != NULL);
+  g_assert (self->has_edit);
+
+  n_lines = line_index_get_n_lines (index);
+  delta = (gint64)n_lines - (gint64)self->n_lines;
+
+  /* The edits must account for every line added or removed */
+  if (delta != (gint64)self->edit_new_end - (gint64)self->edit_old_end)
+    return FALSE;
+
+  begin = MIN (self->edit_begin, self->n_lines);
+  end = CLAMP (self->edit_old_end, begin, self->n_lines);
 
-gerror:
-  g_assert (ret != NULL || error != NULL);
+  if ((gint64)end + delta < begin)
+    return FALSE;
+
+  first = 0;
+  while (first < self->hunks->len &&
+         g_array_index (self->hunks, LineHunk, first).new_end < begin)
+    first++;
+
+  if (first < self->hunks->len)
+    begin = MIN (begin, g_array_index (self->hunks, LineHunk, first).new_begin);
+
+  while (first > 0 &&
+         g_array_index (self->hunks, LineHunk, first - 1).new_end >= begin)
+    {
+      first--;
+      begin = MIN (begin, g_array_index (self->hunks, LineHunk, first).new_begin);
+    }
+
+  for (guint i = 0; i < first; i++)
+    {
+      const LineHunk *hunk = &g_array_index (self->hunks, LineHunk, i);
+      offset += (gint64)(hunk->old_end - hunk->old_begin) - (hunk->new_end - hunk->new_begin);
+    }
+
+  old_begin = begin + offset;
+
+  for (last = first; last < self->hunks->len; last++)
+    {
+      const LineHunk *hunk = &g_array_index (self->hunks, LineHunk, last);
+
+      if (hunk->new_begin > end)
+        break;
+
+      end = MAX (end, hunk->new_end);
+      offset += (gint64)(hunk->old_end - hunk->old_begin) - (hunk->new_end - hunk->new_begin);
+    }
+
+  old_end = end + offset;
+
+  blob_index = ipc_git_change_monitor_impl_get_blob_index (self, blob);
+
+  if (old_begin < 0 ||
+      old_end < old_begin ||
+      old_end > line_index_get_n_lines (blob_index))
+    return FALSE;
+
+  window = g_array_new (FALSE, FALSE, sizeof (LineHunk));
+
+  if (!line_diff (blob_index, old_begin, old_end,
+                  index, begin, end + delta,
+                  WINDOW_MAX_COST,
+                  window))
+    return FALSE;
+
+  g_array_remove_range (self->hunks, first, last - first);
+
+  for (guint i = first; i < self->hunks->len; i++)
+    {
+      LineHunk *hunk = &g_array_index (self->hunks, LineHunk, i);
+
+      hunk->new_begin += delta;
+      hunk->new_end += delta;
+    }
+
+  g_array_insert_vals (self->hunks, first, window->data, window->len);
+
+  /* Removals mark the line after them, so the anchor line at the end
+   * of the range may have changed too.
+   */
+  marks = line_cache_new ();
+  for (guint i = 0; i < window->len; i++)
+    mark_hunk (marks, &g_array_index (window, LineHunk, i));
+
+  line_cache_splice (self->cache, begin, end + 1, end + delta + 1, marks);
+
+  *begin_line = begin;
+  *old_end_line = end + 1;
+  *new_end_line = end + delta + 1;
+
+  return TRUE;
+}
+
+/*
+ * Brings the line marks up to date with the contents and returns the
+ * range of lines which changed since the last update.
+ */
+static gboolean
+ipc_git_change_monitor_impl_update (IpcGitChangeMonitorImpl  *self,
+                                    guint                    *begin_line,
+                                    guint                    *old_end_line,
+                                    guint                    *new_end_line,
+                                    GError                  **error)
+{
+  g_autoptr(GgitObject) blob = NULL;
+  g_autoptr(LineIndex) index = NULL;
+
+  g_assert (IPC_IS_GIT_CHANGE_MONITOR_IMPL (self));
+  g_assert (begin_line != NULL);
+  g_assert (old_end_line != NULL);
+  g_assert (new_end_line != NULL);
+
+  *begin_line = 0;
+  *old_end_line = 0;
+  *new_end_line = 0;
+
+  if (self->contents == NULL)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_INITIALIZED,
+                   _("No contents have been set to diff"));
+      return FALSE;
+    }
+
+  if (!(blob = ipc_git_change_monitor_impl_load_blob (self, error)))
+    return FALSE;
+
+  if (self->cache != NULL && !self->needs_full && !self->has_edit)
+    return TRUE;
+
+  index = line_index_new (self->contents);
+
+  if (self->cache == NULL ||
+      self->hunks == NULL ||
+      self->needs_full ||
+      !self->has_edit ||
+      !ipc_git_change_monitor_impl_diff_edit (self, GGIT_BLOB (blob), index,
+                                              begin_line, old_end_line, new_end_line))
+    {
+      if (!ipc_git_change_monitor_impl_diff_full (self, GGIT_BLOB (blob), error))
+        return FALSE;
+
+      *begin_line = 0;
+      *old_end_line = G_MAXUINT;
+      *new_end_line = G_MAXUINT;
+    }
+
+  self->n_lines = line_index_get_n_lines (index);
+  self->needs_full = FALSE;
+  self->has_edit = FALSE;
+
+  return TRUE;
+}
+
+static void
+ipc_git_change_monitor_impl_return_error (GDBusMethodInvocation *invocation,
+                                          GError                *error)
+{
+  g_assert (G_IS_DBUS_METHOD_INVOCATION (invocation));
+  g_assert (error != NULL);
 
   if (g_error_matches (error, GGIT_ERROR, GIT_ENOTFOUND))
     {
       g_dbus_method_invocation_return_dbus_error (invocation,
                                                   "org.freedesktop.DBus.Error.FileNotFound",
                                                   "No such file");
-      return TRUE;
+      return;
     }
 
-  if (error != NULL && error->domain != G_IO_ERROR)
+  if (error->domain != G_IO_ERROR)
     {
-      g_autoptr(GError) wrapped = g_steal_pointer (&error);
+      g_dbus_method_invocation_return_error (invocation,
+                                             G_IO_ERROR,
+                                             G_IO_ERROR_FAILED,
+                                             _("The operation failed. The original error was \"%s\""),
+                                             error->message);
+      return;
+    }
 
-      g_set_error (&error,
-                   G_IO_ERROR,
-                   G_IO_ERROR_FAILED,
-                   _("The operation failed. The original error was \"%s\""),
-                   wrapped->message);
+  g_dbus_method_invocation_return_gerror (invocation, error);
+}
+
+static gboolean
+ipc_git_change_monitor_impl_handle_list_changes (IpcGitChangeMonitor   *monitor,
+                                                 GDBusMethodInvocation *invocation)
+{
+  IpcGitChangeMonitorImpl *self = (IpcGitChangeMonitorImpl *)monitor;
+  g_autoptr(GVariant) ret = NULL;
+  g_autoptr(GError) error = NULL;
+  guint begin_line;
+  guint old_end_line;
+  guint new_end_line;
+
+  g_assert (IPC_IS_GIT_CHANGE_MONITOR_IMPL (self));
+  g_assert (G_IS_DBUS_METHOD_INVOCATION (invocation));
+
+  if (!ipc_git_change_monitor_impl_update (self, &begin_line, &old_end_line, &new_end_line, &error))
+    {
+      ipc_git_change_monitor_impl_return_error (invocation, error);
+      return TRUE;
     }
 
-  if (error != NULL)
-    g_dbus_method_invocation_return_gerror (invocation, error);
-  else
-    ipc_git_change_monitor_complete_list_changes (monitor, invocation, ret);
+  ret = line_cache_to_variant (self->cache);
+
+  g_assert (ret != NULL);
+  g_assert (g_variant_is_of_type (ret, G_VARIANT_TYPE ("au")));
+
+  ipc_git_change_monitor_complete_list_changes (monitor, invocation, ret);
+
+  return TRUE;
+}
+
+static void
+collect_entry_cb (gpointer data,
+                  gpointer user_data)
+{
+  const LineEntry *entry = data;
+  GArray *entries = user_data;
+
+  g_array_append_val (entries, *entry);
+}
+
+static gboolean
+ipc_git_change_monitor_impl_handle_list_changed_lines (IpcGitChangeMonitor   *monitor,
+                                                       GDBusMethodInvocation *invocation)
+{
+  IpcGitChangeMonitorImpl *self = (IpcGitChangeMonitorImpl *)monitor;
+  g_autoptr(GVariant) ret = NULL;
+  g_autoptr(GError) error = NULL;
+  guint begin_line;
+  guint old_end_line;
+  guint new_end_line;
+
+  g_assert (IPC_IS_GIT_CHANGE_MONITOR_IMPL (self));
+  g_assert (G_IS_DBUS_METHOD_INVOCATION (invocation));
+
+  if (!(ret = ipc_git_change_monitor_impl_list_changed_lines (self, &begin_line, &old_end_line, &new_end_line, &error)))
+    {
+      ipc_git_change_monitor_impl_return_error (invocation, error);
+      return TRUE;
+    }
+
+  g_assert (g_variant_is_of_type (ret, G_VARIANT_TYPE ("au")));
+
+  ipc_git_change_monitor_complete_list_changed_lines (monitor,
+                                                      invocation,
+                                                      begin_line,
+                                                      old_end_line,
+                                                      new_end_line,
+                                                      ret);
 
   return TRUE;
 }
@@ -293,7 +672,9 @@ static void
 git_change_monitor_iface_init (IpcGitChangeMonitorIface *iface)
 {
   iface->handle_update_content = ipc_git_change_monitor_impl_handle_update_content;
+  iface->handle_update_content_with_edits = ipc_git_change_monitor_impl_handle_update_content_with_edits;
   iface->handle_list_changes = ipc_git_change_monitor_impl_handle_list_changes;
+  iface->handle_list_changed_lines = ipc_git_change_monitor_impl_handle_list_changed_lines;
   iface->handle_close = ipc_git_change_monitor_impl_handle_close;
 }
 
@@ -305,6 +686,9 @@ ipc_git_change_monitor_impl_finalize (GObject *object)
 {
   IpcGitChangeMonitorImpl *self = (IpcGitChangeMonitorImpl *)object;
 
+  g_clear_pointer (&self->blob_index, line_index_free);
+  g_clear_pointer (&self->hunks, g_array_unref);
+  g_clear_pointer (&self->cache, line_cache_free);
   g_clear_object (&self->blob);
   g_clear_object (&self->repository);
   g_clear_pointer (&self->contents, g_bytes_unref);
@@ -345,5 +729,93 @@ ipc_git_change_monitor_impl_reset (IpcGitChangeMonitorImpl *self)
 {
   g_return_if_fail (IPC_IS_GIT_CHANGE_MONITOR_IMPL (self));
 
+  g_clear_pointer (&self->blob_index, line_index_free);
   g_clear_object (&self->blob);
+
+  /* The previous alignment is for a different blob */
+  self->needs_full = TRUE;
+}
+
+/**
+ * ipc_git_change_monitor_impl_update_content:
+ * @self: a #IpcGitChangeMonitorImpl
+ * @contents: the new contents of the file
+ * @edits: (nullable): a #GVariant of type `a(uuu)` containing the line
+ *   edits since the last update, or %NULL if they are unknown
+ *
+ * Sets the contents to diff, as done by UpdateContent() and
+ * UpdateContentWithEdits().
+ */
+void
+ipc_git_change_monitor_impl_update_content (IpcGitChangeMonitorImpl *self,
+                                            const gchar             *contents,
+                                            GVariant                *edits)
+{
+  GVariantIter iter;
+  guint begin;
+  guint old_end;
+  guint new_end;
+
+  g_return_if_fail (IPC_IS_GIT_CHANGE_MONITOR_IMPL (self));
+  g_return_if_fail (contents != NULL);
+  g_return_if_fail (!edits || g_variant_is_of_type (edits, G_VARIANT_TYPE ("a(uuu)")));
+
+  ipc_git_change_monitor_impl_set_contents (self, contents);
+
+  /* Without edits we have no idea what changed */
+  if (edits == NULL || g_variant_n_children (edits) == 0)
+    {
+      self->needs_full = TRUE;
+      return;
+    }
+
+  g_variant_iter_init (&iter, edits);
+  while (g_variant_iter_next (&iter, "(uuu)", &begin, &old_end, &new_end))
+    ipc_git_change_monitor_impl_add_edit (self, begin, old_end, new_end);
+}
+
+/**
+ * ipc_git_change_monitor_impl_list_changed_lines:
+ * @self: a #IpcGitChangeMonitorImpl
+ * @begin_line: (out): the first line of the changed range
+ * @old_end_line: (out): the end of the changed range before the update
+ * @new_end_line: (out): the end of the changed range after the update
+ * @error: a location for a #GError, or %NULL
+ *
+ * Brings the line marks up to date with the contents, as done by
+ * ListChangedLines(). Both ends are %G_MAXUINT when the whole file was
+ * diffed, in which case every mark is returned.
+ *
+ * Returns: (transfer full): a #GVariant of type `au` containing the
+ *   marks within the changed range, or %NULL and @error is set
+ */
+GVariant *
+ipc_git_change_monitor_impl_list_changed_lines (IpcGitChangeMonitorImpl  *self,
+                                                guint                    *begin_line,
+                                                guint                    *old_end_line,
+                                                guint                    *new_end_line,
+                                                GError                  **error)
+{
+  g_autoptr(GArray) entries = NULL;
+
+  g_return_val_if_fail (IPC_IS_GIT_CHANGE_MONITOR_IMPL (self), NULL);
+  g_return_val_if_fail (begin_line != NULL, NULL);
+  g_return_val_if_fail (old_end_line != NULL, NULL);
+  g_return_val_if_fail (new_end_line != NULL, NULL);
+
+  if (!ipc_git_change_monitor_impl_update (self, begin_line, old_end_line, new_end_line, error))
+    return NULL;
+
+  if (*new_end_line == G_MAXUINT)
+    return line_cache_to_variant (self->cache);
+
+  entries = g_array_new (FALSE, FALSE, sizeof (LineEntry));
+
+  if (*new_end_line > *begin_line)
+    line_cache_foreach_in_range (self->cache, *begin_line, *new_end_line - 1, collect_entry_cb, entries);
+
+  return g_variant_take_ref (g_variant_new_fixed_array (G_VARIANT_TYPE ("u"),
+                                                        entries->data,
+                                                        entries->len,
+                                                        sizeof (LineEntry)));
 }
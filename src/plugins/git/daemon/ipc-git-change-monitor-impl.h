@@ -30,8 +30,16 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (IpcGitChangeMonitorImpl, ipc_git_change_monitor_impl, IPC, GIT_CHANGE_MONITOR_IMPL, IpcGitChangeMonitorSkeleton)
 
-IpcGitChangeMonitor *ipc_git_change_monitor_impl_new   (GgitRepository          *repository,
-                                                        const gchar             *path);
-void                 ipc_git_change_monitor_impl_reset (IpcGitChangeMonitorImpl *self);
+IpcGitChangeMonitor *ipc_git_change_monitor_impl_new                (GgitRepository           *repository,
+                                                                     const gchar              *path);
+void                 ipc_git_change_monitor_impl_reset              (IpcGitChangeMonitorImpl  *self);
+void                 ipc_git_change_monitor_impl_update_content     (IpcGitChangeMonitorImpl  *self,
+                                                                     const gchar              *contents,
+                                                                     GVariant                 *edits);
+GVariant            *ipc_git_change_monitor_impl_list_changed_lines (IpcGitChangeMonitorImpl  *self,
+                                                                     guint                    *begin_line,
+                                                                     guint                    *old_end_line,
+                                                                     guint                    *new_end_line,
+                                                                     GError                  **error);
 
 G_END_DECLS
@@ -71,6 +71,14 @@ ipc_git_repository_impl_monitor_changed_cb (IpcGitRepositoryImpl *self,
       ipc_git_change_monitor_impl_reset (change_monitor);
     }
 
+  g_hash_table_iter_init (&iter, self->blamers);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&key, NULL))
+    {
+      IpcGitBlameImpl *blame = key;
+      g_assert (IPC_IS_GIT_BLAME_IMPL (blame));
+      ipc_git_blame_impl_reset (blame);
+    }
+
   if ((head_ref = ggit_repository_get_head (self->repository, NULL)))
     {
       g_assert (GGIT_IS_REF (head_ref));
@@ -207,6 +207,81 @@ line_cache_foreach_in_range (const LineCache *self,
     }
 }
 
+static guint
+line_cache_lower_bound (const LineCache *self,
+                        guint            line,
+                        guint            L)
+{
+  guint R = self->lines->len;
+
+  while (L < R)
+    {
+      guint m = L + (R - L) / 2;
+
+      if (g_array_index (self->lines, LineEntry, m).line < line)
+        L = m + 1;
+      else
+        R = m;
+    }
+
+  return L;
+}
+
+/**
+ * line_cache_splice:
+ * @self: a #LineCache
+ * @start_line: the first line of the replaced range
+ * @old_end_line: the end of the replaced range before the edit
+ * @new_end_line: the end of the replaced range after the edit
+ * @replacement: a #LineCache containing marks for the new range
+ *
+ * Replaces the marks in [@start_line, @old_end_line) with those of
+ * @replacement that fall within [@start_line, @new_end_line), moving
+ * the marks after the range to account for inserted or removed lines.
+ *
+ * Passing %G_MAXUINT for both ends replaces every mark from @start_line.
+ */
+void
+line_cache_splice (LineCache       *self,
+                   guint            start_line,
+                   guint            old_end_line,
+                   guint            new_end_line,
+                   const LineCache *replacement)
+{
+  guint begin;
+  guint end;
+  guint first;
+  guint last;
+
+  g_assert (self != NULL);
+  g_assert (replacement != NULL);
+  g_assert (start_line <= old_end_line);
+  g_assert (start_line <= new_end_line);
+
+  begin = line_cache_lower_bound (self, start_line, 0);
+  end = line_cache_lower_bound (self, old_end_line, begin);
+
+  if (end > begin)
+    g_array_remove_range (self->lines, begin, end - begin);
+
+  if (old_end_line != new_end_line)
+    {
+      for (guint i = begin; i < self->lines->len; i++)
+        {
+          LineEntry *entry = &g_array_index (self->lines, LineEntry, i);
+          entry->line = entry->line - old_end_line + new_end_line;
+        }
+    }
+
+  first = line_cache_lower_bound (replacement, start_line, 0);
+  last = line_cache_lower_bound (replacement, new_end_line, first);
+
+  if (last > first)
+    g_array_insert_vals (self->lines, begin,
+                         &g_array_index (replacement->lines, LineEntry, first),
+                         last - first);
+}
+
 GVariant *
 line_cache_to_variant (const LineCache *self)
 {
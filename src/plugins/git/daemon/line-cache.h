@@ -54,6 +54,11 @@ void       line_cache_foreach_in_range (const LineCache *self,
                                         gpointer         user_data);
 LineMark   line_cache_get_mark         (const LineCache *self,
                                         gint             line);
+void       line_cache_splice           (LineCache       *self,
+                                        guint            start_line,
+                                        guint            old_end_line,
+                                        guint            new_end_line,
+                                        const LineCache *replacement);
 GVariant  *line_cache_to_variant       (const LineCache *self);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (LineCache, line_cache_free)
@@ -0,0 +1,301 @@
+/* line-diff.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "line-diff"
+
+#include <string.h>
+
+#include "line-diff.h"
+
+struct _LineIndex
+{
+  GBytes *bytes;
+  const gchar *data;
+  /* n_lines + 1 offsets, the last being the length of data */
+  GArray *offsets;
+};
+
+/**
+ * line_index_new:
+ * @bytes: the file contents
+ *
+ * Creates an index of the line offsets within @bytes. Like #GtkTextBuffer,
+ * there is always one more line than there are newlines, so contents
+ * ending in a newline have an empty last line.
+ *
+ * Returns: (transfer full): a new #LineIndex
+ */
+LineIndex *
+line_index_new (GBytes *bytes)
+{
+  LineIndex *self;
+  const gchar *iter;
+  const gchar *end;
+  gsize len = 0;
+  gsize offset = 0;
+
+  g_return_val_if_fail (bytes != NULL, NULL);
+
+  self = g_slice_new0 (LineIndex);
+  self->bytes = g_bytes_ref (bytes);
+  self->data = g_bytes_get_data (bytes, &len);
+  self->offsets = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+  g_array_append_val (self->offsets, offset);
+
+  iter = self->data;
+  end = self->data + len;
+
+  while (iter < end)
+    {
+      const gchar *nl = memchr (iter, '\n', end - iter);
+
+      if (nl == NULL)
+        break;
+
+      offset = nl - self->data + 1;
+      g_array_append_val (self->offsets, offset);
+      iter = nl + 1;
+    }
+
+  g_array_append_val (self->offsets, len);
+
+  return self;
+}
+
+void
+line_index_free (LineIndex *self)
+{
+  if (self != NULL)
+    {
+      g_clear_pointer (&self->offsets, g_array_unref);
+      g_clear_pointer (&self->bytes, g_bytes_unref);
+      g_slice_free (LineIndex, self);
+    }
+}
+
+guint
+line_index_get_n_lines (const LineIndex *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->offsets->len - 1;
+}
+
+static inline gboolean
+line_equal (const LineIndex *a,
+            guint            a_line,
+            const LineIndex *b,
+            guint            b_line)
+{
+  gsize a_begin = g_array_index (a->offsets, gsize, a_line);
+  gsize a_len = g_array_index (a->offsets, gsize, a_line + 1) - a_begin;
+  gsize b_begin = g_array_index (b->offsets, gsize, b_line);
+  gsize b_len = g_array_index (b->offsets, gsize, b_line + 1) - b_begin;
+
+  /* The newline is part of the line so that a missing trailing
+   * newline is treated as a change, just like git does.
+   */
+  return a_len == b_len && memcmp (a->data + a_begin, b->data + b_begin, a_len) == 0;
+}
+
+static void
+add_hunk (GArray *hunks,
+          guint   old_begin,
+          guint   old_end,
+          guint   new_begin,
+          guint   new_end)
+{
+  LineHunk hunk = { old_begin, old_end, new_begin, new_end };
+
+  g_array_append_val (hunks, hunk);
+}
+
+/**
+ * line_diff:
+ * @old_index: the index of the original contents
+ * @old_begin: the first line of @old_index to compare
+ * @old_end: the line after the last line of @old_index to compare
+ * @new_index: the index of the modified contents
+ * @new_begin: the first line of @new_index to compare
+ * @new_end: the line after the last line of @new_index to compare
+ * @max_cost: the largest number of inserted and removed lines to search
+ * @hunks: a #GArray of #LineHunk to append to
+ *
+ * Diffs a window of lines using the Myers algorithm and appends the
+ * hunks, in absolute line numbers, to @hunks. Unchanged lines are never
+ * part of a hunk which matches a git diff without context lines.
+ *
+ * Returns: %FALSE if the windows differ by more than @max_cost lines, in
+ *   which case @hunks is left untouched.
+ */
+gboolean
+line_diff (const LineIndex *old_index,
+           guint            old_begin,
+           guint            old_end,
+           const LineIndex *new_index,
+           guint            new_begin,
+           guint            new_end,
+           guint            max_cost,
+           GArray          *hunks)
+{
+  g_autofree gint *v = NULL;
+  g_autoptr(GArray) trace = NULL;
+  g_autoptr(GArray) found = NULL;
+  LineHunk cur = {0};
+  gboolean has_cur = FALSE;
+  gint n;
+  gint m;
+  gint max;
+  gint d;
+  gint x;
+  gint y;
+
+  g_return_val_if_fail (old_index != NULL, FALSE);
+  g_return_val_if_fail (new_index != NULL, FALSE);
+  g_return_val_if_fail (old_begin <= old_end, FALSE);
+  g_return_val_if_fail (old_end <= line_index_get_n_lines (old_index), FALSE);
+  g_return_val_if_fail (new_begin <= new_end, FALSE);
+  g_return_val_if_fail (new_end <= line_index_get_n_lines (new_index), FALSE);
+  g_return_val_if_fail (hunks != NULL, FALSE);
+
+  /* Most edits touch a few lines in the middle of the window */
+  while (old_begin < old_end && new_begin < new_end &&
+         line_equal (old_index, old_begin, new_index, new_begin))
+    old_begin++, new_begin++;
+
+  while (old_begin < old_end && new_begin < new_end &&
+         line_equal (old_index, old_end - 1, new_index, new_end - 1))
+    old_end--, new_end--;
+
+  if (old_begin == old_end && new_begin == new_end)
+    return TRUE;
+
+  if (old_begin == old_end || new_begin == new_end)
+    {
+      add_hunk (hunks, old_begin, old_end, new_begin, new_end);
+      return TRUE;
+    }
+
+  n = old_end - old_begin;
+  m = new_end - new_begin;
+  max = MIN ((guint)(n + m), max_cost);
+
+#define V(k) v[(k) + max + 1]
+
+  v = g_new0 (gint, 2 * max + 3);
+  trace = g_array_new (FALSE, FALSE, sizeof (gint));
+
+  for (d = 0; d <= max; d++)
+    {
+      /* Keep the diagonals reached after d - 1 edits for backtracking */
+      if (d > 0)
+        g_array_append_vals (trace, &V (-(d - 1)), 2 * d - 1);
+
+      for (gint k = -d; k <= d; k += 2)
+        {
+          if (k == -d || (k != d && V (k - 1) < V (k + 1)))
+            x = V (k + 1);
+          else
+            x = V (k - 1) + 1;
+
+          y = x - k;
+
+          while (x < n && y < m &&
+                 line_equal (old_index, old_begin + x, new_index, new_begin + y))
+            x++, y++;
+
+          V (k) = x;
+
+          if (x >= n && y >= m)
+            goto backtrack;
+        }
+    }
+
+#undef V
+
+  return FALSE;
+
+backtrack:
+  found = g_array_new (FALSE, FALSE, sizeof (LineHunk));
+  x = n;
+  y = m;
+
+  for (; d > 0; d--)
+    {
+      const gint *prev = &g_array_index (trace, gint, (d - 1) * (d - 1));
+      gint k = x - y;
+      gint prev_k;
+      gint prev_x;
+      gint prev_y;
+
+#define P(k) prev[(k) + d - 1]
+
+      if (k == -d || (k != d && P (k - 1) < P (k + 1)))
+        prev_k = k + 1;
+      else
+        prev_k = k - 1;
+
+      prev_x = P (prev_k);
+      prev_y = prev_x - prev_k;
+
+#undef P
+
+      /* Unchanged lines after this edit end the hunk we are building */
+      if (x > prev_x && y > prev_y)
+        {
+          if (has_cur)
+            g_array_append_val (found, cur);
+          has_cur = FALSE;
+        }
+
+      while (x > prev_x && y > prev_y)
+        x--, y--;
+
+      if (!has_cur)
+        {
+          cur.old_begin = cur.old_end = x;
+          cur.new_begin = cur.new_end = y;
+          has_cur = TRUE;
+        }
+
+      cur.old_begin = prev_x;
+      cur.new_begin = prev_y;
+
+      x = prev_x;
+      y = prev_y;
+    }
+
+  if (has_cur)
+    g_array_append_val (found, cur);
+
+  for (guint i = found->len; i > 0; i--)
+    {
+      const LineHunk *hunk = &g_array_index (found, LineHunk, i - 1);
+
+      add_hunk (hunks,
+                old_begin + hunk->old_begin,
+                old_begin + hunk->old_end,
+                new_begin + hunk->new_begin,
+                new_begin + hunk->new_end);
+    }
+
+  return TRUE;
+}
@@ -0,0 +1,54 @@
+/* line-diff.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _LineIndex LineIndex;
+
+/* Lines are 0-based and ranges are half-open. A range with no lines
+ * is the position the lines were inserted at or removed from.
+ */
+typedef struct
+{
+  guint old_begin;
+  guint old_end;
+  guint new_begin;
+  guint new_end;
+} LineHunk;
+
+LineIndex *line_index_new           (GBytes          *bytes);
+void       line_index_free          (LineIndex       *self);
+guint      line_index_get_n_lines   (const LineIndex *self);
+gboolean   line_diff                (const LineIndex *old_index,
+                                     guint            old_begin,
+                                     guint            old_end,
+                                     const LineIndex *new_index,
+                                     guint            new_begin,
+                                     guint            new_end,
+                                     guint            max_cost,
+                                     GArray          *hunks);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (LineIndex, line_index_free)
+
+G_END_DECLS
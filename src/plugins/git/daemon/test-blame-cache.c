@@ -0,0 +1,259 @@
+/* test-blame-cache.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libgit2-glib/ggit.h>
+
+#include "blame-cache.h"
+
+#define N_LINES 20
+
+static const guint8 zero_id[BLAME_OID_SIZE];
+
+typedef struct
+{
+  char           *workdir;
+  char           *path;
+  GgitRepository *repository;
+  char           *commit_id;
+} Fixture;
+
+static void
+fixture_setup (Fixture       *f,
+               gconstpointer  data)
+{
+  g_autoptr(GgitSignature) signature = NULL;
+  g_autoptr(GgitIndex) index = NULL;
+  g_autoptr(GgitTree) tree = NULL;
+  g_autoptr(GgitOId) tree_id = NULL;
+  g_autoptr(GgitOId) commit_id = NULL;
+  g_autoptr(GFile) location = NULL;
+  g_autoptr(GString) contents = g_string_new (NULL);
+  g_autoptr(GError) error = NULL;
+
+  f->workdir = g_dir_make_tmp ("test-blame-cache-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  location = g_file_new_for_path (f->workdir);
+  f->repository = ggit_repository_init_repository (location, FALSE, &error);
+  g_assert_no_error (error);
+
+  for (guint i = 0; i < N_LINES; i++)
+    g_string_append_printf (contents, "line %u\n", i);
+
+  f->path = g_build_filename (f->workdir, "file.txt", NULL);
+  g_file_set_contents (f->path, contents->str, contents->len, &error);
+  g_assert_no_error (error);
+
+  index = ggit_repository_get_index (f->repository, &error);
+  g_assert_no_error (error);
+  ggit_index_add_path (index, "file.txt", &error);
+  g_assert_no_error (error);
+  ggit_index_write (index, &error);
+  g_assert_no_error (error);
+  tree_id = ggit_index_write_tree (index, &error);
+  g_assert_no_error (error);
+  tree = ggit_repository_lookup_tree (f->repository, tree_id, &error);
+  g_assert_no_error (error);
+
+  signature = ggit_signature_new_now ("Builder", "builder@example.com", &error);
+  g_assert_no_error (error);
+
+  commit_id = ggit_repository_create_commit (f->repository,
+                                             "HEAD",
+                                             signature,
+                                             signature,
+                                             NULL,
+                                             "Add file.txt",
+                                             tree,
+                                             NULL,
+                                             0,
+                                             &error);
+  g_assert_no_error (error);
+
+  f->commit_id = ggit_oid_to_string (commit_id);
+}
+
+static void
+fixture_teardown (Fixture       *f,
+                  gconstpointer  data)
+{
+  g_autofree char *command = g_strdup_printf ("rm -rf '%s'", f->workdir);
+
+  if (system (command) != 0)
+    g_warning ("Failed to execute command: %s", command);
+
+  g_clear_object (&f->repository);
+  g_clear_pointer (&f->commit_id, g_free);
+  g_clear_pointer (&f->path, g_free);
+  g_clear_pointer (&f->workdir, g_free);
+}
+
+/* Blames @lines as the unsaved contents of the buffer */
+static GArray *
+blame_contents (Fixture            *f,
+                const char * const *lines)
+{
+  g_autoptr(GgitOId) blob_id = NULL;
+  g_autoptr(GgitBlob) blob = NULL;
+  g_autoptr(GArray) hunks = NULL;
+  g_autoptr(GString) contents = g_string_new (NULL);
+  g_autoptr(GError) error = NULL;
+  GArray *ret;
+
+  for (guint i = 0; lines[i]; i++)
+    {
+      g_string_append (contents, lines[i]);
+      g_string_append_c (contents, '\n');
+    }
+
+  hunks = blame_cache_blame_file (blame_cache_get_default (), f->repository, f->path, &blob_id, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (hunks);
+
+  blob = ggit_repository_lookup_blob (f->repository, blob_id, &error);
+  g_assert_no_error (error);
+
+  ret = blame_hunks_apply_diff (hunks, blob, "file.txt",
+                                (const guint8 *)contents->str, contents->len,
+                                &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (ret);
+
+  return ret;
+}
+
+static void
+assert_committed (Fixture *f,
+                  GArray  *hunks,
+                  guint    line,
+                  guint    orig_line)
+{
+  const BlameHunk *hunk = blame_hunks_lookup (hunks, line);
+  g_autofree char *commit_id = NULL;
+
+  g_assert_nonnull (hunk);
+
+  commit_id = blame_hunk_dup_commit (hunk);
+  g_assert_cmpstr (commit_id, ==, f->commit_id);
+  g_assert_cmpuint (hunk->orig_start + (line - hunk->final_start), ==, orig_line);
+}
+
+static void
+assert_uncommitted (GArray *hunks,
+                    guint   line)
+{
+  const BlameHunk *hunk = blame_hunks_lookup (hunks, line);
+
+  g_assert_nonnull (hunk);
+  g_assert_cmpmem (hunk->commit_id, BLAME_OID_SIZE, zero_id, BLAME_OID_SIZE);
+}
+
+static void
+test_blame_cache_unmodified (Fixture       *f,
+                             gconstpointer  data)
+{
+  g_autoptr(GPtrArray) lines = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(GArray) hunks = NULL;
+
+  for (guint i = 0; i < N_LINES; i++)
+    g_ptr_array_add (lines, g_strdup_printf ("line %u", i));
+  g_ptr_array_add (lines, NULL);
+
+  hunks = blame_contents (f, (const char * const *)lines->pdata);
+
+  /* Lines are 1-based */
+  for (guint i = 1; i <= N_LINES; i++)
+    assert_committed (f, hunks, i, i);
+  g_assert_null (blame_hunks_lookup (hunks, N_LINES + 1));
+}
+
+static void
+test_blame_cache_local_edits (Fixture       *f,
+                              gconstpointer  data)
+{
+  g_autoptr(GPtrArray) lines = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(GArray) hunks = NULL;
+  guint n_lines;
+
+  /* Change the first line, insert two lines after "line 5",
+   * remove "line 10" and append a line at the end.
+   */
+  for (guint i = 0; i < N_LINES; i++)
+    {
+      if (i == 0)
+        g_ptr_array_add (lines, g_strdup ("changed 0"));
+      else if (i != 10)
+        g_ptr_array_add (lines, g_strdup_printf ("line %u", i));
+
+      if (i == 5)
+        {
+          g_ptr_array_add (lines, g_strdup ("added 0"));
+          g_ptr_array_add (lines, g_strdup ("added 1"));
+        }
+    }
+  g_ptr_array_add (lines, g_strdup ("added 2"));
+  n_lines = lines->len;
+  g_ptr_array_add (lines, NULL);
+
+  hunks = blame_contents (f, (const char * const *)lines->pdata);
+
+  /* Every line of the buffer must be found */
+  for (guint i = 1; i <= n_lines; i++)
+    g_assert_nonnull (blame_hunks_lookup (hunks, i));
+  g_assert_null (blame_hunks_lookup (hunks, n_lines + 1));
+
+  assert_uncommitted (hunks, 1);
+  for (guint i = 2; i <= 6; i++)
+    assert_committed (f, hunks, i, i);
+  assert_uncommitted (hunks, 7);
+  assert_uncommitted (hunks, 8);
+  for (guint i = 9; i <= 12; i++)
+    assert_committed (f, hunks, i, i - 2);
+  for (guint i = 13; i <= 21; i++)
+    assert_committed (f, hunks, i, i - 1);
+  assert_uncommitted (hunks, 22);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autofree char *cache_dir = g_dir_make_tmp ("test-blame-cache-XXXXXX", NULL);
+  g_autofree char *command = NULL;
+  int ret;
+
+  /* Keep the blame cache out of the user's cache directory */
+  g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
+  ggit_init ();
+  g_test_init (&argc, &argv, NULL);
+  g_test_add ("/Git/BlameCache/unmodified", Fixture, NULL, fixture_setup, test_blame_cache_unmodified, fixture_teardown);
+  g_test_add ("/Git/BlameCache/local-edits", Fixture, NULL, fixture_setup, test_blame_cache_local_edits, fixture_teardown);
+  ret = g_test_run ();
+
+  command = g_strdup_printf ("rm -rf '%s'", cache_dir);
+  if (system (command) != 0)
+    g_warning ("Failed to execute command: %s", command);
+
+  return ret;
+}
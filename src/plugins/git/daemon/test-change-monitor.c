@@ -0,0 +1,448 @@
+/* test-change-monitor.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <stdlib.h>
+
+#include <libgit2-glib/ggit.h>
+
+#include "ipc-git-change-monitor-impl.h"
+#include "line-cache.h"
+
+/* Large enough for an edit to be too costly to diff incrementally */
+#define N_LINES 1200
+
+typedef struct
+{
+  guint begin;
+  guint old_end;
+  guint new_end;
+} Edit;
+
+typedef struct
+{
+  char                *workdir;
+  GgitRepository      *repository;
+  IpcGitChangeMonitor *monitor;
+  /* The contents as edited by the test and the edits since the last update */
+  GPtrArray           *lines;
+  GArray              *edits;
+  /* The marks as kept by the client, updated from ListChangedLines() */
+  LineCache           *cache;
+  guint                n_added;
+} Fixture;
+
+static char *
+join_lines (GPtrArray *lines)
+{
+  GString *str = g_string_new (NULL);
+
+  for (guint i = 0; i < lines->len; i++)
+    {
+      g_string_append (str, g_ptr_array_index (lines, i));
+      g_string_append_c (str, '\n');
+    }
+
+  return g_string_free (str, FALSE);
+}
+
+static void
+commit_contents (Fixture    *f,
+                 const char *contents)
+{
+  g_autofree char *path = g_build_filename (f->workdir, "file.txt", NULL);
+  g_autoptr(GgitSignature) signature = NULL;
+  g_autoptr(GgitCommit) parent = NULL;
+  g_autoptr(GgitIndex) index = NULL;
+  g_autoptr(GgitTree) tree = NULL;
+  g_autoptr(GgitRef) head = NULL;
+  g_autoptr(GgitOId) tree_id = NULL;
+  g_autoptr(GgitOId) commit_id = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_file_set_contents (path, contents, -1, &error);
+  g_assert_no_error (error);
+
+  index = ggit_repository_get_index (f->repository, &error);
+  g_assert_no_error (error);
+  ggit_index_add_path (index, "file.txt", &error);
+  g_assert_no_error (error);
+  ggit_index_write (index, &error);
+  g_assert_no_error (error);
+  tree_id = ggit_index_write_tree (index, &error);
+  g_assert_no_error (error);
+  tree = ggit_repository_lookup_tree (f->repository, tree_id, &error);
+  g_assert_no_error (error);
+
+  /* There is no HEAD until the first commit */
+  if ((head = ggit_repository_get_head (f->repository, NULL)))
+    {
+      g_autoptr(GgitOId) head_id = ggit_ref_get_target (head);
+
+      parent = ggit_repository_lookup_commit (f->repository, head_id, &error);
+      g_assert_no_error (error);
+    }
+
+  signature = ggit_signature_new_now ("Builder", "builder@example.com", &error);
+  g_assert_no_error (error);
+
+  commit_id = ggit_repository_create_commit (f->repository,
+                                             "HEAD",
+                                             signature,
+                                             signature,
+                                             NULL,
+                                             "Update file.txt",
+                                             tree,
+                                             parent ? &parent : NULL,
+                                             parent ? 1 : 0,
+                                             &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (commit_id);
+}
+
+static const char **
+make_added_lines (Fixture *f,
+                  guint    n_lines)
+{
+  GPtrArray *ar = g_ptr_array_new ();
+
+  for (guint i = 0; i < n_lines; i++)
+    g_ptr_array_add (ar, g_strdup_printf ("added %u", f->n_added++));
+  g_ptr_array_add (ar, NULL);
+
+  return (const char **)g_ptr_array_free (ar, FALSE);
+}
+
+/* Replaces @n_removed lines at @begin with @n_added new lines and records
+ * the edit the way the client reports it to the daemon.
+ */
+static void
+replace_lines (Fixture *f,
+               guint    begin,
+               guint    n_removed,
+               guint    n_added)
+{
+  g_autofree const char **added = make_added_lines (f, n_added);
+  Edit edit = { begin, begin + n_removed, begin + n_added };
+
+  g_assert_cmpuint (begin + n_removed, <=, f->lines->len);
+
+  g_ptr_array_remove_range (f->lines, begin, n_removed);
+  for (guint i = 0; i < n_added; i++)
+    g_ptr_array_insert (f->lines, begin + i, (char *)added[i]);
+
+  g_array_append_val (f->edits, edit);
+}
+
+/* Only valid while no lines were added or removed before @line */
+static void
+restore_line (Fixture *f,
+              guint    line)
+{
+  Edit edit = { line, line + 1, line + 1 };
+
+  g_free (f->lines->pdata[line]);
+  f->lines->pdata[line] = g_strdup_printf ("line %u", line);
+
+  g_array_append_val (f->edits, edit);
+}
+
+static void
+assert_marks_equal (GVariant *marks,
+                    GVariant *expected)
+{
+  const LineEntry *entries;
+  const LineEntry *expected_entries;
+  gsize n_entries = 0;
+  gsize n_expected = 0;
+
+  entries = g_variant_get_fixed_array (marks, &n_entries, sizeof (LineEntry));
+  expected_entries = g_variant_get_fixed_array (expected, &n_expected, sizeof (LineEntry));
+
+  for (gsize i = 0; i < MIN (n_entries, n_expected); i++)
+    {
+      g_assert_cmpuint (entries[i].line, ==, expected_entries[i].line);
+      g_assert_cmpuint (entries[i].mark, ==, expected_entries[i].mark);
+    }
+
+  g_assert_cmpuint (n_entries, ==, n_expected);
+}
+
+/* Sends the contents along with the recorded edits, applies the reply as
+ * the client does and compares the marks to a full diff with libgit2.
+ */
+static void
+check_update (Fixture  *f,
+              gboolean  incremental)
+{
+  g_autoptr(IpcGitChangeMonitor) full = NULL;
+  g_autoptr(GVariant) edits = NULL;
+  g_autoptr(GVariant) changes = NULL;
+  g_autoptr(GVariant) expected = NULL;
+  g_autoptr(GVariant) marks = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *contents = join_lines (f->lines);
+  guint begin_line = 0;
+  guint old_end_line = 0;
+  guint new_end_line = 0;
+
+  if (f->edits->len > 0)
+    {
+      GVariantBuilder builder;
+
+      g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(uuu)"));
+      for (guint i = 0; i < f->edits->len; i++)
+        {
+          const Edit *edit = &g_array_index (f->edits, Edit, i);
+          g_variant_builder_add (&builder, "(uuu)", edit->begin, edit->old_end, edit->new_end);
+        }
+      edits = g_variant_ref_sink (g_variant_builder_end (&builder));
+      g_array_set_size (f->edits, 0);
+    }
+
+  ipc_git_change_monitor_impl_update_content (IPC_GIT_CHANGE_MONITOR_IMPL (f->monitor), contents, edits);
+  changes = ipc_git_change_monitor_impl_list_changed_lines (IPC_GIT_CHANGE_MONITOR_IMPL (f->monitor),
+                                                            &begin_line, &old_end_line, &new_end_line,
+                                                            &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (changes);
+
+  if (incremental)
+    {
+      g_autoptr(LineCache) replacement = line_cache_new_from_variant (changes);
+
+      g_assert_cmpuint (new_end_line, !=, G_MAXUINT);
+      g_assert_cmpuint (begin_line, <=, old_end_line);
+      g_assert_cmpuint (begin_line, <=, new_end_line);
+
+      line_cache_splice (f->cache, begin_line, old_end_line, new_end_line, replacement);
+    }
+  else
+    {
+      g_assert_cmpuint (begin_line, ==, 0);
+      g_assert_cmpuint (old_end_line, ==, G_MAXUINT);
+      g_assert_cmpuint (new_end_line, ==, G_MAXUINT);
+
+      g_clear_pointer (&f->cache, line_cache_free);
+      f->cache = line_cache_new_from_variant (changes);
+    }
+
+  full = ipc_git_change_monitor_impl_new (f->repository, "file.txt");
+  ipc_git_change_monitor_impl_update_content (IPC_GIT_CHANGE_MONITOR_IMPL (full), contents, NULL);
+  expected = ipc_git_change_monitor_impl_list_changed_lines (IPC_GIT_CHANGE_MONITOR_IMPL (full),
+                                                             &begin_line, &old_end_line, &new_end_line,
+                                                             &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (new_end_line, ==, G_MAXUINT);
+
+  marks = line_cache_to_variant (f->cache);
+  assert_marks_equal (marks, expected);
+}
+
+static void
+fixture_setup (Fixture       *f,
+               gconstpointer  data)
+{
+  g_autoptr(GFile) location = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *contents = NULL;
+
+  f->workdir = g_dir_make_tmp ("test-change-monitor-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  location = g_file_new_for_path (f->workdir);
+  f->repository = ggit_repository_init_repository (location, FALSE, &error);
+  g_assert_no_error (error);
+
+  f->lines = g_ptr_array_new_with_free_func (g_free);
+  for (guint i = 0; i < N_LINES; i++)
+    g_ptr_array_add (f->lines, g_strdup_printf ("line %u", i));
+
+  contents = join_lines (f->lines);
+  commit_contents (f, contents);
+
+  f->edits = g_array_new (FALSE, FALSE, sizeof (Edit));
+  f->cache = line_cache_new ();
+  f->monitor = ipc_git_change_monitor_impl_new (f->repository, "file.txt");
+
+  /* Nothing has been diffed yet */
+  check_update (f, FALSE);
+}
+
+static void
+fixture_teardown (Fixture       *f,
+                  gconstpointer  data)
+{
+  g_autofree char *command = g_strdup_printf ("rm -rf '%s'", f->workdir);
+
+  if (system (command) != 0)
+    g_warning ("Failed to execute command: %s", command);
+
+  g_clear_object (&f->monitor);
+  g_clear_object (&f->repository);
+  g_clear_pointer (&f->cache, line_cache_free);
+  g_clear_pointer (&f->edits, g_array_unref);
+  g_clear_pointer (&f->lines, g_ptr_array_unref);
+  g_clear_pointer (&f->workdir, g_free);
+}
+
+static void
+test_change_monitor_middle (Fixture       *f,
+                            gconstpointer  data)
+{
+  /* Changed, added and removed lines */
+  replace_lines (f, 100, 1, 1);
+  check_update (f, TRUE);
+
+  replace_lines (f, 200, 0, 3);
+  check_update (f, TRUE);
+
+  replace_lines (f, 300, 2, 0);
+  check_update (f, TRUE);
+
+  /* Several edits merged into one update */
+  replace_lines (f, 400, 1, 2);
+  replace_lines (f, 410, 3, 1);
+  replace_lines (f, 405, 0, 1);
+  check_update (f, TRUE);
+
+  /* Reverting a change removes its hunk */
+  restore_line (f, 100);
+  check_update (f, TRUE);
+}
+
+static void
+test_change_monitor_hunk_boundaries (Fixture       *f,
+                                     gconstpointer  data)
+{
+  /* Restoring a line in the middle of a hunk splits it */
+  replace_lines (f, 700, 3, 3);
+  check_update (f, TRUE);
+  restore_line (f, 701);
+  check_update (f, TRUE);
+
+  /* Two hunks with one unchanged line between them */
+  replace_lines (f, 500, 1, 1);
+  replace_lines (f, 502, 1, 1);
+  check_update (f, TRUE);
+
+  /* Changing the line between them joins the hunks */
+  replace_lines (f, 501, 1, 1);
+  check_update (f, TRUE);
+
+  /* Lines right before and right after an existing hunk */
+  replace_lines (f, 499, 0, 1);
+  check_update (f, TRUE);
+
+  replace_lines (f, 504, 1, 0);
+  check_update (f, TRUE);
+
+  /* Within an existing hunk, changing its size */
+  replace_lines (f, 501, 1, 3);
+  check_update (f, TRUE);
+
+  /* An addition and a removal with one unchanged line between them */
+  replace_lines (f, 600, 0, 2);
+  replace_lines (f, 603, 1, 0);
+  check_update (f, TRUE);
+}
+
+static void
+test_change_monitor_file_boundaries (Fixture       *f,
+                                     gconstpointer  data)
+{
+  /* Removing the first line is marked on the line before it */
+  replace_lines (f, 0, 1, 0);
+  check_update (f, TRUE);
+
+  replace_lines (f, 0, 0, 2);
+  check_update (f, TRUE);
+
+  replace_lines (f, 1, 1, 1);
+  check_update (f, TRUE);
+
+  /* Changing, appending and removing at the end */
+  replace_lines (f, f->lines->len - 1, 1, 1);
+  check_update (f, TRUE);
+
+  replace_lines (f, f->lines->len, 0, 2);
+  check_update (f, TRUE);
+
+  replace_lines (f, f->lines->len - 3, 3, 0);
+  check_update (f, TRUE);
+}
+
+static void
+test_change_monitor_fallbacks (Fixture       *f,
+                               gconstpointer  data)
+{
+  g_autofree char *contents = NULL;
+  Edit invalid = { 50, 49, 49 };
+
+  /* Edits are unknown */
+  replace_lines (f, 10, 1, 1);
+  g_array_set_size (f->edits, 0);
+  check_update (f, FALSE);
+
+  replace_lines (f, 20, 1, 1);
+  check_update (f, TRUE);
+
+  /* Edits do not account for the lines added */
+  replace_lines (f, 30, 1, 2);
+  g_array_index (f->edits, Edit, 0).new_end--;
+  check_update (f, FALSE);
+
+  /* An edit ending before it begins */
+  replace_lines (f, 40, 1, 1);
+  g_array_append_val (f->edits, invalid);
+  check_update (f, FALSE);
+
+  replace_lines (f, 60, 0, 1);
+  check_update (f, TRUE);
+
+  /* Too many lines to align with the blob */
+  replace_lines (f, 100, 600, 600);
+  check_update (f, FALSE);
+
+  replace_lines (f, 50, 1, 1);
+  check_update (f, TRUE);
+
+  /* The blob changed, such as after a commit */
+  contents = join_lines (f->lines);
+  commit_contents (f, contents);
+  ipc_git_change_monitor_impl_reset (IPC_GIT_CHANGE_MONITOR_IMPL (f->monitor));
+  replace_lines (f, 70, 1, 1);
+  check_update (f, FALSE);
+
+  replace_lines (f, 80, 1, 1);
+  check_update (f, TRUE);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  ggit_init ();
+  g_test_init (&argc, &argv, NULL);
+  g_test_add ("/Git/ChangeMonitor/middle", Fixture, NULL, fixture_setup, test_change_monitor_middle, fixture_teardown);
+  g_test_add ("/Git/ChangeMonitor/hunk-boundaries", Fixture, NULL, fixture_setup, test_change_monitor_hunk_boundaries, fixture_teardown);
+  g_test_add ("/Git/ChangeMonitor/file-boundaries", Fixture, NULL, fixture_setup, test_change_monitor_file_boundaries, fixture_teardown);
+  g_test_add ("/Git/ChangeMonitor/fallbacks", Fixture, NULL, fixture_setup, test_change_monitor_fallbacks, fixture_teardown);
+  return g_test_run ();
+}
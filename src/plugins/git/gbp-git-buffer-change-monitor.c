@@ -37,6 +37,7 @@ struct _GbpGitBufferChangeMonitor
   IpcGitChangeMonitor    *proxy;
   GSignalGroup           *vcs_signals;
   LineCache              *cache;
+  GArray                 *edits;
   GWeakRef                buffer_wr;
   guint                   commit_notify;
   guint                   last_change_count;
@@ -45,9 +46,19 @@ struct _GbpGitBufferChangeMonitor
   guint                   not_found : 1;
 };
 
+typedef struct
+{
+  guint begin;
+  guint old_end;
+  guint new_end;
+} LineEdit;
+
 enum { SLOW, FAST };
 static const guint g_delay[] = { 750, 50 };
 
+/* Past this many edits we just let the daemon diff the whole file */
+#define MAX_EDITS 1000
+
 G_DEFINE_FINAL_TYPE (GbpGitBufferChangeMonitor, gbp_git_buffer_change_monitor, IDE_TYPE_BUFFER_CHANGE_MONITOR)
 
 static gboolean
@@ -89,6 +100,28 @@ gbp_git_buffer_change_monitor_queue_update (GbpGitBufferChangeMonitor *self,
                         g_object_unref);
 }
 
+static void
+gbp_git_buffer_change_monitor_add_edit (GbpGitBufferChangeMonitor *self,
+                                        guint                      begin,
+                                        guint                      old_end,
+                                        guint                      new_end)
+{
+  LineEdit edit = { begin, old_end, new_end };
+
+  g_assert (GBP_IS_GIT_BUFFER_CHANGE_MONITOR (self));
+
+  if (self->edits == NULL)
+    return;
+
+  if (self->edits->len >= MAX_EDITS)
+    {
+      g_clear_pointer (&self->edits, g_array_unref);
+      return;
+    }
+
+  g_array_append_val (self->edits, edit);
+}
+
 static void
 gbp_git_buffer_change_monitor_commit_notify (GtkTextBuffer            *buffer,
                                              GtkTextBufferNotifyFlags  flags,
@@ -130,6 +163,8 @@ gbp_git_buffer_change_monitor_commit_notify (GtkTextBuffer            *buffer,
       begin_line = gtk_text_iter_get_line (&begin);
       end_line = gtk_text_iter_get_line (&end);
 
+      gbp_git_buffer_change_monitor_add_edit (self, begin_line, begin_line + 1, end_line + 1);
+
       if (begin_line != end_line ||
           self->cache == NULL ||
           !line_cache_get_mark (self->cache, begin_line))
@@ -162,6 +197,8 @@ gbp_git_buffer_change_monitor_commit_notify (GtkTextBuffer            *buffer,
       begin_line = gtk_text_iter_get_line (&begin);
       end_line = gtk_text_iter_get_line (&end);
 
+      gbp_git_buffer_change_monitor_add_edit (self, begin_line, end_line + 1, begin_line + 1);
+
       if (begin_line != end_line ||
           self->cache == NULL ||
           !line_cache_get_mark (self->cache, begin_line))
@@ -204,6 +241,7 @@ gbp_git_buffer_change_monitor_destroy (IdeObject *object)
     }
 
   g_clear_pointer (&self->cache, line_cache_free);
+  g_clear_pointer (&self->edits, g_array_unref);
   g_clear_handle_id (&self->queued_source, g_source_remove);
 
   IDE_OBJECT_CLASS (gbp_git_buffer_change_monitor_parent_class)->destroy (object);
@@ -317,6 +355,29 @@ gbp_git_buffer_change_monitor_foreach_change (IdeBufferChangeMonitor
   line_cache_foreach_in_range (self->cache, begin_line, end_line, foreach_cb, &state);
 }
 
+static void
+gbp_git_buffer_change_monitor_foreach_run (IdeBufferChangeMonitor               *monitor,
+                                           guint                                 begin_line,
+                                           guint                                 end_line,
+                                           IdeBufferChangeMonitorForeachRunFunc  callback,
+                                           gpointer                              user_data)
+{
+  GbpGitBufferChangeMonitor *self = (GbpGitBufferChangeMonitor *)monitor;
+
+  g_assert (GBP_IS_GIT_BUFFER_CHANGE_MONITOR (self));
+  g_assert (callback != NULL);
+
+  /* Untracked files are a single run rather than one callback per line */
+  if (self->cache == NULL)
+    {
+      if (self->not_found)
+        callback (begin_line, end_line, IDE_BUFFER_LINE_CHANGE_ADDED, user_data);
+      return;
+    }
+
+  IDE_BUFFER_CHANGE_MONITOR_CLASS (gbp_git_buffer_change_monitor_parent_class)->foreach_run (monitor, begin_line, end_line, callback, user_data);
+}
+
 static IdeBufferLineChange
 gbp_git_buffer_change_monitor_get_change (IdeBufferChangeMonitor *monitor,
                                           guint                   line)
@@ -361,6 +422,7 @@ gbp_git_buffer_change_monitor_class_init (GbpGitBufferChangeMonitorClass *klass)
   monitor_class->reload = gbp_git_buffer_change_monitor_reload;
   monitor_class->get_change = gbp_git_buffer_change_monitor_get_change;
   monitor_class->foreach_change = gbp_git_buffer_change_monitor_foreach_change;
+  monitor_class->foreach_run = gbp_git_buffer_change_monitor_foreach_run;
 
   i_object_class->destroy = gbp_git_buffer_change_monitor_destroy;
 }
@@ -473,6 +535,70 @@ gbp_git_buffer_change_monitor_wait_cb (GObject      *object,
     }
 }
 
+static void
+gbp_git_buffer_change_monitor_wait_lines_cb (GObject      *object,
+                                             GAsyncResult *result,
+                                             gpointer      user_data)
+{
+  IpcGitChangeMonitor *proxy = (IpcGitChangeMonitor *)object;
+  g_autoptr(GVariant) changes = NULL;
+  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(GError) error = NULL;
+  GbpGitBufferChangeMonitor *self;
+  guint begin_line = 0;
+  guint old_end_line = 0;
+  guint new_end_line = 0;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (IPC_IS_GIT_CHANGE_MONITOR (proxy));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_TASK (task));
+
+  self = ide_task_get_source_object (task);
+
+  if (!ipc_git_change_monitor_call_list_changed_lines_finish (proxy,
+                                                              &begin_line,
+                                                              &old_end_line,
+                                                              &new_end_line,
+                                                              &changes,
+                                                              result,
+                                                              &error))
+    {
+      g_clear_pointer (&self->cache, line_cache_free);
+      self->not_found = TRUE;
+
+      if (g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_FILE_NOT_FOUND))
+        ide_task_return_boolean (task, TRUE);
+      else
+        ide_task_return_error (task, g_steal_pointer (&error));
+    }
+  else if (new_end_line == G_MAXUINT)
+    {
+      g_clear_pointer (&self->cache, line_cache_free);
+      self->not_found = FALSE;
+      self->cache = line_cache_new_from_variant (changes);
+      ide_buffer_change_monitor_emit_changed (IDE_BUFFER_CHANGE_MONITOR (self));
+      ide_task_return_boolean (task, TRUE);
+    }
+  else
+    {
+      g_autoptr(LineCache) replacement = line_cache_new_from_variant (changes);
+
+      /* The cache is NULL if an earlier request failed, in which case a
+       * full listing is already on its way. An empty range means nothing
+       * changed since the last reply.
+       */
+      if (self->cache != NULL &&
+          (begin_line != old_end_line || begin_line != new_end_line))
+        {
+          line_cache_splice (self->cache, begin_line, old_end_line, new_end_line, replacement);
+          ide_buffer_change_monitor_emit_changed (IDE_BUFFER_CHANGE_MONITOR (self));
+        }
+
+      ide_task_return_boolean (task, TRUE);
+    }
+}
+
 void
 gbp_git_buffer_change_monitor_wait_async (GbpGitBufferChangeMonitor *self,
                                           GCancellable              *cancellable,
@@ -502,17 +628,52 @@ gbp_git_buffer_change_monitor_wait_async (GbpGitBufferChangeMonitor *self,
   if (change_count != self->last_change_count)
     {
       g_autoptr(GBytes) bytes = ide_buffer_dup_content (buffer);
+      const gchar *contents = g_bytes_get_data (bytes, NULL);
 
       self->last_change_count = change_count;
-      ipc_git_change_monitor_call_update_content (self->proxy,
-                                                  (const gchar *)g_bytes_get_data (bytes, NULL),
-                                                  NULL, NULL, NULL);
+
+      /* Send the edits along with the contents so that the daemon only
+       * needs to diff the lines around them. If we lost track of the
+       * edits, the daemon will diff the whole file.
+       */
+      if (self->edits != NULL && self->edits->len > 0)
+        {
+          GVariantBuilder builder;
+
+          g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(uuu)"));
+          for (guint i = 0; i < self->edits->len; i++)
+            {
+              const LineEdit *edit = &g_array_index (self->edits, LineEdit, i);
+              g_variant_builder_add (&builder, "(uuu)", edit->begin, edit->old_end, edit->new_end);
+            }
+
+          ipc_git_change_monitor_call_update_content_with_edits (self->proxy,
+                                                                 contents,
+                                                                 g_variant_builder_end (&builder),
+                                                                 NULL, NULL, NULL);
+        }
+      else
+        {
+          ipc_git_change_monitor_call_update_content (self->proxy, contents, NULL, NULL, NULL);
+        }
+
+      if (self->edits == NULL)
+        self->edits = g_array_new (FALSE, FALSE, sizeof (LineEdit));
+      else
+        g_array_set_size (self->edits, 0);
     }
 
-  ipc_git_change_monitor_call_list_changes (self->proxy,
-                                            cancellable,
-                                            gbp_git_buffer_change_monitor_wait_cb,
-                                            g_steal_pointer (&task));
+  /* Once we have the changes, only ask for the lines that differ */
+  if (self->cache == NULL)
+    ipc_git_change_monitor_call_list_changes (self->proxy,
+                                              cancellable,
+                                              gbp_git_buffer_change_monitor_wait_cb,
+                                              g_steal_pointer (&task));
+  else
+    ipc_git_change_monitor_call_list_changed_lines (self->proxy,
+                                                    cancellable,
+                                                    gbp_git_buffer_change_monitor_wait_lines_cb,
+                                                    g_steal_pointer (&task));
 }
 
 gboolean
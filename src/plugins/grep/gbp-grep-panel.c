@@ -59,6 +59,10 @@ struct _GbpGrepPanel
   GtkCheckButton    *recursive_button;
 
   GtkButton         *close_button;
+
+  GActionMap        *actions;
+
+  guint              watching_bufmgr : 1;
 };
 
 enum {
@@ -304,6 +308,33 @@ gbp_grep_panel_toggle_all_cb (GbpGrepPanel      *self,
   gtk_widget_queue_resize (GTK_WIDGET (self->tree_view));
 }
 
+static void
+gbp_grep_panel_set_can_undo_replace (GbpGrepPanel *self,
+                                     gboolean      can_undo_replace)
+{
+  GAction *action;
+
+  g_assert (GBP_IS_GREP_PANEL (self));
+
+  action = g_action_map_lookup_action (self->actions, "undo-replace");
+  g_simple_action_set_enabled (G_SIMPLE_ACTION (action), can_undo_replace);
+}
+
+static void
+gbp_grep_panel_notify_can_revert_edits_cb (GbpGrepPanel     *self,
+                                           GParamSpec       *pspec,
+                                           IdeBufferManager *bufmgr)
+{
+  g_assert (GBP_IS_GREP_PANEL (self));
+  g_assert (IDE_IS_BUFFER_MANAGER (bufmgr));
+
+  /* Only ever enabled by our own replace, so that we don't offer to
+   * revert edits which were made by something else.
+   */
+  if (!ide_buffer_manager_can_revert_edits (bufmgr))
+    gbp_grep_panel_set_can_undo_replace (self, FALSE);
+}
+
 static void
 gbp_grep_panel_replace_edited_cb (GObject      *object,
                                   GAsyncResult *result,
@@ -320,9 +351,53 @@ gbp_grep_panel_replace_edited_cb (GObject      *object,
   if (!ide_buffer_manager_apply_edits_finish (bufmgr, result, &error))
     ide_object_warning (IDE_OBJECT (bufmgr), "Failed to apply edits: %s", error->message);
 
+  gbp_grep_panel_set_can_undo_replace (self, ide_buffer_manager_can_revert_edits (bufmgr));
+
   gtk_stack_set_visible_child (self->stack, GTK_WIDGET (self->scrolled_window));
 }
 
+static void
+gbp_grep_panel_undo_replace_cb (GObject      *object,
+                                GAsyncResult *result,
+                                gpointer      user_data)
+{
+  IdeBufferManager *bufmgr = (IdeBufferManager *)object;
+  g_autoptr(GbpGrepPanel) self = user_data;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_BUFFER_MANAGER (bufmgr));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (GBP_IS_GREP_PANEL (self));
+
+  if (!ide_buffer_manager_revert_edits_finish (bufmgr, result, &error))
+    ide_object_warning (IDE_OBJECT (bufmgr), "Failed to undo replace: %s", error->message);
+
+  gtk_stack_set_visible_child (self->stack, GTK_WIDGET (self->scrolled_window));
+}
+
+static void
+gbp_grep_panel_undo_replace_action (GSimpleAction *action,
+                                    GVariant      *variant,
+                                    gpointer       user_data)
+{
+  GbpGrepPanel *self = (GbpGrepPanel *)user_data;
+  IdeBufferManager *bufmgr;
+  IdeContext *context;
+
+  g_assert (GBP_IS_GREP_PANEL (self));
+
+  context = ide_widget_get_context (GTK_WIDGET (self));
+  bufmgr = ide_buffer_manager_from_context (context);
+
+  gbp_grep_panel_set_can_undo_replace (self, FALSE);
+  gtk_stack_set_visible_child (self->stack, GTK_WIDGET (self->spinner));
+
+  ide_buffer_manager_revert_edits_async (bufmgr,
+                                         NULL,
+                                         gbp_grep_panel_undo_replace_cb,
+                                         g_object_ref (self));
+}
+
 static void
 gbp_grep_panel_replace_clicked_cb (GbpGrepPanel *self,
                                    GtkButton    *button)
@@ -356,6 +431,18 @@ gbp_grep_panel_replace_clicked_cb (GbpGrepPanel *self,
   context = ide_widget_get_context (GTK_WIDGET (self));
   bufmgr = ide_buffer_manager_from_context (context);
 
+  if (!self->watching_bufmgr)
+    {
+      self->watching_bufmgr = TRUE;
+      g_signal_connect_object (bufmgr,
+                               "notify::can-revert-edits",
+                               G_CALLBACK (gbp_grep_panel_notify_can_revert_edits_cb),
+                               self,
+                               G_CONNECT_SWAPPED);
+    }
+
+  gbp_grep_panel_set_can_undo_replace (self, FALSE);
+
   ide_buffer_manager_apply_edits_async (bufmgr,
                                         IDE_PTR_ARRAY_STEAL_FULL (&edits),
                                         NULL,
@@ -649,6 +736,7 @@ gbp_grep_panel_class_init (GbpGrepPanelClass *klass)
 
 static const GActionEntry actions[] = {
   { "close-panel", gbp_grep_panel_close_panel_action },
+  { "undo-replace", gbp_grep_panel_undo_replace_action },
 };
 
 static void
@@ -670,6 +758,8 @@ gbp_grep_panel_init (GbpGrepPanel *self)
   gtk_widget_insert_action_group (GTK_WIDGET (self),
                                   "grep",
                                   G_ACTION_GROUP (group));
+  self->actions = G_ACTION_MAP (group);
+  gbp_grep_panel_set_can_undo_replace (self, FALSE);
 
   g_signal_connect (self->find_entry,
                     "activate",
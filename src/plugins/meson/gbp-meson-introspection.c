@@ -210,17 +210,114 @@ gbp_meson_introspection_load_projectinfo (GbpMesonIntrospection *self,
   IDE_EXIT;
 }
 
+/*
+ * Collects the sources of every target by target id so that tests can
+ * be mapped to the sources of the targets they depend on.
+ */
+static GHashTable *
+collect_target_sources (JsonArray *targets)
+{
+  GHashTable *target_sources;
+  guint length;
+
+  g_assert (targets != NULL);
+
+  target_sources = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+  length = json_array_get_length (targets);
+
+  for (guint i = 0; i < length; i++)
+    {
+      JsonNode *node = json_array_get_element (targets, i);
+      g_autofree char *id = NULL;
+      GPtrArray *sources;
+      JsonArray *groups;
+      JsonObject *obj;
+      guint n_groups;
+
+      if (!JSON_NODE_HOLDS_OBJECT (node) ||
+          !(obj = json_node_get_object (node)) ||
+          !get_string_member (obj, "id", &id) ||
+          id == NULL ||
+          !json_object_has_member (obj, "target_sources") ||
+          !JSON_NODE_HOLDS_ARRAY (json_object_get_member (obj, "target_sources")))
+        continue;
+
+      groups = json_object_get_array_member (obj, "target_sources");
+      n_groups = json_array_get_length (groups);
+      sources = g_ptr_array_new_with_free_func (g_free);
+
+      for (guint j = 0; j < n_groups; j++)
+        {
+          JsonNode *group = json_array_get_element (groups, j);
+          g_auto(GStrv) group_sources = NULL;
+
+          if (JSON_NODE_HOLDS_OBJECT (group) &&
+              get_strv_member (json_node_get_object (group), "sources", &group_sources))
+            {
+              for (guint k = 0; group_sources[k]; k++)
+                g_ptr_array_add (sources, g_steal_pointer (&group_sources[k]));
+            }
+        }
+
+      g_hash_table_insert (target_sources, g_steal_pointer (&id), sources);
+    }
+
+  return target_sources;
+}
+
+static char **
+get_test_sources (JsonObject *test,
+                  GHashTable *target_sources)
+{
+  g_autoptr(GHashTable) seen = NULL;
+  g_auto(GStrv) depends = NULL;
+  GPtrArray *strv;
+
+  g_assert (test != NULL);
+
+  if (target_sources == NULL ||
+      !get_strv_member (test, "depends", &depends) ||
+      depends[0] == NULL)
+    return NULL;
+
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+  strv = g_ptr_array_new ();
+
+  for (guint i = 0; depends[i]; i++)
+    {
+      GPtrArray *sources = g_hash_table_lookup (target_sources, depends[i]);
+
+      if (sources == NULL)
+        continue;
+
+      for (guint j = 0; j < sources->len; j++)
+        {
+          const char *source = g_ptr_array_index (sources, j);
+
+          if (g_hash_table_add (seen, (char *)source))
+            g_ptr_array_add (strv, g_strdup (source));
+        }
+    }
+
+  g_ptr_array_add (strv, NULL);
+
+  return (char **)(gpointer)g_ptr_array_free (strv, FALSE);
+}
+
 static void
 gbp_meson_introspection_load_test (GbpMesonIntrospection *self,
-                                   JsonObject            *test)
+                                   JsonObject            *test,
+                                   GHashTable            *target_sources)
 {
   g_autoptr(IdeRunCommand) run_command = NULL;
   g_auto(GStrv) cmd = NULL;
   g_auto(GStrv) env = NULL;
   g_auto(GStrv) suite = NULL;
+  g_auto(GStrv) sources = NULL;
   g_autofree char *name = NULL;
   g_autofree char *workdir = NULL;
   g_autofree char *id = NULL;
+  gboolean is_parallel = TRUE;
 
   IDE_ENTRY;
 
@@ -233,6 +330,12 @@ gbp_meson_introspection_load_test (GbpMesonIntrospection *self,
   get_string_member (test, "name", &name);
   get_string_member (test, "workdir", &workdir);
 
+  /* Tests with is_parallel: false must not run alongside other tests */
+  if (!get_bool_member (test, "is_parallel", &is_parallel))
+    is_parallel = TRUE;
+
+  sources = get_test_sources (test, target_sources);
+
   if (workdir == NULL)
     workdir = g_strdup (ide_pipeline_get_builddir (self->pipeline));
 
@@ -246,6 +349,10 @@ gbp_meson_introspection_load_test (GbpMesonIntrospection *self,
   ide_run_command_set_argv (run_command, (const char * const *)cmd);
   ide_run_command_set_cwd (run_command, workdir);
   ide_run_command_set_can_default (run_command, FALSE);
+  ide_run_command_set_sources (run_command, (const char * const *)sources);
+
+  if (!is_parallel)
+    ide_run_command_set_tags (run_command, IDE_STRV_INIT ("exclusive"));
 
   g_list_store_append (self->run_commands, run_command);
 
@@ -254,7 +361,8 @@ gbp_meson_introspection_load_test (GbpMesonIntrospection *self,
 
 static void
 gbp_meson_introspection_load_tests (GbpMesonIntrospection *self,
-                                    JsonArray             *tests)
+                                    JsonArray             *tests,
+                                    GHashTable            *target_sources)
 {
   guint n_items;
 
@@ -273,7 +381,7 @@ gbp_meson_introspection_load_tests (GbpMesonIntrospection *self,
       if (node != NULL &&
           JSON_NODE_HOLDS_OBJECT (node) &&
           (obj = json_node_get_object (node)))
-        gbp_meson_introspection_load_test (self, obj);
+        gbp_meson_introspection_load_test (self, obj, target_sources);
     }
 
   IDE_EXIT;
@@ -430,6 +538,7 @@ static void
 gbp_meson_introspection_load_json (GbpMesonIntrospection *self,
                                    JsonObject            *root)
 {
+  g_autoptr(GHashTable) target_sources = NULL;
   JsonNode *member;
 
   IDE_ENTRY;
@@ -438,6 +547,11 @@ gbp_meson_introspection_load_json (GbpMesonIntrospection *self,
   g_assert (GBP_IS_MESON_INTROSPECTION (self));
   g_assert (root != NULL);
 
+  if (json_object_has_member (root, "targets") &&
+      (member = json_object_get_member (root, "targets")) &&
+      JSON_NODE_HOLDS_ARRAY (member))
+    target_sources = collect_target_sources (json_node_get_array (member));
+
   if (json_object_has_member (root, "buildoptions") &&
       (member = json_object_get_member (root, "buildoptions")) &&
       JSON_NODE_HOLDS_ARRAY (member))
@@ -451,7 +565,7 @@ gbp_meson_introspection_load_json (GbpMesonIntrospection *self,
   if (json_object_has_member (root, "tests") &&
       (member = json_object_get_member (root, "tests")) &&
       JSON_NODE_HOLDS_ARRAY (member))
-    gbp_meson_introspection_load_tests (self, json_node_get_array (member));
+    gbp_meson_introspection_load_tests (self, json_node_get_array (member), target_sources);
 
   if (json_object_has_member (root, "benchmarks") &&
       (member = json_object_get_member (root, "benchmarks")) &&
@@ -762,6 +762,26 @@ populate_changes_cb (guint               line,
     }
 }
 
+static void
+populate_diagnostic_run_cb (guint                 begin_line,
+                            guint                 end_line,
+                            IdeDiagnosticSeverity severity,
+                            gpointer              user_data)
+{
+  for (guint line = begin_line; line < end_line; line++)
+    populate_diagnostics_cb (line, severity, user_data);
+}
+
+static void
+populate_change_run_cb (guint               line_begin,
+                        guint               line_end,
+                        IdeBufferLineChange change,
+                        gpointer            user_data)
+{
+  for (guint line = line_begin; line < line_end; line++)
+    populate_changes_cb (line, change, user_data);
+}
+
 static void
 gbp_omni_gutter_renderer_load_basic (GbpOmniGutterRenderer *self,
                                      GtkTextIter           *begin,
@@ -793,20 +813,23 @@ gbp_omni_gutter_renderer_load_basic (GbpOmniGutterRenderer *self,
   state.begin_line = gtk_text_iter_get_line (begin);
   state.end_line = state.begin_line + lines->len;
 
+  /* Runs let us skip straight to the visible lines instead of walking
+   * every diagnostic or change in the file.
+   */
   if ((diagnostics = ide_buffer_get_diagnostics (IDE_BUFFER (buffer))))
-    ide_diagnostics_foreach_line_in_range (diagnostics,
-                                           file,
+    ide_diagnostics_foreach_run (diagnostics,
+                                 file,
+                                 state.begin_line,
+                                 state.end_line,
+                                 populate_diagnostic_run_cb,
+                                 &state);
+
+  if (self->change_monitor != NULL)
+    ide_buffer_change_monitor_foreach_run (self->change_monitor,
                                            state.begin_line,
                                            state.end_line,
-                                           populate_diagnostics_cb,
+                                           populate_change_run_cb,
                                            &state);
-
-  if (self->change_monitor != NULL)
-    ide_buffer_change_monitor_foreach_change (self->change_monitor,
-                                              state.begin_line,
-                                              state.end_line,
-                                              populate_changes_cb,
-                                              &state);
 }
 
 static inline int
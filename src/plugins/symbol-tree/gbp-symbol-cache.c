@@ -0,0 +1,336 @@
+/* gbp-symbol-cache.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "gbp-symbol-cache"
+
+#include "config.h"
+
+#include "gbp-symbol-cache.h"
+#include "gbp-symbol-list-model.h"
+#include "gbp-symbol-proxy-node.h"
+
+#define NO_PARENT G_MAXUINT
+
+typedef struct
+{
+  guint               begin_line;
+  guint               begin_line_offset;
+  guint               end_line;
+  guint               end_line_offset;
+  guint               parent;
+  GbpSymbolProxyNode *node;
+} Scope;
+
+struct _GbpSymbolCache
+{
+  GObject             parent_instance;
+
+  /* Stable model shown in the popover, updated in place */
+  GbpSymbolListModel *model;
+
+  /* Scopes sorted by their beginning with the index of the innermost
+   * scope containing them, so lookups only walk up the nesting.
+   */
+  GArray             *scopes;
+
+  guint               change_count;
+  guint               has_tree : 1;
+  guint               has_ranges : 1;
+};
+
+G_DEFINE_FINAL_TYPE (GbpSymbolCache, gbp_symbol_cache, G_TYPE_OBJECT)
+
+static inline int
+compare_position (guint line_a,
+                  guint offset_a,
+                  guint line_b,
+                  guint offset_b)
+{
+  if (line_a < line_b)
+    return -1;
+  else if (line_a > line_b)
+    return 1;
+  else if (offset_a < offset_b)
+    return -1;
+  else if (offset_a > offset_b)
+    return 1;
+  else
+    return 0;
+}
+
+static inline gboolean
+scope_contains (const Scope *scope,
+                guint        line,
+                guint        line_offset)
+{
+  return compare_position (scope->begin_line, scope->begin_line_offset, line, line_offset) <= 0 &&
+         compare_position (line, line_offset, scope->end_line, scope->end_line_offset) <= 0;
+}
+
+static int
+scope_compare (gconstpointer a,
+               gconstpointer b)
+{
+  const Scope *scope_a = a;
+  const Scope *scope_b = b;
+  int ret;
+
+  /* Outer scopes sort before the scopes they contain */
+  if (!(ret = compare_position (scope_a->begin_line, scope_a->begin_line_offset,
+                                scope_b->begin_line, scope_b->begin_line_offset)))
+    ret = compare_position (scope_b->end_line, scope_b->end_line_offset,
+                            scope_a->end_line, scope_a->end_line_offset);
+
+  return ret;
+}
+
+static void
+gbp_symbol_cache_collect (GbpSymbolCache *self,
+                          GListModel     *model)
+{
+  guint n_items;
+
+  g_assert (GBP_IS_SYMBOL_CACHE (self));
+  g_assert (G_IS_LIST_MODEL (model));
+
+  n_items = g_list_model_get_n_items (model);
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autoptr(GbpSymbolProxyNode) node = g_list_model_get_item (model, i);
+      Scope scope = {0};
+
+      if (ide_symbol_node_get_range (IDE_SYMBOL_NODE (node),
+                                     &scope.begin_line, &scope.begin_line_offset,
+                                     &scope.end_line, &scope.end_line_offset))
+        {
+          /* Weak, the model owns the nodes and outlives the index */
+          scope.node = node;
+          scope.parent = NO_PARENT;
+          g_array_append_val (self->scopes, scope);
+        }
+
+      gbp_symbol_cache_collect (self, G_LIST_MODEL (gbp_symbol_proxy_node_get_children (node)));
+    }
+}
+
+static void
+gbp_symbol_cache_rebuild_index (GbpSymbolCache *self)
+{
+  g_autoptr(GArray) stack = NULL;
+
+  g_assert (GBP_IS_SYMBOL_CACHE (self));
+
+  g_array_set_size (self->scopes, 0);
+  gbp_symbol_cache_collect (self, G_LIST_MODEL (self->model));
+  g_array_sort (self->scopes, scope_compare);
+
+  self->has_ranges = self->scopes->len > 0;
+
+  /* Resolve the innermost enclosing scope of each scope in one pass */
+  stack = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (guint i = 0; i < self->scopes->len; i++)
+    {
+      Scope *scope = &g_array_index (self->scopes, Scope, i);
+
+      while (stack->len > 0)
+        {
+          guint top = g_array_index (stack, guint, stack->len - 1);
+          const Scope *outer = &g_array_index (self->scopes, Scope, top);
+
+          if (scope_contains (outer, scope->begin_line, scope->begin_line_offset))
+            {
+              scope->parent = top;
+              break;
+            }
+
+          g_array_set_size (stack, stack->len - 1);
+        }
+
+      g_array_append_val (stack, i);
+    }
+}
+
+static void
+gbp_symbol_cache_finalize (GObject *object)
+{
+  GbpSymbolCache *self = (GbpSymbolCache *)object;
+
+  g_clear_pointer (&self->scopes, g_array_unref);
+  g_clear_object (&self->model);
+
+  G_OBJECT_CLASS (gbp_symbol_cache_parent_class)->finalize (object);
+}
+
+static void
+gbp_symbol_cache_class_init (GbpSymbolCacheClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gbp_symbol_cache_finalize;
+}
+
+static void
+gbp_symbol_cache_init (GbpSymbolCache *self)
+{
+  self->model = gbp_symbol_list_model_new ();
+  self->scopes = g_array_new (FALSE, FALSE, sizeof (Scope));
+}
+
+/**
+ * gbp_symbol_cache_from_buffer:
+ * @buffer: an #IdeBuffer
+ *
+ * Gets the symbol cache for @buffer, creating it if necessary. The cache
+ * lives as long as the buffer so switching between pages does not need
+ * to query the symbol resolvers again.
+ *
+ * Returns: (transfer none): a #GbpSymbolCache
+ */
+GbpSymbolCache *
+gbp_symbol_cache_from_buffer (IdeBuffer *buffer)
+{
+  GbpSymbolCache *self;
+
+  g_return_val_if_fail (IDE_IS_MAIN_THREAD (), NULL);
+  g_return_val_if_fail (IDE_IS_BUFFER (buffer), NULL);
+
+  if (!(self = g_object_get_data (G_OBJECT (buffer), "GBP_SYMBOL_CACHE")))
+    {
+      self = g_object_new (GBP_TYPE_SYMBOL_CACHE, NULL);
+      g_object_set_data_full (G_OBJECT (buffer), "GBP_SYMBOL_CACHE", self, g_object_unref);
+    }
+
+  return self;
+}
+
+GListModel *
+gbp_symbol_cache_get_model (GbpSymbolCache *self)
+{
+  g_return_val_if_fail (GBP_IS_SYMBOL_CACHE (self), NULL);
+
+  return G_LIST_MODEL (self->model);
+}
+
+/**
+ * gbp_symbol_cache_is_current:
+ * @self: a #GbpSymbolCache
+ * @buffer: the #IdeBuffer for @self
+ *
+ * Checks if the cached symbols were resolved for the current contents of
+ * @buffer.
+ */
+gboolean
+gbp_symbol_cache_is_current (GbpSymbolCache *self,
+                             IdeBuffer      *buffer)
+{
+  g_return_val_if_fail (GBP_IS_SYMBOL_CACHE (self), FALSE);
+  g_return_val_if_fail (IDE_IS_BUFFER (buffer), FALSE);
+
+  return self->has_tree && self->change_count == ide_buffer_get_change_count (buffer);
+}
+
+/**
+ * gbp_symbol_cache_update:
+ * @self: a #GbpSymbolCache
+ * @tree: (nullable): the new #IdeSymbolTree
+ * @change_count: the change count of the buffer when @tree was requested
+ *
+ * Merges @tree into the cached model, emitting changes only for the
+ * symbols which changed.
+ */
+void
+gbp_symbol_cache_update (GbpSymbolCache *self,
+                         IdeSymbolTree  *tree,
+                         guint           change_count)
+{
+  g_return_if_fail (GBP_IS_SYMBOL_CACHE (self));
+  g_return_if_fail (!tree || IDE_IS_SYMBOL_TREE (tree));
+
+  gbp_symbol_list_model_update (self->model, tree, NULL);
+  gbp_symbol_cache_rebuild_index (self);
+
+  self->change_count = change_count;
+  self->has_tree = tree != NULL;
+}
+
+/**
+ * gbp_symbol_cache_find_nearest_scope:
+ * @self: a #GbpSymbolCache
+ * @line: the line of the cursor
+ * @line_offset: the offset within @line
+ * @has_ranges: (out): location to store if the symbols have ranges
+ *
+ * Finds the innermost symbol containing @line and @line_offset.
+ *
+ * If the symbols provided by the resolver do not have ranges, @has_ranges
+ * is set to %FALSE and the resolver must be queried instead.
+ *
+ * Returns: (transfer none) (nullable): an #IdeSymbolNode or %NULL
+ */
+IdeSymbolNode *
+gbp_symbol_cache_find_nearest_scope (GbpSymbolCache *self,
+                                     guint           line,
+                                     guint           line_offset,
+                                     gboolean       *has_ranges)
+{
+  guint lo = 0;
+  guint hi;
+  guint pos;
+
+  g_return_val_if_fail (GBP_IS_SYMBOL_CACHE (self), NULL);
+  g_return_val_if_fail (has_ranges != NULL, NULL);
+
+  *has_ranges = self->has_ranges;
+
+  if (self->scopes->len == 0)
+    return NULL;
+
+  /* Find the last scope beginning at or before the position */
+  hi = self->scopes->len;
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+      const Scope *scope = &g_array_index (self->scopes, Scope, mid);
+
+      if (compare_position (scope->begin_line, scope->begin_line_offset, line, line_offset) <= 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  if (lo == 0)
+    return NULL;
+
+  pos = lo - 1;
+
+  while (pos != NO_PARENT)
+    {
+      const Scope *scope = &g_array_index (self->scopes, Scope, pos);
+
+      if (scope_contains (scope, line, line_offset))
+        return IDE_SYMBOL_NODE (scope->node);
+
+      pos = scope->parent;
+    }
+
+  return NULL;
+}
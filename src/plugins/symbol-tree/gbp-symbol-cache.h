@@ -0,0 +1,43 @@
+/* gbp-symbol-cache.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <libide-code.h>
+
+G_BEGIN_DECLS
+
+#define GBP_TYPE_SYMBOL_CACHE (gbp_symbol_cache_get_type())
+
+G_DECLARE_FINAL_TYPE (GbpSymbolCache, gbp_symbol_cache, GBP, SYMBOL_CACHE, GObject)
+
+GbpSymbolCache *gbp_symbol_cache_from_buffer        (IdeBuffer      *buffer);
+GListModel     *gbp_symbol_cache_get_model          (GbpSymbolCache *self);
+gboolean        gbp_symbol_cache_is_current         (GbpSymbolCache *self,
+                                                     IdeBuffer      *buffer);
+void            gbp_symbol_cache_update             (GbpSymbolCache *self,
+                                                     IdeSymbolTree  *tree,
+                                                     guint           change_count);
+IdeSymbolNode  *gbp_symbol_cache_find_nearest_scope (GbpSymbolCache *self,
+                                                     guint           line,
+                                                     guint           line_offset,
+                                                     gboolean       *has_ranges);
+
+G_END_DECLS
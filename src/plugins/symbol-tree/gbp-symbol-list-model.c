@@ -23,19 +23,12 @@
 #include "config.h"
 
 #include "gbp-symbol-list-model.h"
+#include "gbp-symbol-proxy-node.h"
 
 struct _GbpSymbolListModel
 {
-  GObject        parent_instance;
-  IdeSymbolTree *tree;
-  IdeSymbolNode *parent;
-};
-
-enum {
-  PROP_0,
-  PROP_TREE,
-  PROP_PARENT,
-  N_PROPS
+  GObject    parent_instance;
+  GPtrArray *items;
 };
 
 static GType
@@ -49,7 +42,7 @@ gbp_symbol_list_model_get_n_items (GListModel *model)
 {
   GbpSymbolListModel *self = GBP_SYMBOL_LIST_MODEL (model);
 
-  return ide_symbol_tree_get_n_children (self->tree, self->parent);
+  return self->items->len;
 }
 
 static gpointer
@@ -58,10 +51,10 @@ gbp_symbol_list_model_get_item (GListModel *model,
 {
   GbpSymbolListModel *self = GBP_SYMBOL_LIST_MODEL (model);
 
-  if (position >= ide_symbol_tree_get_n_children (self->tree, self->parent))
+  if (position >= self->items->len)
     return NULL;
 
-  return ide_symbol_tree_get_nth_child (self->tree, self->parent, position);
+  return g_object_ref (g_ptr_array_index (self->items, position));
 }
 
 static void
@@ -75,63 +68,25 @@ list_model_iface_init (GListModelInterface *iface)
 G_DEFINE_TYPE_WITH_CODE (GbpSymbolListModel, gbp_symbol_list_model, G_TYPE_OBJECT,
                          G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, list_model_iface_init))
 
-static GParamSpec *properties [N_PROPS];
-
 static void
 gbp_symbol_list_model_dispose (GObject *object)
 {
   GbpSymbolListModel *self = (GbpSymbolListModel *)object;
 
-  g_clear_object (&self->tree);
-  g_clear_object (&self->parent);
+  if (self->items->len > 0)
+    g_ptr_array_remove_range (self->items, 0, self->items->len);
 
   G_OBJECT_CLASS (gbp_symbol_list_model_parent_class)->dispose (object);
 }
 
 static void
-gbp_symbol_list_model_get_property (GObject    *object,
-                                    guint       prop_id,
-                                    GValue     *value,
-                                    GParamSpec *pspec)
-{
-  GbpSymbolListModel *self = GBP_SYMBOL_LIST_MODEL (object);
-
-  switch (prop_id)
-    {
-    case PROP_TREE:
-      g_value_set_object (value, self->tree);
-      break;
-
-    case PROP_PARENT:
-      g_value_set_object (value, self->parent);
-      break;
-
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-    }
-}
-
-static void
-gbp_symbol_list_model_set_property (GObject      *object,
-                                    guint         prop_id,
-                                    const GValue *value,
-                                    GParamSpec   *pspec)
+gbp_symbol_list_model_finalize (GObject *object)
 {
-  GbpSymbolListModel *self = GBP_SYMBOL_LIST_MODEL (object);
-
-  switch (prop_id)
-    {
-    case PROP_TREE:
-      self->tree = g_value_dup_object (value);
-      break;
+  GbpSymbolListModel *self = (GbpSymbolListModel *)object;
 
-    case PROP_PARENT:
-      self->parent = g_value_dup_object (value);
-      break;
+  g_clear_pointer (&self->items, g_ptr_array_unref);
 
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-    }
+  G_OBJECT_CLASS (gbp_symbol_list_model_parent_class)->finalize (object);
 }
 
 static void
@@ -140,45 +95,96 @@ gbp_symbol_list_model_class_init (GbpSymbolListModelClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->dispose = gbp_symbol_list_model_dispose;
-  object_class->get_property = gbp_symbol_list_model_get_property;
-  object_class->set_property = gbp_symbol_list_model_set_property;
-
-  properties [PROP_TREE] =
-    g_param_spec_object ("tree",
-                         "Tree",
-                         "The tree of nodes",
-                         IDE_TYPE_SYMBOL_TREE,
-                         (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
-
-  properties [PROP_PARENT] =
-    g_param_spec_object ("parent",
-                         "Parent",
-                         "The parent node",
-                         IDE_TYPE_SYMBOL_NODE,
-                         (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
-
-  g_object_class_install_properties (object_class, N_PROPS, properties);
+  object_class->finalize = gbp_symbol_list_model_finalize;
 }
 
 static void
 gbp_symbol_list_model_init (GbpSymbolListModel *self)
 {
+  self->items = g_ptr_array_new_with_free_func (g_object_unref);
 }
 
-IdeSymbolTree *
-gbp_symbol_list_model_get_tree (GbpSymbolListModel *self)
+GbpSymbolListModel *
+gbp_symbol_list_model_new (void)
 {
-  g_return_val_if_fail (GBP_IS_SYMBOL_LIST_MODEL (self), NULL);
-
-  return self->tree;
+  return g_object_new (GBP_TYPE_SYMBOL_LIST_MODEL, NULL);
 }
 
-GbpSymbolListModel *
-gbp_symbol_list_model_new (IdeSymbolTree *tree,
-                           IdeSymbolNode *parent)
+/**
+ * gbp_symbol_list_model_update:
+ * @self: a #GbpSymbolListModel
+ * @tree: (nullable): an #IdeSymbolTree or %NULL to clear
+ * @parent: (nullable): the parent node within @tree or %NULL for the root
+ *
+ * Updates @self to contain the children of @parent in @tree.
+ *
+ * Symbols which are still present at the start and end of the list keep
+ * their proxy node and only their children are updated, recursively. The
+ * symbols in-between are replaced with a single #GListModel::items-changed
+ * so that editing one function does not reset the rest of the popover.
+ */
+void
+gbp_symbol_list_model_update (GbpSymbolListModel *self,
+                              IdeSymbolTree      *tree,
+                              IdeSymbolNode      *parent)
 {
-  return g_object_new (GBP_TYPE_SYMBOL_LIST_MODEL,
-                       "tree", tree,
-                       "parent", parent,
-                       NULL);
+  g_autoptr(GPtrArray) nodes = NULL;
+  guint n_old;
+  guint n_new;
+  guint prefix = 0;
+  guint suffix = 0;
+  guint removed;
+  guint added;
+
+  g_return_if_fail (GBP_IS_SYMBOL_LIST_MODEL (self));
+  g_return_if_fail (!tree || IDE_IS_SYMBOL_TREE (tree));
+  g_return_if_fail (!parent || IDE_IS_SYMBOL_NODE (parent));
+
+  n_old = self->items->len;
+  n_new = tree ? ide_symbol_tree_get_n_children (tree, parent) : 0;
+
+  nodes = g_ptr_array_new_full (n_new, g_object_unref);
+  for (guint i = 0; i < n_new; i++)
+    g_ptr_array_add (nodes, ide_symbol_tree_get_nth_child (tree, parent, i));
+
+  while (prefix < n_old &&
+         prefix < n_new &&
+         gbp_symbol_proxy_node_matches (g_ptr_array_index (self->items, prefix),
+                                        tree,
+                                        g_ptr_array_index (nodes, prefix)))
+    prefix++;
+
+  while (suffix < n_old - prefix &&
+         suffix < n_new - prefix &&
+         gbp_symbol_proxy_node_matches (g_ptr_array_index (self->items, n_old - suffix - 1),
+                                        tree,
+                                        g_ptr_array_index (nodes, n_new - suffix - 1)))
+    suffix++;
+
+  /* Matched symbols may still have moved or have changed children */
+  for (guint i = 0; i < prefix; i++)
+    gbp_symbol_proxy_node_update (g_ptr_array_index (self->items, i),
+                                  tree,
+                                  g_ptr_array_index (nodes, i));
+
+  for (guint i = 0; i < suffix; i++)
+    gbp_symbol_proxy_node_update (g_ptr_array_index (self->items, n_old - suffix + i),
+                                  tree,
+                                  g_ptr_array_index (nodes, n_new - suffix + i));
+
+  removed = n_old - prefix - suffix;
+  added = n_new - prefix - suffix;
+
+  if (removed == 0 && added == 0)
+    return;
+
+  if (removed > 0)
+    g_ptr_array_remove_range (self->items, prefix, removed);
+
+  for (guint i = 0; i < added; i++)
+    g_ptr_array_insert (self->items,
+                        prefix + i,
+                        gbp_symbol_proxy_node_new (tree, g_ptr_array_index (nodes, prefix + i)));
+
+  g_list_model_items_changed (G_LIST_MODEL (self), prefix, removed, added);
 }
@@ -28,8 +28,9 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (GbpSymbolListModel, gbp_symbol_list_model, GBP, SYMBOL_LIST_MODEL, GObject)
 
-GbpSymbolListModel *gbp_symbol_list_model_new      (IdeSymbolTree      *tree,
-                                                    IdeSymbolNode      *parent);
-IdeSymbolTree      *gbp_symbol_list_model_get_tree (GbpSymbolListModel *self);
+GbpSymbolListModel *gbp_symbol_list_model_new    (void);
+void                gbp_symbol_list_model_update (GbpSymbolListModel *self,
+                                                  IdeSymbolTree      *tree,
+                                                  IdeSymbolNode      *parent);
 
 G_END_DECLS
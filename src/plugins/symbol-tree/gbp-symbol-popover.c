@@ -27,12 +27,13 @@
 
 #include "gbp-symbol-list-model.h"
 #include "gbp-symbol-popover.h"
+#include "gbp-symbol-proxy-node.h"
 
 struct _GbpSymbolPopover
 {
   GtkPopover       parent_instance;
 
-  IdeSymbolTree   *symbol_tree;
+  GListModel      *symbols;
   GtkFilter       *filter;
 
   GtkSearchEntry  *search_entry;
@@ -43,7 +44,7 @@ struct _GbpSymbolPopover
 
 enum {
   PROP_0,
-  PROP_SYMBOL_TREE,
+  PROP_SYMBOLS,
   N_PROPS
 };
 
@@ -208,7 +209,7 @@ gbp_symbol_popover_dispose (GObject *object)
   GbpSymbolPopover *self = (GbpSymbolPopover *)object;
 
   g_clear_object (&self->filter);
-  g_clear_object (&self->symbol_tree);
+  g_clear_object (&self->symbols);
   g_clear_pointer (&self->search_needle, ide_pattern_spec_unref);
 
   G_OBJECT_CLASS (gbp_symbol_popover_parent_class)->dispose (object);
@@ -224,8 +225,8 @@ gbp_symbol_popover_get_property (GObject    *object,
 
   switch (prop_id)
     {
-    case PROP_SYMBOL_TREE:
-      g_value_set_object (value, gbp_symbol_popover_get_symbol_tree (self));
+    case PROP_SYMBOLS:
+      g_value_set_object (value, gbp_symbol_popover_get_symbols (self));
       break;
 
     default:
@@ -243,8 +244,8 @@ gbp_symbol_popover_set_property (GObject      *object,
 
   switch (prop_id)
     {
-    case PROP_SYMBOL_TREE:
-      gbp_symbol_popover_set_symbol_tree (self, g_value_get_object (value));
+    case PROP_SYMBOLS:
+      gbp_symbol_popover_set_symbols (self, g_value_get_object (value));
       break;
 
     default:
@@ -264,11 +265,11 @@ gbp_symbol_popover_class_init (GbpSymbolPopoverClass *klass)
 
   widget_class->grab_focus = gbp_symbol_popover_grab_focus;
 
-  properties [PROP_SYMBOL_TREE] =
-    g_param_spec_object ("symbol-tree",
-                         "Symbol Tree",
-                         "The symbol tree to display",
-                         IDE_TYPE_SYMBOL_TREE,
+  properties [PROP_SYMBOLS] =
+    g_param_spec_object ("symbols",
+                         "Symbols",
+                         "The toplevel symbols to display",
+                         G_TYPE_LIST_MODEL,
                          (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   g_object_class_install_properties (object_class, N_PROPS, properties);
@@ -294,30 +295,29 @@ gbp_symbol_popover_new (void)
   return g_object_new (GBP_TYPE_SYMBOL_POPOVER, NULL);
 }
 
-IdeSymbolTree *
-gbp_symbol_popover_get_symbol_tree (GbpSymbolPopover *self)
+GListModel *
+gbp_symbol_popover_get_symbols (GbpSymbolPopover *self)
 {
   g_return_val_if_fail (GBP_IS_SYMBOL_POPOVER (self), NULL);
-  g_return_val_if_fail (!self->symbol_tree ||
-                        IDE_IS_SYMBOL_TREE (self->symbol_tree), NULL);
 
-  return self->symbol_tree;
+  return self->symbols;
 }
 
 static GListModel *
 get_child_model (gpointer item,
                  gpointer user_data)
 {
-  IdeSymbolNode *node = item;
-  IdeSymbolTree *tree = user_data;
+  GbpSymbolProxyNode *node = item;
+  GbpSymbolListModel *children;
 
-  g_assert (IDE_IS_SYMBOL_NODE (node));
-  g_assert (IDE_IS_SYMBOL_TREE (tree));
+  g_assert (GBP_IS_SYMBOL_PROXY_NODE (node));
+
+  children = gbp_symbol_proxy_node_get_children (node);
 
-  if (ide_symbol_tree_get_n_children (tree, node) == 0)
+  if (g_list_model_get_n_items (G_LIST_MODEL (children)) == 0)
     return NULL;
 
-  return G_LIST_MODEL (gbp_symbol_list_model_new (tree, node));
+  return g_object_ref (G_LIST_MODEL (children));
 }
 
 static gboolean
@@ -388,32 +388,40 @@ filter_by_name (gpointer item,
   return FALSE;
 }
 
+/**
+ * gbp_symbol_popover_set_symbols:
+ * @self: a #GbpSymbolPopover
+ * @symbols: (nullable): a #GListModel of #GbpSymbolProxyNode
+ *
+ * Sets the toplevel symbols to display.
+ *
+ * The model is expected to be updated in place as the buffer changes so
+ * that expanded rows stay expanded.
+ */
 void
-gbp_symbol_popover_set_symbol_tree (GbpSymbolPopover *self,
-                                    IdeSymbolTree    *symbol_tree)
+gbp_symbol_popover_set_symbols (GbpSymbolPopover *self,
+                                GListModel       *symbols)
 {
   g_return_if_fail (GBP_IS_SYMBOL_POPOVER (self));
-  g_return_if_fail (!symbol_tree || IDE_IS_SYMBOL_TREE (symbol_tree));
+  g_return_if_fail (!symbols || G_IS_LIST_MODEL (symbols));
 
-  if (g_set_object (&self->symbol_tree, symbol_tree))
+  if (g_set_object (&self->symbols, symbols))
     {
       gtk_list_view_set_model (self->list_view, NULL);
 
-      if (symbol_tree != NULL)
+      if (symbols != NULL)
         {
-          GbpSymbolListModel *model;
           GtkTreeListModel *tree_model;
           GtkFilterListModel *filter_model;
           GtkSingleSelection *selection;
           GtkFilter *filter;
 
-          model = gbp_symbol_list_model_new (symbol_tree, NULL);
-          tree_model = gtk_tree_list_model_new (G_LIST_MODEL (model),
+          tree_model = gtk_tree_list_model_new (g_object_ref (symbols),
                                                 FALSE,
                                                 TRUE,
                                                 get_child_model,
-                                                g_object_ref (symbol_tree),
-                                                g_object_unref);
+                                                NULL,
+                                                NULL);
 
           filter_model = gtk_filter_list_model_new (G_LIST_MODEL (tree_model), NULL);
           filter = GTK_FILTER (gtk_custom_filter_new (filter_by_name, self, NULL));
@@ -426,7 +434,7 @@ gbp_symbol_popover_set_symbol_tree (GbpSymbolPopover *self,
           g_object_unref (selection);
         }
 
-      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_SYMBOL_TREE]);
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_SYMBOLS]);
     }
 }
 
@@ -30,10 +30,10 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (GbpSymbolPopover, gbp_symbol_popover, GBP, SYMBOL_POPOVER, GtkPopover)
 
-GtkWidget     *gbp_symbol_popover_new             (void);
-IdeSymbolTree *gbp_symbol_popover_get_symbol_tree (GbpSymbolPopover *self);
-void           gbp_symbol_popover_set_symbol_tree (GbpSymbolPopover *self,
-                                                   IdeSymbolTree    *symbol_tree);
-GListModel    *gbp_symbol_popover_get_model       (GbpSymbolPopover *self);
+GtkWidget  *gbp_symbol_popover_new         (void);
+GListModel *gbp_symbol_popover_get_symbols (GbpSymbolPopover *self);
+void        gbp_symbol_popover_set_symbols (GbpSymbolPopover *self,
+                                            GListModel       *symbols);
+GListModel *gbp_symbol_popover_get_model   (GbpSymbolPopover *self);
 
 G_END_DECLS
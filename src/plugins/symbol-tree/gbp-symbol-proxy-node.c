@@ -0,0 +1,259 @@
+/* gbp-symbol-proxy-node.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "gbp-symbol-proxy-node"
+
+#include "config.h"
+
+#include <libide-threading.h>
+
+#include "gbp-symbol-proxy-node.h"
+
+/* A proxy node stays alive across symbol tree updates so that rows in the
+ * popover keep their expansion state. The node it wraps is replaced with
+ * the node from the newest tree whenever the symbol is still there.
+ */
+
+struct _GbpSymbolProxyNode
+{
+  IdeSymbolNode       parent_instance;
+  IdeSymbolNode      *node;
+  GbpSymbolListModel *children;
+};
+
+G_DEFINE_FINAL_TYPE (GbpSymbolProxyNode, gbp_symbol_proxy_node, IDE_TYPE_SYMBOL_NODE)
+
+static void
+gbp_symbol_proxy_node_get_location_cb (GObject      *object,
+                                       GAsyncResult *result,
+                                       gpointer      user_data)
+{
+  IdeSymbolNode *node = (IdeSymbolNode *)object;
+  g_autoptr(IdeLocation) location = NULL;
+  g_autoptr(IdeTask) task = user_data;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_SYMBOL_NODE (node));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (IDE_IS_TASK (task));
+
+  if (!(location = ide_symbol_node_get_location_finish (node, result, &error)))
+    ide_task_return_error (task, g_steal_pointer (&error));
+  else
+    ide_task_return_pointer (task, g_steal_pointer (&location), g_object_unref);
+}
+
+static void
+gbp_symbol_proxy_node_get_location_async (IdeSymbolNode       *node,
+                                          GCancellable        *cancellable,
+                                          GAsyncReadyCallback  callback,
+                                          gpointer             user_data)
+{
+  GbpSymbolProxyNode *self = (GbpSymbolProxyNode *)node;
+  g_autoptr(IdeTask) task = NULL;
+
+  g_assert (GBP_IS_SYMBOL_PROXY_NODE (self));
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = ide_task_new (self, cancellable, callback, user_data);
+  ide_task_set_source_tag (task, gbp_symbol_proxy_node_get_location_async);
+
+  ide_symbol_node_get_location_async (self->node,
+                                      cancellable,
+                                      gbp_symbol_proxy_node_get_location_cb,
+                                      g_steal_pointer (&task));
+}
+
+static IdeLocation *
+gbp_symbol_proxy_node_get_location_finish (IdeSymbolNode  *node,
+                                           GAsyncResult   *result,
+                                           GError        **error)
+{
+  g_assert (GBP_IS_SYMBOL_PROXY_NODE (node));
+  g_assert (IDE_IS_TASK (result));
+
+  return ide_task_propagate_pointer (IDE_TASK (result), error);
+}
+
+static gboolean
+gbp_symbol_proxy_node_get_range (IdeSymbolNode *node,
+                                 guint         *begin_line,
+                                 guint         *begin_line_offset,
+                                 guint         *end_line,
+                                 guint         *end_line_offset)
+{
+  GbpSymbolProxyNode *self = (GbpSymbolProxyNode *)node;
+
+  g_assert (GBP_IS_SYMBOL_PROXY_NODE (self));
+
+  return ide_symbol_node_get_range (self->node,
+                                    begin_line, begin_line_offset,
+                                    end_line, end_line_offset);
+}
+
+static void
+gbp_symbol_proxy_node_dispose (GObject *object)
+{
+  GbpSymbolProxyNode *self = (GbpSymbolProxyNode *)object;
+
+  g_clear_object (&self->node);
+  g_clear_object (&self->children);
+
+  G_OBJECT_CLASS (gbp_symbol_proxy_node_parent_class)->dispose (object);
+}
+
+static void
+gbp_symbol_proxy_node_class_init (GbpSymbolProxyNodeClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  IdeSymbolNodeClass *symbol_node_class = IDE_SYMBOL_NODE_CLASS (klass);
+
+  object_class->dispose = gbp_symbol_proxy_node_dispose;
+
+  symbol_node_class->get_location_async = gbp_symbol_proxy_node_get_location_async;
+  symbol_node_class->get_location_finish = gbp_symbol_proxy_node_get_location_finish;
+  symbol_node_class->get_range = gbp_symbol_proxy_node_get_range;
+}
+
+static void
+gbp_symbol_proxy_node_init (GbpSymbolProxyNode *self)
+{
+  self->children = gbp_symbol_list_model_new ();
+}
+
+static void
+gbp_symbol_proxy_node_set_node (GbpSymbolProxyNode *self,
+                                IdeSymbolNode      *node)
+{
+  g_autofree char *display_name = NULL;
+  g_autofree char *old_display_name = NULL;
+  IdeSymbolFlags flags;
+  gboolean use_markup;
+
+  g_assert (GBP_IS_SYMBOL_PROXY_NODE (self));
+  g_assert (IDE_IS_SYMBOL_NODE (node));
+
+  g_set_object (&self->node, node);
+
+  g_object_freeze_notify (G_OBJECT (self));
+
+  /* Only notify for what changed so bound rows are not redrawn */
+  if (g_strcmp0 (ide_symbol_node_get_name (IDE_SYMBOL_NODE (self)), ide_symbol_node_get_name (node)) != 0)
+    g_object_set (self, "name", ide_symbol_node_get_name (node), NULL);
+
+  if (ide_symbol_node_get_kind (IDE_SYMBOL_NODE (self)) != ide_symbol_node_get_kind (node))
+    g_object_set (self, "kind", ide_symbol_node_get_kind (node), NULL);
+
+  flags = ide_symbol_node_get_flags (node);
+  if (ide_symbol_node_get_flags (IDE_SYMBOL_NODE (self)) != flags)
+    g_object_set (self, "flags", flags, NULL);
+
+  use_markup = ide_symbol_node_get_use_markup (node);
+  if (ide_symbol_node_get_use_markup (IDE_SYMBOL_NODE (self)) != use_markup)
+    g_object_set (self, "use-markup", use_markup, NULL);
+
+  g_object_get (node, "display-name", &display_name, NULL);
+  g_object_get (self, "display-name", &old_display_name, NULL);
+  if (g_strcmp0 (display_name, old_display_name) != 0)
+    g_object_set (self, "display-name", display_name, NULL);
+
+  g_object_thaw_notify (G_OBJECT (self));
+}
+
+GbpSymbolProxyNode *
+gbp_symbol_proxy_node_new (IdeSymbolTree *tree,
+                           IdeSymbolNode *node)
+{
+  GbpSymbolProxyNode *self;
+
+  g_return_val_if_fail (IDE_IS_SYMBOL_TREE (tree), NULL);
+  g_return_val_if_fail (IDE_IS_SYMBOL_NODE (node), NULL);
+
+  self = g_object_new (GBP_TYPE_SYMBOL_PROXY_NODE, NULL);
+  gbp_symbol_proxy_node_update (self, tree, node);
+
+  return self;
+}
+
+IdeSymbolNode *
+gbp_symbol_proxy_node_get_node (GbpSymbolProxyNode *self)
+{
+  g_return_val_if_fail (GBP_IS_SYMBOL_PROXY_NODE (self), NULL);
+
+  return self->node;
+}
+
+GbpSymbolListModel *
+gbp_symbol_proxy_node_get_children (GbpSymbolProxyNode *self)
+{
+  g_return_val_if_fail (GBP_IS_SYMBOL_PROXY_NODE (self), NULL);
+
+  return self->children;
+}
+
+/**
+ * gbp_symbol_proxy_node_matches:
+ * @self: a #GbpSymbolProxyNode
+ * @tree: the tree containing @node
+ * @node: a node from a new symbol tree
+ *
+ * Checks if @node is the same symbol as the one proxied by @self.
+ *
+ * Symbols are matched by kind and name rather than by range, otherwise
+ * every symbol below an inserted line would be considered new. Whether
+ * the symbol has children is part of the identity because rows cannot
+ * become expandable after they are created.
+ *
+ * Returns: %TRUE if @self can be updated to proxy @node
+ */
+gboolean
+gbp_symbol_proxy_node_matches (GbpSymbolProxyNode *self,
+                               IdeSymbolTree      *tree,
+                               IdeSymbolNode      *node)
+{
+  gboolean had_children;
+  gboolean has_children;
+
+  g_return_val_if_fail (GBP_IS_SYMBOL_PROXY_NODE (self), FALSE);
+  g_return_val_if_fail (IDE_IS_SYMBOL_TREE (tree), FALSE);
+  g_return_val_if_fail (IDE_IS_SYMBOL_NODE (node), FALSE);
+
+  if (ide_symbol_node_get_kind (self->node) != ide_symbol_node_get_kind (node) ||
+      g_strcmp0 (ide_symbol_node_get_name (self->node), ide_symbol_node_get_name (node)) != 0)
+    return FALSE;
+
+  had_children = g_list_model_get_n_items (G_LIST_MODEL (self->children)) > 0;
+  has_children = ide_symbol_tree_get_n_children (tree, node) > 0;
+
+  return had_children == has_children;
+}
+
+void
+gbp_symbol_proxy_node_update (GbpSymbolProxyNode *self,
+                              IdeSymbolTree      *tree,
+                              IdeSymbolNode      *node)
+{
+  g_return_if_fail (GBP_IS_SYMBOL_PROXY_NODE (self));
+  g_return_if_fail (IDE_IS_SYMBOL_TREE (tree));
+  g_return_if_fail (IDE_IS_SYMBOL_NODE (node));
+
+  gbp_symbol_proxy_node_set_node (self, node);
+  gbp_symbol_list_model_update (self->children, tree, node);
+}
@@ -0,0 +1,44 @@
+/* gbp-symbol-proxy-node.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <libide-code.h>
+
+#include "gbp-symbol-list-model.h"
+
+G_BEGIN_DECLS
+
+#define GBP_TYPE_SYMBOL_PROXY_NODE (gbp_symbol_proxy_node_get_type())
+
+G_DECLARE_FINAL_TYPE (GbpSymbolProxyNode, gbp_symbol_proxy_node, GBP, SYMBOL_PROXY_NODE, IdeSymbolNode)
+
+GbpSymbolProxyNode *gbp_symbol_proxy_node_new          (IdeSymbolTree      *tree,
+                                                        IdeSymbolNode      *node);
+IdeSymbolNode      *gbp_symbol_proxy_node_get_node     (GbpSymbolProxyNode *self);
+GbpSymbolListModel *gbp_symbol_proxy_node_get_children (GbpSymbolProxyNode *self);
+gboolean            gbp_symbol_proxy_node_matches      (GbpSymbolProxyNode *self,
+                                                        IdeSymbolTree      *tree,
+                                                        IdeSymbolNode      *node);
+void                gbp_symbol_proxy_node_update       (GbpSymbolProxyNode *self,
+                                                        IdeSymbolTree      *tree,
+                                                        IdeSymbolNode      *node);
+
+G_END_DECLS
@@ -28,6 +28,7 @@
 #include <libide-editor.h>
 #include <libide-gui.h>
 
+#include "gbp-symbol-cache.h"
 #include "gbp-symbol-popover.h"
 #include "gbp-symbol-workspace-addin.h"
 #include "gbp-symbol-util.h"
@@ -72,27 +73,22 @@ IDE_DEFINE_ACTION_GROUP (GbpSymbolWorkspaceAddin, gbp_symbol_workspace_addin, {
 });
 
 static void
-gbp_symbol_workspace_addin_set_symbol (GbpSymbolWorkspaceAddin *self,
-                                       IdeSymbol               *symbol)
+gbp_symbol_workspace_addin_set_label (GbpSymbolWorkspaceAddin *self,
+                                      IdeSymbolKind            kind,
+                                      const char              *label)
 {
   g_autofree char *truncated = NULL;
-  const char *label = NULL;
   const char *icon_name = NULL;
   const char *nl;
 
   IDE_ENTRY;
 
   g_assert (GBP_IS_SYMBOL_WORKSPACE_ADDIN (self));
-  g_assert (!symbol || IDE_IS_SYMBOL (symbol));
 
-  if (symbol != NULL)
-    {
-      icon_name = ide_symbol_kind_get_icon_name (ide_symbol_get_kind (symbol));
-      label = ide_symbol_get_name (symbol);
-
-      if (ide_str_empty0 (label))
-        label = NULL;
-    }
+  if (ide_str_empty0 (label))
+    label = NULL;
+  else
+    icon_name = ide_symbol_kind_get_icon_name (kind);
 
   if (label == NULL)
     {
@@ -112,6 +108,65 @@ gbp_symbol_workspace_addin_set_symbol (GbpSymbolWorkspaceAddin *self,
   IDE_EXIT;
 }
 
+static void
+gbp_symbol_workspace_addin_set_symbol (GbpSymbolWorkspaceAddin *self,
+                                       IdeSymbol               *symbol)
+{
+  g_assert (GBP_IS_SYMBOL_WORKSPACE_ADDIN (self));
+  g_assert (!symbol || IDE_IS_SYMBOL (symbol));
+
+  if (symbol == NULL)
+    gbp_symbol_workspace_addin_set_label (self, IDE_SYMBOL_KIND_NONE, NULL);
+  else
+    gbp_symbol_workspace_addin_set_label (self,
+                                          ide_symbol_get_kind (symbol),
+                                          ide_symbol_get_name (symbol));
+}
+
+static gboolean
+gbp_symbol_workspace_addin_update_nearest_scope_from_cache (GbpSymbolWorkspaceAddin *self,
+                                                            IdeBuffer               *buffer)
+{
+  GbpSymbolCache *cache;
+  IdeSymbolNode *node;
+  GtkTextIter iter;
+  gboolean has_ranges = FALSE;
+
+  g_assert (GBP_IS_SYMBOL_WORKSPACE_ADDIN (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  cache = gbp_symbol_cache_from_buffer (buffer);
+
+  /* Only trust the index if it describes the buffer as it is now,
+   * otherwise the resolver has to be asked about the new contents.
+   */
+  if (!gbp_symbol_cache_is_current (cache, buffer))
+    return FALSE;
+
+  gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (buffer),
+                                    &iter,
+                                    gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (buffer)));
+
+  node = gbp_symbol_cache_find_nearest_scope (cache,
+                                              gtk_text_iter_get_line (&iter),
+                                              gtk_text_iter_get_line_offset (&iter),
+                                              &has_ranges);
+
+  if (!has_ranges)
+    return FALSE;
+
+  if (node == NULL)
+    gbp_symbol_workspace_addin_set_label (self, IDE_SYMBOL_KIND_NONE, NULL);
+  else
+    gbp_symbol_workspace_addin_set_label (self,
+                                          ide_symbol_node_get_kind (node),
+                                          ide_symbol_node_get_name (node));
+
+  gtk_widget_show (GTK_WIDGET (self->menu_button));
+
+  return TRUE;
+}
+
 static void
 gbp_symbol_workspace_addin_find_nearest_scope_cb (GObject      *object,
                                                   GAsyncResult *result,
@@ -155,21 +210,41 @@ failure:
   IDE_EXIT;
 }
 
+typedef struct
+{
+  GbpSymbolWorkspaceAddin *self;
+  guint                    change_count;
+} GetSymbolTree;
+
+static void
+get_symbol_tree_free (GetSymbolTree *state)
+{
+  g_clear_object (&state->self);
+  g_slice_free (GetSymbolTree, state);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GetSymbolTree, get_symbol_tree_free)
+
 static void
 gbp_symbol_workspace_addin_get_symbol_tree_cb (GObject      *object,
                                                GAsyncResult *result,
                                                gpointer      user_data)
 {
   IdeBuffer *buffer = (IdeBuffer *)object;
-  g_autoptr(GbpSymbolWorkspaceAddin) self = user_data;
+  g_autoptr(GetSymbolTree) state = user_data;
   g_autoptr(IdeSymbolTree) tree = NULL;
   g_autoptr(GError) error = NULL;
+  GbpSymbolWorkspaceAddin *self;
+  GbpSymbolCache *cache;
 
   IDE_ENTRY;
 
   g_assert (IDE_IS_BUFFER (buffer));
   g_assert (G_IS_ASYNC_RESULT (result));
-  g_assert (GBP_IS_SYMBOL_WORKSPACE_ADDIN (self));
+  g_assert (state != NULL);
+  g_assert (GBP_IS_SYMBOL_WORKSPACE_ADDIN (state->self));
+
+  self = state->self;
 
   if (!(tree = gbp_symbol_get_symbol_tree_finish (buffer, result, &error)))
     {
@@ -178,10 +253,19 @@ gbp_symbol_workspace_addin_get_symbol_tree_cb (GObject      *object,
       IDE_GOTO (failure);
     }
 
+  /* Update the cache even if the buffer is no longer focused so that
+   * switching back to it does not require another query.
+   */
+  cache = gbp_symbol_cache_from_buffer (buffer);
+  gbp_symbol_cache_update (cache, tree, state->change_count);
+
   if ((gpointer)buffer != _g_signal_group_get_target (self->buffer_signals))
-    IDE_GOTO (failure);
+    IDE_EXIT;
+
+  gbp_symbol_popover_set_symbols (self->popover, gbp_symbol_cache_get_model (cache));
 
-  gbp_symbol_popover_set_symbol_tree (self->popover, tree);
+  /* The index may now answer the scope query without the resolver */
+  gbp_symbol_workspace_addin_update_nearest_scope_from_cache (self, buffer);
 
   IDE_EXIT;
 
@@ -191,7 +275,7 @@ failure:
   if ((gpointer)buffer != _g_signal_group_get_target (self->buffer_signals))
     IDE_EXIT;
 
-  gbp_symbol_popover_set_symbol_tree (self->popover, NULL);
+  gbp_symbol_popover_set_symbols (self->popover, NULL);
 
   IDE_EXIT;
 }
@@ -212,6 +296,9 @@ gbp_symbol_workspace_addin_update_nearest_scope (GbpSymbolWorkspaceAddin *self,
       IDE_EXIT;
     }
 
+  if (gbp_symbol_workspace_addin_update_nearest_scope_from_cache (self, buffer))
+    IDE_EXIT;
+
   gbp_symbol_find_nearest_scope_async (buffer,
                                        NULL,
                                        gbp_symbol_workspace_addin_find_nearest_scope_cb,
@@ -224,6 +311,9 @@ static void
 gbp_symbol_workspace_addin_update_symbol_tree (GbpSymbolWorkspaceAddin *self,
                                                IdeBuffer               *buffer)
 {
+  GbpSymbolCache *cache;
+  GetSymbolTree *state;
+
   IDE_ENTRY;
 
   g_assert (GBP_IS_SYMBOL_WORKSPACE_ADDIN (self));
@@ -231,14 +321,27 @@ gbp_symbol_workspace_addin_update_symbol_tree (GbpSymbolWorkspaceAddin *self,
 
   if (!ide_buffer_has_symbol_resolvers (buffer))
     {
-      gbp_symbol_popover_set_symbol_tree (self->popover, NULL);
+      gbp_symbol_popover_set_symbols (self->popover, NULL);
       IDE_EXIT;
     }
 
+  /* Show whatever we have immediately; the model is updated in place
+   * when the new tree arrives so expanded rows are preserved.
+   */
+  cache = gbp_symbol_cache_from_buffer (buffer);
+  gbp_symbol_popover_set_symbols (self->popover, gbp_symbol_cache_get_model (cache));
+
+  if (gbp_symbol_cache_is_current (cache, buffer))
+    IDE_EXIT;
+
+  state = g_slice_new0 (GetSymbolTree);
+  state->self = g_object_ref (self);
+  state->change_count = ide_buffer_get_change_count (buffer);
+
   gbp_symbol_get_symbol_tree_async (buffer,
                                     NULL,
                                     gbp_symbol_workspace_addin_get_symbol_tree_cb,
-                                    g_object_ref (self));
+                                    state);
 
   IDE_EXIT;
 }
@@ -323,7 +426,7 @@ gbp_symbol_workspace_addin_symbol_tree_timeout (gpointer data)
   if ((buffer = _g_signal_group_get_target (self->buffer_signals)))
     gbp_symbol_workspace_addin_update_symbol_tree (self, buffer);
   else
-    gbp_symbol_popover_set_symbol_tree (self->popover, NULL);
+    gbp_symbol_popover_set_symbols (self->popover, NULL);
 
   IDE_RETURN (G_SOURCE_REMOVE);
 }
@@ -425,7 +528,7 @@ gbp_symbol_workspace_addin_page_changed (IdeWorkspaceAddin *addin,
   g_assert (GBP_IS_SYMBOL_WORKSPACE_ADDIN (self));
   g_assert (!page || IDE_IS_PAGE (page));
 
-  gbp_symbol_popover_set_symbol_tree (self->popover, NULL);
+  gbp_symbol_popover_set_symbols (self->popover, NULL);
   gbp_symbol_workspace_addin_set_symbol (self, NULL);
   gtk_widget_hide (GTK_WIDGET (self->menu_button));
 
@@ -22,7 +22,9 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 #include <libide-gui.h>
 #include <libide-threading.h>
@@ -39,11 +41,14 @@ struct _GbpSysprofWorkbenchAddin
   guint         run_manager_busy : 1;
 };
 
-static void gbp_sysprof_workbench_addin_run (GbpSysprofWorkbenchAddin *self,
-                                             GVariant                 *param);
+static void gbp_sysprof_workbench_addin_run            (GbpSysprofWorkbenchAddin *self,
+                                                        GVariant                 *param);
+static void gbp_sysprof_workbench_addin_record_builder (GbpSysprofWorkbenchAddin *self,
+                                                        GVariant                 *state);
 
 IDE_DEFINE_ACTION_GROUP (GbpSysprofWorkbenchAddin, gbp_sysprof_workbench_addin, {
   { "run", gbp_sysprof_workbench_addin_run },
+  { "record-builder", NULL, NULL, "false", gbp_sysprof_workbench_addin_record_builder },
 })
 
 static void
@@ -143,6 +148,9 @@ static void
 gbp_sysprof_workbench_addin_init (GbpSysprofWorkbenchAddin *self)
 {
   gbp_sysprof_workbench_addin_set_action_enabled (self, "run", FALSE);
+  gbp_sysprof_workbench_addin_set_action_state (self,
+                                                "record-builder",
+                                                g_variant_new_boolean (ide_profiler_is_active ()));
 }
 
 static void
@@ -168,3 +176,90 @@ gbp_sysprof_workbench_addin_run (GbpSysprofWorkbenchAddin *self,
 
   IDE_EXIT;
 }
+
+static void
+notify_recording (GbpSysprofWorkbenchAddin *self,
+                  const char               *title,
+                  const char               *body)
+{
+  g_autoptr(IdeNotification) notif = NULL;
+  IdeContext *context;
+
+  g_assert (GBP_IS_SYSPROF_WORKBENCH_ADDIN (self));
+
+  if (self->workbench == NULL)
+    return;
+
+  context = ide_workbench_get_context (self->workbench);
+
+  notif = ide_notification_new ();
+  ide_notification_set_icon_name (notif, "builder-profiler-symbolic");
+  ide_notification_set_title (notif, title);
+  ide_notification_set_body (notif, body);
+  ide_notification_attach (notif, IDE_OBJECT (context));
+  ide_notification_withdraw_in_seconds (notif, 30);
+}
+
+static void
+gbp_sysprof_workbench_addin_record_builder (GbpSysprofWorkbenchAddin *self,
+                                            GVariant                 *state)
+{
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAIN_THREAD ());
+  g_assert (GBP_IS_SYSPROF_WORKBENCH_ADDIN (self));
+  g_assert (state != NULL && g_variant_is_of_type (state, G_VARIANT_TYPE_BOOLEAN));
+
+  if (g_variant_get_boolean (state) == ide_profiler_is_active ())
+    IDE_EXIT;
+
+  if (g_variant_get_boolean (state))
+    {
+      g_autoptr(GDateTime) now = g_date_time_new_now_local ();
+      g_autoptr(GError) error = NULL;
+      g_autofree char *directory = NULL;
+      g_autofree char *name = NULL;
+      g_autofree char *path = NULL;
+
+      directory = g_build_filename (g_get_user_cache_dir (), ide_get_program_name (), "profiles", NULL);
+      name = g_date_time_format (now, "builder-%Y%m%d-%H%M%S.syscap");
+      path = g_build_filename (directory, name, NULL);
+
+      if (g_mkdir_with_parents (directory, 0750) != 0 ||
+          !ide_profiler_start (path, &error))
+        {
+          if (error == NULL)
+            {
+              int errsv = errno;
+              error = g_error_new_literal (G_IO_ERROR,
+                                           g_io_error_from_errno (errsv),
+                                           g_strerror (errsv));
+            }
+
+          notify_recording (self, _("Failed to record Builder performance"), error->message);
+          IDE_EXIT;
+        }
+
+      g_object_set_data_full (G_OBJECT (self), "PROFILE_PATH", g_steal_pointer (&path), g_free);
+    }
+  else
+    {
+      const char *path = g_object_get_data (G_OBJECT (self), "PROFILE_PATH");
+      g_autofree char *body = NULL;
+
+      ide_profiler_stop ();
+
+      if (path != NULL)
+        {
+          /* translators: %s is replaced with the path to the capture file */
+          body = g_strdup_printf (_("Saved to “%s”"), path);
+          notify_recording (self, _("Builder performance recorded"), body);
+        }
+
+      g_object_set_data (G_OBJECT (self), "PROFILE_PATH", NULL);
+    }
+
+  gbp_sysprof_workbench_addin_set_action_state (self, "record-builder", state);
+
+  IDE_EXIT;
+}
@@ -75,6 +75,35 @@ ide_xml_analysis_get_schemas (IdeXmlAnalysis *self)
   return self->schemas;
 }
 
+/**
+ * ide_xml_analysis_get_content:
+ * @self: an #IdeXmlAnalysis.
+ *
+ * Returns: (nullable) (transfer none): The content the analysis was made from.
+ *
+ */
+GBytes *
+ide_xml_analysis_get_content (IdeXmlAnalysis *self)
+{
+  g_return_val_if_fail (self, NULL);
+
+  return self->content;
+}
+
+void
+ide_xml_analysis_set_content (IdeXmlAnalysis *self,
+                              GBytes         *content)
+{
+  g_return_if_fail (self != NULL);
+
+  if (self->content != content)
+    {
+      g_clear_pointer (&self->content, g_bytes_unref);
+      if (content != NULL)
+        self->content = g_bytes_ref (content);
+    }
+}
+
 void
 ide_xml_analysis_set_diagnostics (IdeXmlAnalysis *self,
                                   IdeDiagnostics *diagnostics)
@@ -126,6 +155,7 @@ ide_xml_analysis_new (gint64 sequence)
   self = g_slice_new0 (IdeXmlAnalysis);
   self->ref_count = 1;
   self->sequence = sequence;
+  self->needs_validation = TRUE;
 
   return self;
 }
@@ -138,6 +168,7 @@ ide_xml_analysis_free (IdeXmlAnalysis *self)
 
   g_clear_object (&self->root_node);
   g_clear_object (&self->diagnostics);
+  g_clear_pointer (&self->content, g_bytes_unref);
   g_slice_free (IdeXmlAnalysis, self);
 }
 
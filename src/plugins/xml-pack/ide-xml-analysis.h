@@ -36,7 +36,12 @@ struct _IdeXmlAnalysis
   IdeXmlSymbolNode *root_node;
   IdeDiagnostics   *diagnostics;
   GPtrArray        *schemas;       // array of IdeXmlSchemaCacheEntry
+  GBytes           *content;       // the analysed content, to reparse only the edited element
   gint64            sequence;
+
+  guint             is_well_formed : 1;
+  guint             needs_validation : 1;
+  guint             is_reparsed : 1;  // only the edited element was parsed again
 };
 
 GType               ide_xml_analysis_get_type            (void);
@@ -44,6 +49,9 @@ IdeDiagnostics     *ide_xml_analysis_get_diagnostics     (IdeXmlAnalysis   *self
 IdeXmlSymbolNode   *ide_xml_analysis_get_root_node       (IdeXmlAnalysis   *self);
 gint64              ide_xml_analysis_get_sequence        (IdeXmlAnalysis   *self);
 GPtrArray          *ide_xml_analysis_get_schemas         (IdeXmlAnalysis   *self);
+GBytes             *ide_xml_analysis_get_content         (IdeXmlAnalysis   *self);
+void                ide_xml_analysis_set_content         (IdeXmlAnalysis   *self,
+                                                          GBytes           *content);
 void                ide_xml_analysis_set_diagnostics     (IdeXmlAnalysis   *self,
                                                           IdeDiagnostics   *diagnostics);
 void                ide_xml_analysis_set_root_node       (IdeXmlAnalysis   *self,
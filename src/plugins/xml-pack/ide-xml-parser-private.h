@@ -66,7 +66,9 @@ typedef struct _ParserState
   GFile             *file;
   GBytes            *content;
   IdeXmlAnalysis    *analysis;
+  IdeXmlAnalysis    *previous;
   GPtrArray         *diagnostics_array;
+  IdeDiagnostics    *validation_diagnostics;
   IdeXmlSymbolNode  *root_node;
   IdeXmlSymbolNode  *parent_node;
   IdeXmlSymbolNode  *current_node;
@@ -20,6 +20,7 @@
 
 #include <glib/gi18n.h>
 #include <glib-object.h>
+#include <string.h>
 
 #include <libxml/xmlerror.h>
 
@@ -32,6 +33,8 @@
 #include "ide-xml-stack.h"
 #include "ide-xml-tree-builder-utils-private.h"
 
+#define BUILTIN_SCHEMAS_URI "resource:///plugins/xml-pack/schemas/"
+
 typedef struct _ColorTag
 {
   gchar *name;
@@ -70,7 +73,9 @@ static void
 parser_state_free (ParserState *state)
 {
   g_clear_pointer (&state->analysis, ide_xml_analysis_unref);
+  g_clear_pointer (&state->previous, ide_xml_analysis_unref);
   g_clear_pointer (&state->diagnostics_array, g_ptr_array_unref);
+  g_clear_object (&state->validation_diagnostics);
   g_clear_object (&state->file);
   g_clear_object (&state->root_node);
   g_clear_object (&state->sax_parser);
@@ -562,6 +567,404 @@ ide_xml_parser_characters_sax_cb (ParserState    *state,
   ide_xml_parser_state_processing (self, state, element_value, NULL, IDE_XML_SAX_CALLBACK_TYPE_CHAR, FALSE);
 }
 
+static gboolean
+is_builtin_schema (IdeXmlSchemaCacheEntry *entry)
+{
+  g_autofree gchar *uri = NULL;
+
+  if (entry->file == NULL)
+    return FALSE;
+
+  uri = g_file_get_uri (entry->file);
+
+  return g_str_has_prefix (uri, BUILTIN_SCHEMAS_URI);
+}
+
+static GArray *
+get_line_starts (const gchar *data,
+                 gsize        size)
+{
+  GArray *lines;
+  const gchar *iter = data;
+  const gchar *end = data + size;
+  gsize offset = 0;
+
+  lines = g_array_new (FALSE, FALSE, sizeof (gsize));
+  g_array_append_val (lines, offset);
+
+  while (iter < end && NULL != (iter = memchr (iter, '\n', end - iter)))
+    {
+      offset = ++iter - data;
+      g_array_append_val (lines, offset);
+    }
+
+  return lines;
+}
+
+/* Nodes lines and line offsets start at 1, line offsets being in bytes */
+static gssize
+get_offset (GArray *lines,
+            gint    line,
+            gint    line_offset)
+{
+  if (line < 1 || line_offset < 1 || (guint)line > lines->len)
+    return -1;
+
+  return g_array_index (lines, gsize, line - 1) + line_offset - 1;
+}
+
+static void
+get_element_end (IdeXmlSymbolNode *node,
+                 gint             *end_line,
+                 gint             *end_line_offset)
+{
+  if (ide_xml_symbol_node_has_end_tag (node))
+    ide_xml_symbol_node_get_end_tag_location (node, NULL, NULL, end_line, end_line_offset, NULL);
+  else
+    ide_xml_symbol_node_get_location (node, NULL, NULL, end_line, end_line_offset, NULL);
+}
+
+/* Get the bytes span of an element, from its first '<' to its last '>' */
+static gboolean
+get_element_span (IdeXmlSymbolNode *node,
+                  GArray           *lines,
+                  const gchar      *data,
+                  gsize             size,
+                  gssize           *begin,
+                  gssize           *end)
+{
+  IdeSymbolKind kind;
+  gint line;
+  gint line_offset;
+  gint end_line;
+  gint end_line_offset;
+
+  kind = ide_symbol_node_get_kind (IDE_SYMBOL_NODE (node));
+  if (kind == IDE_SYMBOL_KIND_XML_COMMENT ||
+      kind == IDE_SYMBOL_KIND_XML_CDATA ||
+      ide_xml_symbol_node_get_state (node) != IDE_XML_SYMBOL_NODE_STATE_OK)
+    return FALSE;
+
+  ide_xml_symbol_node_get_location (node, &line, &line_offset, NULL, NULL, NULL);
+  get_element_end (node, &end_line, &end_line_offset);
+
+  *begin = get_offset (lines, line, line_offset);
+  *end = get_offset (lines, end_line, end_line_offset);
+
+  return (*begin >= 0 && *end > *begin && (gsize)*end < size &&
+          data[*begin] == '<' && data[*end] == '>');
+}
+
+/* Find the deepest element enclosing the [change_begin, change_end[ bytes
+ * range, without its first '<' and last '>' being part of the change.
+ */
+static IdeXmlSymbolNode *
+find_edited_element (IdeXmlSymbolNode *root_node,
+                     GArray           *lines,
+                     const gchar      *data,
+                     gsize             size,
+                     gsize             change_begin,
+                     gsize             change_end)
+{
+  IdeXmlSymbolNode *node = root_node;
+  IdeXmlSymbolNode *edited = NULL;
+
+  while (node != NULL)
+    {
+      guint n_children = ide_xml_symbol_node_get_n_direct_children (node);
+      IdeXmlSymbolNode *next = NULL;
+
+      for (guint i = 0; i < n_children; ++i)
+        {
+          g_autoptr(IdeXmlSymbolNode) child = NULL;
+          gssize begin;
+          gssize end;
+
+          child = (IdeXmlSymbolNode *)ide_xml_symbol_node_get_nth_direct_child (node, i);
+          if (!get_element_span (child, lines, data, size, &begin, &end))
+            continue;
+
+          if ((gsize)begin >= change_begin)
+            break;
+
+          if ((gsize)end >= change_end)
+            {
+              next = child;
+              break;
+            }
+        }
+
+      if (next != NULL)
+        edited = next;
+
+      node = next;
+    }
+
+  return edited;
+}
+
+/* The validation errors are reported on the lines of the elements, only
+ * those after the edited element need to be moved.
+ */
+static IdeDiagnostics *
+shift_validation_diagnostics (IdeDiagnostics *diagnostics,
+                              gint            line,
+                              gint            line_delta)
+{
+  g_autoptr(IdeDiagnostics) shifted = NULL;
+  guint n_items;
+
+  shifted = ide_diagnostics_new ();
+  n_items = g_list_model_get_n_items (G_LIST_MODEL (diagnostics));
+
+  for (guint i = 0; i < n_items; ++i)
+    {
+      g_autoptr(IdeDiagnostic) diagnostic = g_list_model_get_item (G_LIST_MODEL (diagnostics), i);
+      g_autoptr(IdeLocation) location = NULL;
+      IdeLocation *old_location;
+
+      old_location = ide_diagnostic_get_location (diagnostic);
+      if (line_delta == 0 ||
+          old_location == NULL ||
+          ide_location_get_line (old_location) < line)
+        {
+          ide_diagnostics_add (shifted, diagnostic);
+          continue;
+        }
+
+      if (ide_diagnostic_get_n_ranges (diagnostic) > 0 ||
+          ide_diagnostic_get_n_fixits (diagnostic) > 0)
+        return NULL;
+
+      location = ide_location_new (ide_location_get_file (old_location),
+                                   ide_location_get_line (old_location) + line_delta,
+                                   ide_location_get_line_offset (old_location));
+      ide_diagnostics_take (shifted,
+                            ide_diagnostic_new (ide_diagnostic_get_severity (diagnostic),
+                                                ide_diagnostic_get_text (diagnostic),
+                                                location));
+    }
+
+  return g_steal_pointer (&shifted);
+}
+
+/* The built-in GtkBuilder schemas only put constraints on the attributes
+ * values, so editing the text of an element which already had some can't
+ * change the result of the validation.
+ */
+static gboolean
+is_text_edit (IdeXmlSymbolNode *edited,
+              IdeXmlSymbolNode *node,
+              GArray           *lines,
+              const gchar      *data,
+              gsize             change_begin,
+              gsize             change_end)
+{
+  gint line;
+  gint line_offset;
+  gssize text_begin;
+  gssize text_end;
+
+  if (ide_xml_symbol_node_get_n_direct_children (edited) > 0 ||
+      ide_xml_symbol_node_get_n_direct_children (node) > 0 ||
+      !ide_xml_symbol_node_has_end_tag (edited) ||
+      !ide_xml_symbol_node_has_end_tag (node))
+    return FALSE;
+
+  ide_xml_symbol_node_get_location (edited, NULL, NULL, &line, &line_offset, NULL);
+  text_begin = get_offset (lines, line, line_offset) + 1;
+
+  ide_xml_symbol_node_get_end_tag_location (edited, &line, &line_offset, NULL, NULL, NULL);
+  text_end = get_offset (lines, line, line_offset);
+
+  if (text_begin < 1 || text_end < text_begin ||
+      change_begin < (gsize)text_begin || change_end > (gsize)text_end)
+    return FALSE;
+
+  for (const gchar *iter = data + text_begin; iter < data + text_end; ++iter)
+    {
+      if (!g_ascii_isspace (*iter))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+can_reuse_validation (ParserState *state)
+{
+  GPtrArray *schemas = state->previous->schemas;
+
+  if (!state->file_is_ui ||
+      schemas == NULL ||
+      schemas->len == 0 ||
+      state->previous->diagnostics == NULL)
+    return FALSE;
+
+  for (guint i = 0; i < schemas->len; ++i)
+    {
+      if (!is_builtin_schema (g_ptr_array_index (schemas, i)))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Instead of parsing the whole document again, we only parse the smallest
+ * element enclosing the edit since the previous analysis, starting with
+ * its parent as the current node. The nodes around it are copied from the
+ * previous tree, with their location moved by the size of the edit.
+ *
+ * We bail out to a full parse as soon as something is not trivial:
+ * an edit in the prolog or in the document element tags, a previous
+ * document which was not well formed or errors while parsing the element.
+ */
+static gboolean
+ide_xml_parser_reparse_edited_element (IdeXmlParser *self,
+                                       ParserState  *state)
+{
+  IdeXmlAnalysis *previous = state->previous;
+  g_autoptr(IdeXmlSymbolNode) replacements = NULL;
+  g_autoptr(IdeXmlSymbolNode) root_node = NULL;
+  g_autoptr(IdeXmlSymbolNode) node = NULL;
+  g_autoptr(IdeXmlStack) stack = NULL;
+  g_autoptr(GArray) lines = NULL;
+  g_autofree gchar *uri = NULL;
+  IdeXmlSymbolNodeShift shift;
+  IdeXmlSymbolNode *edited;
+  IdeXmlSymbolNode *parent;
+  const gchar *old_data;
+  const gchar *new_data;
+  gsize old_size;
+  gsize new_size;
+  gsize prefix = 0;
+  gsize suffix = 0;
+  gssize begin;
+  gssize end;
+  gint line;
+  gint line_offset;
+  gint end_line;
+  gint end_line_offset;
+  gint new_end_line;
+  gint new_end_line_offset;
+
+  g_assert (IDE_IS_XML_PARSER (self));
+  g_assert (state != NULL);
+
+  if (previous == NULL ||
+      previous->content == NULL ||
+      previous->root_node == NULL ||
+      !previous->is_well_formed)
+    return FALSE;
+
+  old_data = g_bytes_get_data (previous->content, &old_size);
+  new_data = g_bytes_get_data (state->content, &new_size);
+
+  while (prefix < old_size && prefix < new_size && old_data[prefix] == new_data[prefix])
+    ++prefix;
+
+  while (suffix < old_size - prefix &&
+         suffix < new_size - prefix &&
+         old_data[old_size - suffix - 1] == new_data[new_size - suffix - 1])
+    ++suffix;
+
+  lines = get_line_starts (old_data, old_size);
+  edited = find_edited_element (previous->root_node, lines, old_data, old_size, prefix, old_size - suffix);
+  if (edited == NULL)
+    return FALSE;
+
+  /* Labels of menus and styles are made from these children */
+  while (state->file_is_ui &&
+         edited != previous->root_node &&
+         (ide_str_equal0 (ide_xml_symbol_node_get_element_name (edited), "class") ||
+          ide_str_equal0 (ide_xml_symbol_node_get_element_name (edited), "attribute")))
+    edited = ide_xml_symbol_node_get_parent (edited);
+
+  /* Editing the document element is the same as a full parse */
+  parent = ide_xml_symbol_node_get_parent (edited);
+  if (parent == NULL || parent == previous->root_node ||
+      !get_element_span (edited, lines, old_data, old_size, &begin, &end))
+    return FALSE;
+
+  replacements = ide_xml_symbol_node_new ("internal", NULL,
+                                          ide_xml_symbol_node_get_element_name (parent),
+                                          IDE_SYMBOL_KIND_NONE);
+
+  stack = g_steal_pointer (&state->stack);
+  state->stack = ide_xml_stack_new ();
+  ide_xml_stack_push (state->stack, ide_xml_symbol_node_get_element_name (parent), replacements, NULL, 0);
+  state->parent_node = replacements;
+
+  uri = g_file_get_uri (state->file);
+  ide_xml_sax_parse (state->sax_parser,
+                     new_data + begin,
+                     (end + 1 - begin) + ((gssize)new_size - (gssize)old_size),
+                     uri,
+                     state);
+
+  g_clear_object (&state->stack);
+  state->stack = g_steal_pointer (&stack);
+  state->parent_node = state->root_node;
+  state->current_node = NULL;
+  state->build_state = BUILD_STATE_NORMAL;
+  state->error_missing_tag_end = FALSE;
+
+  if (state->diagnostics_array->len > 0 ||
+      state->schemas->len > 0 ||
+      ide_xml_symbol_node_get_n_direct_children (replacements) != 1)
+    {
+      g_ptr_array_set_size (state->diagnostics_array, 0);
+      g_ptr_array_set_size (state->schemas, 0);
+      return FALSE;
+    }
+
+  if (self->post_processing_callback != NULL)
+    (self->post_processing_callback)(self, replacements);
+
+  /* Move the new nodes at the place of the element in the document */
+  ide_xml_symbol_node_get_location (edited, &line, &line_offset, NULL, NULL, NULL);
+  shift.line = 1;
+  shift.line_offset = 1;
+  shift.line_delta = line - 1;
+  shift.line_offset_delta = line_offset - 1;
+  ide_xml_symbol_node_shift (replacements, &shift);
+
+  /* And the nodes after it by the size of the edit */
+  node = (IdeXmlSymbolNode *)ide_xml_symbol_node_get_nth_direct_child (replacements, 0);
+  get_element_end (edited, &end_line, &end_line_offset);
+  get_element_end (node, &new_end_line, &new_end_line_offset);
+  shift.line = end_line;
+  shift.line_offset = end_line_offset + 1;
+  shift.line_delta = new_end_line - end_line;
+  shift.line_offset_delta = new_end_line_offset - end_line_offset;
+
+  root_node = ide_xml_symbol_node_copy (previous->root_node, &shift, edited, replacements);
+  g_set_object (&state->root_node, root_node);
+  ide_xml_analysis_set_root_node (state->analysis, root_node);
+
+  /* The prolog is unchanged, the built-in schemas are added back later */
+  if (previous->schemas != NULL)
+    {
+      for (guint i = 0; i < previous->schemas->len; ++i)
+        {
+          IdeXmlSchemaCacheEntry *entry = g_ptr_array_index (previous->schemas, i);
+
+          if (!is_builtin_schema (entry))
+            g_ptr_array_add (state->schemas, ide_xml_schema_cache_entry_copy (entry));
+        }
+    }
+
+  if (can_reuse_validation (state) &&
+      is_text_edit (edited, node, lines, old_data, prefix, old_size - suffix) &&
+      (line != end_line || shift.line_delta == 0) &&
+      NULL != (state->validation_diagnostics = shift_validation_diagnostics (previous->diagnostics,
+                                                                             line,
+                                                                             shift.line_delta)))
+    state->analysis->needs_validation = FALSE;
+
+  return TRUE;
+}
+
 static void
 ide_xml_parser_get_analysis_worker (IdeTask      *task,
                                     gpointer      source_object,
@@ -593,11 +996,16 @@ ide_xml_parser_get_analysis_worker (IdeTask      *task,
   else
     ide_xml_parser_generic_setup (self, state);
 
-  uri = g_file_get_uri (state->file);
-  ide_xml_sax_parse (state->sax_parser, doc_data, doc_size, uri, state);
+  if (ide_xml_parser_reparse_edited_element (self, state))
+    state->analysis->is_reparsed = TRUE;
+  else
+    {
+      uri = g_file_get_uri (state->file);
+      ide_xml_sax_parse (state->sax_parser, doc_data, doc_size, uri, state);
 
-  if (self->post_processing_callback != NULL)
-    (self->post_processing_callback)(self, state->root_node);
+      if (self->post_processing_callback != NULL)
+        (self->post_processing_callback)(self, state->root_node);
+    }
 
   if (!(analysis = g_steal_pointer (&state->analysis)))
     {
@@ -614,7 +1022,11 @@ ide_xml_parser_get_analysis_worker (IdeTask      *task,
       for (guint i = 0; i < state->diagnostics_array->len; i++)
         ide_diagnostics_add (diagnostics, g_ptr_array_index (state->diagnostics_array, i));
     }
+  if (state->validation_diagnostics != NULL)
+    ide_diagnostics_merge (diagnostics, state->validation_diagnostics);
   ide_xml_analysis_set_diagnostics (analysis, diagnostics);
+  ide_xml_analysis_set_content (analysis, state->content);
+  analysis->is_well_formed = (state->diagnostics_array->len == 0);
 
   /* by default use gtk4builder.rng and only gtkbuilder.rng if explicitly stated in the ui file.
    * As gtkbuilder.rng is a subset of gtk4builder.rng this probably never makes problems.
@@ -623,7 +1035,7 @@ ide_xml_parser_get_analysis_worker (IdeTask      *task,
     {
       entry = ide_xml_schema_cache_entry_new ();
       entry->kind = SCHEMA_KIND_RNG;
-      entry->file = g_file_new_for_uri ("resource:///plugins/xml-pack/schemas/gtkbuilder.rng");
+      entry->file = g_file_new_for_uri (BUILTIN_SCHEMAS_URI "gtkbuilder.rng");
       g_object_set_data (G_OBJECT (entry->file), "kind", GUINT_TO_POINTER (entry->kind));
       g_ptr_array_add (state->schemas, entry);
     }
@@ -631,7 +1043,7 @@ ide_xml_parser_get_analysis_worker (IdeTask      *task,
     {
       entry = ide_xml_schema_cache_entry_new ();
       entry->kind = SCHEMA_KIND_RNG;
-      entry->file = g_file_new_for_uri ("resource:///plugins/xml-pack/schemas/gtk4builder.rng");
+      entry->file = g_file_new_for_uri (BUILTIN_SCHEMAS_URI "gtk4builder.rng");
       g_object_set_data (G_OBJECT (entry->file), "kind", GUINT_TO_POINTER (entry->kind));
       g_ptr_array_add (state->schemas, entry);
     }
@@ -650,6 +1062,7 @@ ide_xml_parser_get_analysis_async (IdeXmlParser        *self,
                                    GFile               *file,
                                    GBytes              *content,
                                    gint64               sequence,
+                                   IdeXmlAnalysis      *previous,
                                    GCancellable        *cancellable,
                                    GAsyncReadyCallback  callback,
                                    gpointer             user_data)
@@ -669,6 +1082,7 @@ ide_xml_parser_get_analysis_async (IdeXmlParser        *self,
   state->file = g_object_ref (file);
   state->content = g_bytes_ref (content);
   state->sequence = sequence;
+  state->previous = previous ? ide_xml_analysis_ref (previous) : NULL;
   state->diagnostics_array = g_ptr_array_new_with_free_func (g_object_unref);
   state->schemas = g_ptr_array_new_with_free_func (g_object_unref);
   state->sax_parser = ide_xml_sax_new ();
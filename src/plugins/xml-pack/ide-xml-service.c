@@ -34,6 +34,7 @@
 #include "ide-xml-tree-builder.h"
 
 #define DEFAULT_EVICTION_MSEC (60 * 1000)
+#define SCHEMAS_MAX_SIZE      (32 * 1024 * 1024)
 
 struct _IdeXmlService
 {
@@ -525,6 +526,22 @@ ide_xml_service_get_diagnostics_finish (IdeXmlService  *self,
   return g_task_propagate_pointer (G_TASK (result), error);
 }
 
+static gsize
+ide_xml_service_schema_size (gconstpointer key,
+                             gconstpointer value)
+{
+  const IdeXmlSchemaCacheEntry *entry = value;
+  gsize ret = sizeof *entry;
+
+  /* The parsed schema is not accounted, it is roughly proportional to
+   * the content which is kept alongside.
+   */
+  if (entry->content != NULL)
+    ret += g_bytes_get_size (entry->content);
+
+  return ret;
+}
+
 static void
 ide_xml_service_parent_set (IdeObject *object,
                             IdeObject *parent)
@@ -571,6 +588,8 @@ ide_xml_service_parent_set (IdeObject *object,
                                       NULL);
 
   ide_task_cache_set_name (self->schemas, "xml schemas cache");
+  ide_task_cache_set_size_func (self->schemas, ide_xml_service_schema_size);
+  ide_task_cache_set_max_size (self->schemas, SCHEMAS_MAX_SIZE);
 
   IDE_EXIT;
 }
@@ -1055,6 +1074,28 @@ ide_xml_service_init (IdeXmlService *self)
 {
 }
 
+/**
+ * ide_xml_service_get_cached_analysis:
+ *
+ * Gets the last #IdeXmlAnalysis of the file, if it is still cached.
+ *
+ * Returns: (transfer full) (nullable): an #IdeXmlAnalysis.
+ */
+IdeXmlAnalysis *
+ide_xml_service_get_cached_analysis (IdeXmlService *self,
+                                     GFile         *file)
+{
+  IdeXmlAnalysis *analysis;
+
+  g_return_val_if_fail (IDE_IS_XML_SERVICE (self), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  if (NULL != (analysis = ide_task_cache_peek (self->analyses, file)))
+    return ide_xml_analysis_ref (analysis);
+
+  return NULL;
+}
+
 /**
  * ide_xml_service_get_cached_root_node:
  *
@@ -25,6 +25,7 @@
 #include <libide-code.h>
 #include <libide-io.h>
 
+#include "ide-xml-analysis.h"
 #include "ide-xml-position.h"
 #include "ide-xml-symbol-node.h"
 
@@ -35,6 +36,8 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (IdeXmlService, ide_xml_service, IDE, XML_SERVICE, IdeObject)
 
 IdeXmlService      *ide_xml_service_from_context                       (IdeContext           *context);
+IdeXmlAnalysis     *ide_xml_service_get_cached_analysis                (IdeXmlService        *self,
+                                                                        GFile                *gfile);
 IdeDiagnostics     *ide_xml_service_get_cached_diagnostics             (IdeXmlService        *self,
                                                                         GFile                *gfile);
 IdeXmlSymbolNode   *ide_xml_service_get_cached_root_node               (IdeXmlService        *self,
@@ -417,6 +417,159 @@ ide_xml_symbol_node_take_internal_child (IdeXmlSymbolNode *self,
   ++self->nb_internal_children;
 }
 
+static inline void
+shift_position (const IdeXmlSymbolNodeShift *shift,
+                gint                        *line,
+                gint                        *line_offset)
+{
+  if (*line < shift->line ||
+      (*line == shift->line && *line_offset < shift->line_offset))
+    return;
+
+  if (*line == shift->line)
+    *line_offset += shift->line_offset_delta;
+
+  *line += shift->line_delta;
+}
+
+static inline void
+shift_range (const IdeXmlSymbolNodeShift *shift,
+             NodeRange                   *range)
+{
+  shift_position (shift, &range->start_line, &range->start_line_offset);
+  shift_position (shift, &range->end_line, &range->end_line_offset);
+}
+
+/**
+ * ide_xml_symbol_node_shift:
+ * @self: an #IdeXmlSymbolNode
+ * @shift: the move to apply
+ *
+ * Moves the tags of @self and of its whole subtree according to @shift.
+ * This is used to place the nodes of a reparsed element at the position
+ * of that element in the document.
+ */
+void
+ide_xml_symbol_node_shift (IdeXmlSymbolNode            *self,
+                           const IdeXmlSymbolNodeShift *shift)
+{
+  g_return_if_fail (IDE_IS_XML_SYMBOL_NODE (self));
+  g_return_if_fail (shift != NULL);
+
+  shift_range (shift, &self->start_tag);
+  if (self->has_end_tag)
+    shift_range (shift, &self->end_tag);
+
+  if (self->children != NULL)
+    {
+      for (guint n = 0; n < self->children->len; ++n)
+        ide_xml_symbol_node_shift (g_array_index (self->children, NodeEntry, n).node, shift);
+    }
+}
+
+/**
+ * ide_xml_symbol_node_copy:
+ * @self: an #IdeXmlSymbolNode
+ * @shift: (nullable): a move to apply to the copied tags
+ * @replaced: (nullable): a node of the subtree of @self
+ * @replacements: (nullable): a node holding the replacements of @replaced
+ *
+ * Copies the subtree of @self, moving the tags of the copies by @shift.
+ *
+ * If @replaced is found, it is not copied. The direct children of
+ * @replacements are moved in its place instead, and they are expected
+ * to be already at their final position.
+ *
+ * Returns: (transfer full): a new #IdeXmlSymbolNode
+ */
+IdeXmlSymbolNode *
+ide_xml_symbol_node_copy (IdeXmlSymbolNode            *self,
+                          const IdeXmlSymbolNodeShift *shift,
+                          IdeXmlSymbolNode            *replaced,
+                          IdeXmlSymbolNode            *replacements)
+{
+  IdeXmlSymbolNode *copy;
+  g_autofree gchar *name = NULL;
+  g_autofree gchar *display_name = NULL;
+
+  g_return_val_if_fail (IDE_IS_XML_SYMBOL_NODE (self), NULL);
+  g_return_val_if_fail (replaced == NULL || IDE_IS_XML_SYMBOL_NODE (replacements), NULL);
+
+  g_object_get (self,
+                "name", &name,
+                "display-name", &display_name,
+                NULL);
+
+  copy = g_object_new (IDE_TYPE_XML_SYMBOL_NODE,
+                       "name", name,
+                       "display-name", display_name,
+                       "kind", ide_symbol_node_get_kind (IDE_SYMBOL_NODE (self)),
+                       "flags", ide_symbol_node_get_flags (IDE_SYMBOL_NODE (self)),
+                       "use-markup", ide_symbol_node_get_use_markup (IDE_SYMBOL_NODE (self)),
+                       NULL);
+
+  copy->element_name = g_strdup (self->element_name);
+  copy->value = g_strdup (self->value);
+  copy->ns = g_strdup (self->ns);
+  copy->state = self->state;
+  copy->start_tag = self->start_tag;
+  copy->end_tag = self->end_tag;
+  copy->has_end_tag = self->has_end_tag;
+  g_set_object (&copy->file, self->file);
+
+  if (shift != NULL)
+    {
+      shift_range (shift, &copy->start_tag);
+      if (copy->has_end_tag)
+        shift_range (shift, &copy->end_tag);
+    }
+
+  if (self->attributes != NULL)
+    {
+      copy->attributes = g_array_sized_new (FALSE, FALSE, sizeof (Attribute), self->attributes->len);
+      for (guint i = 0; i < self->attributes->len; ++i)
+        {
+          const Attribute *attr = &g_array_index (self->attributes, Attribute, i);
+          Attribute attr_copy = { g_strdup (attr->name), g_strdup (attr->value) };
+
+          g_array_append_val (copy->attributes, attr_copy);
+        }
+    }
+
+  if (self->children == NULL)
+    return copy;
+
+  for (guint n = 0; n < self->children->len; ++n)
+    {
+      const NodeEntry *entry = &g_array_index (self->children, NodeEntry, n);
+
+      if (entry->node == replaced)
+        {
+          if (replacements->children == NULL)
+            continue;
+
+          for (guint i = 0; i < replacements->children->len; ++i)
+            {
+              const NodeEntry *replacement = &g_array_index (replacements->children, NodeEntry, i);
+
+              if (replacement->is_internal)
+                ide_xml_symbol_node_take_internal_child (copy, g_object_ref (replacement->node));
+              else
+                ide_xml_symbol_node_take_child (copy, g_object_ref (replacement->node));
+            }
+
+          continue;
+        }
+
+      if (entry->is_internal)
+        ide_xml_symbol_node_take_internal_child (copy, ide_xml_symbol_node_copy (entry->node, shift, replaced, replacements));
+      else
+        ide_xml_symbol_node_take_child (copy, ide_xml_symbol_node_copy (entry->node, shift, replaced, replacements));
+    }
+
+  return copy;
+}
+
 void
 ide_xml_symbol_node_set_location (IdeXmlSymbolNode *self,
                                   GFile            *file,
@@ -48,10 +48,27 @@ typedef enum
   IDE_XML_SYMBOL_NODE_STATE_NOT_CLOSED
 } IdeXmlSymbolNodeState;
 
+/* Positions at or after (line, line_offset) are moved by line_delta lines,
+ * and by line_offset_delta bytes when they are on that same line.
+ */
+typedef struct
+{
+  gint line;
+  gint line_offset;
+  gint line_delta;
+  gint line_offset_delta;
+} IdeXmlSymbolNodeShift;
+
 IdeXmlSymbolNode                 *ide_xml_symbol_node_new                           (const gchar            *name,
                                                                                      const gchar            *value,
                                                                                      const gchar            *element_name,
                                                                                      IdeSymbolKind           kind);
+IdeXmlSymbolNode                 *ide_xml_symbol_node_copy                          (IdeXmlSymbolNode       *self,
+                                                                                     const IdeXmlSymbolNodeShift *shift,
+                                                                                     IdeXmlSymbolNode       *replaced,
+                                                                                     IdeXmlSymbolNode       *replacements);
+void                              ide_xml_symbol_node_shift                         (IdeXmlSymbolNode       *self,
+                                                                                     const IdeXmlSymbolNodeShift *shift);
 IdeXmlSymbolNodeRelativePosition  ide_xml_symbol_node_compare_location              (IdeXmlSymbolNode       *ref_node,
                                                                                      gint                    line,
                                                                                      gint                    line_offset);
@@ -309,6 +309,15 @@ ide_xml_tree_builder_parse_worker (IdeTask      *task,
   schemas = ide_xml_analysis_get_schemas (state->analysis);
   g_assert (schemas != NULL);
 
+  /* The parser reused the previous validation for this edit */
+  if (!state->analysis->needs_validation)
+    {
+      ide_task_return_pointer (task,
+                               g_steal_pointer (&state->analysis),
+                               ide_xml_analysis_unref);
+      return;
+    }
+
   context = ide_object_get_context (IDE_OBJECT (self));
   g_assert (IDE_IS_CONTEXT (context));
 
@@ -501,7 +510,10 @@ ide_xml_tree_builder_build_tree_async (IdeXmlTreeBuilder   *self,
 {
   g_autoptr(IdeTask) task = NULL;
   g_autoptr(TreeBuilderState) state = NULL;
+  g_autoptr(IdeXmlAnalysis) previous = NULL;
   g_autoptr(GBytes) content = NULL;
+  IdeXmlService *service;
+  IdeContext *context;
   gint64 sequence = 0;
 
   g_return_if_fail (IDE_IS_XML_TREE_BUILDER (self));
@@ -532,10 +544,18 @@ ide_xml_tree_builder_build_tree_async (IdeXmlTreeBuilder   *self,
                           g_steal_pointer (&state),
                           tree_builder_state_free);
 
+  /* The analysis still in the service cache lets the parser reparse only
+   * the edited element, and is released along with the cache entry.
+   */
+  context = ide_object_get_context (IDE_OBJECT (self));
+  service = ide_xml_service_from_context (context);
+  previous = ide_xml_service_get_cached_analysis (service, file);
+
   ide_xml_parser_get_analysis_async (self->parser,
                                      file,
                                      content,
                                      sequence,
+                                     previous,
                                      cancellable,
                                      ide_xml_tree_builder_build_tree_cb,
                                      g_steal_pointer (&task));
@@ -0,0 +1,205 @@
+/* test-xml-parser.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <string.h>
+
+#include <libide-code.h>
+
+#include "ide-xml-analysis.h"
+#include "ide-xml-parser.h"
+
+static const gchar *document =
+  "<?xml version=\"1.0\"?>\n"
+  "<library>\n"
+  "  <shelf name=\"fiction\">\n"
+  "    <book id=\"1\">\n"
+  "      <title>Dune</title>\n"
+  "    </book>\n"
+  "    <book id=\"2\">\n"
+  "      <title>Emma</title>\n"
+  "    </book>\n"
+  "  </shelf>\n"
+  "  <shelf name=\"poetry\">\n"
+  "    <book id=\"3\"/>\n"
+  "  </shelf>\n"
+  "</library>\n";
+
+static void
+get_analysis_cb (GObject      *object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  IdeXmlAnalysis **analysis = user_data;
+  g_autoptr(GError) error = NULL;
+
+  *analysis = ide_xml_parser_get_analysis_finish (IDE_XML_PARSER (object), result, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (*analysis);
+}
+
+static IdeXmlAnalysis *
+parse (IdeXmlParser   *parser,
+       const gchar    *text,
+       IdeXmlAnalysis *previous)
+{
+  g_autoptr(GFile) file = g_file_new_for_path ("library.xml");
+  g_autoptr(GBytes) content = g_bytes_new (text, strlen (text));
+  IdeXmlAnalysis *analysis = NULL;
+
+  ide_xml_parser_get_analysis_async (parser, file, content, 0, previous, NULL, get_analysis_cb, &analysis);
+
+  while (analysis == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  return analysis;
+}
+
+static void
+assert_same_node (IdeXmlSymbolNode *a,
+                  IdeXmlSymbolNode *b)
+{
+  gint a_pos[4];
+  gint b_pos[4];
+  guint n_children;
+
+  g_assert_cmpstr (ide_symbol_node_get_name (IDE_SYMBOL_NODE (a)), ==,
+                   ide_symbol_node_get_name (IDE_SYMBOL_NODE (b)));
+  g_assert_cmpint (ide_symbol_node_get_kind (IDE_SYMBOL_NODE (a)), ==,
+                   ide_symbol_node_get_kind (IDE_SYMBOL_NODE (b)));
+  g_assert_cmpstr (ide_xml_symbol_node_get_element_name (a), ==, ide_xml_symbol_node_get_element_name (b));
+  g_assert_cmpstr (ide_xml_symbol_node_get_value (a), ==, ide_xml_symbol_node_get_value (b));
+
+  ide_xml_symbol_node_get_location (a, &a_pos[0], &a_pos[1], &a_pos[2], &a_pos[3], NULL);
+  ide_xml_symbol_node_get_location (b, &b_pos[0], &b_pos[1], &b_pos[2], &b_pos[3], NULL);
+  for (guint i = 0; i < G_N_ELEMENTS (a_pos); i++)
+    g_assert_cmpint (a_pos[i], ==, b_pos[i]);
+
+  g_assert_cmpint (ide_xml_symbol_node_has_end_tag (a), ==, ide_xml_symbol_node_has_end_tag (b));
+  if (ide_xml_symbol_node_has_end_tag (a))
+    {
+      ide_xml_symbol_node_get_end_tag_location (a, &a_pos[0], &a_pos[1], &a_pos[2], &a_pos[3], NULL);
+      ide_xml_symbol_node_get_end_tag_location (b, &b_pos[0], &b_pos[1], &b_pos[2], &b_pos[3], NULL);
+      for (guint i = 0; i < G_N_ELEMENTS (a_pos); i++)
+        g_assert_cmpint (a_pos[i], ==, b_pos[i]);
+    }
+
+  n_children = ide_xml_symbol_node_get_n_direct_children (a);
+  g_assert_cmpint (n_children, ==, ide_xml_symbol_node_get_n_direct_children (b));
+
+  for (guint i = 0; i < n_children; i++)
+    {
+      g_autoptr(IdeSymbolNode) a_child = ide_xml_symbol_node_get_nth_direct_child (a, i);
+      g_autoptr(IdeSymbolNode) b_child = ide_xml_symbol_node_get_nth_direct_child (b, i);
+
+      assert_same_node (IDE_XML_SYMBOL_NODE (a_child), IDE_XML_SYMBOL_NODE (b_child));
+    }
+}
+
+static void
+assert_same_diagnostics (IdeDiagnostics *a,
+                         IdeDiagnostics *b)
+{
+  guint n_items = g_list_model_get_n_items (G_LIST_MODEL (a));
+
+  g_assert_cmpint (n_items, ==, g_list_model_get_n_items (G_LIST_MODEL (b)));
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autoptr(IdeDiagnostic) a_diag = g_list_model_get_item (G_LIST_MODEL (a), i);
+      g_autoptr(IdeDiagnostic) b_diag = g_list_model_get_item (G_LIST_MODEL (b), i);
+      IdeLocation *a_loc = ide_diagnostic_get_location (a_diag);
+      IdeLocation *b_loc = ide_diagnostic_get_location (b_diag);
+
+      g_assert_cmpstr (ide_diagnostic_get_text (a_diag), ==, ide_diagnostic_get_text (b_diag));
+      g_assert_cmpint (ide_location_get_line (a_loc), ==, ide_location_get_line (b_loc));
+      g_assert_cmpint (ide_location_get_line_offset (a_loc), ==, ide_location_get_line_offset (b_loc));
+    }
+}
+
+static void
+assert_reparse (const gchar *find,
+                const gchar *replace)
+{
+  g_autoptr(IdeXmlParser) parser = ide_xml_parser_new ();
+  g_autoptr(IdeXmlAnalysis) previous = NULL;
+  g_autoptr(IdeXmlAnalysis) reparsed = NULL;
+  g_autoptr(IdeXmlAnalysis) full = NULL;
+  g_autoptr(GString) edited = g_string_new (document);
+
+  g_assert_cmpint (g_string_replace (edited, find, replace, 1), ==, 1);
+
+  previous = parse (parser, document, NULL);
+  g_assert_true (previous->is_well_formed);
+  g_assert_false (previous->is_reparsed);
+
+  reparsed = parse (parser, edited->str, previous);
+  full = parse (parser, edited->str, NULL);
+
+  /* Make sure we did not fall back to a full parse */
+  g_assert_true (reparsed->is_reparsed);
+  g_assert_false (full->is_reparsed);
+  g_assert_true (reparsed->is_well_formed);
+
+  assert_same_node (ide_xml_analysis_get_root_node (reparsed),
+                    ide_xml_analysis_get_root_node (full));
+  assert_same_diagnostics (ide_xml_analysis_get_diagnostics (reparsed),
+                           ide_xml_analysis_get_diagnostics (full));
+}
+
+static void
+test_reparse_leaf_text (void)
+{
+  assert_reparse ("<title>Dune</title>", "<title>Dune Messiah</title>");
+}
+
+static void
+test_reparse_attribute (void)
+{
+  assert_reparse ("<book id=\"2\">", "<book id=\"20\" lang=\"en\">");
+}
+
+static void
+test_reparse_nested_element (void)
+{
+  assert_reparse ("<title>Emma</title>\n",
+                  "<title>Emma</title>\n"
+                  "      <author><name>Austen</name></author>\n");
+}
+
+static void
+test_reparse_line_breaks (void)
+{
+  /* Joining lines moves every element after the edit up by one line */
+  assert_reparse ("<book id=\"1\">\n      <title>", "<book id=\"1\"><title>");
+  /* And splitting the line of an element moves them down */
+  assert_reparse ("<title>Emma</title>", "<title>\n        Emma\n      </title>");
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Xml/Parser/reparse/leaf-text", test_reparse_leaf_text);
+  g_test_add_func ("/Xml/Parser/reparse/attribute", test_reparse_attribute);
+  g_test_add_func ("/Xml/Parser/reparse/nested-element", test_reparse_nested_element);
+  g_test_add_func ("/Xml/Parser/reparse/line-breaks", test_reparse_line_breaks);
+  return g_test_run ();
+}
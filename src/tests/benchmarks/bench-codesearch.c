@@ -0,0 +1,247 @@
+/* bench-codesearch.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+
+#include "code-index.h"
+
+#include "bench-corpus.h"
+#include "bench-util.h"
+
+static const GValue *
+wait_for_future (DexFuture  *future,
+                 GError    **error)
+{
+  while (dex_future_is_pending (future))
+    g_main_context_iteration (NULL, TRUE);
+
+  return dex_future_get_value (future, error);
+}
+
+static CodeIndexBuilder *
+build_index (GPtrArray *documents)
+{
+  CodeIndexBuilder *builder = code_index_builder_new ();
+
+  for (guint i = 0; i < documents->len; i++)
+    {
+      const BenchDocument *doc = g_ptr_array_index (documents, i);
+      CodeTrigramIter iter;
+      CodeTrigram trigram;
+
+      code_index_builder_begin (builder, doc->path);
+      code_trigram_iter_init (&iter, doc->contents, doc->length);
+      while (code_trigram_iter_next (&iter, &trigram))
+        code_index_builder_add (builder, &trigram);
+      code_index_builder_commit (builder);
+    }
+
+  return builder;
+}
+
+/* Mirrors what CodeQuery does for a literal: intersect the posting lists
+ * of every trigram in the needle, rarest first. @extra is intersected too
+ * when set, to measure skipping over a long list.
+ */
+static guint
+intersect (CodeIndex           *index,
+           const char          *needle,
+           const CodeIndexIter *extra)
+{
+  g_autoptr(GArray) iters = g_array_new (FALSE, FALSE, sizeof (CodeIndexIter));
+  CodeTrigramIter titer;
+  CodeTrigram trigram;
+  CodeDocument doc;
+  guint n_matches = 0;
+
+  code_trigram_iter_init (&titer, needle, -1);
+  while (code_trigram_iter_next (&titer, &trigram))
+    {
+      CodeIndexIter iter;
+
+      if (!code_index_iter_init (&iter, index, &trigram))
+        return 0;
+
+      g_array_append_val (iters, iter);
+    }
+
+  if (extra != NULL)
+    g_array_append_vals (iters, extra, 1);
+
+  if (iters->len == 0)
+    return 0;
+
+  code_index_iter_sort ((CodeIndexIter *)(gpointer)iters->data, iters->len);
+
+  while (code_index_iter_intersect ((CodeIndexIter *)(gpointer)iters->data, iters->len, &doc))
+    n_matches++;
+
+  return n_matches;
+}
+
+static void
+bench_code_index (BenchSuite *suite,
+                  const char *tmpdir)
+{
+  g_autoptr(GPtrArray) documents = NULL;
+  g_autoptr(GPtrArray) identifiers = NULL;
+  g_autoptr(CodeIndex) index = NULL;
+  g_autofree char *path = NULL;
+  BenchCase *build = bench_case_begin (suite, "code-index/build", "bytes");
+  BenchCase *write = bench_case_begin (suite, "code-index/write", "files");
+  BenchCase *load = bench_case_begin (suite, "code-index/load", "files");
+  BenchCase *decode = bench_case_begin (suite, "code-index/decode", "documents");
+  BenchCase *intersect_rare = bench_case_begin (suite, "code-index/intersect", "queries");
+  BenchCase *intersect_common = bench_case_begin (suite, "code-index/intersect-common", "queries");
+  g_autoptr(GHashTable) trigram_ids = g_hash_table_new (NULL, NULL);
+  CodeIndexIter common = {0};
+  GHashTableIter hiter;
+  gpointer key;
+  guint64 n_bytes = 0;
+  guint n_matches = 0;
+
+  documents = bench_corpus_tree (BENCH_CORPUS_SEED, bench_suite_scale (suite, 2000), 200);
+  identifiers = bench_corpus_identifiers (BENCH_CORPUS_SEED ^ 0xc0de, bench_suite_scale (suite, 500));
+  path = g_build_filename (tmpdir, "code.index", NULL);
+
+  for (guint i = 0; i < documents->len; i++)
+    n_bytes += ((const BenchDocument *)g_ptr_array_index (documents, i))->length;
+
+  for (guint i = 0; i < 3; i++)
+    {
+      g_autoptr(CodeIndexBuilder) builder = NULL;
+      g_autoptr(GError) error = NULL;
+      DexFuture *future;
+      gint64 begin;
+
+      begin = bench_now ();
+      builder = build_index (documents);
+      bench_case_sample (build, begin, n_bytes);
+
+      begin = bench_now ();
+      future = code_index_builder_write_filename (builder, path, G_PRIORITY_DEFAULT);
+      wait_for_future (future, &error);
+      dex_unref (future);
+      g_assert_no_error (error);
+      bench_case_sample (write, begin, 1);
+    }
+
+  for (guint i = 0; i < 20; i++)
+    {
+      g_autoptr(GError) error = NULL;
+      gint64 begin = bench_now ();
+
+      g_clear_pointer (&index, code_index_unref);
+      index = code_index_new (path, &error);
+      g_assert_no_error (error);
+      bench_case_sample (load, begin, 1);
+    }
+
+  /* Walk the posting lists of the trigrams found in a sample of the
+   * corpus, remembering the longest one for the intersections below.
+   */
+  for (guint i = 0; i < MIN (documents->len, 100); i++)
+    {
+      const BenchDocument *doc = g_ptr_array_index (documents, i);
+      CodeTrigramIter titer;
+      CodeTrigram trigram;
+
+      code_trigram_iter_init (&titer, doc->contents, doc->length);
+      while (code_trigram_iter_next (&titer, &trigram))
+        g_hash_table_add (trigram_ids, GUINT_TO_POINTER (code_trigram_encode (&trigram) + 1));
+    }
+
+  for (guint i = 0; i < 5; i++)
+    {
+      gint64 begin = bench_now ();
+      guint64 n_documents = 0;
+
+      g_hash_table_iter_init (&hiter, trigram_ids);
+      while (g_hash_table_iter_next (&hiter, &key, NULL))
+        {
+          CodeTrigram trigram = code_trigram_decode (GPOINTER_TO_UINT (key) - 1);
+          CodeIndexIter iter;
+          CodeDocument doc;
+
+          if (!code_index_iter_init (&iter, index, &trigram))
+            continue;
+
+          if (code_index_iter_get_n_documents (&iter) > code_index_iter_get_n_documents (&common))
+            common = iter;
+
+          while (code_index_iter_next (&iter, &doc))
+            n_documents++;
+        }
+
+      bench_case_sample (decode, begin, n_documents);
+      bench_case_count (decode, "trigrams", g_hash_table_size (trigram_ids));
+    }
+
+  for (guint i = 0; i < identifiers->len; i++)
+    {
+      const char *needle = g_ptr_array_index (identifiers, i);
+      gint64 begin;
+
+      begin = bench_now ();
+      n_matches += intersect (index, needle, NULL);
+      bench_case_sample (intersect_rare, begin, 1);
+
+      /* A rare needle along with a trigram found nearly everywhere */
+      begin = bench_now ();
+      n_matches += intersect (index, needle, common.index ? &common : NULL);
+      bench_case_sample (intersect_common, begin, 1);
+      bench_case_count (intersect_common, "common-documents", code_index_iter_get_n_documents (&common));
+    }
+
+  g_debug ("%u documents matched", n_matches);
+
+  g_unlink (path);
+
+  bench_case_end (build);
+  bench_case_end (write);
+  bench_case_end (load);
+  bench_case_end (decode);
+  bench_case_end (intersect_rare);
+  bench_case_end (intersect_common);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GError) error = NULL;
+  g_autofree char *tmpdir = NULL;
+  BenchSuite *suite;
+
+  dex_init ();
+
+  suite = bench_suite_new ("codesearch", &argc, &argv);
+
+  if (!(tmpdir = g_dir_make_tmp ("bench-codesearch-XXXXXX", &error)))
+    g_error ("%s", error->message);
+
+  bench_code_index (suite, tmpdir);
+
+  g_rmdir (tmpdir);
+
+  return bench_suite_finish (suite);
+}
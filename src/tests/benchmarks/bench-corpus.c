@@ -0,0 +1,336 @@
+/* bench-corpus.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "bench-corpus.h"
+
+static const char *syllables[] = {
+  "blame", "buf", "build", "code", "ctx", "diag", "doc", "fer", "file",
+  "fuzzy", "get", "git", "heap", "hunk", "index", "iter", "key", "len",
+  "line", "log", "map", "match", "node", "path", "pipe", "pos", "ptr",
+  "region", "run", "scope", "search", "set", "src", "str", "symbol",
+  "tag", "task", "text", "tree", "val", "view", "widget", "word",
+};
+
+static const char *prefixes[] = {
+  "", "", "", "ide_", "g_", "gtk_", "code_", "_",
+};
+
+static const char *kinds[] = { "f", "v", "s", "m", "t", "d", "e" };
+
+static const char *
+random_syllable (GRand *rand)
+{
+  return syllables[g_rand_int_range (rand, 0, G_N_ELEMENTS (syllables))];
+}
+
+static char *
+random_identifier (GRand *rand)
+{
+  GString *str = g_string_new (NULL);
+  guint n_parts = g_rand_int_range (rand, 2, 5);
+  guint style = g_rand_int_range (rand, 0, 4);
+
+  if (style == 0)
+    g_string_append (str, prefixes[g_rand_int_range (rand, 0, G_N_ELEMENTS (prefixes))]);
+
+  for (guint i = 0; i < n_parts; i++)
+    {
+      const char *part = random_syllable (rand);
+
+      switch (style)
+        {
+        case 0: /* snake_case */
+          if (i > 0)
+            g_string_append_c (str, '_');
+          g_string_append (str, part);
+          break;
+
+        case 1: /* CamelCase */
+          g_string_append_c (str, g_ascii_toupper (part[0]));
+          g_string_append (str, part + 1);
+          break;
+
+        case 2: /* lowerCamelCase */
+          g_string_append_c (str, i > 0 ? g_ascii_toupper (part[0]) : part[0]);
+          g_string_append (str, part + 1);
+          break;
+
+        case 3: /* UPPER_SNAKE */
+        default:
+          if (i > 0)
+            g_string_append_c (str, '_');
+          for (const char *c = part; *c; c++)
+            g_string_append_c (str, g_ascii_toupper (*c));
+          break;
+        }
+    }
+
+  return g_string_free (str, FALSE);
+}
+
+/**
+ * bench_corpus_identifiers:
+ * @seed: the seed for the generator
+ * @n_identifiers: the number of identifiers to generate
+ *
+ * Generates unique identifiers in a mix of the naming styles that
+ * show up in C, Python and JavaScript projects.
+ *
+ * Returns: (transfer full): a #GPtrArray of strings
+ */
+GPtrArray *
+bench_corpus_identifiers (guint32 seed,
+                          guint   n_identifiers)
+{
+  g_autoptr(GHashTable) seen = g_hash_table_new (g_str_hash, g_str_equal);
+  g_autoptr(GRand) rand = g_rand_new_with_seed (seed);
+  GPtrArray *ar = g_ptr_array_new_full (n_identifiers, g_free);
+
+  while (ar->len < n_identifiers)
+    {
+      char *ident = random_identifier (rand);
+
+      /* Disambiguate collisions deterministically rather than retrying
+       * so the size of the corpus never depends on luck.
+       */
+      if (g_hash_table_contains (seen, ident))
+        {
+          char *tmp = g_strdup_printf ("%s%u", ident, ar->len);
+          g_free (ident);
+          ident = tmp;
+        }
+
+      g_hash_table_add (seen, ident);
+      g_ptr_array_add (ar, ident);
+    }
+
+  return ar;
+}
+
+/**
+ * bench_corpus_queries:
+ * @seed: the seed for the generator
+ * @identifiers: identifiers from bench_corpus_identifiers()
+ * @n_queries: the number of queries to generate
+ *
+ * Generates fuzzy queries by taking an in-order subsequence of a random
+ * identifier, which is what users type into the global search.
+ *
+ * Returns: (transfer full): a #GPtrArray of strings
+ */
+GPtrArray *
+bench_corpus_queries (guint32    seed,
+                      GPtrArray *identifiers,
+                      guint      n_queries)
+{
+  g_autoptr(GRand) rand = g_rand_new_with_seed (seed);
+  GPtrArray *ar = g_ptr_array_new_full (n_queries, g_free);
+
+  g_return_val_if_fail (identifiers != NULL, ar);
+  g_return_val_if_fail (identifiers->len > 0, ar);
+
+  for (guint i = 0; i < n_queries; i++)
+    {
+      const char *ident = g_ptr_array_index (identifiers, g_rand_int_range (rand, 0, identifiers->len));
+      gsize len = strlen (ident);
+      guint n_chars = g_rand_int_range (rand, 2, 6);
+      GString *query = g_string_new (NULL);
+      gsize pos = 0;
+
+      while (query->len < n_chars && pos < len)
+        {
+          pos += g_rand_int_range (rand, 0, 3);
+          if (pos >= len)
+            break;
+          if (ident[pos] != '_')
+            g_string_append_c (query, g_ascii_tolower (ident[pos]));
+          pos++;
+        }
+
+      if (query->len == 0)
+        g_string_append_c (query, g_ascii_tolower (ident[0]));
+
+      g_ptr_array_add (ar, g_string_free (query, FALSE));
+    }
+
+  return ar;
+}
+
+static void
+append_source_line (GString *str,
+                    GRand   *rand)
+{
+  guint depth = g_rand_int_range (rand, 0, 4);
+  g_autofree char *a = random_identifier (rand);
+  g_autofree char *b = random_identifier (rand);
+
+  for (guint i = 0; i < depth; i++)
+    g_string_append (str, "  ");
+
+  switch (g_rand_int_range (rand, 0, 6))
+    {
+    case 0:
+      break;
+
+    case 1:
+      g_string_append_printf (str, "/* %s %s */", a, b);
+      break;
+
+    case 2:
+      g_string_append_printf (str, "if (%s != NULL)", a);
+      break;
+
+    case 3:
+      g_string_append_printf (str, "%s = %s (self, %u);", a, b, g_rand_int_range (rand, 0, 1000));
+      break;
+
+    case 4:
+      g_string_append_printf (str, "g_autoptr(%s) %s = NULL;", a, b);
+      break;
+
+    case 5:
+    default:
+      g_string_append_printf (str, "return %s (%s);", a, b);
+      break;
+    }
+
+  g_string_append_c (str, '\n');
+}
+
+/**
+ * bench_corpus_source:
+ * @seed: the seed for the generator
+ * @n_lines: the number of lines to generate
+ * @length: (out): location for the length in bytes
+ *
+ * Generates C-like source text with varying indentation, comments
+ * and blank lines.
+ *
+ * Returns: (transfer full): a newly allocated string
+ */
+char *
+bench_corpus_source (guint32  seed,
+                     guint    n_lines,
+                     gsize   *length)
+{
+  g_autoptr(GRand) rand = g_rand_new_with_seed (seed);
+  GString *str = g_string_sized_new (n_lines * 40);
+
+  for (guint i = 0; i < n_lines; i++)
+    append_source_line (str, rand);
+
+  if (length != NULL)
+    *length = str->len;
+
+  return g_string_free (str, FALSE);
+}
+
+/**
+ * bench_corpus_tags:
+ * @seed: the seed for the generator
+ * @n_tags: the number of tags to generate
+ * @length: (out): location for the length in bytes
+ *
+ * Generates a sorted tags file in the extended format produced by
+ * Universal Ctags.
+ *
+ * Returns: (transfer full): a newly allocated string
+ */
+char *
+bench_corpus_tags (guint32  seed,
+                   guint    n_tags,
+                   gsize   *length)
+{
+  g_autoptr(GPtrArray) names = bench_corpus_identifiers (seed, n_tags);
+  g_autoptr(GRand) rand = g_rand_new_with_seed (seed ^ 0x7a6);
+  GString *str = g_string_sized_new (n_tags * 80);
+
+  g_ptr_array_sort (names, (GCompareFunc)g_strcmp0);
+
+  g_string_append (str, "!_TAG_FILE_FORMAT\t2\t/extended format/\n");
+  g_string_append (str, "!_TAG_FILE_SORTED\t1\t/0=unsorted, 1=sorted, 2=foldcase/\n");
+
+  for (guint i = 0; i < names->len; i++)
+    {
+      const char *name = g_ptr_array_index (names, i);
+
+      g_string_append_printf (str,
+                              "%s\tsrc/%s/%s.c\t/^%s (void)$/;\"\t%s\tline:%u\n",
+                              name,
+                              random_syllable (rand),
+                              random_syllable (rand),
+                              name,
+                              kinds[g_rand_int_range (rand, 0, G_N_ELEMENTS (kinds))],
+                              g_rand_int_range (rand, 1, 5000));
+    }
+
+  if (length != NULL)
+    *length = str->len;
+
+  return g_string_free (str, FALSE);
+}
+
+static void
+bench_document_free (BenchDocument *doc)
+{
+  g_free (doc->path);
+  g_free (doc->contents);
+  g_free (doc);
+}
+
+/**
+ * bench_corpus_tree:
+ * @seed: the seed for the generator
+ * @n_documents: the number of documents to generate
+ * @n_lines_per_document: the average number of lines per document
+ *
+ * Generates an in-memory source tree. Nothing is written to disk so
+ * that benchmarks which do not measure I/O are not perturbed by it.
+ *
+ * Returns: (transfer full): a #GPtrArray of #BenchDocument
+ */
+GPtrArray *
+bench_corpus_tree (guint32 seed,
+                   guint   n_documents,
+                   guint   n_lines_per_document)
+{
+  g_autoptr(GRand) rand = g_rand_new_with_seed (seed);
+  GPtrArray *ar = g_ptr_array_new_full (n_documents, (GDestroyNotify)bench_document_free);
+
+  for (guint i = 0; i < n_documents; i++)
+    {
+      BenchDocument *doc = g_new0 (BenchDocument, 1);
+      guint n_lines = g_rand_int_range (rand, n_lines_per_document / 2 + 1, n_lines_per_document * 3 / 2 + 2);
+
+      doc->path = g_strdup_printf ("src/%s/%s-%u.c",
+                                   random_syllable (rand),
+                                   random_syllable (rand),
+                                   i);
+      doc->contents = bench_corpus_source (g_rand_int (rand), n_lines, &doc->length);
+
+      g_ptr_array_add (ar, doc);
+    }
+
+  return ar;
+}
@@ -0,0 +1,54 @@
+/* bench-corpus.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* All corpora are generated from a fixed seed so that two builds
+ * being compared see byte-for-byte identical input.
+ */
+#define BENCH_CORPUS_SEED 0x1de5eed
+
+typedef struct _BenchDocument
+{
+  char  *path;
+  char  *contents;
+  gsize  length;
+} BenchDocument;
+
+GPtrArray *bench_corpus_identifiers (guint32    seed,
+                                     guint      n_identifiers);
+GPtrArray *bench_corpus_queries     (guint32    seed,
+                                     GPtrArray *identifiers,
+                                     guint      n_queries);
+char      *bench_corpus_source      (guint32    seed,
+                                     guint      n_lines,
+                                     gsize     *length);
+char      *bench_corpus_tags        (guint32    seed,
+                                     guint      n_tags,
+                                     gsize     *length);
+GPtrArray *bench_corpus_tree        (guint32    seed,
+                                     guint      n_documents,
+                                     guint      n_lines_per_document);
+
+G_END_DECLS
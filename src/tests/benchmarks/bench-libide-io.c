@@ -0,0 +1,331 @@
+/* bench-libide-io.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include <libide-io.h>
+
+#include "bench-corpus.h"
+#include "bench-util.h"
+
+static void
+bench_line_reader (BenchSuite *suite,
+                   const char *name,
+                   char       *contents,
+                   gsize       length)
+{
+  BenchCase *bench = bench_case_begin (suite, name, "lines");
+  guint iterations = bench_suite_scale (suite, 50);
+
+  for (guint i = 0; i < iterations; i++)
+    {
+      IdeLineReader reader;
+      gint64 begin = bench_now ();
+      guint n_lines = 0;
+      gsize len;
+
+      ide_line_reader_init (&reader, contents, length);
+      while (ide_line_reader_next (&reader, &len))
+        n_lines++;
+
+      bench_case_sample (bench, begin, n_lines);
+    }
+
+  bench_case_end (bench);
+}
+
+static int
+compare_guint (gconstpointer a,
+               gconstpointer b)
+{
+  guint aval = *(const guint *)a;
+  guint bval = *(const guint *)b;
+
+  return aval < bval ? -1 : aval > bval ? 1 : 0;
+}
+
+static void
+bench_heap (BenchSuite *suite)
+{
+  g_autoptr(GRand) rand = g_rand_new_with_seed (BENCH_CORPUS_SEED);
+  g_autofree guint *values = NULL;
+  BenchCase *insert = bench_case_begin (suite, "heap/insert", "items");
+  BenchCase *extract = bench_case_begin (suite, "heap/extract", "items");
+  guint iterations = bench_suite_scale (suite, 20);
+  guint n_values = 100000;
+
+  values = g_new (guint, n_values);
+  for (guint i = 0; i < n_values; i++)
+    values[i] = g_rand_int (rand);
+
+  for (guint i = 0; i < iterations; i++)
+    {
+      IdeHeap *heap = ide_heap_new (sizeof (guint), compare_guint);
+      gint64 begin;
+      guint val;
+
+      begin = bench_now ();
+      for (guint j = 0; j < n_values; j++)
+        ide_heap_insert_val (heap, values[j]);
+      bench_case_sample (insert, begin, n_values);
+
+      begin = bench_now ();
+      while (ide_heap_extract (heap, &val)) { }
+      bench_case_sample (extract, begin, n_values);
+
+      ide_heap_unref (heap);
+    }
+
+  bench_case_end (insert);
+  bench_case_end (extract);
+}
+
+static void
+bench_persistent_map (BenchSuite *suite,
+                      const char *tmpdir)
+{
+  g_autoptr(GPtrArray) keys = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autofree char *path = NULL;
+  BenchCase *write = bench_case_begin (suite, "persistent-map/build+write", "keys");
+  BenchCase *load = bench_case_begin (suite, "persistent-map/load", "files");
+  BenchCase *lookup = bench_case_begin (suite, "persistent-map/lookup", "keys");
+  guint n_keys = bench_suite_scale (suite, 50000);
+
+  keys = bench_corpus_identifiers (BENCH_CORPUS_SEED, n_keys);
+  path = g_build_filename (tmpdir, "persistent-map.gvariant", NULL);
+  file = g_file_new_for_path (path);
+
+  for (guint i = 0; i < 5; i++)
+    {
+      g_autoptr(IdePersistentMapBuilder) builder = ide_persistent_map_builder_new ();
+      g_autoptr(GError) error = NULL;
+      gint64 begin = bench_now ();
+
+      for (guint j = 0; j < keys->len; j++)
+        ide_persistent_map_builder_insert (builder,
+                                           g_ptr_array_index (keys, j),
+                                           g_variant_new_uint32 (j),
+                                           TRUE);
+      ide_persistent_map_builder_write (builder, file, G_PRIORITY_DEFAULT, NULL, &error);
+      g_assert_no_error (error);
+
+      bench_case_sample (write, begin, keys->len);
+    }
+
+  for (guint i = 0; i < 20; i++)
+    {
+      g_autoptr(IdePersistentMap) map = ide_persistent_map_new ();
+      g_autoptr(GError) error = NULL;
+      gint64 begin = bench_now ();
+
+      ide_persistent_map_load_file (map, file, NULL, &error);
+      g_assert_no_error (error);
+
+      bench_case_sample (load, begin, 1);
+
+      if (i == 0)
+        {
+          /* Sample in batches so each latency is above timer resolution */
+          for (guint j = 0; j < keys->len; j += 100)
+            {
+              guint end = MIN (j + 100, keys->len);
+
+              begin = bench_now ();
+              for (guint k = j; k < end; k++)
+                {
+                  g_autoptr(GVariant) value = ide_persistent_map_lookup_value (map, g_ptr_array_index (keys, k));
+                  g_assert (value != NULL);
+                }
+              bench_case_sample (lookup, begin, end - j);
+            }
+        }
+    }
+
+  g_file_delete (file, NULL, NULL);
+
+  bench_case_end (write);
+  bench_case_end (load);
+  bench_case_end (lookup);
+}
+
+typedef struct
+{
+  IdePtyFd fd;
+  gsize    len;
+} PtyWriter;
+
+static gpointer
+pty_write_thread (gpointer data)
+{
+  PtyWriter *writer = data;
+  char buf[4096];
+
+  memset (buf, 'x', sizeof buf);
+
+  while (writer->len > 0)
+    {
+      gssize n_written = write (writer->fd, buf, MIN (sizeof buf, writer->len));
+
+      if (n_written < 0 && errno == EINTR)
+        continue;
+
+      g_assert (n_written > 0);
+      writer->len -= n_written;
+    }
+
+  return NULL;
+}
+
+static void
+pty_observe_cb (const IdePtyIntercept     *intercept,
+                const IdePtyInterceptSide *side,
+                const guint8              *data,
+                gsize                      len,
+                gpointer                   user_data)
+{
+  guint *n_callbacks = user_data;
+
+  (*n_callbacks)++;
+}
+
+/* Reads from the terminal side until @len bytes arrived, dispatching
+ * the intercept callbacks like a main loop would.
+ */
+static void
+pty_drain (IdePtyFd terminal_fd,
+           gsize    len)
+{
+  while (len > 0)
+    {
+      struct pollfd pfd = { .fd = terminal_fd, .events = POLLIN };
+      char buf[4096 * 4];
+      gssize n;
+
+      while (g_main_context_iteration (NULL, FALSE)) { }
+
+      if (poll (&pfd, 1, 1) <= 0)
+        continue;
+
+      while (len > 0 && (n = read (terminal_fd, buf, sizeof buf)) > 0)
+        len -= n;
+    }
+}
+
+static void
+bench_pty_intercept (BenchSuite *suite)
+{
+  g_auto(IdePtyFd) terminal_fd = IDE_PTY_FD_INVALID;
+  g_auto(IdePtyFd) inferior_fd = IDE_PTY_FD_INVALID;
+  BenchCase *throughput;
+  BenchCase *latency;
+  IdePtyIntercept intercept;
+  guint iterations = bench_suite_scale (suite, 10);
+  guint n_callbacks = 0;
+  gsize len = 1024 * 1024 * 16;
+
+  if ((terminal_fd = ide_pty_intercept_create_consumer ()) == IDE_PTY_FD_INVALID ||
+      !ide_pty_intercept_init (&intercept, terminal_fd, NULL))
+    {
+      g_printerr ("PTYs are not available, skipping pty-intercept\n");
+      return;
+    }
+
+  ide_pty_intercept_set_callback (&intercept, &intercept.consumer, pty_observe_cb, &n_callbacks);
+  inferior_fd = ide_pty_intercept_create_producer (ide_pty_intercept_get_fd (&intercept), TRUE);
+  g_assert (inferior_fd != IDE_PTY_FD_INVALID);
+
+  throughput = bench_case_begin (suite, "pty-intercept/throughput", "bytes");
+
+  for (guint i = 0; i < iterations; i++)
+    {
+      PtyWriter writer = { inferior_fd, len };
+      gint64 begin = bench_now ();
+      GThread *thread;
+
+      n_callbacks = 0;
+      thread = g_thread_new ("writer", pty_write_thread, &writer);
+      pty_drain (terminal_fd, len);
+      g_thread_join (thread);
+
+      bench_case_sample (throughput, begin, len);
+      bench_case_count (throughput, "callbacks", n_callbacks);
+    }
+
+  bench_case_end (throughput);
+
+  /* Time from the inferior writing a keystroke echo until the terminal
+   * can read it, which is what typing into a running program feels like.
+   */
+  latency = bench_case_begin (suite, "pty-intercept/latency", "writes");
+
+  for (guint i = 0; i < iterations * 50; i++)
+    {
+      gint64 begin = bench_now ();
+      gssize n_written;
+
+      n_written = write (inferior_fd, "x", 1);
+      g_assert (n_written == 1);
+      pty_drain (terminal_fd, 1);
+
+      bench_case_sample (latency, begin, 1);
+    }
+
+  bench_case_end (latency);
+
+  ide_pty_intercept_clear (&intercept);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GError) error = NULL;
+  g_autofree char *source = NULL;
+  g_autofree char *tags = NULL;
+  g_autofree char *tmpdir = NULL;
+  BenchSuite *suite;
+  gsize source_len;
+  gsize tags_len;
+
+  suite = bench_suite_new ("libide-io", &argc, &argv);
+
+  if (!(tmpdir = g_dir_make_tmp ("bench-libide-io-XXXXXX", &error)))
+    g_error ("%s", error->message);
+
+  source = bench_corpus_source (BENCH_CORPUS_SEED, bench_suite_scale (suite, 100000), &source_len);
+  tags = bench_corpus_tags (BENCH_CORPUS_SEED, bench_suite_scale (suite, 50000), &tags_len);
+
+  bench_line_reader (suite, "line-reader/source", source, source_len);
+  bench_line_reader (suite, "line-reader/tags", tags, tags_len);
+  bench_heap (suite);
+  bench_persistent_map (suite, tmpdir);
+  bench_pty_intercept (suite);
+
+  g_rmdir (tmpdir);
+
+  return bench_suite_finish (suite);
+}
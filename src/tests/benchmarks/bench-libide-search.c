@@ -0,0 +1,195 @@
+/* bench-libide-search.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+
+#include <libide-search.h>
+
+#include "bench-corpus.h"
+#include "bench-util.h"
+
+static void
+bench_fuzzy_mutable_index (BenchSuite *suite,
+                           GPtrArray  *identifiers,
+                           GPtrArray  *queries)
+{
+  g_autoptr(IdeFuzzyMutableIndex) fuzzy = NULL;
+  BenchCase *insert = bench_case_begin (suite, "fuzzy-mutable-index/bulk-insert", "keys");
+  BenchCase *match = bench_case_begin (suite, "fuzzy-mutable-index/match", "queries");
+
+  for (guint i = 0; i < 5; i++)
+    {
+      gint64 begin;
+
+      g_clear_pointer (&fuzzy, ide_fuzzy_mutable_index_unref);
+      fuzzy = ide_fuzzy_mutable_index_new (FALSE);
+
+      begin = bench_now ();
+      ide_fuzzy_mutable_index_begin_bulk_insert (fuzzy);
+      for (guint j = 0; j < identifiers->len; j++)
+        ide_fuzzy_mutable_index_insert (fuzzy, g_ptr_array_index (identifiers, j), GUINT_TO_POINTER (j + 1));
+      ide_fuzzy_mutable_index_end_bulk_insert (fuzzy);
+      bench_case_sample (insert, begin, identifiers->len);
+    }
+
+  for (guint i = 0; i < queries->len; i++)
+    {
+      g_autoptr(GArray) matches = NULL;
+      gint64 begin = bench_now ();
+
+      matches = ide_fuzzy_mutable_index_match (fuzzy, g_ptr_array_index (queries, i), 100);
+      bench_case_sample (match, begin, 1);
+    }
+
+  bench_case_end (insert);
+  bench_case_end (match);
+}
+
+typedef struct
+{
+  GMainLoop  *main_loop;
+  GListModel *model;
+  GError     *error;
+} QueryState;
+
+static void
+query_cb (GObject      *object,
+          GAsyncResult *result,
+          gpointer      user_data)
+{
+  QueryState *state = user_data;
+
+  state->model = ide_fuzzy_index_query_finish (IDE_FUZZY_INDEX (object), result, &state->error);
+  g_main_loop_quit (state->main_loop);
+}
+
+static void
+bench_fuzzy_index (BenchSuite *suite,
+                   GPtrArray  *identifiers,
+                   GPtrArray  *queries,
+                   const char *tmpdir)
+{
+  g_autoptr(IdeFuzzyIndex) index = NULL;
+  g_autoptr(GMainLoop) main_loop = g_main_loop_new (NULL, FALSE);
+  g_autoptr(GFile) file = NULL;
+  g_autofree char *path = NULL;
+  BenchCase *write = bench_case_begin (suite, "fuzzy-index/build+write", "keys");
+  BenchCase *load = bench_case_begin (suite, "fuzzy-index/load", "files");
+  BenchCase *query = bench_case_begin (suite, "fuzzy-index/query", "queries");
+  BenchCase *cursor = bench_case_begin (suite, "fuzzy-index/cursor-iterate", "matches");
+
+  path = g_build_filename (tmpdir, "fuzzy.index", NULL);
+  file = g_file_new_for_path (path);
+
+  for (guint i = 0; i < 3; i++)
+    {
+      g_autoptr(IdeFuzzyIndexBuilder) builder = ide_fuzzy_index_builder_new ();
+      g_autoptr(GError) error = NULL;
+      gint64 begin = bench_now ();
+
+      for (guint j = 0; j < identifiers->len; j++)
+        ide_fuzzy_index_builder_insert (builder,
+                                        g_ptr_array_index (identifiers, j),
+                                        g_variant_new_uint32 (j),
+                                        0);
+      ide_fuzzy_index_builder_write (builder, file, G_PRIORITY_DEFAULT, NULL, &error);
+      g_assert_no_error (error);
+
+      bench_case_sample (write, begin, identifiers->len);
+    }
+
+  for (guint i = 0; i < 20; i++)
+    {
+      g_autoptr(GError) error = NULL;
+      gint64 begin;
+
+      g_clear_object (&index);
+      index = ide_fuzzy_index_new ();
+
+      begin = bench_now ();
+      ide_fuzzy_index_load_file (index, file, NULL, &error);
+      g_assert_no_error (error);
+      bench_case_sample (load, begin, 1);
+    }
+
+  /* Queries complete on a worker thread, so the latency measured here
+   * includes the round-trip through the main loop like real callers.
+   */
+  for (guint i = 0; i < queries->len; i++)
+    {
+      QueryState state = { main_loop, NULL, NULL };
+      guint n_items;
+      gint64 begin;
+
+      begin = bench_now ();
+      ide_fuzzy_index_query_async (index, g_ptr_array_index (queries, i), 100, NULL, query_cb, &state);
+      g_main_loop_run (main_loop);
+      bench_case_sample (query, begin, 1);
+
+      g_assert_no_error (state.error);
+      g_assert_nonnull (state.model);
+
+      begin = bench_now ();
+      n_items = g_list_model_get_n_items (state.model);
+      for (guint j = 0; j < n_items; j++)
+        {
+          g_autoptr(IdeFuzzyIndexMatch) match = g_list_model_get_item (state.model, j);
+          g_assert (ide_fuzzy_index_match_get_key (match) != NULL);
+        }
+      bench_case_sample (cursor, begin, n_items);
+
+      g_clear_object (&state.model);
+    }
+
+  g_file_delete (file, NULL, NULL);
+
+  bench_case_end (write);
+  bench_case_end (load);
+  bench_case_end (query);
+  bench_case_end (cursor);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GPtrArray) identifiers = NULL;
+  g_autoptr(GPtrArray) queries = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *tmpdir = NULL;
+  BenchSuite *suite;
+
+  suite = bench_suite_new ("libide-search", &argc, &argv);
+
+  if (!(tmpdir = g_dir_make_tmp ("bench-libide-search-XXXXXX", &error)))
+    g_error ("%s", error->message);
+
+  identifiers = bench_corpus_identifiers (BENCH_CORPUS_SEED, bench_suite_scale (suite, 100000));
+  queries = bench_corpus_queries (BENCH_CORPUS_SEED, identifiers, bench_suite_scale (suite, 500));
+
+  bench_fuzzy_mutable_index (suite, identifiers, queries);
+  bench_fuzzy_index (suite, identifiers, queries, tmpdir);
+
+  g_rmdir (tmpdir);
+
+  return bench_suite_finish (suite);
+}
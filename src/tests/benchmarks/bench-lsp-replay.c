@@ -0,0 +1,422 @@
+/* bench-lsp-replay.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+
+#include <libide-lsp.h>
+
+#include "ide-lsp-replay-private.h"
+
+#include "bench-util.h"
+
+/* Replays a language server session recorded with IDE_LSP_RECORD_DIR
+ * against IdeLspClient. Every request and notification the client made
+ * on behalf of an editor is issued again through the public API, while
+ * the messages the client sends on its own (initialize, shutdown, ...)
+ * are left to the client. Pass a recording on the command line to
+ * replay it instead of the bundled session.
+ *
+ * Besides latency, each case counts the time spent handling server
+ * messages on the main thread and the number of allocations made by
+ * the main thread.
+ */
+
+#ifdef __GLIBC__
+extern void *__libc_malloc  (size_t size);
+extern void *__libc_calloc  (size_t n_members, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static __thread guint64 n_allocations;
+
+void *
+malloc (size_t size)
+{
+  n_allocations++;
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n_members,
+        size_t size)
+{
+  n_allocations++;
+  return __libc_calloc (n_members, size);
+}
+
+void *
+realloc (void   *ptr,
+         size_t  size)
+{
+  n_allocations++;
+  return __libc_realloc (ptr, size);
+}
+#else
+static guint64 n_allocations;
+#endif
+
+static const char *automatic_methods[] = {
+  "initialize",
+  "initialized",
+  "shutdown",
+  "exit",
+  "$/cancelRequest",
+  "workspace/didChangeConfiguration",
+  "workspace/didChangeWorkspaceFolders",
+};
+
+typedef struct
+{
+  char     *method;
+  GVariant *params;
+  guint     is_request : 1;
+  guint     expects_diagnostics : 1;
+} Step;
+
+typedef struct
+{
+  GVariant *reply;
+  GError   *error;
+  gboolean  done;
+} Call;
+
+static void
+step_free (gpointer data)
+{
+  Step *step = data;
+
+  g_clear_pointer (&step->method, g_free);
+  g_clear_pointer (&step->params, g_variant_unref);
+  g_free (step);
+}
+
+static gboolean
+is_automatic (const char *method)
+{
+  if (method == NULL)
+    return TRUE;
+
+  for (guint i = 0; i < G_N_ELEMENTS (automatic_methods); i++)
+    {
+      if (g_str_equal (method, automatic_methods[i]))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static GPtrArray *
+load_steps (GFile *file)
+{
+  g_autoptr(GPtrArray) steps = g_ptr_array_new_with_free_func (step_free);
+  g_autoptr(GError) error = NULL;
+  g_autofree char *contents = NULL;
+  g_auto(GStrv) lines = NULL;
+  Step *last = NULL;
+
+  if (!g_file_load_contents (file, NULL, &contents, NULL, NULL, &error))
+    g_error ("%s", error->message);
+
+  lines = g_strsplit (contents, "\n", 0);
+
+  for (guint i = 0; lines[i]; i++)
+    {
+      g_autoptr(JsonParser) parser = json_parser_new_immutable ();
+      JsonObject *record;
+      JsonObject *message;
+      const char *direction;
+      const char *method;
+      Step *step;
+
+      if (lines[i][0] == 0)
+        continue;
+
+      if (!json_parser_load_from_data (parser, lines[i], -1, &error))
+        g_error ("Line %u: %s", i + 1, error->message);
+
+      record = json_node_get_object (json_parser_get_root (parser));
+      message = json_object_get_object_member (record, "message");
+      direction = json_object_get_string_member (record, "direction");
+      method = json_object_get_string_member_with_default (message, "method", NULL);
+
+      if (g_str_equal (direction, "recv"))
+        {
+          if (last != NULL && !last->is_request &&
+              g_strcmp0 (method, "textDocument/publishDiagnostics") == 0)
+            last->expects_diagnostics = TRUE;
+          continue;
+        }
+
+      if (is_automatic (method))
+        continue;
+
+      step = g_new0 (Step, 1);
+      step->method = g_strdup (method);
+      step->is_request = json_object_has_member (message, "id");
+
+      if (json_object_has_member (message, "params") &&
+          !json_object_get_null_member (message, "params"))
+        {
+          if (!(step->params = json_gvariant_deserialize (json_object_get_member (message, "params"), NULL, &error)))
+            g_error ("Line %u: %s", i + 1, error->message);
+          g_variant_take_ref (step->params);
+        }
+
+      g_ptr_array_add (steps, step);
+      last = step;
+    }
+
+  return g_steal_pointer (&steps);
+}
+
+typedef struct
+{
+  BenchSuite *suite;
+  GHashTable *by_name;
+  GPtrArray  *ordered;
+} Cases;
+
+static BenchCase *
+get_case (Cases      *cases,
+          const char *name,
+          const char *unit)
+{
+  BenchCase *bench;
+
+  if (!(bench = g_hash_table_lookup (cases->by_name, name)))
+    {
+      g_autofree char *full_name = g_strdup_printf ("lsp-replay/%s", name);
+
+      bench = bench_case_begin (cases->suite, full_name, unit);
+      g_hash_table_insert (cases->by_name, g_strdup (name), bench);
+      g_ptr_array_add (cases->ordered, bench);
+    }
+
+  return bench;
+}
+
+static guint64
+get_main_thread_usec (IdeLspClient *client)
+{
+  g_autoptr(GVariant) stats = ide_lsp_client_dup_traffic_stats (client);
+  guint64 value = 0;
+
+  g_variant_lookup (stats, "main-thread-usec", "t", &value);
+
+  return value;
+}
+
+static void
+call_cb (GObject      *object,
+         GAsyncResult *result,
+         gpointer      user_data)
+{
+  Call *call = user_data;
+
+  ide_lsp_client_call_finish (IDE_LSP_CLIENT (object), result, &call->reply, &call->error);
+  call->done = TRUE;
+}
+
+static void
+notification_cb (GObject      *object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  Call *call = user_data;
+
+  ide_lsp_client_send_notification_finish (IDE_LSP_CLIENT (object), result, &call->error);
+  call->done = TRUE;
+}
+
+static void
+flag_cb (gpointer user_data)
+{
+  *(gboolean *)user_data = TRUE;
+}
+
+static void
+published_diagnostics_cb (IdeLspClient   *client,
+                          GFile          *file,
+                          IdeDiagnostics *diagnostics,
+                          gboolean       *published)
+{
+  *published = TRUE;
+}
+
+static gboolean
+timeout_cb (gpointer user_data)
+{
+  g_error ("Timed out waiting for %s, does the recording match the client?",
+           (const char *)user_data);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+run_until (gboolean   *condition,
+           const char *what)
+{
+  guint timeout = g_timeout_add_seconds (30, timeout_cb, (gpointer)what);
+
+  while (!*condition)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_source_remove (timeout);
+}
+
+static void
+bench_session (Cases     *cases,
+               GFile     *recording,
+               GPtrArray *steps,
+               GFile     *workdir)
+{
+  g_autoptr(IdeLspReplay) replay = NULL;
+  g_autoptr(IdeLspClient) client = NULL;
+  g_autoptr(IdeContext) context = NULL;
+  g_autoptr(GIOStream) stream = NULL;
+  g_autoptr(GError) error = NULL;
+  BenchCase *initialize;
+  gboolean initialized = FALSE;
+  gboolean published = FALSE;
+  gint64 begin;
+
+  if (!(replay = ide_lsp_replay_new (recording, &error)) ||
+      !(stream = ide_lsp_replay_start (replay, &error)))
+    g_error ("%s", error->message);
+
+  context = ide_context_new ();
+  ide_context_set_workdir (context, workdir);
+
+  client = ide_lsp_client_new (stream);
+  ide_object_append (IDE_OBJECT (context), IDE_OBJECT (client));
+
+  g_signal_connect_swapped (client, "initialized", G_CALLBACK (flag_cb), &initialized);
+  g_signal_connect (client, "published-diagnostics", G_CALLBACK (published_diagnostics_cb), &published);
+
+  initialize = get_case (cases, "initialize", "sessions");
+  begin = bench_now ();
+  ide_lsp_client_start (client);
+  run_until (&initialized, "initialize");
+  bench_case_sample (initialize, begin, 1);
+
+  for (guint i = 0; i < steps->len; i++)
+    {
+      const Step *step = g_ptr_array_index (steps, i);
+      Call call = {0};
+      BenchCase *bench;
+      guint64 main_thread_usec;
+      guint64 allocations;
+
+      if (step->expects_diagnostics)
+        bench = get_case (cases, "textDocument/publishDiagnostics", "notifications");
+      else
+        bench = get_case (cases, step->method, step->is_request ? "requests" : "notifications");
+
+      published = FALSE;
+      main_thread_usec = get_main_thread_usec (client);
+      allocations = n_allocations;
+      begin = bench_now ();
+
+      if (step->is_request)
+        ide_lsp_client_call_async (client, step->method, step->params, NULL, call_cb, &call);
+      else
+        ide_lsp_client_send_notification_async (client, step->method, step->params, NULL, notification_cb, &call);
+
+      run_until (&call.done, step->method);
+
+      /* Diagnostics latency spans from the edit to the client publishing
+       * the new diagnostics which is what the user is waiting for.
+       */
+      if (step->expects_diagnostics)
+        run_until (&published, "textDocument/publishDiagnostics");
+
+      bench_case_sample (bench, begin, 1);
+
+      allocations = n_allocations - allocations;
+      main_thread_usec = get_main_thread_usec (client) - main_thread_usec;
+
+      bench_case_count (bench, "allocations", allocations);
+      bench_case_count (bench, "main-thread-usec", main_thread_usec);
+
+      if (call.error != NULL)
+        g_error ("%s: %s", step->method, call.error->message);
+
+      g_clear_pointer (&call.reply, g_variant_unref);
+    }
+
+  if (ide_lsp_replay_get_n_unmatched (replay) > 0)
+    g_printerr ("%u messages did not match the recording\n",
+                ide_lsp_replay_get_n_unmatched (replay));
+
+  ide_lsp_client_stop (client);
+  ide_object_destroy (IDE_OBJECT (client));
+  ide_lsp_replay_stop (replay);
+  ide_object_destroy (IDE_OBJECT (context));
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GHashTable) by_name = NULL;
+  g_autoptr(GPtrArray) ordered = NULL;
+  g_autoptr(GPtrArray) steps = NULL;
+  g_autoptr(GFile) recording = NULL;
+  g_autoptr(GFile) workdir = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *tmpdir = NULL;
+  BenchSuite *suite;
+  Cases cases;
+  guint n_sessions;
+
+  suite = bench_suite_new ("lsp-replay", &argc, &argv);
+
+  if (argc > 1)
+    recording = g_file_new_for_commandline_arg (argv[1]);
+  else
+    recording = g_file_new_build_filename (g_getenv ("G_TEST_SRCDIR") ?: ".", "lsp-session.jsonl", NULL);
+
+  if (!(tmpdir = g_dir_make_tmp ("bench-lsp-replay-XXXXXX", &error)))
+    g_error ("%s", error->message);
+
+  workdir = g_file_new_for_path (tmpdir);
+  steps = load_steps (recording);
+  by_name = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  ordered = g_ptr_array_new ();
+
+  cases.suite = suite;
+  cases.by_name = by_name;
+  cases.ordered = ordered;
+
+  n_sessions = bench_suite_scale (suite, 10);
+
+  for (guint i = 0; i < n_sessions; i++)
+    bench_session (&cases, recording, steps, workdir);
+
+  for (guint i = 0; i < ordered->len; i++)
+    bench_case_end (g_ptr_array_index (ordered, i));
+
+  g_rmdir (tmpdir);
+
+  return bench_suite_finish (suite);
+}
@@ -0,0 +1,269 @@
+#!/usr/bin/env python3
+#
+# bench-session-restore.py
+#
+# Copyright 2025 Christian Hergert <chergert@redhat.com>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# SPDX-License-Identifier: GPL-3.0-or-later
+
+"""
+Measure how long Builder takes to restore a session of N editor pages,
+with the lazy placeholder pages and with every page loaded up front
+(IDE_EAGER_SESSION_RESTORE).
+
+    ./bench-session-restore.py --builder _build/src/gnome-builder --pages 50
+
+Builder runs on its own D-Bus session bus with private XDG directories
+and, unless --display is given, on a gtk4-broadwayd display so that no
+window shows up. A first run opens the generated files to save the
+session which every measured run then restores.
+
+Each run reports the time from spawning Builder until the focused page
+was interactive, the same measured from the start of the restore, and
+the time until every page was loaded. The report uses the format of the
+C benchmarks so that compare-benchmarks.py can diff two builds.
+"""
+
+import argparse
+import glob
+import json
+import os
+import queue
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+REPORT_VERSION = 1
+RESTORED_RE = re.compile(r'Restored (\d+) pages \((\w+)\): focused page after (-?\d+) usec, '
+                         r'all pages after (\d+) usec')
+FILE_LINES = 2000
+
+
+def generate_project(directory, n_pages):
+    files = []
+    for i in range(n_pages):
+        path = os.path.join(directory, 'file{:03d}.c'.format(i))
+        with open(path, 'w') as f:
+            for j in range(FILE_LINES // 4):
+                f.write('static int\nfunction_{}_{} (int value)\n'.format(i, j))
+                f.write('{{ return value * {} + {}; }}\n\n'.format(i, j))
+        files.append(path)
+    return files
+
+
+class Builder:
+    def __init__(self, args, env, extra_env=None):
+        env = dict(env)
+        env.update(extra_env or {})
+        self.begin = time.monotonic()
+        self.lines = queue.Queue()
+        self.proc = subprocess.Popen(args, env=env, stdout=subprocess.PIPE,
+                                     stderr=subprocess.STDOUT, text=True, errors='replace')
+        threading.Thread(target=self._read, daemon=True).start()
+
+    def _read(self):
+        for line in self.proc.stdout:
+            self.lines.put((time.monotonic(), line))
+        self.lines.put((time.monotonic(), None))
+
+    def wait_for(self, regex, timeout):
+        deadline = time.monotonic() + timeout
+        while True:
+            try:
+                when, line = self.lines.get(timeout=max(0, deadline - time.monotonic()))
+            except queue.Empty:
+                return None, None
+            if line is None:
+                return None, None
+            match = regex.search(line)
+            if match:
+                return when, match
+
+
+def quit_builder(builder, app_id, env):
+    subprocess.run(['gapplication', 'action', app_id, 'quit'], env=env,
+                   stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        builder.proc.wait(timeout=30)
+    except subprocess.TimeoutExpired:
+        builder.proc.kill()
+        builder.proc.wait()
+
+
+def wait_for_app(app_id, env, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        result = subprocess.run(['gapplication', 'list-actions', app_id], env=env,
+                                stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True)
+        if 'quit' in result.stdout.split():
+            return True
+        time.sleep(0.25)
+    return False
+
+
+def seed_session(args, env, project, files):
+    builder = Builder([args.builder, '-vvv', '--project=' + project], env)
+    if not wait_for_app(args.app_id, env, args.timeout):
+        quit_builder(builder, args.app_id, env)
+        sys.exit('Builder did not start')
+
+    # Give the workbench time to load the project, then open every file
+    # in it from a second, remote, invocation.
+    time.sleep(2)
+    subprocess.run([args.builder] + files, env=env, timeout=args.timeout,
+                   stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    time.sleep(max(2, len(files) * 0.1))
+    quit_builder(builder, args.app_id, env)
+
+    sessions = glob.glob(os.path.join(env['XDG_CACHE_HOME'], '**', 'session.gvariant'), recursive=True)
+    if not sessions:
+        sys.exit('Builder did not save a session')
+
+
+def measure(args, env, project, mode):
+    extra_env = {'IDE_EAGER_SESSION_RESTORE': '1'} if mode == 'eager' else {}
+    builder = Builder([args.builder, '-vvv', '--project=' + project], env, extra_env)
+    when, match = builder.wait_for(RESTORED_RE, args.timeout)
+    quit_builder(builder, args.app_id, env)
+
+    if match is None:
+        sys.exit('Timed out waiting for the {} session restore'.format(mode))
+
+    n_pages = int(match.group(1))
+    focused_usec = int(match.group(3))
+    all_usec = int(match.group(4))
+
+    if match.group(2) != mode:
+        sys.exit('Expected a {} restore but Builder reported {}'.format(mode, match.group(2)))
+    if focused_usec < 0:
+        sys.exit('The restored session has no focused page')
+
+    # The message is logged once every page is loaded, so the moment the
+    # focused page was ready is that much earlier.
+    from_spawn_nsec = int((when - builder.begin) * 1e9) - (all_usec - focused_usec) * 1000
+
+    return n_pages, {
+        'startup-to-focused': from_spawn_nsec,
+        'restore-to-focused': focused_usec * 1000,
+        'restore-to-all': all_usec * 1000,
+    }
+
+
+def percentile(samples, pct):
+    # Nearest-rank, like bench-util.c
+    ordered = sorted(samples)
+    rank = max((len(ordered) * pct + 99) // 100 - 1, 0)
+    return ordered[min(rank, len(ordered) - 1)]
+
+
+def make_case(name, samples, n_pages):
+    total = sum(samples)
+    return {
+        'name': name,
+        'unit': 'pages',
+        'samples': len(samples),
+        'units': n_pages * len(samples),
+        'total_ns': total,
+        'throughput': n_pages * len(samples) / (total / 1e9) if total else 0,
+        'min_ns': percentile(samples, 0),
+        'p50_ns': percentile(samples, 50),
+        'p90_ns': percentile(samples, 90),
+        'p99_ns': percentile(samples, 99),
+        'max_ns': percentile(samples, 100),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure session restore with and without lazy pages')
+    parser.add_argument('--builder', default='gnome-builder', help='the gnome-builder to run')
+    parser.add_argument('--app-id', default='org.gnome.Builder', help='the application id of that build')
+    parser.add_argument('--pages', type=int, default=50, help='number of pages in the session (default: 50)')
+    parser.add_argument('--runs', type=int, default=5, help='runs for each mode (default: 5)')
+    parser.add_argument('--timeout', type=float, default=120, help='seconds to wait for each run')
+    parser.add_argument('--display', help='use this display rather than a broadway one')
+    parser.add_argument('--output', help='where to write the JSON report')
+    args = parser.parse_args()
+
+    # Keep Builder from talking to the user's session bus and instance
+    if 'BENCH_SESSION_RESTORE_BUS' not in os.environ:
+        env = dict(os.environ, BENCH_SESSION_RESTORE_BUS='1')
+        os.execvpe('dbus-run-session', ['dbus-run-session', '--', sys.executable] + sys.argv, env)
+
+    root = tempfile.mkdtemp(prefix='bench-session-restore-')
+    broadwayd = None
+
+    try:
+        env = dict(os.environ)
+        for name in ('XDG_CACHE_HOME', 'XDG_CONFIG_HOME', 'XDG_DATA_HOME', 'XDG_STATE_HOME'):
+            env[name] = os.path.join(root, name.lower())
+            os.makedirs(env[name])
+        env['GSETTINGS_BACKEND'] = 'keyfile'
+        env['NO_AT_BRIDGE'] = '1'
+
+        if args.display:
+            env['DISPLAY'] = args.display
+        else:
+            env['GDK_BACKEND'] = 'broadway'
+            env['BROADWAY_DISPLAY'] = ':7'
+            env.pop('WAYLAND_DISPLAY', None)
+            env.pop('DISPLAY', None)
+            broadwayd = subprocess.Popen(['gtk4-broadwayd', ':7'], stdout=subprocess.DEVNULL,
+                                         stderr=subprocess.DEVNULL)
+            time.sleep(1)
+
+        project = os.path.join(root, 'project')
+        os.makedirs(project)
+        files = generate_project(project, args.pages)
+
+        seed_session(args, env, project, files)
+
+        samples = {}
+        n_pages = 0
+        for run in range(args.runs):
+            # Interleave the modes so that drift affects both alike
+            for mode in ('lazy', 'eager'):
+                n_pages, result = measure(args, env, project, mode)
+                for key, value in result.items():
+                    samples.setdefault('{}/{}'.format(mode, key), []).append(value)
+
+        cases = [make_case(name, values, n_pages) for name, values in sorted(samples.items())]
+        report = {'version': REPORT_VERSION, 'suite': 'session-restore', 'scale': 1.0, 'cases': cases}
+
+        for case in cases:
+            print('{:<40} p50 {:>9.1f}ms  p90 {:>9.1f}ms  ({} pages)'.format(
+                case['name'], case['p50_ns'] / 1e6, case['p90_ns'] / 1e6, n_pages))
+
+        output = args.output
+        if output is None and os.environ.get('IDE_BENCHMARK_RESULTS_DIR'):
+            output = os.path.join(os.environ['IDE_BENCHMARK_RESULTS_DIR'], 'session-restore.json')
+        if output is not None:
+            os.makedirs(os.path.dirname(os.path.abspath(output)), exist_ok=True)
+            with open(output, 'w') as f:
+                json.dump(report, f, indent=2)
+            print('Wrote report to {}'.format(output))
+    finally:
+        if broadwayd is not None:
+            broadwayd.terminate()
+            broadwayd.wait()
+        shutil.rmtree(root, ignore_errors=True)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,119 @@
+/* bench-text-region.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include "cjhtextregionprivate.h"
+
+#include "bench-corpus.h"
+#include "bench-util.h"
+
+#define OPS_PER_SAMPLE 1000
+
+static gboolean
+count_runs_cb (gsize                   offset,
+               const CjhTextRegionRun *run,
+               gpointer                user_data)
+{
+  (*(guint *)user_data)++;
+  return FALSE;
+}
+
+/* Simulates an editing session: most edits land near the previous
+ * one (typing, deleting a word) with the occasional jump elsewhere in
+ * the document, which is the access pattern IdeBuffer sees.
+ */
+static void
+bench_text_region_edit (BenchSuite *suite)
+{
+  g_autoptr(GRand) rand = g_rand_new_with_seed (BENCH_CORPUS_SEED);
+  BenchCase *insert = bench_case_begin (suite, "text-region/insert", "ops");
+  BenchCase *replace = bench_case_begin (suite, "text-region/replace", "ops");
+  BenchCase *remove = bench_case_begin (suite, "text-region/remove", "ops");
+  BenchCase *foreach = bench_case_begin (suite, "text-region/foreach", "runs");
+  guint n_samples = bench_suite_scale (suite, 100);
+  CjhTextRegion *region;
+  gsize cursor = 0;
+
+  region = _cjh_text_region_new (NULL, NULL);
+  _cjh_text_region_insert (region, 0, 1000000, NULL);
+
+  for (guint i = 0; i < n_samples; i++)
+    {
+      gint64 begin;
+      guint n_runs = 0;
+
+      begin = bench_now ();
+      for (guint j = 0; j < OPS_PER_SAMPLE; j++)
+        {
+          gsize len = _cjh_text_region_get_length (region);
+
+          if (g_rand_int_range (rand, 0, 20) == 0)
+            cursor = g_rand_int_range (rand, 0, len);
+          else
+            cursor = MIN (len, cursor + g_rand_int_range (rand, 0, 8));
+
+          _cjh_text_region_insert (region, cursor, g_rand_int_range (rand, 1, 16), GUINT_TO_POINTER (j + 1));
+        }
+      bench_case_sample (insert, begin, OPS_PER_SAMPLE);
+
+      begin = bench_now ();
+      for (guint j = 0; j < OPS_PER_SAMPLE; j++)
+        {
+          gsize len = _cjh_text_region_get_length (region);
+          gsize offset = g_rand_int_range (rand, 0, len - 64);
+
+          _cjh_text_region_replace (region, offset, g_rand_int_range (rand, 1, 64), GUINT_TO_POINTER (j + 1));
+        }
+      bench_case_sample (replace, begin, OPS_PER_SAMPLE);
+
+      begin = bench_now ();
+      for (guint j = 0; j < OPS_PER_SAMPLE; j++)
+        {
+          gsize len = _cjh_text_region_get_length (region);
+          gsize offset = g_rand_int_range (rand, 0, len - 16);
+
+          _cjh_text_region_remove (region, offset, g_rand_int_range (rand, 1, 16));
+        }
+      bench_case_sample (remove, begin, OPS_PER_SAMPLE);
+
+      begin = bench_now ();
+      _cjh_text_region_foreach (region, count_runs_cb, &n_runs);
+      bench_case_sample (foreach, begin, n_runs);
+    }
+
+  _cjh_text_region_free (region);
+
+  bench_case_end (insert);
+  bench_case_end (replace);
+  bench_case_end (remove);
+  bench_case_end (foreach);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  BenchSuite *suite = bench_suite_new ("text-region", &argc, &argv);
+
+  bench_text_region_edit (suite);
+
+  return bench_suite_finish (suite);
+}
@@ -0,0 +1,408 @@
+/* bench-util.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench-util.h"
+
+/* Bump when the layout of the JSON report changes so that
+ * compare-benchmarks.py can refuse to compare apples to oranges.
+ */
+#define BENCH_REPORT_VERSION 1
+
+struct _BenchSuite
+{
+  char      *name;
+  char      *output;
+  GPtrArray *cases;
+  double     scale;
+};
+
+struct _BenchCase
+{
+  BenchSuite *suite;
+  char       *name;
+  char       *unit;
+  GArray     *samples;
+  GArray     *counters;
+  guint64     n_units;
+  gint64      total_nsec;
+};
+
+typedef struct
+{
+  char    *name;
+  guint64  value;
+} BenchCounter;
+
+static void
+bench_counter_clear (gpointer data)
+{
+  BenchCounter *counter = data;
+
+  g_clear_pointer (&counter->name, g_free);
+}
+
+static void
+bench_case_free (BenchCase *bench)
+{
+  g_clear_pointer (&bench->name, g_free);
+  g_clear_pointer (&bench->unit, g_free);
+  g_clear_pointer (&bench->samples, g_array_unref);
+  g_clear_pointer (&bench->counters, g_array_unref);
+  g_free (bench);
+}
+
+gint64
+bench_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (gint64)ts.tv_sec * G_GINT64_CONSTANT (1000000000) + ts.tv_nsec;
+}
+
+BenchSuite *
+bench_suite_new (const char   *name,
+                 int          *argc,
+                 char       ***argv)
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *output = NULL;
+  const char *envvar;
+  double scale = 0;
+  BenchSuite *suite;
+  const GOptionEntry entries[] = {
+    { "scale", 's', 0, G_OPTION_ARG_DOUBLE, &scale,
+      "Multiply the size of every corpus and iteration count by SCALE", "SCALE" },
+    { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+      "Write the JSON report to FILE", "FILE" },
+    { NULL }
+  };
+
+  g_assert (name != NULL);
+
+  context = g_option_context_new ("- run benchmarks");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, argc, argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      exit (EXIT_FAILURE);
+    }
+
+  if (scale <= 0 && (envvar = g_getenv ("IDE_BENCHMARK_SCALE")))
+    scale = g_ascii_strtod (envvar, NULL);
+
+  if (scale <= 0)
+    scale = 1.0;
+
+  if (output == NULL && (envvar = g_getenv ("IDE_BENCHMARK_RESULTS_DIR")))
+    {
+      g_autofree char *basename = g_strdup_printf ("%s.json", name);
+
+      g_mkdir_with_parents (envvar, 0750);
+      output = g_build_filename (envvar, basename, NULL);
+    }
+
+  suite = g_new0 (BenchSuite, 1);
+  suite->name = g_strdup (name);
+  suite->output = g_steal_pointer (&output);
+  suite->cases = g_ptr_array_new_with_free_func ((GDestroyNotify)bench_case_free);
+  suite->scale = scale;
+
+  return suite;
+}
+
+/**
+ * bench_suite_scale:
+ * @suite: a #BenchSuite
+ * @n: the baseline size
+ *
+ * Scales @n by the factor requested with `--scale` or the
+ * `IDE_BENCHMARK_SCALE` environment variable so that the same
+ * binary can be used for quick smoke runs and longer soak runs.
+ *
+ * Returns: the scaled value, which is never zero
+ */
+guint
+bench_suite_scale (BenchSuite *suite,
+                   guint       n)
+{
+  g_assert (suite != NULL);
+
+  return MAX (1, (guint)(n * suite->scale));
+}
+
+BenchCase *
+bench_case_begin (BenchSuite *suite,
+                  const char *name,
+                  const char *unit)
+{
+  BenchCase *bench;
+
+  g_assert (suite != NULL);
+  g_assert (name != NULL);
+  g_assert (unit != NULL);
+
+  bench = g_new0 (BenchCase, 1);
+  bench->suite = suite;
+  bench->name = g_strdup (name);
+  bench->unit = g_strdup (unit);
+  bench->samples = g_array_new (FALSE, FALSE, sizeof (gint64));
+  bench->counters = g_array_new (FALSE, FALSE, sizeof (BenchCounter));
+  g_array_set_clear_func (bench->counters, bench_counter_clear);
+
+  return bench;
+}
+
+/**
+ * bench_case_sample:
+ * @bench: a #BenchCase
+ * @begin_nsec: the value of bench_now() when the operation started
+ * @n_units: the number of units (lines, keys, bytes, ...) processed
+ *
+ * Records a single latency sample. Throughput is derived from the
+ * sum of @n_units over the sum of all samples.
+ */
+void
+bench_case_sample (BenchCase *bench,
+                   gint64     begin_nsec,
+                   guint64    n_units)
+{
+  gint64 elapsed = bench_now () - begin_nsec;
+
+  g_assert (bench != NULL);
+
+  g_array_append_val (bench->samples, elapsed);
+  bench->total_nsec += elapsed;
+  bench->n_units += n_units;
+}
+
+/**
+ * bench_case_count:
+ * @bench: a #BenchCase
+ * @counter: the name of the counter such as "allocations"
+ * @value: the amount to add to the counter
+ *
+ * Accumulates a secondary metric for the case. Counters are reported
+ * per sample so they stay comparable when the number of samples
+ * changes with `--scale`.
+ */
+void
+bench_case_count (BenchCase  *bench,
+                  const char *counter,
+                  guint64     value)
+{
+  BenchCounter new_counter;
+
+  g_assert (bench != NULL);
+  g_assert (counter != NULL);
+
+  for (guint i = 0; i < bench->counters->len; i++)
+    {
+      BenchCounter *existing = &g_array_index (bench->counters, BenchCounter, i);
+
+      if (g_str_equal (existing->name, counter))
+        {
+          existing->value += value;
+          return;
+        }
+    }
+
+  new_counter.name = g_strdup (counter);
+  new_counter.value = value;
+  g_array_append_val (bench->counters, new_counter);
+}
+
+void
+bench_case_end (BenchCase *bench)
+{
+  g_assert (bench != NULL);
+  g_assert (bench->suite != NULL);
+
+  g_ptr_array_add (bench->suite->cases, bench);
+}
+
+static int
+compare_gint64 (gconstpointer a,
+                gconstpointer b)
+{
+  gint64 aval = *(const gint64 *)a;
+  gint64 bval = *(const gint64 *)b;
+
+  return aval < bval ? -1 : aval > bval ? 1 : 0;
+}
+
+static gint64
+percentile (const GArray *sorted,
+            guint         pct)
+{
+  gsize rank;
+
+  if (sorted->len == 0)
+    return 0;
+
+  /* Nearest-rank, so p100 is always the maximum sample */
+  rank = (sorted->len * pct + 99) / 100;
+  if (rank > 0)
+    rank--;
+
+  return g_array_index (sorted, gint64, MIN (rank, sorted->len - 1));
+}
+
+static char *
+format_nsec (gint64 nsec)
+{
+  if (nsec >= G_GINT64_CONSTANT (1000000000))
+    return g_strdup_printf ("%.2lfs", nsec / 1000000000.0);
+  else if (nsec >= 1000000)
+    return g_strdup_printf ("%.2lfms", nsec / 1000000.0);
+  else if (nsec >= 1000)
+    return g_strdup_printf ("%.2lfµs", nsec / 1000.0);
+  else
+    return g_strdup_printf ("%"G_GINT64_FORMAT"ns", nsec);
+}
+
+int
+bench_suite_finish (BenchSuite *suite)
+{
+  g_autoptr(GString) json = NULL;
+  g_autoptr(GError) error = NULL;
+  char dbl[G_ASCII_DTOSTR_BUF_SIZE];
+  int ret = EXIT_SUCCESS;
+
+  g_assert (suite != NULL);
+
+  json = g_string_new ("{\n");
+  g_string_append_printf (json, "  \"version\": %d,\n", BENCH_REPORT_VERSION);
+  g_string_append_printf (json, "  \"suite\": \"%s\",\n", suite->name);
+  g_string_append_printf (json, "  \"scale\": %s,\n",
+                          g_ascii_dtostr (dbl, sizeof dbl, suite->scale));
+  g_string_append (json, "  \"cases\": [\n");
+
+  for (guint i = 0; i < suite->cases->len; i++)
+    {
+      BenchCase *bench = g_ptr_array_index (suite->cases, i);
+      g_autoptr(GArray) sorted = NULL;
+      g_autofree char *escaped = g_strescape (bench->name, NULL);
+      g_autofree char *p50 = NULL;
+      g_autofree char *p99 = NULL;
+      double throughput = 0;
+
+      sorted = g_array_copy (bench->samples);
+      g_array_sort (sorted, compare_gint64);
+
+      if (bench->total_nsec > 0)
+        throughput = bench->n_units / (bench->total_nsec / 1000000000.0);
+
+      g_string_append_printf (json,
+                              "    {\n"
+                              "      \"name\": \"%s\",\n"
+                              "      \"unit\": \"%s\",\n"
+                              "      \"samples\": %u,\n"
+                              "      \"units\": %"G_GUINT64_FORMAT",\n"
+                              "      \"total_ns\": %"G_GINT64_FORMAT",\n",
+                              escaped,
+                              bench->unit,
+                              sorted->len,
+                              bench->n_units,
+                              bench->total_nsec);
+      g_string_append_printf (json, "      \"throughput\": %s,\n",
+                              g_ascii_dtostr (dbl, sizeof dbl, throughput));
+      g_string_append_printf (json,
+                              "      \"min_ns\": %"G_GINT64_FORMAT",\n"
+                              "      \"p50_ns\": %"G_GINT64_FORMAT",\n"
+                              "      \"p90_ns\": %"G_GINT64_FORMAT",\n"
+                              "      \"p99_ns\": %"G_GINT64_FORMAT",\n"
+                              "      \"max_ns\": %"G_GINT64_FORMAT"%s\n",
+                              percentile (sorted, 0),
+                              percentile (sorted, 50),
+                              percentile (sorted, 90),
+                              percentile (sorted, 99),
+                              percentile (sorted, 100),
+                              bench->counters->len > 0 ? "," : "");
+
+      if (bench->counters->len > 0)
+        {
+          g_string_append (json, "      \"counters\": {\n");
+
+          for (guint j = 0; j < bench->counters->len; j++)
+            {
+              const BenchCounter *counter = &g_array_index (bench->counters, BenchCounter, j);
+              double per_sample = sorted->len ? counter->value / (double)sorted->len : 0;
+
+              g_string_append_printf (json, "        \"%s\": %s%s\n",
+                                      counter->name,
+                                      g_ascii_dtostr (dbl, sizeof dbl, per_sample),
+                                      j + 1 < bench->counters->len ? "," : "");
+            }
+
+          g_string_append (json, "      }\n");
+        }
+
+      g_string_append_printf (json, "    }%s\n", i + 1 < suite->cases->len ? "," : "");
+
+      p50 = format_nsec (percentile (sorted, 50));
+      p99 = format_nsec (percentile (sorted, 99));
+
+      g_print ("%-48s %14.0lf %s/s  p50 %-10s p99 %s\n",
+               bench->name, throughput, bench->unit, p50, p99);
+
+      for (guint j = 0; j < bench->counters->len; j++)
+        {
+          const BenchCounter *counter = &g_array_index (bench->counters, BenchCounter, j);
+
+          g_print ("%-48s %14.1lf %s/sample\n",
+                   "", sorted->len ? counter->value / (double)sorted->len : 0, counter->name);
+        }
+    }
+
+  g_string_append (json, "  ]\n}\n");
+
+  if (suite->output != NULL)
+    {
+      if (!g_file_set_contents (suite->output, json->str, json->len, &error))
+        {
+          g_printerr ("Failed to write %s: %s\n", suite->output, error->message);
+          ret = EXIT_FAILURE;
+        }
+      else
+        {
+          g_print ("Wrote report to %s\n", suite->output);
+        }
+    }
+  else
+    {
+      g_print ("%s", json->str);
+    }
+
+  g_clear_pointer (&suite->cases, g_ptr_array_unref);
+  g_clear_pointer (&suite->output, g_free);
+  g_clear_pointer (&suite->name, g_free);
+  g_free (suite);
+
+  return ret;
+}
@@ -0,0 +1,48 @@
+/* bench-util.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _BenchSuite BenchSuite;
+typedef struct _BenchCase  BenchCase;
+
+BenchSuite *bench_suite_new        (const char  *name,
+                                    int         *argc,
+                                    char      ***argv);
+guint       bench_suite_scale      (BenchSuite  *suite,
+                                    guint        n);
+int         bench_suite_finish     (BenchSuite  *suite);
+BenchCase  *bench_case_begin       (BenchSuite  *suite,
+                                    const char  *name,
+                                    const char  *unit);
+void        bench_case_sample      (BenchCase   *bench,
+                                    gint64       begin_nsec,
+                                    guint64      n_units);
+void        bench_case_count       (BenchCase   *bench,
+                                    const char  *counter,
+                                    guint64      value);
+void        bench_case_end         (BenchCase   *bench);
+gint64      bench_now              (void);
+
+G_END_DECLS
@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+#
+# compare-benchmarks.py
+#
+# Copyright 2025 Christian Hergert <chergert@redhat.com>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# SPDX-License-Identifier: GPL-3.0-or-later
+
+"""
+Compare the JSON reports produced by `meson test --benchmark` in two
+build directories and flag regressions.
+
+    ./compare-benchmarks.py build-main build-branch --threshold 10
+
+Exits with status 1 if any case regressed by more than the threshold.
+"""
+
+import argparse
+import glob
+import json
+import os
+import sys
+
+REPORT_VERSION = 1
+RESULTS_SUBDIR = os.path.join('src', 'tests', 'benchmarks', 'results')
+
+
+def load_reports(path):
+    # Accept either a build directory or the results directory itself
+    candidates = [os.path.join(path, RESULTS_SUBDIR), path]
+    for directory in candidates:
+        files = sorted(glob.glob(os.path.join(directory, '*.json')))
+        if files:
+            break
+    else:
+        sys.exit('No benchmark reports found in {}. '
+                 'Did you run `meson test --benchmark`?'.format(path))
+
+    cases = {}
+    for filename in files:
+        with open(filename) as f:
+            report = json.load(f)
+        if report.get('version') != REPORT_VERSION:
+            sys.exit('{}: unsupported report version {}'.format(filename, report.get('version')))
+        for case in report['cases']:
+            key = '{}:{}'.format(report['suite'], case['name'])
+            case['scale'] = report['scale']
+            cases[key] = case
+    return cases
+
+
+def percent(old, new):
+    if old == 0:
+        return 0.0
+    return (new - old) * 100.0 / old
+
+
+def format_ns(ns):
+    if ns >= 1e9:
+        return '{:.2f}s'.format(ns / 1e9)
+    if ns >= 1e6:
+        return '{:.2f}ms'.format(ns / 1e6)
+    if ns >= 1e3:
+        return '{:.2f}µs'.format(ns / 1e3)
+    return '{}ns'.format(ns)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare benchmark results between two build directories')
+    parser.add_argument('old', help='baseline build directory')
+    parser.add_argument('new', help='candidate build directory')
+    parser.add_argument('--threshold', type=float, default=10.0,
+                        help='percentage change considered a regression (default: 10)')
+    parser.add_argument('--latency', default='p50_ns', choices=['p50_ns', 'p90_ns', 'p99_ns'],
+                        help='latency percentile to compare (default: p50_ns)')
+    args = parser.parse_args()
+
+    old = load_reports(args.old)
+    new = load_reports(args.new)
+    regressions = []
+
+    print('{:<56} {:>10} {:>12} {:>12} {:>10}'.format('case', 'throughput', 'old ' + args.latency[:3],
+                                                      'new ' + args.latency[:3], 'latency'))
+
+    for key in sorted(set(old) | set(new)):
+        if key not in old or key not in new:
+            print('{:<56} {}'.format(key, 'only in ' + (args.old if key in old else args.new)))
+            continue
+
+        o, n = old[key], new[key]
+        if o['scale'] != n['scale']:
+            print('{:<56} {}'.format(key, 'skipped, different --scale'))
+            continue
+
+        tput = percent(o['throughput'], n['throughput'])
+        lat = percent(o[args.latency], n[args.latency])
+        flag = ''
+        if tput < -args.threshold or lat > args.threshold:
+            flag = '  REGRESSION'
+            regressions.append(key)
+        elif tput > args.threshold and lat < -args.threshold:
+            flag = '  improved'
+
+        print('{:<56} {:>+9.1f}% {:>12} {:>12} {:>+9.1f}%{}'.format(
+            key, tput, format_ns(o[args.latency]), format_ns(n[args.latency]), lat, flag))
+
+        # Counters such as allocations are per sample, lower is better
+        old_counters = o.get('counters', {})
+        new_counters = n.get('counters', {})
+        for name in sorted(set(old_counters) & set(new_counters)):
+            change = percent(old_counters[name], new_counters[name])
+            flag = ''
+            if change > args.threshold:
+                flag = '  REGRESSION'
+                regressions.append('{}:{}'.format(key, name))
+            elif change < -args.threshold:
+                flag = '  improved'
+            print('  {:<54} {:>11} {:>12.1f} {:>12.1f} {:>+9.1f}%{}'.format(
+                name, '', old_counters[name], new_counters[name], change, flag))
+
+    if regressions:
+        print('\n{} case(s) regressed by more than {:.0f}%'.format(len(regressions), args.threshold))
+        return 1
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
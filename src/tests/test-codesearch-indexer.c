@@ -0,0 +1,438 @@
+/* test-codesearch-indexer.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <glib/gstdio.h>
+
+#include "gbp-codesearch-indexer.h"
+
+#define N_GENERATED_FILES 500
+#define N_GENERATED_LINES 100
+
+static const char main_c[] =
+  "#include \"util.h\"\n"
+  "\n"
+  "int\n"
+  "main (int argc, char *argv[])\n"
+  "{\n"
+  "  return say_hello_world ();\n"
+  "}\n";
+
+static const char util_c[] =
+  "#include \"util.h\"\n"
+  "\n"
+  "int\n"
+  "say_hello_world (void)\n"
+  "{\n"
+  "  return old_implementation ();\n"
+  "}\n";
+
+static const char *words[] = {
+  "buffer", "context", "widget", "runtime", "pipeline", "search", "index",
+  "symbol", "project", "workspace", "builder", "document", "trigram",
+};
+
+static void
+write_file (const char *dir,
+            const char *name,
+            const char *contents,
+            gssize      len)
+{
+  g_autoptr(GError) error = NULL;
+  g_autofree char *path = g_build_filename (dir, name, NULL);
+  g_autofree char *parent = g_path_get_dirname (path);
+
+  g_assert_cmpint (g_mkdir_with_parents (parent, 0750), ==, 0);
+  g_file_set_contents (path, contents, len, &error);
+  g_assert_no_error (error);
+}
+
+static char *
+make_tree (void)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GRand) rand = g_rand_new_with_seed (1234);
+  char *tmpdir;
+
+  tmpdir = g_dir_make_tmp ("test-codesearch-indexer-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  write_file (tmpdir, "src/main.c", main_c, -1);
+  write_file (tmpdir, "src/util.c", util_c, -1);
+  write_file (tmpdir, "src/util.h", "int say_hello_world (void);\n", -1);
+  write_file (tmpdir, "src/logo.png", "\x89PNG\0say_hello_world", 20);
+  write_file (tmpdir, "_build/src/main.c", main_c, -1);
+
+  /* Filler so that the reported numbers mean something */
+  for (guint i = 0; i < N_GENERATED_FILES; i++)
+    {
+      g_autoptr(GString) str = g_string_new (NULL);
+      g_autofree char *name = g_strdup_printf ("generated/dir%02u/file%03u.c", i % 10, i);
+
+      for (guint j = 0; j < N_GENERATED_LINES; j++)
+        g_string_append_printf (str, "%s_%s (%u);\n",
+                                words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))],
+                                words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))],
+                                g_rand_int (rand));
+
+      write_file (tmpdir, name, str->str, str->len);
+    }
+
+  return tmpdir;
+}
+
+static void
+remove_tree (const char *path)
+{
+  g_autoptr(GDir) dir = NULL;
+  const char *name;
+
+  if ((dir = g_dir_open (path, 0, NULL)))
+    {
+      while ((name = g_dir_read_name (dir)))
+        {
+          g_autofree char *child = g_build_filename (path, name, NULL);
+          remove_tree (child);
+        }
+    }
+
+  g_remove (path);
+}
+
+static gboolean
+is_ignored (GFile    *file,
+            gpointer  user_data)
+{
+  g_autofree char *name = g_file_get_basename (file);
+
+  return g_str_equal (name, "_build");
+}
+
+static gboolean
+is_unchanged (CodeIndex  *index,
+              const char *path,
+              gpointer    user_data)
+{
+  return !g_hash_table_contains (user_data, path);
+}
+
+static GArray *
+search (CodeIndex  *index,
+        CodeIndex  *delta,
+        GFile      *workdir,
+        const char *needle)
+{
+  CodeIndex *indexes[] = { index, delta };
+  g_autoptr(GTimer) timer = g_timer_new ();
+  GArray *hits;
+
+  hits = gbp_codesearch_indexer_search (indexes, delta ? 2 : 1, workdir, needle, 100, NULL);
+
+  g_test_message ("Searching for `%s` found %u hits in %.3lf msec",
+                  needle, hits->len, g_timer_elapsed (timer, NULL) * 1000.);
+
+  return hits;
+}
+
+static void
+assert_hit (GArray     *hits,
+            const char *path,
+            const char *text,
+            guint       line,
+            guint       line_offset)
+{
+  const GbpCodesearchHit *hit;
+
+  g_assert_cmpint (hits->len, ==, 1);
+
+  hit = &g_array_index (hits, GbpCodesearchHit, 0);
+  g_assert_cmpstr (hit->path, ==, path);
+  g_assert_cmpstr (hit->text, ==, text);
+  g_assert_cmpint (hit->line, ==, line);
+  g_assert_cmpint (hit->line_offset, ==, line_offset);
+}
+
+static void
+test_codesearch_indexer_build (void)
+{
+  g_autoptr(CodeIndexBuilder) builder = NULL;
+  g_autoptr(CodeIndex) index = NULL;
+  g_autoptr(GTimer) timer = g_timer_new ();
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GArray) hits = NULL;
+  g_autoptr(GFile) workdir = NULL;
+  g_autofree char *tmpdir = make_tree ();
+  g_autofree char *cachedir = NULL;
+  g_autofree char *filename = NULL;
+  CodeIndexStat stat;
+
+  workdir = g_file_new_for_path (tmpdir);
+  cachedir = g_dir_make_tmp ("test-codesearch-cache-XXXXXX", &error);
+  g_assert_no_error (error);
+  filename = g_build_filename (cachedir, "codesearch", "project.index", NULL);
+
+  builder = gbp_codesearch_indexer_build (workdir, is_ignored, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (builder);
+
+  /* main.c, util.c, util.h and the generated files after the reserved
+   * document zero.
+   */
+  g_assert_cmpint (code_index_builder_get_n_documents (builder), ==, N_GENERATED_FILES + 4);
+
+  index = gbp_codesearch_indexer_write (builder, filename, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (index);
+
+  code_index_stat (index, &stat);
+  g_test_message ("Indexed %u documents in %.3lf msec into %u trigrams, %u bytes of postings",
+                  stat.n_documents - 1,
+                  g_timer_elapsed (timer, NULL) * 1000.,
+                  stat.n_trigrams,
+                  stat.trigrams_data_bytes);
+
+  hits = search (index, NULL, workdir, "hello_world ();");
+  assert_hit (hits, "src/main.c", "return say_hello_world ();", 5, 13);
+  g_clear_pointer (&hits, g_array_unref);
+
+  hits = search (index, NULL, workdir, "say_hello_world");
+  g_assert_cmpint (hits->len, ==, 3);
+  g_clear_pointer (&hits, g_array_unref);
+
+  /* Needles which are not in the index at all */
+  hits = search (index, NULL, workdir, "not_anywhere_in_the_tree");
+  g_assert_cmpint (hits->len, ==, 0);
+  g_clear_pointer (&hits, g_array_unref);
+
+  hits = search (index, NULL, workdir, "ab");
+  g_assert_cmpint (hits->len, ==, 0);
+  g_clear_pointer (&hits, g_array_unref);
+
+  /* Generated content is found and results are capped */
+  hits = search (index, NULL, workdir, "trigram_");
+  g_assert_cmpint (hits->len, ==, 100);
+  g_clear_pointer (&hits, g_array_unref);
+
+  remove_tree (cachedir);
+  remove_tree (tmpdir);
+}
+
+static void
+test_codesearch_indexer_update (void)
+{
+  g_autoptr(CodeIndexBuilder) builder = NULL;
+  g_autoptr(CodeIndexBuilder) delta_builder = NULL;
+  g_autoptr(CodeIndexBuilder) merge_builder = NULL;
+  g_autoptr(GHashTable) changed = NULL;
+  g_autoptr(CodeIndex) index = NULL;
+  g_autoptr(CodeIndex) delta = NULL;
+  g_autoptr(CodeIndex) merged = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GArray) hits = NULL;
+  g_autoptr(GFile) workdir = NULL;
+  g_autofree char *tmpdir = make_tree ();
+  g_autofree char *cachedir = NULL;
+  g_autofree char *filename = NULL;
+  g_autofree char *delta_filename = NULL;
+  CodeIndexStat before;
+  CodeIndexStat after;
+  CodeIndexIter iter;
+  CodeTrigram trigram;
+
+  workdir = g_file_new_for_path (tmpdir);
+  cachedir = g_dir_make_tmp ("test-codesearch-cache-XXXXXX", &error);
+  g_assert_no_error (error);
+  filename = g_build_filename (cachedir, "project.index", NULL);
+  delta_filename = g_build_filename (cachedir, "delta.index", NULL);
+
+  builder = gbp_codesearch_indexer_build (workdir, is_ignored, NULL, NULL, &error);
+  g_assert_no_error (error);
+  index = gbp_codesearch_indexer_write (builder, filename, &error);
+  g_assert_no_error (error);
+
+  write_file (tmpdir, "src/util.c", "int\nsay_hello_world (void)\n{\n  return new_implementation ();\n}\n", -1);
+  write_file (tmpdir, "src/added.c", "static int new_implementation (void) { return 0; }\n", -1);
+
+  /* Changed files are indexed into a delta searched along with the index */
+  delta_builder = code_index_builder_new ();
+  g_assert_true (gbp_codesearch_indexer_add_file (delta_builder, workdir, "src/util.c"));
+  g_assert_true (gbp_codesearch_indexer_add_file (delta_builder, workdir, "src/added.c"));
+  delta = gbp_codesearch_indexer_write (delta_builder, delta_filename, &error);
+  g_assert_no_error (error);
+
+  hits = search (index, delta, workdir, "return new_implementation");
+  assert_hit (hits, "src/util.c", "return new_implementation ();", 3, 2);
+  g_clear_pointer (&hits, g_array_unref);
+
+  hits = search (index, delta, workdir, "new_implementation");
+  g_assert_cmpint (hits->len, ==, 2);
+  g_clear_pointer (&hits, g_array_unref);
+
+  /* The index still lists util.c but the contents on disk win */
+  hits = search (index, delta, workdir, "old_implementation");
+  g_assert_cmpint (hits->len, ==, 0);
+  g_clear_pointer (&hits, g_array_unref);
+
+  /* Merging replaces the changed documents of the index */
+  changed = g_hash_table_new (g_str_hash, g_str_equal);
+  g_hash_table_add (changed, (char *)"src/util.c");
+  g_hash_table_add (changed, (char *)"src/added.c");
+
+  merge_builder = code_index_builder_new ();
+  g_assert_true (code_index_builder_merge_full (merge_builder, index, is_unchanged, changed));
+  g_assert_true (gbp_codesearch_indexer_add_file (merge_builder, workdir, "src/util.c"));
+  g_assert_true (gbp_codesearch_indexer_add_file (merge_builder, workdir, "src/added.c"));
+  merged = gbp_codesearch_indexer_write (merge_builder, filename, &error);
+  g_assert_no_error (error);
+
+  code_index_stat (index, &before);
+  code_index_stat (merged, &after);
+  g_assert_cmpint (after.n_documents, ==, before.n_documents + 1);
+
+  /* Nothing but the old util.c contained this trigram */
+  trigram = (CodeTrigram) { 'o', 'l', 'd' };
+  g_assert_false (code_index_iter_init (&iter, merged, &trigram));
+
+  hits = search (merged, NULL, workdir, "new_implementation");
+  g_assert_cmpint (hits->len, ==, 2);
+  g_clear_pointer (&hits, g_array_unref);
+
+  hits = search (merged, NULL, workdir, "say_hello_world");
+  g_assert_cmpint (hits->len, ==, 3);
+  g_clear_pointer (&hits, g_array_unref);
+
+  remove_tree (cachedir);
+  remove_tree (tmpdir);
+}
+
+static void
+add_document (CodeIndexBuilder *builder,
+              guint             i)
+{
+  g_autofree char *path = g_strdup_printf ("doc%05u", i);
+
+  code_index_builder_begin (builder, path);
+  if (i % 3 == 0)
+    code_index_builder_add (builder, &(CodeTrigram) { 'a', 'a', 'a' });
+  if (i % 5 == 0)
+    code_index_builder_add (builder, &(CodeTrigram) { 'b', 'b', 'b' });
+  /* Large gaps so that blocks need wide deltas */
+  if (i % 1000 == 0)
+    code_index_builder_add (builder, &(CodeTrigram) { 'c', 'c', 'c' });
+  code_index_builder_commit (builder);
+}
+
+static void
+test_codesearch_index_blocks (void)
+{
+  g_autoptr(CodeIndexBuilder) builder = code_index_builder_new ();
+  g_autoptr(CodeIndexBuilder) merge_builder = code_index_builder_new ();
+  g_autoptr(CodeIndex) index = NULL;
+  g_autoptr(CodeIndex) merged = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *cachedir = NULL;
+  g_autofree char *filename = NULL;
+  CodeIndexIter iters[3];
+  CodeDocument document;
+  guint n_documents = 10000;
+  guint expected;
+
+  cachedir = g_dir_make_tmp ("test-codesearch-cache-XXXXXX", &error);
+  g_assert_no_error (error);
+  filename = g_build_filename (cachedir, "blocks.index", NULL);
+
+  /* Document ids start at 1 */
+  for (guint i = 1; i < n_documents; i++)
+    add_document (builder, i);
+
+  index = gbp_codesearch_indexer_write (builder, filename, &error);
+  g_assert_no_error (error);
+
+  g_assert_true (code_index_iter_init (&iters[0], index, &(CodeTrigram) { 'a', 'a', 'a' }));
+  g_assert_cmpint (code_index_iter_get_n_documents (&iters[0]), ==, (n_documents - 1) / 3);
+
+  /* Every id is decoded in order across block boundaries */
+  expected = 3;
+  while (code_index_iter_next (&iters[0], &document))
+    {
+      g_assert_cmpint (document.id, ==, expected);
+      expected += 3;
+    }
+  g_assert_cmpint (expected, >=, n_documents);
+
+  /* Seeking lands on the next document when missing */
+  g_assert_true (code_index_iter_init (&iters[0], index, &(CodeTrigram) { 'a', 'a', 'a' }));
+  g_assert_true (code_index_iter_seek_to (&iters[0], 3));
+  g_assert_true (code_index_iter_seek_to (&iters[0], 3));
+  g_assert_false (code_index_iter_seek_to (&iters[0], 5000));
+  g_assert_cmpint (iters[0].last, ==, 5001);
+  g_assert_true (code_index_iter_seek_to (&iters[0], 9999));
+  g_assert_false (code_index_iter_seek_to (&iters[0], 10000));
+  g_assert_false (code_index_iter_next (&iters[0], &document));
+
+  /* The rarest list drives the intersection whatever the order */
+  g_assert_true (code_index_iter_init (&iters[0], index, &(CodeTrigram) { 'a', 'a', 'a' }));
+  g_assert_true (code_index_iter_init (&iters[1], index, &(CodeTrigram) { 'b', 'b', 'b' }));
+  g_assert_true (code_index_iter_init (&iters[2], index, &(CodeTrigram) { 'c', 'c', 'c' }));
+  code_index_iter_sort (iters, 3);
+  g_assert_cmpint (code_index_iter_get_n_documents (&iters[0]), ==, 9);
+
+  expected = 0;
+  while (code_index_iter_intersect (iters, 3, &document))
+    {
+      g_assert_cmpint (document.id % 3000, ==, 0);
+      expected++;
+    }
+  g_assert_cmpint (expected, ==, 3);
+
+  g_assert_true (code_index_iter_init (&iters[0], index, &(CodeTrigram) { 'a', 'a', 'a' }));
+  g_assert_true (code_index_iter_init (&iters[1], index, &(CodeTrigram) { 'b', 'b', 'b' }));
+  code_index_iter_sort (iters, 2);
+
+  expected = 15;
+  while (code_index_iter_intersect (iters, 2, &document))
+    {
+      g_assert_cmpint (document.id, ==, expected);
+      expected += 15;
+    }
+  g_assert_cmpint (expected, >=, n_documents);
+
+  /* Merging decodes the blocks back into the builder */
+  g_assert_true (code_index_builder_merge (merge_builder, index));
+  merged = gbp_codesearch_indexer_write (merge_builder, filename, &error);
+  g_assert_no_error (error);
+
+  g_assert_true (code_index_iter_init (&iters[0], merged, &(CodeTrigram) { 'b', 'b', 'b' }));
+  g_assert_cmpint (code_index_iter_get_n_documents (&iters[0]), ==, (n_documents - 1) / 5);
+  g_assert_true (code_index_iter_seek_to (&iters[0], 9995));
+  g_assert_cmpstr (code_index_get_document_path (merged, 9995), ==, "doc09995");
+
+  remove_tree (cachedir);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Codesearch/Indexer/build", test_codesearch_indexer_build);
+  g_test_add_func ("/Codesearch/Indexer/update", test_codesearch_indexer_update);
+  g_test_add_func ("/Codesearch/Index/blocks", test_codesearch_index_blocks);
+  return g_test_run ();
+}
@@ -0,0 +1,134 @@
+/* test-file-edits.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <string.h>
+
+#include <libide-code.h>
+
+#include "ide-file-edits-private.h"
+
+static void
+add_edit (GArray     *edits,
+          int         begin_line,
+          int         begin_line_offset,
+          int         end_line,
+          int         end_line_offset,
+          const char *text)
+{
+  IdeFileEdit edit = {
+    begin_line, begin_line_offset,
+    end_line, end_line_offset,
+    g_strdup (text),
+  };
+
+  g_array_append_val (edits, edit);
+}
+
+static GArray *
+new_edits (void)
+{
+  GArray *edits = g_array_new (FALSE, FALSE, sizeof (IdeFileEdit));
+  g_array_set_clear_func (edits, (GDestroyNotify)_ide_file_edit_clear);
+  return edits;
+}
+
+static void
+assert_edits (const char   *contents,
+              const GArray *edits,
+              const char   *expected)
+{
+  g_autoptr(GBytes) bytes = g_bytes_new_static (contents, strlen (contents));
+  g_autoptr(GBytes) result = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *str = NULL;
+  gsize len;
+
+  result = _ide_file_edits_apply (bytes, edits, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (result);
+
+  str = g_strndup (g_bytes_get_data (result, NULL), g_bytes_get_size (result));
+  len = g_bytes_get_size (result);
+
+  g_assert_cmpint (len, ==, strlen (expected));
+  g_assert_cmpstr (str, ==, expected);
+}
+
+static void
+test_file_edits_basic (void)
+{
+  g_autoptr(GArray) edits = new_edits ();
+
+  /* Edits are sorted in reverse like the buffer manager does */
+  add_edit (edits, 1, 4, 1, 7, "baz");
+  add_edit (edits, 0, 0, 0, 5, "HELLO");
+
+  assert_edits ("hello world\nfoo bar\n", edits, "HELLO world\nfoo baz\n");
+}
+
+static void
+test_file_edits_clamp (void)
+{
+  g_autoptr(GArray) edits = new_edits ();
+  g_autoptr(GArray) past_end = new_edits ();
+
+  /* The \r of \r\n is not part of the line */
+  add_edit (edits, 0, 10, 0, 10, "!");
+  assert_edits ("ab\r\ncd", edits, "ab!\r\ncd");
+
+  add_edit (past_end, 5, 0, 5, 0, "x");
+  assert_edits ("a\n", past_end, "a\nx");
+}
+
+static void
+test_file_edits_utf8 (void)
+{
+  g_autoptr(GArray) edits = new_edits ();
+
+  add_edit (edits, 0, 1, 0, 2, "e");
+  assert_edits ("h\xc3\xa9llo", edits, "hello");
+}
+
+static void
+test_file_edits_invalid (void)
+{
+  g_autoptr(GBytes) bytes = g_bytes_new_static ("\xff\xfe", 2);
+  g_autoptr(GArray) edits = new_edits ();
+  g_autoptr(GBytes) result = NULL;
+  g_autoptr(GError) error = NULL;
+
+  add_edit (edits, 0, 0, 0, 1, "x");
+
+  result = _ide_file_edits_apply (bytes, edits, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+  g_assert_null (result);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/FileEdits/basic", test_file_edits_basic);
+  g_test_add_func ("/Ide/FileEdits/clamp", test_file_edits_clamp);
+  g_test_add_func ("/Ide/FileEdits/utf8", test_file_edits_utf8);
+  g_test_add_func ("/Ide/FileEdits/invalid", test_file_edits_invalid);
+  return g_test_run ();
+}
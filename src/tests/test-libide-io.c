@@ -18,6 +18,10 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+
 #include <libide-io.h>
 
 static void
@@ -37,12 +41,179 @@ test_path_expand (void)
   test_expand ("foo", g_build_filename (g_get_home_dir (), "foo", NULL));
 }
 
+typedef struct
+{
+  IdePtyFd fd;
+  gsize    len;
+  gboolean close_when_done;
+} Writer;
+
+static gpointer
+write_thread (gpointer data)
+{
+  Writer *writer = data;
+  char buf[4096];
+
+  /* No newlines so that ONLCR does not change what we read back */
+  memset (buf, 'x', sizeof buf);
+
+  while (writer->len > 0)
+    {
+      gssize n_written = write (writer->fd, buf, MIN (sizeof buf, writer->len));
+
+      if (n_written < 0 && errno == EINTR)
+        continue;
+
+      g_assert_cmpint (n_written, >, 0);
+      writer->len -= n_written;
+    }
+
+  /* Like an inferior exiting right after printing its last output */
+  if (writer->close_when_done)
+    pty_fd_clear (&writer->fd);
+
+  return NULL;
+}
+
+static void
+observe_cb (const IdePtyIntercept     *intercept,
+            const IdePtyInterceptSide *side,
+            const guint8              *data,
+            gsize                      len,
+            gpointer                   user_data)
+{
+  gsize *n_observed = user_data;
+
+  g_assert_true (side == &intercept->consumer);
+
+  for (gsize i = 0; i < len; i++)
+    g_assert_cmpint (data[i], ==, 'x');
+
+  *n_observed += len;
+}
+
+static void
+test_pty_intercept_forward (void)
+{
+  g_auto(IdePtyFd) terminal_fd = IDE_PTY_FD_INVALID;
+  g_auto(IdePtyFd) inferior_fd = IDE_PTY_FD_INVALID;
+  IdePtyIntercept intercept;
+  Writer writer;
+  GThread *thread;
+  gsize len = 1024 * 1024;
+  gsize n_observed = 0;
+  gsize n_read = 0;
+
+  if ((terminal_fd = ide_pty_intercept_create_consumer ()) == IDE_PTY_FD_INVALID)
+    {
+      g_test_skip ("PTYs are not available");
+      return;
+    }
+
+  g_assert_true (ide_pty_intercept_init (&intercept, terminal_fd, NULL));
+  ide_pty_intercept_set_callback (&intercept, &intercept.consumer, observe_cb, &n_observed);
+
+  inferior_fd = ide_pty_intercept_create_producer (ide_pty_intercept_get_fd (&intercept), TRUE);
+  g_assert_cmpint (inferior_fd, !=, IDE_PTY_FD_INVALID);
+
+  writer.fd = inferior_fd;
+  writer.len = len;
+  writer.close_when_done = FALSE;
+  thread = g_thread_new ("writer", write_thread, &writer);
+
+  while (n_read < len || n_observed < len)
+    {
+      struct pollfd pfd = { .fd = terminal_fd, .events = POLLIN };
+      char buf[4096];
+      gssize n;
+
+      g_main_context_iteration (NULL, FALSE);
+
+      if (poll (&pfd, 1, 10) <= 0)
+        continue;
+
+      while ((n = read (terminal_fd, buf, sizeof buf)) > 0)
+        {
+          for (gssize i = 0; i < n; i++)
+            g_assert_cmpint (buf[i], ==, 'x');
+          n_read += n;
+        }
+    }
+
+  g_assert_cmpint (n_read, ==, len);
+  g_assert_cmpint (n_observed, ==, len);
+
+  g_thread_join (thread);
+  ide_pty_intercept_clear (&intercept);
+}
+
+static void
+test_pty_intercept_hangup (void)
+{
+  g_auto(IdePtyFd) terminal_fd = IDE_PTY_FD_INVALID;
+  IdePtyIntercept intercept;
+  Writer writer;
+  GThread *thread;
+  gsize len = 1024 * 512;
+  gsize n_read = 0;
+  gint64 deadline;
+
+  if ((terminal_fd = ide_pty_intercept_create_consumer ()) == IDE_PTY_FD_INVALID)
+    {
+      g_test_skip ("PTYs are not available");
+      return;
+    }
+
+  g_assert_true (ide_pty_intercept_init (&intercept, terminal_fd, NULL));
+
+  writer.fd = ide_pty_intercept_create_producer (ide_pty_intercept_get_fd (&intercept), TRUE);
+  writer.len = len;
+  writer.close_when_done = TRUE;
+  g_assert_cmpint (writer.fd, !=, IDE_PTY_FD_INVALID);
+
+  thread = g_thread_new ("writer", write_thread, &writer);
+
+  /* Read slowly so that the intercept is still holding a large part of
+   * the burst when the writer hangs up. All of it must still arrive.
+   */
+  deadline = g_get_monotonic_time () + 30 * G_USEC_PER_SEC;
+
+  while (n_read < len && g_get_monotonic_time () < deadline)
+    {
+      struct pollfd pfd = { .fd = terminal_fd, .events = POLLIN };
+      char buf[1024];
+      gssize n;
+
+      g_main_context_iteration (NULL, FALSE);
+
+      if (poll (&pfd, 1, 10) <= 0)
+        continue;
+
+      if ((n = read (terminal_fd, buf, sizeof buf)) > 0)
+        {
+          for (gssize i = 0; i < n; i++)
+            g_assert_cmpint (buf[i], ==, 'x');
+          n_read += n;
+        }
+
+      g_usleep (100);
+    }
+
+  g_thread_join (thread);
+  g_assert_cmpint (writer.fd, ==, IDE_PTY_FD_INVALID);
+  g_assert_cmpint (n_read, ==, len);
+
+  ide_pty_intercept_clear (&intercept);
+}
+
 gint
 main (int argc,
       char *argv[])
 {
   g_test_init (&argc, &argv, NULL);
   g_test_add_func ("/libide-io/path/expand", test_path_expand);
+  g_test_add_func ("/libide-io/pty-intercept/forward", test_pty_intercept_forward);
+  g_test_add_func ("/libide-io/pty-intercept/hangup", test_pty_intercept_hangup);
   return g_test_run ();
 }
 
@@ -0,0 +1,188 @@
+/* test-lsp-completion-results.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <json-glib/json-glib.h>
+
+#include <libide-lsp.h>
+
+#include "ide-lsp-completion-item-private.h"
+#include "ide-lsp-completion-results-private.h"
+
+typedef struct
+{
+  guint removed;
+  guint added;
+} Changed;
+
+static GVariant *
+parse_reply (const char *json)
+{
+  g_autoptr(GError) error = NULL;
+  GVariant *reply;
+
+  /* Decoded the same way jsonrpc-glib decodes server replies */
+  reply = json_gvariant_deserialize_data (json, -1, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (reply);
+
+  return g_variant_ref_sink (reply);
+}
+
+static void
+items_changed_cb (GListModel *model,
+                  guint       position,
+                  guint       removed,
+                  guint       added,
+                  Changed    *changed)
+{
+  g_assert_cmpint (position, ==, 0);
+
+  changed->removed = removed;
+  changed->added = added;
+}
+
+static void
+assert_labels (IdeLspCompletionResults *results,
+               const char * const      *expected)
+{
+  guint n_items = g_list_model_get_n_items (G_LIST_MODEL (results));
+
+  g_assert_cmpint (n_items, ==, g_strv_length ((char **)expected));
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autoptr(IdeLspCompletionItem) item = g_list_model_get_item (G_LIST_MODEL (results), i);
+      g_autofree char *typed_text = gtk_source_completion_proposal_get_typed_text (GTK_SOURCE_COMPLETION_PROPOSAL (item));
+
+      g_assert_cmpstr (typed_text, ==, expected[i]);
+    }
+}
+
+static IdeSymbolKind
+get_kind (IdeLspCompletionResults *results,
+          guint                    position)
+{
+  g_autoptr(IdeLspCompletionItem) item = g_list_model_get_item (G_LIST_MODEL (results), position);
+
+  return _ide_lsp_completion_item_get_kind (item);
+}
+
+static void
+test_completion_results_narrow (void)
+{
+  g_autoptr(IdeLspCompletionResults) results = NULL;
+  g_autoptr(GVariant) reply = NULL;
+  Changed changed = {0};
+
+  reply = parse_reply ("["
+                       "{\"label\":\"foo\",\"kind\":3,\"sortText\":\"2\"},"
+                       "{\"label\":\"foo\",\"kind\":2,\"sortText\":\"1\"},"
+                       "{\"label\":\"FooBar\",\"kind\":7},"
+                       "{\"label\":\"food()\",\"filterText\":\"food\",\"kind\":6},"
+                       "{\"label\":\"bar\"}"
+                       "]");
+
+  results = ide_lsp_completion_results_new (reply);
+  g_signal_connect (results, "items-changed", G_CALLBACK (items_changed_cb), &changed);
+  g_assert_false (ide_lsp_completion_results_get_incomplete (results));
+  g_assert_cmpint (g_list_model_get_n_items (G_LIST_MODEL (results)), ==, 5);
+
+  /* Equal matches keep the order given by sortText */
+  ide_lsp_completion_results_refilter (results, "foo");
+  g_assert_cmpint (changed.removed, ==, 5);
+  g_assert_cmpint (changed.added, ==, 4);
+  g_assert_cmpint (get_kind (results, 0), ==, IDE_SYMBOL_KIND_METHOD);
+  g_assert_cmpint (get_kind (results, 1), ==, IDE_SYMBOL_KIND_FUNCTION);
+
+  /* Narrowing only rechecks previous matches, with casefolded keys */
+  ide_lsp_completion_results_refilter (results, "FOOB");
+  g_assert_cmpint (changed.removed, ==, 4);
+  g_assert_cmpint (changed.added, ==, 1);
+  assert_labels (results, (const char * const []) { "FooBar", NULL });
+  g_assert_cmpint (get_kind (results, 0), ==, IDE_SYMBOL_KIND_CLASS);
+
+  /* filterText is matched rather than the label */
+  ide_lsp_completion_results_refilter (results, "food");
+  g_assert_cmpint (changed.added, ==, 1);
+  assert_labels (results, (const char * const []) { "food()", NULL });
+  g_assert_cmpint (get_kind (results, 0), ==, IDE_SYMBOL_KIND_VARIABLE);
+
+  /* Widening the query has to scan everything again */
+  ide_lsp_completion_results_refilter (results, "b");
+  assert_labels (results, (const char * const []) { "bar", "FooBar", NULL });
+
+  /* Without a query everything is ordered by sortText, or the label */
+  ide_lsp_completion_results_refilter (results, NULL);
+  g_assert_cmpint (changed.added, ==, 5);
+  assert_labels (results, (const char * const []) { "foo", "foo", "FooBar", "bar", "food()", NULL });
+  g_assert_cmpint (get_kind (results, 3), ==, IDE_SYMBOL_KIND_NONE);
+}
+
+static void
+test_completion_results_incomplete (void)
+{
+  g_autoptr(IdeLspCompletionResults) results = NULL;
+  g_autoptr(GVariant) reply = NULL;
+  g_autoptr(GVariant) requery = NULL;
+  Changed changed = {0};
+
+  reply = parse_reply ("{\"isIncomplete\":true,\"items\":["
+                       "{\"label\":\"alpha\",\"kind\":6},"
+                       "{\"label\":\"alphabet\",\"kind\":6},"
+                       "{\"label\":\"beta\",\"kind\":6}"
+                       "]}");
+
+  results = ide_lsp_completion_results_new (reply);
+  g_signal_connect (results, "items-changed", G_CALLBACK (items_changed_cb), &changed);
+  g_assert_true (ide_lsp_completion_results_get_incomplete (results));
+
+  /* Local filtering still narrows while the server is queried again */
+  ide_lsp_completion_results_refilter (results, "alph");
+  assert_labels (results, (const char * const []) { "alpha", "alphabet", NULL });
+
+  requery = parse_reply ("{\"isIncomplete\":false,\"items\":["
+                         "{\"label\":\"alphanumeric\",\"kind\":3,\"sortText\":\"b\"},"
+                         "{\"label\":\"alphabet\",\"kind\":5,\"sortText\":\"a\"},"
+                         "{\"label\":\"gamma\",\"kind\":3}"
+                         "]}");
+
+  /* The new items replace the old ones in the same model and are
+   * filtered with the current word without reusing the old matches.
+   */
+  _ide_lsp_completion_results_update (results, requery, "alpha");
+  g_assert_false (ide_lsp_completion_results_get_incomplete (results));
+  g_assert_cmpint (changed.removed, ==, 2);
+  g_assert_cmpint (changed.added, ==, 2);
+  g_assert_cmpint (get_kind (results, 0), ==, IDE_SYMBOL_KIND_FIELD);
+  g_assert_cmpint (get_kind (results, 1), ==, IDE_SYMBOL_KIND_FUNCTION);
+
+  ide_lsp_completion_results_refilter (results, "alphan");
+  assert_labels (results, (const char * const []) { "alphanumeric", NULL });
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/Lsp/CompletionResults/narrow", test_completion_results_narrow);
+  g_test_add_func ("/Ide/Lsp/CompletionResults/incomplete", test_completion_results_incomplete);
+  return g_test_run ();
+}
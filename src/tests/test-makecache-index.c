@@ -0,0 +1,391 @@
+/* test-makecache-index.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "ide-makecache-index.h"
+
+/* A tiny tree shaped like the output of automake, with a recursive
+ * top-level Makefile and the objects living in src/.
+ */
+static const char top_makefile[] =
+  "SUBDIRS = src\n"
+  "subdir = .\n"
+  "all:\n"
+  "\t@for d in $(SUBDIRS); do $(MAKE) -C $$d all; done\n";
+
+static const char src_makefile[] =
+  "CC = cc\n"
+  "subdir = src\n"
+  "all: app\n"
+  "app: app-main.o libutil_la-util.lo\n"
+  "\t$(CC) -o $@ $^\n"
+  "app-main.o: main.c util.h\n"
+  "\t$(CC) -DMAIN -c -o $@ main.c\n"
+  "libutil_la-util.lo: util.c util.h | .deps\n"
+  "\t$(CC) -DUTIL -c -o $@ util.c\n"
+  "app-main.o: CFLAGS = -O2\n"
+  ".deps:\n"
+  "\tmkdir -p $@\n";
+
+/* Per-target flags make automake compile the same source once for
+ * each target, with different flags.
+ */
+static const char shared_makefile[] =
+  "CC = cc\n"
+  "subdir = src\n"
+  "all: app\n"
+  "app: app-main.o libx_la-shared.lo liby_la-shared.lo\n"
+  "\t$(CC) -o $@ $^\n"
+  "app-main.o: main.c\n"
+  "\t$(CC) -DMAIN -c -o $@ main.c\n"
+  "libx_la-shared.lo: shared.c\n"
+  "\t$(CC) -DLIBX -c -o $@ `test -f 'shared.c' || echo './'`shared.c\n"
+  "liby_la-shared.lo: shared.c\n"
+  "\t$(CC) -DLIBY -c -o $@ `test -f 'shared.c' || echo './'`shared.c\n";
+
+static char *
+make_tree (const char *makefile)
+{
+  g_autoptr(GError) error = NULL;
+  g_autofree char *src = NULL;
+  char *tmpdir;
+
+  tmpdir = g_dir_make_tmp ("test-makecache-index-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  src = g_build_filename (tmpdir, "src", NULL);
+  g_assert_cmpint (g_mkdir (src, 0750), ==, 0);
+
+#define WRITE_FILE(dir, name, contents)                                   \
+  G_STMT_START {                                                          \
+    g_autofree char *path = g_build_filename (dir, name, NULL);          \
+    g_file_set_contents (path, contents, -1, &error);                     \
+    g_assert_no_error (error);                                            \
+  } G_STMT_END
+
+  WRITE_FILE (tmpdir, "Makefile", top_makefile);
+  WRITE_FILE (src, "Makefile", makefile);
+  WRITE_FILE (src, "main.c", "");
+  WRITE_FILE (src, "shared.c", "");
+  WRITE_FILE (src, "util.c", "");
+  WRITE_FILE (src, "util.h", "");
+
+#undef WRITE_FILE
+
+  return tmpdir;
+}
+
+static void
+remove_tree (const char *tmpdir)
+{
+  static const char *files[] = { "src/Makefile", "src/main.c", "src/shared.c", "src/util.c", "src/util.h", "src", "Makefile" };
+
+  for (guint i = 0; i < G_N_ELEMENTS (files); i++)
+    {
+      g_autofree char *path = g_build_filename (tmpdir, files[i], NULL);
+      g_remove (path);
+    }
+
+  g_rmdir (tmpdir);
+}
+
+static char *
+run_make (const char  *tmpdir,
+          const char **extra_argv,
+          gboolean    *skipped)
+{
+  g_autoptr(GPtrArray) argv = g_ptr_array_new ();
+  g_autoptr(GError) error = NULL;
+  char *stdout_buf = NULL;
+  int status = 0;
+
+  g_ptr_array_add (argv, (char *)"make");
+  for (guint i = 0; extra_argv[i]; i++)
+    g_ptr_array_add (argv, (char *)extra_argv[i]);
+  g_ptr_array_add (argv, NULL);
+
+  *skipped = FALSE;
+
+  if (!g_spawn_sync (tmpdir, (char **)argv->pdata, NULL,
+                     G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+                     NULL, NULL, &stdout_buf, NULL, &status, &error))
+    {
+      g_test_skip ("make is not available");
+      *skipped = TRUE;
+      return NULL;
+    }
+
+  return stdout_buf;
+}
+
+static IdeMakecacheIndex *
+index_tree (const char *tmpdir,
+            gboolean   *skipped)
+{
+  static const char *argv[] = { "-p", "-n", "-s", "all", NULL };
+  g_autofree char *contents = NULL;
+
+  /* The recursive make is run even with -n, so this contains the
+   * database of src/ followed by the top-level one.
+   */
+  if (!(contents = run_make (tmpdir, argv, skipped)))
+    return NULL;
+
+  return ide_makecache_index_new (contents, strlen (contents));
+}
+
+static void
+assert_lookup (IdeMakecacheIndex *index,
+               const char        *path,
+               const char        *target)
+{
+  g_autoptr(GPtrArray) targets = ide_makecache_index_lookup (index, path);
+  IdeMakecacheTarget *first;
+
+  if (target == NULL)
+    {
+      g_assert_null (targets);
+      return;
+    }
+
+  g_assert_nonnull (targets);
+  g_assert_cmpint (targets->len, ==, 1);
+
+  first = g_ptr_array_index (targets, 0);
+  g_assert_cmpstr (ide_makecache_target_get_subdir (first), ==, "src");
+  g_assert_cmpstr (ide_makecache_target_get_target (first), ==, target);
+}
+
+static void
+assert_index (IdeMakecacheIndex *index)
+{
+  g_autoptr(GPtrArray) targets = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(GPtrArray) sources = g_ptr_array_new_with_free_func (g_free);
+
+  g_assert_cmpint (ide_makecache_index_get_n_targets (index), ==, 2);
+
+  assert_lookup (index, "/home/user/project/src/main.c", "app-main.o");
+  assert_lookup (index, "src/util.c", "libutil_la-util.lo");
+  assert_lookup (index, "app.c", NULL);
+
+  /* Headers are prerequisites of both objects */
+  {
+    g_autoptr(GPtrArray) header = ide_makecache_index_lookup (index, "util.h");
+    g_assert_nonnull (header);
+    g_assert_cmpint (header->len, ==, 2);
+  }
+
+  g_assert_false (ide_makecache_index_get_dry_run (index, NULL, targets, sources));
+  g_assert_true (ide_makecache_index_get_dry_run (index, "src", targets, sources));
+  g_assert_cmpint (targets->len, ==, 2);
+  g_assert_cmpint (sources->len, ==, 2);
+
+  for (guint i = 0; i < targets->len; i++)
+    {
+      const char *target = g_ptr_array_index (targets, i);
+      const char *source = g_ptr_array_index (sources, i);
+
+      if (g_str_equal (target, "app-main.o"))
+        g_assert_cmpstr (source, ==, "main.c");
+      else if (g_str_equal (target, "libutil_la-util.lo"))
+        g_assert_cmpstr (source, ==, "util.c");
+      else
+        g_assert_not_reached ();
+    }
+}
+
+static void
+test_makecache_index_parse (void)
+{
+  g_autoptr(IdeMakecacheIndex) index = NULL;
+  g_autoptr(IdeMakecacheIndex) copy = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  g_autofree char *tmpdir = make_tree (src_makefile);
+  gboolean skipped;
+
+  if (!(index = index_tree (tmpdir, &skipped)))
+    {
+      g_assert_true (skipped);
+      remove_tree (tmpdir);
+      return;
+    }
+
+  assert_index (index);
+
+  /* The index is persisted next to the make cache */
+  variant = g_variant_ref_sink (ide_makecache_index_to_variant (index));
+  copy = ide_makecache_index_new_from_variant (variant);
+  g_assert_nonnull (copy);
+  assert_index (copy);
+
+  remove_tree (tmpdir);
+}
+
+static const char *
+matched_command (GPtrArray  *commands,
+                 GPtrArray  *targets,
+                 const int  *matches,
+                 const char *target)
+{
+  guint pos;
+
+  g_assert_true (g_ptr_array_find_with_equal_func (targets, target, g_str_equal, &pos));
+  g_assert_cmpint (matches[pos], >=, 0);
+  g_assert_cmpint (matches[pos], <, commands->len);
+
+  return g_ptr_array_index (commands, matches[pos]);
+}
+
+static void
+test_makecache_index_dry_run (void)
+{
+  g_autoptr(IdeMakecacheIndex) index = NULL;
+  g_autoptr(GPtrArray) targets = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(GPtrArray) sources = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(GPtrArray) argv = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(GPtrArray) commands = g_ptr_array_new ();
+  g_autofree char *tmpdir = make_tree (shared_makefile);
+  g_autofree char *output = NULL;
+  g_autofree int *matches = NULL;
+  g_auto(GStrv) lines = NULL;
+  gboolean skipped;
+  char *tmp;
+
+  if (!(index = index_tree (tmpdir, &skipped)))
+    {
+      remove_tree (tmpdir);
+      return;
+    }
+
+  g_assert_true (ide_makecache_index_get_dry_run (index, "src", targets, sources));
+  g_assert_cmpint (targets->len, ==, 3);
+
+  /* A single make invocation, as ide_makecache_run_dry_run() does */
+  g_ptr_array_add (argv, g_strdup ("-C"));
+  g_ptr_array_add (argv, g_strdup ("src"));
+  g_ptr_array_add (argv, g_strdup ("-s"));
+  g_ptr_array_add (argv, g_strdup ("-i"));
+  g_ptr_array_add (argv, g_strdup ("-n"));
+  for (guint i = 0; i < sources->len; i++)
+    g_ptr_array_add (argv, g_strdup_printf ("-W%s", (char *)g_ptr_array_index (sources, i)));
+  for (guint i = 0; i < targets->len; i++)
+    g_ptr_array_add (argv, g_strdup (g_ptr_array_index (targets, i)));
+  g_ptr_array_add (argv, NULL);
+
+  output = run_make (tmpdir, (const char **)argv->pdata, &skipped);
+  g_assert_nonnull (output);
+
+  for (tmp = output; (tmp = strstr (tmp, "\\\n")); )
+    tmp[0] = tmp[1] = ' ';
+
+  lines = g_strsplit (output, "\n", 0);
+  for (guint i = 0; lines[i]; i++)
+    {
+      if (strstr (lines[i], " -c ") != NULL)
+        g_ptr_array_add (commands, lines[i]);
+    }
+
+  g_assert_cmpint (commands->len, ==, 3);
+
+  matches = g_new (int, targets->len);
+  ide_makecache_match_commands (commands, targets, sources, 0, targets->len, matches);
+
+  /* Both objects of shared.c must get the flags of their own command */
+  g_assert_nonnull (strstr (matched_command (commands, targets, matches, "app-main.o"), "-DMAIN"));
+  g_assert_nonnull (strstr (matched_command (commands, targets, matches, "libx_la-shared.lo"), "-DLIBX"));
+  g_assert_nonnull (strstr (matched_command (commands, targets, matches, "liby_la-shared.lo"), "-DLIBY"));
+
+  remove_tree (tmpdir);
+}
+
+static void
+test_makecache_match_commands (void)
+{
+  static const char *command_strs[] = {
+    "libtool --mode=compile cc -DLIBX -c -o libx_la-foo.lo `test -f 'foo.c' || echo './'`foo.c",
+    "libtool --mode=compile cc -DLIBY -c -o 'liby_la-foo.lo' foo.c",
+    "cc -DLIBZ -c foo.c",
+    "valac -C --vapidir=vapi bar.vala baz.vala",
+    "cc -c -osub/app.o app.c",
+  };
+  static const char *target_strs[] = {
+    "liby_la-foo.lo",
+    "libx_la-foo.lo",
+    "foo.o",
+    "libbar_la_vala.stamp",
+    "app.o",
+    "missing.o",
+    "unknown.o",
+  };
+  static const char *source_strs[] = {
+    "foo.c",
+    "foo.c",
+    "foo.c",
+    "baz.vala",
+    "app.c",
+    "missing.c",
+    NULL,
+  };
+  static const int expected[] = { 1, 0, 2, 3, 4, -1, -1 };
+  g_autoptr(GPtrArray) commands = g_ptr_array_new ();
+  g_autoptr(GPtrArray) targets = g_ptr_array_new ();
+  g_autoptr(GPtrArray) sources = g_ptr_array_new ();
+  int matches[G_N_ELEMENTS (target_strs)];
+
+  G_STATIC_ASSERT (G_N_ELEMENTS (target_strs) == G_N_ELEMENTS (source_strs));
+  G_STATIC_ASSERT (G_N_ELEMENTS (target_strs) == G_N_ELEMENTS (expected));
+
+  for (guint i = 0; i < G_N_ELEMENTS (command_strs); i++)
+    g_ptr_array_add (commands, (char *)command_strs[i]);
+
+  for (guint i = 0; i < G_N_ELEMENTS (target_strs); i++)
+    {
+      g_ptr_array_add (targets, (char *)target_strs[i]);
+      g_ptr_array_add (sources, (char *)source_strs[i]);
+    }
+
+  /* Objects are matched by -o, even when quoted or in a directory. A
+   * target without an -o command falls back to the command mentioning
+   * its source which does not already build another target.
+   */
+  ide_makecache_match_commands (commands, targets, sources, 0, targets->len, matches);
+
+  for (guint i = 0; i < G_N_ELEMENTS (expected); i++)
+    g_assert_cmpint (matches[i], ==, expected[i]);
+
+  /* Only the requested range is matched */
+  ide_makecache_match_commands (commands, targets, sources, 1, 3, matches);
+  g_assert_cmpint (matches[0], ==, 0);
+  g_assert_cmpint (matches[1], ==, 2);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/MakecacheIndex/parse", test_makecache_index_parse);
+  g_test_add_func ("/Ide/MakecacheIndex/dry-run", test_makecache_index_dry_run);
+  g_test_add_func ("/Ide/MakecacheIndex/match-commands", test_makecache_match_commands);
+  return g_test_run ();
+}
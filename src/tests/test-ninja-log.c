@@ -0,0 +1,117 @@
+/* test-ninja-log.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <string.h>
+
+#include <libide-foundry.h>
+
+#include "ide-ninja-log-private.h"
+
+static IdeNinjaLog *
+parse (const char *contents)
+{
+  g_autoptr(GBytes) bytes = g_bytes_new_static (contents, strlen (contents));
+  g_autoptr(GError) error = NULL;
+  IdeNinjaLog *ninja_log;
+
+  ninja_log = ide_ninja_log_new_from_bytes (bytes, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (ninja_log);
+
+  return ninja_log;
+}
+
+static void
+test_ninja_log_last_build (void)
+{
+  g_autoptr(IdeNinjaLog) ninja_log = NULL;
+  const IdeNinjaLogEntry *entry;
+
+  /* The second build restarts the clock and only rebuilt two objects.
+   * The header generator has two outputs which share a single edge.
+   */
+  ninja_log = parse ("# ninja log v5\n"
+                     "0\t500\t1\tfoo.o\taaaa\n"
+                     "0\t800\t1\tbar.o\tbbbb\n"
+                     "800\t900\t1\tapp\tcccc\n"
+                     "0\t40\t2\tgen.h\tdddd\n"
+                     "0\t40\t2\tgen.c\tdddd\n"
+                     "40\t300\t2\tfoo.o\taaaa\n"
+                     "300\t350\t2\tapp\tcccc\n");
+
+  g_assert_cmpint (ide_ninja_log_get_n_entries (ninja_log), ==, 3);
+  g_assert_cmpint (ide_ninja_log_get_duration (ninja_log), ==, 350);
+
+  entry = ide_ninja_log_get_entry (ninja_log, 0);
+  g_assert_cmpstr (entry->output, ==, "foo.o");
+  g_assert_cmpint (IDE_NINJA_LOG_ENTRY_DURATION (entry), ==, 260);
+
+  entry = ide_ninja_log_get_entry (ninja_log, 2);
+  g_assert_cmpstr (entry->output, ==, "gen.h");
+
+  g_assert_null (ide_ninja_log_get_entry (ninja_log, 3));
+}
+
+static void
+test_ninja_log_critical_path (void)
+{
+  g_autoptr(IdeNinjaLog) ninja_log = NULL;
+  g_autoptr(GPtrArray) path = NULL;
+
+  /* b.o is on the critical path as the link waited for it, while a.o
+   * and c.o ran in parallel with it.
+   */
+  ninja_log = parse ("# ninja log v6\n"
+                     "0\t100\t1\ta.o\taaaa\n"
+                     "0\t200\t1\tgen.h\tbbbb\n"
+                     "100\t250\t1\tc.o\tcccc\n"
+                     "200\t600\t1\tb.o\tdddd\n"
+                     "600\t700\t1\tapp\teeee\n");
+
+  path = ide_ninja_log_get_critical_path (ninja_log);
+
+  g_assert_cmpint (path->len, ==, 3);
+  g_assert_cmpstr (((IdeNinjaLogEntry *)g_ptr_array_index (path, 0))->output, ==, "gen.h");
+  g_assert_cmpstr (((IdeNinjaLogEntry *)g_ptr_array_index (path, 1))->output, ==, "b.o");
+  g_assert_cmpstr (((IdeNinjaLogEntry *)g_ptr_array_index (path, 2))->output, ==, "app");
+}
+
+static void
+test_ninja_log_invalid (void)
+{
+  g_autoptr(GBytes) bytes = g_bytes_new_static ("# ninja log v4\n", 15);
+  g_autoptr(IdeNinjaLog) ninja_log = NULL;
+  g_autoptr(GError) error = NULL;
+
+  ninja_log = ide_ninja_log_new_from_bytes (bytes, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED);
+  g_assert_null (ninja_log);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/NinjaLog/last-build", test_ninja_log_last_build);
+  g_test_add_func ("/Ide/NinjaLog/critical-path", test_ninja_log_critical_path);
+  g_test_add_func ("/Ide/NinjaLog/invalid", test_ninja_log_invalid);
+  return g_test_run ();
+}
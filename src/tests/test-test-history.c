@@ -0,0 +1,113 @@
+/* test-test-history.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <libide-foundry.h>
+
+#include "ide-test-history-private.h"
+
+static IdeTestHistory *
+create_history (void)
+{
+  g_autoptr(GFile) file = g_file_new_for_path ("test-history.gvariant");
+
+  return ide_test_history_new (file);
+}
+
+static GPtrArray *
+create_tests (const char * const *ids)
+{
+  GPtrArray *tests = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (guint i = 0; ids[i]; i++)
+    {
+      g_autoptr(IdeRunCommand) run_command = ide_run_command_new ();
+
+      ide_run_command_set_id (run_command, ids[i]);
+      ide_run_command_set_kind (run_command, IDE_RUN_COMMAND_KIND_TEST);
+
+      g_ptr_array_add (tests, ide_test_new (run_command));
+    }
+
+  return tests;
+}
+
+static void
+assert_order (GPtrArray          *tests,
+              const char * const *ids)
+{
+  g_assert_cmpint (tests->len, ==, g_strv_length ((char **)ids));
+
+  for (guint i = 0; i < tests->len; i++)
+    g_assert_cmpstr (ide_test_get_id (g_ptr_array_index (tests, i)), ==, ids[i]);
+}
+
+static void
+test_test_history_record (void)
+{
+  g_autoptr(IdeTestHistory) history = create_history ();
+  GTimeSpan duration = 0;
+  gboolean failed = FALSE;
+
+  g_assert_false (ide_test_history_lookup (history, "a", NULL, NULL));
+
+  ide_test_history_record (history, "a", 1000, TRUE);
+  g_assert_true (ide_test_history_lookup (history, "a", &duration, &failed));
+  g_assert_cmpint (duration, ==, 1000);
+  g_assert_true (failed);
+
+  /* Durations are smoothed, outcomes are not */
+  ide_test_history_record (history, "a", 3000, FALSE);
+  g_assert_true (ide_test_history_lookup (history, "a", &duration, &failed));
+  g_assert_cmpint (duration, ==, 2000);
+  g_assert_false (failed);
+}
+
+static void
+test_test_history_sort (void)
+{
+  g_autoptr(IdeTestHistory) history = create_history ();
+  g_autoptr(GPtrArray) tests = NULL;
+
+  ide_test_history_record (history, "fast", 100, FALSE);
+  ide_test_history_record (history, "slow", 5000, FALSE);
+  ide_test_history_record (history, "medium", 1000, TRUE);
+  ide_test_history_record (history, "also-fast", 100, FALSE);
+
+  /* Tests which never ran go first, equal durations keep their order */
+  tests = create_tests (IDE_STRV_INIT ("fast", "medium", "new", "also-fast", "slow"));
+  ide_test_history_sort (history, tests, FALSE);
+  assert_order (tests, IDE_STRV_INIT ("new", "slow", "medium", "fast", "also-fast"));
+
+  g_clear_pointer (&tests, g_ptr_array_unref);
+
+  tests = create_tests (IDE_STRV_INIT ("fast", "medium", "new", "also-fast", "slow"));
+  ide_test_history_sort (history, tests, TRUE);
+  assert_order (tests, IDE_STRV_INIT ("medium", "new", "slow", "fast", "also-fast"));
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/TestHistory/record", test_test_history_record);
+  g_test_add_func ("/Ide/TestHistory/sort", test_test_history_sort);
+  return g_test_run ();
+}